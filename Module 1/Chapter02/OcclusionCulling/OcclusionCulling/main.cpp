@@ -0,0 +1,550 @@
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "..\..\src\GLSLShader.h"
+
+#define GL_CHECK_ERRORS assert(glGetError()== GL_NO_ERROR);
+
+#pragma comment(lib, "glew32.lib")
+
+using namespace std;
+
+//screen size
+const int WIDTH  = 1280;
+const int HEIGHT = 960;
+
+//camera tranformation variables
+int state = 0, oldX=0, oldY=0;
+float rX=0, rY=0, fov = 45;
+
+#include "..\..\src\FreeCamera.h"
+
+//virtual key codes
+const int VK_W = 0x57;
+const int VK_S = 0x53;
+const int VK_A = 0x41;
+const int VK_D = 0x44;
+const int VK_Q = 0x51;
+const int VK_Z = 0x5a;
+
+//for floating point imprecision
+const float EPSILON = 0.001f;
+const float EPSILON2 = EPSILON*EPSILON;
+
+//delta time
+float dt = 0;
+
+//free camera instance
+CFreeCamera cam;
+
+//output message
+#include <sstream>
+std::stringstream msg;
+
+//grid object
+#include "..\..\src\Grid.h"
+CGrid* grid;
+
+//unit cube object, its geometry is drawn once per visible building
+#include "..\..\src\UnitCube.h"
+CUnitCube* cube;
+
+//occlusion culler and frustum culling hierarchy
+#include "..\..\src\HiZOcclusionCuller.h"
+#include "..\..\src\SceneBVH.h"
+CHiZOcclusionCuller occlusionCuller;
+CFrustumCuller frustumCuller;
+CSceneBVH cityBVH;
+
+//city layout: CITY_X x CITY_Z blocks with one building per block
+const int CITY_X = 100;
+const int CITY_Z = 100;
+const int TOTAL_BUILDINGS = CITY_X*CITY_Z;
+const float BLOCK_SIZE = 4.0f;
+
+//building bounding boxes
+AABBBatch buildings;
+
+//instanced building shader
+GLSLShader boxShader;
+
+//buffers holding the building boxes, the visible ids and the indirect command
+GLuint boxBufferID;
+GLuint visibleBufferID;
+GLuint commandBufferID;
+
+//size of the software depth buffer used by the CPU path
+const int CPU_DEPTH_WIDTH  = 256;
+const int CPU_DEPTH_HEIGHT = 192;
+//number of nearest buildings rasterized as occluders by the CPU path
+const int MAX_CPU_OCCLUDERS = 512;
+
+//culling modes
+enum CullMode {CULL_NONE, CULL_GPU, CULL_CPU};
+CullMode mode = CULL_GPU;
+bool gpuCullingSupported = false;
+
+//view projection matrix of the previous frame, the Hi-Z pyramid is built
+//from the previous frame's depth so the GPU test uses this matrix
+glm::mat4 prevVP;
+
+//visible building lists used by the CPU path
+std::vector<int> frustumVisible;
+std::vector<int> cpuVisible;
+//list of all buildings used when culling is disabled
+std::vector<int> allBuildings;
+
+//queries counting the drawn triangles, read back a frame late
+GLuint query[2];
+int currentQuery = 0;
+int totalQueriesIssued = 0;
+int totalDrawn = 0;
+
+//window size
+int winWidth = WIDTH, winHeight = HEIGHT;
+
+//time related variables
+float last_time=0, current_time=0;
+
+//mouse filtering variables
+const float MOUSE_FILTER_WEIGHT=0.75f;
+const int MOUSE_HISTORY_BUFFER_SIZE = 10;
+
+//mouse history buffer
+glm::vec2 mouseHistory[MOUSE_HISTORY_BUFFER_SIZE];
+
+float mouseX=0, mouseY=0; //filtered mouse values
+
+//flag to enable filtering
+bool useFiltering = true;
+
+//mouse move filtering function
+void filterMouseMoves(float dx, float dy) {
+    for (int i = MOUSE_HISTORY_BUFFER_SIZE - 1; i > 0; --i) {
+        mouseHistory[i] = mouseHistory[i - 1];
+    }
+
+    // Store current mouse entry at front of array.
+    mouseHistory[0] = glm::vec2(dx, dy);
+
+    float averageX = 0.0f;
+    float averageY = 0.0f;
+    float averageTotal = 0.0f;
+    float currentWeight = 1.0f;
+
+    // Filter the mouse.
+    for (int i = 0; i < MOUSE_HISTORY_BUFFER_SIZE; ++i)
+    {
+		glm::vec2 tmp=mouseHistory[i];
+        averageX += tmp.x * currentWeight;
+        averageY += tmp.y * currentWeight;
+        averageTotal += 1.0f * currentWeight;
+        currentWeight *= MOUSE_FILTER_WEIGHT;
+    }
+
+    mouseX = averageX / averageTotal;
+    mouseY = averageY / averageTotal;
+
+}
+
+//mouse click handler
+void OnMouseDown(int button, int s, int x, int y)
+{
+	if (s == GLUT_DOWN)
+	{
+		oldX = x;
+		oldY = y;
+	}
+
+	if(button == GLUT_MIDDLE_BUTTON)
+		state = 0;
+	else
+		state = 1;
+}
+
+//mouse move handler
+void OnMouseMove(int x, int y)
+{
+	if (state == 0) {
+		fov += (y - oldY)/5.0f;
+		cam.SetupProjection(fov, cam.GetAspectRatio());
+	} else {
+		rY += (y - oldY)/5.0f;
+		rX += (oldX-x)/5.0f;
+		if(useFiltering)
+			filterMouseMoves(rX, rY);
+		else {
+			mouseX = rX;
+			mouseY = rY;
+		}
+		cam.Rotate(mouseX,mouseY, 0);
+	}
+	oldX = x;
+	oldY = y;
+
+	glutPostRedisplay();
+}
+
+//comparison functor to sort buildings by distance to the camera
+struct NearerToCamera {
+	glm::vec3 eye;
+	bool operator()(int a, int b) const {
+		glm::vec3 ca = glm::vec3(buildings.minX[a]+buildings.maxX[a], buildings.minY[a]+buildings.maxY[a], buildings.minZ[a]+buildings.maxZ[a])*0.5f;
+		glm::vec3 cb = glm::vec3(buildings.minX[b]+buildings.maxX[b], buildings.minY[b]+buildings.maxY[b], buildings.minZ[b]+buildings.maxZ[b])*0.5f;
+		return glm::dot(ca-eye, ca-eye) < glm::dot(cb-eye, cb-eye);
+	}
+};
+
+//OpenGL initialization
+void OnInit() {
+
+	GL_CHECK_ERRORS
+
+	//create a grid covering the city in XZ plane
+	grid = new CGrid(int(CITY_X*BLOCK_SIZE), int(CITY_Z*BLOCK_SIZE));
+
+	//create a unit cube
+	cube = new CUnitCube();
+
+	GL_CHECK_ERRORS
+
+	//generate the city, one building with random footprint and height per block
+	srand(42);
+	for(int j=0;j<CITY_Z;j++) {
+		for(int i=0;i<CITY_X;i++) {
+			float cx = (i-CITY_X/2+0.5f)*BLOCK_SIZE;
+			float cz = (j-CITY_Z/2+0.5f)*BLOCK_SIZE;
+			float hx = BLOCK_SIZE*(0.3f + 0.15f*(rand()/float(RAND_MAX)));
+			float hz = BLOCK_SIZE*(0.3f + 0.15f*(rand()/float(RAND_MAX)));
+			float h  = 2.0f + 18.0f*(rand()/float(RAND_MAX));
+			buildings.Add(glm::vec3(cx-hx, 0, cz-hz), glm::vec3(cx+hx, h, cz+hz));
+		}
+	}
+	cityBVH.Build(buildings);
+
+	//store the boxes as min, max pairs for the shaders
+	std::vector<glm::vec4> boxData(TOTAL_BUILDINGS*2);
+	for(int i=0;i<TOTAL_BUILDINGS;i++) {
+		boxData[2*i]   = glm::vec4(buildings.minX[i], buildings.minY[i], buildings.minZ[i], 1);
+		boxData[2*i+1] = glm::vec4(buildings.maxX[i], buildings.maxY[i], buildings.maxZ[i], 1);
+	}
+
+	//the indirect command draws the cube indices once per visible building
+	DrawElementsIndirectCommand command = {GLuint(cube->GetTotalIndices()), 0, 0, 0, 0};
+
+	glGenBuffers(1, &boxBufferID);
+	glGenBuffers(1, &visibleBufferID);
+	glGenBuffers(1, &commandBufferID);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, boxBufferID);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, boxData.size()*sizeof(glm::vec4), &boxData[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBufferID);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, TOTAL_BUILDINGS*sizeof(GLuint), 0, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBufferID);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(command), &command, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	GL_CHECK_ERRORS
+
+	//load the instanced building shader
+	boxShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/instanced_box.vert");
+	boxShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/instanced_box.frag");
+	boxShader.CreateAndLinkProgram();
+	boxShader.Use();
+		boxShader.AddAttribute("vVertex");
+		boxShader.AddUniform("MVP");
+	boxShader.UnUse();
+
+	GL_CHECK_ERRORS
+
+	//setup the Hi-Z pyramid and the software depth buffer
+	gpuCullingSupported = occlusionCuller.InitGPU(WIDTH, HEIGHT);
+	if(!gpuCullingSupported) {
+		cout<<"GPU occlusion culling requires OpenGL 4.3, using the CPU path"<<endl;
+		mode = CULL_CPU;
+	}
+	occlusionCuller.InitCPU(CPU_DEPTH_WIDTH, CPU_DEPTH_HEIGHT);
+	frustumVisible.reserve(TOTAL_BUILDINGS);
+	cpuVisible.reserve(TOTAL_BUILDINGS);
+	allBuildings.resize(TOTAL_BUILDINGS);
+	for(int i=0;i<TOTAL_BUILDINGS;i++)
+		allBuildings[i] = i;
+
+	glGenQueries(2, query);
+
+	GL_CHECK_ERRORS
+
+	//place the camera at street level looking along a street
+	glm::vec3 p = glm::vec3(BLOCK_SIZE*0.5f, 3, CITY_Z*BLOCK_SIZE*0.5f);
+	cam.SetPosition(p);
+	rX = 180;
+	rY = 0;
+
+	//if filtering is enabled, save positions to mouse history buffer
+	if(useFiltering) {
+		for (int i = 0; i < MOUSE_HISTORY_BUFFER_SIZE ; ++i) {
+			mouseHistory[i] = glm::vec2(rX, rY);
+		}
+	}
+	cam.Rotate(rX,rY,0);
+	cam.SetSpeed(10);
+
+	//enable depth test
+	glEnable(GL_DEPTH_TEST);
+
+	cout<<"Initialization successfull"<<endl;
+}
+
+
+//release all allocated resources
+void OnShutdown() {
+
+	delete grid;
+	delete cube;
+
+	boxShader.DeleteShaderProgram();
+	if(gpuCullingSupported)
+		occlusionCuller.DestroyGPU();
+
+	glDeleteBuffers(1, &boxBufferID);
+	glDeleteBuffers(1, &visibleBufferID);
+	glDeleteBuffers(1, &commandBufferID);
+	glDeleteQueries(2, query);
+	cout<<"Shutdown successfull"<<endl;
+}
+
+//resize event handler
+void OnResize(int w, int h) {
+	winWidth  = w;
+	winHeight = h;
+	//set the camera projection matrix
+	cam.SetupProjection(fov, (GLfloat)w/h);
+}
+
+//idle callback function
+void OnIdle() {
+
+	//handle the WSAD, QZ key events to move the camera around
+	if( GetAsyncKeyState(VK_W) & 0x8000) {
+		cam.Walk(dt);
+	}
+
+	if( GetAsyncKeyState(VK_S) & 0x8000) {
+		cam.Walk(-dt);
+	}
+
+	if( GetAsyncKeyState(VK_A) & 0x8000) {
+		cam.Strafe(-dt);
+	}
+
+	if( GetAsyncKeyState(VK_D) & 0x8000) {
+		cam.Strafe(dt);
+	}
+
+	if( GetAsyncKeyState(VK_Q) & 0x8000) {
+		cam.Lift(dt);
+	}
+
+	if( GetAsyncKeyState(VK_Z) & 0x8000) {
+		cam.Lift(-dt);
+	}
+	glm::vec3 t = cam.GetTranslation();
+	if(glm::dot(t,t)>EPSILON2) {
+		cam.SetTranslation(t*0.95f);
+	}
+	//call the display function
+	glutPostRedisplay();
+}
+
+//fill the visible list and the indirect command on the CPU
+void UploadVisibleList(const std::vector<int>& visible) {
+	GLuint instanceCount = GLuint(visible.size());
+	if(instanceCount>0) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBufferID);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, instanceCount*sizeof(GLuint), &visible[0]);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBufferID);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, offsetof(DrawElementsIndirectCommand, instanceCount), sizeof(GLuint), &instanceCount);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+//display callback function
+void OnRender() {
+	GL_CHECK_ERRORS
+	//timing related calcualtion
+	last_time = current_time;
+	current_time = glutGet(GLUT_ELAPSED_TIME)/1000.0f;
+	dt = current_time-last_time;
+
+	//set the camera modelview and projection matrices to get the combined MVP matrix
+	glm::mat4 MV  = cam.GetViewMatrix();
+	glm::mat4 P   = cam.GetProjectionMatrix();
+	glm::mat4 MVP = P*MV;
+	if(totalQueriesIssued==0)
+		prevVP = MVP;
+
+	//find the visible buildings
+	if(mode == CULL_GPU) {
+		//frustum test with this frame's view, occlusion test against the
+		//pyramid built from last frame's depth
+		occlusionCuller.CullGPU(boxBufferID, TOTAL_BUILDINGS, MVP, prevVP, visibleBufferID, commandBufferID);
+	} else if(mode == CULL_CPU) {
+		//frustum cull with the hierarchy first
+		cam.CalcFrustumPlanes();
+		frustumCuller.SetFrustum(cam);
+		frustumVisible.clear();
+		cityBVH.Cull(frustumCuller, frustumVisible);
+
+		//rasterize the nearest buildings as occluders into the software depth buffer
+		NearerToCamera nearer;
+		nearer.eye = cam.GetPosition();
+		int totalOccluders = std::min(int(frustumVisible.size()), MAX_CPU_OCCLUDERS);
+		std::partial_sort(frustumVisible.begin(), frustumVisible.begin()+totalOccluders, frustumVisible.end(), nearer);
+		occlusionCuller.BeginCPU(MVP);
+		for(int i=0;i<totalOccluders;i++) {
+			int id = frustumVisible[i];
+			occlusionCuller.RasterizeBoxOccluder(glm::vec3(buildings.minX[id], buildings.minY[id], buildings.minZ[id]),
+												 glm::vec3(buildings.maxX[id], buildings.maxY[id], buildings.maxZ[id]));
+		}
+		occlusionCuller.BuildPyramidCPU();
+
+		cpuVisible.clear();
+		occlusionCuller.CullCPU(buildings, frustumVisible, cpuVisible);
+		UploadVisibleList(cpuVisible);
+	} else {
+		//draw everything
+		UploadVisibleList(allBuildings);
+	}
+
+	//render into the FBO whose depth becomes the next frame's pyramid
+	if(gpuCullingSupported) {
+		glBindFramebuffer(GL_FRAMEBUFFER, occlusionCuller.GetSceneFBO());
+		glViewport(0, 0, WIDTH, HEIGHT);
+	} else {
+		glViewport(0, 0, winWidth, winHeight);
+	}
+
+	//clear color buffer and depth buffer
+	glClearColor(0.6f, 0.7f, 0.9f, 1);
+	glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+
+	//render the grid object
+	grid->Render(glm::value_ptr(MVP));
+
+	//render all visible buildings with a single indirect draw
+	glBeginQuery(GL_PRIMITIVES_GENERATED, query[currentQuery]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, boxBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleBufferID);
+	boxShader.Use();
+		glUniformMatrix4fv(boxShader("MVP"), 1, GL_FALSE, glm::value_ptr(MVP));
+		cube->RenderIndirect(commandBufferID);
+	boxShader.UnUse();
+	glEndQuery(GL_PRIMITIVES_GENERATED);
+
+	if(gpuCullingSupported) {
+		//show the rendered image and build the pyramid for the next frame
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, occlusionCuller.GetSceneFBO());
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, WIDTH, HEIGHT, 0, 0, winWidth, winHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		occlusionCuller.BuildPyramidGPU();
+	}
+	prevVP = MVP;
+
+	//read the previous frame's triangle count without waiting for the GPU
+	currentQuery = 1-currentQuery;
+	GLuint available = 0;
+	if(++totalQueriesIssued > 1)
+		glGetQueryObjectuiv(query[currentQuery], GL_QUERY_RESULT_AVAILABLE, &available);
+	if(available) {
+		GLuint res;
+		glGetQueryObjectuiv(query[currentQuery], GL_QUERY_RESULT, &res);
+		totalDrawn = res/12;
+	}
+
+	//set the mesage
+	msg.str(std::string());
+	msg<<((mode==CULL_GPU)?"GPU Hi-Z culling":(mode==CULL_CPU)?"CPU Hi-Z culling":"No culling");
+	msg<<" :: Buildings drawn: "<<totalDrawn<<"/"<<TOTAL_BUILDINGS;
+	glutSetWindowTitle(msg.str().c_str());
+
+	//swap front and back buffers to show the rendered result
+	glutSwapBuffers();
+}
+
+//Keyboard event handler to cycle through the culling modes
+void OnKey(unsigned char key, int x, int y) {
+	switch(key) {
+		case '1':
+			mode = CULL_NONE;
+		break;
+		case '2':
+			if(gpuCullingSupported)
+				mode = CULL_GPU;
+		break;
+		case '3':
+			mode = CULL_CPU;
+		break;
+	}
+	glutPostRedisplay();
+}
+
+int main(int argc, char** argv) {
+	//freeglut initialization calls
+	glutInit(&argc, argv);
+	glutInitDisplayMode(GLUT_DEPTH | GLUT_DOUBLE | GLUT_RGBA);
+	glutInitContextVersion (4, 3);
+	glutInitContextFlags (GLUT_CORE_PROFILE | GLUT_DEBUG);
+	glutInitWindowSize(WIDTH, HEIGHT);
+	glutCreateWindow("Hi-Z Occlusion Culling - OpenGL 4.3");
+
+	//glew initialization
+	glewExperimental = GL_TRUE;
+	GLenum err = glewInit();
+	if (GLEW_OK != err)	{
+		cerr<<"Error: "<<glewGetErrorString(err)<<endl;
+	} else {
+		if (GLEW_VERSION_4_3)
+		{
+			cout<<"Driver supports OpenGL 4.3\nDetails:"<<endl;
+		}
+	}
+	err = glGetError(); //this is to ignore INVALID ENUM error 1282
+	GL_CHECK_ERRORS
+
+	//print information on screen
+	cout<<"\tUsing GLEW "<<glewGetString(GLEW_VERSION)<<endl;
+	cout<<"\tVendor: "<<glGetString (GL_VENDOR)<<endl;
+	cout<<"\tRenderer: "<<glGetString (GL_RENDERER)<<endl;
+	cout<<"\tVersion: "<<glGetString (GL_VERSION)<<endl;
+	cout<<"\tGLSL: "<<glGetString (GL_SHADING_LANGUAGE_VERSION)<<endl;
+
+	GL_CHECK_ERRORS
+
+	//opengl initialization
+	OnInit();
+
+	//callback hooks
+	glutCloseFunc(OnShutdown);
+	glutDisplayFunc(OnRender);
+	glutReshapeFunc(OnResize);
+	glutMouseFunc(OnMouseDown);
+	glutMotionFunc(OnMouseMove);
+	glutKeyboardFunc(OnKey);
+	glutIdleFunc(OnIdle);
+
+	//call main loop
+	glutMainLoop();
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#version 330 core
+
+//uniform
+uniform sampler2D depthTexture;	//previous pyramid level, bound as the texture base level
+
+void main()
+{
+	//size of the previous level and of the level being written
+	ivec2 prevSize = textureSize(depthTexture, 0);
+	ivec2 curSize  = max(prevSize/2, ivec2(1));
+	ivec2 p = ivec2(gl_FragCoord.xy);
+
+	//range of previous level texels overlapped by this texel. For odd sizes
+	//this is three texels wide so the border rows and columns are not lost.
+	ivec2 first = (p*prevSize)/curSize;
+	ivec2 last  = min(((p+1)*prevSize + curSize - 1)/curSize - 1, prevSize-1);
+
+	//keep the farthest depth so that the level is conservative for occlusion
+	float depth = 0.0;
+	for(int y=first.y; y<=last.y; y++)
+		for(int x=first.x; x<=last.x; x++)
+			depth = max(depth, texelFetch(depthTexture, ivec2(x,y), 0).r);
+
+	gl_FragDepth = depth;
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 430 core
+
+layout(location = 0) out vec4 vFragColor;	//fragment shader output
+
+//input from the vertex shader
+smooth in vec3 vColor;
+
+void main()
+{
+	vFragColor = vec4(vColor,1);
+}
\ No newline at end of file
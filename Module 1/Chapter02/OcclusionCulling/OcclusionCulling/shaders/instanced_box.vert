@@ -0,0 +1,34 @@
+#version 430 core
+
+layout(location = 0) in vec3 vVertex;	//unit cube vertex position in -0.5 to 0.5 range
+
+//instance bounding boxes stored as min, max pairs
+layout(std430, binding = 0) readonly buffer Boxes {
+	vec4 boxes[];
+};
+
+//ids of the visible instances written by the culling stage
+layout(std430, binding = 1) readonly buffer Visible {
+	uint visibleIDs[];
+};
+
+//uniform
+uniform mat4 MVP;	//combined modelview projection matrix
+
+//output to fragment shader
+smooth out vec3 vColor;
+
+void main()
+{
+	//get the box of this instance and stretch the unit cube over it
+	uint id = visibleIDs[gl_InstanceID];
+	vec3 bmin = boxes[2*id].xyz;
+	vec3 bmax = boxes[2*id+1].xyz;
+	vec3 pos = mix(bmin, bmax, vVertex+0.5);
+
+	//shade by height and vary the tint per building
+	float tint = fract(float(id)*0.618034);
+	vColor = mix(vec3(0.3,0.3,0.35), vec3(0.6+0.4*tint, 0.6, 0.8-0.3*tint), vVertex.y+0.5);
+
+	gl_Position = MVP*vec4(pos,1);
+}
\ No newline at end of file
@@ -60,6 +60,16 @@ glm::mat4 MV,P;
 //selected box index
 int selected_box=-1;
 
+//index of the box under the mouse
+int hovered_box=-1;
+
+//last known mouse position
+int mouse_x=0, mouse_y=0;
+
+//asynchronous colour picking
+#include "..\..\src\AsyncPicker.h"
+CAsyncPicker picker;
+
 //box positions
 glm::vec3 box_positions[3]={glm::vec3(-1,0.5,0),
 							glm::vec3(0,0.5,1),
@@ -118,24 +128,13 @@ void OnMouseDown(int button, int s, int x, int y)
 		oldX = x;
 		oldY = y;
 
-		//read pixel colour at mouse click position
-		GLubyte pixel[4];
-		glReadPixels(x, HEIGHT-y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
-
-		//based on colour decide which box was selected
-		selected_box=-1;
-		if(pixel[0]==255 && pixel[1]==0 && pixel[2]==0) {
-			cout<<"picked box 1"<<endl;
-			selected_box = 0;
-		}
-		if(pixel[0]==0 && pixel[1]==255 && pixel[2]==0) {
-			cout<<"picked box 2"<<endl;
-			selected_box = 1;
-		}
-		if(pixel[0]==0 && pixel[1]==0 && pixel[2]==255) {
-			cout<<"picked box 3"<<endl;
-			selected_box = 2;
-		}
+		//the box under the mouse is known from the colour read back in the
+		//previous frames, so clicking needs no read back of its own
+		selected_box = hovered_box;
+		if(selected_box==-1)
+			cout<<"No box picked"<<endl;
+		else
+			cout<<"picked box "<<selected_box+1<<endl;
 	}
 
 	if(button == GLUT_MIDDLE_BUTTON)
@@ -148,6 +147,8 @@ void OnMouseDown(int button, int s, int x, int y)
 //mouse move handler
 void OnMouseMove(int x, int y)
 {
+	mouse_x = x;
+	mouse_y = y;
 	if(selected_box == -1) {
 		if (state == 0) {
 			fov += (y - oldY)/5.0f;
@@ -169,6 +170,27 @@ void OnMouseMove(int x, int y)
 	glutPostRedisplay();
 }
 
+//passive mouse move handler, keeps track of the hover position
+void OnMousePassiveMove(int x, int y)
+{
+	mouse_x = x;
+	mouse_y = y;
+}
+
+//based on colour decide which box is under the mouse
+int GetBoxFromColor(const GLubyte* pixel) {
+	if(pixel[0]==255 && pixel[1]==0 && pixel[2]==0)
+		return 0;
+	if(pixel[0]==0 && pixel[1]==255 && pixel[2]==0)
+		return 1;
+	if(pixel[0]==0 && pixel[1]==0 && pixel[2]==255)
+		return 2;
+	//the selected box is drawn in cyan
+	if(pixel[0]==0 && pixel[1]==255 && pixel[2]==255)
+		return selected_box;
+	return -1;
+}
+
 //OpenGL initialization
 void OnInit() {
 	
@@ -207,6 +229,9 @@ void OnInit() {
 	//enable depth test
 	glEnable(GL_DEPTH_TEST);
 
+	//setup the pixel buffers for picking
+	picker.Init();
+
 	cout<<"Initialization successfull"<<endl;
 }
 
@@ -216,6 +241,7 @@ void OnShutdown() {
 
 	delete grid;
 	delete cube;
+	picker.Destroy();
 	cout<<"Shutdown successfull"<<endl;
 }
 
@@ -271,6 +297,11 @@ void OnRender() {
 	current_time = glutGet(GLUT_ELAPSED_TIME)/1000.0f;
 	dt = current_time-last_time;
 
+	//collect the colour of earlier pick requests that have finished
+	PickResult pick;
+	if(picker.Poll(pick))
+		hovered_box = GetBoxFromColor(pick.color);
+
 	//clear color buffer and depth buffer
 	glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 
@@ -280,6 +311,8 @@ void OnRender() {
 		msg<<"No box picked";
 	else
 		msg<<"Picked box: "<<selected_box;
+	if(hovered_box!=-1)
+		msg<<" :: Box under mouse: "<<hovered_box;
 
 	//set the window title
 	glutSetWindowTitle(msg.str().c_str());
@@ -310,6 +343,10 @@ void OnRender() {
 	cube->color = (selected_box==2)?glm::vec3(0,1,1):glm::vec3(0,0,1);
 	cube->Render(glm::value_ptr(MVP*T));
 
+	//queue the read of the colour under the mouse, it is collected once
+	//the GPU has finished this frame
+	picker.Request(mouse_x, HEIGHT-mouse_y);
+
 	//swap front and back buffers to show the rendered result
 	glutSwapBuffers();
 }
@@ -355,6 +392,7 @@ int main(int argc, char** argv) {
 	glutReshapeFunc(OnResize);
 	glutMouseFunc(OnMouseDown);
 	glutMotionFunc(OnMouseMove);
+	glutPassiveMotionFunc(OnMousePassiveMove);
 	glutIdleFunc(OnIdle);
 
 	//call main loop
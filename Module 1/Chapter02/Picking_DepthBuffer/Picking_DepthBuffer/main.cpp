@@ -59,6 +59,16 @@ glm::mat4 MV,P;
 //selected box index
 int selected_box=-1;
 
+//index of the box under the mouse
+int hovered_box=-1;
+
+//last known mouse position
+int mouse_x=0, mouse_y=0;
+
+//asynchronous depth picking
+#include "..\..\src\AsyncPicker.h"
+CAsyncPicker picker;
+
 //box positions
 glm::vec3 box_positions[3]={glm::vec3(-1,0.5,0),
 							glm::vec3(0,0.5,1),
@@ -118,27 +128,9 @@ void OnMouseDown(int button, int s, int x, int y)
 		oldX = x;
 		oldY = y;
 
-		float winZ=0;
-		//read pixel depth at mouse click position
-		glReadPixels( x, HEIGHT-y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &winZ );
-
-		//unproject the obtained winx,winy and winz point to get the object space point
-		glm::vec3 objPt = glm::unProject(glm::vec3(x,HEIGHT-y,winZ), MV, P, glm::vec4(0,0,WIDTH, HEIGHT));
-				 
-		size_t i=0;
-		float minDist = 1000;
-		selected_box=-1;
-
-		//loop through all scene objects and determine the object clicked by looking at the 
-		//nearest distance to the object
-		for(i=0;i<3;i++) {
-			float dist = glm::distance(box_positions[i], objPt);
-
-			if( dist<1 && dist<minDist) {
-				selected_box = i;
-				minDist = dist;
-			}
-		}
+		//the box under the mouse is known from the depth read back in the
+		//previous frames, so clicking needs no read back of its own
+		selected_box = hovered_box;
 	}
 
 	if(button == GLUT_MIDDLE_BUTTON)
@@ -150,6 +142,8 @@ void OnMouseDown(int button, int s, int x, int y)
 //mouse move handler
 void OnMouseMove(int x, int y)
 {
+	mouse_x = x;
+	mouse_y = y;
 	if(selected_box == -1) {
 		if (state == 0) {
 			fov += (y - oldY)/5.0f;
@@ -172,6 +166,35 @@ void OnMouseMove(int x, int y)
 	glutPostRedisplay();
 }
 
+//passive mouse move handler, keeps track of the hover position
+void OnMousePassiveMove(int x, int y)
+{
+	mouse_x = x;
+	mouse_y = y;
+}
+
+//find the box nearest to the point under the mouse
+int GetBoxFromDepth(const PickResult& pick) {
+	//unproject the obtained winx,winy and winz point with the matrices of the
+	//frame it was read from to get the object space point
+	glm::vec3 objPt = glm::unProject(glm::vec3(pick.x, pick.y, pick.depth), glm::mat4(1), pick.VP, glm::vec4(0,0,WIDTH, HEIGHT));
+
+	int box = -1;
+	float minDist = 1000;
+
+	//loop through all scene objects and determine the object under the mouse
+	//by looking at the nearest distance to the object
+	for(int i=0;i<3;i++) {
+		float dist = glm::distance(box_positions[i], objPt);
+
+		if( dist<1 && dist<minDist) {
+			box = i;
+			minDist = dist;
+		}
+	}
+	return box;
+}
+
 //OpenGL initialization
 void OnInit() {
 
@@ -207,6 +230,9 @@ void OnInit() {
 	//enable depth testing
 	glEnable(GL_DEPTH_TEST);
 
+	//setup the pixel buffers for picking
+	picker.Init();
+
 	cout<<"Initialization successfull"<<endl;
 }
 
@@ -216,6 +242,7 @@ void OnShutdown() {
 
 	delete grid;
 	delete cube;
+	picker.Destroy();
 	cout<<"Shutdown successfull"<<endl;
 }
 
@@ -272,6 +299,11 @@ void OnRender() {
 	current_time = glutGet(GLUT_ELAPSED_TIME)/1000.0f;
 	dt = current_time-last_time;
 
+	//collect the depth of earlier pick requests that have finished
+	PickResult pick;
+	if(picker.Poll(pick))
+		hovered_box = GetBoxFromDepth(pick);
+
 	//clear colour and depth buffers
 	glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 
@@ -281,6 +313,8 @@ void OnRender() {
 		msg<<"No box picked";
 	else
 		msg<<"Picked box: "<<selected_box;
+	if(hovered_box!=-1)
+		msg<<" :: Box under mouse: "<<hovered_box;
 	
 	//set the window title
 	glutSetWindowTitle(msg.str().c_str());
@@ -311,6 +345,10 @@ void OnRender() {
 	cube->color = (selected_box==2)?glm::vec3(0,1,1):glm::vec3(0,0,1);
 	cube->Render(glm::value_ptr(MVP*T));
 
+	//queue the read of the depth under the mouse, it is collected once
+	//the GPU has finished this frame
+	picker.Request(mouse_x, HEIGHT-mouse_y, MVP);
+
 	//swap front and back buffers to show the rendered result
 	glutSwapBuffers();
 }
@@ -356,6 +394,7 @@ int main(int argc, char** argv) {
 	glutReshapeFunc(OnResize);
 	glutMouseFunc(OnMouseDown);
 	glutMotionFunc(OnMouseMove);
+	glutPassiveMotionFunc(OnMousePassiveMove);
 	glutIdleFunc(OnIdle);
 
 	//call main loop
@@ -66,6 +66,13 @@ glm::vec3 box_positions[3]={glm::vec3(-1,0.5,0),
 							};
 
 
+//triangle hierarchy of the cube mesh, shared by all boxes
+#include "..\..\src\MeshBVH.h"
+CMeshBVH cubeBVH;
+
+//triangle and barycentric coordinates of the last hit
+RayHit selected_hit;
+
 //box struct 
 struct Box { glm::vec3 min, max;}boxes[3];
 #include <limits>
@@ -161,18 +168,26 @@ void OnMouseDown(int button, int s, int x, int y)
 		selected_box = -1;
 
 		//next we loop through all scene objects and find the ray intersection with the bounding box
-		//of each object. The nearest intersected object's index is stored
+		//of each object. Only objects whose box is hit nearer than the current hit are then
+		//tested against their triangles. The ray is moved into the object space of the box so
+		//the one cube hierarchy serves all boxes. The nearest intersected object's index is stored
 		for(int i=0;i<3;i++) {
 			glm::vec2 tMinMax = intersectBox(eyeRay, boxes[i]);
-			if(tMinMax.x<tMinMax.y && tMinMax.x<tMin) {
-				selected_box=i;
-				tMin = tMinMax.x;
+			if(tMinMax.x<tMinMax.y && tMinMax.y>0 && tMinMax.x<tMin) {
+				RayHit hit;
+				if(cubeBVH.Intersect(eyeRay.origin-box_positions[i], eyeRay.direction, tMin, hit)) {
+					selected_box=i;
+					selected_hit=hit;
+					tMin = hit.t;
+				}
 			}
 		}
 		if(selected_box==-1)
 			cout<<"No box picked"<<endl;
 		else
-			cout<<"Selected box: "<<selected_box<<endl;
+			cout<<"Selected box: "<<selected_box<<" triangle: "<<selected_hit.triangle
+				<<" barycentrics: ("<<1-selected_hit.u-selected_hit.v<<", "<<selected_hit.u<<", "<<selected_hit.v<<")"
+				<<" distance: "<<selected_hit.t<<endl;
 	}
 
 	if(button == GLUT_MIDDLE_BUTTON)
@@ -243,6 +258,13 @@ void OnInit() {
 	//enable depth testing
 	glEnable(GL_DEPTH_TEST);
 
+	//build the triangle hierarchy from the cube geometry
+	std::vector<glm::vec3> vertices(cube->GetTotalVertices());
+	std::vector<GLuint> indices(cube->GetTotalIndices());
+	cube->FillVertexBuffer(&vertices[0].x);
+	cube->FillIndexBuffer(&indices[0]);
+	cubeBVH.Build(&vertices[0], int(vertices.size()), &indices[0], int(indices.size()));
+
 	//determine the scene geometry bounding boxes
 	for(int i=0;i<3;i++) {
 		boxes[i].min=box_positions[i]-0.5f;
@@ -320,7 +342,7 @@ void OnRender() {
 	if(selected_box==-1)
 		msg<<"No box picked";
 	else
-		msg<<"Picked box: "<<selected_box;
+		msg<<"Picked box: "<<selected_box<<" triangle: "<<selected_hit.triangle;
 
 	//set the window title
 	glutSetWindowTitle(msg.str().c_str());
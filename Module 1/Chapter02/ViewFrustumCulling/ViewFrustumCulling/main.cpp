@@ -56,6 +56,7 @@ int state = 0, oldX=0, oldY=0;
 float rX=-135, rY=45, fov = 45;
 
 #include "..\..\src\FreeCamera.h"
+#include "..\..\src\SceneBVH.h"
  
 //virtual key codes
 const int VK_W = 0x57;
@@ -110,8 +111,17 @@ GLuint pointVAOID, pointVBOID;
 //number of points visible
 int total_visible=0;
 
-//hardware query 
-GLuint query;
+//hardware queries, two are used in turns so that the result of the previous
+//frame's query can be read without waiting for the current frame to finish
+GLuint query[2];
+int currentQuery = 0;
+int totalQueriesIssued = 0;
+
+//CPU culling of the same points using a bounding volume hierarchy
+AABBBatch pointBoxes;
+CSceneBVH pointBVH;
+CFrustumCuller culler;
+std::vector<int> cpuVisible;
 
 //FPS related variables
 float start_time = 0;
@@ -218,8 +228,8 @@ void OnMouseMove(int x, int y)
 	glutPostRedisplay();
 }
 void OnInit() {
-	//generate hardware query
-	glGenQueries(1, &query);
+	//generate hardware queries
+	glGenQueries(2, query);
 
 	//enable polygin line drawing mode
 	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -388,6 +398,18 @@ void OnInit() {
 	//pass vertices to buffer object
 	glBufferData (GL_ARRAY_BUFFER, sizeof(pointVertices), pointVertices, GL_STATIC_DRAW);
 
+	//build the CPU culling hierarchy over the points placed the same way
+	//as the geometry shader does (0 to 1 range mapped to -5 to 5 range).
+	//The vertex shader moves the points by a sine wave in Y, so each box
+	//covers the whole -1 to 1 range of the wave.
+	pointBoxes.Clear();
+	for(int i=0;i<MAX_POINTS;i++) {
+		glm::vec3 V = glm::vec3((pointVertices[i].x*2-1)*5, pointVertices[i].y, (pointVertices[i].z*2-1)*5);
+		pointBoxes.Add(V-glm::vec3(0,1,0), V+glm::vec3(0,1,0));
+	}
+	pointBVH.Build(pointBoxes);
+	cpuVisible.reserve(MAX_POINTS);
+
 	//enable vertex attrib array for position
 	glEnableVertexAttribArray(pointShader["vVertex"]);
 	glVertexAttribPointer(pointShader["vVertex"], 3, GL_FLOAT, GL_FALSE,0,0);
@@ -414,7 +436,7 @@ void OnInit() {
 
 //delete all allocated objects
 void OnShutdown() {
-	glDeleteQueries(1, &query);
+	glDeleteQueries(2, query);
 
 	//Destroy shader
 	shader.DeleteShaderProgram();
@@ -526,8 +548,15 @@ void OnRender() {
 	glm::vec4 p[6];
 	pCurrentCam->GetFrustumPlanes(p);
 
+	//cull the points on the CPU against the same frustum planes. The boxes
+	//cover the whole wave, so this count never misses a point the geometry
+	//shader emits but may include a few it drops
+	culler.SetPlanes(p);
+	cpuVisible.clear();
+	pointBVH.Cull(culler, cpuVisible);
+
 	//begin hardware query
-	glBeginQuery(GL_PRIMITIVES_GENERATED, query);
+	glBeginQuery(GL_PRIMITIVES_GENERATED, query[currentQuery]);
 
 	//bind point shader
 	pointShader.Use();
@@ -547,10 +576,18 @@ void OnRender() {
 	//end hardware query
 	glEndQuery(GL_PRIMITIVES_GENERATED);
 
-	//check the query result to get the total number of visible points
-	GLuint res;
-	glGetQueryObjectuiv(query, GL_QUERY_RESULT, &res);
-	sprintf_s(buffer, "FPS: %3.3f :: Total visible points: %3d",fps, res);
+	//read the previous frame's query only if its result is ready, so that
+	//the CPU never waits for the GPU to finish the current frame
+	currentQuery = 1-currentQuery;
+	GLuint available = 0;
+	if(++totalQueriesIssued > 1)
+		glGetQueryObjectuiv(query[currentQuery], GL_QUERY_RESULT_AVAILABLE, &available);
+	if(available) {
+		GLuint res;
+		glGetQueryObjectuiv(query[currentQuery], GL_QUERY_RESULT, &res);
+		total_visible = res;
+	}
+	sprintf_s(buffer, "FPS: %3.3f :: Total visible points: %3d :: CPU culled visible: %3d",fps, total_visible, int(cpuVisible.size()));
 	glutSetWindowTitle(buffer);
 
 	//set the normal shader
@@ -0,0 +1,97 @@
+#include "AsyncPicker.h"
+#include <cstring>
+
+//the colour is stored first followed by the depth in each pixel buffer
+const int COLOR_OFFSET = 0;
+const int DEPTH_OFFSET = 4;
+const int PBO_SIZE = 8;
+
+CAsyncPicker::CAsyncPicker(void)
+{
+	head = 0;
+	totalPending = 0;
+	for(int i=0;i<TOTAL_SLOTS;i++) {
+		slots[i].pboID = 0;
+		slots[i].fence = 0;
+		slots[i].x = slots[i].y = 0;
+	}
+}
+
+CAsyncPicker::~CAsyncPicker(void)
+{
+}
+
+void CAsyncPicker::Init() {
+	for(int i=0;i<TOTAL_SLOTS;i++) {
+		glGenBuffers(1, &slots[i].pboID);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].pboID);
+		glBufferData(GL_PIXEL_PACK_BUFFER, PBO_SIZE, 0, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	head = 0;
+	totalPending = 0;
+}
+
+void CAsyncPicker::Destroy() {
+	for(int i=0;i<TOTAL_SLOTS;i++) {
+		if(slots[i].fence)
+			glDeleteSync(slots[i].fence);
+		slots[i].fence = 0;
+		glDeleteBuffers(1, &slots[i].pboID);
+	}
+	totalPending = 0;
+}
+
+bool CAsyncPicker::Request(const int x, const int y, const glm::mat4& VP) {
+	if(totalPending == TOTAL_SLOTS)
+		return false;
+
+	Slot& slot = slots[(head+totalPending)%TOTAL_SLOTS];
+	slot.x = x;
+	slot.y = y;
+	slot.VP = VP;
+
+	//with a pixel pack buffer bound, glReadPixels only schedules the copy
+	//and returns immediately, the pointer argument is an offset into the buffer
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pboID);
+		glReadPixels(x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)COLOR_OFFSET);
+		glReadPixels(x, y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, (GLvoid*)DEPTH_OFFSET);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	totalPending++;
+	return true;
+}
+
+bool CAsyncPicker::Poll(PickResult& result) {
+	bool found = false;
+	while(totalPending>0) {
+		Slot& slot = slots[head];
+		//zero timeout, only check whether the copy has finished. The flush
+		//makes sure the fence eventually reaches the GPU.
+		GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+
+		//the data is already in the buffer so mapping does not wait
+		GLubyte data[PBO_SIZE];
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pboID);
+			GLubyte* pBuffer = static_cast<GLubyte*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, PBO_SIZE, GL_MAP_READ_BIT));
+			memcpy(data, pBuffer, PBO_SIZE);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		result.x = slot.x;
+		result.y = slot.y;
+		result.VP = slot.VP;
+		memcpy(result.color, data+COLOR_OFFSET, 4);
+		memcpy(&result.depth, data+DEPTH_OFFSET, sizeof(float));
+		found = true;
+
+		head = (head+1)%TOTAL_SLOTS;
+		totalPending--;
+	}
+	return found;
+}
\ No newline at end of file
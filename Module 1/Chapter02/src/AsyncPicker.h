@@ -0,0 +1,54 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+//colour and depth read back for one pick request
+struct PickResult {
+	int x, y;			//window position the request was made at
+	GLubyte color[4];	//colour (object id) under the position
+	float depth;		//window space depth under the position
+	glm::mat4 VP;		//view projection matrix passed with the request, so
+						//the depth can be unprojected even if the camera moved
+};
+
+//Reads the colour and depth under a window position without stalling the
+//pipeline. Each request copies the pixel into its own pixel buffer object and
+//inserts a fence; the copy is consumed once the fence has signalled, usually
+//one or two frames later. A small ring of buffers lets a request be issued
+//every frame, e.g. for picking on mouse hover.
+class CAsyncPicker
+{
+public:
+	CAsyncPicker(void);
+	~CAsyncPicker(void);
+
+	void Init();
+	void Destroy();
+
+	//queue a read of the pixel at (x,y) (window coordinates with the origin at
+	//the bottom left) from the current read framebuffer. Call it once the frame
+	//has been rendered. Returns false if all buffers are still in flight.
+	bool Request(const int x, const int y, const glm::mat4& VP=glm::mat4(1));
+
+	//collect the finished requests without waiting. Returns true and fills
+	//result with the newest finished request if there is one.
+	bool Poll(PickResult& result);
+
+	//number of requests that have not been collected yet
+	int GetTotalPending() const { return totalPending; }
+
+private:
+	//number of requests that can be in flight at once
+	static const int TOTAL_SLOTS = 4;
+
+	struct Slot {
+		GLuint pboID;
+		GLsync fence;
+		int x, y;
+		glm::mat4 VP;
+	};
+
+	Slot slots[TOTAL_SLOTS];
+	int head;			//slot of the oldest request
+	int totalPending;
+};
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include "FrustumCuller.h"
+#include "AbstractCamera.h"
+
+#include <xmmintrin.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+void AABBBatch::Add(const glm::vec3& min, const glm::vec3& max) {
+	minX.push_back(min.x); minY.push_back(min.y); minZ.push_back(min.z);
+	maxX.push_back(max.x); maxY.push_back(max.y); maxZ.push_back(max.z);
+}
+
+void AABBBatch::Clear() {
+	minX.clear(); minY.clear(); minZ.clear();
+	maxX.clear(); maxY.clear(); maxZ.clear();
+}
+
+void SphereBatch::Add(const glm::vec3& center, const float radius) {
+	X.push_back(center.x);
+	Y.push_back(center.y);
+	Z.push_back(center.z);
+	R.push_back(radius);
+}
+
+void SphereBatch::Clear() {
+	X.clear(); Y.clear(); Z.clear(); R.clear();
+}
+
+CFrustumCuller::CFrustumCuller(void)
+{
+	for(int i=0;i<6;i++) {
+		nx[i] = 0; ny[i] = 1; nz[i] = 0; d[i] = 0;
+	}
+}
+
+CFrustumCuller::~CFrustumCuller(void)
+{
+}
+
+void CFrustumCuller::SetFrustum(CAbstractCamera& cam) {
+	glm::vec4 p[6];
+	cam.GetFrustumPlanes(p);
+	SetPlanes(p);
+}
+
+void CFrustumCuller::SetPlanes(const glm::vec4 planes[6]) {
+	for(int i=0;i<6;i++) {
+		nx[i] = planes[i].x;
+		ny[i] = planes[i].y;
+		nz[i] = planes[i].z;
+		d[i]  = planes[i].w;
+	}
+}
+
+CFrustumCuller::Result CFrustumCuller::ClassifyBox(const glm::vec3& min, const glm::vec3& max) const {
+	Result res = INSIDE;
+	for(int i=0; i < 6; i++)
+	{
+		//p is the box corner furthest along the plane normal, n the nearest
+		glm::vec3 p=min, n=max;
+		if(nx[i]>=0) { p.x = max.x; n.x = min.x; }
+		if(ny[i]>=0) { p.y = max.y; n.y = min.y; }
+		if(nz[i]>=0) { p.z = max.z; n.z = min.z; }
+
+		if( nx[i]*p.x + ny[i]*p.y + nz[i]*p.z + d[i] < 0 )
+			return OUTSIDE;
+		if( nx[i]*n.x + ny[i]*n.y + nz[i]*n.z + d[i] < 0 )
+			res = INTERSECT;
+	}
+	return res;
+}
+
+int CFrustumCuller::CullBoxes(const float* minX, const float* minY, const float* minZ,
+							  const float* maxX, const float* maxY, const float* maxZ,
+							  int count, int indexOffset, int* out) const {
+	//for each plane only the corner furthest along the normal (the p-vertex)
+	//needs testing. Since the plane is shared by the whole batch, the choice
+	//between the min and max array is made once per plane, not per box.
+	const float* px[6];
+	const float* py[6];
+	const float* pz[6];
+	for(int p=0;p<6;p++) {
+		px[p] = (nx[p]>=0)? maxX : minX;
+		py[p] = (ny[p]>=0)? maxY : minY;
+		pz[p] = (nz[p]>=0)? maxZ : minZ;
+	}
+
+	int total = 0;
+	int i = 0;
+
+#if defined(__AVX__)
+	for(; i+8 <= count; i+=8) {
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for(int p=0;p<6;p++) {
+			__m256 dist = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(nx[p]), _mm256_loadu_ps(px[p]+i)),
+							  _mm256_mul_ps(_mm256_set1_ps(ny[p]), _mm256_loadu_ps(py[p]+i))),
+				_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(nz[p]), _mm256_loadu_ps(pz[p]+i)),
+							  _mm256_set1_ps(d[p])));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+		int mask = _mm256_movemask_ps(inside);
+		for(int k=0;k<8;k++)
+			if(mask & (1<<k))
+				out[total++] = indexOffset + i + k;
+	}
+#endif
+
+	for(; i+4 <= count; i+=4) {
+		__m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+		for(int p=0;p<6;p++) {
+			__m128 dist = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(nx[p]), _mm_loadu_ps(px[p]+i)),
+						   _mm_mul_ps(_mm_set1_ps(ny[p]), _mm_loadu_ps(py[p]+i))),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(nz[p]), _mm_loadu_ps(pz[p]+i)),
+						   _mm_set1_ps(d[p])));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+		}
+		int mask = _mm_movemask_ps(inside);
+		for(int k=0;k<4;k++)
+			if(mask & (1<<k))
+				out[total++] = indexOffset + i + k;
+	}
+
+	//remaining boxes
+	for(; i < count; i++) {
+		bool visible = true;
+		for(int p=0;p<6 && visible;p++)
+			visible = (nx[p]*px[p][i] + ny[p]*py[p][i] + nz[p]*pz[p][i] + d[p]) >= 0;
+		if(visible)
+			out[total++] = indexOffset + i;
+	}
+	return total;
+}
+
+int CFrustumCuller::CullBoxes(const AABBBatch& batch, int first, int count, std::vector<int>& visible) const {
+	if(count<=0)
+		return 0;
+	size_t start = visible.size();
+	visible.resize(start+count);
+	int total = CullBoxes(&batch.minX[first], &batch.minY[first], &batch.minZ[first],
+						  &batch.maxX[first], &batch.maxY[first], &batch.maxZ[first],
+						  count, first, &visible[start]);
+	visible.resize(start+total);
+	return total;
+}
+
+int CFrustumCuller::CullSpheres(const SphereBatch& batch, int first, int count, std::vector<int>& visible) const {
+	if(count<=0)
+		return 0;
+	size_t start = visible.size();
+	visible.resize(start+count);
+	int* out = &visible[start];
+	const float* X = &batch.X[first];
+	const float* Y = &batch.Y[first];
+	const float* Z = &batch.Z[first];
+	const float* R = &batch.R[first];
+
+	int total = 0;
+	int i = 0;
+	for(; i+4 <= count; i+=4) {
+		__m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+		__m128 negR   = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(R+i));
+		for(int p=0;p<6;p++) {
+			__m128 dist = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(nx[p]), _mm_loadu_ps(X+i)),
+						   _mm_mul_ps(_mm_set1_ps(ny[p]), _mm_loadu_ps(Y+i))),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(nz[p]), _mm_loadu_ps(Z+i)),
+						   _mm_set1_ps(d[p])));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, negR));
+		}
+		int mask = _mm_movemask_ps(inside);
+		for(int k=0;k<4;k++)
+			if(mask & (1<<k))
+				out[total++] = first + i + k;
+	}
+	for(; i < count; i++) {
+		bool isVisible = true;
+		for(int p=0;p<6 && isVisible;p++)
+			isVisible = (nx[p]*X[i] + ny[p]*Y[i] + nz[p]*Z[i] + d[p]) >= -R[i];
+		if(isVisible)
+			out[total++] = first + i;
+	}
+	visible.resize(start+total);
+	return total;
+}
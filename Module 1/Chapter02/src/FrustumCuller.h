@@ -0,0 +1,58 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+class CAbstractCamera;
+
+//Structure of arrays storage for a batch of axis aligned bounding boxes.
+//Keeping each component in its own array lets the culler test 4 (SSE) or
+//8 (AVX) boxes against a plane with a handful of vector instructions.
+struct AABBBatch
+{
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+
+	void Add(const glm::vec3& min, const glm::vec3& max);
+	void Clear();
+	int Size() const { return int(minX.size()); }
+};
+
+//Structure of arrays storage for a batch of bounding spheres
+struct SphereBatch
+{
+	std::vector<float> X, Y, Z, R;
+
+	void Add(const glm::vec3& center, const float radius);
+	void Clear();
+	int Size() const { return int(X.size()); }
+};
+
+class CFrustumCuller
+{
+public:
+	enum Result {OUTSIDE, INTERSECT, INSIDE};
+
+	CFrustumCuller(void);
+	~CFrustumCuller(void);
+
+	//set the six planes from the camera (CalcFrustumPlanes must have been called)
+	void SetFrustum(CAbstractCamera& cam);
+	void SetPlanes(const glm::vec4 planes[6]);
+
+	//classify a single box, used for hierarchy nodes
+	Result ClassifyBox(const glm::vec3& min, const glm::vec3& max) const;
+
+	//test count boxes/spheres starting at first. The index of every visible
+	//primitive (offset by first) is appended to visible. Returns the number added.
+	int CullBoxes(const AABBBatch& batch, int first, int count, std::vector<int>& visible) const;
+	int CullSpheres(const SphereBatch& batch, int first, int count, std::vector<int>& visible) const;
+
+	//raw array version used by the hierarchy, out must hold count entries
+	int CullBoxes(const float* minX, const float* minY, const float* minZ,
+				  const float* maxX, const float* maxY, const float* maxZ,
+				  int count, int indexOffset, int* out) const;
+
+private:
+	//plane normal and offset components, one entry per plane
+	float nx[6], ny[6], nz[6], d[6];
+};
@@ -0,0 +1,346 @@
+#include "HiZOcclusionCuller.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+//number of compute shader threads per work group, must match hiz_cull.comp
+const int CULL_GROUP_SIZE = 64;
+
+CHiZOcclusionCuller::CHiZOcclusionCuller(void)
+{
+	depthTextureID = 0;
+	sceneFBOID = pyramidFBOID = 0;
+	colorRBOID = 0;
+	emptyVAOID = 0;
+	gpuWidth = gpuHeight = gpuLevels = 0;
+}
+
+CHiZOcclusionCuller::~CHiZOcclusionCuller(void)
+{
+}
+
+bool CHiZOcclusionCuller::InitGPU(const int width, const int height) {
+	if(!GLEW_VERSION_4_3)
+		return false;
+
+	gpuWidth  = width;
+	gpuHeight = height;
+	gpuLevels = 1;
+	for(int s=std::max(width,height); s>1; s/=2)
+		gpuLevels++;
+
+	//depth texture with the full mip chain, each level is written by the
+	//downsample shader so only nearest filtering is used
+	glGenTextures(1, &depthTextureID);
+	glBindTexture(GL_TEXTURE_2D, depthTextureID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, gpuLevels-1);
+	glTexStorage2D(GL_TEXTURE_2D, gpuLevels, GL_DEPTH_COMPONENT32F, width, height);
+
+	//scene FBO: colour renderbuffer plus level 0 of the pyramid as depth
+	glGenRenderbuffers(1, &colorRBOID);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorRBOID);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenFramebuffers(1, &sceneFBOID);
+	glBindFramebuffer(GL_FRAMEBUFFER, sceneFBOID);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBOID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTextureID, 0);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+	//clear the depth to the far plane so the first frame culls nothing
+	glClearDepth(1.0f);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	//FBO used to write the coarser levels, it has no colour attachment
+	glGenFramebuffers(1, &pyramidFBOID);
+	glBindFramebuffer(GL_FRAMEBUFFER, pyramidFBOID);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	for(int i=1;i<gpuLevels;i++) {
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTextureID, i);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if(status != GL_FRAMEBUFFER_COMPLETE)
+		return false;
+
+	//the fullscreen triangle is generated from gl_VertexID, but a core
+	//profile still requires a vertex array object to be bound
+	glGenVertexArrays(1, &emptyVAOID);
+
+	downsampleShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/hiz_downsample.vert");
+	downsampleShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/hiz_downsample.frag");
+	downsampleShader.CreateAndLinkProgram();
+	downsampleShader.Use();
+		downsampleShader.AddUniform("depthTexture");
+		glUniform1i(downsampleShader("depthTexture"), 0);
+	downsampleShader.UnUse();
+
+	cullShader.LoadFromFile(GL_COMPUTE_SHADER, "shaders/hiz_cull.comp");
+	cullShader.CreateAndLinkProgram();
+	cullShader.Use();
+		cullShader.AddUniform("VP");
+		cullShader.AddUniform("prevVP");
+		cullShader.AddUniform("totalBoxes");
+		cullShader.AddUniform("totalLevels");
+		cullShader.AddUniform("hiZ");
+		glUniform1i(cullShader("hiZ"), 0);
+	cullShader.UnUse();
+
+	return true;
+}
+
+void CHiZOcclusionCuller::DestroyGPU() {
+	downsampleShader.DeleteShaderProgram();
+	cullShader.DeleteShaderProgram();
+	glDeleteFramebuffers(1, &sceneFBOID);
+	glDeleteFramebuffers(1, &pyramidFBOID);
+	glDeleteRenderbuffers(1, &colorRBOID);
+	glDeleteTextures(1, &depthTextureID);
+	glDeleteVertexArrays(1, &emptyVAOID);
+}
+
+void CHiZOcclusionCuller::BuildPyramidGPU() {
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, pyramidFBOID);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, depthTextureID);
+	//the depth test must pass always so that the farthest depth is written
+	glDepthFunc(GL_ALWAYS);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	downsampleShader.Use();
+	glBindVertexArray(emptyVAOID);
+	int w = gpuWidth, h = gpuHeight;
+	for(int i=1;i<gpuLevels;i++) {
+		w = std::max(1, w/2);
+		h = std::max(1, h/2);
+		//restrict sampling to the previous level so that reading and
+		//writing never touch the same level
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, i-1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, i-1);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTextureID, i);
+		glViewport(0, 0, w, h);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+	glBindVertexArray(0);
+	downsampleShader.UnUse();
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, gpuLevels-1);
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthFunc(GL_LESS);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void CHiZOcclusionCuller::CullGPU(GLuint boxBuffer, const int count, const glm::mat4& VP, const glm::mat4& prevVP,
+								  GLuint visibleBuffer, GLuint commandBuffer) {
+	//reset the instance count, the shader increments it for each visible box
+	GLuint zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, offsetof(DrawElementsIndirectCommand, instanceCount), sizeof(GLuint), &zero);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, boxBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, depthTextureID);
+
+	cullShader.Use();
+		glUniformMatrix4fv(cullShader("VP"), 1, GL_FALSE, glm::value_ptr(VP));
+		glUniformMatrix4fv(cullShader("prevVP"), 1, GL_FALSE, glm::value_ptr(prevVP));
+		glUniform1i(cullShader("totalBoxes"), count);
+		glUniform1i(cullShader("totalLevels"), gpuLevels);
+		glDispatchCompute((count+CULL_GROUP_SIZE-1)/CULL_GROUP_SIZE, 1, 1);
+	cullShader.UnUse();
+
+	//the results are consumed as draw command and instance data
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void CHiZOcclusionCuller::InitCPU(const int width, const int height) {
+	//each level is half the size of the previous one rounded up, so that
+	//texel p of level 0 maps to texel (p>>i) of level i
+	levels.clear();
+	int w = width, h = height, offset = 0;
+	while(true) {
+		Level l = {w, h, offset};
+		levels.push_back(l);
+		offset += w*h;
+		if(w==1 && h==1)
+			break;
+		w = (w+1)/2;
+		h = (h+1)/2;
+	}
+	pyramid.resize(offset);
+}
+
+void CHiZOcclusionCuller::BeginCPU(const glm::mat4& VP) {
+	cpuVP = VP;
+	std::fill(pyramid.begin(), pyramid.begin()+levels[0].width*levels[0].height, 1.0f);
+}
+
+void CHiZOcclusionCuller::RasterizeTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+	//triangles crossing the near plane are skipped, not drawing an occluder
+	//only makes culling less effective, never incorrect
+	if(a.z < -a.w || b.z < -b.w || c.z < -c.w)
+		return;
+
+	const int W = levels[0].width;
+	const int H = levels[0].height;
+	float* depth = &pyramid[0];
+
+	//to window space
+	glm::vec3 v[3];
+	const glm::vec4* clip[3] = {&a, &b, &c};
+	for(int i=0;i<3;i++) {
+		glm::vec3 ndc = glm::vec3(*clip[i])/clip[i]->w;
+		v[i] = glm::vec3((ndc.x*0.5f+0.5f)*W, (ndc.y*0.5f+0.5f)*H, ndc.z*0.5f+0.5f);
+	}
+
+	float area = (v[1].x-v[0].x)*(v[2].y-v[0].y) - (v[2].x-v[0].x)*(v[1].y-v[0].y);
+	if(fabs(area) < 1e-8f)
+		return;
+	//accept both windings
+	if(area < 0) {
+		std::swap(v[1], v[2]);
+		area = -area;
+	}
+
+	int x0 = std::max(0,   int(floor(std::min(v[0].x, std::min(v[1].x, v[2].x)))));
+	int x1 = std::min(W-1, int(ceil (std::max(v[0].x, std::max(v[1].x, v[2].x)))));
+	int y0 = std::max(0,   int(floor(std::min(v[0].y, std::min(v[1].y, v[2].y)))));
+	int y1 = std::min(H-1, int(ceil (std::max(v[0].y, std::max(v[1].y, v[2].y)))));
+
+	float invArea = 1.0f/area;
+	for(int y=y0;y<=y1;y++) {
+		float py = y+0.5f;
+		for(int x=x0;x<=x1;x++) {
+			float px = x+0.5f;
+			//edge functions give the barycentric weights of the pixel centre
+			float w0 = (v[2].x-v[1].x)*(py-v[1].y) - (v[2].y-v[1].y)*(px-v[1].x);
+			float w1 = (v[0].x-v[2].x)*(py-v[2].y) - (v[0].y-v[2].y)*(px-v[2].x);
+			float w2 = (v[1].x-v[0].x)*(py-v[0].y) - (v[1].y-v[0].y)*(px-v[0].x);
+			if(w0<0 || w1<0 || w2<0)
+				continue;
+			float z = (w0*v[0].z + w1*v[1].z + w2*v[2].z)*invArea;
+			float& d = depth[y*W+x];
+			if(z < d)
+				d = z;
+		}
+	}
+}
+
+void CHiZOcclusionCuller::RasterizeOccluder(const glm::vec3* vertices, const GLuint* indices, const int totalIndices, const glm::mat4& M) {
+	glm::mat4 MVP = cpuVP*M;
+	for(int i=0;i+2<totalIndices;i+=3) {
+		RasterizeTriangle(MVP*glm::vec4(vertices[indices[i]],1),
+						  MVP*glm::vec4(vertices[indices[i+1]],1),
+						  MVP*glm::vec4(vertices[indices[i+2]],1));
+	}
+}
+
+void CHiZOcclusionCuller::RasterizeBoxOccluder(const glm::vec3& min, const glm::vec3& max) {
+	//same corner numbering and faces as CUnitCube
+	static const GLuint boxIndices[36] = { 0,5,4, 5,0,1, 3,7,6, 3,6,2,
+										   7,4,6, 6,4,5, 2,1,3, 3,1,0,
+										   3,0,7, 7,0,4, 6,5,2, 2,5,1 };
+	glm::vec3 corners[8] = { glm::vec3(min.x,min.y,min.z), glm::vec3(max.x,min.y,min.z),
+							 glm::vec3(max.x,max.y,min.z), glm::vec3(min.x,max.y,min.z),
+							 glm::vec3(min.x,min.y,max.z), glm::vec3(max.x,min.y,max.z),
+							 glm::vec3(max.x,max.y,max.z), glm::vec3(min.x,max.y,max.z) };
+	RasterizeOccluder(corners, boxIndices, 36, glm::mat4(1));
+}
+
+void CHiZOcclusionCuller::BuildPyramidCPU() {
+	for(size_t i=1;i<levels.size();i++) {
+		const Level& src = levels[i-1];
+		const Level& dst = levels[i];
+		const float* in = &pyramid[src.offset];
+		float* out = &pyramid[dst.offset];
+		for(int y=0;y<dst.height;y++) {
+			int sy0 = 2*y;
+			int sy1 = std::min(2*y+1, src.height-1);
+			for(int x=0;x<dst.width;x++) {
+				int sx0 = 2*x;
+				int sx1 = std::min(2*x+1, src.width-1);
+				out[y*dst.width+x] = std::max(std::max(in[sy0*src.width+sx0], in[sy0*src.width+sx1]),
+											  std::max(in[sy1*src.width+sx0], in[sy1*src.width+sx1]));
+			}
+		}
+	}
+}
+
+bool CHiZOcclusionCuller::IsBoxVisibleCPU(const glm::vec3& min, const glm::vec3& max) const {
+	//project the corners to get the screen rectangle and the nearest depth
+	glm::vec3 smin(1e30f), smax(-1e30f);
+	int behind = 0;
+	for(int i=0;i<8;i++) {
+		glm::vec4 p = cpuVP*glm::vec4((i&1)?max.x:min.x, (i&2)?max.y:min.y, (i&4)?max.z:min.z, 1);
+		if(p.w <= 0.0001f) {
+			behind++;
+			continue;
+		}
+		glm::vec3 ndc = glm::vec3(p)/p.w;
+		smin = glm::min(smin, ndc);
+		smax = glm::max(smax, ndc);
+	}
+	//completely behind the viewer
+	if(behind == 8)
+		return false;
+	//the box crosses the eye plane, its projection is unbounded
+	if(behind > 0)
+		return true;
+
+	//outside the view frustum
+	if(smax.x < -1 || smin.x > 1 || smax.y < -1 || smin.y > 1 || smin.z > 1)
+		return false;
+
+	const int W = levels[0].width;
+	const int H = levels[0].height;
+	int x0 = glm::clamp(int((smin.x*0.5f+0.5f)*W), 0, W-1);
+	int x1 = glm::clamp(int((smax.x*0.5f+0.5f)*W), 0, W-1);
+	int y0 = glm::clamp(int((smin.y*0.5f+0.5f)*H), 0, H-1);
+	int y1 = glm::clamp(int((smax.y*0.5f+0.5f)*H), 0, H-1);
+
+	//pick the level where the rectangle spans at most two texels per axis
+	int size = std::max(x1-x0, y1-y0);
+	int level = 0;
+	while(size > 1 && level < int(levels.size())-1) {
+		size >>= 1;
+		level++;
+	}
+	const Level& l = levels[level];
+	const float* depth = &pyramid[l.offset];
+	float farthest = 0;
+	for(int y=(y0>>level); y<=(y1>>level); y++)
+		for(int x=(x0>>level); x<=(x1>>level); x++)
+			farthest = std::max(farthest, depth[y*l.width+x]);
+
+	float nearest = smin.z*0.5f+0.5f;
+	return nearest <= farthest;
+}
+
+int CHiZOcclusionCuller::CullCPU(const AABBBatch& boxes, const std::vector<int>& candidates, std::vector<int>& visible) const {
+	size_t start = visible.size();
+	for(size_t i=0;i<candidates.size();i++) {
+		int id = candidates[i];
+		if(IsBoxVisibleCPU(glm::vec3(boxes.minX[id], boxes.minY[id], boxes.minZ[id]),
+						   glm::vec3(boxes.maxX[id], boxes.maxY[id], boxes.maxZ[id])))
+			visible.push_back(id);
+	}
+	return int(visible.size()-start);
+}
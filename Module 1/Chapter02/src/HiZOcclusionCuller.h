@@ -0,0 +1,87 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "GLSLShader.h"
+#include "FrustumCuller.h"
+
+//layout of one command in a GL_DRAW_INDIRECT_BUFFER for glDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+//Occlusion culling against a hierarchical Z (Hi-Z) pyramid. Every level of
+//the pyramid stores the farthest depth of the 2x2 texels below it, so a box
+//can be rejected with a few texel reads by comparing its nearest depth with
+//the level where its screen footprint covers about two texels.
+//
+//The GPU path builds the pyramid from the previous frame's depth texture with
+//a fragment shader and tests the instance boxes in a compute shader (OpenGL
+//4.3) that appends the visible instance ids and bumps the instanceCount of an
+//indirect draw command, so no result ever comes back to the CPU.
+//The CPU path rasterizes occluder triangles into a small software depth
+//buffer and runs the same test, which allows using it without a GPU.
+class CHiZOcclusionCuller
+{
+public:
+	CHiZOcclusionCuller(void);
+	~CHiZOcclusionCuller(void);
+
+	//GPU path
+	//create the depth texture with a full mip chain and load the shaders
+	bool InitGPU(const int width, const int height);
+	void DestroyGPU();
+	//framebuffer whose depth attachment is level 0 of the pyramid. The scene is
+	//rendered into it so that the next frame can cull against its depth.
+	GLuint GetSceneFBO() const { return sceneFBOID; }
+	GLuint GetDepthTexture() const { return depthTextureID; }
+	//downsample level 0 into the coarser levels
+	void BuildPyramidGPU();
+	//test count boxes stored in boxBuffer (a shader storage buffer holding
+	//min, max pairs as vec4) against the view frustum of VP and against the
+	//pyramid built with prevVP, the view projection matrix of the previous
+	//frame. The visible ids are written to visibleBuffer and the instance
+	//count of the command at commandBuffer is set accordingly.
+	void CullGPU(GLuint boxBuffer, const int count, const glm::mat4& VP, const glm::mat4& prevVP,
+				 GLuint visibleBuffer, GLuint commandBuffer);
+
+	//CPU path
+	void InitCPU(const int width, const int height);
+	//clear the software depth buffer to the far plane and set the matrix used
+	//for both rasterizing occluders and testing boxes
+	void BeginCPU(const glm::mat4& VP);
+	void RasterizeOccluder(const glm::vec3* vertices, const GLuint* indices, const int totalIndices, const glm::mat4& M);
+	void RasterizeBoxOccluder(const glm::vec3& min, const glm::vec3& max);
+	void BuildPyramidCPU();
+	bool IsBoxVisibleCPU(const glm::vec3& min, const glm::vec3& max) const;
+	//append the visible ids of the given boxes and return how many were added
+	int CullCPU(const AABBBatch& boxes, const std::vector<int>& candidates, std::vector<int>& visible) const;
+
+	int GetTotalLevels() const { return int(levels.size()); }
+
+private:
+	//per level size and offset into the CPU pyramid storage
+	struct Level {
+		int width, height, offset;
+	};
+
+	void RasterizeTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+
+	//GPU resources
+	GLuint depthTextureID;
+	GLuint sceneFBOID, pyramidFBOID;
+	GLuint colorRBOID;
+	GLuint emptyVAOID;
+	GLSLShader downsampleShader;
+	GLSLShader cullShader;
+	int gpuWidth, gpuHeight, gpuLevels;
+
+	//CPU resources
+	std::vector<Level> levels;
+	std::vector<float> pyramid;
+	glm::mat4 cpuVP;
+};
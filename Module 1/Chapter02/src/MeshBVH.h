@@ -0,0 +1,54 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+//result of a ray mesh intersection
+struct RayHit {
+	int triangle;		//index of the hit triangle, -1 if nothing was hit
+	float t;			//distance along the ray
+	float u, v;			//barycentric coordinates of the hit point, the weight
+						//of the first vertex is 1-u-v
+};
+
+//Bounding volume hierarchy over the triangles of one mesh, used to find the
+//exact triangle under the mouse. Rays are given in the object space of the
+//mesh so the same hierarchy is shared by all instances of the mesh.
+class CMeshBVH
+{
+public:
+	CMeshBVH(void);
+	~CMeshBVH(void);
+
+	void Build(const glm::vec3* vertices, const int totalVertices, const GLuint* indices, const int totalIndices);
+
+	//find the nearest hit with t in (0, tMax). Returns false if there is none.
+	bool Intersect(const glm::vec3& origin, const glm::vec3& direction, const float tMax, RayHit& hit) const;
+
+	const glm::vec3& GetMin() const { return nodes[0].min; }
+	const glm::vec3& GetMax() const { return nodes[0].max; }
+
+	int GetTotalTriangles() const { return int(triangles.size()); }
+
+private:
+	struct Node {
+		glm::vec3 min, max;
+		int first;		//first triangle in the triangle list
+		int count;		//number of triangles, 0 for interior nodes
+		int right;		//right child, left child always follows the node
+	};
+
+	struct Triangle {
+		glm::vec3 v0, e1, e2;	//first vertex and the two edges from it
+		float normalLength;		//length of cross(e1, e2), twice the area
+		int id;					//index of the triangle in the source mesh
+	};
+
+	int BuildRecursive(int first, int count);
+
+	std::vector<Node> nodes;
+	std::vector<Triangle> triangles;
+	//scratch used while building
+	std::vector<glm::vec3> centers, tmin, tmax;
+	std::vector<int> order;
+};
\ No newline at end of file
@@ -65,4 +65,12 @@ void RenderableObject::Render(const GLfloat* MVP) {
 			glDrawElements(primType, totalIndices, GL_UNSIGNED_INT, 0);
 		glBindVertexArray(0);
 	shader.UnUse();
+}
+
+void RenderableObject::RenderIndirect(GLuint commandBuffer) {
+	glBindVertexArray(vaoID);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+			glDrawElementsIndirect(primType, GL_UNSIGNED_INT, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
 }
\ No newline at end of file
@@ -7,6 +7,9 @@ public:
 	RenderableObject(void);
 	virtual ~RenderableObject(void);
 	void Render(const float* MVP);
+	//draw the geometry with the currently bound shader, taking the draw
+	//parameters (like a GPU generated instance count) from an indirect buffer
+	void RenderIndirect(GLuint commandBuffer);
 	
 	virtual int GetTotalVertices()=0;
 	virtual int GetTotalIndices()=0;
@@ -0,0 +1,165 @@
+#include "SceneBVH.h"
+#include <algorithm>
+
+//comparison functor used to split objects at the median centre along an axis
+struct CenterLess {
+	const std::vector<glm::vec3>* centers;
+	int axis;
+	bool operator()(int a, int b) const {
+		return (*centers)[a][axis] < (*centers)[b][axis];
+	}
+};
+
+CSceneBVH::CSceneBVH(void)
+{
+	source = 0;
+}
+
+CSceneBVH::~CSceneBVH(void)
+{
+}
+
+void CSceneBVH::CopyObject(const AABBBatch& src, int from, int to) {
+	boxes.minX[to] = src.minX[from];
+	boxes.minY[to] = src.minY[from];
+	boxes.minZ[to] = src.minZ[from];
+	boxes.maxX[to] = src.maxX[from];
+	boxes.maxY[to] = src.maxY[from];
+	boxes.maxZ[to] = src.maxZ[from];
+}
+
+void CSceneBVH::Build(const AABBBatch& objects, const int maxLeafSize) {
+	const int total = objects.Size();
+	nodes.clear();
+	objectIDs.resize(total);
+	centers.resize(total);
+	for(int i=0;i<total;i++) {
+		objectIDs[i] = i;
+		centers[i] = glm::vec3(objects.minX[i]+objects.maxX[i],
+							   objects.minY[i]+objects.maxY[i],
+							   objects.minZ[i]+objects.maxZ[i])*0.5f;
+	}
+
+	if(total==0)
+		return;
+
+	source = &objects;
+	nodes.reserve(2*(total/std::max(maxLeafSize,1)+1));
+	BuildRecursive(0, total, std::max(maxLeafSize,1));
+	source = 0;
+
+	//store the boxes in leaf order so each leaf is one contiguous SIMD batch
+	boxes.minX.resize(total); boxes.minY.resize(total); boxes.minZ.resize(total);
+	boxes.maxX.resize(total); boxes.maxY.resize(total); boxes.maxZ.resize(total);
+	for(int i=0;i<total;i++)
+		CopyObject(objects, objectIDs[i], i);
+
+	std::vector<glm::vec3>().swap(centers);
+}
+
+int CSceneBVH::BuildRecursive(int first, int count, const int maxLeafSize) {
+	int index = int(nodes.size());
+	nodes.push_back(Node());
+
+	//get the bounds of the objects and of their centres
+	glm::vec3 bmin(source->minX[objectIDs[first]], source->minY[objectIDs[first]], source->minZ[objectIDs[first]]);
+	glm::vec3 bmax(source->maxX[objectIDs[first]], source->maxY[objectIDs[first]], source->maxZ[objectIDs[first]]);
+	glm::vec3 cmin = centers[objectIDs[first]];
+	glm::vec3 cmax = cmin;
+	for(int i=first+1;i<first+count;i++) {
+		int id = objectIDs[i];
+		bmin = glm::min(bmin, glm::vec3(source->minX[id], source->minY[id], source->minZ[id]));
+		bmax = glm::max(bmax, glm::vec3(source->maxX[id], source->maxY[id], source->maxZ[id]));
+		cmin = glm::min(cmin, centers[id]);
+		cmax = glm::max(cmax, centers[id]);
+	}
+	nodes[index].min   = bmin;
+	nodes[index].max   = bmax;
+	nodes[index].first = first;
+	nodes[index].count = count;
+	nodes[index].right = -1;
+
+	glm::vec3 extent = cmax-cmin;
+	if(count <= maxLeafSize || glm::max(extent.x, glm::max(extent.y, extent.z)) <= 0)
+		return index;
+
+	//split at the median of the longest centre axis
+	CenterLess cmp;
+	cmp.centers = &centers;
+	cmp.axis = (extent.x > extent.y && extent.x > extent.z)? 0 : (extent.y > extent.z)? 1 : 2;
+	int half = count/2;
+	std::nth_element(objectIDs.begin()+first, objectIDs.begin()+first+half, objectIDs.begin()+first+count, cmp);
+
+	nodes[index].count = 0;
+	BuildRecursive(first, half, maxLeafSize);
+	int right = BuildRecursive(first+half, count-half, maxLeafSize);
+	nodes[index].right = right;
+	return index;
+}
+
+void CSceneBVH::Refit(const AABBBatch& objects) {
+	//children are always stored after their parent, so walking the node
+	//array backwards visits every child before the node that contains it
+	for(int i=int(nodes.size())-1;i>=0;i--) {
+		Node& node = nodes[i];
+		if(node.count>0) {
+			for(int j=node.first;j<node.first+node.count;j++)
+				CopyObject(objects, objectIDs[j], j);
+			node.min = glm::vec3(boxes.minX[node.first], boxes.minY[node.first], boxes.minZ[node.first]);
+			node.max = glm::vec3(boxes.maxX[node.first], boxes.maxY[node.first], boxes.maxZ[node.first]);
+			for(int j=node.first+1;j<node.first+node.count;j++) {
+				node.min = glm::min(node.min, glm::vec3(boxes.minX[j], boxes.minY[j], boxes.minZ[j]));
+				node.max = glm::max(node.max, glm::vec3(boxes.maxX[j], boxes.maxY[j], boxes.maxZ[j]));
+			}
+		} else {
+			const Node& left  = nodes[i+1];
+			const Node& right = nodes[node.right];
+			node.min = glm::min(left.min, right.min);
+			node.max = glm::max(left.max, right.max);
+		}
+	}
+}
+
+int CSceneBVH::Cull(const CFrustumCuller& culler, std::vector<int>& visible) const {
+	if(nodes.empty())
+		return 0;
+
+	size_t start = visible.size();
+	//the tree is median split so its depth is logarithmic in the object count
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+
+	while(top>0) {
+		const int index = stack[--top];
+		const Node& node = nodes[index];
+		CFrustumCuller::Result res = culler.ClassifyBox(node.min, node.max);
+		if(res == CFrustumCuller::OUTSIDE)
+			continue;
+
+		if(res == CFrustumCuller::INSIDE) {
+			//accept the whole subtree, its objects are stored contiguously
+			//so find the object range covered by it
+			int first = node.first;
+			const Node* last = &node;
+			while(last->count==0)
+				last = &nodes[last->right];
+			int end = last->first + last->count;
+			visible.insert(visible.end(), objectIDs.begin()+first, objectIDs.begin()+end);
+		} else if(node.count>0) {
+			size_t offset = visible.size();
+			visible.resize(offset+node.count);
+			int n = culler.CullBoxes(&boxes.minX[node.first], &boxes.minY[node.first], &boxes.minZ[node.first],
+									 &boxes.maxX[node.first], &boxes.maxY[node.first], &boxes.maxZ[node.first],
+									 node.count, node.first, &visible[offset]);
+			//convert leaf order positions back to object indices
+			for(int i=0;i<n;i++)
+				visible[offset+i] = objectIDs[visible[offset+i]];
+			visible.resize(offset+n);
+		} else {
+			stack[top++] = node.right;
+			stack[top++] = index+1;
+		}
+	}
+	return int(visible.size()-start);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "FrustumCuller.h"
+
+//Bounding volume hierarchy over the bounding boxes of scene objects. The
+//tree is walked top down against the view frustum: nodes completely inside
+//accept their whole subtree without further tests, nodes outside reject it
+//and only the leaves straddling a plane are tested with the SIMD batch culler.
+class CSceneBVH
+{
+public:
+	CSceneBVH(void);
+	~CSceneBVH(void);
+
+	//build the hierarchy from the object bounding boxes. Object i of the
+	//batch is reported with index i by Cull.
+	void Build(const AABBBatch& objects, const int maxLeafSize=32);
+
+	//update the node bounds after objects moved, keeping the tree topology
+	void Refit(const AABBBatch& objects);
+
+	//append the indices of all objects visible to the culler's frustum.
+	//Returns the number of visible objects. Cull is const so the same tree
+	//can be used for several cameras.
+	int Cull(const CFrustumCuller& culler, std::vector<int>& visible) const;
+
+	int GetTotalNodes() const { return int(nodes.size()); }
+
+private:
+	struct Node {
+		glm::vec3 min, max;
+		int first;		//first object in the reordered arrays
+		int count;		//number of objects, 0 for interior nodes
+		int right;		//right child, left child always follows the node
+	};
+
+	int BuildRecursive(int first, int count, const int maxLeafSize);
+	void CopyObject(const AABBBatch& src, int from, int to);
+
+	std::vector<Node> nodes;
+	//object boxes reordered so that every leaf covers a contiguous range
+	AABBBatch boxes;
+	std::vector<int> objectIDs;
+	//scratch used while building
+	std::vector<glm::vec3> centers;
+	const AABBBatch* source;
+};
@@ -1,6 +1,7 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 #include <iostream>
+#include <sstream>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -9,6 +10,7 @@
 #include <SOIL.h>
 
 #include "..\\..\\src\GLSLShader.h"
+#include "..\\..\\src\ImageFilter.h"
 
 #define GL_CHECK_ERRORS assert(glGetError()== GL_NO_ERROR);
 
@@ -21,10 +23,15 @@ using namespace std;
 const int WIDTH  = 512;
 const int HEIGHT = 512;
 
-//shader for rendering of image and convolution
+//shader for rendering of image
 GLSLShader shader;
-GLSLShader convolution_shader;
-GLSLShader* current_shader;
+
+//convolution filter and the texture holding its result
+CImageFilter filter;
+GLuint filteredTextureID;
+
+//show the filtered or the normal image
+bool showFiltered = false;
 
 //vertex array and vertex buffer object IDs
 GLuint vaoID;
@@ -41,6 +48,65 @@ GLushort indices[6];
 //texture image filename
 const string filename = "media/Lenna.png";
 
+//available kernels
+const int TOTAL_KERNELS = 8;
+const char* kernelNames[TOTAL_KERNELS] = {"3x3 sharpening", "3x3 unweighted smoothing", "3x3 Gaussian smoothing",
+	"3x3 emboss (NW)", "31x31 Gaussian", "31x31 box", "31x31 disc", "21x21 difference of Gaussians"};
+int currentKernel = 0;
+
+//creates the given kernel
+CConvolutionKernel CreateKernel(int index) {
+	const float sharpen[9]	= {-1,-1,-1, -1,8,-1, -1,-1,-1};
+	const float smooth[9]	= {1,1,1, 1,1,1, 1,1,1};
+	const float gaussian[9] = {0,1,0, 1,5,1, 0,1,0};
+	const float emboss[9]	= {-4,-4,0, -4,12,0, 0,0,0};
+	float w[9];
+	switch(index) {
+		case 0: return CConvolutionKernel::Enhance3x3(sharpen);
+		case 1: for(int i=0;i<9;i++) w[i] = smooth[i]/9.0f;
+				return CConvolutionKernel(w, 3, 3);
+		case 2: for(int i=0;i<9;i++) w[i] = gaussian[i]/9.0f;
+				return CConvolutionKernel(w, 3, 3);
+		case 3: return CConvolutionKernel::Enhance3x3(emboss);
+		case 4: return CConvolutionKernel::Gaussian(15, 5.0f);
+		case 5: return CConvolutionKernel::Box(15);
+		case 6: return CConvolutionKernel::Disc(15);
+		default: {
+			//not separable but of rank two
+			CConvolutionKernel narrow = CConvolutionKernel::Gaussian(10, 2.0f);
+			CConvolutionKernel wide = CConvolutionKernel::Gaussian(10, 6.0f);
+			float dog[21*21];
+			for(int i=0;i<21*21;i++)
+				dog[i] = 2*narrow.GetWeights()[i] - wide.GetWeights()[i];
+			return CConvolutionKernel(dog, 21, 21);
+		}
+	}
+}
+
+//filters the image with the current kernel and shows the method in the title
+void ApplyKernel() {
+	filter.SetKernel(CreateKernel(currentKernel));
+
+	//the image does not change so it is filtered only when the kernel changes
+	glFinish();
+	int start = glutGet(GLUT_ELAPSED_TIME);
+	filteredTextureID = filter.Apply(textureID);
+	glFinish();
+	int elapsed = glutGet(GLUT_ELAPSED_TIME)-start;
+
+	//restore the window viewport
+	glViewport(0, 0, glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
+
+	const char* methods[3] = {"direct", "separable", "FFT"};
+	stringstream msg;
+	msg<<(showFiltered? "Filtered image" : "Normal image")<<" :: "<<kernelNames[currentKernel]<<" :: "
+	   <<methods[filter.GetMethod()];
+	if(filter.GetMethod() == CConvolutionKernel::SEPARABLE)
+		msg<<" (rank "<<filter.GetKernel().GetRank()<<")";
+	msg<<" :: "<<elapsed<<" ms";
+	glutSetWindowTitle(msg.str().c_str());
+}
+
 void OnInit() {
 	GL_CHECK_ERRORS
 	//load shader
@@ -56,23 +122,6 @@ void OnInit() {
 		glUniform1i(shader("textureMap"), 0);
 	shader.UnUse();
 
-	current_shader = &shader;
-
-	GL_CHECK_ERRORS
-
-	//load shader
-	convolution_shader.LoadFromFile(GL_VERTEX_SHADER, "shaders/shader.vert");
-	convolution_shader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/shader_convolution.frag");
-	//compile and link shader
-	convolution_shader.CreateAndLinkProgram();
-	convolution_shader.Use();
-		//add attributes and uniforms
-		convolution_shader.AddAttribute("vVertex");
-		convolution_shader.AddUniform("textureMap");
-		//pass values of constant uniforms at initialization
-		glUniform1i(convolution_shader("textureMap"), 0);
-	convolution_shader.UnUse();
-
 	GL_CHECK_ERRORS
 
 	//setup quad geometry
@@ -151,17 +200,21 @@ void OnInit() {
 
 	GL_CHECK_ERRORS
 
+	//setup the filter for the image size and filter with the first kernel
+	filter.Init(texture_width, texture_height);
+	ApplyKernel();
+
+	GL_CHECK_ERRORS
+
 	cout<<"Initialization successfull"<<endl;
 }
 
 //release all allocated resources
 void OnShutdown() {
 
-	current_shader = 0;
-
 	//Destroy shader
 	shader.DeleteShaderProgram();
-	convolution_shader.DeleteShaderProgram();
+	filter.Destroy();
 
 
 	//Destroy vao and vbo
@@ -185,12 +238,17 @@ void OnRender() {
 	//clear the colour and depth buffers
 	glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 
-	//bind current shader
-	current_shader->Use();
+	//bind the filtered or the normal image
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, showFiltered? filteredTextureID : textureID);
+
+	//bind shader
+	shader.Use();
 		//draw fullscreen quad
+		glBindVertexArray(vaoID);
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
 	//unbind shader
-	current_shader->UnUse();
+	shader.UnUse();
 
 	//swap front and back buffers to show the rendered result
 	glutSwapBuffers();
@@ -199,15 +257,17 @@ void OnRender() {
 //keyboard event handler to change the output to convolved or normal image
 void OnKey(unsigned char key, int x, int y) {
 	switch(key) {
-		case ' ': {
-			if(current_shader == &shader) {
-				current_shader = &convolution_shader;
-				glutSetWindowTitle("Filtered image");
-			} else {
-				current_shader = &shader;
-				glutSetWindowTitle("Normal image");
-			}
-		}break;
+		case ' ':
+			showFiltered = !showFiltered;
+			ApplyKernel();
+		break;
+
+		case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8':
+			currentKernel = key-'1';
+			showFiltered = true;
+			ApplyKernel();
+		break;
 	}
 	//call display function
  	glutPostRedisplay();
@@ -244,6 +304,7 @@ int main(int argc, char** argv) {
 	cout<<"\tGLSL: "<<glGetString (GL_SHADING_LANGUAGE_VERSION)<<endl;
 
 	cout<<"Press ' ' key to filter/unfilter\n";
+	cout<<"Press '1'-'8' to select the kernel\n";
 	GL_CHECK_ERRORS
 
 	//initialization of OpenGL
@@ -33,6 +33,9 @@ const int CUBEMAP_SIZE = 1024;
 //shaders for rendering and cubemap generation
 GLSLShader shader, cubemapShader;
 
+//shaders for rendering triangles and lines into all cubemap faces in one pass
+GLSLShader layeredShader, layeredLinesShader;
+
 //vertex struct for storing per-vertex position and normal
 struct Vertex {
 	glm::vec3 pos, normal;
@@ -62,6 +65,30 @@ GLuint dynamicCubeMapID;
 //FBO and RBO IDs
 GLuint fboID, rboID;
 
+//depth cubemap and FBOs for layered rendering. The layered FBO has all six
+//faces attached at once, the clear FBO one face at a time so that only the
+//faces being updated are cleared.
+GLuint depthCubeMapID;
+GLuint layeredFboID, clearFboID;
+
+//cubemap update modes
+enum UpdateMode {SIX_PASSES, LAYERED, LAYERED_SCHEDULED};
+UpdateMode mode = LAYERED_SCHEDULED;
+
+//decides which cubemap faces are updated each frame
+#include "../src/CubemapScheduler.h"
+CCubemapScheduler scheduler;
+
+//bounds of the cubes in the previous frame, used to invalidate the faces they leave
+glm::vec3 lastMin[8], lastMax[8];
+
+//statistics of the last cubemap update
+int facesRendered = 0, sceneSubmissions = 0;
+
+//output message
+#include <sstream>
+std::stringstream msg;
+
 
 //grid object
 #include "../src/Grid.h"
@@ -142,6 +169,18 @@ void OnMouseDown(int button, int s, int x, int y)
 		state = 1;
 }
 
+//keyboard handler to switch between the cubemap update modes
+void OnKey(unsigned char key, int x, int y) {
+	switch(key) {
+		case '1': mode = SIX_PASSES; break;
+		case '2': mode = LAYERED; break;
+		case '3': mode = LAYERED_SCHEDULED; scheduler.InvalidateAll(); break;
+		case '+': scheduler.SetFacesPerFrame(scheduler.GetFacesPerFrame()+1); break;
+		case '-': scheduler.SetFacesPerFrame(scheduler.GetFacesPerFrame()-1); break;
+	}
+	glutPostRedisplay();
+}
+
 //mouse move handler
 void OnMouseMove(int x, int y)
 {
@@ -179,6 +218,28 @@ void OnInit() {
 
 	GL_CHECK_ERRORS
 
+	//load the layered shaders, both share the vertex and fragment shader and
+	//differ in the primitive type the geometry shader takes
+	layeredShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/layered.vert");
+	layeredShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/layered.frag");
+	layeredShader.LoadFromFile(GL_GEOMETRY_SHADER, "shaders/layered.geom");
+	layeredLinesShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/layered.vert");
+	layeredLinesShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/layered.frag");
+	layeredLinesShader.LoadFromFile(GL_GEOMETRY_SHADER, "shaders/layered_lines.geom");
+	GLSLShader* layered[2] = {&layeredShader, &layeredLinesShader};
+	for(int i=0;i<2;i++) {
+		layered[i]->CreateAndLinkProgram();
+		layered[i]->Use();
+			layered[i]->AddAttribute("vVertex");
+			layered[i]->AddUniform("M");
+			layered[i]->AddUniform("vColor");
+			layered[i]->AddUniform("faceMask");
+			layered[i]->AddUniform("faceVP");
+		layered[i]->UnUse();
+	}
+
+	GL_CHECK_ERRORS
+
 	//setup sphere geometry
 	createSphere(1,10,10);
 
@@ -255,6 +316,52 @@ void OnInit() {
 
 	GL_CHECK_ERRORS
 
+	//layered rendering needs every attachment to be layered so the depth
+	//buffer is a cubemap texture as well
+	glGenTextures(1, &depthCubeMapID);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubeMapID);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	for (int face = 0; face < 6; face++) {
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, CUBEMAP_SIZE, CUBEMAP_SIZE, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	}
+	//rebind the colour cubemap on texture unit 1
+	glBindTexture(GL_TEXTURE_CUBE_MAP, dynamicCubeMapID);
+
+	//attach the whole colour and depth cubemaps, the geometry shader selects
+	//the face with gl_Layer
+	glGenFramebuffers(1, &layeredFboID);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, layeredFboID);
+	glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, dynamicCubeMapID, 0);
+	glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubeMapID, 0);
+	status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+	if(status != GL_FRAMEBUFFER_COMPLETE) {
+		cerr<<"Layered frame buffer object setup error."<<endl;
+		exit(EXIT_FAILURE);
+	}
+
+	//clearing a layered FBO clears all faces, so faces are cleared through
+	//a second FBO that has a single face attached
+	glGenFramebuffers(1, &clearFboID);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, clearFboID);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, dynamicCubeMapID, 0);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X, depthCubeMapID, 0);
+	status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+	if(status != GL_FRAMEBUFFER_COMPLETE) {
+		cerr<<"Clear frame buffer object setup error."<<endl;
+		exit(EXIT_FAILURE);
+	}
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+	//the reflective sphere is the probe centre, update two faces per frame
+	scheduler.SetCenter(glm::vec3(0,1,0));
+	scheduler.SetFacesPerFrame(2);
+
+	GL_CHECK_ERRORS
+
 	//create a grid object
 	grid = new CGrid();
 
@@ -275,6 +382,8 @@ void OnShutdown() {
 	//Destroy shader
 	shader.DeleteShaderProgram();
 	cubemapShader.DeleteShaderProgram();
+	layeredShader.DeleteShaderProgram();
+	layeredLinesShader.DeleteShaderProgram();
 
 	//Destroy vao and vbo
 	glDeleteBuffers(1, &sphereVerticesVBO);
@@ -289,6 +398,10 @@ void OnShutdown() {
 
 	glDeleteFramebuffers(1, &fboID);
 	glDeleteRenderbuffers(1, &rboID);
+
+	glDeleteTextures(1, &depthCubeMapID);
+	glDeleteFramebuffers(1, &layeredFboID);
+	glDeleteFramebuffers(1, &clearFboID);
 	cout<<"Shutdown successfull"<<endl;
 }
 
@@ -334,6 +447,68 @@ void DrawScene(glm::mat4 MView, glm::mat4 Proj ) {
 	grid->Render(glm::value_ptr(Proj*MView));
 }
 
+//world transform of the given cube
+glm::mat4 GetCubeTransform(int i) {
+	float angle = (float)(i/8.0f*2*M_PI);
+	return Rot*glm::translate(glm::mat4(1), glm::vec3(radius*cos(angle),0.5,radius*sin(angle)));
+}
+
+//renders the scene into the cubemap faces in faces (bit i is GL_TEXTURE_CUBE_MAP_POSITIVE_X+i)
+//with a single submission of the scene. Each cube is only sent to the faces its
+//bounds overlap and the geometry shader drops triangles outside each face.
+void DrawSceneLayered(int faces) {
+	if(faces == 0)
+		return;
+
+	//clear only the faces being updated
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, clearFboID);
+	for(int face=0;face<6;face++) {
+		if(!(faces & (1<<face)))
+			continue;
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X+face, dynamicCubeMapID, 0);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X+face, depthCubeMapID, 0);
+		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+	}
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, layeredFboID);
+
+	//view projection matrix of each face
+	glm::mat4 faceVP[6];
+	for(int face=0;face<6;face++)
+		faceVP[face] = Pcubemap*CCubemapScheduler::GetFaceViewMatrix(face, scheduler.GetCenter());
+
+	//per instance transforms, colours and face masks for the cubes
+	glm::mat4 M[8];
+	GLint faceMask[8];
+	for(int i=0;i<8;i++) {
+		M[i] = GetCubeTransform(i);
+		glm::vec3 c = glm::vec3(M[i][3]);
+		faceMask[i] = faces & scheduler.GetFaceMask(c-glm::vec3(0.71f,0.5f,0.71f), c+glm::vec3(0.71f,0.5f,0.71f));
+	}
+
+	//all cubes in one instanced draw
+	layeredShader.Use();
+		glUniformMatrix4fv(layeredShader("faceVP"), 6, GL_FALSE, glm::value_ptr(faceVP[0]));
+		glUniformMatrix4fv(layeredShader("M"), 8, GL_FALSE, glm::value_ptr(M[0]));
+		glUniform3fv(layeredShader("vColor"), 8, glm::value_ptr(colors[0]));
+		glUniform1iv(layeredShader("faceMask"), 8, faceMask);
+		cube->RenderGeometry(8);
+	layeredShader.UnUse();
+
+	//the grid is static and is drawn into every face being updated
+	glm::mat4 I = glm::mat4(1);
+	glm::vec3 white = glm::vec3(1);
+	layeredLinesShader.Use();
+		glUniformMatrix4fv(layeredLinesShader("faceVP"), 6, GL_FALSE, glm::value_ptr(faceVP[0]));
+		glUniformMatrix4fv(layeredLinesShader("M"), 1, GL_FALSE, glm::value_ptr(I));
+		glUniform3fv(layeredLinesShader("vColor"), 1, glm::value_ptr(white));
+		glUniform1iv(layeredLinesShader("faceMask"), 1, &faces);
+		grid->RenderGeometry();
+	layeredLinesShader.UnUse();
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
 //display callback function
 void OnRender() {
 
@@ -369,69 +544,102 @@ void OnRender() {
 	//set the viewport to the size of the cube map texture
 	glViewport(0,0,CUBEMAP_SIZE,CUBEMAP_SIZE);
 
-	//bind the FBO
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fboID);
-
-		//set the GL_TEXTURE_CUBE_MAP_POSITIVE_X to the colour attachment of FBO
-		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, dynamicCubeMapID, 0);
-		//clear the colour and depth buffers
-		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
-		//set the virtual viewrer at the reflective object center and render the scene
-		//using the cube map projection matrix and appropriate viewing settings
-		glm::mat4 MV1 = glm::lookAt(glm::vec3(0),glm::vec3(1,0,0), glm::vec3(0,-1,0));
- 		DrawScene( MV1*T, Pcubemap);
-
-		//set the GL_TEXTURE_CUBE_MAP_NEGATIVE_X to the colour attachment of FBO
-		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_NEGATIVE_X, dynamicCubeMapID, 0);
-		//clear the colour and depth buffers
-		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
-		//set the virtual viewrer at the reflective object center and render the scene
-		//using the cube map projection matrix and appropriate viewing settings
-		glm::mat4 MV2 = glm::lookAt(glm::vec3(0),glm::vec3(-1,0,0), glm::vec3(0,-1,0));
-		DrawScene( MV2*T, Pcubemap);
+	if(mode == SIX_PASSES) {
+		//bind the FBO
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fboID);
+
+			//set the GL_TEXTURE_CUBE_MAP_POSITIVE_X to the colour attachment of FBO
+			glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, dynamicCubeMapID, 0);
+			//clear the colour and depth buffers
+			glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+			//set the virtual viewrer at the reflective object center and render the scene
+			//using the cube map projection matrix and appropriate viewing settings
+			glm::mat4 MV1 = glm::lookAt(glm::vec3(0),glm::vec3(1,0,0), glm::vec3(0,-1,0));
+	 		DrawScene( MV1*T, Pcubemap);
+
+			//set the GL_TEXTURE_CUBE_MAP_NEGATIVE_X to the colour attachment of FBO
+			glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_NEGATIVE_X, dynamicCubeMapID, 0);
+			//clear the colour and depth buffers
+			glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+			//set the virtual viewrer at the reflective object center and render the scene
+			//using the cube map projection matrix and appropriate viewing settings
+			glm::mat4 MV2 = glm::lookAt(glm::vec3(0),glm::vec3(-1,0,0), glm::vec3(0,-1,0));
+			DrawScene( MV2*T, Pcubemap);
 		
-		//set the GL_TEXTURE_CUBE_MAP_POSITIVE_Y to the colour attachment of FBO		
-		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_Y, dynamicCubeMapID, 0);
-		//clear the colour and depth buffers 
-		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
-		//set the virtual viewrer at the reflective object center and render the scene
-		//using the cube map projection matrix and appropriate viewing settings
-		glm::mat4 MV3 = glm::lookAt(glm::vec3(0),glm::vec3(0,1,0), glm::vec3(1,0,0));
-		DrawScene( MV3*T, Pcubemap);
-
-		//set the GL_TEXTURE_CUBE_MAP_NEGATIVE_Y to the colour attachment of FBO		
-		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, dynamicCubeMapID, 0);
-		//clear the colour and depth buffers
-		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
-		//set the virtual viewrer at the reflective object center and render the scene
-		//using the cube map projection matrix and appropriate viewing settings
-		glm::mat4 MV4 = glm::lookAt(glm::vec3(0),glm::vec3(0,-1,0), glm::vec3(1,0,0));
-		DrawScene( MV4*T, Pcubemap);
-
-		//set the GL_TEXTURE_CUBE_MAP_POSITIVE_Z to the colour attachment of FBO		
-		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_Z, dynamicCubeMapID, 0);
-		//clear the colour and depth buffers
-		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
-		//set the virtual viewrer at the reflective object center and render the scene
-		//using the cube map projection matrix and appropriate viewing settings
-		glm::mat4 MV5 = glm::lookAt(glm::vec3(0),glm::vec3(0,0,1), glm::vec3(0,-1,0));
-		DrawScene(MV5*T, Pcubemap);
-
-		//set the GL_TEXTURE_CUBE_MAP_NEGATIVE_Z to the colour attachment of FBO		
-		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, dynamicCubeMapID, 0);
-		//clear the colour and depth buffers
-		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
-		//set the virtual viewrer at the reflective object center and render the scene
-		//using the cube map projection matrix and appropriate viewing settings
-		glm::mat4 MV6 = glm::lookAt(glm::vec3(0),glm::vec3(0,0,-1), glm::vec3(0,-1,0));
-		DrawScene( MV6*T, Pcubemap);
-
-	//unbind the FBO
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+			//set the GL_TEXTURE_CUBE_MAP_POSITIVE_Y to the colour attachment of FBO		
+			glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_Y, dynamicCubeMapID, 0);
+			//clear the colour and depth buffers 
+			glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+			//set the virtual viewrer at the reflective object center and render the scene
+			//using the cube map projection matrix and appropriate viewing settings
+			glm::mat4 MV3 = glm::lookAt(glm::vec3(0),glm::vec3(0,1,0), glm::vec3(1,0,0));
+			DrawScene( MV3*T, Pcubemap);
+
+			//set the GL_TEXTURE_CUBE_MAP_NEGATIVE_Y to the colour attachment of FBO		
+			glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, dynamicCubeMapID, 0);
+			//clear the colour and depth buffers
+			glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+			//set the virtual viewrer at the reflective object center and render the scene
+			//using the cube map projection matrix and appropriate viewing settings
+			glm::mat4 MV4 = glm::lookAt(glm::vec3(0),glm::vec3(0,-1,0), glm::vec3(1,0,0));
+			DrawScene( MV4*T, Pcubemap);
+
+			//set the GL_TEXTURE_CUBE_MAP_POSITIVE_Z to the colour attachment of FBO		
+			glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_Z, dynamicCubeMapID, 0);
+			//clear the colour and depth buffers
+			glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+			//set the virtual viewrer at the reflective object center and render the scene
+			//using the cube map projection matrix and appropriate viewing settings
+			glm::mat4 MV5 = glm::lookAt(glm::vec3(0),glm::vec3(0,0,1), glm::vec3(0,-1,0));
+			DrawScene(MV5*T, Pcubemap);
+
+			//set the GL_TEXTURE_CUBE_MAP_NEGATIVE_Z to the colour attachment of FBO		
+			glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, dynamicCubeMapID, 0);
+			//clear the colour and depth buffers
+			glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+			//set the virtual viewrer at the reflective object center and render the scene
+			//using the cube map projection matrix and appropriate viewing settings
+			glm::mat4 MV6 = glm::lookAt(glm::vec3(0),glm::vec3(0,0,-1), glm::vec3(0,-1,0));
+			DrawScene( MV6*T, Pcubemap);
+
+		//unbind the FBO
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		facesRendered = 6;
+		sceneSubmissions = 6;
+	} else {
+		int faces = 0x3f;
+		if(mode == LAYERED_SCHEDULED) {
+			//the moving cubes invalidate the faces they were in and the faces
+			//they are in now, the static grid never invalidates a face
+			for(int i=0;i<8;i++) {
+				glm::vec3 c = glm::vec3(GetCubeTransform(i)[3]);
+				glm::vec3 bmin = c-glm::vec3(0.71f,0.5f,0.71f);
+				glm::vec3 bmax = c+glm::vec3(0.71f,0.5f,0.71f);
+				scheduler.Invalidate(lastMin[i], lastMax[i]);
+				scheduler.Invalidate(bmin, bmax);
+				lastMin[i] = bmin;
+				lastMax[i] = bmax;
+			}
+			faces = scheduler.Schedule();
+		}
+		DrawSceneLayered(faces);
+		facesRendered = 0;
+		for(int face=0;face<6;face++)
+			facesRendered += (faces>>face)&1;
+		sceneSubmissions = (faces != 0)? 1 : 0;
+	}
 
 	//reset the default viewport 
 	glViewport(0,0,WIDTH,HEIGHT);
 
+	//show the cubemap update statistics in the title
+	msg.str(std::string());
+	msg<<(mode==SIX_PASSES? "Six passes" : (mode==LAYERED? "Layered" : "Layered, scheduled"))
+	   <<" (1/2/3) :: Faces rendered: "<<facesRendered<<" :: Scene submissions: "<<sceneSubmissions;
+	if(mode == LAYERED_SCHEDULED)
+		msg<<" :: Faces per frame (+/-): "<<scheduler.GetFacesPerFrame()<<" :: Out of date: "<<scheduler.GetTotalDirty();
+	glutSetWindowTitle(msg.str().c_str());
+
 	//render scene from the camera point of view and projection matrix
 	DrawScene(MV, P);
 
@@ -497,6 +705,7 @@ int main(int argc, char** argv) {
 	glutReshapeFunc(OnResize);
 	glutMouseFunc(OnMouseDown);
 	glutMotionFunc(OnMouseMove); 
+	glutKeyboardFunc(OnKey);
 	glutIdleFunc(OnIdle);
 
 	//main loop call
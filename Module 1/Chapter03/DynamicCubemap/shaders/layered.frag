@@ -0,0 +1,12 @@
+#version 330 core
+
+layout(location=0) out vec4 vFragColor;	//fragment shader output
+
+//input from the geometry shader
+flat in vec3 vColor;	//constant colour of the instance
+
+void main()
+{
+	//return constant colour as shader output
+	vFragColor = vec4(vColor,1);
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 330 core
+  
+layout(location=0) in vec3 vVertex;	//object space vertex position
+
+//uniforms
+uniform mat4 M[8];			//model matrix of each instance
+uniform vec3 vColor[8];		//colour of each instance
+uniform int faceMask[8];	//cubemap faces each instance has to be rendered into
+
+//vertex shader outputs
+out vec4 vWorldPos;			//world space position
+flat out vec3 vInstanceColor;	//colour of the instance
+flat out int vFaceMask;		//faces the instance is rendered into
+
+void main()
+{ 
+	//the geometry shader projects the world space position once for every face
+	vWorldPos = M[gl_InstanceID]*vec4(vVertex.xyz,1);
+	vInstanceColor = vColor[gl_InstanceID];
+	vFaceMask = faceMask[gl_InstanceID];
+}
\ No newline at end of file
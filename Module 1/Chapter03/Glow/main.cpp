@@ -9,6 +9,7 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "..\src\GLSLShader.h"
+#include "..\src\ImageFilter.h"
 
 #define GL_CHECK_ERRORS assert(glGetError()== GL_NO_ERROR);
 
@@ -86,9 +87,12 @@ glm::vec3 particles[8];
 GLuint particlesVAO;
 GLuint particlesVBO;
 
-//particle and blurring shader
+//particle and fullscreen quad shader
 GLSLShader particleShader;
-GLSLShader blurShader;
+GLSLShader fullscreenShader;
+
+//separable Gaussian blur of the glow
+CImageFilter blurFilter;
 
 //quad vertex array and vertex buffer object IDs
 GLuint quadVAOID;
@@ -100,9 +104,8 @@ float angle = 0;
 
 //FBO ID
 GLuint fboID;
-//FBO colour attachment textures
-GLuint texID[2]; //0 -> glow rendered output
-				 //1 -> blurred output
+//FBO colour attachment texture
+GLuint texID; //glow rendered output
 
 //width and height of the FBO colour attachment
 const int RENDER_TARGET_WIDTH = WIDTH>>1;
@@ -249,25 +252,23 @@ void OnInit() {
 	glGenFramebuffers(1, &fboID);
 	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fboID);
 
-	//setup two colour attachments
-	glGenTextures(2, texID);
+	//setup the colour attachment
+	glGenTextures(1, &texID);
 	glActiveTexture(GL_TEXTURE0);
-	for(int i=0;i<2;i++) {		
-		glBindTexture(GL_TEXTURE_2D, texID[i]);
-		//set texture parameters
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, texID);
+	//set texture parameters
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-		//allocate OpenGL texture
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, RENDER_TARGET_WIDTH, RENDER_TARGET_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	//allocate OpenGL texture
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, RENDER_TARGET_WIDTH, RENDER_TARGET_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
 
-		GL_CHECK_ERRORS
+	GL_CHECK_ERRORS
 
-		//set the current texture as the FBO attachment 
-		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0+i, GL_TEXTURE_2D, texID[i], 0);
-	}
+	//set the texture as the FBO attachment 
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texID, 0);
 	
 	GL_CHECK_ERRORS
 
@@ -301,18 +302,25 @@ void OnInit() {
 	*id++ = 0; 	*id++ = 1; 	*id++ = 2;
 	*id++ = 0; 	*id++ = 2; 	*id++ = 3;
 
-	//load the blur shader
-	blurShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/full_screen_shader.vert");
-	blurShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/full_screen_shader.frag");
+	//load the fullscreen quad shader
+	fullscreenShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/full_screen_shader.vert");
+	fullscreenShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/full_screen_shader.frag");
 	//compile and link the shader
-	blurShader.CreateAndLinkProgram();
-	blurShader.Use();
+	fullscreenShader.CreateAndLinkProgram();
+	fullscreenShader.Use();
 		//add shader attributes and uniforms
-		blurShader.AddAttribute("vVertex");
-		blurShader.AddUniform("textureMap");
+		fullscreenShader.AddAttribute("vVertex");
+		fullscreenShader.AddUniform("textureMap");
 		//set the values of the constant uniforms at initialization
-		glUniform1i(blurShader("textureMap"),0);
-	blurShader.UnUse();
+		glUniform1i(fullscreenShader("textureMap"),0);
+	fullscreenShader.UnUse();
+
+	GL_CHECK_ERRORS
+
+	//setup the blur filter for the offscreen render target, a Gaussian is
+	//separable so it is applied as a horizontal and a vertical pass
+	blurFilter.Init(RENDER_TARGET_WIDTH, RENDER_TARGET_HEIGHT);
+	blurFilter.SetKernel(CConvolutionKernel::Gaussian(10, 4.0f));
 
 	GL_CHECK_ERRORS
 
@@ -344,7 +352,8 @@ void OnInit() {
 //release all allocated resources
 void OnShutdown() {
 	particleShader.DeleteShaderProgram();
-	blurShader.DeleteShaderProgram();
+	fullscreenShader.DeleteShaderProgram();
+	blurFilter.Destroy();
 
 	delete grid;
 	delete cube;
@@ -356,7 +365,7 @@ void OnShutdown() {
 	glDeleteBuffers(1, &quadVBOIndicesID);
 	glDeleteBuffers(1, &quadVAOID);
 
-	glDeleteTextures(2, texID);
+	glDeleteTextures(1, &texID);
 	glDeleteFramebuffers(1, &fboID);
 
 	cout<<"Shutdown successfull"<<endl;
@@ -470,31 +479,28 @@ void OnRender() {
 		particleShader.UnUse();
 	GL_CHECK_ERRORS
 
-	//set the first colour attachment
-	glDrawBuffer(GL_COLOR_ATTACHMENT1);
-	//bind the output of the previous step as texture
-	glBindTexture(GL_TEXTURE_2D, texID[0]);
-		//use the blur shader
-		blurShader.Use();
-			//bind the fullscreen quad vertex array
-			glBindVertexArray(quadVAOID);
-				//render fullscreen quad
-				glDrawElements(GL_TRIANGLES,6,GL_UNSIGNED_SHORT,0);
+	//unbind the FBO
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+	//blur the output of the previous step
+	GLuint blurredTexID = blurFilter.Apply(texID);
 
 	GL_CHECK_ERRORS
 
-	//unbind the FBO
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 	//restore the default back buffer
 	glDrawBuffer(GL_BACK_LEFT);
 	//bind the filtered texture from the final step
-	glBindTexture(GL_TEXTURE_2D, texID[1]);
+	glBindTexture(GL_TEXTURE_2D, blurredTexID);
 
 	GL_CHECK_ERRORS
 
 	//reset the default viewport
 	glViewport(0,0,WIDTH, HEIGHT);
 	GL_CHECK_ERRORS
+	//use the fullscreen quad shader
+	fullscreenShader.Use();
+	//bind the fullscreen quad vertex array
+	glBindVertexArray(quadVAOID);
 	//enable additive blending
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_ONE, GL_ONE);
@@ -502,8 +508,8 @@ void OnRender() {
 		glDrawElements(GL_TRIANGLES,6,GL_UNSIGNED_SHORT,0);
 	glBindVertexArray(0);
 
-	//unbind the blur shader
-	blurShader.UnUse();
+	//unbind the fullscreen quad shader
+	fullscreenShader.UnUse();
 
 	//disable blending
 	glDisable(GL_BLEND);
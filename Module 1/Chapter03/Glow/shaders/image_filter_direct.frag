@@ -0,0 +1,28 @@
+#version 330 core
+ 
+layout(location=0) out vec4 vFragColor;	//fragment shader output
+
+//input from the vertex shader
+smooth in vec2 vUV;						//2D texture coordinates
+
+//shader uniforms
+uniform sampler2D textureMap;			//the image to filter
+uniform float weights[225];				//kernel weights row by row, up to 15x15
+uniform ivec2 kernelSize;				//kernel width and height
+
+void main()
+{ 
+	//determine the inverse of texture size
+	vec2 delta = 1.0/textureSize(textureMap,0);
+	ivec2 center = kernelSize/2;
+	vec4 color = vec4(0);
+
+	//accumulate the product of the kernel weights with the texture samples in
+	//the neighborhood. The kernel is mirrored so this is a true convolution.
+	for(int j=0;j<kernelSize.y;j++) {
+		for(int i=0;i<kernelSize.x;i++) {
+			color += weights[j*kernelSize.x+i]*texture(textureMap, vUV + vec2(center-ivec2(i,j))*delta);
+		}
+	}
+	vFragColor = color;
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#version 330 core
+
+layout(location=0) out vec4 vFragColor;	//fragment shader output
+
+//shader uniforms
+uniform sampler2D textureMap;			//the image or spectrum to process
+uniform sampler2D kernelMap;			//the kernel spectrum
+uniform int pass;						//0 -> copy, 1 -> butterfly, 2 -> multiply
+
+//copy pass uniforms
+uniform ivec2 offset;					//first texel of textureMap to copy
+uniform ivec2 size;						//texels of textureMap, the rest reads as zero
+uniform float scale;					//scale of the copied values
+
+//butterfly pass uniforms
+uniform ivec2 direction;				//(1,0) for the rows, (0,1) for the columns
+uniform int span;						//length of the transforms already done
+uniform int halfLength;					//half the transform length
+uniform float sign;						//-1 for the forward, 1 for the inverse transform
+
+const float TWO_PI = 6.28318530718;
+
+//every texel holds two complex numbers, (x,y) and (z,w), both are multiplied
+//by the complex number c
+vec4 ComplexMul(vec4 a, vec2 c) {
+	return vec4(a.x*c.x - a.y*c.y, a.x*c.y + a.y*c.x,
+				a.z*c.x - a.w*c.y, a.z*c.y + a.w*c.x);
+}
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+
+	if(pass == 0) {
+		//pad the image with zeros or crop the result out of the padded image
+		ivec2 src = texel + offset;
+		if(any(greaterThanEqual(src, size))) {
+			vFragColor = vec4(0);
+		} else {
+			vFragColor = scale*texelFetch(textureMap, src, 0);
+		}
+	} else if(pass == 1) {
+		//one radix 2 Stockham stage. Output i takes the two inputs j and
+		//j+halfLength of the transforms of length span, the outputs end up
+		//in natural order so no bit reversal pass is needed.
+		int i = texel.x*direction.x + texel.y*direction.y;
+		int k = i % span;
+		int j = (i/(2*span))*span + k;
+		ivec2 a = texel + direction*(j-i);
+		ivec2 b = a + direction*halfLength;
+		float angle = sign*TWO_PI*float(k)/float(2*span);
+		vec4 x = texelFetch(textureMap, a, 0);
+		vec4 y = ComplexMul(texelFetch(textureMap, b, 0), vec2(cos(angle), sin(angle)));
+		vFragColor = ((i/span)%2 == 0)? x+y : x-y;
+	} else {
+		//the kernel is real so its spectrum multiplies both complex numbers
+		vFragColor = ComplexMul(texelFetch(textureMap, texel, 0), texelFetch(kernelMap, texel, 0).xy);
+	}
+}
\ No newline at end of file
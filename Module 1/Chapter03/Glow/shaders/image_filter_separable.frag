@@ -0,0 +1,27 @@
+#version 330 core
+ 
+layout(location=0) out vec4 vFragColor;	//fragment shader output
+
+//input from the vertex shader
+smooth in vec2 vUV;						//2D texture coordinates
+
+//shader uniforms
+uniform sampler2D textureMap;			//the image to filter
+uniform float weights[127];				//1D kernel weights
+uniform int kernelSize;					//number of weights
+uniform vec2 direction;					//(1,0) for the horizontal, (0,1) for the vertical pass
+
+void main()
+{ 
+	//one texel step along the pass direction
+	vec2 delta = direction/textureSize(textureMap,0);
+	int center = kernelSize/2;
+	vec4 color = vec4(0);
+
+	//1D convolution along the pass direction, two of these passes replace
+	//the kernelSize*kernelSize samples of the 2D loop
+	for(int i=0;i<kernelSize;i++) {
+		color += weights[i]*texture(textureMap, vUV + float(center-i)*delta);
+	}
+	vFragColor = color;
+}
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include "ConvolutionKernel.h"
+#include <cmath>
+
+//a kernel counts as rank r when the remaining terms hold less than this
+//fraction of its energy (squared Frobenius norm)
+const double RANK_TOLERANCE = 1e-6;
+
+//power iterations used to find each singular vector
+const int MAX_ITERATIONS = 200;
+
+CConvolutionKernel::CConvolutionKernel(void)
+{
+	//identity kernel
+	float one = 1;
+	Set(&one, 1, 1);
+}
+
+CConvolutionKernel::CConvolutionKernel(const float* w, const int width, const int height)
+{
+	Set(w, width, height);
+}
+
+CConvolutionKernel::~CConvolutionKernel(void)
+{
+}
+
+void CConvolutionKernel::Set(const float* w, const int width, const int height) {
+	this->width = width;
+	this->height = height;
+	weights.assign(w, w+width*height);
+	Decompose();
+}
+
+CConvolutionKernel CConvolutionKernel::Box(const int radius) {
+	int size = 2*radius+1;
+	std::vector<float> w(size*size, 1.0f/(size*size));
+	return CConvolutionKernel(&w[0], size, size);
+}
+
+CConvolutionKernel CConvolutionKernel::Gaussian(const int radius, const float sigma) {
+	int size = 2*radius+1;
+	std::vector<float> w(size*size);
+	float sum = 0;
+	for(int j=-radius;j<=radius;j++) {
+		for(int i=-radius;i<=radius;i++) {
+			float g = expf(-(i*i+j*j)/(2*sigma*sigma));
+			w[(j+radius)*size+(i+radius)] = g;
+			sum += g;
+		}
+	}
+	for(size_t i=0;i<w.size();i++)
+		w[i] /= sum;
+	return CConvolutionKernel(&w[0], size, size);
+}
+
+CConvolutionKernel CConvolutionKernel::Enhance3x3(const float* k) {
+	float w[9];
+	for(int i=0;i<9;i++)
+		w[i] = k[i]/9.0f;
+	w[4] += 1;
+	return CConvolutionKernel(w, 3, 3);
+}
+
+CConvolutionKernel CConvolutionKernel::Disc(const int radius) {
+	int size = 2*radius+1;
+	std::vector<float> w(size*size, 0.0f);
+	int total = 0;
+	for(int j=-radius;j<=radius;j++) {
+		for(int i=-radius;i<=radius;i++) {
+			if(i*i+j*j <= radius*radius) {
+				w[(j+radius)*size+(i+radius)] = 1;
+				total++;
+			}
+		}
+	}
+	for(size_t i=0;i<w.size();i++)
+		w[i] /= total;
+	return CConvolutionKernel(&w[0], size, size);
+}
+
+void CConvolutionKernel::Decompose() {
+	rows.clear();
+	columns.clear();
+
+	//residual of the kernel after removing the terms found so far
+	std::vector<double> A(weights.begin(), weights.end());
+	double energy = 0;
+	for(size_t i=0;i<A.size();i++)
+		energy += A[i]*A[i];
+
+	std::vector<double> u(height), v(width), Av(height), AtAv(width);
+	double residual = energy;
+	while(residual > RANK_TOLERANCE*energy && int(rows.size()) < MAX_RANK) {
+		//find the largest singular value and its vectors by power iteration
+		//on A^T*A. The start vector is slightly uneven so it is not
+		//orthogonal to the dominant vector of zero sum kernels.
+		for(int i=0;i<width;i++)
+			v[i] = 1.0 + 0.1*i/width;
+		double sigma = 0;
+		for(int it=0;it<MAX_ITERATIONS;it++) {
+			for(int j=0;j<height;j++) {
+				double sum = 0;
+				for(int i=0;i<width;i++)
+					sum += A[j*width+i]*v[i];
+				Av[j] = sum;
+			}
+			double len = 0;
+			for(int i=0;i<width;i++) {
+				double sum = 0;
+				for(int j=0;j<height;j++)
+					sum += A[j*width+i]*Av[j];
+				AtAv[i] = sum;
+				len += sum*sum;
+			}
+			len = sqrt(len);
+			if(len == 0)
+				break;
+			double change = 0;
+			for(int i=0;i<width;i++) {
+				double n = AtAv[i]/len;
+				change += (n-v[i])*(n-v[i]);
+				v[i] = n;
+			}
+			if(change < 1e-20)
+				break;
+		}
+		//u = A*v/sigma
+		for(int j=0;j<height;j++) {
+			double sum = 0;
+			for(int i=0;i<width;i++)
+				sum += A[j*width+i]*v[i];
+			u[j] = sum;
+			sigma += sum*sum;
+		}
+		sigma = sqrt(sigma);
+		if(sigma == 0)
+			break;
+
+		//store the term with the singular value folded into the column and
+		//remove it from the residual
+		std::vector<float> row(width), column(height);
+		for(int i=0;i<width;i++)
+			row[i] = float(v[i]);
+		for(int j=0;j<height;j++)
+			column[j] = float(u[j]);
+		rows.push_back(row);
+		columns.push_back(column);
+
+		residual = 0;
+		for(int j=0;j<height;j++) {
+			for(int i=0;i<width;i++) {
+				A[j*width+i] -= u[j]*v[i];
+				residual += A[j*width+i]*A[j*width+i];
+			}
+		}
+	}
+
+	if(residual > RANK_TOLERANCE*energy) {
+		rows.clear();
+		columns.clear();
+	}
+
+	//a pair of 1D passes per term reads width+height texels, the direct loop
+	//reads width*height texels
+	int rank = int(rows.size());
+	if(rank>0 && rank*(width+height) < width*height)
+		method = SEPARABLE;
+	else if(width*height > MAX_DIRECT_TAPS)
+		method = FFT;
+	else
+		method = DIRECT;
+}
\ No newline at end of file
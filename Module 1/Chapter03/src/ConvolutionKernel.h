@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+
+//A 2D convolution kernel of arbitrary size. On creation the kernel is split
+//into a sum of separable terms, K = sum of column[r]*row[r]^T, using the
+//singular value decomposition. A kernel of rank r can then be applied with
+//r pairs of 1D passes, which is much cheaper than the direct 2D loop for all
+//but the smallest kernels. Kernels of high rank are large enough to be
+//better off with FFT convolution.
+class CConvolutionKernel
+{
+public:
+	//how the kernel is best applied
+	enum Method {DIRECT, SEPARABLE, FFT};
+
+	//separable terms are only used up to this rank
+	static const int MAX_RANK = 4;
+	//largest kernel (width*height) applied with the direct loop
+	static const int MAX_DIRECT_TAPS = 225;
+
+	CConvolutionKernel(void);
+	//weights are given row by row, width and height must be odd
+	CConvolutionKernel(const float* weights, const int width, const int height);
+	~CConvolutionKernel(void);
+
+	void Set(const float* weights, const int width, const int height);
+
+	//common kernels
+	static CConvolutionKernel Box(const int radius);
+	static CConvolutionKernel Gaussian(const int radius, const float sigma);
+	//identity plus the given 3x3 kernel divided by 9, as used for sharpening
+	//and embossing
+	static CConvolutionKernel Enhance3x3(const float* weights);
+	//flat disc shaped blur, not separable
+	static CConvolutionKernel Disc(const int radius);
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	const float* GetWeights() const { return &weights[0]; }
+
+	//number of separable terms, 0 if the kernel needs more than MAX_RANK
+	int GetRank() const { return int(rows.size()); }
+	const float* GetRow(const int term) const { return &rows[term][0]; }
+	const float* GetColumn(const int term) const { return &columns[term][0]; }
+
+	//cheapest way to apply the kernel
+	Method GetMethod() const { return method; }
+
+private:
+	void Decompose();
+
+	int width, height;
+	std::vector<float> weights;
+	std::vector< std::vector<float> > rows, columns;
+	Method method;
+};
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "CubemapScheduler.h"
+#include <glm/gtc/matrix_transform.hpp>
+
+//look and up directions of the cubemap faces in the GL_TEXTURE_CUBE_MAP_POSITIVE_X,
+//NEGATIVE_X, POSITIVE_Y, NEGATIVE_Y, POSITIVE_Z, NEGATIVE_Z order
+const glm::vec3 FACE_LOOK[6] = { glm::vec3(1,0,0), glm::vec3(-1,0,0),
+								 glm::vec3(0,1,0), glm::vec3(0,-1,0),
+								 glm::vec3(0,0,1), glm::vec3(0,0,-1) };
+const glm::vec3 FACE_UP[6]   = { glm::vec3(0,-1,0), glm::vec3(0,-1,0),
+								 glm::vec3(1,0,0),  glm::vec3(1,0,0),
+								 glm::vec3(0,-1,0), glm::vec3(0,-1,0) };
+
+const int ALL_FACES = 0x3f;
+
+CCubemapScheduler::CCubemapScheduler(void)
+{
+	center = glm::vec3(0);
+	facesPerFrame = 6;
+	frame = 0;
+	for(int i=0;i<6;i++)
+		lastUpdate[i] = -1;
+	dirtyMask = ALL_FACES;
+}
+
+CCubemapScheduler::~CCubemapScheduler(void)
+{
+}
+
+void CCubemapScheduler::SetCenter(const glm::vec3& c) {
+	if(c != center)
+		dirtyMask = ALL_FACES;
+	center = c;
+}
+
+void CCubemapScheduler::SetFacesPerFrame(const int count) {
+	facesPerFrame = glm::clamp(count, 1, 6);
+}
+
+int CCubemapScheduler::GetFaceMask(const glm::vec3& min, const glm::vec3& max) const {
+	glm::vec3 bmin = min-center;
+	glm::vec3 bmax = max-center;
+	int mask = 0;
+	for(int face=0;face<6;face++) {
+		int a = face/2;				//major axis of the face
+		int b = (a+1)%3, c = (a+2)%3;
+		float s = (face&1)? -1.0f : 1.0f;
+
+		//the face frustum is the region with s*p[a] >= |p[b]| and s*p[a] >= |p[c]|.
+		//The box is outside if it lies behind the face or behind any of the four
+		//side planes; each plane is tested with the box corner furthest along its
+		//normal.
+		float major = (s>0)? bmax[a] : -bmin[a];
+		if(major < 0 ||
+		   major + bmax[b] < 0 || major - bmin[b] < 0 ||
+		   major + bmax[c] < 0 || major - bmin[c] < 0)
+			continue;
+		mask |= 1<<face;
+	}
+	return mask;
+}
+
+void CCubemapScheduler::Invalidate(const glm::vec3& min, const glm::vec3& max) {
+	dirtyMask |= GetFaceMask(min, max);
+}
+
+void CCubemapScheduler::InvalidateAll() {
+	dirtyMask = ALL_FACES;
+}
+
+int CCubemapScheduler::Schedule() {
+	int mask = 0;
+	//pick the out of date faces that were rendered longest ago
+	for(int n=0;n<facesPerFrame;n++) {
+		int oldest = -1;
+		for(int face=0;face<6;face++) {
+			if(!(dirtyMask & (1<<face)) || (mask & (1<<face)))
+				continue;
+			if(oldest == -1 || lastUpdate[face] < lastUpdate[oldest])
+				oldest = face;
+		}
+		if(oldest == -1)
+			break;
+		mask |= 1<<oldest;
+	}
+	for(int face=0;face<6;face++) {
+		if(mask & (1<<face))
+			lastUpdate[face] = frame;
+	}
+	dirtyMask &= ~mask;
+	frame++;
+	return mask;
+}
+
+int CCubemapScheduler::GetTotalDirty() const {
+	int total = 0;
+	for(int face=0;face<6;face++)
+		total += (dirtyMask>>face)&1;
+	return total;
+}
+
+glm::mat4 CCubemapScheduler::GetFaceViewMatrix(const int face, const glm::vec3& c) {
+	return glm::lookAt(c, c+FACE_LOOK[face], FACE_UP[face]);
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+#include <glm/glm.hpp>
+
+//Decides which faces of a dynamic cubemap are rendered in a frame. Faces only
+//need an update when something moving is inside their frustum, and at most
+//a fixed number of faces is rendered per frame so the cost of a reflection
+//probe is spread over several frames. Out of date faces are updated oldest
+//first so no face starves.
+class CCubemapScheduler
+{
+public:
+	CCubemapScheduler(void);
+	~CCubemapScheduler(void);
+
+	void SetCenter(const glm::vec3& center);
+	const glm::vec3& GetCenter() const { return center; }
+
+	//at most this many faces are rendered per frame, 6 updates every out of
+	//date face in the same frame
+	void SetFacesPerFrame(const int count);
+	int GetFacesPerFrame() const { return facesPerFrame; }
+
+	//bit mask (bit i is GL_TEXTURE_CUBE_MAP_POSITIVE_X+i) of the faces whose
+	//frustum overlaps the given world space box
+	int GetFaceMask(const glm::vec3& min, const glm::vec3& max) const;
+
+	//mark the faces seeing the box as out of date. For moving objects call it
+	//with the old and the new bounds so the object is removed from the faces
+	//it has left.
+	void Invalidate(const glm::vec3& min, const glm::vec3& max);
+	void InvalidateAll();
+
+	//returns the bit mask of the faces to render this frame and marks them
+	//as up to date
+	int Schedule();
+
+	//number of faces that are still out of date
+	int GetTotalDirty() const;
+
+	//view matrix of the given face for a probe at center
+	static glm::mat4 GetFaceViewMatrix(const int face, const glm::vec3& center);
+
+private:
+	glm::vec3 center;
+	int facesPerFrame;
+	int dirtyMask;
+	int frame;
+	int lastUpdate[6];	//frame each face was last rendered in
+};
\ No newline at end of file
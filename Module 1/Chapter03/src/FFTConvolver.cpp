@@ -0,0 +1,212 @@
+#include "FFTConvolver.h"
+#include <xmmintrin.h>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//smallest power of two not less than n, at least 4 so rows fill SSE registers
+static int NextPowerOfTwo(int n) {
+	int p = 4;
+	while(p < n)
+		p <<= 1;
+	return p;
+}
+
+static void FillTwiddles(const int n, std::vector<float>& c, std::vector<float>& s) {
+	c.resize(n/2);
+	s.resize(n/2);
+	for(int k=0;k<n/2;k++) {
+		c[k] = float(cos(2*M_PI*k/n));
+		s[k] = float(sin(2*M_PI*k/n));
+	}
+}
+
+CFFTConvolver::CFFTConvolver(void)
+{
+	imageWidth = imageHeight = 0;
+	kernelWidth = kernelHeight = 0;
+	N = M = 0;
+	kernelRe = kernelIm = 0;
+	re = im = tmp = 0;
+}
+
+CFFTConvolver::~CFFTConvolver(void)
+{
+	Release();
+}
+
+void CFFTConvolver::Release() {
+	float* buffers[5] = {kernelRe, kernelIm, re, im, tmp};
+	for(int i=0;i<5;i++) {
+		if(buffers[i])
+			_mm_free(buffers[i]);
+	}
+	kernelRe = kernelIm = 0;
+	re = im = tmp = 0;
+}
+
+void CFFTConvolver::SetKernel(const CConvolutionKernel& kernel, const int width, const int height) {
+	imageWidth = width;
+	imageHeight = height;
+	kernelWidth = kernel.GetWidth();
+	kernelHeight = kernel.GetHeight();
+
+	//pad so that the linear convolution does not wrap around
+	int newN = NextPowerOfTwo(imageWidth + kernelWidth - 1);
+	int newM = NextPowerOfTwo(imageHeight + kernelHeight - 1);
+	if(newN != N || newM != M || !re) {
+		Release();
+		N = newN;
+		M = newM;
+		size_t size = size_t(N)*M*sizeof(float);
+		kernelRe = static_cast<float*>(_mm_malloc(size, 16));
+		kernelIm = static_cast<float*>(_mm_malloc(size, 16));
+		re  = static_cast<float*>(_mm_malloc(size, 16));
+		im  = static_cast<float*>(_mm_malloc(size, 16));
+		tmp = static_cast<float*>(_mm_malloc(size, 16));
+		FillTwiddles(N, cosN, sinN);
+		FillTwiddles(M, cosM, sinM);
+	}
+
+	//the kernel spectrum, with the kernel origin at the first pixel
+	memset(re, 0, size_t(N)*M*sizeof(float));
+	memset(im, 0, size_t(N)*M*sizeof(float));
+	const float* w = kernel.GetWeights();
+	for(int j=0;j<kernelHeight;j++)
+		memcpy(re + j*N, w + j*kernelWidth, kernelWidth*sizeof(float));
+	Forward();
+	memcpy(kernelRe, re, size_t(N)*M*sizeof(float));
+	memcpy(kernelIm, im, size_t(N)*M*sizeof(float));
+}
+
+void CFFTConvolver::TransformColumns(float* r, float* i, const int rows, const int cols, const bool inverse) {
+	//bit reversal permutation of the rows
+	for(int a=1, b=0; a<rows; a++) {
+		int bit = rows>>1;
+		for(; b & bit; bit >>= 1)
+			b ^= bit;
+		b ^= bit;
+		if(a < b) {
+			std::swap_ranges(r + a*cols, r + (a+1)*cols, r + b*cols);
+			std::swap_ranges(i + a*cols, i + (a+1)*cols, i + b*cols);
+		}
+	}
+
+	const float* cosTable = (rows==N)? &cosN[0] : &cosM[0];
+	const float* sinTable = (rows==N)? &sinN[0] : &sinM[0];
+	const float sign = inverse? 1.0f : -1.0f;
+
+	//radix 2 butterflies, every column of a row pair shares the twiddle factor
+	//so four columns are processed per SSE instruction
+	for(int len=2; len<=rows; len<<=1) {
+		int half = len>>1;
+		int step = rows/len;
+		for(int start=0; start<rows; start+=len) {
+			for(int k=0;k<half;k++) {
+				__m128 wr = _mm_set1_ps(cosTable[k*step]);
+				__m128 wi = _mm_set1_ps(sign*sinTable[k*step]);
+				float* ar = r + (start+k)*cols;
+				float* ai = i + (start+k)*cols;
+				float* br = r + (start+k+half)*cols;
+				float* bi = i + (start+k+half)*cols;
+				for(int c=0;c<cols;c+=4) {
+					__m128 xr = _mm_load_ps(br+c);
+					__m128 xi = _mm_load_ps(bi+c);
+					__m128 tr = _mm_sub_ps(_mm_mul_ps(xr, wr), _mm_mul_ps(xi, wi));
+					__m128 ti = _mm_add_ps(_mm_mul_ps(xr, wi), _mm_mul_ps(xi, wr));
+					__m128 yr = _mm_load_ps(ar+c);
+					__m128 yi = _mm_load_ps(ai+c);
+					_mm_store_ps(br+c, _mm_sub_ps(yr, tr));
+					_mm_store_ps(bi+c, _mm_sub_ps(yi, ti));
+					_mm_store_ps(ar+c, _mm_add_ps(yr, tr));
+					_mm_store_ps(ai+c, _mm_add_ps(yi, ti));
+				}
+			}
+		}
+	}
+}
+
+void CFFTConvolver::Transpose(const float* src, float* dst, const int rows, const int cols) {
+	//4x4 blocks are transposed in registers
+	for(int j=0;j<rows;j+=4) {
+		for(int i=0;i<cols;i+=4) {
+			__m128 r0 = _mm_load_ps(src + (j  )*cols + i);
+			__m128 r1 = _mm_load_ps(src + (j+1)*cols + i);
+			__m128 r2 = _mm_load_ps(src + (j+2)*cols + i);
+			__m128 r3 = _mm_load_ps(src + (j+3)*cols + i);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_store_ps(dst + (i  )*rows + j, r0);
+			_mm_store_ps(dst + (i+1)*rows + j, r1);
+			_mm_store_ps(dst + (i+2)*rows + j, r2);
+			_mm_store_ps(dst + (i+3)*rows + j, r3);
+		}
+	}
+}
+
+void CFFTConvolver::Forward() {
+	//transform along y, transpose, then transform along x
+	TransformColumns(re, im, M, N, false);
+	Transpose(re, tmp, M, N); std::swap(re, tmp);
+	Transpose(im, tmp, M, N); std::swap(im, tmp);
+	TransformColumns(re, im, N, M, false);
+}
+
+void CFFTConvolver::Inverse() {
+	TransformColumns(re, im, N, M, true);
+	Transpose(re, tmp, N, M); std::swap(re, tmp);
+	Transpose(im, tmp, N, M); std::swap(im, tmp);
+	TransformColumns(re, im, M, N, true);
+}
+
+void CFFTConvolver::Convolve(const float* src, float* dst, const int channels) {
+	const int cx = kernelWidth/2;
+	const int cy = kernelHeight/2;
+	const float scale = 1.0f/(float(N)*M);
+	const size_t total = size_t(N)*M;
+
+	//the kernel is real, so the real and imaginary part of the result are
+	//the convolutions of the real and imaginary part of the input
+	for(int c=0;c<channels;c+=2) {
+		const bool pair = (c+1 < channels);
+		memset(re, 0, total*sizeof(float));
+		memset(im, 0, total*sizeof(float));
+		for(int y=0;y<imageHeight;y++) {
+			const float* s = src + size_t(y)*imageWidth*channels;
+			float* r = re + size_t(y)*N;
+			float* i = im + size_t(y)*N;
+			for(int x=0;x<imageWidth;x++) {
+				r[x] = s[x*channels+c];
+				if(pair)
+					i[x] = s[x*channels+c+1];
+			}
+		}
+
+		Forward();
+
+		//multiply with the kernel spectrum
+		for(size_t k=0;k<total;k+=4) {
+			__m128 ar = _mm_load_ps(re+k), ai = _mm_load_ps(im+k);
+			__m128 br = _mm_load_ps(kernelRe+k), bi = _mm_load_ps(kernelIm+k);
+			_mm_store_ps(re+k, _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi)));
+			_mm_store_ps(im+k, _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br)));
+		}
+
+		Inverse();
+
+		//the kernel centre was at the origin, so the output is shifted by it
+		for(int y=0;y<imageHeight;y++) {
+			const float* r = re + size_t(y+cy)*N + cx;
+			const float* i = im + size_t(y+cy)*N + cx;
+			float* d = dst + size_t(y)*imageWidth*channels;
+			for(int x=0;x<imageWidth;x++) {
+				d[x*channels+c] = r[x]*scale;
+				if(pair)
+					d[x*channels+c+1] = i[x]*scale;
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+#include "ConvolutionKernel.h"
+#include <vector>
+
+//Convolves images with large kernels on the CPU through the FFT. The image
+//is zero padded to a power of two, transformed, multiplied with the cached
+//spectrum of the kernel and transformed back, so the cost no longer depends
+//on the kernel size. Two channels are transformed at once as the real and
+//imaginary part of one complex image, and the butterflies work on four
+//columns at a time with SSE. Used by CImageFilter::ApplyCPU for headless
+//runs, CImageFilter::Apply does the same on the GPU.
+class CFFTConvolver
+{
+public:
+	CFFTConvolver(void);
+	~CFFTConvolver(void);
+
+	//prepare for images of the given size, computes the kernel spectrum
+	void SetKernel(const CConvolutionKernel& kernel, const int imageWidth, const int imageHeight);
+
+	//convolve an image of the size given to SetKernel. Pixels are stored row
+	//by row with the given number of interleaved channels. Pixels outside
+	//the image are treated as zero.
+	void Convolve(const float* src, float* dst, const int channels);
+
+	int GetTransformWidth() const { return N; }
+	int GetTransformHeight() const { return M; }
+
+private:
+	//in place FFT of the columns of a rows x cols complex image
+	void TransformColumns(float* re, float* im, const int rows, const int cols, const bool inverse);
+	//out of place transpose of a rows x cols image
+	static void Transpose(const float* src, float* dst, const int rows, const int cols);
+	//2D transform of re/im, the spectrum is left transposed which saves
+	//transposing it back and forth
+	void Forward();
+	//inverse of Forward, without the 1/(N*M) scale
+	void Inverse();
+	void Release();
+
+	int imageWidth, imageHeight;
+	int kernelWidth, kernelHeight;
+	int N, M;					//transform width and height
+
+	//twiddle factors for each transform length
+	std::vector<float> cosN, sinN, cosM, sinM;
+
+	//kernel spectrum (transposed) and scratch images
+	float *kernelRe, *kernelIm;
+	float *re, *im, *tmp;
+};
\ No newline at end of file
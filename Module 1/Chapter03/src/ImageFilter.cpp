@@ -0,0 +1,420 @@
+#include "ImageFilter.h"
+#include "FFTConvolver.h"
+#include <glm/glm.hpp>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+//smallest power of two not less than n
+static int NextPowerOfTwo(int n) {
+	int p = 1;
+	while(p < n)
+		p <<= 1;
+	return p;
+}
+
+CImageFilter::CImageFilter(void)
+{
+	width = height = 0;
+	method = CConvolutionKernel::DIRECT;
+	vaoID = vboVerticesID = vboIndicesID = 0;
+	fboID = 0;
+	texID[0] = texID[1] = 0;
+	fftWidth = fftHeight = 0;
+	fftFboID = 0;
+	fftTexID[0] = fftTexID[1] = 0;
+	kernelTexID = 0;
+}
+
+CImageFilter::~CImageFilter(void)
+{
+}
+
+void CImageFilter::Init(const int w, const int h) {
+	width = w;
+	height = h;
+
+	//load the direct 2D convolution shader
+	directShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/image_filter.vert");
+	directShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/image_filter_direct.frag");
+	directShader.CreateAndLinkProgram();
+	directShader.Use();
+		directShader.AddAttribute("vVertex");
+		directShader.AddUniform("textureMap");
+		directShader.AddUniform("weights");
+		directShader.AddUniform("kernelSize");
+		glUniform1i(directShader("textureMap"), 0);
+	directShader.UnUse();
+
+	//load the 1D convolution shader used for the separable passes
+	separableShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/image_filter.vert");
+	separableShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/image_filter_separable.frag");
+	separableShader.CreateAndLinkProgram();
+	separableShader.Use();
+		separableShader.AddAttribute("vVertex");
+		separableShader.AddUniform("textureMap");
+		separableShader.AddUniform("weights");
+		separableShader.AddUniform("kernelSize");
+		separableShader.AddUniform("direction");
+		glUniform1i(separableShader("textureMap"), 0);
+	separableShader.UnUse();
+
+	//load the FFT shader, it pads, transforms, multiplies and crops
+	fftShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/image_filter.vert");
+	fftShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/image_filter_fft.frag");
+	fftShader.CreateAndLinkProgram();
+	fftShader.Use();
+		fftShader.AddAttribute("vVertex");
+		fftShader.AddUniform("textureMap");
+		fftShader.AddUniform("kernelMap");
+		fftShader.AddUniform("pass");
+		fftShader.AddUniform("offset");
+		fftShader.AddUniform("size");
+		fftShader.AddUniform("scale");
+		fftShader.AddUniform("direction");
+		fftShader.AddUniform("span");
+		fftShader.AddUniform("halfLength");
+		fftShader.AddUniform("sign");
+		glUniform1i(fftShader("textureMap"), 0);
+		glUniform1i(fftShader("kernelMap"), 1);
+	fftShader.UnUse();
+
+	//fullscreen quad
+	glm::vec2 vertices[4] = { glm::vec2(0,0), glm::vec2(1,0), glm::vec2(1,1), glm::vec2(0,1) };
+	GLushort indices[6] = { 0,1,2, 0,2,3 };
+
+	glGenVertexArrays(1, &vaoID);
+	glGenBuffers(1, &vboVerticesID);
+	glGenBuffers(1, &vboIndicesID);
+	glBindVertexArray(vaoID);
+		glBindBuffer(GL_ARRAY_BUFFER, vboVerticesID);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), &vertices[0], GL_STATIC_DRAW);
+		glEnableVertexAttribArray(directShader["vVertex"]);
+		glVertexAttribPointer(directShader["vVertex"], 2, GL_FLOAT, GL_FALSE, 0, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboIndicesID);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), &indices[0], GL_STATIC_DRAW);
+	glBindVertexArray(0);
+
+	//float render targets keep the negative and above one values of
+	//sharpening kernels and of partial sums of separable terms
+	glGenTextures(2, texID);
+	glActiveTexture(GL_TEXTURE0);
+	for(int i=0;i<2;i++) {
+		glBindTexture(GL_TEXTURE_2D, texID[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+	}
+
+	glGenFramebuffers(1, &fboID);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fboID);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texID[0], 0);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, texID[1], 0);
+	GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+	if(status != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr<<"Image filter FBO setup error."<<std::endl;
+		exit(EXIT_FAILURE);
+	}
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+	SetKernel(kernel);
+}
+
+void CImageFilter::Destroy() {
+	directShader.DeleteShaderProgram();
+	separableShader.DeleteShaderProgram();
+	fftShader.DeleteShaderProgram();
+
+	glDeleteBuffers(1, &vboVerticesID);
+	glDeleteBuffers(1, &vboIndicesID);
+	glDeleteVertexArrays(1, &vaoID);
+
+	glDeleteTextures(2, texID);
+	glDeleteFramebuffers(1, &fboID);
+
+	if(fftFboID) {
+		glDeleteTextures(2, fftTexID);
+		glDeleteTextures(1, &kernelTexID);
+		glDeleteFramebuffers(1, &fftFboID);
+		fftFboID = 0;
+		fftWidth = fftHeight = 0;
+	}
+}
+
+void CImageFilter::InitFFT(const int n, const int m) {
+	if(n == fftWidth && m == fftHeight)
+		return;
+	fftWidth = n;
+	fftHeight = m;
+
+	//the butterflies need full float precision and exact texel reads
+	if(!fftFboID) {
+		glGenTextures(2, fftTexID);
+		glGenTextures(1, &kernelTexID);
+		glGenFramebuffers(1, &fftFboID);
+	}
+	GLuint textures[3] = { fftTexID[0], fftTexID[1], kernelTexID };
+	glActiveTexture(GL_TEXTURE0);
+	for(int i=0;i<3;i++) {
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, fftWidth, fftHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+	}
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fftFboID);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fftTexID[0], 0);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, fftTexID[1], 0);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, kernelTexID, 0);
+	GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+	if(status != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr<<"Image filter FFT FBO setup error."<<std::endl;
+		exit(EXIT_FAILURE);
+	}
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+int CImageFilter::Transform(int src, const bool inverse) {
+	//log2(n) Stockham passes along the rows, then log2(m) along the columns,
+	//each pass reads one texture and writes the other
+	glUniform1i(fftShader("pass"), 1);
+	glUniform1f(fftShader("sign"), inverse? 1.0f : -1.0f);
+	for(int axis=0;axis<2;axis++) {
+		const int length = (axis==0)? fftWidth : fftHeight;
+		glUniform2i(fftShader("direction"), 1-axis, axis);
+		glUniform1i(fftShader("halfLength"), length/2);
+		for(int span=1;span<length;span<<=1) {
+			glDrawBuffer(GL_COLOR_ATTACHMENT0 + (1-src));
+			glBindTexture(GL_TEXTURE_2D, fftTexID[src]);
+			glUniform1i(fftShader("span"), span);
+			DrawQuad();
+			src = 1-src;
+		}
+	}
+	return src;
+}
+
+void CImageFilter::SetKernel(const CConvolutionKernel& k) {
+	kernel = k;
+	method = kernel.GetMethod();
+
+	//the separable shader has a fixed weight array
+	if(method == CConvolutionKernel::SEPARABLE &&
+	   glm::max(kernel.GetWidth(), kernel.GetHeight()) > MAX_SEPARABLE_TAPS)
+		method = CConvolutionKernel::FFT;
+
+	if(method != CConvolutionKernel::FFT || width==0)
+		return;
+
+	//pad so that the linear convolution does not wrap around
+	InitFFT(NextPowerOfTwo(width + kernel.GetWidth() - 1),
+			NextPowerOfTwo(height + kernel.GetHeight() - 1));
+
+	//upload the kernel with its origin at the first texel and keep its
+	//spectrum, the kernel goes into the first of the two complex numbers
+	std::vector<float> padded(size_t(kernel.GetWidth())*kernel.GetHeight()*4, 0.0f);
+	for(int i=0;i<kernel.GetWidth()*kernel.GetHeight();i++)
+		padded[i*4] = kernel.GetWeights()[i];
+
+	const GLfloat zero[4] = {0,0,0,0};
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fftFboID);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	glClearBufferfv(GL_COLOR, 0, zero);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, fftTexID[0]);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, kernel.GetWidth(), kernel.GetHeight(), GL_RGBA, GL_FLOAT, &padded[0]);
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glViewport(0, 0, fftWidth, fftHeight);
+	fftShader.Use();
+		int result = Transform(0, false);
+
+		//copy the spectrum into the kernel texture
+		glUniform1i(fftShader("pass"), 0);
+		glUniform2i(fftShader("offset"), 0, 0);
+		glUniform2i(fftShader("size"), fftWidth, fftHeight);
+		glUniform1f(fftShader("scale"), 1.0f);
+		glDrawBuffer(GL_COLOR_ATTACHMENT2);
+		glBindTexture(GL_TEXTURE_2D, fftTexID[result]);
+		DrawQuad();
+	fftShader.UnUse();
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+void CImageFilter::DrawQuad() {
+	glBindVertexArray(vaoID);
+		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+	glBindVertexArray(0);
+}
+
+GLuint CImageFilter::Apply(GLuint srcTexture) {
+	glActiveTexture(GL_TEXTURE0);
+
+	if(method == CConvolutionKernel::FFT) {
+		//RGBA is transformed as the two complex numbers (R,G) and (B,A). The
+		//kernel is real so their real and imaginary parts stay separate.
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fftFboID);
+		glViewport(0, 0, fftWidth, fftHeight);
+		fftShader.Use();
+			//zero pad the image
+			glUniform1i(fftShader("pass"), 0);
+			glUniform2i(fftShader("offset"), 0, 0);
+			glUniform2i(fftShader("size"), width, height);
+			glUniform1f(fftShader("scale"), 1.0f);
+			glDrawBuffer(GL_COLOR_ATTACHMENT0);
+			glBindTexture(GL_TEXTURE_2D, srcTexture);
+			DrawQuad();
+
+			int result = Transform(0, false);
+
+			//multiply with the kernel spectrum
+			glUniform1i(fftShader("pass"), 2);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, kernelTexID);
+			glActiveTexture(GL_TEXTURE0);
+			glDrawBuffer(GL_COLOR_ATTACHMENT0 + (1-result));
+			glBindTexture(GL_TEXTURE_2D, fftTexID[result]);
+			DrawQuad();
+
+			result = Transform(1-result, true);
+
+			//the kernel centre was at the origin, so the output is shifted by
+			//it. Crop the image and apply the 1/(n*m) of the inverse transform.
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fboID);
+			glViewport(0, 0, width, height);
+			glDrawBuffer(GL_COLOR_ATTACHMENT0);
+			glUniform1i(fftShader("pass"), 0);
+			glUniform2i(fftShader("offset"), kernel.GetWidth()/2, kernel.GetHeight()/2);
+			glUniform2i(fftShader("size"), fftWidth, fftHeight);
+			glUniform1f(fftShader("scale"), 1.0f/(float(fftWidth)*fftHeight));
+			glBindTexture(GL_TEXTURE_2D, fftTexID[result]);
+			DrawQuad();
+		fftShader.UnUse();
+
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		return texID[0];
+	}
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fboID);
+	glViewport(0, 0, width, height);
+
+	if(method == CConvolutionKernel::DIRECT) {
+		glDrawBuffer(GL_COLOR_ATTACHMENT0);
+		glBindTexture(GL_TEXTURE_2D, srcTexture);
+		directShader.Use();
+			glUniform1fv(directShader("weights"), kernel.GetWidth()*kernel.GetHeight(), kernel.GetWeights());
+			glUniform2i(directShader("kernelSize"), kernel.GetWidth(), kernel.GetHeight());
+			DrawQuad();
+		directShader.UnUse();
+	} else {
+		//a horizontal and a vertical pass for each separable term, the
+		//vertical passes add their result to the previous terms
+		separableShader.Use();
+		for(int term=0;term<kernel.GetRank();term++) {
+			glDrawBuffer(GL_COLOR_ATTACHMENT1);
+			glBindTexture(GL_TEXTURE_2D, srcTexture);
+			glUniform1fv(separableShader("weights"), kernel.GetWidth(), kernel.GetRow(term));
+			glUniform1i(separableShader("kernelSize"), kernel.GetWidth());
+			glUniform2f(separableShader("direction"), 1, 0);
+			DrawQuad();
+
+			glDrawBuffer(GL_COLOR_ATTACHMENT0);
+			glBindTexture(GL_TEXTURE_2D, texID[1]);
+			glUniform1fv(separableShader("weights"), kernel.GetHeight(), kernel.GetColumn(term));
+			glUniform1i(separableShader("kernelSize"), kernel.GetHeight());
+			glUniform2f(separableShader("direction"), 0, 1);
+			if(term>0) {
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_ONE, GL_ONE);
+			}
+			DrawQuad();
+			glDisable(GL_BLEND);
+		}
+		separableShader.UnUse();
+	}
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	return texID[0];
+}
+
+void CImageFilter::ApplyCPU(const CConvolutionKernel& kernel, const float* src, float* dst,
+							const int width, const int height, const int channels) {
+	const int kw = kernel.GetWidth(), kh = kernel.GetHeight();
+	const int cx = kw/2, cy = kh/2;
+	const size_t total = size_t(width)*height*channels;
+
+	switch(kernel.GetMethod()) {
+		case CConvolutionKernel::DIRECT: {
+			const float* w = kernel.GetWeights();
+			for(int y=0;y<height;y++) {
+				for(int x=0;x<width;x++) {
+					float* d = dst + (size_t(y)*width+x)*channels;
+					for(int c=0;c<channels;c++)
+						d[c] = 0;
+					for(int j=0;j<kh;j++) {
+						int sy = y+cy-j;
+						if(sy<0 || sy>=height)
+							continue;
+						for(int i=0;i<kw;i++) {
+							int sx = x+cx-i;
+							if(sx<0 || sx>=width)
+								continue;
+							const float* s = src + (size_t(sy)*width+sx)*channels;
+							for(int c=0;c<channels;c++)
+								d[c] += w[j*kw+i]*s[c];
+						}
+					}
+				}
+			}
+		} break;
+
+		case CConvolutionKernel::SEPARABLE: {
+			std::vector<float> horizontal(total);
+			for(size_t i=0;i<total;i++)
+				dst[i] = 0;
+			for(int term=0;term<kernel.GetRank();term++) {
+				const float* row = kernel.GetRow(term);
+				const float* column = kernel.GetColumn(term);
+				for(int y=0;y<height;y++) {
+					for(int x=0;x<width;x++) {
+						float* h = &horizontal[(size_t(y)*width+x)*channels];
+						for(int c=0;c<channels;c++)
+							h[c] = 0;
+						for(int i=0;i<kw;i++) {
+							int sx = x+cx-i;
+							if(sx<0 || sx>=width)
+								continue;
+							const float* s = src + (size_t(y)*width+sx)*channels;
+							for(int c=0;c<channels;c++)
+								h[c] += row[i]*s[c];
+						}
+					}
+				}
+				//the vertical pass walks whole rows so the inner loop is contiguous
+				for(int y=0;y<height;y++) {
+					float* d = dst + size_t(y)*width*channels;
+					for(int j=0;j<kh;j++) {
+						int sy = y+cy-j;
+						if(sy<0 || sy>=height)
+							continue;
+						const float* h = &horizontal[size_t(sy)*width*channels];
+						for(int i=0;i<width*channels;i++)
+							d[i] += column[j]*h[i];
+					}
+				}
+			}
+		} break;
+
+		case CConvolutionKernel::FFT: {
+			CFFTConvolver convolver;
+			convolver.SetKernel(kernel, width, height);
+			convolver.Convolve(src, dst, channels);
+		} break;
+	}
+}
\ No newline at end of file
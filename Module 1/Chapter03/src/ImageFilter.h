@@ -0,0 +1,64 @@
+#pragma once
+#include <GL/glew.h>
+#include "GLSLShader.h"
+#include "ConvolutionKernel.h"
+
+//Applies an arbitrary convolution kernel to a texture. The kernel decides
+//the method: small kernels use a direct 2D loop, low rank kernels a pair of
+//1D passes per separable term and large kernels of high rank FFT convolution.
+//The FFT runs as radix 2 butterfly passes that ping-pong between two float
+//textures, so the image never leaves the GPU. All methods compute the same
+//result. Pixels outside the image are zero, as with a GL_CLAMP_TO_BORDER
+//source texture. Needs the shaders image_filter.vert, image_filter_direct.frag,
+//image_filter_separable.frag and image_filter_fft.frag.
+class CImageFilter
+{
+public:
+	//longest 1D kernel the separable pass takes
+	static const int MAX_SEPARABLE_TAPS = 127;
+
+	CImageFilter(void);
+	~CImageFilter(void);
+
+	//create the shaders and render targets for images of the given size
+	void Init(const int width, const int height);
+	void Destroy();
+
+	void SetKernel(const CConvolutionKernel& kernel);
+	const CConvolutionKernel& GetKernel() const { return kernel; }
+	CConvolutionKernel::Method GetMethod() const { return method; }
+
+	//filter the given texture (of the size given to Init) and return the
+	//texture holding the result. Changes the bound framebuffer, viewport,
+	//program and texture unit 0 binding.
+	GLuint Apply(GLuint srcTexture);
+
+	//filters an image in memory without OpenGL, for headless runs
+	static void ApplyCPU(const CConvolutionKernel& kernel, const float* src, float* dst,
+						 const int width, const int height, const int channels);
+
+private:
+	void DrawQuad();
+	//create the FFT render targets for a transform of the given size
+	void InitFFT(const int n, const int m);
+	//FFT of the image in fftTexID[src] along the rows and the columns, returns
+	//the index of the texture holding the result. The inverse is not scaled.
+	int Transform(int src, const bool inverse);
+
+	int width, height;
+	CConvolutionKernel kernel;
+	CConvolutionKernel::Method method;
+
+	GLSLShader directShader, separableShader, fftShader;
+	GLuint vaoID, vboVerticesID, vboIndicesID;
+	GLuint fboID;
+	GLuint texID[2];	//0 -> result, 1 -> result of the horizontal pass
+
+	//FFT convolution: transform width and height, the padded image and its
+	//spectrum ping-pong between fftTexID[0] and [1], the kernel spectrum is
+	//kept in kernelTexID
+	int fftWidth, fftHeight;
+	GLuint fftFboID;
+	GLuint fftTexID[2];
+	GLuint kernelTexID;
+};
\ No newline at end of file
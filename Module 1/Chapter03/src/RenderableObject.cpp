@@ -68,6 +68,15 @@ void RenderableObject::Render(const GLfloat* MVP) {
 	shader.UnUse();
 }
 
+void RenderableObject::RenderGeometry(const int instances) {
+	glBindVertexArray(vaoID);
+		if(instances>1)
+			glDrawElementsInstanced(primType, totalIndices, GL_UNSIGNED_INT, 0, instances);
+		else
+			glDrawElements(primType, totalIndices, GL_UNSIGNED_INT, 0);
+	glBindVertexArray(0);
+}
+
 void RenderableObject::SetCustomUniforms() {
 
 }
\ No newline at end of file
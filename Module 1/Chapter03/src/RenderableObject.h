@@ -7,6 +7,10 @@ public:
 	RenderableObject(void);
 	virtual ~RenderableObject(void);
 	void Render(const float* MVP);
+
+	//draws the geometry with the currently bound shader instead of the object's
+	//own one, e.g. to render several instances into all cubemap faces at once
+	void RenderGeometry(const int instances=1);
 	
 	virtual int GetTotalVertices()=0;
 	virtual int GetTotalIndices()=0;
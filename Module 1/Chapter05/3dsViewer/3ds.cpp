@@ -1,149 +1,444 @@
 #include "3ds.h"
+#include "..\src\MappedFile.h"
+#include "..\src\ThreadPool.h"
+#include "..\src\Timer.h"
 
 C3dsLoader::C3dsLoader() {
-
+	startFrame = endFrame = 0;
 }
 
 C3dsLoader::~C3dsLoader() {
 
 }
 
-#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <map>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+//a chunk of the file, the chunks are indexed in file order so the
+//subchunks of a chunk follow it
+struct Chunk {
+	unsigned short id;
+	const char* data;	//contents after the chunk header
+	unsigned int size;	//size of the contents, subchunks included
+	int parent;			//index of the parent chunk, -1 for the main chunk
+	int end;			//index after the last subchunk
+};
+
+//a named list of faces using a material
+struct MaterialGroup {
+	std::string material;
+	vector<unsigned short> face_ids;
+};
+
+//a mesh parsed by a thread pool task
+struct MeshTask {
+	int chunk;
+	C3dsMesh* pMesh;
+	vector<MaterialGroup> groups;
+	bool ok;
+};
+
+struct MeshTasks {
+	const vector<Chunk>* chunks;
+	vector<MeshTask>* tasks;
+};
+
+template<typename T>
+static T Read(const char* p) {
+	T value;
+	memcpy(&value, p, sizeof(T));
+	return value;
+}
 
-bool C3dsLoader::Load3DS(const std::string& filename, std::vector<C3dsMesh*>& meshes, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<glm::vec2>& uvs, std::vector<Face>& faces, std::vector<unsigned short>& indices, std::vector<Material*>& materials) {
-	ifstream infile(filename, std::ios::in|std::ios::binary);
-
-	if(infile.bad())
-		return false;
-
-	long beg=0,end=0;
-	infile.seekg(0, std::ios::beg); 
-	beg = (long)infile.tellg();     
-	infile.seekg(0, std::ios::end);
-	end = (long)infile.tellg();
-	infile.seekg(0, std::ios::beg); 
-	long fileSize = (end - beg);
+//reads a null terminated string that must end within size bytes, returns
+//its length including the terminator or 0 when it does not
+static unsigned int ReadName(const char* p, const unsigned int size, std::string& name) {
+	const char* end = static_cast<const char*>(memchr(p, 0, size));
+	if(!end)
+		return 0;
+	name.assign(p, end);
+	return (unsigned int)(end-p)+1;
+}
 
-	unsigned short chunk_id;
-	unsigned int chunk_length;
+//offset of the subchunks in the contents of a chunk, -1 for chunks that
+//have no subchunks. Returns false when the chunk is malformed.
+static bool GetSubchunkOffset(const unsigned short id, const char* data, const unsigned int size, int& offset) {
+	offset = -1;
+	switch(id) {
+	case 0x4d4d://Main chunk
+	case 0x3d3d://3D editor
+	case 0x4100://Triangular mesh
+	case 0xafff://Material
+	case 0xa010://Ambient color
+	case 0xa020://Diffuse color
+	case 0xa030://Specular color
+	case 0xa040://Shininess
+	case 0xa041://Shininess strength
+	case 0xa050://Transparency
+	case 0xa052://Transparency falloff
+	case 0xa053://Reflection blur
+	case 0xa084://Self illumination
+	case 0xa200://Texture map 1
+	case 0xa33a://Texture map 2
+	case 0xa210://Opacity map
+	case 0xa230://Bump map
+	case 0xa33c://Shininess map
+	case 0xa204://Specular map
+	case 0xa33d://Self illum. map
+	case 0xa220://Reflection map
+	case 0xa33E://Mask for texture map 1
+	case 0xa340://Mask for texture map 2
+	case 0xa342://Mask for opacity map
+	case 0xa344://Mask for bump map
+	case 0xa346://Mask for shininess map
+	case 0xa348://Mask for specular map
+	case 0xa34A://Mask for self illum. map
+	case 0xa34C://Mask for reflection map
+	case 0xb000://Keyframer
+	case 0xb002://Object node
+		offset = 0;
+		return true;
+
+	case 0x4000: {//Object, the name comes first
+		const char* end = static_cast<const char*>(memchr(data, 0, size));
+		offset = end? int(end-data)+1 : -1;
+		return end!=0;
+	}
 
-	Material* pMaterial=0;
-	TextureMap* pCurrentTextureMap=0;
-	float* pColorChannel=0;
-	float* pPercent=0;
-	C3dsMesh* pMesh = 0;
+	case 0x4120: {//Faces, the face list comes first
+		if(size<2)
+			return false;
+		offset = 2 + Read<unsigned short>(data)*int(sizeof(Face));
+		return (unsigned int)(offset)<=size;
+	}
+	}
+	return true;
+}
 
-	int totalFaces = 0; 
-	int totalVertices = 0;
-	while(infile.tellg() < fileSize) {
-		infile.read(reinterpret_cast<char*>(&chunk_id), 2);
-		infile.read(reinterpret_cast<char*>(&chunk_length), 4);  
-
-		//std::cout<<"Chunk: "<<chunk_id<<" Length: "<<chunk_length<<std::endl;
-
-		switch(chunk_id) {
-		case 0x4d4d: break;
-		case 0x3d3d: break;
-		case 0x4000: {
-			std::string name = "";
-			char c = ' ';
-			while(c!='\0') {
-				infile.read(&c,1);
-				name.push_back(c);
-			} 
-			if(pMesh != NULL) {
-				totalFaces += pMesh->faces.size();
-				totalVertices += pMesh->vertices.size();
-			}
-			pMesh =new C3dsMesh(name);
-			
-			meshes.push_back(pMesh);
-		} break;
+//deepest chunk nesting accepted, real files stay well below this. Limits the
+//recursion of IndexChunks on files that nest containers over and over.
+const int MAX_CHUNK_DEPTH = 16;
 
-		case 0x4100:
-			break;
+//builds the chunk index of the given contents in a single pass, fails on
+//chunks that do not fit into their parent or nest deeper than MAX_CHUNK_DEPTH
+static bool IndexChunks(const char* data, const unsigned int size, const int parent, const int depth, vector<Chunk>& chunks) {
+	if(depth>=MAX_CHUNK_DEPTH)
+		return false;
+	unsigned int pos = 0;
+	while(pos<size) {
+		if(size-pos<6)
+			return false;
+		const unsigned short id = Read<unsigned short>(data+pos);
+		const unsigned int length = Read<unsigned int>(data+pos+2);
+		if(length<6 || length>size-pos)
+			return false;
+
+		Chunk chunk = {id, data+pos+6, length-6, parent, 0};
+		const int index = int(chunks.size());
+		chunks.push_back(chunk);
+
+		int offset;
+		if(!GetSubchunkOffset(id, chunk.data, chunk.size, offset))
+			return false;
+		if(offset>=0 && !IndexChunks(chunk.data+offset, chunk.size-offset, index, depth+1, chunks))
+			return false;
+		chunks[index].end = int(chunks.size());
+		pos += length;
+	}
+	return true;
+}
 
-		case 0x4110: {
-			unsigned short total_vertices=0;
-			infile.read(reinterpret_cast<char*>(&total_vertices), 2);
+//parses the triangular mesh of an object chunk
+static void ParseMesh(int task, void* data) {
+	MeshTasks* pTasks = static_cast<MeshTasks*>(data);
+	const vector<Chunk>& chunks = *pTasks->chunks;
+	MeshTask& t = (*pTasks->tasks)[task];
+	C3dsMesh* pMesh = t.pMesh;
+	t.ok = false;
+
+	for(int i=t.chunk+1;i<chunks[t.chunk].end;i++) {
+		const Chunk& c = chunks[i];
+		switch(c.id) {
+		case 0x4110: {//Vertices
+			if(c.size<2)
+				return;
+			const unsigned short total_vertices = Read<unsigned short>(c.data);
+			if(2 + total_vertices*sizeof(glm::vec3) > c.size)
+				return;
 			pMesh->vertices.resize(total_vertices);
-			infile.read(reinterpret_cast<char*>(&pMesh->vertices[0].x), sizeof(glm::vec3)*total_vertices); 
-		}break;
+			if(total_vertices>0)
+				memcpy(&pMesh->vertices[0].x, c.data+2, sizeof(glm::vec3)*total_vertices);
+		} break;
 
-		case 0x4120: {
-			unsigned short total_tris=0;
-			infile.read(reinterpret_cast<char*>(&total_tris), 2);
+		case 0x4120: {//Faces, the size was checked by the index
+			const unsigned short total_tris = Read<unsigned short>(c.data);
 			pMesh->faces.resize(total_tris);
-			infile.read(reinterpret_cast<char*>(&pMesh->faces[0].a), sizeof(Face)*total_tris);
-			for(size_t j=0;j<pMesh->faces.size();j++) {
-				pMesh->faces[j].a += totalVertices;
-				pMesh->faces[j].b += totalVertices;
-				pMesh->faces[j].c += totalVertices;
-			}
-		}break;
-
-		case 0x4130: {
-			std::string name = "";
-			char c = ' ';
-			while(c!='\0') {
-				infile.read(&c,1);
-				name.push_back(c);
-			} 
-			unsigned short total_enteries=0;
-			infile.read(reinterpret_cast<char*>(&total_enteries), 2);
-
-			//find the material in the materials list
-			Material* pMat = 0;
-			for(size_t i=0;i<materials.size();i++) {
-				if(name.compare(materials[i]->name)==0) {
-					pMat = materials[i];
-					break;
-				}
-			}			 
+			if(total_tris>0)
+				memcpy(&pMesh->faces[0].a, c.data+2, sizeof(Face)*total_tris);
+		} break;
 
-			unsigned short face_id;
-			for(size_t i=0;i<total_enteries;i++) {
-				infile.read(reinterpret_cast<char*>(&face_id), 2);
-				pMat->face_ids.push_back(face_id + totalFaces); 
-			}
+		case 0x4130: {//Faces using a material
+			MaterialGroup group;
+			const unsigned int length = ReadName(c.data, c.size, group.material);
+			if(length==0 || length+2 > c.size)
+				return;
+			const unsigned short total_entries = Read<unsigned short>(c.data+length);
+			if(length + 2 + total_entries*2 > c.size)
+				return;
+			group.face_ids.resize(total_entries);
+			if(total_entries>0)
+				memcpy(&group.face_ids[0], c.data+length+2, 2*total_entries);
+			t.groups.push_back(group);
 		} break;
 
-		case 0x4140: {
-			unsigned short total_uvs=0;
-			infile.read(reinterpret_cast<char*>(&total_uvs), 2);
+		case 0x4140: {//Texture coordinates
+			if(c.size<2)
+				return;
+			const unsigned short total_uvs = Read<unsigned short>(c.data);
+			if(2 + total_uvs*sizeof(glm::vec2) > c.size)
+				return;
 			pMesh->uvs.resize(total_uvs);
-			infile.read(reinterpret_cast<char*>(&pMesh->uvs[0].x), sizeof(glm::vec2)*total_uvs);
-		}break;
+			if(total_uvs>0)
+				memcpy(&pMesh->uvs[0].x, c.data+2, sizeof(glm::vec2)*total_uvs);
+		} break;
 
-		case 0x4150: {
-			unsigned int id = 0;
+		case 0x4150: {//Smoothing groups, one per face
+			if(pMesh->faces.size()*4 > c.size)
+				return;
 			pMesh->smoothing_groups.resize(pMesh->faces.size());
-			for(size_t i=0;i<pMesh->faces.size();i++) {
-				infile.read(reinterpret_cast<char*>(&(pMesh->smoothing_groups[i])), 4);
-			}
+			if(!pMesh->faces.empty())
+				memcpy(&pMesh->smoothing_groups[0], c.data, 4*pMesh->faces.size());
 		} break;
-		
-		case 0x4160: {
-			float transform[4][3]={0};  
-			infile.read(reinterpret_cast<char*>(&transform[0][0]), 12*sizeof(float)); 
 
-		
-			pMesh->transform = glm::mat4(transform[0][0],transform[0][1],transform[0][2],0,
+		case 0x4160: {//Mesh matrix, the rows are the axes and the origin
+			if(c.size<12*sizeof(float))
+				return;
+			float transform[4][3];
+			memcpy(&transform[0][0], c.data, 12*sizeof(float));
+			pMesh->matrix = glm::mat4(transform[0][0],transform[0][1],transform[0][2],0,
 				transform[1][0],transform[1][1],transform[1][2],0,
 				transform[2][0],transform[2][1],transform[2][2],0,
-				transform[3][0],transform[3][1],transform[3][2],1)  ;
+				transform[3][0],transform[3][1],transform[3][2],1);
+		} break;
+		}
+	}
+	//the faces must index the mesh vertices
+	for(size_t j=0;j<pMesh->faces.size();j++) {
+		const Face& f = pMesh->faces[j];
+		if(f.a>=pMesh->vertices.size() || f.b>=pMesh->vertices.size() || f.c>=pMesh->vertices.size())
+			return;
+	}
+	for(size_t j=0;j<t.groups.size();j++) {
+		for(size_t k=0;k<t.groups[j].face_ids.size();k++) {
+			if(t.groups[j].face_ids[k]>=pMesh->faces.size())
+				return;
+		}
+	}
+	t.ok = true;
+}
 
-			for (int j=0;j<4;j++) {
-				for (int i=0;i<3;i++)
-					cout<<transform[j][i]<<" ";
-				cout<<endl;
-			}
-			cout<<"------------------------"<<endl;
+//reads a keyframer track. Every key has a frame number, spline flags that
+//tell which of the five spline parameters follow and the value. The spline
+//parameters are skipped, keys are interpolated linearly.
+static bool ReadTrack(const Chunk& c, const int valueSize, vector<int>& frames, vector<float>& values) {
+	//flags, two unused integers and the number of keys
+	if(c.size<14)
+		return false;
+	const unsigned int total_keys = Read<unsigned int>(c.data+10);
+	unsigned int pos = 14;
+	for(unsigned int i=0;i<total_keys;i++) {
+		if(pos+6 > c.size)
+			return false;
+		const int frame = Read<int>(c.data+pos);
+		const unsigned short flags = Read<unsigned short>(c.data+pos+4);
+		pos += 6;
+		for(int bit=0;bit<5;bit++)
+			if(flags & (1<<bit))
+				pos += 4;
+		if(pos + valueSize*sizeof(float) > c.size)
+			return false;
+		frames.push_back(frame);
+		for(int k=0;k<valueSize;k++)
+			values.push_back(Read<float>(c.data+pos+k*4));
+		pos += valueSize*4;
+	}
+	return true;
+}
+
+//reads an object node of the keyframer
+static bool ParseNode(const vector<Chunk>& chunks, const int index, C3dsNode& node, int& parentId) {
+	parentId = -1;
+	for(int i=index+1;i<chunks[index].end;i++) {
+		const Chunk& c = chunks[i];
+		vector<int> frames;
+		vector<float> values;
+		switch(c.id) {
+		case 0xb030://Node id
+			if(c.size<2)
+				return false;
+			node.id = Read<unsigned short>(c.data);
+			break;
+
+		case 0xb010: {//Node header, name, two flags and the parent id
+			const unsigned int length = ReadName(c.data, c.size, node.name);
+			if(length==0 || length+6 > c.size)
+				return false;
+			const short parent = Read<short>(c.data+length+4);
+			parentId = (parent<0)? -1 : parent;
 		} break;
 
+		case 0xb013://Pivot
+			if(c.size<3*sizeof(float))
+				return false;
+			memcpy(&node.pivot.x, c.data, 3*sizeof(float));
+			break;
+
+		case 0xb020://Position track
+		case 0xb022://Scale track
+			if(!ReadTrack(c, 3, frames, values))
+				return false;
+			for(size_t k=0;k<frames.size();k++) {
+				C3dsVectorKey key;
+				key.frame = frames[k];
+				key.value = glm::vec3(values[k*3], values[k*3+1], values[k*3+2]);
+				if(c.id==0xb020)
+					node.positions.push_back(key);
+				else
+					node.scales.push_back(key);
+			}
+			break;
+
+		case 0xb021://Rotation track
+			if(!ReadTrack(c, 4, frames, values))
+				return false;
+			for(size_t k=0;k<frames.size();k++) {
+				//angle and axis, every key rotates relative to the previous
+				//one and 3DS angles turn the other way
+				const float angle = -values[k*4]*0.5f;
+				glm::vec3 axis(values[k*4+1], values[k*4+2], values[k*4+3]);
+				const float len = glm::length(axis);
+				axis = (len>0)? axis*(sinf(angle)/len) : glm::vec3(0);
+				C3dsRotationKey key;
+				key.frame = frames[k];
+				key.value = glm::quat(cosf(angle), axis.x, axis.y, axis.z);
+				if(!node.rotations.empty())
+					key.value = key.value*node.rotations.back().value;
+				node.rotations.push_back(key);
+			}
+			break;
+		}
+	}
+	return true;
+}
+
+//finds the keys around the frame and the interpolation factor between them
+template<typename Key>
+static int FindKey(const vector<Key>& keys, const float frame, float& t) {
+	t = 0;
+	if(frame<=keys[0].frame)
+		return 0;
+	size_t i = 0;
+	while(i+1<keys.size() && keys[i+1].frame<=frame)
+		i++;
+	if(i+1<keys.size())
+		t = (frame-keys[i].frame)/float(keys[i+1].frame-keys[i].frame);
+	return int(i);
+}
+
+static glm::vec3 Evaluate(const vector<C3dsVectorKey>& keys, const float frame, const glm::vec3& value) {
+	if(keys.empty())
+		return value;
+	float t;
+	const int i = FindKey(keys, frame, t);
+	return (t>0)? glm::mix(keys[i].value, keys[i+1].value, t) : keys[i].value;
+}
+
+static glm::quat Evaluate(const vector<C3dsRotationKey>& keys, const float frame) {
+	if(keys.empty())
+		return glm::quat(1,0,0,0);
+	float t;
+	const int i = FindKey(keys, frame, t);
+	return (t>0)? glm::normalize(glm::mix(keys[i].value, keys[i+1].value, t)) : keys[i].value;
+}
+
+void C3dsLoader::EvaluateTransforms(const float frame, std::vector<C3dsMesh*>& meshes) {
+	//local transforms first, then the hierarchy. The parent of a node may
+	//come after it in the file, so every node waits for its parent.
+	vector<glm::mat4> local(nodes.size());
+	vector<bool> done(nodes.size(), false);
+	for(size_t i=0;i<nodes.size();i++) {
+		const C3dsNode& node = nodes[i];
+		glm::mat4 T = glm::translate(glm::mat4(1), Evaluate(node.positions, frame, glm::vec3(0)));
+		glm::mat4 R = glm::mat4_cast(Evaluate(node.rotations, frame));
+		glm::mat4 S = glm::scale(glm::mat4(1), Evaluate(node.scales, frame, glm::vec3(1)));
+		local[i] = T*R*S;
+	}
+	size_t total_done = 0;
+	while(total_done<nodes.size()) {
+		for(size_t i=0;i<nodes.size();i++) {
+			C3dsNode& node = nodes[i];
+			if(done[i] || (node.parent>=0 && !done[node.parent]))
+				continue;
+			node.matrix = (node.parent>=0)? nodes[node.parent].matrix*local[i] : local[i];
+			done[i] = true;
+			total_done++;
+		}
+	}
 
-		case 0xa200://Texture map 1 
+	//the vertices are saved transformed by the mesh matrix, the node places
+	//the mesh relative to its pivot
+	for(size_t i=0;i<nodes.size();i++) {
+		const C3dsNode& node = nodes[i];
+		if(node.mesh<0)
+			continue;
+		C3dsMesh* pMesh = meshes[node.mesh];
+		const glm::mat4& M = pMesh->matrix;
+		glm::mat4 invM = (fabs(glm::determinant(M))>1e-12f)? glm::inverse(M) : glm::mat4(1);
+		pMesh->transform = node.matrix*glm::translate(glm::mat4(1), -node.pivot)*invM;
+	}
+}
+
+bool C3dsLoader::Load3DS(const std::string& filename, std::vector<C3dsMesh*>& meshes, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<glm::vec2>& uvs, std::vector<unsigned int>& indices, std::vector<Material*>& materials) {
+	CTimer timer;
+	nodes.clear();
+	startFrame = endFrame = 0;
+
+	//map the file and index all of its chunks
+	CMappedFile file;
+	if(!file.Open(filename))
+		return false;
+	vector<Chunk> chunks;
+	const char* data = file.GetData();
+	if(file.GetSize()<6 || Read<unsigned short>(data)!=0x4d4d ||
+	   !IndexChunks(data, std::min<size_t>(Read<unsigned int>(data+2), file.GetSize()), -1, 0, chunks)) {
+		cout<<"Malformed 3ds file "<<filename<<endl;
+		return false;
+	}
+
+	//read the materials and create a parsing task for every mesh
+	vector<MeshTask> tasks;
+	Material* pMaterial=0;
+	TextureMap* pCurrentTextureMap=0;
+	bool ok = true;
+	for(size_t i=0;i<chunks.size() && ok;i++) {
+		const Chunk& c = chunks[i];
+		const unsigned short parent_id = (c.parent>=0)? chunks[c.parent].id : 0;
+
+		switch(c.id) {
+		case 0x4100: {
+			ok = (parent_id==0x4000);
+			MeshTask t;
+			t.chunk = c.parent;
+			t.pMesh = 0;
+			t.ok = false;
+			tasks.push_back(t);
+		} break;
+
+		case 0xa200://Texture map 1
 		case 0xa33a://Texture map 2
 		case 0xa210://Opacity map
 		case 0xa230://Bump map
@@ -157,187 +452,241 @@ bool C3dsLoader::Load3DS(const std::string& filename, std::vector<C3dsMesh*>& me
 		case 0xa344://Mask for bump map
 		case 0xa346://Mask for shininess map
 		case 0xa348://Mask for specular map
-		case 0xa34A://Mask for self illum. map			
-		case 0xa34C://Mask for reflection map	
-		{
-			pMaterial->textureMaps.push_back(new TextureMap());
-			pCurrentTextureMap = pMaterial->textureMaps[pMaterial->textureMaps.size()-1]; 
-		}
-		break; 
-
-		case 0xa300://Mapping filename
+		case 0xa34A://Mask for self illum. map
+		case 0xa34C://Mask for reflection map
 		{
-			std::string name = "";
-			char c = ' ';
-			while(c!='\0') {
-				infile.read(&c,1);
-				name.push_back(c);
-			} 
-			pCurrentTextureMap->filename = name; 
+			ok = (pMaterial!=0);
+			if(ok) {
+				pMaterial->textureMaps.push_back(new TextureMap());
+				pCurrentTextureMap = pMaterial->textureMaps[pMaterial->textureMaps.size()-1];
+			}
 		}
 		break;
 
-		case 0xa351://Mapping parameters 
-			infile.seekg(chunk_length-6, std::ios::cur);
-			break;
-
-		case 0xa353://Blur percent 
-			infile.read(reinterpret_cast<char*>(& pCurrentTextureMap->blur_percent ), sizeof(float)); 
-			break;
-
-		case 0xa354://V scale	
-			infile.read(reinterpret_cast<char*>(& pCurrentTextureMap->UVscale[1] ), sizeof(float)); 
+		case 0xa300://Mapping filename
+			ok = (pCurrentTextureMap!=0) && ReadName(c.data, c.size, pCurrentTextureMap->filename)>0;
 			break;
 
+		case 0xa353://Blur percent
+		case 0xa354://V scale
 		case 0xa356://U scale
-			infile.read(reinterpret_cast<char*>(& pCurrentTextureMap->UVscale[0] ), sizeof(float)); 
-			break;
-
 		case 0xa358://U offset
-			infile.read(reinterpret_cast<char*>(& pCurrentTextureMap->UVoffset[0] ), sizeof(float)); 
-			break;
-
 		case 0xa35A://V offset
-			infile.read(reinterpret_cast<char*>(& pCurrentTextureMap->UVoffset[1] ), sizeof(float)); 
-			break;
-
 		case 0xa35C://Rotation angle
-			infile.read(reinterpret_cast<char*>(& pCurrentTextureMap->rotation_angle ), sizeof(float)); 				  
-			break;
+		{
+			ok = (pCurrentTextureMap!=0) && c.size>=sizeof(float);
+			if(!ok)
+				break;
+			float* pValue = (c.id==0xa353)? &pCurrentTextureMap->blur_percent :
+							(c.id==0xa354)? &pCurrentTextureMap->UVscale[1] :
+							(c.id==0xa356)? &pCurrentTextureMap->UVscale[0] :
+							(c.id==0xa358)? &pCurrentTextureMap->UVoffset[0] :
+							(c.id==0xa35A)? &pCurrentTextureMap->UVoffset[1] : &pCurrentTextureMap->rotation_angle;
+			*pValue = Read<float>(c.data);
+		} break;
 
 		case 0xa360://RGB Luma/Alpha tint 1
-			infile.read(reinterpret_cast<char*>(& pCurrentTextureMap->rgbLumAlphaTint1[0] ), 3*sizeof(float)); 
-			break;
-
 		case 0xa362://RGB Luma/Alpha tint 2
-			infile.read(reinterpret_cast<char*>(& pCurrentTextureMap->rgbLumAlphaTint2[0] ), 3*sizeof(float)); 
+			ok = (pCurrentTextureMap!=0) && c.size>=3*sizeof(float);
+			if(ok)
+				memcpy((c.id==0xa360)? pCurrentTextureMap->rgbLumAlphaTint1 : pCurrentTextureMap->rgbLumAlphaTint2, c.data, 3*sizeof(float));
 			break;
 
-		case 0xafff: {
-
-		}break;
+		case 0xafff:
+			pMaterial = 0;
+			pCurrentTextureMap = 0;
+			break;
 
 		case 0xa000: {
-			std::string name = "";
-			char c = ' ';
-			while(c!='\0') {
-				infile.read(&c,1);
-				name.push_back(c);
+			std::string name;
+			ok = ReadName(c.data, c.size, name)>0;
+			if(ok) {
+				materials.push_back(new Material(name));
+				pMaterial = materials[materials.size()-1];
 			}
-			materials.push_back(new Material(name));
-			pMaterial = materials[materials.size()-1];
 		}
 		break;
-		
-		case 0xa010: {
-			pColorChannel = &pMaterial->ambient[0];			
-		}	break;
 
-		case 0xa020: {
-			pColorChannel = &pMaterial->diffuse[0];
-		}
-		break;
-
-		case 0xa030: {
-			pColorChannel = &pMaterial->specular[0];
-		}
-		break;
+		case 0x0011: {//24 bit color of the parent color chunk
+			if(pMaterial==0 || c.size<3)
+				break;
+			float* pColorChannel = (parent_id==0xa010)? pMaterial->ambient :
+								   (parent_id==0xa020)? pMaterial->diffuse :
+								   (parent_id==0xa030)? pMaterial->specular : 0;
+			if(pColorChannel) {
+				const unsigned char* rgb = reinterpret_cast<const unsigned char*>(c.data);
+				pColorChannel[0] = rgb[0]/255.0f;
+				pColorChannel[1] = rgb[1]/255.0f;
+				pColorChannel[2] = rgb[2]/255.0f;
+			}
+		} break;
 
-		case 0xa040: 
-			pPercent = &pMaterial->shininess;  
-		break;
+		case 0x0030: {//integer percentage of the parent percent chunk
+			if(pMaterial==0 || c.size<2)
+				break;
+			float* pPercent = (parent_id==0xa040)? &pMaterial->shininess :
+							  (parent_id==0xa041)? &pMaterial->shininess_strength :
+							  (parent_id==0xa050)? &pMaterial->transparency_percent :
+							  (parent_id==0xa052)? &pMaterial->transparency_falloff :
+							  (parent_id==0xa053)? &pMaterial->reflection_blur_percent :
+							  (parent_id==0xa084)? &pMaterial->self_illum : 0;
+			if(pPercent)
+				*pPercent = Read<unsigned short>(c.data);
+		} break;
 
-		case 0xa041: 
-			pPercent = &pMaterial->shininess_strength;  
-		break; 
-		 
-		case 0xa050: 
-			pPercent = &pMaterial->transparency_percent;  
+		case 0xb008://Keyframer frame range
+			if(c.size>=8) {
+				startFrame = Read<int>(c.data);
+				endFrame = Read<int>(c.data+4);
+			}
 			break;
+		}
+	}
 
-		case 0xa052: 
-			pPercent = &pMaterial->transparency_falloff;  
-		break;
+	//parse the meshes in parallel
+	std::map<std::string, int> meshIndices;
+	for(size_t i=0;i<tasks.size() && ok;i++) {
+		std::string name;
+		ReadName(chunks[tasks[i].chunk].data, chunks[tasks[i].chunk].size, name);
+		tasks[i].pMesh = new C3dsMesh(name);
+		meshIndices[name] = int(meshes.size());
+		meshes.push_back(tasks[i].pMesh);
+	}
+	if(ok && !tasks.empty()) {
+		MeshTasks meshTasks = {&chunks, &tasks};
+		CThreadPool pool;
+		pool.Init((tasks.size()>1)? 0 : 1);
+		pool.Run(int(tasks.size()), ParseMesh, &meshTasks);
+		pool.Destroy();
+		for(size_t i=0;i<tasks.size();i++)
+			ok = ok && tasks[i].ok;
+	}
 
-		case 0xa053: 
-			pPercent = &pMaterial->reflection_blur_percent;  
-		break;
+	//read the keyframer hierarchy, the parents are given by node id
+	std::map<int, int> nodeIndices;
+	vector<int> parentIds;
+	for(size_t i=0;i<chunks.size() && ok;i++) {
+		if(chunks[i].id!=0xb002)
+			continue;
+		C3dsNode node;
+		int parentId;
+		ok = ParseNode(chunks, int(i), node, parentId);
+		if(node.id<0)
+			node.id = int(nodes.size());
+		std::map<std::string, int>::const_iterator mesh = meshIndices.find(node.name);
+		node.mesh = (mesh==meshIndices.end())? -1 : mesh->second;
+		nodeIndices[node.id] = int(nodes.size());
+		nodes.push_back(node);
+		parentIds.push_back(parentId);
+	}
+	for(size_t i=0;i<nodes.size() && ok;i++) {
+		std::map<int, int>::const_iterator parent = nodeIndices.find(parentIds[i]);
+		nodes[i].parent = (parent==nodeIndices.end())? -1 : parent->second;
+	}
+	//a node that is its own ancestor is made a root
+	for(size_t i=0;i<nodes.size() && ok;i++) {
+		int p = nodes[i].parent;
+		for(size_t depth=0;p>=0 && depth<nodes.size();depth++)
+			p = nodes[p].parent;
+		if(p>=0)
+			nodes[i].parent = -1;
+	}
 
-		case 0xa084: 
-			pPercent = &pMaterial->self_illum;  
-		break;   
-		
-		case 0x0011: 
-		{
-			unsigned char rgb[3];
-			infile.read(reinterpret_cast<char*>(&rgb[0]),3*sizeof(unsigned char)); 
-			pColorChannel[0] = rgb[0]/255.0f;
-			pColorChannel[1] = rgb[1]/255.0f;
-			pColorChannel[2] = rgb[2]/255.0f;  
-		} break;
+	if(!ok) {
+		cout<<"Malformed 3ds file "<<filename<<endl;
+		return false;
+	}
+	EvaluateTransforms(float(startFrame), meshes);
 
-		case 0x0030: {
-			unsigned short percent;
-			infile.read(reinterpret_cast<char*>(&percent),2); 
-			*pPercent = percent;
-		} break;
-		
-		default:
-			infile.seekg(chunk_length-6, std::ios::cur);
+	//offset the material face ids so all meshes index one list of faces,
+	//the faces are offset when the indices are merged
+	int totalFaces = 0;
+	int totalVertices = 0;
+	for(size_t i=0;i<tasks.size();i++) {
+		C3dsMesh* pMesh = tasks[i].pMesh;
+		for(size_t j=0;j<tasks[i].groups.size();j++) {
+			const MaterialGroup& group = tasks[i].groups[j];
+			//find the material in the materials list
+			Material* pMat = 0;
+			for(size_t k=0;k<materials.size();k++) {
+				if(group.material.compare(materials[k]->name)==0) {
+					pMat = materials[k];
+					break;
+				}
+			}
+			if(pMat==0)
+				continue;
+			for(size_t k=0;k<group.face_ids.size();k++)
+				pMat->face_ids.push_back(group.face_ids[k] + totalFaces);
 		}
+		totalFaces += pMesh->faces.size();
+		totalVertices += pMesh->vertices.size();
 	}
-	infile.close();
-	 
-  
-	//check if there is any material with 0 size face_ids meaning it is not used then delete it
-	size_t total = materials.size();
-	for(size_t i=0;i<total;i++) {
-		if(materials[i]->face_ids.size()==0)
+
+	//delete the materials with no faces, they are not used
+	for(size_t i=materials.size();i-->0;) {
+		if(materials[i]->face_ids.size()==0) {
+			for(size_t j=0;j<materials[i]->textureMaps.size();j++)
+				delete materials[i]->textureMaps[j];
+			delete materials[i];
 			materials.erase(materials.begin()+i);
+		}
 	}
 
-	//create the super list of attributes
+	//create the super list of attributes, the vertices placed by the
+	//keyframer. Every mesh has up to 65535 vertices so the faces of the
+	//merged meshes need 32 bit indices.
+	vertices.reserve(totalVertices);
+	indices.reserve(size_t(totalFaces)*3);
 	for(size_t i=0;i<meshes.size();i++) {
-		for(size_t j=0;j<meshes[i]->vertices.size();j++) 
-			vertices.push_back(meshes[i]->vertices[j]); 
-
-		for(size_t j=0;j<meshes[i]->uvs.size();j++) 
-			uvs.push_back(meshes[i]->uvs[j]); 
-		
-		for(size_t j=0;j<meshes[i]->faces.size();j++) { 
-			faces.push_back(meshes[i]->faces[j]);   
+		const unsigned int first = unsigned(vertices.size());
+		const glm::mat4& M = meshes[i]->transform;
+		for(size_t j=0;j<meshes[i]->vertices.size();j++)
+			vertices.push_back(glm::vec3(M*glm::vec4(meshes[i]->vertices[j], 1)));
+
+		for(size_t j=0;j<meshes[i]->uvs.size();j++)
+			uvs.push_back(meshes[i]->uvs[j]);
+
+		for(size_t j=0;j<meshes[i]->faces.size();j++) {
+			const Face& f = meshes[i]->faces[j];
+			indices.push_back(first + f.a);
+			indices.push_back(first + f.b);
+			indices.push_back(first + f.c);
 		}
 	}
-	 
+
 	normals.resize(vertices.size());
-	 
-	for(size_t j=0;j<faces.size();j++) {
-		Face f = faces[j];
-		glm::vec3 v0 = vertices[f.a];
-		glm::vec3 v1 = vertices[f.b];
-		glm::vec3 v2 = vertices[f.c];
+
+	for(size_t j=0;j<indices.size();j+=3) {
+		const unsigned int a = indices[j], b = indices[j+1], c = indices[j+2];
+		glm::vec3 v0 = vertices[a];
+		glm::vec3 v1 = vertices[b];
+		glm::vec3 v2 = vertices[c];
 		glm::vec3 e1 = v1 - v0;
 		glm::vec3 e2 = v2 - v0;
 		glm::vec3 N = glm::cross(e1,e2);
-		  
-		normals[f.a] += N; 
-		normals[f.b] += N; 
-		normals[f.c] += N; 				   
+
+		normals[a] += N;
+		normals[b] += N;
+		normals[c] += N;
 	}
-	 
+
 	for(size_t i=0;i<normals.size();i++) {
 		normals[i]=glm::normalize(normals[i]);
-	} 
-	
-	 
+	}
+
+
 	for(size_t i=0;i<materials.size();i++) {
 		Material* pMat = materials[i];
 		for(size_t j=0;j<pMat->face_ids.size();j++) {
-			pMat->sub_indices.push_back(faces[pMat->face_ids[j]].a);
-			pMat->sub_indices.push_back(faces[pMat->face_ids[j]].b);
-			pMat->sub_indices.push_back(faces[pMat->face_ids[j]].c);
+			const unsigned int* face = &indices[size_t(pMat->face_ids[j])*3];
+			pMat->sub_indices.push_back(face[0]);
+			pMat->sub_indices.push_back(face[1]);
+			pMat->sub_indices.push_back(face[2]);
 		}
 	}
-	return true;
-}
 
+	float loadTime = timer.Elapsed();
+	cout<<"Loaded "<<filename<<": "<<meshes.size()<<" meshes, "<<nodes.size()<<" nodes in "<<loadTime<<" ms"<<endl;
+	return true;
+}
\ No newline at end of file
@@ -4,12 +4,14 @@
 #include <string>
 #include <vector>
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 using std::cout;
 using std::endl;
 using std::ifstream;
 using std::vector;
 
+//a triangle as stored in the file, indexing the vertices of its mesh
 struct Face {
 	unsigned short a, b, c, flags; 
 };
@@ -56,7 +58,7 @@ public:
 	float transparency_percent, transparency_falloff, reflection_blur_percent, self_illum;
 	vector<TextureMap*> textureMaps; 
 	vector<int> face_ids;  
-	vector<unsigned short> sub_indices;
+	vector<unsigned int> sub_indices;
 	int offset; 
 };
  
@@ -64,6 +66,7 @@ class C3dsMesh {
 public:
 	C3dsMesh(const std::string& n="") {
 		name = n;
+		matrix = glm::mat4(1);
 		transform = glm::mat4(1); 
 	}
 	~C3dsMesh() {
@@ -80,9 +83,43 @@ public:
 	vector<glm::vec3> normals; //per-vertex normals 
 	vector<Face> faces; //list of all faces of the mesh 
 	vector<unsigned int> smoothing_groups;
-	glm::mat4 transform;
+	glm::mat4 matrix; //mesh matrix the vertices were saved with 
+	glm::mat4 transform; //placement of the vertices by the keyframer
 }; 
 
+//keys of the keyframer tracks, rotations are absolute
+struct C3dsVectorKey {
+	int frame;
+	glm::vec3 value;
+};
+
+struct C3dsRotationKey {
+	int frame;
+	glm::quat value;
+};
+
+//an object node of the keyframer hierarchy
+class C3dsNode {
+public:
+	C3dsNode() {
+		id = -1;
+		parent = -1;
+		mesh = -1;
+		pivot = glm::vec3(0);
+		matrix = glm::mat4(1);
+	}
+
+	std::string name;
+	int id;		//node id the hierarchy refers to
+	int parent;	//index of the parent node, -1 for roots
+	int mesh;	//index of the mesh, -1 for dummy nodes
+	glm::vec3 pivot;
+	vector<C3dsVectorKey> positions;
+	vector<C3dsRotationKey> rotations;
+	vector<C3dsVectorKey> scales;
+	glm::mat4 matrix; //node to world at the evaluated frame
+};
+
 class C3dsLoader
 { 
 public:
@@ -94,9 +131,20 @@ public:
 				 std::vector<glm::vec3>& vertices, 
 				 std::vector<glm::vec3>& normals,
 				 std::vector<glm::vec2>& uvs, 
-				 std::vector<Face>& faces, 
-				 std::vector<unsigned short>& indices, 
+				 std::vector<unsigned int>& indices, 
 				 std::vector<Material*>& materials);
 
+	//keyframer nodes of the last loaded file
+	const vector<C3dsNode>& GetNodes() const { return nodes; }
+	int GetStartFrame() const { return startFrame; }
+	int GetEndFrame() const { return endFrame; }
+
+	//evaluates the keyframer hierarchy at the given frame and sets the
+	//node matrices and the transforms of the meshes of the nodes
+	void EvaluateTransforms(const float frame, std::vector<C3dsMesh*>& meshes);
+
+private:
+	vector<C3dsNode> nodes;
+	int startFrame, endFrame;
 };
 
@@ -49,8 +49,7 @@ typedef map<std::string, GLuint>::iterator iter;	//iterator for texture map
 vector<glm::vec3> vertices;		//mesh vertices
 vector<glm::vec3> normals;		//mesh normals
 vector<glm::vec2> uvs;			//mesh texture coordinates
-vector<Face> faces;				//mesh faces (triangles)
-vector<unsigned short> indices;	//mesh indices
+vector<unsigned int> indices;	//mesh indices, three per triangle
 
 //camera transform variables
 int state = 0, oldX=0, oldY=0;
@@ -117,7 +116,7 @@ void OnInit() {
 	std::string mesh_path = mesh_filename.substr(0, mesh_filename.find_last_of("/")+1);
 	 
 	//load the 3DS file
-	if(!loader.Load3DS(mesh_filename.c_str( ),  meshes, vertices, normals, uvs, faces, indices, materials)) {
+	if(!loader.Load3DS(mesh_filename.c_str( ),  meshes, vertices, normals, uvs, indices, materials)) {
 		cout<<"Cannot load the 3ds mesh"<<endl;
 		exit(EXIT_FAILURE);
 	} 
@@ -226,14 +225,11 @@ void OnInit() {
 	glGenBuffers(1, &vboNormalsID);
 	glGenBuffers(1, &vboIndicesID); 
 
-	//get the mesh bounding box
+	//get the mesh bounding box of the vertices as placed by the keyframer
 	glm::vec3 min=glm::vec3(1000.0f), max=glm::vec3(-1000);
-	for(size_t j=0;j<meshes.size();j++) {
-		C3dsMesh* pMesh = meshes[j];
-		for(size_t i=0;i<pMesh->vertices.size();i++) {
-			min = glm::min(pMesh->vertices[i], min);
-			max = glm::max(pMesh->vertices[i], max);
-		}
+	for(size_t i=0;i<vertices.size();i++) {
+		min = glm::min(vertices[i], min);
+		max = glm::max(vertices[i], max);
 	}
 	//use the bounding information to move the camera such that the whole
 	//mesh is visible on screen
@@ -281,16 +277,7 @@ void OnInit() {
 	if(materials.size()==1) {
 		//pass indices to the element array buffer if there is a single material			
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboIndicesID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort)*3*faces.size(), 0, GL_STATIC_DRAW);
-
-		//fill the element array buffer memory with the indices array
-		GLushort* pIndices = static_cast<GLushort*>(glMapBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY));
-		for(size_t i=0;i<faces.size();i++) {
-			*(pIndices++)=faces[i].a;
-			*(pIndices++)=faces[i].b;
-			*(pIndices++)=faces[i].c;
-		}
-		glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint)*indices.size(), &indices[0], GL_STATIC_DRAW);
 	}  
 		
 	GL_CHECK_ERRORS
@@ -431,7 +418,7 @@ void OnRender() {
 					glUniform3fv(shader("diffuse_color"),1, materials[0]->diffuse);	
 				}
 				//draw mesh triangles in a single call
-				glDrawElements(GL_TRIANGLES, meshes[0]->faces.size()*3, GL_UNSIGNED_SHORT, 0); 
+				glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0); 
 			}  else {
 				//otherwise we render the submeshes by material
 				for(size_t i=0;i<materials.size();i++) {
@@ -451,7 +438,7 @@ void OnRender() {
 					//pass the diffuse colour uniform to the material's diffuse color
 					glUniform3fv(shader("diffuse_color"),1, materials[i]->diffuse);	
 					//draw triangles using the submesh indices 
-					glDrawElements(GL_TRIANGLES, materials[i]->sub_indices.size(), GL_UNSIGNED_SHORT, &(materials[i]->sub_indices[0])); 
+					glDrawElements(GL_TRIANGLES, materials[i]->sub_indices.size(), GL_UNSIGNED_INT, &(materials[i]->sub_indices[0])); 
 			
 				}
 			}
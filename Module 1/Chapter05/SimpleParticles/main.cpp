@@ -10,6 +10,10 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "..\src\GLSLShader.h"
+#include "..\src\ThreadPool.h"
+#include "..\src\ParticleSystem.h"
+#include "..\src\StreamingBuffer.h"
+#include <sstream>
 
 #include <SOIL.h>
 
@@ -27,12 +31,21 @@ const int HEIGHT = 960;
 //particle shader, textured shader and a pointer to current shader
 GLSLShader shader, texturedShader, *pCurrentShader;
 
-//IDs for vertex array and buffer object
+//ID for vertex array object
 GLuint vaoID;
-GLuint vboVerticesID; 
 
-//total number of particles
-const int MAX_PARTICLES = 10000;
+//particle counts selectable with the 1-4 keys
+const int PARTICLE_COUNTS[4] = {10000, 100000, 1000000, 2000000};
+int totalParticles = 1000000;
+
+//life of a particle in seconds
+const float PARTICLE_LIFE = 2;
+
+//worker threads, the CPU particle system and the buffer the particles are
+//streamed to every frame
+CThreadPool threadPool;
+CParticleSystem particles;
+CStreamingBuffer particleBuffer;
  
 //projection modelview and emitter transform matrices
 glm::mat4  P = glm::mat4(1);
@@ -42,7 +55,12 @@ glm::mat4 emitterXForm = glm::mat4(1);
 //camera transformation variables
 int state = 0, oldX=0, oldY=0;
 float rX=0, rY=0, dist = -10;
-float time = 0;
+
+//timing related variables
+float last_time=0, current_time=0;
+
+//output message
+std::stringstream msg;
  
 //particle texture filename 
 const std::string texture_filename = "../media/particle.dds";
@@ -80,6 +98,25 @@ void OnMouseMove(int x, int y)
 	glutPostRedisplay(); 
 }
 
+//creates the particle system and its streaming buffer for the given count
+void SetParticleCount(const int count) {
+	totalParticles = count;
+	particles.Init(totalParticles, PARTICLE_LIFE, &threadPool);
+
+	//one region per frame in flight, each holds a vec4 per particle
+	if(!particleBuffer.Init(particles.GetTotalParticles()*sizeof(glm::vec4), 3)) {
+		cerr<<"Cannot map the particle buffer"<<endl;
+		exit(EXIT_FAILURE);
+	}
+	glBindVertexArray(vaoID);
+		glBindBuffer(GL_ARRAY_BUFFER, particleBuffer.GetBufferID());
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+	
+	//smaller points for more particles to keep the fill rate in check
+	glPointSize(glm::clamp(10.0f*sqrtf(10000.0f/totalParticles), 1.0f, 10.0f));
+}
+
 //OpenGL initialization function
 void OnInit() {
 	GL_CHECK_ERRORS
@@ -91,7 +128,6 @@ void OnInit() {
 	shader.Use();	  
 		//add attribute and uniform
 		shader.AddUniform("MVP");
-		shader.AddUniform("time"); 
 	shader.UnUse();
 
 	GL_CHECK_ERRORS
@@ -104,7 +140,6 @@ void OnInit() {
 	texturedShader.Use();	  
 		//add attribute and uniform
 		texturedShader.AddUniform("MVP");
-		texturedShader.AddUniform("time"); 
 		texturedShader.AddUniform("textureMap");
 		//set values of constant uniforms as initialization	
 		glUniform1i(texturedShader("textureMap"),0);
@@ -112,28 +147,13 @@ void OnInit() {
 	 
 	GL_CHECK_ERRORS
 
-	//setup the vertex array object and vertex buffer object for the mesh
-	//geometry handling 
+	//setup the thread pool and the particle system with its streaming buffer
+	threadPool.Init();
+	cout<<"Updating particles on "<<threadPool.GetTotalThreads()<<" threads"<<endl;
 	glGenVertexArrays(1, &vaoID);
-	glBindVertexArray(vaoID);
-
-	//These calls marked start ATI/end ATI below are not required but on 
-	//ATI cards i tested, i had to pass an allocated buffer object
-	//uncomment the code marked with start/end ATI if running on an ATI hardware
-	/// start ATI ///
-	/*
-	glGenBuffers(1, &vboVerticesID);  
-	glBindBuffer (GL_ARRAY_BUFFER, vboVerticesID);
-	glBufferData (GL_ARRAY_BUFFER, sizeof(GLubyte)*MAX_PARTICLES, 0, GL_STATIC_DRAW);	 
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0,1,GL_UNSIGNED_BYTE, GL_FALSE, 0,0);
-	*/
-	/// end ATI ////
+	SetParticleCount(totalParticles);
 
 	GL_CHECK_ERRORS 
-	
-	//set particle size
-	glPointSize(10);
 
 	//enable blending and over blending operator
 	glEnable(GL_BLEND);
@@ -209,11 +229,10 @@ void OnShutdown() {
 	shader.DeleteShaderProgram();
 	texturedShader.DeleteShaderProgram();
 
-	//Destroy vao and vbo
-	/// start ATI ///
-	//glDeleteBuffers(1, &vboVerticesID); 
-	/// end ATI ///
-
+	//Destroy the particle system, its buffer and the vao
+	particles.Destroy();
+	particleBuffer.Destroy();
+	threadPool.Destroy();
 	glDeleteVertexArrays(1, &vaoID);
 
 	cout<<"Shutdown successfull"<<endl;
@@ -229,8 +248,10 @@ void OnResize(int w, int h) {
 
 //display callback function
 void OnRender() { 
-	//get current time
-	GLfloat time = glutGet(GLUT_ELAPSED_TIME)/1000.0f;
+	//get the elapsed time, clamped so a stall does not make particles jump
+	last_time = current_time;
+	current_time = glutGet(GLUT_ELAPSED_TIME)/1000.0f;
+	float dt = min(current_time-last_time, 0.1f);
 	
 	//clear colour and depth buffer
 	glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
@@ -240,16 +261,34 @@ void OnRender() {
 	glm::mat4 Rx	= glm::rotate(T,  rX, glm::vec3(1.0f, 0.0f, 0.0f));
 	glm::mat4 MV	= glm::rotate(Rx, rY, glm::vec3(0.0f, 1.0f, 0.0f)); 
     glm::mat4 MVP	= P*MV;
+
+	//update and sort the particles in emitter space, then write them to the
+	//next free region of the streaming buffer
+	particles.Update(dt, MV*emitterXForm);
+	float* pParticles = static_cast<float*>(particleBuffer.Map());
+	int count = particles.Write(pParticles);
+	GLint first = GLint(particleBuffer.Unmap()/sizeof(glm::vec4));
 	 
 	//bind the current shader
 	pCurrentShader->Use();				
 		//pass shader uniforms
-		glUniform1f((*pCurrentShader)("time"), time);
 		glUniformMatrix4fv((*pCurrentShader)("MVP"), 1, GL_FALSE, glm::value_ptr(P*MV*emitterXForm));
 		//render points
-			glDrawArrays(GL_POINTS, 0, MAX_PARTICLES);
+		glBindVertexArray(vaoID);
+			glDrawArrays(GL_POINTS, first, count);
 	//unbind shader
 	pCurrentShader->UnUse();
+
+	//the region can be reused once the draw is done
+	particleBuffer.Fence();
+
+	//show the particle counts and CPU timings in the title bar
+	msg.str(std::string());
+	msg<<"Simple particles: "<<particles.GetTotalAlive()<<"/"<<particles.GetTotalParticles()<<" alive, update "
+	   <<particles.GetUpdateTime()<<" ms, sort "<<particles.GetSortTime()<<" ms, write "<<particles.GetWriteTime()
+	   <<" ms"<<(particles.IsSorting()? "" : " (unsorted)")<<(particleBuffer.IsPersistent()? ", persistent" : ", mapped")
+	   <<" buffer, "<<particleBuffer.GetTotalStalls()<<" stalls";
+	glutSetWindowTitle(msg.str().c_str());
 	
 	//swap front and back buffers to show the rendered result
 	glutSwapBuffers();
@@ -260,9 +299,16 @@ void OnIdle() {
 	glutPostRedisplay();
 }
 
-//keyboard event handler to toggle use of textured and coloured particle system
+//keyboard event handler to toggle use of textured and coloured particle system,
+//the depth sorting and to change the particle count
 void OnKey(unsigned char key, int x, int y) {
 	switch (key) {
+		case '1': case '2': case '3': case '4':
+			SetParticleCount(PARTICLE_COUNTS[key-'1']);
+		break;
+		case 's':
+			particles.SetSorting(!particles.IsSorting());
+		break;
 		case ' ': 
 			if(pCurrentShader == &shader) {
 				pCurrentShader = &texturedShader;  
@@ -1,6 +1,9 @@
-﻿#include <GL/glew.h>
+﻿#define _USE_MATH_DEFINES
+#include <GL/glew.h>
 #include <GL/freeglut.h>
 #include <iostream>
+#include <sstream>
+#include <cmath>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp> 
@@ -9,6 +12,9 @@
 #include <SOIL.h>
 
 #include "..\..\src\GLSLShader.h"
+#include "..\..\src\HeightmapPyramid.h"
+#include "..\..\src\TerrainTileCache.h"
+#include "..\..\src\CDLODTerrain.h"
 
 #define GL_CHECK_ERRORS assert(glGetError()== GL_NO_ERROR);
 
@@ -21,45 +27,138 @@ using namespace std;
 const int WIDTH  = 1280;
 const int HEIGHT = 960;
 
-//shaders for use in the recipe
-GLSLShader shader;
+//heightmap filename, the source of the streamed terrain
+const string filename = "../../media/heightmap512x512.png";
 
-//IDs for vertex array and buffer object
-GLuint vaoID;
-GLuint vboVerticesID;
-GLuint vboIndicesID;
+//tile pyramid built from the heightmap on the first run, rebuilt when the
+//heightmap size or the constants below change
+const string pyramid_filename = "terrain.pyramid";
 
-//heighmap texture ID
-GLuint heightMapTextureID;
+//the heightmap is upsampled by this factor with added noise detail, 
+//32 gives a 16K x 16K terrain
+const int TERRAIN_UPSAMPLE = 8;
 
-//heightmap texture dimensions and half dimensions
-const int TERRAIN_WIDTH = 512;
-const int TERRAIN_DEPTH = 512; 
-const int TERRAIN_HALF_WIDTH = TERRAIN_WIDTH>>1;
-const int TERRAIN_HALF_DEPTH = TERRAIN_DEPTH>>1;
+//samples per tile side, a tile is also the size of the terrain patch
+const int TILE_SIZE = 64;
 
-//heightmap height scale and half scale values
-float scale = 50;
-float half_scale = scale/2.0f;
+//tile cache layers and tiles loaded per frame at most
+const int TOTAL_CACHE_SLOTS = 256;
+const int MAX_LOADS_PER_FRAME = 16;
 
-//total vertices and indices in the terrain
-const int TOTAL = (TERRAIN_WIDTH*TERRAIN_DEPTH);
-const int TOTAL_INDICES = TOTAL*2*3;
+//world distance between two heightmap samples and height scale
+const float spacing = 1.0f;
+const float scale = 400.0f;
 
-//heightmap filename
-const string filename = "../../media/heightmap512x512.png";
- 
-//height map vertices and indices
-glm::vec3 vertices[TOTAL];
-GLuint indices[TOTAL_INDICES];
+//heightmap pyramid, tile cache and the CDLOD terrain renderer
+CHeightmapPyramid pyramid;
+CTerrainTileCache tileCache;
+CCDLODTerrain terrain;
 
-//projection and modelview matrices
+//projection matrix and field of view
 glm::mat4  P = glm::mat4(1);
-glm::mat4 MV = glm::mat4(1);
+float fov = 45;
+int screenHeight = HEIGHT;
+
+//target size of a terrain triangle in pixels
+float pixelsPerTriangle = 4;
 
 //camera transform variables
 int state = 0, oldX=0, oldY=0;
-float rX=25, rY=-40, dist = -7;
+float yaw = 45, pitch = -20;
+glm::vec3 eye = glm::vec3(-1500, 600, -1500);
+const float CAMERA_SPEED = 400;
+
+//virtual key codes
+const int VK_W = 0x57;
+const int VK_S = 0x53;
+const int VK_A = 0x41;
+const int VK_D = 0x44;
+const int VK_Q = 0x51;
+const int VK_Z = 0x5a;
+
+//timing related variables
+float last_time=0, current_time=0, dt=0;
+
+//wireframe rendering toggle
+bool bWireframe = false;
+
+//output message
+std::stringstream msg;
+
+//source image for the pyramid height function
+struct HeightmapImage {
+	GLubyte* pData;
+	int width, height;
+};
+
+//value noise used to add detail below the resolution of the source image
+float Hash(int x, int z) {
+	unsigned int n = unsigned(x)*73856093u ^ unsigned(z)*19349663u;
+	n = (n<<13) ^ n;
+	n = n*(n*n*15731u + 789221u) + 1376312589u;
+	return float(n & 0x7fffffff)/float(0x7fffffff);
+}
+
+float ValueNoise(float x, float z) {
+	int ix = int(floor(x)), iz = int(floor(z));
+	float fx = x-ix, fz = z-iz;
+	fx = fx*fx*(3-2*fx);
+	fz = fz*fz*(3-2*fz);
+	float a = Hash(ix, iz),   b = Hash(ix+1, iz);
+	float c = Hash(ix, iz+1), d = Hash(ix+1, iz+1);
+	return (a + (b-a)*fx) + ((c + (d-c)*fx) - (a + (b-a)*fx))*fz;
+}
+
+//bilinearly upsampled heightmap plus a few octaves of noise
+float TerrainHeight(int x, int z, void* userData) {
+	const HeightmapImage* image = static_cast<HeightmapImage*>(userData);
+	float u = float(x)/TERRAIN_UPSAMPLE, v = float(z)/TERRAIN_UPSAMPLE;
+	int i = min(int(u), image->width-2), j = min(int(v), image->height-2);
+	float fu = u-i, fv = v-j;
+	const GLubyte* row0 = image->pData + j*image->width;
+	const GLubyte* row1 = row0 + image->width;
+	float h0 = row0[i] + (row0[i+1]-row0[i])*fu;
+	float h1 = row1[i] + (row1[i+1]-row1[i])*fu;
+	float h = (h0 + (h1-h0)*fv)/255.0f;
+
+	float detail = 0, amplitude = 0.02f, frequency = 1.0f/16;
+	for(int k=0;k<3;k++) {
+		detail += (ValueNoise(x*frequency, z*frequency)-0.5f)*amplitude;
+		amplitude *= 0.5f;
+		frequency *= 2;
+	}
+	return h*0.9f + 0.05f + detail;
+}
+
+//opens the tile pyramid of the heightmap image. The pyramid is built if it
+//is missing or was built for another heightmap size, tile size or upsampling
+//factor, the upsampling factor is kept as the source key of the pyramid.
+bool OpenPyramid() {
+	HeightmapImage image;
+	int channels = 0;
+	image.pData = SOIL_load_image(filename.c_str(), &image.width, &image.height, &channels, SOIL_LOAD_L);
+	if(!image.pData) {
+		cerr<<"Cannot load heightmap: "<<filename<<endl;
+		return false;
+	}
+	const int width = image.width*TERRAIN_UPSAMPLE, depth = image.height*TERRAIN_UPSAMPLE;
+	bool ok = pyramid.Open(pyramid_filename) && pyramid.GetWidth() == width && pyramid.GetDepth() == depth &&
+			  pyramid.GetTileSize() == TILE_SIZE && pyramid.GetSourceKey() == TERRAIN_UPSAMPLE;
+	if(!ok) {
+		pyramid.Close();
+		cout<<"Building terrain tile pyramid "<<pyramid_filename<<" ..."<<endl;
+		ok = CHeightmapPyramid::Build(pyramid_filename, width, depth, TILE_SIZE, TerrainHeight, &image, TERRAIN_UPSAMPLE) &&
+			 pyramid.Open(pyramid_filename);
+	}
+	SOIL_free_image_data(image.pData);
+	return ok;
+}
+
+//camera forward vector from yaw and pitch
+glm::vec3 GetLookVector() {
+	float y = glm::radians(yaw), p = glm::radians(pitch);
+	return glm::vec3(cos(p)*sin(y), sin(p), cos(p)*cos(y));
+}
 
 //mouse click handler
 void OnMouseDown(int button, int s, int x, int y)
@@ -79,12 +178,11 @@ void OnMouseDown(int button, int s, int x, int y)
 //mouse move handler
 void OnMouseMove(int x, int y)
 {
-	if (state == 0)
-		dist *= (1 + (y - oldY)/60.0f); 
-	else
+	if (state == 1)
 	{
-		rY += (x - oldX)/5.0f; 
-		rX += (y - oldY)/5.0f; 
+		yaw   += (oldX - x)/5.0f; 
+		pitch += (oldY - y)/5.0f; 
+		pitch = glm::clamp(pitch, -89.0f, 89.0f);
 	}  
 	oldX = x; 
 	oldY = y; 
@@ -96,138 +194,33 @@ void OnMouseMove(int x, int y)
 void OnInit() {
 
 	GL_CHECK_ERRORS
-	//load heightmap shader
-	shader.LoadFromFile(GL_VERTEX_SHADER, "shaders/shader.vert");
-	shader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/shader.frag");
-	//compile and link shader
-	shader.CreateAndLinkProgram();
-	shader.Use();	
-		//add attributes and uniforms
-		shader.AddAttribute("vVertex"); 
-		shader.AddUniform("heightMapTexture");
-		shader.AddUniform("scale");
-		shader.AddUniform("half_scale");
-		shader.AddUniform("HALF_TERRAIN_SIZE");
-		shader.AddUniform("MVP");
-		//set values of constant uniforms as initialization	
-		glUniform1i(shader("heightMapTexture"), 0);
-		glUniform2i(shader("HALF_TERRAIN_SIZE"), TERRAIN_WIDTH>>1, TERRAIN_DEPTH>>1);
-		glUniform1f(shader("scale"), scale);
-		glUniform1f(shader("half_scale"), half_scale);
-	shader.UnUse();
-
-	GL_CHECK_ERRORS
-		 
-		
-	//fill indices array
-	GLuint* id=&indices[0];
-	int i=0, j=0;
-	
-	//setup vertices 
-	int count = 0;
-	//fill terrain vertices
-	for( j=0;j<TERRAIN_DEPTH;j++) {		 
-		for( i=0;i<TERRAIN_WIDTH;i++) {	  
-			vertices[count] = glm::vec3( (float(i)/(TERRAIN_WIDTH-1)), 
-										 0, 
-										 (float(j)/(TERRAIN_DEPTH-1)));
-			count++;
-		}
-	}
-	 
-	//fill terrain indices
-	for (i = 0; i < TERRAIN_DEPTH-1; i++) {        
-		for (j = 0; j < TERRAIN_WIDTH-1; j++) {			
-			int i0 = j+ i*TERRAIN_WIDTH;
-			int i1 = i0+1;
-			int i2 = i0+TERRAIN_WIDTH;
-			int i3 = i2+1;
-			*id++ = i0; 
-			*id++ = i2; 
-			*id++ = i1; 
-			*id++ = i1; 
-			*id++ = i2; 
-			*id++ = i3; 
-		}    
+	//open the tile pyramid, building it first if needed
+	if(!OpenPyramid()) {
+		cerr<<"Cannot open terrain tile pyramid"<<endl;
+		exit(EXIT_FAILURE);
 	}
+	cout<<"Terrain: "<<pyramid.GetWidth()<<"x"<<pyramid.GetDepth()<<" samples, "<<pyramid.GetTotalLevels()<<" levels"<<endl;
 
-	GL_CHECK_ERRORS
+	//setup the tile cache and the terrain renderer
+	if(!tileCache.Init(&pyramid, TOTAL_CACHE_SLOTS) || !terrain.Init(&pyramid, &tileCache, spacing, scale)) {
+		cerr<<"Cannot initialize terrain"<<endl;
+		exit(EXIT_FAILURE);
+	}
 
-	//setup terrain vertex array and vertex buffer objects 
-	glGenVertexArrays(1, &vaoID);
-	glGenBuffers(1, &vboVerticesID);
-	glGenBuffers(1, &vboIndicesID);
-	 
-	glBindVertexArray(vaoID);	
-
-		glBindBuffer (GL_ARRAY_BUFFER, vboVerticesID);
-		//pass terrain vertices to buffer object
-		glBufferData (GL_ARRAY_BUFFER, sizeof(vertices), &vertices[0], GL_STATIC_DRAW);
-		GL_CHECK_ERRORS
-		//enable vertex attribute array for position
-		glEnableVertexAttribArray(shader["vVertex"]);
-		glVertexAttribPointer(shader["vVertex"], 3, GL_FLOAT, GL_FALSE,0,0);
-		GL_CHECK_ERRORS 
-		//pass the terrain indices array to element array buffer
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboIndicesID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), &indices[0], GL_STATIC_DRAW);
-		GL_CHECK_ERRORS
-			
-	//load the heightmap texture using SOIL	
-	int texture_width = 0, texture_height = 0, channels=0;		 
-	GLubyte* pData = SOIL_load_image(filename.c_str(), &texture_width, &texture_height, &channels, SOIL_LOAD_L);
-	
-	//vertically flip the heightmap image on Y axis since it is inverted 
-	for( j = 0; j*2 < texture_height; ++j )
-	{
-		int index1 = j * texture_width ;
-		int index2 = (texture_height - 1 - j) * texture_width ;
-		for( i = texture_width ; i > 0; --i )
-		{
-			GLubyte temp = pData[index1];
-			pData[index1] = pData[index2];
-			pData[index2] = temp;
-			++index1;
-			++index2;
-		}
-	} 
-
-	//setup OpenGL texture
-	glGenTextures(1, &heightMapTextureID);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, heightMapTextureID);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, texture_width, texture_height, 0, GL_RED, GL_UNSIGNED_BYTE, pData);
-	
-	//free SOIL image data
-	SOIL_free_image_data(pData);
-	
 	GL_CHECK_ERRORS
 
-	//set polygon mode to draw lines
-	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-
-	GL_CHECK_ERRORS
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+	glClearColor(0.6f, 0.75f, 0.9f, 1);
 
 	cout<<"Initialization successfull"<<endl;
 }
 
 //release all allocated resources
 void OnShutdown() {
-
-	//Destroy shader
-	shader.DeleteShaderProgram();
-
-	//Destroy vao and vbo
-	glDeleteBuffers(1, &vboVerticesID);
-	glDeleteBuffers(1, &vboIndicesID);
-	glDeleteVertexArrays(1, &vaoID);
-
-	//Delete textures
-	glDeleteTextures(1, &heightMapTextureID);
+	terrain.Destroy();
+	tileCache.Destroy();
+	pyramid.Close();
 	cout<<"Shutdown successfull"<<endl;
 }
 
@@ -237,37 +230,88 @@ void OnResize(int w, int h) {
 	glViewport (0, 0, (GLsizei) w, (GLsizei) h);
 
 	//setup the projection matrix
-	P = glm::perspective(45.0f, (GLfloat)w/h, 0.01f, 10000.f);
+	P = glm::perspective(fov, (GLfloat)w/h, 1.0f, 20000.f);
+
+	//LOD ranges depend on the screen size
+	screenHeight = h;
+	terrain.SetDetail(screenHeight, fov, pixelsPerTriangle);
+}
+
+//idle callback, moves the camera with the WSAD, QZ keys
+void OnIdle() {
+	glm::vec3 look = GetLookVector();
+	glm::vec3 right = glm::normalize(glm::cross(look, glm::vec3(0,1,0)));
+	float step = CAMERA_SPEED*dt;
+
+	if( GetAsyncKeyState(VK_W) & 0x8000) 
+		eye += look*step;
+	if( GetAsyncKeyState(VK_S) & 0x8000) 
+		eye -= look*step;
+	if( GetAsyncKeyState(VK_A) & 0x8000) 
+		eye -= right*step;
+	if( GetAsyncKeyState(VK_D) & 0x8000) 
+		eye += right*step;
+	if( GetAsyncKeyState(VK_Q) & 0x8000) 
+		eye.y += step;
+	if( GetAsyncKeyState(VK_Z) & 0x8000) 
+		eye.y -= step;
+
+	glutPostRedisplay();
 }
 
 //display function
 void OnRender() {
+	//timing related calcualtion
+	last_time = current_time;
+	current_time = glutGet(GLUT_ELAPSED_TIME)/1000.0f;
+	dt = current_time-last_time;
+
 	//clear colour and depth buffers
 	glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 
 	//set the camera transform
-	glm::mat4 T		= glm::translate(glm::mat4(1.0f),glm::vec3(0.0f, 0.0f, dist));
-	glm::mat4 Rx	= glm::rotate(T,  rX, glm::vec3(1.0f, 0.0f, 0.0f));
-	glm::mat4 Ry	= glm::rotate(Rx, rY, glm::vec3(0.0f, 1.0f, 0.0f));
-	glm::mat4 MV	= Ry;
-    glm::mat4 MVP	= P*MV;
-
-	//since we have kept the terrain vertex array object bound
-	//it is still bound to the context so we can directly call draw element
-	//which will draw vertices from the bound vertex array object
-	//bind the terrain shader
-	shader.Use();				
-		//pass shader uniforms
-		glUniformMatrix4fv(shader("MVP"), 1, GL_FALSE, glm::value_ptr(MVP));
-			//draw terrain mesh
-			glDrawElements(GL_TRIANGLES, TOTAL_INDICES, GL_UNSIGNED_INT, 0);
-	//unbind shader
-	shader.UnUse();
-	
+	glm::mat4 MV  = glm::lookAt(eye, eye+GetLookVector(), glm::vec3(0,1,0));
+	glm::mat4 MVP = P*MV;
+
+	//select the visible quadtree nodes, then stream in the tiles that were
+	//missing so the nodes can be refined in the next frames
+	tileCache.BeginFrame();
+	terrain.Select(MVP, eye);
+	tileCache.Update(MAX_LOADS_PER_FRAME);
+
+	//draw all selected nodes as instanced patches
+	glPolygonMode(GL_FRONT_AND_BACK, bWireframe? GL_LINE : GL_FILL);
+	terrain.Render(MVP, eye);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+	//show the LOD statistics in the title bar
+	msg.str(std::string());
+	msg<<"CDLOD terrain: "<<terrain.GetTotalNodes()<<" nodes, "<<terrain.GetTotalTriangles()<<" triangles, "
+	   <<tileCache.GetTotalResident()<<"/"<<tileCache.GetTotalSlots()<<" tiles, "<<tileCache.GetTotalLoads()<<" loads, "
+	   <<pixelsPerTriangle<<" px/triangle";
+	glutSetWindowTitle(msg.str().c_str());
+
 	//swap front and back buffers to show the rendered result
 	glutSwapBuffers();
 }
 
+//keyboard handler, space toggles wireframe, +/- change the triangle size
+void OnKey(unsigned char key, int x, int y) {
+	switch(key) {
+		case ' ':
+			bWireframe = !bWireframe;
+		break;
+		case '+':
+			pixelsPerTriangle = max(1.0f, pixelsPerTriangle*0.5f);
+		break;
+		case '-':
+			pixelsPerTriangle = min(64.0f, pixelsPerTriangle*2.0f);
+		break;
+	}
+	terrain.SetDetail(screenHeight, fov, pixelsPerTriangle);
+	glutPostRedisplay();
+}
+
 int main(int argc, char** argv) {
 	//freeglut initialization
 	glutInit(&argc, argv);
@@ -275,7 +319,7 @@ int main(int argc, char** argv) {
 	glutInitContextVersion (3, 3);
 	glutInitContextFlags (GLUT_CORE_PROFILE | GLUT_DEBUG);
 	glutInitWindowSize(WIDTH, HEIGHT);
-	glutCreateWindow("Simple terrain - OpenGL 3.3");
+	glutCreateWindow("CDLOD terrain - OpenGL 3.3");
 	
 	//initialize glew
 	glewExperimental = GL_TRUE;	 
@@ -309,6 +353,8 @@ int main(int argc, char** argv) {
 	glutReshapeFunc(OnResize);
 	glutMouseFunc(OnMouseDown);
 	glutMotionFunc(OnMouseMove);
+	glutKeyboardFunc(OnKey);
+	glutIdleFunc(OnIdle);
 
 	//call main loop
 	glutMainLoop();	
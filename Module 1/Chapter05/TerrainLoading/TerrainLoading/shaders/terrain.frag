@@ -0,0 +1,19 @@
+#version 330 core
+
+layout (location=0) out vec4 vFragColor;	//fragment shader output
+
+smooth in vec3 vWorldPos;	//interpolated world space position
+uniform float heightScale;	//scale for the heightmap height
+
+void main()
+{
+	//face normal from the screen space derivatives of the position
+	vec3 N = normalize(cross(dFdx(vWorldPos), dFdy(vWorldPos)));
+	float diffuse = max(0.0, dot(N, normalize(vec3(0.5, 1.0, 0.3))));
+
+	//colour by height, from grass to rock to snow
+	float h = vWorldPos.y/heightScale;
+	vec3 color = mix(vec3(0.3,0.5,0.2), vec3(0.5,0.45,0.4), smoothstep(0.3, 0.6, h));
+	color = mix(color, vec3(0.95), smoothstep(0.75, 0.85, h));
+	vFragColor = vec4(color*(0.25 + 0.75*diffuse), 1);
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#version 330 core
+
+layout (location=0) in vec2 vGridPos;	//grid position in the patch
+layout (location=1) in vec4 vNode;		//per instance: patch origin (xy), grid spacing, level
+layout (location=2) in vec4 vTile;		//per instance: texel offset of the patch (xy), tile layer
+
+//uniforms
+uniform mat4 MVP;						//combined modelview projection matrix
+uniform vec3 eyePos;					//camera position
+uniform float heightScale;				//scale for the heightmap height
+uniform float tileSamples;				//samples per row of a tile
+uniform vec2 morphRange[16];			//morph start and end distance of every level
+uniform sampler2DArray heightTiles;		//resident heightmap tiles
+
+smooth out vec3 vWorldPos;				//world space position to fragment shader
+
+//height at a grid position of the patch, texels are at the sample centres
+float GetHeight(vec2 gridPos)
+{
+	vec2 uv = (vTile.xy + gridPos + 0.5)/tileSamples;
+	return texture(heightTiles, vec3(uv, vTile.z)).r*heightScale;
+}
+
+void main()
+{
+	vec2 pos = vNode.xy + vGridPos*vNode.z;
+	vec3 worldPos = vec3(pos.x, GetHeight(vGridPos), pos.y);
+
+	//blend the odd vertices onto their even neighbours towards the end of
+	//the range of the level, there they match the next coarser level
+	vec2 range = morphRange[int(vNode.w)];
+	float morphK = clamp((distance(eyePos, worldPos) - range.x)/(range.y - range.x), 0.0, 1.0);
+	vec2 gridPos = vGridPos - fract(vGridPos*0.5)*2.0*morphK;
+
+	pos = vNode.xy + gridPos*vNode.z;
+	vWorldPos = vec3(pos.x, GetHeight(gridPos), pos.y);
+	gl_Position = MVP*vec4(vWorldPos, 1);
+}
\ No newline at end of file
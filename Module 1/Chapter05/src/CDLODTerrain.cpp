@@ -0,0 +1,279 @@
+#include "CDLODTerrain.h"
+#include <glm/gtc/matrix_access.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+//fraction of the range of a level after which its vertices start morphing
+//into the next coarser level
+const float MORPH_START = 0.7f;
+
+CCDLODTerrain::CCDLODTerrain(void)
+{
+	pyramid = 0;
+	cache = 0;
+	spacing = 1;
+	heightScale = 1;
+	patchSize = 0;
+	vboVerticesID = 0;
+	for(int i=0;i<2;i++) {
+		vaoID[i] = 0;
+		vboIndicesID[i] = 0;
+		vboInstancesID[i] = 0;
+		totalIndices[i] = 0;
+	}
+	for(int i=0;i<MAX_LEVELS;i++)
+		ranges[i] = FLT_MAX;
+}
+
+CCDLODTerrain::~CCDLODTerrain(void)
+{
+}
+
+bool CCDLODTerrain::Init(CHeightmapPyramid* p, CTerrainTileCache* c, const float spacing, const float heightScale) {
+	pyramid = p;
+	cache = c;
+	this->spacing = spacing;
+	this->heightScale = heightScale;
+	patchSize = pyramid->GetTileSize();
+	if(pyramid->GetTotalLevels() > MAX_LEVELS || (patchSize&1) || (patchSize+1)*(patchSize+1) > 65536)
+		return false;
+
+	shader.LoadFromFile(GL_VERTEX_SHADER, "shaders/terrain.vert");
+	shader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/terrain.frag");
+	shader.CreateAndLinkProgram();
+	shader.Use();
+		shader.AddUniform("MVP");
+		shader.AddUniform("eyePos");
+		shader.AddUniform("heightScale");
+		shader.AddUniform("tileSamples");
+		shader.AddUniform("morphRange");
+		shader.AddUniform("heightTiles");
+		glUniform1i(shader("heightTiles"), 0);
+		glUniform1f(shader("heightScale"), heightScale);
+		glUniform1f(shader("tileSamples"), float(patchSize+1));
+	shader.UnUse();
+
+	//grid positions of the full patch, the quarter patch uses its first rows
+	std::vector<glm::vec2> vertices;
+	for(int j=0;j<=patchSize;j++)
+		for(int i=0;i<=patchSize;i++)
+			vertices.push_back(glm::vec2(float(i), float(j)));
+
+	glGenVertexArrays(2, vaoID);
+	glGenBuffers(1, &vboVerticesID);
+	glGenBuffers(2, vboIndicesID);
+	glGenBuffers(2, vboInstancesID);
+	glBindBuffer(GL_ARRAY_BUFFER, vboVerticesID);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(glm::vec2), &vertices[0], GL_STATIC_DRAW);
+
+	SetupPatch(vaoID[0], vboIndicesID[0], vboInstancesID[0], patchSize);
+	SetupPatch(vaoID[1], vboIndicesID[1], vboInstancesID[1], patchSize/2);
+	totalIndices[0] = patchSize*patchSize*6;
+	totalIndices[1] = (patchSize/2)*(patchSize/2)*6;
+	glBindVertexArray(0);
+	return true;
+}
+
+void CCDLODTerrain::SetupPatch(GLuint vao, GLuint indexBuffer, GLuint instanceBuffer, const int size) {
+	//all quads are split along the same diagonal, when the odd vertices
+	//collapse onto the even ones the triangles of the coarser grid are left
+	std::vector<GLushort> indices;
+	const int stride = patchSize+1;
+	for(int j=0;j<size;j++) {
+		for(int i=0;i<size;i++) {
+			GLushort i0 = GLushort(j*stride+i);
+			GLushort i1 = i0+1;
+			GLushort i2 = GLushort(i0+stride);
+			GLushort i3 = i2+1;
+			indices.push_back(i0);
+			indices.push_back(i2);
+			indices.push_back(i1);
+			indices.push_back(i1);
+			indices.push_back(i2);
+			indices.push_back(i3);
+		}
+	}
+
+	glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, vboVerticesID);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), 0);
+		glVertexAttribDivisor(1, 1);
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (const GLvoid*)(sizeof(glm::vec4)));
+		glVertexAttribDivisor(2, 1);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+}
+
+void CCDLODTerrain::Destroy() {
+	shader.DeleteShaderProgram();
+	glDeleteBuffers(1, &vboVerticesID);
+	glDeleteBuffers(2, vboIndicesID);
+	glDeleteBuffers(2, vboInstancesID);
+	glDeleteVertexArrays(2, vaoID);
+}
+
+void CCDLODTerrain::SetDetail(const int screenHeight, const float fovY, const float pixelsPerTriangle) {
+	//distance at which a grid cell of the finest level covers the given
+	//number of pixels, cells of every next level are twice as large
+	float d = spacing*screenHeight/(2.0f*tanf(glm::radians(fovY)*0.5f)*pixelsPerTriangle);
+
+	//a node must be small compared to its range or its children could be
+	//more than one level apart from their neighbours
+	d = std::max(d, 2.0f*patchSize*spacing);
+	const int top = pyramid->GetTotalLevels()-1;
+	for(int i=0;i<MAX_LEVELS;i++) {
+		ranges[i] = (i<top)? d : FLT_MAX;
+		d *= 2;
+	}
+}
+
+int CCDLODTerrain::GetTotalTriangles() const {
+	return int(fullNodes.size())*totalIndices[0]/3 + int(halfNodes.size())*totalIndices[1]/3;
+}
+
+void CCDLODTerrain::GetNodeBox(const int level, const int x, const int z, glm::vec3& min, glm::vec3& max) const {
+	const float size = float(patchSize<<level)*spacing;
+	const float halfWidth = (pyramid->GetWidth()-1)*spacing*0.5f;
+	const float halfDepth = (pyramid->GetDepth()-1)*spacing*0.5f;
+	min = glm::vec3(x*size-halfWidth, pyramid->GetMinHeight(level, x, z)*heightScale, z*size-halfDepth);
+	max = glm::vec3(min.x+size, pyramid->GetMaxHeight(level, x, z)*heightScale, min.z+size);
+}
+
+bool CCDLODTerrain::IsVisible(const glm::vec3& min, const glm::vec3& max) const {
+	for(int i=0;i<6;i++) {
+		//corner of the box furthest along the plane normal
+		glm::vec3 p(planes[i].x>0? max.x : min.x,
+					planes[i].y>0? max.y : min.y,
+					planes[i].z>0? max.z : min.z);
+		if(glm::dot(glm::vec3(planes[i]), p) + planes[i].w < 0)
+			return false;
+	}
+	return true;
+}
+
+bool CCDLODTerrain::IsInRange(const glm::vec3& min, const glm::vec3& max, const float range) const {
+	if(range == FLT_MAX)
+		return true;
+	glm::vec3 closest = glm::clamp(eye, min, max);
+	glm::vec3 d = closest - eye;
+	return glm::dot(d, d) <= range*range;
+}
+
+void CCDLODTerrain::Select(const glm::mat4& VP, const glm::vec3& eyePos) {
+	eye = eyePos;
+	fullNodes.clear();
+	halfNodes.clear();
+
+	//frustum planes from the rows of the view projection matrix
+	glm::vec4 r0 = glm::row(VP, 0), r1 = glm::row(VP, 1), r2 = glm::row(VP, 2), r3 = glm::row(VP, 3);
+	planes[0] = r3+r0; planes[1] = r3-r0;
+	planes[2] = r3+r1; planes[3] = r3-r1;
+	planes[4] = r3+r2; planes[5] = r3-r2;
+
+	const int top = pyramid->GetTotalLevels()-1;
+	for(int z=0;z<pyramid->GetTilesZ(top);z++)
+		for(int x=0;x<pyramid->GetTilesX(top);x++)
+			SelectNode(top, x, z);
+}
+
+void CCDLODTerrain::SelectNode(const int level, const int x, const int z) {
+	glm::vec3 min, max;
+	GetNodeBox(level, x, z, min, max);
+	if(!IsVisible(min, max))
+		return;
+
+	//the caller made sure the tile is resident
+	int slot = cache->Request(level, x, z);
+	if(level==0 || !IsInRange(min, max, ranges[level-1])) {
+		AddNode(level, x, z, slot, -1);
+		return;
+	}
+
+	//children closer than the range of their level are split off, the rest
+	//of the node is drawn with quarter patches. The node is only split once
+	//the tiles of all visible children in range are resident.
+	bool split[4] = {false, false, false, false};
+	bool visible[4] = {false, false, false, false};
+	bool resident = true;
+	for(int c=0;c<4;c++) {
+		int cx = x*2+(c&1), cz = z*2+(c>>1);
+		if(cx >= pyramid->GetTilesX(level-1) || cz >= pyramid->GetTilesZ(level-1))
+			continue;
+		GetNodeBox(level-1, cx, cz, min, max);
+		visible[c] = IsVisible(min, max);
+		split[c] = visible[c] && IsInRange(min, max, ranges[level-1]);
+		if(split[c] && cache->Request(level-1, cx, cz) < 0)
+			resident = false;
+	}
+	if(!resident) {
+		AddNode(level, x, z, slot, -1);
+		return;
+	}
+	for(int c=0;c<4;c++) {
+		if(split[c])
+			SelectNode(level-1, x*2+(c&1), z*2+(c>>1));
+		else if(visible[c])
+			AddNode(level, x, z, slot, c);
+	}
+}
+
+void CCDLODTerrain::AddNode(const int level, const int x, const int z, const int slot, const int quarter) {
+	glm::vec3 min, max;
+	GetNodeBox(level, x, z, min, max);
+	const float cellSize = float(1<<level)*spacing;
+	Instance instance;
+	if(quarter<0) {
+		instance.node = glm::vec4(min.x, min.z, cellSize, float(level));
+		instance.tile = glm::vec4(0, 0, float(slot), 0);
+		fullNodes.push_back(instance);
+	} else {
+		//offset of the quarter in grid cells, always even so the morph
+		//pattern matches the full patch
+		float ox = float((quarter&1)*(patchSize/2));
+		float oz = float((quarter>>1)*(patchSize/2));
+		instance.node = glm::vec4(min.x+ox*cellSize, min.z+oz*cellSize, cellSize, float(level));
+		instance.tile = glm::vec4(ox, oz, float(slot), 0);
+		halfNodes.push_back(instance);
+	}
+}
+
+void CCDLODTerrain::Render(const glm::mat4& MVP, const glm::vec3& eyePos) {
+	//morph start and end distance of every level
+	glm::vec2 morphRange[MAX_LEVELS];
+	float prev = 0;
+	for(int i=0;i<MAX_LEVELS;i++) {
+		if(ranges[i] == FLT_MAX)
+			morphRange[i] = glm::vec2(1e30f, 2e30f);
+		else
+			morphRange[i] = glm::vec2(prev + (ranges[i]-prev)*MORPH_START, ranges[i]);
+		prev = ranges[i];
+	}
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, cache->GetTextureID());
+	shader.Use();
+		glUniformMatrix4fv(shader("MVP"), 1, GL_FALSE, glm::value_ptr(MVP));
+		glUniform3fv(shader("eyePos"), 1, glm::value_ptr(eyePos));
+		glUniform2fv(shader("morphRange"), MAX_LEVELS, glm::value_ptr(morphRange[0]));
+
+		std::vector<Instance>* nodes[2] = {&fullNodes, &halfNodes};
+		for(int i=0;i<2;i++) {
+			if(nodes[i]->empty())
+				continue;
+			glBindBuffer(GL_ARRAY_BUFFER, vboInstancesID[i]);
+			glBufferData(GL_ARRAY_BUFFER, nodes[i]->size()*sizeof(Instance), &(*nodes[i])[0], GL_STREAM_DRAW);
+			glBindVertexArray(vaoID[i]);
+			glDrawElementsInstanced(GL_TRIANGLES, totalIndices[i], GL_UNSIGNED_SHORT, 0, GLsizei(nodes[i]->size()));
+		}
+		glBindVertexArray(0);
+	shader.UnUse();
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "GLSLShader.h"
+#include "HeightmapPyramid.h"
+#include "TerrainTileCache.h"
+
+//Continuous distance dependent level of detail (CDLOD) terrain. The terrain
+//is a quadtree matching the tiles of a heightmap pyramid, a node of level L
+//covers one tile of level L. Every frame the quadtree is traversed, nodes
+//outside the view frustum are skipped and a node is split while its children
+//are within the distance range of their level. The selected nodes are drawn
+//as instances of one shared grid patch whose vertices morph smoothly into
+//the coarser grid towards the end of the range of their level, so there are
+//no cracks or popping between levels. Nodes are only split once the tiles of
+//their children are resident in the tile cache.
+class CCDLODTerrain
+{
+public:
+	//deepest quadtree supported by the shader
+	static const int MAX_LEVELS = 16;
+
+	CCDLODTerrain(void);
+	~CCDLODTerrain(void);
+
+	//spacing is the world distance between two samples of the finest level,
+	//heights in [0,1] are scaled by heightScale. The terrain is centred on
+	//the origin.
+	bool Init(CHeightmapPyramid* pyramid, CTerrainTileCache* cache, const float spacing, const float heightScale);
+	void Destroy();
+
+	//sets the distance ranges so a triangle of the finest level covers about
+	//pixelsPerTriangle pixels at the end of its range, the triangle count
+	//then depends on the screen size and not on the size of the terrain
+	void SetDetail(const int screenHeight, const float fovY, const float pixelsPerTriangle);
+
+	//selects the nodes to draw for the given camera
+	void Select(const glm::mat4& VP, const glm::vec3& eye);
+	void Render(const glm::mat4& MVP, const glm::vec3& eye);
+
+	int GetTotalNodes() const { return int(fullNodes.size() + halfNodes.size()); }
+	int GetTotalTriangles() const;
+	float GetRange(const int level) const { return ranges[level]; }
+
+private:
+	//per instance data, the patch origin and grid spacing in world space and
+	//its level, and the tile layer and the texel offset of the patch in it
+	struct Instance {
+		glm::vec4 node;
+		glm::vec4 tile;
+	};
+
+	void SelectNode(const int level, const int x, const int z);
+	void AddNode(const int level, const int x, const int z, const int slot, const int quarter);
+	void GetNodeBox(const int level, const int x, const int z, glm::vec3& min, glm::vec3& max) const;
+	bool IsVisible(const glm::vec3& min, const glm::vec3& max) const;
+	bool IsInRange(const glm::vec3& min, const glm::vec3& max, const float range) const;
+	void SetupPatch(GLuint vao, GLuint indexBuffer, GLuint instanceBuffer, const int size);
+
+	CHeightmapPyramid* pyramid;
+	CTerrainTileCache* cache;
+	GLSLShader shader;
+	float spacing, heightScale;
+	int patchSize;
+	float ranges[MAX_LEVELS];
+
+	//the full patch and the quarter patch used where only some of the
+	//children of a node are split
+	GLuint vaoID[2];
+	GLuint vboVerticesID;
+	GLuint vboIndicesID[2];
+	GLuint vboInstancesID[2];
+	int totalIndices[2];
+
+	std::vector<Instance> fullNodes, halfNodes;
+	glm::vec4 planes[6];
+	glm::vec3 eye;
+};
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "HeightmapPyramid.h"
+#include <algorithm>
+#include <cstring>
+
+const char MAGIC[4] = {'H','M','P','Y'};
+const int VERSION = 2;
+
+//64 bit file seek, pyramids of large heightmaps are bigger than 2GB
+static int Seek(FILE* fp, const long long offset) {
+#ifdef _WIN32
+	return _fseeki64(fp, offset, SEEK_SET);
+#else
+	return fseeko(fp, off_t(offset), SEEK_SET);
+#endif
+}
+
+CHeightmapPyramid::CHeightmapPyramid(void)
+{
+	file = 0;
+	width = depth = 0;
+	tileSize = 0;
+	totalLevels = 0;
+	sourceKey = 0;
+	dataOffset = 0;
+}
+
+CHeightmapPyramid::~CHeightmapPyramid(void)
+{
+	Close();
+}
+
+void CHeightmapPyramid::SetupLevels() {
+	tilesX.clear();
+	tilesZ.clear();
+	levelStart.clear();
+	int tx = (width+tileSize-1)/tileSize;
+	int tz = (depth+tileSize-1)/tileSize;
+	int total = 0;
+	while(true) {
+		tilesX.push_back(tx);
+		tilesZ.push_back(tz);
+		levelStart.push_back(total);
+		total += tx*tz;
+		if(tx==1 && tz==1)
+			break;
+		tx = (tx+1)/2;
+		tz = (tz+1)/2;
+	}
+	totalLevels = int(tilesX.size());
+	minMax.assign(total*2, 0);
+}
+
+bool CHeightmapPyramid::Build(const std::string& filename, const int width, const int depth, const int tileSize,
+							  HeightFunction function, void* userData, const int sourceKey) {
+	CHeightmapPyramid pyramid;
+	pyramid.width = width;
+	pyramid.depth = depth;
+	pyramid.tileSize = tileSize;
+	pyramid.SetupLevels();
+
+	FILE* fp = fopen(filename.c_str(), "wb");
+	if(!fp)
+		return false;
+
+	int header[5] = {width, depth, tileSize, pyramid.totalLevels, sourceKey};
+	fwrite(MAGIC, 1, 4, fp);
+	fwrite(&VERSION, sizeof(int), 1, fp);
+	fwrite(header, sizeof(int), 5, fp);
+	//the min/max table is filled in once all tiles are written
+	long long tableOffset = 4 + 6*sizeof(int);
+	fwrite(&pyramid.minMax[0], sizeof(unsigned short), pyramid.minMax.size(), fp);
+
+	const int stride = tileSize+1;
+	std::vector<unsigned short> samples(stride*stride);
+	for(int level=0;level<pyramid.totalLevels;level++) {
+		for(int tz=0;tz<pyramid.tilesZ[level];tz++) {
+			for(int tx=0;tx<pyramid.tilesX[level];tx++) {
+				unsigned short lo = 65535, hi = 0;
+				for(int j=0;j<stride;j++) {
+					//sample positions on the finest level, clamped at the border
+					int z = std::min(((tz*tileSize+j)<<level), depth-1);
+					for(int i=0;i<stride;i++) {
+						int x = std::min(((tx*tileSize+i)<<level), width-1);
+						float h = std::max(0.0f, std::min(1.0f, function(x, z, userData)));
+						unsigned short s = (unsigned short)(h*65535.0f+0.5f);
+						samples[j*stride+i] = s;
+						lo = std::min(lo, s);
+						hi = std::max(hi, s);
+					}
+				}
+				//include the range of the finer tiles below
+				if(level>0) {
+					for(int c=0;c<4;c++) {
+						int cx = tx*2+(c&1), cz = tz*2+(c>>1);
+						if(cx >= pyramid.tilesX[level-1] || cz >= pyramid.tilesZ[level-1])
+							continue;
+						int child = pyramid.TileIndex(level-1, cx, cz);
+						lo = std::min(lo, pyramid.minMax[child*2]);
+						hi = std::max(hi, pyramid.minMax[child*2+1]);
+					}
+				}
+				int index = pyramid.TileIndex(level, tx, tz);
+				pyramid.minMax[index*2] = lo;
+				pyramid.minMax[index*2+1] = hi;
+				fwrite(&samples[0], sizeof(unsigned short), samples.size(), fp);
+			}
+		}
+	}
+
+	Seek(fp, tableOffset);
+	fwrite(&pyramid.minMax[0], sizeof(unsigned short), pyramid.minMax.size(), fp);
+	bool ok = (ferror(fp) == 0);
+	fclose(fp);
+	return ok;
+}
+
+bool CHeightmapPyramid::Open(const std::string& filename) {
+	Close();
+	file = fopen(filename.c_str(), "rb");
+	if(!file)
+		return false;
+
+	char magic[4];
+	int version = 0;
+	int header[5];
+	if(fread(magic, 1, 4, file) != 4 || memcmp(magic, MAGIC, 4) != 0 ||
+	   fread(&version, sizeof(int), 1, file) != 1 || version != VERSION ||
+	   fread(header, sizeof(int), 5, file) != 5 ||
+	   header[0] <= 0 || header[1] <= 0 || header[2] <= 0) {
+		Close();
+		return false;
+	}
+	width = header[0];
+	depth = header[1];
+	tileSize = header[2];
+	sourceKey = header[4];
+	SetupLevels();
+	if(totalLevels != header[3] ||
+	   fread(&minMax[0], sizeof(unsigned short), minMax.size(), file) != minMax.size()) {
+		Close();
+		return false;
+	}
+	dataOffset = 4 + 6*sizeof(int) + (long long)(minMax.size()*sizeof(unsigned short));
+	return true;
+}
+
+void CHeightmapPyramid::Close() {
+	if(file)
+		fclose(file);
+	file = 0;
+}
+
+bool CHeightmapPyramid::ReadTile(const int level, const int x, const int z, unsigned short* samples) {
+	if(!file)
+		return false;
+	const size_t total = size_t(tileSize+1)*(tileSize+1);
+	long long offset = dataOffset + (long long)TileIndex(level, x, z)*total*sizeof(unsigned short);
+	if(Seek(file, offset) != 0)
+		return false;
+	return fread(samples, sizeof(unsigned short), total, file) == total;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//height in [0,1] of the sample (x,z) of the finest level, used to build a pyramid
+typedef float (*HeightFunction)(int x, int z, void* userData);
+
+//A heightmap stored on disk as a pyramid of square tiles. Level 0 holds the
+//full resolution samples and each coarser level every second sample of the
+//level below, so the even samples of a level are exactly the samples of the
+//next coarser level. Every tile stores (tileSize+1)^2 16 bit samples, the
+//last row and column repeat the first ones of the neighbouring tile so tiles
+//can be filtered on their own. Tiles are read one at a time, only the
+//minimum and maximum height of every tile are kept in memory.
+class CHeightmapPyramid
+{
+public:
+	CHeightmapPyramid(void);
+	~CHeightmapPyramid(void);
+
+	//writes the pyramid of a width x depth heightmap to filename. The height
+	//function is evaluated tile by tile so the full heightmap never has to
+	//be in memory. sourceKey is stored in the header for the caller to tell
+	//whether the pyramid was built from the same source and settings.
+	static bool Build(const std::string& filename, const int width, const int depth, const int tileSize,
+					  HeightFunction function, void* userData, const int sourceKey);
+
+	bool Open(const std::string& filename);
+	void Close();
+
+	//reads the samples of a tile, (tileSize+1)^2 values row by row
+	bool ReadTile(const int level, const int x, const int z, unsigned short* samples);
+
+	int GetWidth() const { return width; }
+	int GetDepth() const { return depth; }
+	int GetTileSize() const { return tileSize; }
+	int GetTotalLevels() const { return totalLevels; }
+	int GetSourceKey() const { return sourceKey; }
+	int GetTilesX(const int level) const { return tilesX[level]; }
+	int GetTilesZ(const int level) const { return tilesZ[level]; }
+
+	//height range in [0,1] of everything inside the tile, including the
+	//finer levels below it
+	float GetMinHeight(const int level, const int x, const int z) const { return minMax[TileIndex(level,x,z)*2]/65535.0f; }
+	float GetMaxHeight(const int level, const int x, const int z) const { return minMax[TileIndex(level,x,z)*2+1]/65535.0f; }
+
+private:
+	void SetupLevels();
+	int TileIndex(const int level, const int x, const int z) const { return levelStart[level] + z*tilesX[level] + x; }
+
+	FILE* file;
+	int width, depth;
+	int tileSize;
+	int totalLevels;
+	int sourceKey;
+	std::vector<int> tilesX, tilesZ, levelStart;
+	std::vector<unsigned short> minMax;	//min and max of every tile
+	long long dataOffset;				//file offset of the first tile
+};
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "MappedFile.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CMappedFile::CMappedFile(void)
+{
+	data = 0;
+	size = 0;
+#ifdef _WIN32
+	fileHandle = 0;
+	mappingHandle = 0;
+#endif
+}
+
+CMappedFile::~CMappedFile(void)
+{
+	Close();
+}
+
+bool CMappedFile::Open(const std::string& filename) {
+	Close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+							  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if(file==INVALID_HANDLE_VALUE)
+		return false;
+	fileHandle = file;
+	LARGE_INTEGER fileSize;
+	if(GetFileSizeEx(file, &fileSize) && fileSize.QuadPart>0) {
+		mappingHandle = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+		if(mappingHandle)
+			data = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		size = size_t(fileSize.QuadPart);
+	}
+#else
+	int file = open(filename.c_str(), O_RDONLY);
+	if(file<0)
+		return false;
+	struct stat info;
+	if(fstat(file, &info)==0 && info.st_size>0) {
+		void* view = mmap(0, size_t(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		if(view!=MAP_FAILED) {
+			data = (const char*)view;
+			size = size_t(info.st_size);
+		}
+	}
+	close(file);
+#endif
+	if(!data) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void CMappedFile::Close() {
+#ifdef _WIN32
+	if(data)
+		UnmapViewOfFile(data);
+	if(mappingHandle)
+		CloseHandle(mappingHandle);
+	if(fileHandle)
+		CloseHandle(fileHandle);
+	fileHandle = 0;
+	mappingHandle = 0;
+#else
+	if(data)
+		munmap((void*)data, size);
+#endif
+	data = 0;
+	size = 0;
+}
\ No newline at end of file
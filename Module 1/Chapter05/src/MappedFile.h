@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+//A file mapped read only into memory. The pages are read by the system as
+//they are touched, so parsers can work on the file contents in place.
+class CMappedFile
+{
+public:
+	CMappedFile(void);
+	~CMappedFile(void);
+
+	bool Open(const std::string& filename);
+	void Close();
+
+	bool IsOpen() const { return data!=0; }
+	const char* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+
+private:
+	CMappedFile(const CMappedFile&);
+	CMappedFile& operator=(const CMappedFile&);
+
+	const char* data;
+	size_t size;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,397 @@
+#include "ParticleSystem.h"
+#include "Timer.h"
+#include <emmintrin.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+#include <algorithm>
+#include <cmath>
+
+const float PI = 3.14159265f;
+
+static float* AllocateArray(const int count) {
+	return static_cast<float*>(_mm_malloc(count*sizeof(float), 32));
+}
+
+static void FreeArray(float*& p) {
+	if(p)
+		_mm_free(p);
+	p = 0;
+}
+
+//xorshift random number in [0,1)
+static float Random(unsigned int& seed) {
+	seed ^= seed<<13;
+	seed ^= seed>>17;
+	seed ^= seed<<5;
+	return (seed>>8)*(1.0f/16777216.0f);
+}
+
+CParticleSystem::CParticleSystem(void)
+{
+	pool = 0;
+	total = alive = 0;
+	maxLife = 1;
+	acceleration = glm::vec3(0,2,0);
+	emitterShape = POINT_EMITTER;
+	sorting = true;
+	px = py = pz = 0;
+	vx = vy = vz = 0;
+	age = life = depth = 0;
+	vertices = 0;
+	dt = 0;
+	minDepth = maxDepth = 0;
+	pass = 0;
+	writeTarget = 0;
+	totalBlocks = 0;
+	updateTime = sortTime = writeTime = 0;
+}
+
+CParticleSystem::~CParticleSystem(void)
+{
+	Destroy();
+}
+
+void CParticleSystem::Init(const int maxParticles, const float life, CThreadPool* threadPool) {
+	Destroy();
+	pool = threadPool;
+	maxLife = life;
+	//round up to the SIMD width so the kernels need no remainder loop
+	total = (maxParticles+7) & ~7;
+	alive = 0;
+
+	px = AllocateArray(total); py = AllocateArray(total); pz = AllocateArray(total);
+	vx = AllocateArray(total); vy = AllocateArray(total); vz = AllocateArray(total);
+	age = AllocateArray(total); this->life = AllocateArray(total);
+	depth = AllocateArray(total);
+	vertices = AllocateArray(total*4);
+
+	int totalChunks = (total+CHUNK_SIZE-1)/CHUNK_SIZE;
+	chunkStats.resize(totalChunks);
+	seeds.resize(totalChunks);
+	for(int i=0;i<totalChunks;i++)
+		seeds[i] = 2654435761u*(i+1);
+
+	//particle i is emitted i*maxLife/total seconds after the start
+	unsigned int seed = 1234567;
+	for(int i=0;i<total;i++) {
+		Respawn(i, seed);
+		age[i] = -i*maxLife/total;
+		depth[i] = 0;
+	}
+
+	totalBlocks = std::max(1, std::min(pool->GetTotalThreads(), total/1024));
+	for(int i=0;i<2;i++) {
+		keys[i].resize(total);
+		indices[i].resize(total);
+	}
+	histograms.resize(totalBlocks*RADIX_SIZE);
+}
+
+void CParticleSystem::Destroy() {
+	FreeArray(px); FreeArray(py); FreeArray(pz);
+	FreeArray(vx); FreeArray(vy); FreeArray(vz);
+	FreeArray(age); FreeArray(life);
+	FreeArray(depth);
+	FreeArray(vertices);
+	total = alive = 0;
+}
+
+void CParticleSystem::Respawn(const int i, unsigned int& seed) {
+	//random direction in a cone of 30 degrees around the y axis
+	float theta = Random(seed)*PI/6.0f;
+	float phi = Random(seed)*2.0f*PI;
+	vx[i] = sinf(theta)*cosf(phi);
+	vy[i] = cosf(theta);
+	vz[i] = sinf(theta)*sinf(phi);
+
+	float r0 = Random(seed), r1 = Random(seed);
+	switch(emitterShape) {
+		case POINT_EMITTER:
+			px[i] = py[i] = pz[i] = 0;
+		break;
+		case QUAD_EMITTER:
+			px[i] = r0*2-1; py[i] = 0; pz[i] = r1*2-1;
+		break;
+		case DISC_EMITTER: {
+			float r = sqrtf(r0), a = r1*2.0f*PI;
+			px[i] = r*cosf(a); py[i] = 0; pz[i] = r*sinf(a);
+		}
+		break;
+	}
+	life[i] = maxLife*(0.75f + 0.25f*Random(seed));
+}
+
+void CParticleSystem::UpdateChunk(const int chunk) {
+	const int start = chunk*CHUNK_SIZE;
+	const int end = std::min(total, start+CHUNK_SIZE);
+	unsigned int& seed = seeds[chunk];
+	int i = start;
+
+#if defined(__AVX__)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 t = _mm256_set1_ps(dt);
+		const __m256 ax = _mm256_set1_ps(acceleration.x*dt), ay = _mm256_set1_ps(acceleration.y*dt), az = _mm256_set1_ps(acceleration.z*dt);
+		const __m256 rx = _mm256_set1_ps(-depthRow.x), ry = _mm256_set1_ps(-depthRow.y);
+		const __m256 rz = _mm256_set1_ps(-depthRow.z), rw = _mm256_set1_ps(-depthRow.w);
+		for(; i<end; i+=8) {
+			//aging, particles only move once they are emitted
+			__m256 a = _mm256_add_ps(_mm256_load_ps(age+i), t);
+			__m256 active = _mm256_cmp_ps(a, zero, _CMP_GT_OQ);
+			_mm256_store_ps(age+i, a);
+
+			//semi-implicit Euler integration
+			__m256 x = _mm256_add_ps(_mm256_load_ps(vx+i), _mm256_and_ps(active, ax));
+			__m256 y = _mm256_add_ps(_mm256_load_ps(vy+i), _mm256_and_ps(active, ay));
+			__m256 z = _mm256_add_ps(_mm256_load_ps(vz+i), _mm256_and_ps(active, az));
+			_mm256_store_ps(vx+i, x); _mm256_store_ps(vy+i, y); _mm256_store_ps(vz+i, z);
+			__m256 step = _mm256_and_ps(active, t);
+			x = _mm256_add_ps(_mm256_load_ps(px+i), _mm256_mul_ps(x, step));
+			y = _mm256_add_ps(_mm256_load_ps(py+i), _mm256_mul_ps(y, step));
+			z = _mm256_add_ps(_mm256_load_ps(pz+i), _mm256_mul_ps(z, step));
+			_mm256_store_ps(px+i, x); _mm256_store_ps(py+i, y); _mm256_store_ps(pz+i, z);
+
+			//distance along the view direction
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rx, x), _mm256_mul_ps(ry, y)),
+									 _mm256_add_ps(_mm256_mul_ps(rz, z), rw));
+			_mm256_store_ps(depth+i, d);
+
+			//particles at the end of their life go back to the emitter
+			int dead = _mm256_movemask_ps(_mm256_cmp_ps(a, _mm256_load_ps(life+i), _CMP_GE_OQ));
+			for(int k=0; dead; k++, dead>>=1) {
+				if(dead & 1) {
+					int j = i+k;
+					float overshoot = age[j]-life[j];
+					Respawn(j, seed);
+					age[j] = (overshoot < life[j])? overshoot : 0;
+					depth[j] = -(depthRow.x*px[j] + depthRow.y*py[j] + depthRow.z*pz[j] + depthRow.w);
+				}
+			}
+		}
+	}
+#else
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 t = _mm_set1_ps(dt);
+		const __m128 ax = _mm_set1_ps(acceleration.x*dt), ay = _mm_set1_ps(acceleration.y*dt), az = _mm_set1_ps(acceleration.z*dt);
+		const __m128 rx = _mm_set1_ps(-depthRow.x), ry = _mm_set1_ps(-depthRow.y);
+		const __m128 rz = _mm_set1_ps(-depthRow.z), rw = _mm_set1_ps(-depthRow.w);
+		for(; i<end; i+=4) {
+			//aging, particles only move once they are emitted
+			__m128 a = _mm_add_ps(_mm_load_ps(age+i), t);
+			__m128 active = _mm_cmpgt_ps(a, zero);
+			_mm_store_ps(age+i, a);
+
+			//semi-implicit Euler integration
+			__m128 x = _mm_add_ps(_mm_load_ps(vx+i), _mm_and_ps(active, ax));
+			__m128 y = _mm_add_ps(_mm_load_ps(vy+i), _mm_and_ps(active, ay));
+			__m128 z = _mm_add_ps(_mm_load_ps(vz+i), _mm_and_ps(active, az));
+			_mm_store_ps(vx+i, x); _mm_store_ps(vy+i, y); _mm_store_ps(vz+i, z);
+			__m128 step = _mm_and_ps(active, t);
+			x = _mm_add_ps(_mm_load_ps(px+i), _mm_mul_ps(x, step));
+			y = _mm_add_ps(_mm_load_ps(py+i), _mm_mul_ps(y, step));
+			z = _mm_add_ps(_mm_load_ps(pz+i), _mm_mul_ps(z, step));
+			_mm_store_ps(px+i, x); _mm_store_ps(py+i, y); _mm_store_ps(pz+i, z);
+
+			//distance along the view direction
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, x), _mm_mul_ps(ry, y)),
+								  _mm_add_ps(_mm_mul_ps(rz, z), rw));
+			_mm_store_ps(depth+i, d);
+
+			//particles at the end of their life go back to the emitter
+			int dead = _mm_movemask_ps(_mm_cmpge_ps(a, _mm_load_ps(life+i)));
+			for(int k=0; dead; k++, dead>>=1) {
+				if(dead & 1) {
+					int j = i+k;
+					float overshoot = age[j]-life[j];
+					Respawn(j, seed);
+					age[j] = (overshoot < life[j])? overshoot : 0;
+					depth[j] = -(depthRow.x*px[j] + depthRow.y*py[j] + depthRow.z*pz[j] + depthRow.w);
+				}
+			}
+		}
+	}
+#endif
+
+	//depth range and count of the emitted particles
+	ChunkStats& stats = chunkStats[chunk];
+	stats.minDepth = 1e30f;
+	stats.maxDepth = -1e30f;
+	stats.alive = 0;
+	for(i=start; i<end; i++) {
+		if(age[i] > 0) {
+			stats.minDepth = std::min(stats.minDepth, depth[i]);
+			stats.maxDepth = std::max(stats.maxDepth, depth[i]);
+			stats.alive++;
+		}
+	}
+}
+
+void CParticleSystem::GetBlockRange(const int block, const int count, int& start, int& end) const {
+	//block boundaries are kept on a multiple of 4 for the SSE loops
+	start = int((long long)count*block/totalBlocks) & ~3;
+	end = (block == totalBlocks-1)? count : (int((long long)count*(block+1)/totalBlocks) & ~3);
+}
+
+void CParticleSystem::ComputeKeys(const int block) {
+	int start, end;
+	GetBlockRange(block, total, start, end);
+	unsigned int* k = &keys[0][0];
+	unsigned int* index = &indices[0][0];
+	int* histogram = &histograms[block*RADIX_SIZE];
+	std::fill(histogram, histogram+RADIX_SIZE, 0);
+
+	//the farthest particle gets key 0 so the ascending sort is back to front
+	const float scale = (maxDepth > minDepth)? float(MAX_KEY-1)/(maxDepth-minDepth) : 0.0f;
+	const __m128 far = _mm_set1_ps(maxDepth);
+	const __m128 s = _mm_set1_ps(scale);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 largest = _mm_set1_ps(float(MAX_KEY-1));
+	const __m128 unused = _mm_set1_ps(float(MAX_KEY));
+	for(int i=start; i<end; i+=4) {
+		__m128 a = _mm_load_ps(age+i);
+		__m128 q = _mm_mul_ps(_mm_sub_ps(far, _mm_load_ps(depth+i)), s);
+		q = _mm_min_ps(_mm_max_ps(q, zero), largest);
+		__m128 active = _mm_cmpgt_ps(a, zero);
+		q = _mm_or_ps(_mm_and_ps(active, q), _mm_andnot_ps(active, unused));
+		_mm_storeu_si128((__m128i*)(k+i), _mm_cvttps_epi32(q));
+		for(int j=i;j<i+4;j++) {
+			index[j] = j;
+			histogram[k[j] & (RADIX_SIZE-1)]++;
+		}
+		WriteVertices(i, a, vertices+i*4);
+	}
+}
+
+void CParticleSystem::Histogram(const int block, const unsigned int* k, const int shift) {
+	int start, end;
+	GetBlockRange(block, total, start, end);
+	int* histogram = &histograms[block*RADIX_SIZE];
+	std::fill(histogram, histogram+RADIX_SIZE, 0);
+	for(int i=start; i<end; i++)
+		histogram[(k[i]>>shift) & (RADIX_SIZE-1)]++;
+}
+
+void CParticleSystem::PrefixSum() {
+	//turn the counts into output offsets, digit by digit and within a digit
+	//block by block so the sort is stable
+	int sum = 0;
+	for(int d=0;d<RADIX_SIZE;d++) {
+		for(int b=0;b<totalBlocks;b++) {
+			int& h = histograms[b*RADIX_SIZE+d];
+			int count = h;
+			h = sum;
+			sum += count;
+		}
+	}
+}
+
+void CParticleSystem::Scatter(const int block, const unsigned int* srcKeys, const unsigned int* srcIndices,
+							  unsigned int* dstKeys, unsigned int* dstIndices, const int shift) {
+	int start, end;
+	GetBlockRange(block, total, start, end);
+	int* offsets = &histograms[block*RADIX_SIZE];
+	for(int i=start; i<end; i++) {
+		int o = offsets[(srcKeys[i]>>shift) & (RADIX_SIZE-1)]++;
+		dstKeys[o] = srcKeys[i];
+		dstIndices[o] = srcIndices[i];
+	}
+}
+
+void CParticleSystem::WriteBlock(const int block) {
+	int start, end;
+	if(sorting) {
+		//gather the vertices built with the keys in sorted order
+		GetBlockRange(block, alive, start, end);
+		const unsigned int* index = &indices[0][0];
+		for(int k=start; k<end; k++)
+			_mm_storeu_ps(writeTarget + k*4, _mm_load_ps(vertices + index[k]*4));
+		return;
+	}
+
+	//unsorted particles are written in place
+	GetBlockRange(block, total, start, end);
+	for(int i=start; i<end; i+=4)
+		WriteVertices(i, _mm_load_ps(age+i), writeTarget+i*4);
+}
+
+void CParticleSystem::WriteVertices(const int i, const __m128 a, float* v) const {
+	//four particles as (x, y, z, alpha), particles that are not emitted yet
+	//get a zero alpha
+	const __m128 zero = _mm_setzero_ps();
+	__m128 alpha = _mm_and_ps(_mm_cmpgt_ps(a, zero), _mm_sub_ps(_mm_set1_ps(1.0f), _mm_div_ps(a, _mm_load_ps(life+i))));
+	__m128 x = _mm_load_ps(px+i), y = _mm_load_ps(py+i), z = _mm_load_ps(pz+i);
+	_MM_TRANSPOSE4_PS(x, y, z, alpha);
+	_mm_storeu_ps(v, x);
+	_mm_storeu_ps(v+4, y);
+	_mm_storeu_ps(v+8, z);
+	_mm_storeu_ps(v+12, alpha);
+}
+
+void CParticleSystem::UpdateTask(int task, void* data) {
+	static_cast<CParticleSystem*>(data)->UpdateChunk(task);
+}
+
+void CParticleSystem::KeysTask(int task, void* data) {
+	static_cast<CParticleSystem*>(data)->ComputeKeys(task);
+}
+
+void CParticleSystem::HistogramTask(int task, void* data) {
+	CParticleSystem* ps = static_cast<CParticleSystem*>(data);
+	ps->Histogram(task, &ps->keys[1][0], RADIX_BITS);
+}
+
+void CParticleSystem::ScatterTask(int task, void* data) {
+	CParticleSystem* ps = static_cast<CParticleSystem*>(data);
+	int src = ps->pass, dst = 1-ps->pass;
+	ps->Scatter(task, &ps->keys[src][0], &ps->indices[src][0], &ps->keys[dst][0], &ps->indices[dst][0], src*RADIX_BITS);
+}
+
+void CParticleSystem::WriteTask(int task, void* data) {
+	static_cast<CParticleSystem*>(data)->WriteBlock(task);
+}
+
+void CParticleSystem::Update(const float deltaTime, const glm::mat4& MV) {
+	if(total == 0)
+		return;
+	CTimer timer;
+	dt = deltaTime;
+	depthRow = glm::vec4(MV[0][2], MV[1][2], MV[2][2], MV[3][2]);
+	pool->Run(int(chunkStats.size()), UpdateTask, this);
+
+	minDepth = 1e30f;
+	maxDepth = -1e30f;
+	alive = 0;
+	for(size_t i=0;i<chunkStats.size();i++) {
+		minDepth = std::min(minDepth, chunkStats[i].minDepth);
+		maxDepth = std::max(maxDepth, chunkStats[i].maxDepth);
+		alive += chunkStats[i].alive;
+	}
+	updateTime = timer.Elapsed();
+
+	sortTime = 0;
+	if(!sorting)
+		return;
+
+	//two pass LSD radix sort of (key, index) pairs, ping ponging between
+	//the two buffers so the result ends up in the first one
+	timer.Start();
+	pool->Run(totalBlocks, KeysTask, this);
+	PrefixSum();
+	pass = 0;
+	pool->Run(totalBlocks, ScatterTask, this);
+	pool->Run(totalBlocks, HistogramTask, this);
+	PrefixSum();
+	pass = 1;
+	pool->Run(totalBlocks, ScatterTask, this);
+	sortTime = timer.Elapsed();
+}
+
+int CParticleSystem::Write(float* dst) {
+	CTimer timer;
+	writeTarget = dst;
+	pool->Run(totalBlocks, WriteTask, this);
+	writeTime = timer.Elapsed();
+	return sorting? alive : total;
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <xmmintrin.h>
+#include <vector>
+#include "ThreadPool.h"
+
+//CPU particle system for large particle counts. Particles are stored as a
+//structure of arrays so that integration and aging run on 4 (SSE) or 8 (AVX)
+//particles per instruction, and the update is split into chunks that run
+//on a thread pool. Every particle is emitted at a fixed time offset and is
+//respawned at the emitter when its life is over, so the pool never needs
+//compaction. For alpha blending the alive particles are sorted back to
+//front by their view depth with a parallel radix sort on quantized depth.
+class CParticleSystem
+{
+public:
+	enum EmitterShape {POINT_EMITTER, QUAD_EMITTER, DISC_EMITTER};
+
+	CParticleSystem(void);
+	~CParticleSystem(void);
+
+	//allocates maxParticles particles with a life of at most maxLife seconds,
+	//the particles are emitted evenly over the first maxLife seconds
+	void Init(const int maxParticles, const float maxLife, CThreadPool* pool);
+	void Destroy();
+
+	void SetAcceleration(const glm::vec3& a) { acceleration = a; }
+	void SetEmitterShape(const EmitterShape shape) { emitterShape = shape; }
+	void SetSorting(const bool sort) { sorting = sort; }
+	bool IsSorting() const { return sorting; }
+
+	//advances the particles by dt seconds. MV transforms emitter space into
+	//eye space and is only used for sorting.
+	void Update(const float dt, const glm::mat4& MV);
+
+	//writes the particles to draw as (x, y, z, alpha), back to front when
+	//sorting. dst must have room for GetTotalParticles() vec4s. Returns the
+	//number of particles written.
+	int Write(float* dst);
+
+	int GetTotalParticles() const { return total; }
+	int GetTotalAlive() const { return alive; }
+
+	//CPU time of the last update, sort and write in milliseconds
+	float GetUpdateTime() const { return updateTime; }
+	float GetSortTime() const { return sortTime; }
+	float GetWriteTime() const { return writeTime; }
+
+private:
+	//quantized depth keys are sorted in two passes of 11 bits
+	static const int RADIX_BITS = 11;
+	static const int RADIX_SIZE = 1<<RADIX_BITS;
+	//largest key, given to particles that are not emitted yet so they sort last
+	static const unsigned int MAX_KEY = (1u<<(2*RADIX_BITS))-1;
+	//particles per update task, a multiple of the SIMD width
+	static const int CHUNK_SIZE = 16384;
+
+	struct ChunkStats {
+		float minDepth, maxDepth;
+		int alive;
+	};
+
+	void Respawn(const int i, unsigned int& seed);
+	void UpdateChunk(const int chunk);
+	void ComputeKeys(const int block);
+	void Histogram(const int block, const unsigned int* keys, const int shift);
+	void Scatter(const int block, const unsigned int* srcKeys, const unsigned int* srcIndices,
+				 unsigned int* dstKeys, unsigned int* dstIndices, const int shift);
+	void PrefixSum();
+	void WriteBlock(const int block);
+	void WriteVertices(const int i, const __m128 age, float* v) const;
+	void GetBlockRange(const int block, const int count, int& start, int& end) const;
+
+	static void UpdateTask(int task, void* data);
+	static void KeysTask(int task, void* data);
+	static void HistogramTask(int task, void* data);
+	static void ScatterTask(int task, void* data);
+	static void WriteTask(int task, void* data);
+
+	CThreadPool* pool;
+	int total, alive;
+	float maxLife;
+	glm::vec3 acceleration;
+	EmitterShape emitterShape;
+	bool sorting;
+
+	//structure of arrays particle data
+	float *px, *py, *pz;
+	float *vx, *vy, *vz;
+	float *age, *life;
+	float *depth;
+	//the particles as vertices in index order, gathered after sorting
+	float *vertices;
+
+	//state of the current frame shared with the tasks
+	float dt;
+	glm::vec4 depthRow;				//row of MV giving the eye space z
+	float minDepth, maxDepth;
+	int pass;
+	float* writeTarget;
+	std::vector<ChunkStats> chunkStats;
+	std::vector<unsigned int> seeds;	//random number state of every chunk
+
+	//radix sort buffers, per block digit counts and the sorted indices
+	int totalBlocks;
+	std::vector<unsigned int> keys[2], indices[2];
+	std::vector<int> histograms;
+
+	float updateTime, sortTime, writeTime;
+};
\ No newline at end of file
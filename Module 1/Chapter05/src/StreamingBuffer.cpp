@@ -0,0 +1,91 @@
+#include "StreamingBuffer.h"
+
+CStreamingBuffer::CStreamingBuffer(void)
+{
+	bufferID = 0;
+	regionSize = 0;
+	totalRegions = 0;
+	current = 0;
+	persistent = false;
+	mapped = 0;
+	totalStalls = 0;
+	for(int i=0;i<MAX_REGIONS;i++)
+		fences[i] = 0;
+}
+
+CStreamingBuffer::~CStreamingBuffer(void)
+{
+}
+
+bool CStreamingBuffer::Init(const GLsizeiptr size, const int regions) {
+	Destroy();
+	regionSize = size;
+	totalRegions = (regions < 1)? 1 : (regions > MAX_REGIONS)? MAX_REGIONS : regions;
+	current = totalRegions-1;
+	totalStalls = 0;
+
+	glGenBuffers(1, &bufferID);
+	glBindBuffer(GL_ARRAY_BUFFER, bufferID);
+	persistent = (GLEW_ARB_buffer_storage == GL_TRUE);
+	if(persistent) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, regionSize*totalRegions, 0, flags);
+		mapped = static_cast<char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize*totalRegions, flags));
+		if(!mapped)
+			return false;
+	} else {
+		glBufferData(GL_ARRAY_BUFFER, regionSize*totalRegions, 0, GL_STREAM_DRAW);
+	}
+	return true;
+}
+
+void CStreamingBuffer::Destroy() {
+	for(int i=0;i<MAX_REGIONS;i++) {
+		if(fences[i])
+			glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+	if(bufferID) {
+		if(mapped) {
+			glBindBuffer(GL_ARRAY_BUFFER, bufferID);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+		}
+		glDeleteBuffers(1, &bufferID);
+	}
+	bufferID = 0;
+	mapped = 0;
+}
+
+void* CStreamingBuffer::Map() {
+	current = (current+1)%totalRegions;
+
+	//wait for the draw that last read this region
+	GLsync& fence = fences[current];
+	if(fence) {
+		if(glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+			totalStalls++;
+			while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+		}
+		glDeleteSync(fence);
+		fence = 0;
+	}
+
+	if(persistent)
+		return mapped + current*regionSize;
+
+	glBindBuffer(GL_ARRAY_BUFFER, bufferID);
+	return glMapBufferRange(GL_ARRAY_BUFFER, current*regionSize, regionSize,
+							GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+GLintptr CStreamingBuffer::Unmap() {
+	if(!persistent) {
+		glBindBuffer(GL_ARRAY_BUFFER, bufferID);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+	return current*regionSize;
+}
+
+void CStreamingBuffer::Fence() {
+	fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
\ No newline at end of file
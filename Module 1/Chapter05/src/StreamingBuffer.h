@@ -0,0 +1,42 @@
+#pragma once
+#include <GL/glew.h>
+
+//A vertex buffer split into regions that are written by the CPU in turn,
+//one region per frame. With ARB_buffer_storage the buffer is mapped once,
+//persistently and coherently, otherwise each region is mapped unsynchronized
+//when it is written. A fence after the draw of a region keeps the CPU from
+//overwriting it while the GPU may still read it.
+class CStreamingBuffer
+{
+public:
+	CStreamingBuffer(void);
+	~CStreamingBuffer(void);
+
+	//creates totalRegions regions of regionSize bytes each
+	bool Init(const GLsizeiptr regionSize, const int totalRegions = 3);
+	void Destroy();
+
+	//waits until the next region is free and returns a pointer to it
+	void* Map();
+	//finishes writing the region, returns its offset in the buffer
+	GLintptr Unmap();
+	//call after the draw calls reading the region returned by Unmap
+	void Fence();
+
+	GLuint GetBufferID() const { return bufferID; }
+	bool IsPersistent() const { return persistent; }
+	//number of times Map had to wait for the GPU
+	int GetTotalStalls() const { return totalStalls; }
+
+private:
+	static const int MAX_REGIONS = 4;
+
+	GLuint bufferID;
+	GLsizeiptr regionSize;
+	int totalRegions;
+	int current;
+	bool persistent;
+	char* mapped;		//persistent mapping of the whole buffer
+	GLsync fences[MAX_REGIONS];
+	int totalStalls;
+};
\ No newline at end of file
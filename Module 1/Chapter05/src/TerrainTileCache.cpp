@@ -0,0 +1,133 @@
+#include "TerrainTileCache.h"
+#include <algorithm>
+
+CTerrainTileCache::CTerrainTileCache(void)
+{
+	pyramid = 0;
+	textureID = 0;
+	frame = 0;
+	totalLoads = 0;
+}
+
+CTerrainTileCache::~CTerrainTileCache(void)
+{
+}
+
+bool CTerrainTileCache::Init(CHeightmapPyramid* p, const int totalSlots) {
+	pyramid = p;
+	const int size = pyramid->GetTileSize()+1;
+	buffer.resize(size*size);
+
+	Slot empty = {-1, -1, false};
+	slots.assign(totalSlots, empty);
+	resident.clear();
+	pending.clear();
+	frame = 0;
+	totalLoads = 0;
+
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R16, size, size, totalSlots, 0, GL_RED, GL_UNSIGNED_SHORT, 0);
+
+	//the top level is always resident
+	const int top = pyramid->GetTotalLevels()-1;
+	for(int z=0;z<pyramid->GetTilesZ(top);z++) {
+		for(int x=0;x<pyramid->GetTilesX(top);x++) {
+			int slot = FindFreeSlot();
+			if(slot<0 || !Load(Key(top, x, z), slot))
+				return false;
+			slots[slot].pinned = true;
+		}
+	}
+	return true;
+}
+
+void CTerrainTileCache::Destroy() {
+	glDeleteTextures(1, &textureID);
+	textureID = 0;
+	slots.clear();
+	resident.clear();
+	pending.clear();
+}
+
+void CTerrainTileCache::BeginFrame() {
+	frame++;
+	pending.clear();
+}
+
+int CTerrainTileCache::Request(const int level, const int x, const int z) {
+	long long key = Key(level, x, z);
+	std::map<long long, int>::iterator it = resident.find(key);
+	if(it != resident.end()) {
+		slots[it->second].lastUsed = frame;
+		return it->second;
+	}
+	if(std::find(pending.begin(), pending.end(), key) == pending.end())
+		pending.push_back(key);
+	return -1;
+}
+
+int CTerrainTileCache::FindFreeSlot() const {
+	//an empty slot, otherwise the least recently used one not needed this frame
+	int best = -1;
+	for(size_t i=0;i<slots.size();i++) {
+		const Slot& s = slots[i];
+		if(s.key < 0)
+			return int(i);
+		if(s.pinned || s.lastUsed == frame)
+			continue;
+		if(best<0 || s.lastUsed < slots[best].lastUsed)
+			best = int(i);
+	}
+	return best;
+}
+
+bool CTerrainTileCache::Load(const long long key, const int slot) {
+	const int level = int(key>>48);
+	const int z = int((key>>24) & 0xFFFFFF);
+	const int x = int(key & 0xFFFFFF);
+	if(!pyramid->ReadTile(level, x, z, &buffer[0]))
+		return false;
+
+	Slot& s = slots[slot];
+	if(s.key >= 0)
+		resident.erase(s.key);
+	s.key = key;
+	s.lastUsed = frame;
+	s.pinned = false;
+	resident[key] = slot;
+
+	//rows of 16 bit samples are not 4 byte aligned for odd tile sizes
+	const int size = pyramid->GetTileSize()+1;
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, slot, size, size, 1, GL_RED, GL_UNSIGNED_SHORT, &buffer[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	totalLoads++;
+	return true;
+}
+
+//coarse tiles first, the finer tiles cannot be used before their parents
+static bool CoarserFirst(const long long a, const long long b) {
+	return (a>>48) > (b>>48);
+}
+
+int CTerrainTileCache::Update(const int maxLoads) {
+	std::stable_sort(pending.begin(), pending.end(), CoarserFirst);
+	int loads = 0;
+	size_t i = 0;
+	for(;i<pending.size() && loads<maxLoads;i++) {
+		int slot = FindFreeSlot();
+		if(slot<0)
+			break;
+		if(Load(pending[i], slot))
+			loads++;
+	}
+	//what is left is requested again next frame if it is still needed
+	pending.erase(pending.begin(), pending.begin()+i);
+	return loads;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+#include <GL/glew.h>
+#include <map>
+#include <vector>
+#include "HeightmapPyramid.h"
+
+//Keeps a bounded set of heightmap pyramid tiles in the layers of a 2D array
+//texture. Tiles are requested while the terrain is traversed, missing tiles
+//are queued and read from disk in Update with a per frame budget, coarse
+//tiles first. When all layers are in use the least recently used tile is
+//replaced, tiles used in the current frame and the top level tiles are never
+//replaced so there is always something to draw.
+class CTerrainTileCache
+{
+public:
+	CTerrainTileCache(void);
+	~CTerrainTileCache(void);
+
+	//creates the array texture with totalSlots layers and loads the top
+	//level tiles
+	bool Init(CHeightmapPyramid* pyramid, const int totalSlots);
+	void Destroy();
+
+	//starts a new frame, tiles still queued from the previous frame are dropped
+	void BeginFrame();
+
+	//layer holding the tile, or -1 if the tile is not resident yet in which
+	//case it is queued for loading
+	int Request(const int level, const int x, const int z);
+
+	//loads at most maxLoads of the queued tiles, returns the number loaded
+	int Update(const int maxLoads);
+
+	GLuint GetTextureID() const { return textureID; }
+	int GetTotalSlots() const { return int(slots.size()); }
+	int GetTotalResident() const { return int(resident.size()); }
+	int GetTotalPending() const { return int(pending.size()); }
+	int GetTotalLoads() const { return totalLoads; }
+
+private:
+	struct Slot {
+		long long key;	//tile in the slot, -1 if empty
+		int lastUsed;	//frame the tile was last requested in
+		bool pinned;
+	};
+
+	static long long Key(const int level, const int x, const int z) {
+		return ((long long)level<<48) | ((long long)z<<24) | x;
+	}
+	int FindFreeSlot() const;
+	bool Load(const long long key, const int slot);
+
+	CHeightmapPyramid* pyramid;
+	GLuint textureID;
+	std::vector<Slot> slots;
+	std::map<long long, int> resident;	//tile key -> slot
+	std::vector<long long> pending;		//tiles missed this frame
+	std::vector<unsigned short> buffer;
+	int frame;
+	int totalLoads;
+};
\ No newline at end of file
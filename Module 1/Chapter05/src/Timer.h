@@ -0,0 +1,29 @@
+#pragma once
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+
+//High resolution timer on the performance counter, used to measure the CPU
+//time of a step in milliseconds.
+class CTimer
+{
+public:
+	CTimer(void) { QueryPerformanceFrequency(&frequency); Start(); }
+
+	//restarts the timer
+	void Start() { QueryPerformanceCounter(&start); }
+
+	//milliseconds since the last Start
+	float Elapsed() const {
+		LARGE_INTEGER now;
+		QueryPerformanceCounter(&now);
+		return float(double(now.QuadPart-start.QuadPart)*1000.0/double(frequency.QuadPart));
+	}
+
+private:
+	LARGE_INTEGER frequency, start;
+};
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 #include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -53,8 +56,51 @@ GLuint colorBlenderFBOID;
 //colour blend FBO colour attachment texture ID
 GLuint colorBlenderTexID;
 
+//front to back peeling FBO ids
+GLuint frontPeelFBOID[2];
+//front to back peeling colour attachment IDs
+GLuint frontTexID[2];
+//front to back peeling depth attachment IDs
+GLuint frontDepthTexID[2];
+//front to back colour blending FBO ID and its colour attachment
+GLuint frontBlenderFBOID;
+GLuint frontBlenderTexID;
+
+//weighted blended OIT FBO id
+GLuint wboitFBOID;
+//weighted colour sum and revealage texture ID
+GLuint accumTexID;
+//weighted alpha sum texture ID
+GLuint weightTexID;
+
+//A-buffer head pointer image ID and the FBO used to clear it
+GLuint headPointerTexID;
+GLuint headPointerFBOID;
+//A-buffer fragment pool buffer and its buffer texture
+GLuint nodeBufferID;
+GLuint nodeTexID;
+//atomic counters for allocating fragment pool nodes. Every frame uses the
+//next counter of the ring and puts a fence behind it, a counter is read back
+//when its slot comes round again and its fence has passed, so the CPU never
+//waits for the GPU to finish the frame.
+const int COUNTER_FRAMES = 3;
+GLuint nodeCounterID[COUNTER_FRAMES];
+GLsync counterFence[COUNTER_FRAMES];
+int counterFrame = 0;
+//current size of the fragment pool in nodes
+GLuint totalNodes = 0;
+//the pool starts with 4 nodes per pixel and may grow up to 16 nodes per pixel
+const GLuint INITIAL_NODES = WIDTH*HEIGHT*4;
+const GLuint MAX_NODES = WIDTH*HEIGHT*16;
+//number of fragments requested by the last A-buffer frame that was read back
+GLuint lastFragments = 0;
+//flag set when the driver supports image load/store and atomic counters
+bool bHasABuffer = false;
+
 //occlusion query ID
 GLuint queryId;
+//timer query ID for the benchmark
+GLuint timerQueryId;
 
 //fullscreen quad vao and vbos
 GLuint quadVAOID;
@@ -68,6 +114,10 @@ GLuint cubeIndicesID;
 
 //shaders for cube, initialization, dual depth peeling, blending and final rendering
 GLSLShader cubeShader, initShader, dualPeelShader, blendShader, finalShader;
+//shaders for front to back peeling and its final rendering
+GLSLShader frontPeelShader, frontFinalShader;
+//shaders for weighted blended OIT and the A-buffer
+GLSLShader wboitShader, wboitCompositeShader, abufferStoreShader, abufferResolveShader;
 
 //total number of depth peeling passes
 const int NUM_PASSES=4;
@@ -75,8 +125,29 @@ const int NUM_PASSES=4;
 //flag to use occlusion queries
 bool bUseOQ = true;
 
-//flag to use dual depth peeling
-bool bShowDepthPeeling = true;
+//transparency modes
+enum TransparencyMode {
+	MODE_OFF,
+	MODE_FRONT_TO_BACK,
+	MODE_DUAL_PEELING,
+	MODE_WEIGHTED_BLENDED,
+	MODE_ABUFFER,
+	TOTAL_MODES
+};
+const char* modeNames[TOTAL_MODES] = {"Alpha blending", "Front-to-back Depth Peeling", "Dual Depth Peeling",
+									  "Weighted Blended OIT", "A-buffer"};
+
+//current transparency mode
+int mode = MODE_DUAL_PEELING;
+
+//geometry passes of the last rendered frame
+int lastPasses = 0;
+
+//number of cubes along each axis, the scene has about twice as many
+//transparent layers as cubes per axis
+int cubesPerAxis = 3;
+const int MIN_CUBES = 2;
+const int MAX_CUBES = 16;
 
 //blending colour alpha
 float alpha=0.6f;
@@ -97,6 +168,17 @@ GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0,
 						   GL_COLOR_ATTACHMENT6
 };
 
+//(re)allocates the A-buffer fragment pool
+void resizeNodePool(GLuint nodes) {
+	totalNodes = nodes;
+	glBindBuffer(GL_TEXTURE_BUFFER, nodeBufferID);
+	glBufferData(GL_TEXTURE_BUFFER, GLsizeiptr(totalNodes)*4*sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_BUFFER, nodeTexID);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32UI, nodeBufferID);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
 //FBO initialization function
 void initFBO() {
 	//generate dual depth FBO
@@ -171,6 +253,115 @@ void initFBO() {
 	else
 		printf("Problem with FBO setup");
 
+	//setup the front to back peeling FBOs, each with a depth and a colour
+	//attachment
+	glGenFramebuffers(2, frontPeelFBOID);
+	glGenTextures(2, frontTexID);
+	glGenTextures(2, frontDepthTexID);
+	for(int i=0;i<2;i++) {
+		glBindTexture(GL_TEXTURE_RECTANGLE, frontDepthTexID[i]);
+		glTexParameteri(GL_TEXTURE_RECTANGLE , GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_RECTANGLE , GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_RECTANGLE , GL_TEXTURE_WRAP_S, GL_CLAMP);
+		glTexParameteri(GL_TEXTURE_RECTANGLE , GL_TEXTURE_WRAP_T, GL_CLAMP);
+		glTexImage2D(GL_TEXTURE_RECTANGLE , 0, GL_DEPTH_COMPONENT32F, WIDTH, HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+
+		glBindTexture(GL_TEXTURE_RECTANGLE, frontTexID[i]);
+		glTexParameteri(GL_TEXTURE_RECTANGLE , GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_RECTANGLE , GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_RECTANGLE , GL_TEXTURE_WRAP_S, GL_CLAMP);
+		glTexParameteri(GL_TEXTURE_RECTANGLE , GL_TEXTURE_WRAP_T, GL_CLAMP);
+		glTexImage2D(GL_TEXTURE_RECTANGLE , 0, GL_RGBA, WIDTH, HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, frontPeelFBOID[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_TEXTURE_RECTANGLE, frontDepthTexID[i], 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_RECTANGLE, frontTexID[i], 0);
+	}
+
+	//the front to back blender shares the depth attachment of the first FBO
+	glGenTextures(1, &frontBlenderTexID);
+	glBindTexture(GL_TEXTURE_RECTANGLE, frontBlenderTexID);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, WIDTH, HEIGHT, 0, GL_RGBA, GL_FLOAT, 0);
+
+	glGenFramebuffers(1, &frontBlenderFBOID);
+	glBindFramebuffer(GL_FRAMEBUFFER, frontBlenderFBOID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_RECTANGLE, frontDepthTexID[0], 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_RECTANGLE, frontBlenderTexID, 0);
+
+	status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if(status != GL_FRAMEBUFFER_COMPLETE )
+		printf("Problem with front to back peeling FBO setup");
+
+	GL_CHECK_ERRORS
+
+	//setup the weighted blended OIT FBO. The first attachment keeps the
+	//weighted colour sum in RGB and the revealage in alpha, the second the
+	//weighted alpha sum. Half floats are enough for both.
+	glGenTextures(1, &accumTexID);
+	glBindTexture(GL_TEXTURE_RECTANGLE, accumTexID);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA16F, WIDTH, HEIGHT, 0, GL_RGBA, GL_FLOAT, 0);
+
+	glGenTextures(1, &weightTexID);
+	glBindTexture(GL_TEXTURE_RECTANGLE, weightTexID);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_R16F, WIDTH, HEIGHT, 0, GL_RED, GL_FLOAT, 0);
+
+	glGenFramebuffers(1, &wboitFBOID);
+	glBindFramebuffer(GL_FRAMEBUFFER, wboitFBOID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_RECTANGLE, accumTexID, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_RECTANGLE, weightTexID, 0);
+
+	status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if(status != GL_FRAMEBUFFER_COMPLETE )
+		printf("Problem with weighted blended OIT FBO setup");
+
+	GL_CHECK_ERRORS
+
+	//the A-buffer needs image load/store and atomic counters (OpenGL 4.2)
+	if(bHasABuffer) {
+		//per pixel head pointers, cleared through an FBO
+		glGenTextures(1, &headPointerTexID);
+		glBindTexture(GL_TEXTURE_2D, headPointerTexID);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, WIDTH, HEIGHT, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+
+		glGenFramebuffers(1, &headPointerFBOID);
+		glBindFramebuffer(GL_FRAMEBUFFER, headPointerFBOID);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, headPointerTexID, 0);
+
+		status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		if(status != GL_FRAMEBUFFER_COMPLETE )
+			printf("Problem with A-buffer FBO setup");
+
+		//fragment pool with 16 bytes per node
+		glGenBuffers(1, &nodeBufferID);
+		glGenTextures(1, &nodeTexID);
+		resizeNodePool(INITIAL_NODES);
+
+		//node allocation counters
+		glGenBuffers(COUNTER_FRAMES, nodeCounterID);
+		for(int i=0;i<COUNTER_FRAMES;i++) {
+			glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, nodeCounterID[i]);
+			glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+			counterFence[i] = 0;
+		}
+		glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+
+		GL_CHECK_ERRORS
+	}
+
 	//unbind FBO
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
@@ -183,6 +374,44 @@ void shutdownFBO() {
 	glDeleteTextures (2, backTexID);
 	glDeleteTextures (2, depthTexID);
 	glDeleteTextures(1, &colorBlenderTexID);
+
+	glDeleteFramebuffers(2, frontPeelFBOID);
+	glDeleteFramebuffers(1, &frontBlenderFBOID);
+	glDeleteTextures(2, frontTexID);
+	glDeleteTextures(2, frontDepthTexID);
+	glDeleteTextures(1, &frontBlenderTexID);
+
+	glDeleteFramebuffers(1, &wboitFBOID);
+	glDeleteTextures(1, &accumTexID);
+	glDeleteTextures(1, &weightTexID);
+
+	if(bHasABuffer) {
+		glDeleteFramebuffers(1, &headPointerFBOID);
+		glDeleteTextures(1, &headPointerTexID);
+		glDeleteTextures(1, &nodeTexID);
+		glDeleteBuffers(1, &nodeBufferID);
+		glDeleteBuffers(COUNTER_FRAMES, nodeCounterID);
+		for(int i=0;i<COUNTER_FRAMES;i++) {
+			if(counterFence[i])
+				glDeleteSync(counterFence[i]);
+		}
+	}
+}
+
+//GPU memory in bytes used by the render targets and buffers of a mode
+size_t getModeMemory(int m) {
+	const size_t pixels = size_t(WIDTH)*HEIGHT;
+	switch(m) {
+		//two depth and two colour attachments and the blender
+		case MODE_FRONT_TO_BACK:	return pixels*(2*4 + 2*4 + 4);
+		//two RG32F depth, four RGBA8 colour attachments and the blender
+		case MODE_DUAL_PEELING:		return pixels*(2*8 + 4*4 + 4);
+		//RGBA16F accumulation and R16F weight
+		case MODE_WEIGHTED_BLENDED:	return pixels*(8 + 2);
+		//head pointers, the fragment pool and the counters
+		case MODE_ABUFFER:			return pixels*4 + size_t(totalNodes)*16 + 4*COUNTER_FRAMES;
+	}
+	return 0;
 }
 
 //mouse down event handler
@@ -221,11 +450,17 @@ void OnInit() {
 
 	GL_CHECK_ERRORS
 
+	//the A-buffer mode needs image load/store and atomic counters
+	bHasABuffer = GLEW_VERSION_4_2 || (GLEW_ARB_shader_image_load_store && GLEW_ARB_shader_atomic_counters);
+	if(!bHasABuffer)
+		cout<<"Image load/store is not supported, the A-buffer mode is disabled"<<endl;
+
 	//initialize FBO
 	initFBO();
 
-	//generate hardwre query
+	//generate hardwre queries
 	glGenQueries(1, &queryId);
+	glGenQueries(1, &timerQueryId);
 
 	//create a uniform grid of size 20x20 in XZ plane
 	grid = new CGrid(20,20);
@@ -388,6 +623,95 @@ void OnInit() {
 
 	GL_CHECK_ERRORS
 
+	//Load the front to back peeling shader
+	frontPeelShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/dual_peel.vert");
+	frontPeelShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/front_peel.frag");
+	//compile and link the shader
+	frontPeelShader.CreateAndLinkProgram();
+	frontPeelShader.Use();
+		//add attributes and uniforms
+		frontPeelShader.AddAttribute("vVertex");
+		frontPeelShader.AddUniform("MVP");
+		frontPeelShader.AddUniform("vColor");
+		frontPeelShader.AddUniform("alpha");
+		frontPeelShader.AddUniform("depthTexture");
+		//pass constant uniforms at initialization
+		glUniform1i(frontPeelShader("depthTexture"), 0);
+	frontPeelShader.UnUse();
+
+	//Load the front to back peeling final shader
+	frontFinalShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/blend.vert");
+	frontFinalShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/front_final.frag");
+	//compile and link the shader
+	frontFinalShader.CreateAndLinkProgram();
+	frontFinalShader.Use();
+		//add attributes and uniforms
+		frontFinalShader.AddAttribute("vVertex");
+		frontFinalShader.AddUniform("colorTexture");
+		frontFinalShader.AddUniform("vBackgroundColor");
+		//pass constant uniforms at initialization
+		glUniform1i(frontFinalShader("colorTexture"), 0);
+	frontFinalShader.UnUse();
+
+	GL_CHECK_ERRORS
+
+	//Load the weighted blended OIT accumulation shader
+	wboitShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/dual_peel.vert");
+	wboitShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/wboit_accum.frag");
+	//compile and link the shader
+	wboitShader.CreateAndLinkProgram();
+	wboitShader.Use();
+		//add attributes and uniforms
+		wboitShader.AddAttribute("vVertex");
+		wboitShader.AddUniform("MVP");
+		wboitShader.AddUniform("vColor");
+		wboitShader.AddUniform("alpha");
+	wboitShader.UnUse();
+
+	//Load the weighted blended OIT composite shader
+	wboitCompositeShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/blend.vert");
+	wboitCompositeShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/wboit_composite.frag");
+	//compile and link the shader
+	wboitCompositeShader.CreateAndLinkProgram();
+	wboitCompositeShader.Use();
+		//add attributes and uniforms
+		wboitCompositeShader.AddAttribute("vVertex");
+		wboitCompositeShader.AddUniform("accumTexture");
+		wboitCompositeShader.AddUniform("weightTexture");
+		//pass constant uniforms at initialization
+		glUniform1i(wboitCompositeShader("accumTexture"), 0);
+		glUniform1i(wboitCompositeShader("weightTexture"), 1);
+	wboitCompositeShader.UnUse();
+
+	GL_CHECK_ERRORS
+
+	if(bHasABuffer) {
+		//Load the A-buffer store shader
+		abufferStoreShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/dual_peel.vert");
+		abufferStoreShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/abuffer_store.frag");
+		//compile and link the shader
+		abufferStoreShader.CreateAndLinkProgram();
+		abufferStoreShader.Use();
+			//add attributes and uniforms
+			abufferStoreShader.AddAttribute("vVertex");
+			abufferStoreShader.AddUniform("MVP");
+			abufferStoreShader.AddUniform("vColor");
+			abufferStoreShader.AddUniform("alpha");
+			abufferStoreShader.AddUniform("maxNodes");
+		abufferStoreShader.UnUse();
+
+		//Load the A-buffer resolve shader
+		abufferResolveShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/blend.vert");
+		abufferResolveShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/abuffer_resolve.frag");
+		//compile and link the shader
+		abufferResolveShader.CreateAndLinkProgram();
+		abufferResolveShader.Use();
+			abufferResolveShader.AddAttribute("vVertex");
+		abufferResolveShader.UnUse();
+
+		GL_CHECK_ERRORS
+	}
+
 	cout<<"Initialization successfull"<<endl;
 }
 
@@ -398,9 +722,18 @@ void OnShutdown() {
 	dualPeelShader.DeleteShaderProgram();
 	blendShader.DeleteShaderProgram();
 	finalShader.DeleteShaderProgram();
+	frontPeelShader.DeleteShaderProgram();
+	frontFinalShader.DeleteShaderProgram();
+	wboitShader.DeleteShaderProgram();
+	wboitCompositeShader.DeleteShaderProgram();
+	if(bHasABuffer) {
+		abufferStoreShader.DeleteShaderProgram();
+		abufferResolveShader.DeleteShaderProgram();
+	}
 
 	shutdownFBO();
 	glDeleteQueries(1, &queryId);
+	glDeleteQueries(1, &timerQueryId);
 
 	glDeleteVertexArrays(1, &quadVAOID);
 	glDeleteBuffers(1, &quadVBOID);
@@ -432,11 +765,13 @@ void OnIdle() {
 }
 
 //function to render scene given the combined modelview projection matrix 
-//and a shader
-void DrawScene(const glm::mat4& MVP, GLSLShader& shader, bool useColor=false, bool useAlphaMultiplier=false) {
+//and a shader. If setBlending is false the caller's blend state is kept.
+void DrawScene(const glm::mat4& MVP, GLSLShader& shader, bool useColor=false, bool useAlphaMultiplier=false, bool setBlending=true) {
 	//enable alpha blending with over compositing
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	if(setBlending) {
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	}
 
 	//bind the cube vertex array object
 	glBindVertexArray(cubeVAOID);
@@ -444,16 +779,20 @@ void DrawScene(const glm::mat4& MVP, GLSLShader& shader, bool useColor=false, bo
 	//bind the shader
 	shader.Use();
 
+	//the cubes fill the same [-2,2] volume for any count, so the number
+	//of overlapping layers grows while the covered area stays the same
+	float spacing = 4.0f/(cubesPerAxis-1);
+
 	//for all cubes
-	for(int k=-1;k<=1;k++) {
-		for(int j=-1;j<=1;j++) {
-			int index =0;
-			for(int i=-1;i<=1;i++) {
+	for(int k=0;k<cubesPerAxis;k++) {
+		for(int j=0;j<cubesPerAxis;j++) {
+			for(int i=0;i<cubesPerAxis;i++) {
 				GL_CHECK_ERRORS
 				//set the modelling transformation and shader uniforms
-				glm::mat4 T = glm::translate(glm::mat4(1), glm::vec3(i*2,j*2,k*2));
+				glm::mat4 T = glm::translate(glm::mat4(1), glm::vec3(i,j,k)*spacing-2.0f);
+				T = glm::scale(T, glm::vec3(spacing/2));
 				if(useColor)
-					glUniform4fv(shader("vColor"),1, &(box_colors[index++].x));
+					glUniform4fv(shader("vColor"),1, &(box_colors[i%3].x));
 				if(useAlphaMultiplier)
 					glUniform1f(shader("alpha"), alpha);
 
@@ -470,7 +809,8 @@ void DrawScene(const glm::mat4& MVP, GLSLShader& shader, bool useColor=false, bo
 	//unbind vertex array object
 	glBindVertexArray(0);
 	//diable alpha blending
-	glDisable(GL_BLEND);
+	if(setBlending)
+		glDisable(GL_BLEND);
 }
 
 //function to draw a fullscreen quad
@@ -481,164 +821,411 @@ void DrawFullScreenQuad() {
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
 }
 
-//display callback function
-void OnRender() {
-	GL_CHECK_ERRORS
+//front to back depth peeling, returns the number of geometry passes
+int RenderFrontToBackPeeling(const glm::mat4& MVP) {
+	//bind the colour blending FBO
+	glBindFramebuffer(GL_FRAMEBUFFER, frontBlenderFBOID);
+	//set the first colour attachment as the draw buffer
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	//clear the colour and depth buffer
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+
+	//the first pass peels against a depth of 0 which keeps every fragment,
+	//so with depth testing it gets the nearest surface
+	glBindFramebuffer(GL_FRAMEBUFFER, frontPeelFBOID[1]);
+	glClearDepth(0);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glClearDepth(1);
+
+	// 1. In the first pass, we render normally with depth test enabled to get the nearest surface
+	glBindFramebuffer(GL_FRAMEBUFFER, frontBlenderFBOID);
+	glEnable(GL_DEPTH_TEST);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_RECTANGLE, frontDepthTexID[1]);
+	DrawScene(MVP, frontPeelShader, true, true);
+
+	// 2. Depth peeling + blending pass
+	int numLayers = (NUM_PASSES - 1) * 2;
+	int passes = 1;
+
+	//for each pass
+	for (int layer = 1; bUseOQ || layer < numLayers; layer++, passes++) {
+		int currId = layer % 2;
+		int prevId = 1 - currId;
+
+		//bind the current FBO
+		glBindFramebuffer(GL_FRAMEBUFFER, frontPeelFBOID[currId]);
+		//set the first colour attachment as draw buffer
+		glDrawBuffer(GL_COLOR_ATTACHMENT0);
+
+		//set clear colour to black
+		glClearColor(0, 0, 0, 0);
+		//clear the colour and depth buffers
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	//camera transformation
-	glm::mat4 Tr	= glm::translate(glm::mat4(1.0f),glm::vec3(0.0f, 0.0f, dist));
-	glm::mat4 Rx	= glm::rotate(Tr,  rX, glm::vec3(1.0f, 0.0f, 0.0f));
-	glm::mat4 MV    = glm::rotate(Rx, rY, glm::vec3(0.0f, 1.0f, 0.0f));
+		//disbale blending and depth testing
+		glDisable(GL_BLEND);
+		glEnable(GL_DEPTH_TEST);
 
-	//clear colour and depth buffer
-	glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+		//if we want to use occlusion query, we initiate it
+		if (bUseOQ) {
+			glBeginQuery(GL_SAMPLES_PASSED_ARB, queryId);
+		}
 
-	//get the combined modelview projection matrix
-    glm::mat4 MVP	= P*MV;
-	
-	//if we want to use depth peeling 
-	if(bShowDepthPeeling) {
-		
-		//disble depth test and enable alpha blending
+		//bind the depth texture from the previous step
+		glBindTexture(GL_TEXTURE_RECTANGLE, frontDepthTexID[prevId]);
+
+		//render scene with the front to back peeling shader
+		DrawScene(MVP, frontPeelShader, true, true);
+
+		//if we initiated the occlusion query, we end it 
+		if (bUseOQ) {
+			glEndQuery(GL_SAMPLES_PASSED_ARB);
+		}
+
+		//bind the colour blender FBO
+		glBindFramebuffer(GL_FRAMEBUFFER, frontBlenderFBOID);
+		//render to its first colour attachment 
+		glDrawBuffer(GL_COLOR_ATTACHMENT0);
+
+		//enable blending but disable depth testing
 		glDisable(GL_DEPTH_TEST);
 		glEnable(GL_BLEND);
 
-		//bind dual depth FBO
-		glBindFramebuffer(GL_FRAMEBUFFER, dualDepthFBOID);
+		//use under blending
+		glBlendEquation(GL_FUNC_ADD);
+		glBlendFuncSeparate(GL_DST_ALPHA, GL_ONE,
+							GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+
+		//bind the result from the previous iteration as texture
+		glBindTexture(GL_TEXTURE_RECTANGLE, frontTexID[currId]);
+		//bind the blend shader and then draw a fullscreen quad
+		blendShader.Use();
+			DrawFullScreenQuad();
+		blendShader.UnUse();
+
+		//disable blending
+		glDisable(GL_BLEND);
+
+		//if we initiated the occlusion query, we get the query result
+		//that is the total number of samples
+		if (bUseOQ) {
+			GLuint sample_count;
+			glGetQueryObjectuiv(queryId, GL_QUERY_RESULT, &sample_count);
+			if (sample_count == 0) {
+				break;
+			}
+		}
+	}
+
+	GL_CHECK_ERRORS
+
+	// 3. Final render pass
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDrawBuffer(GL_BACK_LEFT);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	//bind the colour blender texture and draw a fullscreen quad
+	glBindTexture(GL_TEXTURE_RECTANGLE, frontBlenderTexID);
+	frontFinalShader.Use();
+		glUniform4fv(frontFinalShader("vBackgroundColor"), 1, &bg.x);
+		DrawFullScreenQuad();
+	frontFinalShader.UnUse();
+
+	return passes;
+}
+
+//dual depth peeling, returns the number of geometry passes
+int RenderDualDepthPeeling(const glm::mat4& MVP) {
+	//disble depth test and enable alpha blending
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+
+	//bind dual depth FBO
+	glBindFramebuffer(GL_FRAMEBUFFER, dualDepthFBOID);
+
+	// Render targets 1 and 2 store the front and back colors
+	// Clear to 0.0 and use MAX blending to filter written color
+	// At most one front color and one back color can be written every pass
+	glDrawBuffers(2, &drawBuffers[1]);
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT);
 
-		// Render targets 1 and 2 store the front and back colors
-		// Clear to 0.0 and use MAX blending to filter written color
-		// At most one front color and one back color can be written every pass
-		glDrawBuffers(2, &drawBuffers[1]);
+	GL_CHECK_ERRORS
+
+	// Render target 0 stores (-minDepth, maxDepth)
+	glDrawBuffer(drawBuffers[0]);
+	//clear the offscreen texture with -MAX_DEPTH
+	glClearColor(-MAX_DEPTH, -MAX_DEPTH, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT);
+	//enable max blending
+	glBlendEquation(GL_MAX);
+	//render scene with the initialization shader
+	DrawScene(MVP, initShader);
+
+	// 2. Depth peeling + blending pass
+	glDrawBuffer(drawBuffers[6]);
+	//clear color buffer with the background colour
+	glClearColor(bg.x, bg.y, bg.z, 0);
+	glClear(GL_COLOR_BUFFER_BIT);
+	 
+	int currId = 0;
+	int passes = 1;
+	//for each pass
+	for (int layer = 1; bUseOQ || layer < NUM_PASSES; layer++, passes++) {
+		currId = layer % 2;
+		int prevId = 1 - currId;
+		int bufId = currId * 3;
+
+		//render to 2 colour attachments simultaneously
+		glDrawBuffers(2, &drawBuffers[bufId+1]);
+		//set clear color to black and clear colour buffer
 		glClearColor(0, 0, 0, 0);
 		glClear(GL_COLOR_BUFFER_BIT);
 
-		GL_CHECK_ERRORS
-
-		// Render target 0 stores (-minDepth, maxDepth)
-		glDrawBuffer(drawBuffers[0]);
-		//clear the offscreen texture with -MAX_DEPTH
+		//alternate the colour attachment for draw buffer
+		glDrawBuffer(drawBuffers[bufId+0]);
+		//clear the color to -MAX_DEPTH and clear colour buffer
 		glClearColor(-MAX_DEPTH, -MAX_DEPTH, 0, 0);
 		glClear(GL_COLOR_BUFFER_BIT);
+
+		//Render to three draw buffers simultaneously
+		// Render target 0: RG32F MAX blending
+		// Render target 1: RGBA MAX blending
+		// Render target 2: RGBA MAX blending
+		glDrawBuffers(3, &drawBuffers[bufId+0]);	
 		//enable max blending
 		glBlendEquation(GL_MAX);
-		//render scene with the initialization shader
-		DrawScene(MVP, initShader);
 
-		// 2. Depth peeling + blending pass
+		//bind depth texture to texture unit 0
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_RECTANGLE, depthTexID[prevId]);
+
+		//bind colour attachment texture to texture unit 1
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_RECTANGLE, texID[prevId]);
+		
+		//draw scene using the dual peel shader 
+		DrawScene(MVP, dualPeelShader, true,true);
+
+		// Full screen pass to alpha-blend the back color
 		glDrawBuffer(drawBuffers[6]);
-		//clear color buffer with the background colour
-		glClearColor(bg.x, bg.y, bg.z, 0);
-		glClear(GL_COLOR_BUFFER_BIT);
+
+		//set the over blending 
+		glBlendEquation(GL_FUNC_ADD);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		 
-		int currId = 0;
-		//for each pass
-		for (int layer = 1; bUseOQ || layer < NUM_PASSES; layer++) {
-			currId = layer % 2;
-			int prevId = 1 - currId;
-			int bufId = currId * 3;
-
-			//render to 2 colour attachments simultaneously
-			glDrawBuffers(2, &drawBuffers[bufId+1]);
-			//set clear color to black and clear colour buffer
-			glClearColor(0, 0, 0, 0);
-			glClear(GL_COLOR_BUFFER_BIT);
-
-			//alternate the colour attachment for draw buffer
-			glDrawBuffer(drawBuffers[bufId+0]);
-			//clear the color to -MAX_DEPTH and clear colour buffer
-			glClearColor(-MAX_DEPTH, -MAX_DEPTH, 0, 0);
-			glClear(GL_COLOR_BUFFER_BIT);
-
-			//Render to three draw buffers simultaneously
-			// Render target 0: RG32F MAX blending
-			// Render target 1: RGBA MAX blending
-			// Render target 2: RGBA MAX blending
-			glDrawBuffers(3, &drawBuffers[bufId+0]);	
-			//enable max blending
-			glBlendEquation(GL_MAX);
-
-			//bind depth texture to texture unit 0
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_RECTANGLE, depthTexID[prevId]);
-
-			//bind colour attachment texture to texture unit 1
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_RECTANGLE, texID[prevId]);
-			
-			//draw scene using the dual peel shader 
-			DrawScene(MVP, dualPeelShader, true,true);
-
-			// Full screen pass to alpha-blend the back color
-			glDrawBuffer(drawBuffers[6]);
-
-			//set the over blending 
-			glBlendEquation(GL_FUNC_ADD);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			 
-			//if we want to use occlusion query, we initiate it
-			if (bUseOQ) {
-				glBeginQuery(GL_SAMPLES_PASSED_ARB, queryId);
+		//if we want to use occlusion query, we initiate it
+		if (bUseOQ) {
+			glBeginQuery(GL_SAMPLES_PASSED_ARB, queryId);
+		}
+
+		GL_CHECK_ERRORS
+
+		//bind the back colour attachment to texture unit 0
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_RECTANGLE, backTexID[currId]);
+
+		//use blending shader and draw a fullscreen quad
+		blendShader.Use();
+			 DrawFullScreenQuad();
+		blendShader.UnUse();
+
+		//if we initiated the occlusion query, we end it and get
+		//the query result which is the total number of samples
+		//output from the blending result
+		if (bUseOQ) {
+			glEndQuery(GL_SAMPLES_PASSED);
+			GLuint sample_count;
+			glGetQueryObjectuiv(queryId, GL_QUERY_RESULT, &sample_count);
+			if (sample_count == 0) {
+				break;
 			}
+		}
+		GL_CHECK_ERRORS
+	}
+
+	GL_CHECK_ERRORS
+
+	//disable alpha blending
+	glDisable(GL_BLEND);
+
+	// 3. Final render pass
+	//remove the FBO 
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	//restore the default back buffer
+	glDrawBuffer(GL_BACK_LEFT);
+	 
+	//bind the depth texture to texture unit 0
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_RECTANGLE, depthTexID[currId]);
+
+	//bind the depth texture to colour texture to texture unit 1
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_RECTANGLE, texID[currId]);
+	
+	//bind the colour blender texture to texture unit 2
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_RECTANGLE, colorBlenderTexID);
+
+	//bind the final shader and draw a fullscreen quad
+	finalShader.Use();
+		DrawFullScreenQuad();
+	finalShader.UnUse();
+
+	return passes;
+}
+
+//weighted blended order independent transparency in one geometry pass
+int RenderWeightedBlended(const glm::mat4& MVP) {
+	//clear the colour sum to 0, the revealage to 1 and the weight sum to 0
+	glBindFramebuffer(GL_FRAMEBUFFER, wboitFBOID);
+	glDrawBuffers(2, drawBuffers);
+	GLfloat accumClear[4] = {0, 0, 0, 1};
+	GLfloat weightClear[4] = {0, 0, 0, 0};
+	glClearBufferfv(GL_COLOR, 0, accumClear);
+	glClearBufferfv(GL_COLOR, 1, weightClear);
+
+	//accumulate all fragments without depth testing. Both targets use the
+	//same blend function, additive on colour and multiplicative on alpha.
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendEquation(GL_FUNC_ADD);
+	glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+	DrawScene(MVP, wboitShader, true, true, false);
+
+	GL_CHECK_ERRORS
 
-			GL_CHECK_ERRORS
-
-			//bind the back colour attachment to texture unit 0
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_RECTANGLE, backTexID[currId]);
-
-			//use blending shader and draw a fullscreen quad
-			blendShader.Use();
-				 DrawFullScreenQuad();
-			blendShader.UnUse();
-
-			//if we initiated the occlusion query, we end it and get
-			//the query result which is the total number of samples
-			//output from the blending result
-			if (bUseOQ) {
-				glEndQuery(GL_SAMPLES_PASSED);
-				GLuint sample_count;
-				glGetQueryObjectuiv(queryId, GL_QUERY_RESULT, &sample_count);
-				if (sample_count == 0) {
-					break;
-				}
+	//composite the premultiplied average over the background
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDrawBuffer(GL_BACK_LEFT);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_RECTANGLE, accumTexID);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_RECTANGLE, weightTexID);
+	wboitCompositeShader.Use();
+		DrawFullScreenQuad();
+	wboitCompositeShader.UnUse();
+	glActiveTexture(GL_TEXTURE0);
+
+	glDisable(GL_BLEND);
+
+	return 1;
+}
+
+//per pixel linked list A-buffer. All fragments are stored in one geometry
+//pass and sorted per pixel in the resolve pass.
+int RenderABuffer(const glm::mat4& MVP) {
+	//the counter of this slot was used COUNTER_FRAMES frames ago. If that frame
+	//has finished, read how many fragments it requested. If the pool was too
+	//small the extra fragments were dropped, so grow it before this frame.
+	const int slot = counterFrame;
+	counterFrame = (counterFrame+1)%COUNTER_FRAMES;
+	if(counterFence[slot]) {
+		GLenum result = glClientWaitSync(counterFence[slot], 0, 0);
+		if(result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+			glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, nodeCounterID[slot]);
+			glGetBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &lastFragments);
+			if(lastFragments >= totalNodes && totalNodes < MAX_NODES) {
+				GLuint nodes = totalNodes;
+				while(nodes <= lastFragments && nodes < MAX_NODES)
+					nodes = min(nodes*2, MAX_NODES);
+				resizeNodePool(nodes);
+				cout<<"A-buffer pool grown to "<<totalNodes<<" nodes"<<endl;
 			}
-			GL_CHECK_ERRORS
 		}
+		glDeleteSync(counterFence[slot]);
+		counterFence[slot] = 0;
+	}
 
-		GL_CHECK_ERRORS
+	//clear the head pointers to the end of list
+	glBindFramebuffer(GL_FRAMEBUFFER, headPointerFBOID);
+	GLuint headClear[4] = {0, 0, 0, 0};
+	glClearBufferuiv(GL_COLOR, 0, headClear);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-		//disable alpha blending
-		glDisable(GL_BLEND);
+	//reset the node counter
+	GLuint zero = 0;
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, nodeCounterID[slot]);
+	glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &zero);
+	glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, nodeCounterID[slot]);
 
-		// 3. Final render pass
-		//remove the FBO 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		//restore the default back buffer
-		glDrawBuffer(GL_BACK_LEFT);
-		 
-		//bind the depth texture to texture unit 0
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_RECTANGLE, depthTexID[currId]);
+	glBindImageTexture(0, headPointerTexID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+	glBindImageTexture(1, nodeTexID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32UI);
 
-		//bind the depth texture to colour texture to texture unit 1
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_RECTANGLE, texID[currId]);
-		
-		//bind the colour blender texture to texture unit 2
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_RECTANGLE, colorBlenderTexID);
+	//store the fragments, nothing is written to the framebuffer
+	glDisable(GL_DEPTH_TEST);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	abufferStoreShader.Use();
+		glUniform1i(abufferStoreShader("maxNodes"), totalNodes);
+	abufferStoreShader.UnUse();
+	DrawScene(MVP, abufferStoreShader, true, true, false);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
-		//bind the final shader and draw a fullscreen quad
-		finalShader.Use();
-			DrawFullScreenQuad();
-		finalShader.UnUse();
+	//make the stored lists visible to the resolve pass
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
-	} else {
-		//no depth peeling, render scene with default alpha blending
-		glEnable(GL_DEPTH_TEST);
-		DrawScene(MVP, cubeShader, true,false);
+	//sort and composite the lists over the background
+	glEnable(GL_BLEND);
+	glBlendEquation(GL_FUNC_ADD);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	abufferResolveShader.Use();
+		DrawFullScreenQuad();
+	abufferResolveShader.UnUse();
+	glDisable(GL_BLEND);
+
+	GL_CHECK_ERRORS
+
+	//the counter is read back once this fence has passed, the barrier makes
+	//the shader increments visible to the read back
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	counterFence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+
+	return 1;
+}
+
+//renders the transparent cubes with the current mode, returns the number
+//of geometry passes
+int RenderTransparent(const glm::mat4& MVP) {
+	switch(mode) {
+		case MODE_FRONT_TO_BACK:	return RenderFrontToBackPeeling(MVP);
+		case MODE_DUAL_PEELING:		return RenderDualDepthPeeling(MVP);
+		case MODE_WEIGHTED_BLENDED:	return RenderWeightedBlended(MVP);
+		case MODE_ABUFFER:			return RenderABuffer(MVP);
 	}
+	//no order independent transparency, render scene with default alpha blending
+	glEnable(GL_DEPTH_TEST);
+	DrawScene(MVP, cubeShader, true,false);
+	return 1;
+}
+
+//returns the combined modelview projection matrix of the camera
+glm::mat4 GetMVP() {
+	//camera transformation
+	glm::mat4 Tr	= glm::translate(glm::mat4(1.0f),glm::vec3(0.0f, 0.0f, dist));
+	glm::mat4 Rx	= glm::rotate(Tr,  rX, glm::vec3(1.0f, 0.0f, 0.0f));
+	glm::mat4 MV    = glm::rotate(Rx, rY, glm::vec3(0.0f, 1.0f, 0.0f));
+	return P*MV;
+}
+
+//display callback function
+void OnRender() {
+	GL_CHECK_ERRORS
+
+	//clear colour and depth buffer
+	glClearColor(bg.x, bg.y, bg.z, bg.w);
+	glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+
+	//get the combined modelview projection matrix
+	glm::mat4 MVP	= GetMVP();
+	
+	//render the transparent cubes
+	lastPasses = RenderTransparent(MVP);
 
 	//render grid
 	grid->Render(glm::value_ptr(MVP));
@@ -647,17 +1234,86 @@ void OnRender() {
 	glutSwapBuffers();
 }
 
-//Keyboard event handler to toggle the dual depth peeling usage
+//shows the mode and the scene size in the window title
+void UpdateTitle() {
+	std::stringstream title;
+	title<<modeNames[mode]<<" - "<<cubesPerAxis*cubesPerAxis*cubesPerAxis<<" cubes, up to "
+		 <<cubesPerAxis*2<<" layers, "<<getModeMemory(mode)/(1024*1024)<<" MB";
+	glutSetWindowTitle(title.str().c_str());
+}
+
+//renders every order independent mode at a growing number of layers and
+//prints the GPU time, the geometry passes and the memory of each
+void RunBenchmark() {
+	const int sizes[] = {2, 3, 4, 6, 8, 10, 12, 16};
+	const int TOTAL_SIZES = sizeof(sizes)/sizeof(sizes[0]);
+	const int WARMUP_FRAMES = 3;
+	const int TIMED_FRAMES = 10;
+
+	int oldMode = mode;
+	int oldCubes = cubesPerAxis;
+	glm::mat4 MVP = GetMVP();
+
+	cout<<endl<<"Transparency benchmark ("<<WIDTH<<"x"<<HEIGHT<<")"<<endl;
+	cout<<setw(8)<<"layers"<<setw(30)<<"mode"<<setw(12)<<"GPU ms"<<setw(10)<<"passes"<<setw(12)<<"memory MB"<<endl;
+
+	for(int s=0;s<TOTAL_SIZES;s++) {
+		cubesPerAxis = sizes[s];
+		for(mode=MODE_FRONT_TO_BACK; mode<TOTAL_MODES; mode++) {
+			if(mode==MODE_ABUFFER && !bHasABuffer)
+				continue;
+
+			double totalTime = 0;
+			for(int frame=0; frame<WARMUP_FRAMES+TIMED_FRAMES; frame++) {
+				glClearColor(bg.x, bg.y, bg.z, bg.w);
+				glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+
+				//time only the transparent cubes on the GPU
+				glBeginQuery(GL_TIME_ELAPSED, timerQueryId);
+				lastPasses = RenderTransparent(MVP);
+				glEndQuery(GL_TIME_ELAPSED);
+
+				GLuint64 elapsed = 0;
+				glGetQueryObjectui64v(timerQueryId, GL_QUERY_RESULT, &elapsed);
+				if(frame>=WARMUP_FRAMES)
+					totalTime += elapsed/1000000.0;
+			}
+
+			cout<<setw(8)<<cubesPerAxis*2<<setw(30)<<modeNames[mode]
+				<<setw(12)<<fixed<<setprecision(3)<<totalTime/TIMED_FRAMES
+				<<setw(10)<<lastPasses
+				<<setw(12)<<setprecision(1)<<getModeMemory(mode)/(1024.0*1024.0);
+			if(mode==MODE_ABUFFER && lastFragments>=totalNodes)
+				cout<<"  pool overflow, "<<lastFragments<<" fragments";
+			cout<<endl;
+		}
+	}
+
+	mode = oldMode;
+	cubesPerAxis = oldCubes;
+}
+
+//Keyboard event handler to switch the transparency mode and scene size
 void OnKey(unsigned char key, int x, int y) {
 	switch(key) {
+		//cycle through the modes, skipping the A-buffer if unsupported
 		case ' ':
-		bShowDepthPeeling = !bShowDepthPeeling;
+			mode = (mode+1)%TOTAL_MODES;
+			if(mode==MODE_ABUFFER && !bHasABuffer)
+				mode = MODE_OFF;
+			break;
+		//more or fewer cubes along each axis
+		case '+':
+			cubesPerAxis = min(cubesPerAxis+1, MAX_CUBES);
+			break;
+		case '-':
+			cubesPerAxis = max(cubesPerAxis-1, MIN_CUBES);
+			break;
+		case 'b':
+			RunBenchmark();
 			break;
 	}
-	if(bShowDepthPeeling)
-		glutSetWindowTitle("Dual Depth Peeling: On");
-	else
-		glutSetWindowTitle("Dual Depth Peeling: Off");
+	UpdateTitle();
 	glutPostRedisplay();
 }
 
@@ -695,6 +1351,7 @@ int main(int argc, char** argv) {
 
 	//OpenGL initialization
 	OnInit();
+	UpdateTitle();
 
 	//callback hooks
 	glutCloseFunc(OnShutdown);
@@ -0,0 +1,50 @@
+#version 420 core
+
+layout(location = 0) out vec4 vFragColor; //fragment shader output
+
+//number of fragments sorted per pixel, farther ones are dropped
+#define MAX_FRAGMENTS 32
+
+layout(binding = 0, r32ui) uniform readonly uimage2D headPointers;
+layout(binding = 1, rgba32ui) uniform readonly uimageBuffer nodes;
+
+void main()
+{
+	uint index = imageLoad(headPointers, ivec2(gl_FragCoord.xy)).r;
+
+	//no transparent fragment covers this pixel
+	if(index == 0u)
+		discard;
+
+	//walk the list and insertion sort the fragments by depth into a local
+	//array, keeping the nearest MAX_FRAGMENTS of them. Each entry is the
+	//packed colour and the depth bits.
+	uvec2 fragments[MAX_FRAGMENTS];
+	int count = 0;
+	while(index != 0u) {
+		uvec4 node = imageLoad(nodes, int(index));
+		float depth = uintBitsToFloat(node.z);
+		if(count < MAX_FRAGMENTS || depth < uintBitsToFloat(fragments[MAX_FRAGMENTS-1].y)) {
+			int j = min(count, MAX_FRAGMENTS-1);
+			while(j > 0 && uintBitsToFloat(fragments[j-1].y) > depth) {
+				fragments[j] = fragments[j-1];
+				j--;
+			}
+			fragments[j] = node.yz;
+			count = min(count+1, MAX_FRAGMENTS);
+		}
+		index = node.x;
+	}
+
+	//composite front to back with under blending
+	vec3 color = vec3(0);
+	float transmittance = 1.0;
+	for(int i = 0; i < count; i++) {
+		vec4 c = unpackUnorm4x8(fragments[i].x);
+		color += transmittance * c.a * c.rgb;
+		transmittance *= 1.0 - c.a;
+	}
+
+	//premultiplied result, blended over the background
+	vFragColor = vec4(color, 1.0 - transmittance);
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#version 420 core
+
+//uniforms
+uniform vec4 vColor;	//solid colour of the cube
+uniform float alpha;	//fragment alpha
+uniform int maxNodes;	//size of the fragment pool
+
+//node 0 is the end of a list, so the counter is offset by one
+layout(binding = 0, offset = 0) uniform atomic_uint nodeCounter;
+//index of the last node stored for each pixel
+layout(binding = 0, r32ui) uniform coherent uimage2D headPointers;
+//fragment pool, each node is (next, colour, depth, unused)
+layout(binding = 1, rgba32ui) uniform writeonly uimageBuffer nodes;
+
+void main()
+{
+	uint index = atomicCounterIncrement(nodeCounter) + 1u;
+
+	//the pool is bounded, fragments past its end are dropped. The counter
+	//keeps counting so the application can see how many were requested.
+	if(index >= uint(maxNodes))
+		return;
+
+	//push the fragment at the front of the pixel's list
+	uint next = imageAtomicExchange(headPointers, ivec2(gl_FragCoord.xy), index);
+	imageStore(nodes, int(index), uvec4(next, packUnorm4x8(vec4(vColor.rgb, alpha)), floatBitsToUint(gl_FragCoord.z), 0u));
+}
\ No newline at end of file
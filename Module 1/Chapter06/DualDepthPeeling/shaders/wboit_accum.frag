@@ -0,0 +1,23 @@
+#version 330 core
+
+layout(location = 0) out vec4 vFragAccum;		//premultiplied colour sum and revealage
+layout(location = 1) out vec4 vFragWeight;		//sum of the weighted alphas
+
+//uniforms
+uniform vec4 vColor;	//solid colour of the cube
+uniform float alpha;	//fragment alpha
+
+void main()
+{
+	//depth weight of McGuire and Bavoil's weighted blended OIT. Nearer
+	//fragments get a larger weight so that they dominate the average colour.
+	float z = 1.0 - gl_FragCoord.z;
+	float w = alpha * clamp(3e3 * z * z * z, 1e-2, 3e3);
+
+	//both targets share one blend function: ONE, ONE on colour sums the
+	//weighted premultiplied colours and ZERO, ONE_MINUS_SRC_ALPHA on alpha
+	//multiplies up the revealage (the product of all 1-alpha). The weight
+	//target is single channel so only its summed red channel is kept.
+	vFragAccum = vec4(vColor.rgb * alpha * w, alpha);
+	vFragWeight = vec4(alpha * w);
+}
\ No newline at end of file
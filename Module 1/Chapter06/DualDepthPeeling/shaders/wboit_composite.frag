@@ -0,0 +1,22 @@
+#version 330 core
+
+layout(location = 0) out vec4 vFragColor; //fragment shader output
+
+//uniforms
+uniform sampler2DRect accumTexture;		//weighted colour sum and revealage
+uniform sampler2DRect weightTexture;	//weighted alpha sum
+
+void main()
+{
+	vec4 accum = texture(accumTexture, gl_FragCoord.xy);
+	float revealage = accum.a;
+
+	//nothing transparent covers this pixel
+	if(revealage == 1.0)
+		discard;
+
+	//weighted average colour, premultiplied by the total coverage
+	float weight = texture(weightTexture, gl_FragCoord.xy).r;
+	vec3 average = accum.rgb / max(weight, 1e-5);
+	vFragColor = vec4(average * (1.0 - revealage), 1.0 - revealage);
+}
\ No newline at end of file
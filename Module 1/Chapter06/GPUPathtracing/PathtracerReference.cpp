@@ -0,0 +1,376 @@
+#include "PathtracerReference.h"
+#include <algorithm>
+#include <cmath>
+
+//constants shared with pathtracer.frag
+const float LIGHT_RADIUS = 1.0f;
+const float EPSILON = 0.001f;
+const float FAR = 1e10f;
+const float PI = 3.14159265358979f;
+
+struct CPathtracerReference::Job {
+	const CPathtracerReference* reference;
+	const View* view;
+	int step, totalSamples, outWidth;
+	glm::vec3* image;
+};
+
+//integer hash used to seed every pixel
+static inline unsigned int Hash(unsigned int x) {
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+static inline unsigned int HashCombine(unsigned int seed, unsigned int v) {
+	return seed ^ (v + (seed << 6) + (seed >> 2));
+}
+
+static inline unsigned int ReverseBits(unsigned int x) {
+	x = ((x & 0xaaaaaaaau) >> 1) | ((x & 0x55555555u) << 1);
+	x = ((x & 0xccccccccu) >> 2) | ((x & 0x33333333u) << 2);
+	x = ((x & 0xf0f0f0f0u) >> 4) | ((x & 0x0f0f0f0fu) << 4);
+	x = ((x & 0xff00ff00u) >> 8) | ((x & 0x00ff00ffu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+//hash based Owen scrambling of the bits of x
+static inline unsigned int NestedUniformScramble(unsigned int x, unsigned int seed) {
+	x = ReverseBits(x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return ReverseBits(x);
+}
+
+//second dimension of the Sobol sequence, the first one is ReverseBits
+static inline unsigned int Sobol1(unsigned int index) {
+	unsigned int v = 1u << 31;
+	unsigned int result = 0u;
+	for(; index != 0u; index >>= 1, v ^= v >> 1) {
+		if(index & 1u)
+			result ^= v;
+	}
+	return result;
+}
+
+//returns a vec2 with the t values of the near and far intersection
+static glm::vec2 IntersectCube(const glm::vec3& origin, const glm::vec3& ray, const BBox& cube) {
+	glm::vec3 tMin = (cube.min - origin) / ray;
+	glm::vec3 tMax = (cube.max - origin) / ray;
+	glm::vec3 t1 = glm::min(tMin, tMax);
+	glm::vec3 t2 = glm::max(tMin, tMax);
+	float tNear = std::max(std::max(t1.x, t1.y), t1.z);
+	float tFar  = std::min(std::min(t2.x, t2.y), t2.z);
+	return glm::vec2(tNear, tFar);
+}
+
+static void MakeBasis(const glm::vec3& N, glm::vec3& T, glm::vec3& B) {
+	T = glm::normalize(std::fabs(N.x) > 0.5f ? glm::cross(N, glm::vec3(0,1,0)) : glm::cross(N, glm::vec3(1,0,0)));
+	B = glm::cross(N, T);
+}
+
+static glm::vec3 CosineSampleHemisphere(const glm::vec3& N, const glm::vec2& u) {
+	glm::vec3 T, B;
+	MakeBasis(N, T, B);
+	float r = std::sqrt(u.x);
+	float angle = 2.0f * PI * u.y;
+	return glm::normalize(T * (r * std::cos(angle)) + B * (r * std::sin(angle)) + N * std::sqrt(std::max(0.0f, 1.0f - u.x)));
+}
+
+static float LightCone(const glm::vec3& light, const glm::vec3& p) {
+	glm::vec3 toLight = light - p;
+	float sin2 = LIGHT_RADIUS * LIGHT_RADIUS / glm::dot(toLight, toLight);
+	if(sin2 >= 1.0f)
+		return 0.0f;
+	return sin2 / (1.0f + std::sqrt(1.0f - sin2));
+}
+
+static bool SampleLight(const glm::vec3& light, const glm::vec3& p, const glm::vec2& u, glm::vec3& dir, float& dist, float& pdf) {
+	float cone = LightCone(light, p);
+	if(cone <= 0.0f)
+		return false;
+	glm::vec3 toLight = light - p;
+	float d = glm::length(toLight);
+	glm::vec3 W = toLight / d;
+	glm::vec3 T, B;
+	MakeBasis(W, T, B);
+	float cosTheta = 1.0f - u.x * cone;
+	float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+	float angle = 2.0f * PI * u.y;
+	dir = T * (sinTheta * std::cos(angle)) + B * (sinTheta * std::sin(angle)) + W * cosTheta;
+	float b = d * cosTheta;
+	dist = b - std::sqrt(std::max(0.0f, LIGHT_RADIUS * LIGHT_RADIUS - (d * d - b * b)));
+	pdf = 1.0f / (2.0f * PI * cone);
+	return true;
+}
+
+static float IntersectLight(const glm::vec3& light, const glm::vec3& origin, const glm::vec3& dir) {
+	glm::vec3 oc = origin - light;
+	float b = glm::dot(oc, dir);
+	float c = glm::dot(oc, oc) - LIGHT_RADIUS * LIGHT_RADIUS;
+	float h = b * b - c;
+	if(h < 0.0f)
+		return FAR;
+	float t = -b - std::sqrt(h);
+	return (t > 0.0f) ? t : FAR;
+}
+
+CPathtracerReference::CPathtracerReference(void)
+{
+	aabb.min = aabb.max = glm::vec3(0);
+}
+
+CPathtracerReference::~CPathtracerReference(void)
+{
+	pool.Destroy();
+}
+
+float CPathtracerReference::Halton(int index, int base) {
+	float result = 0;
+	float f = 1.0f/base;
+	for(int i=index;i>0;i/=base, f/=base)
+		result += f*(i%base);
+	return result;
+}
+
+unsigned int CPathtracerReference::PixelSeed(int x, int y) {
+	return Hash(unsigned(x) + Hash(unsigned(y)));
+}
+
+glm::vec2 CPathtracerReference::Sample2D(unsigned int pixelSeed, unsigned int sampleIndex, int dimension) {
+	unsigned int seed  = HashCombine(pixelSeed, unsigned(dimension));
+	unsigned int index = NestedUniformScramble(sampleIndex, HashCombine(seed, 0u));
+	unsigned int x = NestedUniformScramble(ReverseBits(index), HashCombine(seed, 1u));
+	unsigned int y = NestedUniformScramble(Sobol1(index), HashCombine(seed, 2u));
+	return glm::vec2(float(x >> 8), float(y >> 8)) / 16777216.0f;
+}
+
+void CPathtracerReference::SetScene(const std::vector<glm::vec3>& p, const std::vector<unsigned short>& t, const BBox& box) {
+	positions = p;
+	triangles = t;
+	aabb = box;
+}
+
+void CPathtracerReference::SetTexture(const int layer, const unsigned char* pixels, const int width, const int height, const int channels) {
+	if(layer >= int(textures.size()))
+		textures.resize(layer+1);
+	Texture& tex = textures[layer];
+	tex.width = width;
+	tex.height = height;
+	tex.channels = channels;
+	tex.pixels.assign(pixels, pixels + size_t(width)*height*channels);
+}
+
+glm::vec3 CPathtracerReference::SampleTexture(const glm::vec3& uvw) const {
+	if(uvw.z == 255)
+		return glm::vec3(1);
+	int layer = std::min(std::max(int(std::floor(uvw.z + 0.5f)), 0), int(textures.size())-1);
+	if(layer < 0 || textures[layer].pixels.empty())
+		return glm::vec3(0);
+	//bilinear filtering with clamped edges
+	const Texture& tex = textures[layer];
+	float x = uvw.x * tex.width - 0.5f;
+	float y = uvw.y * tex.height - 0.5f;
+	int x0 = int(std::floor(x)), y0 = int(std::floor(y));
+	float fx = x - x0, fy = y - y0;
+	glm::vec3 result(0);
+	for(int j=0;j<2;j++) {
+		for(int i=0;i<2;i++) {
+			int px = std::min(std::max(x0+i, 0), tex.width-1);
+			int py = std::min(std::max(y0+j, 0), tex.height-1);
+			const unsigned char* c = &tex.pixels[(size_t(py)*tex.width + px)*tex.channels];
+			float w = (i ? fx : 1-fx) * (j ? fy : 1-fy);
+			result += w * glm::vec3(c[0], c[std::min(1, tex.channels-1)], c[std::min(2, tex.channels-1)]) / 255.0f;
+		}
+	}
+	return result;
+}
+
+glm::vec4 CPathtracerReference::IntersectTriangle(const glm::vec3& origin, const glm::vec3& dir, int index, glm::vec3& normal) const {
+	const unsigned short* t = &triangles[4*index];
+	int list[4] = {t[0], t[1], t[2], t[3]};
+	if((index+1) % 2 != 0) {
+		int x = list[0], y = list[1], z = list[2];
+		list[0] = z;
+		list[1] = x;
+		list[2] = y;
+	}
+	const glm::vec3& v0 = positions[list[2]];
+	const glm::vec3& v1 = positions[list[1]];
+	const glm::vec3& v2 = positions[list[0]];
+
+	glm::vec3 e1 = v1-v0;
+	glm::vec3 e2 = v2-v0;
+	glm::vec3 tvec = origin - v0;
+	glm::vec3 pvec = glm::cross(dir, e2);
+	float det = glm::dot(e1, pvec);
+	float inv_det = 1.0f/det;
+
+	float u = glm::dot(tvec, pvec) * inv_det;
+	if(u < 0.0f || u > 1.0f)
+		return glm::vec4(-1,0,0,0);
+
+	glm::vec3 qvec = glm::cross(tvec, e1);
+	float v = glm::dot(dir, qvec) * inv_det;
+	if(v < 0.0f || (u + v) > 1.0f)
+		return glm::vec4(-1,0,0,0);
+
+	float tHit = glm::dot(e2, qvec) * inv_det;
+	if((index+1) % 2 == 0)
+		v = 1-v;
+	else
+		u = 1-u;
+
+	normal = glm::normalize(glm::cross(e2, e1));
+	return glm::vec4(tHit, u, v, float(list[3]));
+}
+
+glm::vec4 CPathtracerReference::TraceScene(const glm::vec3& origin, const glm::vec3& dir, const float tMax, glm::vec3& N) const {
+	glm::vec4 val(tMax, 0, 0, 0);
+	N = glm::vec3(0,1,0);
+	glm::vec2 tNearFar = IntersectCube(origin, dir, aabb);
+	if(tNearFar.x > tNearFar.y || tNearFar.y < 0.0f)
+		return val;
+	const int total = int(triangles.size()/4);
+	for(int i=0;i<total;i++) {
+		glm::vec3 normal;
+		glm::vec4 res = IntersectTriangle(origin, dir, i, normal);
+		if(res.x > EPSILON && res.x < val.x) {
+			val = res;
+			N = normal;
+		}
+	}
+	return val;
+}
+
+bool CPathtracerReference::Occluded(const glm::vec3& origin, const glm::vec3& dir, const float tMax) const {
+	glm::vec2 tNearFar = IntersectCube(origin, dir, aabb);
+	if(tNearFar.x > tNearFar.y || tNearFar.y < 0.0f)
+		return false;
+	const int total = int(triangles.size()/4);
+	glm::vec3 normal;
+	for(int i=0;i<total;i++) {
+		glm::vec4 res = IntersectTriangle(origin, dir, i, normal);
+		if(res.x > EPSILON && res.x < tMax)
+			return true;
+	}
+	return false;
+}
+
+glm::vec3 CPathtracerReference::Pathtrace(const View& view, unsigned int seed, unsigned int sampleIndex, glm::vec3 origin, glm::vec3 ray) const {
+	glm::vec3 radiance(0.0f);
+	glm::vec3 throughput(1.0f);
+	float bsdfPdf = 0.0f;
+	glm::vec3 Le(view.lightIntensity / (PI * LIGHT_RADIUS * LIGHT_RADIUS));
+	ray = glm::normalize(ray);
+
+	for(int bounce = 0; bounce < MAX_BOUNCES; bounce++) {
+		glm::vec3 N;
+		float tLight = IntersectLight(view.light, origin, ray);
+		glm::vec4 val = TraceScene(origin, ray, tLight, N);
+
+		//the path reached the light
+		if(tLight < FAR && val.x >= tLight) {
+			float weight = 1.0f;
+			if(bounce > 0) {
+				float pdf = 1.0f / (2.0f * PI * LightCone(view.light, origin));
+				weight = bsdfPdf * bsdfPdf / (bsdfPdf * bsdfPdf + pdf * pdf);
+			}
+			radiance += throughput * Le * weight;
+			break;
+		}
+
+		//the path left the scene, only eye rays see the background
+		if(val.x >= FAR) {
+			if(bounce == 0)
+				radiance = glm::vec3(view.background);
+			break;
+		}
+
+		glm::vec3 albedo = SampleTexture(glm::vec3(val.y, val.z, val.w));
+		glm::vec3 hit = origin + ray * val.x;
+		if(glm::dot(N, ray) > 0.0f)
+			N = -N;
+		origin = hit + N * EPSILON;
+
+		//next event estimation with a shadow ray to a point on the light
+		glm::vec3 L;
+		float dist, pdf;
+		if(SampleLight(view.light, origin, Sample2D(seed, sampleIndex, 3*bounce), L, dist, pdf)) {
+			float cosL = glm::dot(N, L);
+			if(cosL > 0.0f && !Occluded(origin, L, dist)) {
+				float pdfB = cosL / PI;
+				float weight = pdf * pdf / (pdf * pdf + pdfB * pdfB);
+				radiance += throughput * albedo / PI * Le * cosL / pdf * weight;
+			}
+		}
+
+		ray = CosineSampleHemisphere(N, Sample2D(seed, sampleIndex, 3*bounce+1));
+		bsdfPdf = std::max(glm::dot(N, ray), 0.0f) / PI;
+		throughput *= albedo;
+
+		if(bounce >= RR_START) {
+			float survive = std::min(std::max(std::max(throughput.x, std::max(throughput.y, throughput.z)), 0.05f), 0.95f);
+			if(Sample2D(seed, sampleIndex, 3*bounce+2).x >= survive)
+				break;
+			throughput /= survive;
+		}
+	}
+	return radiance;
+}
+
+void CPathtracerReference::RenderRows(int task, void* data) {
+	Job& job = *(Job*)data;
+	const View& view = *job.view;
+	const CPathtracerReference& ref = *job.reference;
+
+	glm::vec3 U = glm::vec3(view.invMVP[0]);
+	glm::vec3 V = glm::vec3(view.invMVP[1]);
+	glm::vec3 W = glm::vec3(view.invMVP[2]);
+
+	int y = task*job.step;
+	for(int i=0;i<job.outWidth;i++) {
+		int x = i*job.step;
+		unsigned int seed = PixelSeed(x, y);
+		glm::vec2 uv((x+0.5f)/view.width*2.0f-1.0f, (y+0.5f)/view.height*2.0f-1.0f);
+		glm::vec3 sum(0);
+		for(int s=0;s<job.totalSamples;s++) {
+			//same subpixel jitter and eye ray as the progressive GPU frames
+			glm::vec2 p = uv + glm::vec2((Halton(s+1, 2)-0.5f)*2.0f/view.width, (Halton(s+1, 3)-0.5f)*2.0f/view.height);
+			glm::vec3 dir = glm::normalize(p.x*U + p.y*V + W);
+			dir += U*p.x;
+			dir += V*p.y;
+			glm::vec2 tNearFar = IntersectCube(view.eyePos, dir, ref.aabb);
+			if(tNearFar.x < tNearFar.y)
+				sum += ref.Pathtrace(view, seed, unsigned(s), view.eyePos, dir);
+			else
+				sum += glm::vec3(view.background);
+		}
+		job.image[task*job.outWidth+i] = sum/float(std::max(job.totalSamples, 1));
+	}
+}
+
+void CPathtracerReference::Render(const View& view, const int step, const int totalSamples, std::vector<glm::vec3>& image) {
+	if(pool.GetTotalThreads()==1)
+		pool.Init();
+	int outWidth  = view.width/step;
+	int outHeight = view.height/step;
+	image.assign(size_t(outWidth)*outHeight, glm::vec3(0));
+	if(image.empty() || triangles.empty())
+		return;
+
+	Job job;
+	job.reference = this;
+	job.view = &view;
+	job.step = step;
+	job.totalSamples = totalSamples;
+	job.outWidth = outWidth;
+	job.image = &image[0];
+	pool.Run(outHeight, RenderRows, &job);
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "..\src\ThreadPool.h"
+#include "Obj.h"
+
+//CPU version of pathtracer.frag used to verify the shader. It intersects the
+//same triangles, draws the same scrambled Sobol samples and evaluates the same
+//estimator (light sampling, cosine weighted bounces, multiple importance
+//sampling and Russian roulette), so for an equal number of samples its
+//pixels match the accumulated GPU pixels up to floating point differences.
+class CPathtracerReference
+{
+public:
+	//constants shared with pathtracer.frag
+	static const int MAX_BOUNCES = 8;
+	static const int RR_START = 2;
+	static const int TILE_SIZE = 16;
+
+	//an RGB(A) layer of the texture array, rows bottom up as uploaded
+	struct Texture {
+		int width, height, channels;
+		std::vector<unsigned char> pixels;
+	};
+
+	//camera and light of one frame, as passed to the shader
+	struct View {
+		glm::mat4 invMVP;
+		glm::vec3 eyePos;
+		glm::vec3 light;
+		glm::vec4 background;
+		float lightIntensity;
+		int width, height;
+	};
+
+	CPathtracerReference(void);
+	~CPathtracerReference(void);
+
+	//positions and the triangle list with 4 entries per triangle, three
+	//vertex indices and the texture layer (255 for untextured)
+	void SetScene(const std::vector<glm::vec3>& positions, const std::vector<unsigned short>& triangles, const BBox& aabb);
+	void SetTexture(const int layer, const unsigned char* pixels, const int width, const int height, const int channels);
+
+	//renders every step-th pixel of the frame in both directions with the
+	//samples [0, totalSamples). The image has (width/step)*(height/step)
+	//pixels, pixel (i,j) is the frame pixel (i*step, j*step).
+	void Render(const View& view, const int step, const int totalSamples, std::vector<glm::vec3>& image);
+
+	//radical inverse in the given base, also used for the GPU subpixel jitter
+	static float Halton(int index, int base);
+
+	//per pixel seed and the 2D sample of a dimension pair
+	static unsigned int PixelSeed(int x, int y);
+	static glm::vec2 Sample2D(unsigned int pixelSeed, unsigned int sampleIndex, int dimension);
+
+private:
+	struct Job;
+	static void RenderRows(int task, void* data);
+
+	glm::vec3 Pathtrace(const View& view, unsigned int seed, unsigned int sampleIndex, glm::vec3 origin, glm::vec3 ray) const;
+	glm::vec4 TraceScene(const glm::vec3& origin, const glm::vec3& dir, const float tMax, glm::vec3& N) const;
+	bool Occluded(const glm::vec3& origin, const glm::vec3& dir, const float tMax) const;
+	glm::vec4 IntersectTriangle(const glm::vec3& origin, const glm::vec3& dir, int index, glm::vec3& normal) const;
+	glm::vec3 SampleTexture(const glm::vec3& uvw) const;
+
+	std::vector<glm::vec3> positions;
+	std::vector<unsigned short> triangles;
+	std::vector<Texture> textures;
+	BBox aabb;
+	CThreadPool pool;
+};
\ No newline at end of file
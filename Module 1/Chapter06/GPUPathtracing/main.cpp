@@ -9,7 +9,10 @@
 
 #include "..\src\GLSLShader.h"
 #include <vector>
+#include <sstream>
+#include <iomanip>
 #include "Obj.h"
+#include "PathtracerReference.h"
 
 #include <SOIL.h>
 
@@ -27,6 +30,8 @@ const int HEIGHT = 960;
 //shaders for use in the recipe
 //mesh rendering shader, pathtracing shader and flat shader
 GLSLShader shader, pathtraceShader, flatShader;
+//progressive mode shaders, tile statistics and display of the averaged samples
+GLSLShader tileStatsShader, resolveShader;
 
 //IDs for vertex array and buffer object
 GLuint vaoID;
@@ -86,6 +91,50 @@ float lastTime =0;
 //texture ID for array texture
 GLuint textureID;
 
+//progressive mode: every frame adds one sample per pixel to a float
+//accumulation target while the camera and light stay still
+bool bProgressive = true;
+
+//accumulation FBO with the colour sums (alpha counts the samples) and the
+//luminance moments used to estimate the variance of every pixel
+GLuint accumFBOID;
+GLuint accumTexID;
+GLuint momentsTexID;
+int rtWidth = 0, rtHeight = 0;
+
+//per tile relative error, least samples and average samples
+const int TILE_SIZE = 16;
+GLuint tileFBOID;
+GLuint tileTexID;
+int tilesX = 0, tilesY = 0;
+vector<glm::vec4> tileStats;
+
+//adaptive sampling stops the tiles whose relative error is below the
+//threshold once all their pixels have MIN_SAMPLES samples
+bool bAdaptive = true;
+float errorThreshold = 0.02f;
+const float MIN_SAMPLES = 16;
+
+//progress of the accumulation
+int frameIndex = 0;
+float averageSamples = 0;
+float averageError = 1;
+int activeTiles = 0;
+
+//camera and light of the accumulated samples, any change restarts it
+glm::mat4 accumMV;
+glm::vec3 accumLight;
+bool bResetAccumulation = true;
+
+//radiant intensity of the spherical light, a white surface facing the light
+//from the initial light distance reflects a radiance of 1
+const float LIGHT_INTENSITY = 3.14159265f*70*70;
+
+//CPU version of the path tracer, it renders every REFERENCE_STEP-th pixel
+//to check the accumulated GPU samples
+CPathtracerReference reference;
+const int REFERENCE_STEP = 8;
+
 //mouse clock handler
 void OnMouseDown(int button, int s, int x, int y)
 {
@@ -128,6 +177,89 @@ void OnMouseMove(int x, int y)
 	glutPostRedisplay();
 }
 
+//release the accumulation and tile FBOs
+void ShutdownFBO() {
+	glDeleteTextures(1, &accumTexID);
+	glDeleteTextures(1, &momentsTexID);
+	glDeleteTextures(1, &tileTexID);
+	glDeleteFramebuffers(1, &accumFBOID);
+	glDeleteFramebuffers(1, &tileFBOID);
+	accumTexID = momentsTexID = tileTexID = 0;
+	accumFBOID = tileFBOID = 0;
+}
+
+//creates the accumulation FBO at the window size and the tile FBO with one
+//texel per tile
+void InitFBO(int w, int h) {
+	ShutdownFBO();
+	rtWidth  = w;
+	rtHeight = h;
+	tilesX = (w+TILE_SIZE-1)/TILE_SIZE;
+	tilesY = (h+TILE_SIZE-1)/TILE_SIZE;
+	tileStats.resize(tilesX*tilesY);
+
+	glGenFramebuffers(1, &accumFBOID);
+	glBindFramebuffer(GL_FRAMEBUFFER, accumFBOID);
+
+	//bind the colour sums to texture unit 4 and the moments to unit 5
+	GLuint* ids[2] = {&accumTexID, &momentsTexID};
+	for(int i=0;i<2;i++) {
+		glGenTextures(1, ids[i]);
+		glActiveTexture(GL_TEXTURE4+i);
+		glBindTexture(GL_TEXTURE_2D, *ids[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, w, h, 0, GL_RGBA, GL_FLOAT, NULL);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0+i, GL_TEXTURE_2D, *ids[i], 0);
+	}
+	GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+	glDrawBuffers(2, drawBuffers);
+
+	//check FBO completeness status
+	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		cerr<<"Error in accumulation FBO setup."<<endl;
+
+	//tile statistics bound to texture unit 3
+	glGenFramebuffers(1, &tileFBOID);
+	glBindFramebuffer(GL_FRAMEBUFFER, tileFBOID);
+	glGenTextures(1, &tileTexID);
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_2D, tileTexID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, tilesX, tilesY, 0, GL_RGBA, GL_FLOAT, NULL);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tileTexID, 0);
+
+	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		cerr<<"Error in tile FBO setup."<<endl;
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	bResetAccumulation = true;
+}
+
+//clears the accumulated samples and marks every tile as unconverged
+void ResetAccumulation() {
+	glBindFramebuffer(GL_FRAMEBUFFER, accumFBOID);
+	glClearColor(0,0,0,0);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glBindFramebuffer(GL_FRAMEBUFFER, tileFBOID);
+	glClearColor(1,0,0,0);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glClearColor(bg.x, bg.y, bg.z, bg.w);
+
+	frameIndex = 0;
+	averageSamples = 0;
+	averageError = 1;
+	activeTiles = tilesX*tilesY;
+	bResetAccumulation = false;
+}
+
 //OpenGL initialization function
 void OnInit() {
 	//setup fullscreen quad geometry
@@ -173,6 +305,9 @@ void OnInit() {
 
 	GL_CHECK_ERRORS
 
+	//the CPU reference intersects the same triangles as the shader
+	reference.SetScene(vertices2, indices2, aabb);
+
 	int total =0;
 	//check the total number of non empty textures since we will use this
 	//information to creare a single array texture to store all textures 
@@ -238,6 +373,9 @@ void OnInit() {
 			//modify the existing texture
 			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0,0,0,k, texture_width, texture_height, 1, format, GL_UNSIGNED_BYTE, pData);
 
+			//keep a copy for the CPU reference
+			reference.SetTexture(k, pData, texture_width, texture_height, channels);
+
 			//release the SOIL image data
 			SOIL_free_image_data(pData);
 		}
@@ -271,9 +409,15 @@ void OnInit() {
 		pathtraceShader.AddUniform("aabb.max");
 		pathtraceShader.AddUniform("vertex_positions");
 		pathtraceShader.AddUniform("triangles_list");
-		pathtraceShader.AddUniform("time");
+		pathtraceShader.AddUniform("sampleIndex");
+		pathtraceShader.AddUniform("lightIntensity");
 		pathtraceShader.AddUniform("VERTEX_TEXTURE_SIZE");
 		pathtraceShader.AddUniform("TRIANGLE_TEXTURE_SIZE");
+		pathtraceShader.AddUniform("jitter");
+		pathtraceShader.AddUniform("tileStats");
+		pathtraceShader.AddUniform("useAdaptive");
+		pathtraceShader.AddUniform("errorThreshold");
+		pathtraceShader.AddUniform("minSamples");
 
 		//set values of constant uniforms as initialization	
 		glUniform1f(pathtraceShader("VERTEX_TEXTURE_SIZE"), (float)vertices2.size());		
@@ -283,10 +427,41 @@ void OnInit() {
 		glUniform4fv(pathtraceShader("backgroundColor"),1, glm::value_ptr(bg));
 		glUniform1i(pathtraceShader("vertex_positions"), 1);
 		glUniform1i(pathtraceShader("triangles_list"), 2);
+		glUniform1i(pathtraceShader("tileStats"), 3);
+		glUniform1f(pathtraceShader("minSamples"), MIN_SAMPLES);
+		glUniform1f(pathtraceShader("lightIntensity"), LIGHT_INTENSITY);
 	pathtraceShader.UnUse();
 	
 	GL_CHECK_ERRORS
 
+	//load tile statistics shader
+	tileStatsShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/pathtracer.vert");
+	tileStatsShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/tilestats.frag");
+	//compile and link shader
+	tileStatsShader.CreateAndLinkProgram();
+	tileStatsShader.Use();
+		//add attribute and uniform
+		tileStatsShader.AddAttribute("vVertex");
+		tileStatsShader.AddUniform("accumulation");
+		tileStatsShader.AddUniform("moments");
+		glUniform1i(tileStatsShader("accumulation"), 4);
+		glUniform1i(tileStatsShader("moments"), 5);
+	tileStatsShader.UnUse();
+
+	//load the shader that shows the averaged samples
+	resolveShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/pathtracer.vert");
+	resolveShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/resolve.frag");
+	//compile and link shader
+	resolveShader.CreateAndLinkProgram();
+	resolveShader.Use();
+		//add attribute and uniform
+		resolveShader.AddAttribute("vVertex");
+		resolveShader.AddUniform("accumulation");
+		glUniform1i(resolveShader("accumulation"), 4);
+	resolveShader.UnUse();
+
+	GL_CHECK_ERRORS
+
 	//load mesh rendering shader
 	shader.LoadFromFile(GL_VERTEX_SHADER, "shaders/shader.vert");
 	shader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/shader.frag");
@@ -480,6 +655,10 @@ void OnShutdown() {
 	shader.DeleteShaderProgram();
 	pathtraceShader.DeleteShaderProgram();
 	flatShader.DeleteShaderProgram();
+	tileStatsShader.DeleteShaderProgram();
+	resolveShader.DeleteShaderProgram();
+
+	ShutdownFBO();
 
 	//Destroy vao and vbo
 	glDeleteBuffers(1, &vboVerticesID);
@@ -494,12 +673,142 @@ void OnShutdown() {
 	cout<<"Shutdown successfull"<<endl;
 }
 
+//renders every REFERENCE_STEP-th pixel on the CPU with the samples the GPU
+//has accumulated so far and prints how far apart the two are
+void VerifyWithReference() {
+	if(!bPathtrace || !bProgressive || frameIndex==0) {
+		cout<<"Verification needs accumulated samples of the progressive path tracer"<<endl;
+		return;
+	}
+
+	//read back the colour sums, alpha holds the samples of every pixel
+	vector<glm::vec4> gpu(rtWidth*rtHeight);
+	glBindFramebuffer(GL_FRAMEBUFFER, accumFBOID);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glReadPixels(0, 0, rtWidth, rtHeight, GL_RGBA, GL_FLOAT, &gpu[0]);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	//camera and light of the accumulated samples
+	glm::mat4 invMV = glm::inverse(accumMV);
+	CPathtracerReference::View view;
+	view.invMVP = glm::inverse(P*accumMV);
+	view.eyePos = glm::vec3(invMV[3][0], invMV[3][1], invMV[3][2]);
+	view.light = accumLight;
+	view.background = bg;
+	view.lightIntensity = LIGHT_INTENSITY;
+	view.width = rtWidth;
+	view.height = rtHeight;
+
+	int start = glutGet(GLUT_ELAPSED_TIME);
+	vector<glm::vec3> cpu;
+	reference.Render(view, REFERENCE_STEP, frameIndex, cpu);
+	float time = float(glutGet(GLUT_ELAPSED_TIME)-start);
+
+	//compare the pixels that took every sample, adaptive sampling may have
+	//stopped the others earlier
+	int outWidth = rtWidth/REFERENCE_STEP;
+	int compared = 0;
+	double sumGPU = 0, sumCPU = 0, sumSquared = 0;
+	for(size_t i=0;i<cpu.size();i++) {
+		int x = int(i%outWidth)*REFERENCE_STEP;
+		int y = int(i/outWidth)*REFERENCE_STEP;
+		const glm::vec4& sum = gpu[y*rtWidth+x];
+		if(int(sum.w+0.5f) != frameIndex)
+			continue;
+		glm::vec3 difference = glm::vec3(sum)/sum.w - cpu[i];
+		sumGPU += (sum.x+sum.y+sum.z)/(3*sum.w);
+		sumCPU += (cpu[i].x+cpu[i].y+cpu[i].z)/3;
+		sumSquared += glm::dot(difference, difference)/3;
+		compared++;
+	}
+	if(compared==0) {
+		cout<<"No pixel has taken all "<<frameIndex<<" samples"<<endl;
+		return;
+	}
+	double rms = sqrt(sumSquared/compared);
+	cout<<"Reference: "<<compared<<" pixels at "<<frameIndex<<" spp in "<<time<<" ms, mean GPU "
+		<<sumGPU/compared<<", mean CPU "<<sumCPU/compared<<", RMS difference "<<rms
+		<<" ("<<100*rms/std::max(sumCPU/compared, 1e-6)<<"%)"<<endl;
+}
+
 //resize event handler
 void OnResize(int w, int h) {
 	//set the viewport
 	glViewport (0, 0, (GLsizei) w, (GLsizei) h);
 	//setup the projection matrix
 	P = glm::perspective(60.0f,(float)w/h, 0.1f,1000.0f);
+	//the accumulation target follows the window size
+	if(w>0 && h>0 && (w!=rtWidth || h!=rtHeight))
+		InitFBO(w, h);
+}
+
+//adds one sample to the unconverged pixels, updates the tile statistics and
+//shows the average. Returns true while there are tiles left to refine.
+bool RenderProgressive(const glm::vec3& eyePos, const glm::mat4& invMVP) {
+	glDisable(GL_DEPTH_TEST);
+
+	if(activeTiles>0) {
+		//add the new sample to the sums with additive blending
+		glBindFramebuffer(GL_FRAMEBUFFER, accumFBOID);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+
+		//a different subpixel position every frame antialiases the image
+		glm::vec2 jitter((CPathtracerReference::Halton(frameIndex+1, 2)-0.5f)*2.0f/rtWidth, (CPathtracerReference::Halton(frameIndex+1, 3)-0.5f)*2.0f/rtHeight);
+
+		pathtraceShader.Use();
+			glUniform3fv(pathtraceShader("eyePos"), 1, glm::value_ptr(eyePos));
+			//the frame index picks the sample of the low discrepancy sequence
+			glUniform1i(pathtraceShader("sampleIndex"), frameIndex);
+			glUniform3fv(pathtraceShader("light_position"),1, &(lightPosOS.x));
+			glUniformMatrix4fv(pathtraceShader("invMVP"), 1, GL_FALSE, glm::value_ptr(invMVP));
+			glUniform2fv(pathtraceShader("jitter"), 1, glm::value_ptr(jitter));
+			glUniform1i(pathtraceShader("useAdaptive"), bAdaptive);
+			glUniform1f(pathtraceShader("errorThreshold"), errorThreshold);
+				DrawFullScreenQuad();
+		pathtraceShader.UnUse();
+		glDisable(GL_BLEND);
+		frameIndex++;
+
+		//reduce every tile to its error and sample counts
+		glBindFramebuffer(GL_FRAMEBUFFER, tileFBOID);
+		glViewport(0, 0, tilesX, tilesY);
+		tileStatsShader.Use();
+			DrawFullScreenQuad();
+		tileStatsShader.UnUse();
+
+		//the tile texture is small, reading it back gives the progress
+		glReadPixels(0, 0, tilesX, tilesY, GL_RGBA, GL_FLOAT, &tileStats[0]);
+		glViewport(0, 0, rtWidth, rtHeight);
+
+		float error = 0, samples = 0;
+		activeTiles = 0;
+		for(size_t i=0;i<tileStats.size();i++) {
+			error += tileStats[i].x;
+			samples += tileStats[i].z;
+			if(!bAdaptive || tileStats[i].y < MIN_SAMPLES || tileStats[i].x >= errorThreshold)
+				activeTiles++;
+		}
+		averageError = error/tileStats.size();
+		averageSamples = samples/tileStats.size();
+	}
+
+	//show the average of the samples
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	resolveShader.Use();
+		DrawFullScreenQuad();
+	resolveShader.UnUse();
+
+	glEnable(GL_DEPTH_TEST);
+
+	//report samples per pixel and the estimated convergence
+	std::stringstream msg;
+	msg<<std::fixed<<"GPU pathtracer - "<<frameIndex<<" frames, "<<std::setprecision(1)<<averageSamples
+	   <<" spp, relative error "<<std::setprecision(4)<<averageError<<", "
+	   <<(100*activeTiles)/(tilesX*tilesY)<<"% tiles active";
+	glutSetWindowTitle(msg.str().c_str());
+
+	return activeTiles>0;
 }
 
 //display callback function
@@ -528,15 +837,25 @@ void OnRender() {
 	glm::vec3 eyePos = glm::vec3(invMV[3][0],invMV[3][1],invMV[3][2]);
 	glm::mat4 invMVP = glm::inverse(P*MV); 
 
-	//if pathtracing is enabled
-	if(bPathtrace) {
+	//restart the accumulation when the camera or the light moved
+	bool bRefining = false;
+	if(bPathtrace && bProgressive) {
+		if(bResetAccumulation || MV!=accumMV || lightPosOS!=accumLight) {
+			accumMV = MV;
+			accumLight = lightPosOS;
+			ResetAccumulation();
+		}
+		bRefining = RenderProgressive(eyePos, invMVP);
+	} else if(bPathtrace) {
 		//set the pathtracing shader 
 		pathtraceShader.Use();
 			//pass shader uniforms
 			glUniform3fv(pathtraceShader("eyePos"), 1, glm::value_ptr(eyePos));
-			glUniform1f(pathtraceShader("time"), current);
+			glUniform1i(pathtraceShader("sampleIndex"), int(current));
 			glUniform3fv(pathtraceShader("light_position"),1, &(lightPosOS.x));
 			glUniformMatrix4fv(pathtraceShader("invMVP"), 1, GL_FALSE, glm::value_ptr(invMVP));
+			glUniform2f(pathtraceShader("jitter"), 0, 0);
+			glUniform1i(pathtraceShader("useAdaptive"), 0);
 				//draw a fullscreen quad
 				DrawFullScreenQuad();
 		//unbind pathtracing shader
@@ -601,6 +920,10 @@ void OnRender() {
 
 	//swap front and back buffers to show the rendered result
 	glutSwapBuffers();
+
+	//keep adding samples until every tile has converged
+	if(bRefining)
+		glutPostRedisplay();
 }
 //mouse wheel callback to move the light source on mouse wheel scroll event
 void OnMouseWheel(int button, int dir, int x, int y) {
@@ -627,6 +950,18 @@ void OnMouseWheel(int button, int dir, int x, int y) {
 void OnKey(unsigned char k, int x, int y) {
 	switch(k) {
 		case ' ':bPathtrace=!bPathtrace; break;
+
+		//toggle progressive accumulation and adaptive sampling
+		case 'p':bProgressive=!bProgressive; bResetAccumulation=true; break;
+		case 'a':bAdaptive=!bAdaptive; activeTiles=tilesX*tilesY; break;
+
+		//change the relative error at which tiles stop sampling, the samples
+		//taken so far are kept
+		case '+':errorThreshold*=0.5f; activeTiles=tilesX*tilesY; break;
+		case '-':errorThreshold*=2.0f; activeTiles=tilesX*tilesY; break;
+
+		//compare the accumulated image with the CPU reference
+		case 'v':VerifyWithReference(); break;
 	}
 	glutPostRedisplay();
 }
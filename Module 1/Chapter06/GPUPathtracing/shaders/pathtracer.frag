@@ -1,6 +1,7 @@
 #version 330 core
 
 layout(location = 0) out vec4 vFragColor; //fragment shader output
+layout(location = 1) out vec4 vFragMoments; //luminance and squared luminance
 
 
 //structs for Ray, Box and Camera objects
@@ -26,10 +27,25 @@ uniform vec3 light_position;			//light position is in object space
 uniform Box aabb;	 					//scene's bounding box 
 uniform float VERTEX_TEXTURE_SIZE; 		//size of the vertex texture
 uniform float TRIANGLE_TEXTURE_SIZE; 	//size of the triangle texture 
-uniform float time;						//current time
+uniform int sampleIndex;				//index of the sample in the sequence
+uniform float lightIntensity;			//radiant intensity of the light
+uniform vec2 jitter;					//subpixel offset of the eye ray
+uniform sampler2D tileStats;			//error and least samples of each tile
+uniform bool useAdaptive;				//skip the tiles that have converged
+uniform float errorThreshold;			//relative error at which a tile is converged
+uniform float minSamples;				//samples every pixel takes before a tile may stop
 
 //shader constants
-const int MAX_BOUNCES = 3;	//the total number of bounces for each ray
+const int MAX_BOUNCES = 8;			//the maximum number of bounces for each ray
+const int RR_START = 2;				//bounce from which paths may be terminated
+const int TILE_SIZE = 16;			//size of the tiles used for adaptive sampling
+const float LIGHT_RADIUS = 1.0;		//radius of the spherical light
+const float EPSILON = 0.001;		//offset of ray origins from the surface
+const float FAR = 1e10;				//distance used for rays that hit nothing
+const float PI = 3.14159265358979;
+
+//per pixel seed of the scrambled sample sequence
+uint pixelSeed;
 
 //function to return the intersection of a ray with a box
 //returns a vec2 in which the x value contains the t value at the near intersection
@@ -115,139 +131,263 @@ vec4 intersectTriangle(vec3 origin, vec3 dir, int index, out vec3 normal ) {
 	return vec4(t,u,v,list_pos.w);
 }
 
-//pseudorandom number generator
-float random(vec3 scale, float seed) {		
-	return fract(sin(dot(gl_FragCoord.xyz + seed, scale)) * 43758.5453 + seed);	
-}	
+//integer hash used to seed every pixel
+uint hash(uint x) {
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
 
-//gives a uniform random direction vector
-vec3 uniformlyRandomDirection(float seed) {		
-	float u = random(vec3(12.9898, 78.233, 151.7182), seed);		
-	float v = random(vec3(63.7264, 10.873, 623.6736), seed);		
-	float z = 1.0 - 2.0 * u;		
-	float r = sqrt(1.0 - z * z);	
-	float angle = 6.283185307179586 * v;	
-	return vec3(r * cos(angle), r * sin(angle), z);	
-}	
+uint hashCombine(uint seed, uint v) {
+	return seed ^ (v + (seed << 6) + (seed >> 2));
+}
+
+uint reverseBits(uint x) {
+	x = ((x & 0xaaaaaaaau) >> 1) | ((x & 0x55555555u) << 1);
+	x = ((x & 0xccccccccu) >> 2) | ((x & 0x33333333u) << 2);
+	x = ((x & 0xf0f0f0f0u) >> 4) | ((x & 0x0f0f0f0fu) << 4);
+	x = ((x & 0xff00ff00u) >> 8) | ((x & 0x00ff00ffu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+//hash based Owen scrambling of the bits of x
+uint nestedUniformScramble(uint x, uint seed) {
+	x = reverseBits(x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return reverseBits(x);
+}
+
+//second dimension of the Sobol sequence, the first one is reverseBits
+uint sobol1(uint index) {
+	uint v = 1u << 31;
+	uint result = 0u;
+	for(; index != 0u; index >>= 1, v ^= v >> 1) {
+		if((index & 1u) != 0u)
+			result ^= v;
+	}
+	return result;
+}
+
+//2D sample of the current sample index for the given dimension pair. Every
+//pair and every pixel shuffles and scrambles the Sobol points differently
+vec2 sample2D(int dimension) {
+	uint seed  = hashCombine(pixelSeed, uint(dimension));
+	uint index = nestedUniformScramble(uint(sampleIndex), hashCombine(seed, 0u));
+	uint x = nestedUniformScramble(reverseBits(index), hashCombine(seed, 1u));
+	uint y = nestedUniformScramble(sobol1(index), hashCombine(seed, 2u));
+	return vec2(x >> 8, y >> 8) / 16777216.0;
+}
+
+//orthonormal tangents of the unit vector N
+void makeBasis(vec3 N, out vec3 T, out vec3 B) {
+	T = normalize(abs(N.x) > 0.5 ? cross(N, vec3(0,1,0)) : cross(N, vec3(1,0,0)));
+	B = cross(N, T);
+}
+
+//cosine weighted direction about the normal, its pdf is cos(theta)/PI
+vec3 cosineSampleHemisphere(vec3 N, vec2 u) {
+	vec3 T, B;
+	makeBasis(N, T, B);
+	float r = sqrt(u.x);
+	float angle = 2.0 * PI * u.y;
+	return normalize(T * (r * cos(angle)) + B * (r * sin(angle)) + N * sqrt(max(0.0, 1.0 - u.x)));
+}
+
+//1-cos of the half angle of the cone subtended by the light, 0 when p is
+//inside the light
+float lightCone(vec3 p) {
+	vec3 toLight = light_position - p;
+	float sin2 = LIGHT_RADIUS * LIGHT_RADIUS / dot(toLight, toLight);
+	if(sin2 >= 1.0)
+		return 0.0;
+	return sin2 / (1.0 + sqrt(1.0 - sin2));
+}
+
+//solid angle pdf of sampling the light cone from p
+float lightPdf(vec3 p) {
+	return 1.0 / (2.0 * PI * lightCone(p));
+}
 
-//returns a uniformly random vector
-vec3 uniformlyRandomVector(float seed) 
-{		
-	return uniformlyRandomDirection(seed) *  (random(vec3(36.7539, 50.3658, 306.2759), seed));	
+//picks a direction uniformly in the cone subtended by the light, returns
+//false when p is inside the light. dist is the distance to the light surface
+bool sampleLight(vec3 p, vec2 u, out vec3 dir, out float dist, out float pdf) {
+	float cone = lightCone(p);
+	if(cone <= 0.0)
+		return false;
+	vec3 toLight = light_position - p;
+	float d = length(toLight);
+	vec3 W = toLight / d;
+	vec3 T, B;
+	makeBasis(W, T, B);
+	float cosTheta = 1.0 - u.x * cone;
+	float sinTheta = sqrt(max(0.0, 1.0 - cosTheta * cosTheta));
+	float angle = 2.0 * PI * u.y;
+	dir = T * (sinTheta * cos(angle)) + B * (sinTheta * sin(angle)) + W * cosTheta;
+	float b = d * cosTheta;
+	dist = b - sqrt(max(0.0, LIGHT_RADIUS * LIGHT_RADIUS - (d * d - b * b)));
+	pdf = 1.0 / (2.0 * PI * cone);
+	return true;
 }
 
-//function to test if the given ray intersect any object
-//if so it returns 0.5 otherwise 1. This darkens the shade
-//simulating shadow
-float shadow(vec3 origin, vec3 dir ) {
+//distance along the unit direction to the light sphere, FAR on a miss
+float intersectLight(vec3 origin, vec3 dir) {
+	vec3 oc = origin - light_position;
+	float b = dot(oc, dir);
+	float c = dot(oc, oc) - LIGHT_RADIUS * LIGHT_RADIUS;
+	float h = b * b - c;
+	if(h < 0.0)
+		return FAR;
+	float t = -b - sqrt(h);
+	return (t > 0.0) ? t : FAR;
+}
+
+//nearest triangle hit closer than tMax. The returned x value is the t value,
+//tMax if nothing was hit
+vec4 traceScene(vec3 origin, vec3 dir, float tMax, out vec3 N) {
+	vec4 val = vec4(tMax,0,0,0);
+	N = vec3(0,1,0);
+	vec2 tNearFar = intersectCube(origin, dir, aabb);
+	if(tNearFar.x > tNearFar.y || tNearFar.y < 0.0)
+		return val;
+
+	//brute force check all triangles for intersection with the ray
+	for(int i=0;i<int(TRIANGLE_TEXTURE_SIZE);i++) 
+	{
+		vec3 normal;
+		vec4 res = intersectTriangle(origin, dir, i, normal); 
+		if(res.x>EPSILON && res.x < val.x) { 
+			val = res;   
+			N = normal;
+		}
+	}
+	return val;
+}
+
+//function to test if the given ray intersect any object closer than tMax
+//returns 0 if it does and 1 otherwise
+float shadow(vec3 origin, vec3 dir, float tMax) {
+	vec2 tNearFar = intersectCube(origin, dir, aabb);
+	if(tNearFar.x > tNearFar.y || tNearFar.y < 0.0)
+		return 1.0;
 	vec3 tmp;
 	for(int i=0;i<int(TRIANGLE_TEXTURE_SIZE);i++) 
 	{
 		vec4 res = intersectTriangle(origin, dir, i, tmp); 
-		if(res.x>0 ) { 
-		   return 0.5;   
+		if(res.x>EPSILON && res.x<tMax) { 
+		   return 0.0;   
 		}
 	}
 	return 1.0;
 }
 
-//function that traces ray with origin and direction from the given light position
-vec3 pathtrace(vec3 origin, vec3 ray, vec3 light, float t) {		
+//traces a path from the eye through diffuse surfaces lit by the spherical
+//light. Every hit samples the light directly with a shadow ray and picks the
+//next direction with cosine weighted sampling; both ways of reaching the light
+//are combined with the power heuristic. Paths are cut with Russian roulette.
+vec3 pathtrace(vec3 origin, vec3 ray) {		
+	vec3 radiance = vec3(0.0);
+	vec3 throughput = vec3(1.0);
+	float bsdfPdf = 0.0;
+	vec3 Le = vec3(lightIntensity / (PI * LIGHT_RADIUS * LIGHT_RADIUS));
+	ray = normalize(ray);
 
-	//set the accumulation variable to 0
-	//set color mask to 1 and surface colour to background colour
-	vec3 colorMask = vec3(1.0);		
-	vec3 accumulatedColor = vec3(0.0);
-	vec3 surfaceColor=vec3(backgroundColor.xyz);
-	
-	float diffuse = 1;
-	//for the total number of bounces
 	for(int bounce = 0; bounce < MAX_BOUNCES; bounce++) {			
-		//check the ray for intesection with the scene bounding box
-		vec2 tNearFar = intersectCube(origin, ray,  aabb);
-		
-		//if it is outside continue
-		if(  tNearFar.x > tNearFar.y)  
-		   continue; 
-		
-		//if it nearest so far set the t paramter
-		if(tNearFar.y<t)
-			t =   tNearFar.y+1;					
-		
 		vec3 N;
-		vec4 val=vec4(t,0,0,0); 
-
-		//brute force check all triangles for intersection with the ray
-		for(int i=0;i<int(TRIANGLE_TEXTURE_SIZE);i++) 
-		{
-			vec3 normal;
-			vec4 res = intersectTriangle(origin, ray, i, normal); 
-			//if intersection found, store the result and normal
-		 	if(res.x>0.001 && res.x <  val.x) { 
-			   val = res;   
-			   N = normal;
-		    }
+		float tLight = intersectLight(origin, ray);
+		vec4 val = traceScene(origin, ray, tLight, N);
+
+		//the path reached the light
+		if(tLight < FAR && val.x >= tLight) {
+			float weight = 1.0;
+			if(bounce > 0) {
+				float pdf = lightPdf(origin);
+				weight = bsdfPdf * bsdfPdf / (bsdfPdf * bsdfPdf + pdf * pdf);
+			}
+			radiance += throughput * Le * weight;
+			break;
+		}
+
+		//the path left the scene, only eye rays see the background
+		if(val.x >= FAR) {
+			if(bounce == 0)
+				radiance = backgroundColor.xyz;
+			break;
+		}
+
+		//calcualte the surface color and face the normal to the ray
+		vec3 albedo = mix(texture(textureMaps, val.yzw), vec4(1), (val.w==255) ).xyz; 
+		vec3 hit = origin + ray * val.x;
+		if(dot(N, ray) > 0.0)
+			N = -N;
+		origin = hit + N * EPSILON;
+
+		//next event estimation with a shadow ray to a point on the light
+		vec3 L;
+		float dist, pdf;
+		if(sampleLight(origin, sample2D(3*bounce), L, dist, pdf)) {
+			float cosL = dot(N, L);
+			if(cosL > 0.0 && shadow(origin, L, dist) > 0.0) {
+				float pdfB = cosL / PI;
+				float weight = pdf * pdf / (pdf * pdf + pdfB * pdfB);
+				radiance += throughput * albedo / PI * Le * cosL / pdf * weight;
+			}
+		}
+
+		//continue the path in a cosine weighted direction, the cosine and the
+		//pdf cancel leaving the albedo
+		ray = cosineSampleHemisphere(N, sample2D(3*bounce+1));
+		bsdfPdf = max(dot(N, ray), 0.0) / PI;
+		throughput *= albedo;
+
+		//Russian roulette keeps bright paths and boosts the survivors
+		if(bounce >= RR_START) {
+			float survive = clamp(max(throughput.x, max(throughput.y, throughput.z)), 0.05, 0.95);
+			if(sample2D(3*bounce+2).x >= survive)
+				break;
+			throughput /= survive;
 		}
-		   
-		//if this is a valid intersection
-		if(  val.x < t) {			  	
-			//calcualte the surface color 
-			surfaceColor = mix(texture(textureMaps, val.yzw), vec4(1), (val.w==255) ).xyz; 
-			
-			//find the hit position, change the ray origin to the new hit position
-			//and get a new random ray direction 
-			vec3 hit = origin + ray * val.x;	
-			origin = hit;	
-			ray = uniformlyRandomDirection(time + float(bounce));	
-			
-			//jitter the light to reduce sampling artifacts
-			vec3  jitteredLight  =  light + ray;
-			vec3 L = normalize(jitteredLight - hit);			
-			
-			//calcualte the diffuse component
-			diffuse = max(0.0, dot(L, N ));			 		
-			colorMask *= surfaceColor;			
-
-			//check for shadows
-			float inShadow = shadow(hit+ N*0.0001, L);
-
-			//accumulate the colour
-			accumulatedColor += colorMask * diffuse * inShadow; 
-			t = val.x;
-		}  			
 	}		
-	//if the accumulatedColor is 0, we did not intersect any geometry
-	//return the product of the diffuse component and the surface colour
-	if(accumulatedColor == vec3(0))
-		return surfaceColor*diffuse;
-	else
-		//otherwise divide the accumulated colour with the total number of bounces
-		return accumulatedColor/float(MAX_BOUNCES-1);	
+	return radiance;
 }	
 
 void main()
 { 
-	//set the maximum t value
-	float t = 10000;  
-	
+	//converged tiles take no more samples so the remaining work goes to the
+	//tiles with the highest noise
+	if(useAdaptive) {
+		vec2 tile = texelFetch(tileStats, ivec2(gl_FragCoord.xy)/TILE_SIZE, 0).xy;
+		if(tile.y >= minSamples && tile.x < errorThreshold)
+			discard;
+	}
+
+	//seed the sample sequence of this pixel
+	pixelSeed = hash(uint(gl_FragCoord.x) + hash(uint(gl_FragCoord.y)));
+
 	//set the fragment colour as the background colour 
 	vFragColor = backgroundColor;
 
 	//setup the camera for the given texture coordinate
-	setup_camera(vUV);
+	setup_camera(vUV+jitter);
 	
 	//check if the ray intersects the scene bounding box 
 	vec2 tNearFar = intersectCube(eyeRay.origin, eyeRay.dir,  aabb);
 
 	//if we have a valid intersection
 	if(tNearFar.x<tNearFar.y  ) {
-		t = tNearFar.y+1; //offset the near intersection to remove the depth artifacts
-		  		 
-		//trace ray from the light positoin in a random direction		
-		vec3 light = light_position + uniformlyRandomVector(time);
-
 		//do path tracing here 
-		vFragColor = vec4(pathtrace(eyeRay.origin, eyeRay.dir, light, t),1);		 
+		vFragColor = vec4(pathtrace(eyeRay.origin, eyeRay.dir),1);		 
 	} 
+
+	//the alpha of 1 counts the sample when the colours are added up, the
+	//luminance moments give the variance of each pixel
+	float luminance = dot(vFragColor.xyz, vec3(0.2126, 0.7152, 0.0722));
+	vFragMoments = vec4(luminance, luminance*luminance, 0, 0);
 }
 
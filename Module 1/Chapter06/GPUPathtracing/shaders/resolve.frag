@@ -0,0 +1,13 @@
+#version 330 core
+
+layout(location = 0) out vec4 vFragColor; //fragment shader output
+
+//shader uniforms
+uniform sampler2D accumulation;	//sum of the pixel colours, alpha holds the sample count
+
+void main()
+{
+	//average of all samples taken by the pixel so far
+	vec4 sum = texelFetch(accumulation, ivec2(gl_FragCoord.xy), 0);
+	vFragColor = vec4(sum.xyz/max(sum.w, 1.0), 1);
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#version 330 core
+
+layout(location = 0) out vec4 vFragColor; //fragment shader output
+
+//shader uniforms
+uniform sampler2D accumulation;	//sum of the pixel colours, alpha holds the sample count
+uniform sampler2D moments;		//sum of the luminance and the squared luminance
+
+//shader constants
+const int TILE_SIZE = 16;		//size of the tiles used for adaptive sampling
+
+void main()
+{
+	//each fragment covers one tile of the accumulation target
+	ivec2 size  = textureSize(accumulation, 0);
+	ivec2 first = ivec2(gl_FragCoord.xy)*TILE_SIZE;
+	ivec2 last  = min(first+ivec2(TILE_SIZE), size);
+
+	float error = 0;
+	float samples = 0;
+	float leastSamples = 1e30;
+	for(int y=first.y;y<last.y;y++) {
+		for(int x=first.x;x<last.x;x++) {
+			float n = texelFetch(accumulation, ivec2(x,y), 0).w;
+			vec2  m = texelFetch(moments, ivec2(x,y), 0).xy;
+			if(n < 2) {
+				//no variance estimate yet
+				error += 1;
+			} else {
+				//standard error of the pixel mean relative to the mean, the
+				//offset keeps dark pixels from dominating the tile
+				float mean = m.x/n;
+				float variance = max(0, (m.y - m.x*mean)/(n-1));
+				error += sqrt(variance/n)/(mean+0.05);
+			}
+			samples += n;
+			leastSamples = min(leastSamples, n);
+		}
+	}
+	float count = float((last.x-first.x)*(last.y-first.y));
+
+	//average relative error, least samples and average samples of the tile
+	vFragColor = vec4(error/count, leastSamples, samples/count, 0);
+}
\ No newline at end of file
@@ -16,6 +16,7 @@
 #include <SOIL.h>
 
 #include <cstdlib>
+#include <cfloat>
 
 #define GL_CHECK_ERRORS assert(glGetError()== GL_NO_ERROR);
 
@@ -32,6 +33,13 @@ const int HEIGHT = 960;
 const int RTT_WIDTH = WIDTH/4;
 const int RTT_HEIGHT = HEIGHT/4;
 
+//temporal SSAO occlusion texture size
+const int AO_WIDTH = WIDTH/2;
+const int AO_HEIGHT = HEIGHT/2;
+
+//blue noise texture size
+const int BLUE_NOISE_SIZE = 64;
+
 //shaders for use in the recipe
 GLSLShader	shader,
 			flatShader,
@@ -39,7 +47,9 @@ GLSLShader	shader,
 			ssaoFirstShader,
 			ssaoSecondShader,
 			gaussianH_shader,
-			gaussianV_shader;
+			gaussianV_shader,
+			ssaoTemporalShader,
+			upsampleShader;
 
 //IDs for vertex array and buffer object
 GLuint vaoID;
@@ -95,6 +105,73 @@ float sampling_radius = 0.25f;
 //flag to enable/disable SSAO
 bool bUseSSAO = true;
 
+//flag to use the temporally accumulated, half resolution SSAO
+bool bUseTemporalSSAO = false;
+//full resolution normal/depth FBO and half resolution occlusion FBO for
+//the temporal SSAO
+GLuint temporalFBOID, aoFBOID;
+//full resolution normal texture ID
+GLuint fullNormalTexID;
+//depth of this and the last frame, swapped every frame
+GLuint fullDepthTexID[2];
+//accumulated occlusion and sample count of this and the last frame
+GLuint historyTexID[2];
+//blue noise texture ID
+GLuint blueNoiseTexID;
+//index of the depth and history textures written this frame
+int currentHistory = 0;
+//frame counter used to rotate the sampling kernel
+int frameIndex = 0;
+//the history is invalid after a projection change or a mode switch
+bool bHistoryValid = false;
+//modelview matrix of the last temporal frame
+glm::mat4 prevMV;
+//frames to keep rendering after the view stopped changing so the
+//occlusion converges
+int framesToConverge = 0;
+const int MAX_HISTORY = 16;
+
+//generates a size x size blue noise texture with the void and cluster
+//method: starting from one pixel, the pixel in the largest void (the lowest
+//Gaussian weighted density of the pixels placed so far, with wrap around)
+//is placed next, and its rank scaled to [0,1) becomes its value
+void GenerateBlueNoise(const int size, vector<float>& noise) {
+	const float sigma = 1.5f;
+	const int R = 6;
+	vector<float> kernel((2*R+1)*(2*R+1));
+	for(int y=-R;y<=R;y++)
+		for(int x=-R;x<=R;x++)
+			kernel[(y+R)*(2*R+1)+x+R] = exp(-(x*x+y*y)/(2*sigma*sigma));
+
+	const int total = size*size;
+	vector<float> energy(total, 0.0f);
+	vector<bool> placed(total, false);
+	noise.assign(total, 0.0f);
+
+	int next = (size/2)*size + size/2;
+	for(int rank=0;rank<total;rank++) {
+		placed[next] = true;
+		noise[next] = (rank+0.5f)/total;
+
+		//add the new pixel's density
+		int px = next%size, py = next/size;
+		for(int y=-R;y<=R;y++) {
+			int row = ((py+y+size)%size)*size;
+			for(int x=-R;x<=R;x++)
+				energy[row + (px+x+size)%size] += kernel[(y+R)*(2*R+1)+x+R];
+		}
+
+		//find the largest void
+		float best = FLT_MAX;
+		for(int i=0;i<total;i++) {
+			if(!placed[i] && energy[i]<best) {
+				best = energy[i];
+				next = i;
+			}
+		}
+	}
+}
+
 //initialization of FBOs
 void InitFBO() {
 	//setup offscreen rendering fbo
@@ -161,6 +238,61 @@ void InitFBO() {
 		cout<<"Problem in Filtering FBO setup."<<endl;
 	}
 
+	//setup the full resolution normal/depth FBO of the temporal SSAO. The
+	//depth textures alternate so the last frame's depth is kept for
+	//rejecting disoccluded history.
+	glGenFramebuffers(1, &temporalFBOID);
+	glBindFramebuffer(GL_FRAMEBUFFER, temporalFBOID);
+	glGenTextures(1, &fullNormalTexID);
+	glActiveTexture(GL_TEXTURE6);
+	glBindTexture(GL_TEXTURE_2D, fullNormalTexID);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, WIDTH, HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fullNormalTexID, 0);
+
+	glGenTextures(2, fullDepthTexID);
+	for(int i=0;i<2;i++) {
+		glBindTexture(GL_TEXTURE_2D, fullDepthTexID[i]);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, WIDTH, HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	}
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,GL_TEXTURE_2D, fullDepthTexID[0], 0);
+
+	status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if(status != GL_FRAMEBUFFER_COMPLETE) {
+		cout<<"Problem in temporal SSAO FBO setup."<<endl;
+	}
+
+	//setup the half resolution occlusion FBO, the history textures keep
+	//the occlusion in red and the number of accumulated frames in green
+	glGenFramebuffers(1, &aoFBOID);
+	glBindFramebuffer(GL_FRAMEBUFFER, aoFBOID);
+	glGenTextures(2, historyTexID);
+	for(int i=0;i<2;i++) {
+		glBindTexture(GL_TEXTURE_2D, historyTexID[i]);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, AO_WIDTH, AO_HEIGHT, 0, GL_RG, GL_FLOAT, NULL);
+	}
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, historyTexID[0], 0);
+
+	status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if(status != GL_FRAMEBUFFER_COMPLETE) {
+		cout<<"Problem in occlusion FBO setup."<<endl;
+	}
+
+	//leave the normal texture bound to texture unit 6
+	glActiveTexture(GL_TEXTURE6);
+	glBindTexture(GL_TEXTURE_2D, fullNormalTexID);
+
 	//bind texture unit 0 as active texture since it will be used for loading 
 	//of model textures
 	glActiveTexture(GL_TEXTURE0);
@@ -177,6 +309,11 @@ void ShutdownFBO() {
 	glDeleteTextures(1, &depthTextureID);
 	glDeleteFramebuffers(1, &fboID);
 	glDeleteFramebuffers(1, &filterFBOID);
+	glDeleteTextures(1, &fullNormalTexID);
+	glDeleteTextures(2, fullDepthTexID);
+	glDeleteTextures(2, historyTexID);
+	glDeleteFramebuffers(1, &temporalFBOID);
+	glDeleteFramebuffers(1, &aoFBOID);
 }
 
 //mouse clock handler
@@ -244,6 +381,18 @@ void OnInit() {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, 64, 64, 0, GL_BGRA, GL_FLOAT, pData);
 
+	//generate the blue noise texture that rotates the temporal SSAO kernel
+	vector<float> blueNoise;
+	GenerateBlueNoise(BLUE_NOISE_SIZE, blueNoise);
+	glGenTextures(1, &blueNoiseTexID);
+	glActiveTexture(GL_TEXTURE9);
+	glBindTexture(GL_TEXTURE_2D, blueNoiseTexID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, BLUE_NOISE_SIZE, BLUE_NOISE_SIZE, 0, GL_RED, GL_FLOAT, &blueNoise[0]);
+
 	//get the mesh path for loading of textures
 	std::string mesh_path = mesh_filename.substr(0, mesh_filename.find_last_of("/")+1);
 
@@ -447,6 +596,52 @@ void OnInit() {
 		glUniform2fv(ssaoSecondShader("samples"), 16, &(samples[0].x));
 	ssaoSecondShader.UnUse();
 
+	//load the temporal SSAO shader
+	ssaoTemporalShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/Passthrough.vert");
+	ssaoTemporalShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/SSAO_Temporal.frag");
+	//compile and link shader
+	ssaoTemporalShader.CreateAndLinkProgram();
+	ssaoTemporalShader.Use();
+		//add attribute and uniform
+		ssaoTemporalShader.AddAttribute("vVertex");
+		ssaoTemporalShader.AddUniform("samples");
+		ssaoTemporalShader.AddUniform("invP");
+		ssaoTemporalShader.AddUniform("P");
+		ssaoTemporalShader.AddUniform("toPrevEye");
+		ssaoTemporalShader.AddUniform("normalTex");
+		ssaoTemporalShader.AddUniform("depthTex");
+		ssaoTemporalShader.AddUniform("prevDepthTex");
+		ssaoTemporalShader.AddUniform("historyTex");
+		ssaoTemporalShader.AddUniform("blueNoiseTex");
+		ssaoTemporalShader.AddUniform("radius");
+		ssaoTemporalShader.AddUniform("frameIndex");
+		ssaoTemporalShader.AddUniform("useHistory");
+
+		//set values of constant uniforms as initialization
+		glUniform1i(ssaoTemporalShader("normalTex"),6);
+		glUniform1i(ssaoTemporalShader("depthTex"),7);
+		glUniform1i(ssaoTemporalShader("prevDepthTex"),8);
+		glUniform1i(ssaoTemporalShader("blueNoiseTex"),9);
+		glUniform1i(ssaoTemporalShader("historyTex"),10);
+		glUniform2fv(ssaoTemporalShader("samples"), 16, &(samples[0].x));
+	ssaoTemporalShader.UnUse();
+
+	//load the bilateral upsampling shader
+	upsampleShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/Passthrough.vert");
+	upsampleShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/SSAO_Upsample.frag");
+	//compile and link shader
+	upsampleShader.CreateAndLinkProgram();
+	upsampleShader.Use();
+		//add attribute and uniform
+		upsampleShader.AddAttribute("vVertex");
+		upsampleShader.AddUniform("aoTex");
+		upsampleShader.AddUniform("depthTex");
+		upsampleShader.AddUniform("invP");
+		//set values of constant uniforms as initialization
+		glUniform1i(upsampleShader("depthTex"),7);
+		glUniform1i(upsampleShader("aoTex"),11);
+	upsampleShader.UnUse();
+
 	GL_CHECK_ERRORS
 
 
@@ -583,6 +778,7 @@ void OnShutdown() {
 
 	//Delete textures
 	glDeleteTextures(1, &noiseTexID);
+	glDeleteTextures(1, &blueNoiseTexID);
 
 	//Destroy shader
 	shader.DeleteShaderProgram();
@@ -592,6 +788,8 @@ void OnShutdown() {
 	gaussianV_shader.DeleteShaderProgram();
 	finalShader.DeleteShaderProgram();
 	flatShader.DeleteShaderProgram();
+	ssaoTemporalShader.DeleteShaderProgram();
+	upsampleShader.DeleteShaderProgram();
 
 	//Destroy vao and vbo
 	glDeleteBuffers(1, &vboVerticesID);
@@ -613,6 +811,104 @@ void OnResize(int w, int h) {
 	glViewport (0, 0, (GLsizei) w, (GLsizei) h);
 	//setup the projection matrix
 	P = glm::perspective(60.0f,(float)w/h, 0.1f,1000.0f);
+	//the reprojected history assumes the same projection
+	bHistoryValid = false;
+}
+
+//draws the mesh with the currently bound shader
+void DrawMesh() {
+	glBindVertexArray(vaoID);
+	for(size_t i=0;i<materials.size();i++) {
+		Material* pMat = materials[i];
+		//if we have a single material, we render the whole mesh in a single call
+		if(materials.size()==1)
+			glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_SHORT, 0);
+		else
+			//otherwise we render the submesh
+			glDrawElements(GL_TRIANGLES, pMat->count, GL_UNSIGNED_SHORT, (const GLvoid*)(&indices[pMat->offset]));
+	}
+}
+
+//temporally accumulated SSAO. Normals and depth are rendered at full
+//resolution, the occlusion is estimated at half resolution with a few
+//kernel samples per frame and blended with the reprojected occlusion of
+//the last frame, then upsampled with a depth aware bilateral filter.
+void RenderTemporalSSAO(const glm::mat4& MV) {
+	int prevHistory = 1-currentHistory;
+
+	//the view has to stay unchanged for a few frames to converge
+	if(MV != prevMV || !bHistoryValid)
+		framesToConverge = MAX_HISTORY;
+
+	glm::mat4 biasMat;
+	biasMat = glm::translate(glm::mat4(1),glm::vec3(0.5,0.5,0.5));
+	biasMat = glm::scale(biasMat, glm::vec3(0.5,0.5,0.5));
+	glm::mat4 invP = glm::inverse(biasMat*P);
+
+	//render the eye space normals and depth at full resolution
+	glBindFramebuffer(GL_FRAMEBUFFER, temporalFBOID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,GL_TEXTURE_2D, fullDepthTexID[currentHistory], 0);
+	glViewport(0,0,WIDTH, HEIGHT);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+	ssaoFirstShader.Use();
+		glUniformMatrix4fv(ssaoFirstShader("MVP"), 1, GL_FALSE, glm::value_ptr(P*MV));
+		glUniformMatrix3fv(ssaoFirstShader("N"), 1, GL_FALSE, glm::value_ptr(glm::inverseTranspose(glm::mat3(MV))));
+		DrawMesh();
+	ssaoFirstShader.UnUse();
+
+	GL_CHECK_ERRORS
+
+	//bind this and the last frame's depth and the last frame's occlusion
+	glActiveTexture(GL_TEXTURE7);
+	glBindTexture(GL_TEXTURE_2D, fullDepthTexID[currentHistory]);
+	glActiveTexture(GL_TEXTURE8);
+	glBindTexture(GL_TEXTURE_2D, fullDepthTexID[prevHistory]);
+	glActiveTexture(GL_TEXTURE10);
+	glBindTexture(GL_TEXTURE_2D, historyTexID[prevHistory]);
+
+	//estimate and accumulate the occlusion at half resolution
+	glBindFramebuffer(GL_FRAMEBUFFER, aoFBOID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, historyTexID[currentHistory], 0);
+	glViewport(0,0,AO_WIDTH, AO_HEIGHT);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	glDisable(GL_DEPTH_TEST);
+	glBindVertexArray(quadVAOID);
+	ssaoTemporalShader.Use();
+		glUniform1f(ssaoTemporalShader("radius"), sampling_radius);
+		glUniform1i(ssaoTemporalShader("frameIndex"), frameIndex);
+		glUniform1i(ssaoTemporalShader("useHistory"), bHistoryValid);
+		glUniformMatrix4fv(ssaoTemporalShader("invP"), 1, GL_FALSE, glm::value_ptr(invP));
+		glUniformMatrix4fv(ssaoTemporalShader("P"), 1, GL_FALSE, glm::value_ptr(P));
+		glUniformMatrix4fv(ssaoTemporalShader("toPrevEye"), 1, GL_FALSE, glm::value_ptr(prevMV*glm::inverse(MV)));
+		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+	ssaoTemporalShader.UnUse();
+
+	GL_CHECK_ERRORS
+
+	//restore the default framebuffer and upsample the occlusion with blending
+	glBindFramebuffer(GL_FRAMEBUFFER,0);
+	glViewport(0,0,WIDTH, HEIGHT);
+	glDrawBuffer(GL_BACK_LEFT);
+
+	glActiveTexture(GL_TEXTURE11);
+	glBindTexture(GL_TEXTURE_2D, historyTexID[currentHistory]);
+	glActiveTexture(GL_TEXTURE0);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	upsampleShader.Use();
+		glUniformMatrix4fv(upsampleShader("invP"), 1, GL_FALSE, glm::value_ptr(invP));
+		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+	upsampleShader.UnUse();
+	glDisable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+
+	//this frame becomes the history of the next one
+	prevMV = MV;
+	bHistoryValid = true;
+	currentHistory = prevHistory;
+	frameIndex++;
 }
 
 //display callback function
@@ -664,8 +960,10 @@ void OnRender() {
 		shader.UnUse();
 	}
 
-	//if SSAO is enabled
-	if(bUseSSAO) {
+	//if temporal SSAO is enabled
+	if(bUseSSAO && bUseTemporalSSAO) {
+		RenderTemporalSSAO(MV);
+	} else if(bUseSSAO) {
 		//bind the FBO
 		glBindFramebuffer(GL_FRAMEBUFFER, fboID);
 		//set the viewport to the size of the offscreen render target
@@ -766,6 +1064,10 @@ void OnRender() {
 
 	//swap front and back buffers to show the rendered result
 	glutSwapBuffers();
+
+	//keep rendering until the temporal occlusion has converged
+	if(bUseSSAO && bUseTemporalSSAO && --framesToConverge > 0)
+		glutPostRedisplay();
 }
 
 //mouse wheel callback to move the light source on mouse wheel scroll event
@@ -795,7 +1097,14 @@ void OnKey(unsigned char k, int x, int y) {
 		case '-': sampling_radius-=0.01f; break;
 		case '+': sampling_radius+=0.01f; break;
 		case ' ': bUseSSAO = !bUseSSAO; break;
+		case 't':
+			bUseTemporalSSAO = !bUseTemporalSSAO;
+			bHistoryValid = false;
+			cout<<"Temporal SSAO: "<<(bUseTemporalSSAO ? "on" : "off")<<endl;
+			break;
 	}
+	//a new radius changes the occlusion, so restart the accumulation
+	bHistoryValid = false;
 	sampling_radius = min(5.0f,max(0.0f,sampling_radius));
 	std::cout<<"rad: "<<sampling_radius<<std::endl;
 	glutPostRedisplay();
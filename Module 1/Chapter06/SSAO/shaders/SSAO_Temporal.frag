@@ -0,0 +1,106 @@
+#version 330 core
+  
+uniform sampler2D normalTex;	//full resolution eye space normals
+uniform sampler2D depthTex;		//full resolution depth of this frame
+uniform sampler2D prevDepthTex;	//full resolution depth of the last frame
+uniform sampler2D historyTex;	//accumulated occlusion and sample count of the last frame
+uniform sampler2D blueNoiseTex;	//64x64 blue noise ranks
+
+//uniforms
+uniform vec2 samples[16];		//a set of 16 sample locations 
+uniform mat4 invP;				//inverse of projection matrix with the [0,1] bias
+uniform mat4 P;					//projection matrix
+uniform mat4 toPrevEye;			//eye space of this frame to eye space of the last frame
+uniform float radius;			//occlusion radius for sampling of depth
+uniform int frameIndex;			//frame counter for rotating the kernel
+uniform bool useHistory;		//false when the history is invalid
+  
+smooth in vec2 vUV;	//interpolated texture coordinates
+
+layout(location=0) out vec4 vFragColor;	//occlusion and accumulated sample count
+ 
+//shader constants
+const float g_scale = 0.2;			//controls the radius of occlusion
+const float g_bias =  0;			//>0 lighter <0 darker
+const float g_intensity = 1.5;		//>1 makes the shadows darker
+const int   NUM_SAMPLES = 2;		//kernel samples per frame
+const int   KERNEL_SIZE = 6;		//kernel samples cycled through over frames
+const float MAX_HISTORY = 16;		//frames averaged at most
+const float DEPTH_REJECT = 0.02;	//relative eye depth change treated as disocclusion
+const float GOLDEN_RATIO = 0.61803399;
+
+//returns the eye space position for a texture coordinate and depth
+vec3 getPosition(vec2 uv, float depth) {
+	vec4 p = invP*vec4(uv, depth, 1);
+	return p.xyz/p.w;
+}
+
+//returns the amount of ambient occlusion of point p with normal n from the
+//surface seen at texture coordinate uv
+float calcAO(vec2 uv, vec3 p, vec3 n)
+{
+	vec3 diff = getPosition(uv, texture(depthTex, uv).r) - p;
+	vec3 v = normalize(diff);
+	float d = length(diff)*g_scale;
+	return max(0.0, dot(n,v)-g_bias)*(1.0/(1.0+d))*g_intensity;
+}
+
+void main()
+{  
+	//get the current depth
+	float depth = texture(depthTex, vUV).r; 
+
+	//nothing to occlude on the background
+	if(depth>=1.0) {
+		vFragColor = vec4(0);
+		return;
+	}
+
+	vec3 n = normalize(texture(normalTex, vUV).xyz*2.0 - 1.0);
+	vec3 p = getPosition(vUV, depth);
+
+	//rotate the kernel by the pixel's blue noise value, advanced by the golden
+	//ratio every frame so that the rotations of successive frames and of
+	//neighbouring pixels are well spread
+	ivec2 pixel = ivec2(gl_FragCoord.xy) & 63;
+	float noise = texelFetch(blueNoiseTex, pixel, 0).r;
+	float angle = 6.28318531 * fract(noise + frameIndex*GOLDEN_RATIO);
+	mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+
+	//each frame takes the next NUM_SAMPLES entries of the kernel
+	float ao = 0.0;
+	for(int i = 0; i < NUM_SAMPLES; i++)
+	{
+		vec2 offset = radius * (rotation * samples[(frameIndex*NUM_SAMPLES + i) % KERNEL_SIZE]);
+		ao += calcAO(vUV + offset, p, n);
+		ao += calcAO(vUV - offset, p, n);
+		ao += calcAO(vUV + vec2(offset.x, -offset.y), p, n);
+		ao += calcAO(vUV + vec2(-offset.x, offset.y), p, n);
+		ao += calcAO(vUV + vec2(offset.x, 0), p, n);
+		ao += calcAO(vUV - vec2(offset.x, 0), p, n);
+		ao += calcAO(vUV + vec2(0, offset.y), p, n);
+		ao += calcAO(vUV - vec2(0, offset.y), p, n);
+	}
+	ao /= NUM_SAMPLES*8.0;
+
+	//reproject into the last frame
+	float count = 1.0;
+	if(useHistory) {
+		vec3 prevP = (toPrevEye*vec4(p,1)).xyz;
+		vec4 prevClip = P*vec4(prevP,1);
+		vec2 prevUV = prevClip.xy/prevClip.w*0.5 + 0.5;
+
+		//the history is valid if the point was on screen and the depth
+		//stored there is the depth the point had, otherwise it was occluded
+		if(all(greaterThanEqual(prevUV, vec2(0))) && all(lessThanEqual(prevUV, vec2(1)))) {
+			float storedZ = getPosition(prevUV, texture(prevDepthTex, prevUV).r).z;
+			if(abs(storedZ - prevP.z) < DEPTH_REJECT*abs(prevP.z)) {
+				vec2 history = texture(historyTex, prevUV).rg;
+				count = min(history.g + 1.0, MAX_HISTORY);
+				ao = mix(history.r, ao, 1.0/count);
+			}
+		}
+	}
+
+	vFragColor = vec4(ao, count, 0, 0);
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#version 330 core
+  
+layout(location=0) out vec4 vFragColor;  //fragment shader output
+ 
+smooth in vec2 vUV;	//interpolated texture coordinate from vertex shader
+
+//uniforms
+uniform sampler2D aoTex;		//half resolution occlusion
+uniform sampler2D depthTex;		//full resolution depth
+uniform mat4 invP;				//inverse of projection matrix with the [0,1] bias
+
+const float DEPTH_SIGMA = 0.05;	//relative eye depth difference that halves the weight
+
+//returns the eye space depth for a texture coordinate and depth
+float getEyeZ(vec2 uv, float depth) {
+	vec4 p = invP*vec4(uv, depth, 1);
+	return p.z/p.w;
+}
+
+void main()
+{ 	 
+	float depth = texture(depthTex, vUV).r;
+	if(depth>=1.0)
+		discard;
+	float z = getEyeZ(vUV, depth);
+
+	//joint bilateral upsampling: the four nearest half resolution texels are
+	//weighted bilinearly and by how close their depth is to this pixel's
+	//depth, so occlusion does not bleed across depth edges
+	vec2 aoSize = vec2(textureSize(aoTex, 0));
+	vec2 pos = vUV*aoSize - 0.5;
+	vec2 base = floor(pos);
+	vec2 f = pos - base;
+
+	float total = 0.0, ao = 0.0;
+	float nearestDiff = 1e30, nearestAO = 0.0;
+	for(int j=0;j<2;j++) {
+		for(int i=0;i<2;i++) {
+			vec2 texel = clamp(base + vec2(i,j), vec2(0), aoSize-1.0);
+			vec2 uv = (texel + 0.5)/aoSize;
+			float sampleAO = texture(aoTex, uv).r;
+			float diff = abs(getEyeZ(uv, texture(depthTex, uv).r) - z);
+			float bilinear = (i==0 ? 1.0-f.x : f.x) * (j==0 ? 1.0-f.y : f.y);
+			float w = bilinear * exp2(-diff/(DEPTH_SIGMA*abs(z)));
+			total += w;
+			ao += w*sampleAO;
+			if(diff < nearestDiff) {
+				nearestDiff = diff;
+				nearestAO = sampleAO;
+			}
+		}
+	}
+
+	//if no texel is on this surface take the one nearest in depth
+	ao = total > 1e-4 ? ao/total : nearestAO;
+
+	//the occlusion goes in alpha as it is blended over the output
+	vFragColor = vec4(vec3(0), ao);
+}
\ No newline at end of file
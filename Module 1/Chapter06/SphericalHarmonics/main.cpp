@@ -8,7 +8,11 @@
 #include <glm/gtc/matrix_inverse.hpp>
 
 #include "..\src\GLSLShader.h"
+#include "..\src\SHProjector.h"
+#include "..\src\PRTBaker.h"
 #include <vector>
+#include <cstdio>
+#include <cstring>
 #include "Obj.h"
 
 #include <SOIL.h>
@@ -24,8 +28,9 @@ using namespace std;
 const int WIDTH  = 1280;
 const int HEIGHT = 960;
 
-//spherical harmonics shader, mesh rendering shader and flat shader
-GLSLShader sh_shader, shader, flatShader;
+//spherical harmonics shader, precomputed radiance transfer shader, mesh
+//rendering shader and flat shader
+GLSLShader sh_shader, prt_shader, shader, flatShader;
 
 //pointer to current shader
 GLSLShader* pCurrentShader;
@@ -34,6 +39,7 @@ GLSLShader* pCurrentShader;
 GLuint vaoID;
 GLuint vboVerticesID;
 GLuint vboIndicesID;
+GLuint vboTransferID;
 
 //light crosshair gizmo vetex array and buffer object IDs
 GLuint lightVAOID;
@@ -66,6 +72,125 @@ const std::string mesh_filename = "../media/blocks.obj";
 //objectspace light position
 glm::vec3 lightPosOS=glm::vec3(0, 2,0); 
 
+//Campus sunset HDR probe basic frequency components
+const float campusCoefficients[27] = {
+	 .79f, .94f, .98f,		//L00
+	 .44f, .56f, .70f,		//L1m1
+	-.10f,-.18f,-.27f,		//L10
+	 .45f, .38f, .20f,		//L11
+	 .18f, .14f, .05f,		//L2m2
+	-.14f,-.22f,-.31f,		//L2m1
+	-.39f,-.40f,-.36f,		//L20
+	 .09f, .07f, .04f,		//L21
+	 .67f, .67f, .52f		//L22
+};
+const glm::vec3 campusScaleFactor = glm::vec3(0.39f/(0.79f+0.39f), 0.40f/(.94f+0.40f), 0.31f/(0.98f+0.31f));
+
+//environment lighting, either the campus probe, a procedural sky lit by the
+//light position or an HDR environment given on the command line
+enum Environment { ENV_CAMPUS, ENV_SKY, ENV_FILE, TOTAL_ENVIRONMENTS };
+int environment = ENV_CAMPUS;
+const char* environmentNames[TOTAL_ENVIRONMENTS] = {"campus sunset", "procedural sky", "HDR file"};
+
+//spherical harmonics projector and the current coefficients
+CSHProjector projector;
+float shCoefficients[27];
+glm::vec3 scaleFactor = campusScaleFactor;
+
+//lat-long size of the procedural sky
+const int SKY_WIDTH  = 512;
+const int SKY_HEIGHT = 256;
+vector<float> skyPixels;
+
+//HDR environment, one lat-long image or six cube map faces
+vector<float> environmentFaces[6];
+int environmentWidth = 0, environmentHeight = 0;
+bool isCubeEnvironment = false;
+bool hasEnvironmentFile = false;
+
+//per vertex transfer vectors for the precomputed radiance transfer shader
+CPRTBaker baker;
+vector<float> transfer;
+const int PRT_SQRT_SAMPLES = 32;
+
+//fills the procedural sky lat-long map, a blue gradient above the horizon,
+//brown ground below it and a bright sun in the direction of the light
+void FillSky(const glm::vec3& sunDirection) {
+	const float PI = 3.14159265358979323846f;
+	const float cosSun = cos(4.0f*PI/180.0f);
+	skyPixels.resize(SKY_WIDTH*SKY_HEIGHT*3);
+	for(int j=0;j<SKY_HEIGHT;j++) {
+		float theta = PI*(j+0.5f)/SKY_HEIGHT;
+		for(int i=0;i<SKY_WIDTH;i++) {
+			float phi = 2*PI*(i+0.5f)/SKY_WIDTH;
+			glm::vec3 dir(sin(theta)*cos(phi), cos(theta), sin(theta)*sin(phi));
+			glm::vec3 colour;
+			if(dir.y>0)
+				colour = glm::mix(glm::vec3(0.8f,0.85f,0.9f), glm::vec3(0.25f,0.45f,0.9f), dir.y);
+			else
+				colour = glm::vec3(0.25f,0.2f,0.15f);
+			if(glm::dot(dir, sunDirection)>cosSun)
+				colour += glm::vec3(60,55,45);
+			float* p = &skyPixels[(j*SKY_WIDTH+i)*3];
+			p[0] = colour.x;
+			p[1] = colour.y;
+			p[2] = colour.z;
+		}
+	}
+}
+
+//loads the HDR environment given on the command line, one lat-long image or
+//the six cube map faces in the order +X,-X,+Y,-Y,+Z,-Z
+bool LoadEnvironment(int argc, char** argv) {
+	if(argc!=2 && argc!=7)
+		return false;
+	isCubeEnvironment = (argc==7);
+	for(int i=1;i<argc;i++) {
+		int width = 0, height = 0;
+		if(!CSHProjector::LoadHDR(argv[i], environmentFaces[i-1], width, height)) {
+			cerr<<"Cannot load HDR environment: "<<argv[i]<<endl;
+			return false;
+		}
+		if(isCubeEnvironment && (width!=height || (i>1 && width!=environmentWidth))) {
+			cerr<<"Cube map faces must be square and of the same size: "<<argv[i]<<endl;
+			return false;
+		}
+		environmentWidth = width;
+		environmentHeight = height;
+	}
+	return true;
+}
+
+//projects the current environment to spherical harmonics and sets the
+//exposure. The projection time is shown in the window title.
+void ProjectEnvironment() {
+	float time = 0;
+	if(environment == ENV_CAMPUS) {
+		memcpy(shCoefficients, campusCoefficients, sizeof(shCoefficients));
+		scaleFactor = campusScaleFactor;
+	} else {
+		if(environment == ENV_SKY) {
+			FillSky(glm::normalize(lightPosOS));
+			projector.ProjectLatLong(&skyPixels[0], SKY_WIDTH, SKY_HEIGHT, 3, 3, shCoefficients);
+		} else if(isCubeEnvironment) {
+			const float* faces[6];
+			for(int i=0;i<6;i++)
+				faces[i] = &environmentFaces[i][0];
+			projector.ProjectCubeMap(faces, environmentWidth, 3, 3, shCoefficients);
+		} else {
+			projector.ProjectLatLong(&environmentFaces[0][0], environmentWidth, environmentHeight, 3, 3, shCoefficients);
+		}
+		time = projector.GetLastTime();
+		//map the brightest irradiance of the environment to 1
+		float maxIrradiance = CSHProjector::MaxIrradiance(shCoefficients);
+		scaleFactor = glm::vec3((maxIrradiance>0)? 1.0f/maxIrradiance : 1.0f);
+	}
+
+	char title[256];
+	sprintf(title, "Spherical Harmonics - OpenGL 3.3 - %s (projected in %.2f ms)", environmentNames[environment], time);
+	glutSetWindowTitle(title);
+}
+
 //mouse click handler
 void OnMouseDown(int button, int s, int x, int y)
 {
@@ -97,6 +222,9 @@ void OnMouseMove(int x, int y)
 		lightPosOS.y = radius * cos(phi);
 		lightPosOS.z = radius * sin(theta)*sin(phi);
 
+		//the sun of the procedural sky follows the light
+		if(environment == ENV_SKY)
+			ProjectEnvironment();
 	} else  {
 		rY += (x - oldX)/5.0f;
 		rX += (y - oldY)/5.0f;
@@ -207,12 +335,42 @@ void OnInit() {
 		sh_shader.AddUniform("light_position");
 		sh_shader.AddUniform("useDefault");
 		sh_shader.AddUniform("diffuse_color");
+		sh_shader.AddUniform("L");
+		sh_shader.AddUniform("scaleFactor");
 		//set values of constant uniforms as initialization
 		glUniform1i(sh_shader("textureMap"), 0);
 	sh_shader.UnUse();
 	
 	GL_CHECK_ERRORS
 
+	//load precomputed radiance transfer shader
+	prt_shader.LoadFromFile(GL_VERTEX_SHADER, "shaders/prt_shader.vert");
+	prt_shader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/sh_shader.frag");
+	//compile and link shader
+	prt_shader.CreateAndLinkProgram();
+	prt_shader.Use();
+		//add attribute and uniform
+		prt_shader.AddAttribute("vVertex");
+		prt_shader.AddAttribute("vNormal");
+		prt_shader.AddAttribute("vUV");
+		prt_shader.AddAttribute("vTransfer0");
+		prt_shader.AddAttribute("vTransfer1");
+		prt_shader.AddAttribute("vTransfer2");
+		prt_shader.AddUniform("MV");
+		prt_shader.AddUniform("N");
+		prt_shader.AddUniform("P");
+		prt_shader.AddUniform("textureMap");
+		prt_shader.AddUniform("light_position");
+		prt_shader.AddUniform("useDefault");
+		prt_shader.AddUniform("diffuse_color");
+		prt_shader.AddUniform("L");
+		prt_shader.AddUniform("scaleFactor");
+		//set values of constant uniforms as initialization
+		glUniform1i(prt_shader("textureMap"), 0);
+	prt_shader.UnUse();
+
+	GL_CHECK_ERRORS
+
 	//load mesh rendering shader
 	shader.LoadFromFile(GL_VERTEX_SHADER, "shaders/shader.vert");
 	shader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/sh_shader.frag");
@@ -262,6 +420,27 @@ void OnInit() {
 
 	GL_CHECK_ERRORS
 
+	//bake the self shadowed transfer vectors of all mesh vertices
+	vector<GLuint> bakeIndices(indices.begin(), indices.end());
+	baker.Init();
+	baker.Bake(&vertices[0].pos, &vertices[0].normal, sizeof(Vertex), int(vertices.size()),
+			   &bakeIndices[0], int(bakeIndices.size()), PRT_SQRT_SAMPLES, transfer);
+	baker.Destroy();
+	cout<<"Baked transfer vectors of "<<vertices.size()<<" vertices in "<<baker.GetLastTime()<<" ms"<<endl;
+
+	//pass the transfer vectors in their own buffer object
+	glGenBuffers(1, &vboTransferID);
+	glBindBuffer (GL_ARRAY_BUFFER, vboTransferID);
+	glBufferData (GL_ARRAY_BUFFER, sizeof(float)*transfer.size(), &transfer[0], GL_STATIC_DRAW);
+	const char* transferAttributes[3] = {"vTransfer0", "vTransfer1", "vTransfer2"};
+	for(int i=0;i<3;i++) {
+		GLuint attribute = prt_shader[transferAttributes[i]];
+		glEnableVertexAttribArray(attribute);
+		glVertexAttribPointer(attribute, 3, GL_FLOAT, GL_FALSE, sizeof(float)*CPRTBaker::TOTAL_COEFFICIENTS, (const GLvoid*)(sizeof(float)*3*i));
+	}
+
+	GL_CHECK_ERRORS
+
 	//if we have a single material, it means the 3ds model contains one mesh
 	//we therefore load it into an element array buffer
 	if(materials.size()==1) {
@@ -286,6 +465,10 @@ void OnInit() {
 	lightPosOS.y = radius * cos(phi);
 	lightPosOS.z = radius * sin(theta)*sin(phi);
 
+	//start the projection threads and set the campus probe coefficients
+	projector.Init();
+	ProjectEnvironment();
+
 	//setup vao and vbo stuff for the light position crosshair
 	glm::vec3 crossHairVertices[6];
 	crossHairVertices[0] = glm::vec3(-0.5f,0,0);
@@ -344,11 +527,15 @@ void OnShutdown() {
 	pCurrentShader = NULL;
 	flatShader.DeleteShaderProgram();
 	sh_shader.DeleteShaderProgram();
+	prt_shader.DeleteShaderProgram();
 	shader.DeleteShaderProgram();
 
+	projector.Destroy();
+
 	//Destroy vao and vbo
 	glDeleteBuffers(1, &vboVerticesID);
 	glDeleteBuffers(1, &vboIndicesID);
+	glDeleteBuffers(1, &vboTransferID);
 	glDeleteVertexArrays(1, &vaoID);
 	
 	glDeleteVertexArrays(1, &lightVAOID);
@@ -384,6 +571,11 @@ void OnRender() {
 			glUniformMatrix3fv((*pCurrentShader)("N"), 1, GL_FALSE, glm::value_ptr(glm::inverseTranspose(glm::mat3(MV))));
 			glUniformMatrix4fv((*pCurrentShader)("P"), 1, GL_FALSE, glm::value_ptr(P));
 			glUniform3fv((*pCurrentShader)("light_position"),1, &(lightPosOS.x)); 
+			//pass the environment coefficients to the spherical harmonics shaders
+			if(pCurrentShader != &shader) {
+				glUniform3fv((*pCurrentShader)("L"), 9, shCoefficients);
+				glUniform3fv((*pCurrentShader)("scaleFactor"), 1, &(scaleFactor.x));
+			}
 
 			//loop through all materials
 			for(size_t i=0;i<materials.size();i++) {
@@ -436,12 +628,23 @@ void OnRender() {
 //keyboard event handler
 void OnKey(unsigned char key, int x, int y) {
 	switch(key) {
+		//cycle spherical harmonics, precomputed radiance transfer and plain diffuse
 		case ' ':
 			if(pCurrentShader== &sh_shader)
+				pCurrentShader = &prt_shader;
+			else if(pCurrentShader== &prt_shader)
 				pCurrentShader = &shader;
 			else
 				pCurrentShader = &sh_shader;
 		break;
+
+		//cycle the environments, the HDR file one only if it was loaded
+		case 'e':
+			environment = (environment+1)%TOTAL_ENVIRONMENTS;
+			if(environment == ENV_FILE && !hasEnvironmentFile)
+				environment = ENV_CAMPUS;
+			ProjectEnvironment();
+		break;
 	}
 	glutPostRedisplay();
 }
@@ -478,6 +681,9 @@ int main(int argc, char** argv) {
 
 	GL_CHECK_ERRORS
 
+	//load the optional HDR environment
+	hasEnvironmentFile = LoadEnvironment(argc, argv);
+
 	//OpenGL initialization
 	OnInit();
 
@@ -0,0 +1,71 @@
+#version 330 core
+ 
+layout(location = 0) in vec3 vVertex;	//object space vertex
+layout(location = 1) in vec3 vNormal;	//object space normal
+layout(location = 2) in vec2 vUV;		//texture coordinates
+layout(location = 3) in vec3 vTransfer0;	//precomputed transfer vector
+layout(location = 4) in vec3 vTransfer1;	//coefficients 0-2, 3-5 and 6-8
+layout(location = 5) in vec3 vTransfer2;
+ 
+//shader outputs to fragment shader
+smooth out vec2 vUVout;			//texture coordinates
+smooth out vec4 diffuse;		//diffuse colour
+
+//shader uniforms
+uniform mat4 P;					//projection matrix
+uniform mat4 MV;				//modelview matrix
+uniform mat3 N;					//normal matrix
+uniform vec3 light_position;	// light position in object space
+
+//spherical harmonics coefficients L00, L1-1, L10, L11, L2-2, L2-1, L20, L21, L22
+//of the environment and the factor that brings the irradiance to 0 - 1 range
+uniform vec3 L[9];
+uniform vec3 scaleFactor;
+
+//attenuation constants
+const float k0 = 1.0;	//constant attenuation
+const float k1 = 0.0;	//linear attenuation
+const float k2 = 0.0;	//quadratic attenuation
+
+void main()
+{
+	//copy the texture coordinates to output variable
+	vUVout=vUV; 
+	//normalize the normal vector
+	vec3 tmpN = normalize(N*vNormal);  
+
+	//get eye space light and vertex position
+	vec4 vEyeSpaceLightPosition = (MV*vec4(light_position,1));
+	vec4 vEyeSpacePosition = MV*vec4(vVertex,1);
+
+	//get the light vector
+	vec3 L0 = (vEyeSpaceLightPosition.xyz-vEyeSpacePosition.xyz);
+
+	//get the light distance
+	float d = length(L0);
+
+	//normalize the light vector
+	L0 = normalize(L0);
+
+	//get the diffuse component from light source
+	float nDotL = max(0, dot(L0,tmpN));
+
+	//the transfer vector already holds the cosine weighted visibility of the
+	//vertex, so the self shadowed irradiance is a dot product with the 
+	//spherical harmonics coefficients of the environment
+	vec3 diff = L[0] * vTransfer0.x + L[1] * vTransfer0.y + L[2] * vTransfer0.z +
+				L[3] * vTransfer1.x + L[4] * vTransfer1.y + L[5] * vTransfer1.z +
+				L[6] * vTransfer2.x + L[7] * vTransfer2.y + L[8] * vTransfer2.z;
+	diff *= scaleFactor;//brings it to 0 - 1 range
+
+	//the final diffuse component is the sum of the diffuse component from the
+	//scene lighting and the shadowed diffuse component from the environment
+	diffuse = vec4(diff+nDotL, 1);
+	
+	//apply attenuation
+	float attenuationAmount = 1.0/(k0 + (k1*d) + (k2*d*d));
+	diffuse *= attenuationAmount;
+    
+	//get the clipspace position
+	gl_Position = P*(vEyeSpacePosition);
+}
\ No newline at end of file
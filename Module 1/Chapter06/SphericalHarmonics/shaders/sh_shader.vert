@@ -25,17 +25,10 @@ const float C5 = 0.247708;
 const float PI = 3.1415926535897932384626433832795;
 
 
-//Campus sunset HDR probe basic frequency components
-const vec3 L00 = vec3(.79,.94, .98);
-const vec3 L1m1 = vec3(.44, .56, .70);
-const vec3 L10 = vec3(-.10, -.18, -.27);
-const vec3 L11 = vec3(.45, .38, .20);
-const vec3 L2m2 = vec3(.18, .14, .05);
-const vec3 L2m1 = vec3(-.14, -.22, -.31);
-const vec3 L20 = vec3(-.39, -.40, -.36);
-const vec3 L21 = vec3(.09, .07, .04);
-const vec3 L22 = vec3(.67, .67, .52);
-const vec3 scaleFactor = vec3(0.39/ (0.79+0.39), 0.40/(.94+0.40), 0.31/(0.98+0.31));
+//spherical harmonics coefficients L00, L1-1, L10, L11, L2-2, L2-1, L20, L21, L22
+//of the environment and the factor that brings the irradiance to 0 - 1 range
+uniform vec3 L[9];
+uniform vec3 scaleFactor;
 
 //attenuation constants
 const float k0 = 1.0;	//constant attenuation
@@ -49,6 +42,10 @@ void main()
 	//normalize the normal vector
 	vec3 tmpN = normalize(N*vNormal);  
 
+	//the environment is given in object space like the transfer vectors of
+	//the PRT shader, so the spherical harmonics use the object space normal
+	vec3 n = normalize(vNormal);
+
 	//get eye space light and vertex position
 	vec4 vEyeSpaceLightPosition = (MV*vec4(light_position,1));
 	vec4 vEyeSpacePosition = MV*vec4(vVertex,1);
@@ -66,17 +63,17 @@ void main()
 	float nDotL = max(0, dot(L,tmpN));
 
 	//estimate the diffuse component using the polynomial interpolation of the 
-	//spherical harmonics coefficients with the eye space normal
-	vec3 diff = C1 * L22 * (tmpN.x * tmpN.x - tmpN.y * tmpN.y) + 
-				   C3 * L20 * tmpN.z * tmpN.z + 
-				   C4 * L00 - 
-				   C5 * L20 + 
-				   2.0 * C1 * L2m2 * tmpN.x * tmpN.y + 
-				   2.0 * C1 * L21 * tmpN.x * tmpN.z + 
-				   2.0 * C1 * L2m1 * tmpN.y * tmpN.z + 
-				   2.0 * C2 * L11 * tmpN.x +
-				   2.0 * C2 * L1m1 * tmpN.y +
-				   2.0 * C2 * L10 * tmpN.z;
+	//spherical harmonics coefficients with the object space normal
+	vec3 diff = C1 * L[8] * (n.x * n.x - n.y * n.y) + 
+				   C3 * L[6] * n.z * n.z + 
+				   C4 * L[0] - 
+				   C5 * L[6] + 
+				   2.0 * C1 * L[4] * n.x * n.y + 
+				   2.0 * C1 * L[7] * n.x * n.z + 
+				   2.0 * C1 * L[5] * n.y * n.z + 
+				   2.0 * C2 * L[3] * n.x +
+				   2.0 * C2 * L[1] * n.y +
+				   2.0 * C2 * L[2] * n.z;
 	diff *= scaleFactor;//brings it to 0 - 1 range
 
 	//the final diffuse component is the sum of the diffuse component from the
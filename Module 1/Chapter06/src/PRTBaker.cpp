@@ -0,0 +1,125 @@
+#include "PRTBaker.h"
+#include "Timer.h"
+#include "SHProjector.h"
+#include <algorithm>
+#include <cmath>
+
+//number of vertices baked by one task
+const int VERTICES_PER_TASK = 64;
+
+struct CPRTBaker::Job {
+	const char* positions;
+	const char* normals;
+	int stride, totalVertices;
+	float epsilon, tMax;
+	const CMeshBVH* bvh;
+	const glm::vec3* directions;
+	const float* basis;
+	int totalDirections;
+	float* transfer;
+};
+
+CPRTBaker::CPRTBaker(void)
+{
+	lastTime = 0;
+}
+
+CPRTBaker::~CPRTBaker(void)
+{
+	Destroy();
+}
+
+void CPRTBaker::Init(int totalThreads) {
+	pool.Init(totalThreads);
+}
+
+void CPRTBaker::Destroy() {
+	pool.Destroy();
+}
+
+void CPRTBaker::BakeVertices(int task, void* data) {
+	Job& job = *(Job*)data;
+	//each direction stands for an equal part of the sphere
+	const float weight = 4*3.14159265358979323846f/job.totalDirections;
+	int first = task*VERTICES_PER_TASK;
+	int last = std::min(first+VERTICES_PER_TASK, job.totalVertices);
+
+	for(int v=first;v<last;v++) {
+		const glm::vec3& p = *(const glm::vec3*)(job.positions + size_t(v)*job.stride);
+		glm::vec3 n = *(const glm::vec3*)(job.normals + size_t(v)*job.stride);
+		float length = glm::length(n);
+		float* T = job.transfer + size_t(v)*TOTAL_COEFFICIENTS;
+		std::fill(T, T+TOTAL_COEFFICIENTS, 0.0f);
+		if(length<=0)
+			continue;
+		n /= length;
+		//start the rays off the surface so they do not hit their own triangles
+		glm::vec3 origin = p + n*job.epsilon;
+
+		for(int d=0;d<job.totalDirections;d++) {
+			float cosine = glm::dot(n, job.directions[d]);
+			if(cosine<=0 || job.bvh->Occluded(origin, job.directions[d], job.tMax))
+				continue;
+			const float* Y = job.basis + size_t(d)*TOTAL_COEFFICIENTS;
+			float w = cosine*weight;
+			for(int k=0;k<TOTAL_COEFFICIENTS;k++)
+				T[k] += w*Y[k];
+		}
+	}
+}
+
+void CPRTBaker::Bake(const glm::vec3* positions, const glm::vec3* normals, const int stride, const int totalVertices,
+					 const GLuint* indices, const int totalIndices, const int sqrtSamples, std::vector<float>& transfer) {
+	CTimer timer;
+
+	transfer.assign(size_t(totalVertices)*TOTAL_COEFFICIENTS, 0.0f);
+	if(totalVertices<=0)
+		return;
+
+	//the BVH wants tightly packed positions
+	std::vector<glm::vec3> packed(totalVertices);
+	for(int i=0;i<totalVertices;i++)
+		packed[i] = *(const glm::vec3*)((const char*)positions + size_t(i)*stride);
+	bvh.Build(&packed[0], totalVertices, indices, totalIndices);
+
+	//jittered stratified directions, uniform over the sphere, with a fixed
+	//seed so the bake is repeatable. At least one direction is used.
+	const int strata = std::max(1, sqrtSamples);
+	const int total = strata*strata;
+	directions.resize(total);
+	basis.resize(size_t(total)*TOTAL_COEFFICIENTS);
+	unsigned int seed = 1;
+	int d = 0;
+	for(int i=0;i<strata;i++) {
+		for(int j=0;j<strata;j++, d++) {
+			seed = seed*1664525u+1013904223u;
+			float u = (i + (seed>>8)/16777216.0f)/strata;
+			seed = seed*1664525u+1013904223u;
+			float v = (j + (seed>>8)/16777216.0f)/strata;
+			float z = 1-2*u;
+			float r = sqrt(std::max(0.0f, 1-z*z));
+			float phi = 2*3.14159265358979323846f*v;
+			directions[d] = glm::vec3(r*cos(phi), r*sin(phi), z);
+			CSHProjector::EvaluateBasis(&directions[d].x, 3, &basis[size_t(d)*TOTAL_COEFFICIENTS]);
+		}
+	}
+
+	glm::vec3 extent = bvh.GetMax()-bvh.GetMin();
+	float diagonal = glm::length(extent);
+
+	Job job;
+	job.positions = (const char*)positions;
+	job.normals = (const char*)normals;
+	job.stride = stride;
+	job.totalVertices = totalVertices;
+	job.epsilon = diagonal*1e-4f;
+	job.tMax = diagonal*2;
+	job.bvh = &bvh;
+	job.directions = &directions[0];
+	job.basis = &basis[0];
+	job.totalDirections = total;
+	job.transfer = &transfer[0];
+	pool.Run((totalVertices+VERTICES_PER_TASK-1)/VERTICES_PER_TASK, BakeVertices, &job);
+
+	lastTime = timer.Elapsed();
+}
\ No newline at end of file
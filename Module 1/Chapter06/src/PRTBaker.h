@@ -0,0 +1,48 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "MeshBVH.h"
+#include "ThreadPool.h"
+
+//Precomputed radiance transfer for diffuse surfaces. For every vertex the
+//cosine weighted visibility of the sphere is projected onto the 9 spherical
+//harmonics basis functions by casting rays against a BVH of the mesh. The
+//dot product of the transfer vector with the coefficients of an environment
+//projected by CSHProjector then gives the self shadowed irradiance of the
+//vertex, which matches the unshadowed irradiance polynomial where nothing is
+//in the way.
+class CPRTBaker
+{
+public:
+	static const int TOTAL_COEFFICIENTS = 9;
+
+	CPRTBaker(void);
+	~CPRTBaker(void);
+
+	//starts the worker threads, 0 uses one thread per hardware thread
+	void Init(int totalThreads = 0);
+	void Destroy();
+
+	//positions and normals are read with the given stride in bytes. transfer
+	//receives 9 floats per vertex. sqrtSamples*sqrtSamples stratified
+	//directions are shared by all vertices, sqrtSamples below 1 uses one.
+	void Bake(const glm::vec3* positions, const glm::vec3* normals, const int stride, const int totalVertices,
+			  const GLuint* indices, const int totalIndices, const int sqrtSamples, std::vector<float>& transfer);
+
+	//time taken by the last bake in milliseconds
+	float GetLastTime() const { return lastTime; }
+
+private:
+	CPRTBaker(const CPRTBaker&);
+	CPRTBaker& operator=(const CPRTBaker&);
+
+	struct Job;
+	static void BakeVertices(int task, void* data);
+
+	CThreadPool pool;
+	CMeshBVH bvh;
+	std::vector<glm::vec3> directions;
+	std::vector<float> basis;
+	float lastTime;
+};
\ No newline at end of file
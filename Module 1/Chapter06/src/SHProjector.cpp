@@ -0,0 +1,377 @@
+#include "SHProjector.h"
+#include "Timer.h"
+#include <xmmintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+const float PI = 3.14159265358979323846f;
+
+//real spherical harmonics normalization constants
+const float SH_C0 = 0.282095f;	//Y00
+const float SH_C1 = 0.488603f;	//Y1-1 Y10 Y11
+const float SH_C2 = 1.092548f;	//Y2-2 Y2-1 Y21
+const float SH_C3 = 0.315392f;	//Y20
+const float SH_C4 = 0.546274f;	//Y22
+
+//Ramamoorthi and Hanrahan irradiance constants
+const float C1 = 0.429043f;
+const float C2 = 0.511664f;
+const float C3 = 0.743125f;
+const float C4 = 0.886227f;
+const float C5 = 0.247708f;
+
+//27 colour sums and the weight sum, padded to two cache lines per task
+const int SUMS = CSHProjector::MAX_COEFFICIENTS*3+1;
+const int PARTIAL_STRIDE = 32;
+
+//number of rows summed by one task
+const int ROWS_PER_TASK = 8;
+
+//tangent frames of the cube faces in GL order, a texel at (s,t) in [-1,1]
+//with t growing downwards points along n + s*sAxis + t*tAxis
+static const float FACE_FRAMES[6][3][3] = {
+	{{ 0, 0,-1}, {0,-1, 0}, { 1, 0, 0}},	//+X
+	{{ 0, 0, 1}, {0,-1, 0}, {-1, 0, 0}},	//-X
+	{{ 1, 0, 0}, {0, 0, 1}, { 0, 1, 0}},	//+Y
+	{{ 1, 0, 0}, {0, 0,-1}, { 0,-1, 0}},	//-Y
+	{{ 1, 0, 0}, {0,-1, 0}, { 0, 0, 1}},	//+Z
+	{{-1, 0, 0}, {0,-1, 0}, { 0, 0,-1}}		//-Z
+};
+
+struct CSHProjector::Job {
+	bool isCube;
+	const float* const* faces;
+	const float* pixels;
+	int width, height, channels, order;
+	int totalRows;
+	const float* cosPhi;
+	const float* sinPhi;
+	float* partials;
+};
+
+//adds 4 texels with directions (x,y,z), solid angles w and colours (r,g,b)
+static inline void Accumulate(const __m128 x, const __m128 y, const __m128 z, const __m128 w,
+							  const __m128 r, const __m128 g, const __m128 b, const int order, __m128* acc) {
+	__m128 basis[CSHProjector::MAX_COEFFICIENTS];
+	basis[0] = _mm_set1_ps(SH_C0);
+	basis[1] = _mm_mul_ps(_mm_set1_ps(SH_C1), y);
+	basis[2] = _mm_mul_ps(_mm_set1_ps(SH_C1), z);
+	basis[3] = _mm_mul_ps(_mm_set1_ps(SH_C1), x);
+	int total = 4;
+	if(order>2) {
+		basis[4] = _mm_mul_ps(_mm_set1_ps(SH_C2), _mm_mul_ps(x, y));
+		basis[5] = _mm_mul_ps(_mm_set1_ps(SH_C2), _mm_mul_ps(y, z));
+		basis[6] = _mm_mul_ps(_mm_set1_ps(SH_C3), _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3), _mm_mul_ps(z, z)), _mm_set1_ps(1)));
+		basis[7] = _mm_mul_ps(_mm_set1_ps(SH_C2), _mm_mul_ps(x, z));
+		basis[8] = _mm_mul_ps(_mm_set1_ps(SH_C4), _mm_sub_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+		total = 9;
+	}
+	__m128 wr = _mm_mul_ps(w, r);
+	__m128 wg = _mm_mul_ps(w, g);
+	__m128 wb = _mm_mul_ps(w, b);
+	for(int k=0;k<total;k++) {
+		acc[3*k]   = _mm_add_ps(acc[3*k],   _mm_mul_ps(basis[k], wr));
+		acc[3*k+1] = _mm_add_ps(acc[3*k+1], _mm_mul_ps(basis[k], wg));
+		acc[3*k+2] = _mm_add_ps(acc[3*k+2], _mm_mul_ps(basis[k], wb));
+	}
+	acc[SUMS-1] = _mm_add_ps(acc[SUMS-1], w);
+}
+
+//gathers the colours of up to 4 texels, missing lanes are zero
+static inline void LoadColours(const float* p, const int count, const int channels, __m128& r, __m128& g, __m128& b) {
+	float rgb[3][4] = {{0,0,0,0}, {0,0,0,0}, {0,0,0,0}};
+	for(int i=0;i<count;i++, p+=channels) {
+		rgb[0][i] = p[0];
+		rgb[1][i] = p[1];
+		rgb[2][i] = p[2];
+	}
+	r = _mm_loadu_ps(rgb[0]);
+	g = _mm_loadu_ps(rgb[1]);
+	b = _mm_loadu_ps(rgb[2]);
+}
+
+CSHProjector::CSHProjector(void)
+{
+	lastTime = 0;
+}
+
+CSHProjector::~CSHProjector(void)
+{
+	Destroy();
+}
+
+void CSHProjector::Init(int totalThreads) {
+	pool.Init(totalThreads);
+}
+
+void CSHProjector::Destroy() {
+	pool.Destroy();
+}
+
+void CSHProjector::ProjectRows(int task, void* data) {
+	Job& job = *(Job*)data;
+	__m128 acc[SUMS];
+	for(int i=0;i<SUMS;i++)
+		acc[i] = _mm_setzero_ps();
+
+	const __m128 lanes = _mm_set_ps(3, 2, 1, 0);
+	const int width = job.width;
+	int first = task*ROWS_PER_TASK;
+	int last = std::min(first+ROWS_PER_TASK, job.totalRows);
+
+	for(int row=first;row<last;row++) {
+		if(job.isCube) {
+			int face = row/job.height;
+			int j = row%job.height;
+			const float* src = job.faces[face] + size_t(j)*width*job.channels;
+			const float (*frame)[3] = FACE_FRAMES[face];
+			float step = 2.0f/width;
+			float t = (j+0.5f)*step-1;
+			//texel area on the face plane, projected onto the sphere below
+			__m128 area = _mm_set1_ps(step*step);
+			__m128 tt = _mm_set1_ps(t);
+			__m128 one = _mm_set1_ps(1);
+			for(int i=0;i<width;i+=4) {
+				int count = std::min(4, width-i);
+				__m128 s = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps(i+0.5f), lanes), _mm_set1_ps(step)), one);
+				__m128 x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(frame[0][0])), _mm_mul_ps(tt, _mm_set1_ps(frame[1][0]))), _mm_set1_ps(frame[2][0]));
+				__m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(frame[0][1])), _mm_mul_ps(tt, _mm_set1_ps(frame[1][1]))), _mm_set1_ps(frame[2][1]));
+				__m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(frame[0][2])), _mm_mul_ps(tt, _mm_set1_ps(frame[1][2]))), _mm_set1_ps(frame[2][2]));
+				__m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(one, _mm_add_ps(_mm_mul_ps(s, s), _mm_mul_ps(tt, tt)))));
+				x = _mm_mul_ps(x, invLength);
+				y = _mm_mul_ps(y, invLength);
+				z = _mm_mul_ps(z, invLength);
+				//solid angle dA/(1+s*s+t*t)^(3/2), zero for lanes past the row
+				__m128 w = _mm_mul_ps(area, _mm_mul_ps(invLength, _mm_mul_ps(invLength, invLength)));
+				w = _mm_and_ps(w, _mm_cmplt_ps(lanes, _mm_set1_ps(float(count))));
+				__m128 r, g, b;
+				LoadColours(src + size_t(i)*job.channels, count, job.channels, r, g, b);
+				Accumulate(x, y, z, w, r, g, b, job.order, acc);
+			}
+		} else {
+			const float* src = job.pixels + size_t(row)*width*job.channels;
+			float theta = PI*(row+0.5f)/job.height;
+			__m128 sinTheta = _mm_set1_ps(sin(theta));
+			__m128 y = _mm_set1_ps(cos(theta));
+			//solid angle of a texel, (2 pi/width)(pi/height)sin(theta)
+			__m128 w0 = _mm_set1_ps(2*PI*PI/(float(width)*job.height)*sin(theta));
+			for(int i=0;i<width;i+=4) {
+				int count = std::min(4, width-i);
+				//the angle tables are padded to a multiple of 4
+				__m128 x = _mm_mul_ps(sinTheta, _mm_loadu_ps(job.cosPhi+i));
+				__m128 z = _mm_mul_ps(sinTheta, _mm_loadu_ps(job.sinPhi+i));
+				__m128 w = _mm_and_ps(w0, _mm_cmplt_ps(lanes, _mm_set1_ps(float(count))));
+				__m128 r, g, b;
+				LoadColours(src + size_t(i)*job.channels, count, job.channels, r, g, b);
+				Accumulate(x, y, z, w, r, g, b, job.order, acc);
+			}
+		}
+	}
+
+	float* out = job.partials + size_t(task)*PARTIAL_STRIDE;
+	for(int i=0;i<SUMS;i++) {
+		float v[4];
+		_mm_storeu_ps(v, acc[i]);
+		out[i] = (v[0]+v[1])+(v[2]+v[3]);
+	}
+}
+
+void CSHProjector::Run(Job& job, const int totalRows, float* coeffs) {
+	CTimer timer;
+
+	int totalTasks = (totalRows+ROWS_PER_TASK-1)/ROWS_PER_TASK;
+	partials.assign(size_t(totalTasks)*PARTIAL_STRIDE, 0.0f);
+	job.totalRows = totalRows;
+	job.partials = &partials[0];
+	pool.Run(totalTasks, ProjectRows, &job);
+
+	//reduce the partial sums in task order so the result does not depend on
+	//the number of threads
+	double sums[SUMS] = {0};
+	for(int t=0;t<totalTasks;t++)
+		for(int i=0;i<SUMS;i++)
+			sums[i] += partials[size_t(t)*PARTIAL_STRIDE+i];
+
+	//the texel solid angles are approximate, so rescale them to cover
+	//exactly the 4 pi of the sphere
+	double scale = (sums[SUMS-1]>0)? 4*PI/sums[SUMS-1] : 0;
+	for(int i=0;i<job.order*job.order*3;i++)
+		coeffs[i] = float(sums[i]*scale);
+
+	lastTime = timer.Elapsed();
+}
+
+bool CSHProjector::ProjectCubeMap(const float* const faces[6], const int size, const int channels,
+								  const int order, float* coeffs) {
+	if(size<=0 || channels<3 || order<2 || order>MAX_ORDER)
+		return false;
+	for(int i=0;i<6;i++)
+		if(!faces[i])
+			return false;
+	Job job;
+	job.isCube = true;
+	job.faces = faces;
+	job.pixels = 0;
+	job.width = job.height = size;
+	job.channels = channels;
+	job.order = order;
+	job.cosPhi = job.sinPhi = 0;
+	Run(job, 6*size, coeffs);
+	return true;
+}
+
+bool CSHProjector::ProjectLatLong(const float* pixels, const int width, const int height, const int channels,
+								  const int order, float* coeffs) {
+	if(!pixels || width<=0 || height<=0 || channels<3 || order<2 || order>MAX_ORDER)
+		return false;
+	//the column angles are shared by all rows
+	size_t padded = (size_t(width)+3)&~size_t(3);
+	cosPhi.assign(padded, 0.0f);
+	sinPhi.assign(padded, 0.0f);
+	for(int i=0;i<width;i++) {
+		float phi = 2*PI*(i+0.5f)/width;
+		cosPhi[i] = cos(phi);
+		sinPhi[i] = sin(phi);
+	}
+	Job job;
+	job.isCube = false;
+	job.faces = 0;
+	job.pixels = pixels;
+	job.width = width;
+	job.height = height;
+	job.channels = channels;
+	job.order = order;
+	job.cosPhi = &cosPhi[0];
+	job.sinPhi = &sinPhi[0];
+	Run(job, height, coeffs);
+	return true;
+}
+
+void CSHProjector::EvaluateBasis(const float dir[3], const int order, float* basis) {
+	const float x = dir[0], y = dir[1], z = dir[2];
+	basis[0] = SH_C0;
+	basis[1] = SH_C1*y;
+	basis[2] = SH_C1*z;
+	basis[3] = SH_C1*x;
+	if(order<3)
+		return;
+	basis[4] = SH_C2*x*y;
+	basis[5] = SH_C2*y*z;
+	basis[6] = SH_C3*(3*z*z-1);
+	basis[7] = SH_C2*x*z;
+	basis[8] = SH_C4*(x*x-y*y);
+}
+
+void CSHProjector::Irradiance(const float* L, const float n[3], float rgb[3]) {
+	const float x = n[0], y = n[1], z = n[2];
+	for(int c=0;c<3;c++) {
+		rgb[c] = C1*L[8*3+c]*(x*x-y*y) + C3*L[6*3+c]*z*z + C4*L[c] - C5*L[6*3+c]
+			   + 2*C1*(L[4*3+c]*x*y + L[7*3+c]*x*z + L[5*3+c]*y*z)
+			   + 2*C2*(L[3*3+c]*x + L[1*3+c]*y + L[2*3+c]*z);
+	}
+}
+
+float CSHProjector::MaxIrradiance(const float* coeffs) {
+	//normals on a spherical Fibonacci lattice
+	const int TOTAL = 256;
+	float result = 0;
+	for(int i=0;i<TOTAL;i++) {
+		float z = 1-(2*i+1)/float(TOTAL);
+		float r = sqrt(std::max(0.0f, 1-z*z));
+		float phi = i*2.39996323f;
+		float n[3];
+		n[0] = r*cos(phi);
+		n[1] = r*sin(phi);
+		n[2] = z;
+		float rgb[3];
+		Irradiance(coeffs, n, rgb);
+		result = std::max(result, std::max(rgb[0], std::max(rgb[1], rgb[2])));
+	}
+	return result;
+}
+
+//converts one RGBE texel to floats
+static inline void RGBEToFloat(const unsigned char* rgbe, float* rgb) {
+	if(rgbe[3]==0) {
+		rgb[0] = rgb[1] = rgb[2] = 0;
+		return;
+	}
+	float f = ldexp(1.0f, int(rgbe[3])-(128+8));
+	rgb[0] = rgbe[0]*f;
+	rgb[1] = rgbe[1]*f;
+	rgb[2] = rgbe[2]*f;
+}
+
+bool CSHProjector::LoadHDR(const std::string& filename, std::vector<float>& pixels, int& width, int& height) {
+	FILE* fp = fopen(filename.c_str(), "rb");
+	if(!fp)
+		return false;
+
+	//the header is a list of text lines ended by an empty line
+	char line[256];
+	bool isRGBE = true;
+	if(!fgets(line, sizeof(line), fp) || strncmp(line, "#?", 2)!=0) {
+		fclose(fp);
+		return false;
+	}
+	while(fgets(line, sizeof(line), fp) && line[0]!='\n') {
+		if(strncmp(line, "FORMAT=", 7)==0)
+			isRGBE = strncmp(line+7, "32-bit_rle_rgbe", 15)==0;
+	}
+	//only the standard orientation is read
+	if(!isRGBE || !fgets(line, sizeof(line), fp) || sscanf(line, "-Y %d +X %d", &height, &width)!=2 ||
+	   width<=0 || height<=0 || width>32767 || height>32767) {
+		fclose(fp);
+		return false;
+	}
+
+	pixels.resize(size_t(width)*height*3);
+	std::vector<unsigned char> scanline(size_t(width)*4);
+	bool ok = true;
+	for(int j=0;j<height && ok;j++) {
+		unsigned char head[4];
+		if(fread(head, 1, 4, fp)!=4) {
+			ok = false;
+			break;
+		}
+		if(width<8 || width>0x7fff || head[0]!=2 || head[1]!=2 || (head[2]&0x80)) {
+			//flat scanline
+			memcpy(&scanline[0], head, 4);
+			ok = width==1 || fread(&scanline[4], 4, width-1, fp)==size_t(width-1);
+		} else {
+			//run length encoded scanline, the four components are stored
+			//one after the other
+			ok = ((head[2]<<8)|head[3])==width;
+			for(int c=0;c<4 && ok;c++) {
+				int i = 0;
+				while(i<width && ok) {
+					int count = fgetc(fp);
+					if(count==EOF) {
+						ok = false;
+					} else if(count>128) {
+						count -= 128;
+						int value = fgetc(fp);
+						ok = value!=EOF && i+count<=width;
+						for(int k=0;k<count && ok;k++)
+							scanline[(i++)*4+c] = (unsigned char)value;
+					} else {
+						ok = count>0 && i+count<=width;
+						for(int k=0;k<count && ok;k++) {
+							int value = fgetc(fp);
+							ok = value!=EOF;
+							scanline[(i++)*4+c] = (unsigned char)value;
+						}
+					}
+				}
+			}
+		}
+		for(int i=0;i<width && ok;i++)
+			RGBEToFloat(&scanline[size_t(i)*4], &pixels[(size_t(j)*width+i)*3]);
+	}
+	fclose(fp);
+	if(!ok)
+		pixels.clear();
+	return ok;
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "ThreadPool.h"
+
+//Projects environment maps onto the real spherical harmonics basis. Order 2
+//gives the 4 coefficients of bands 0-1, order 3 the 9 coefficients of bands
+//0-2 that the irradiance shaders use. The coefficients are RGB triples in the
+//order L00, L1-1, L10, L11, L2-2, L2-1, L20, L21, L22. The texel rows are
+//split over a thread pool and each task sums 4 texels at a time with SSE, so
+//an environment can be swapped and projected at runtime.
+class CSHProjector
+{
+public:
+	//largest supported order and the number of coefficients it has
+	static const int MAX_ORDER = 3;
+	static const int MAX_COEFFICIENTS = MAX_ORDER*MAX_ORDER;
+
+	CSHProjector(void);
+	~CSHProjector(void);
+
+	//starts the worker threads, 0 uses one thread per hardware thread
+	void Init(int totalThreads = 0);
+	void Destroy();
+
+	//faces are size x size float images with channels components per texel
+	//(3 or 4, alpha is ignored) in the GL face order +X,-X,+Y,-Y,+Z,-Z with
+	//the first row at the top of the face. coeffs receives order*order RGB
+	//triples.
+	bool ProjectCubeMap(const float* const faces[6], const int size, const int channels,
+						const int order, float* coeffs);
+
+	//a lat-long map has the +Y pole in its first row and the direction
+	//(sin(theta)cos(phi), cos(theta), sin(theta)sin(phi)) at column
+	//phi/(2 pi), row theta/pi
+	bool ProjectLatLong(const float* pixels, const int width, const int height, const int channels,
+						const int order, float* coeffs);
+
+	//time taken by the last projection in milliseconds
+	float GetLastTime() const { return lastTime; }
+
+	//evaluates the order*order basis functions (order 2 or 3) for a unit
+	//direction
+	static void EvaluateBasis(const float dir[3], const int order, float* basis);
+
+	//irradiance for a unit normal from 9 coefficients using the quadratic
+	//polynomial of Ramamoorthi and Hanrahan
+	static void Irradiance(const float* coeffs, const float n[3], float rgb[3]);
+
+	//largest irradiance over a set of normals, used to expose an environment
+	static float MaxIrradiance(const float* coeffs);
+
+	//loads a Radiance .hdr (RGBE) image into RGB floats, top row first. Flat
+	//and run length encoded scanlines are supported.
+	static bool LoadHDR(const std::string& filename, std::vector<float>& pixels, int& width, int& height);
+
+private:
+	CSHProjector(const CSHProjector&);
+	CSHProjector& operator=(const CSHProjector&);
+
+	struct Job;
+	static void ProjectRows(int task, void* data);
+	void Run(Job& job, const int totalRows, float* coeffs);
+
+	CThreadPool pool;
+	//per task partial sums, padded to separate cache lines
+	std::vector<float> partials;
+	std::vector<float> cosPhi, sinPhi;
+	float lastTime;
+};
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+
+//A fixed set of worker threads that run the tasks of a parallel loop. The
+//calling thread takes part in the work and Run returns once every task is
+//done, so a frame can be split into parallel steps without creating threads
+//every frame.
+class CThreadPool
+{
+public:
+	typedef void (*TaskFunction)(int task, void* data);
+
+	CThreadPool(void);
+	~CThreadPool(void);
+
+	//starts totalThreads-1 workers, 0 uses one thread per hardware thread
+	void Init(int totalThreads = 0);
+	void Destroy();
+
+	//number of threads working on a Run, including the caller
+	int GetTotalThreads() const { return int(workers.size())+1; }
+
+	//calls function(task, data) for every task in [0, totalTasks)
+	void Run(const int totalTasks, TaskFunction function, void* data);
+
+private:
+	//a worker thread and the auto reset event that starts its next Run
+	struct Worker {
+		CThreadPool* pool;
+		void* thread;
+		void* startEvent;
+	};
+
+	static unsigned int __stdcall WorkerLoop(void* param);
+	void RunTasks();
+
+	std::vector<Worker> workers;
+	//signalled by the last worker to finish a Run
+	void* doneEvent;
+	TaskFunction function;
+	void* data;
+	long totalTasks;
+	volatile long nextTask;
+	volatile long busyWorkers;
+	volatile long quit;
+};
\ No newline at end of file
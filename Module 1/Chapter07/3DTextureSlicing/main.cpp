@@ -33,8 +33,8 @@ CGrid* grid;
 //modelview and projection matrices
 glm::mat4 MV,P;
 
-//volume vertex array and buffer objects
-GLuint volumeVBO;
+//volume vertex array object. It has no buffers since the
+//slice polygons are generated in the vertex shader
 GLuint volumeVAO;
 
 //3D texture slicing shader
@@ -43,8 +43,12 @@ GLSLShader shader;
 //maximum number of slices
 const int MAX_SLICES = 512;
 
-//sliced vertices
-glm::vec3 vTextureSlices[MAX_SLICES*12];
+//edge start and direction vectors, lambda intersection values
+//and increments for the current view, passed to the vertex shader
+glm::vec3 vecStart[12];
+glm::vec3 vecDir[12];
+float lambda[12];
+float lambda_inc[12];
 
 //background colour
 glm::vec4 bg=glm::vec4(0.5,0.5,1,1);
@@ -185,7 +189,10 @@ int FindAbsMax(glm::vec3 v) {
 	return max_dim;
 }
 
-//main slicing function
+//main slicing function. It only sets up the intersection of the slice
+//planes with the 12 cube edges for the current view. The slice polygons
+//are generated from it in the vertex shader, so reslicing does not depend
+//on the number of slices.
 void SliceVolume() {
 
 	//get the max and min distance of each vertex of the unit cube
@@ -193,7 +200,6 @@ void SliceVolume() {
 	float max_dist = glm::dot(viewDir, vertexList[0]);
 	float min_dist = max_dist;
 	int max_index = 0;
-	int count = 0;
 
 	for(int i=1;i<8;i++) {
 		//get the distance between the current unit cube vertex and 
@@ -217,12 +223,6 @@ void SliceVolume() {
 	min_dist -= EPSILON;
 	max_dist += EPSILON;
 
-	//local variables to store the start, direction vectors, 
-	//lambda intersection values
-	glm::vec3 vecStart[12];
-	glm::vec3 vecDir[12];
-	float lambda[12];
-	float lambda_inc[12];
 	float denom = 0;
 
 	//set the minimum distance as the plane_dist
@@ -252,99 +252,6 @@ void SliceVolume() {
 			lambda_inc[i] =  0.0;
 		}
 	}
-
-	//local variables to store the intesected points
-	//note that for a plane and sub intersection, we can have 
-	//a minimum of 3 and a maximum of 6 vertex polygon
-	glm::vec3 intersection[6];
-	float dL[12];
-
-	//loop through all slices
-	for(int i=num_slices-1;i>=0;i--) {
-		
-		//determine the lambda value for all edges
-		for(int e = 0; e < 12; e++)
-		{
-			dL[e] = lambda[e] + i*lambda_inc[e];
-		}
-
-		//if the values are between 0-1, we have an intersection at the current edge
-		//repeat the same for all 12 edges
-		if  ((dL[0] >= 0.0) && (dL[0] < 1.0))	{
-			intersection[0] = vecStart[0] + dL[0]*vecDir[0];
-		}
-		else if ((dL[1] >= 0.0) && (dL[1] < 1.0))	{
-			intersection[0] = vecStart[1] + dL[1]*vecDir[1];
-		}
-		else if ((dL[3] >= 0.0) && (dL[3] < 1.0))	{
-			intersection[0] = vecStart[3] + dL[3]*vecDir[3];
-		}
-		else continue;
-
-		if ((dL[2] >= 0.0) && (dL[2] < 1.0)){
-			intersection[1] = vecStart[2] + dL[2]*vecDir[2];
-		}
-		else if ((dL[0] >= 0.0) && (dL[0] < 1.0)){
-			intersection[1] = vecStart[0] + dL[0]*vecDir[0];
-		}
-		else if ((dL[1] >= 0.0) && (dL[1] < 1.0)){
-			intersection[1] = vecStart[1] + dL[1]*vecDir[1];
-		} else {
-			intersection[1] = vecStart[3] + dL[3]*vecDir[3];
-		}
-
-		if  ((dL[4] >= 0.0) && (dL[4] < 1.0)){
-			intersection[2] = vecStart[4] + dL[4]*vecDir[4];
-		}
-		else if ((dL[5] >= 0.0) && (dL[5] < 1.0)){
-			intersection[2] = vecStart[5] + dL[5]*vecDir[5];
-		} else {
-			intersection[2] = vecStart[7] + dL[7]*vecDir[7];
-		}
-		if	((dL[6] >= 0.0) && (dL[6] < 1.0)){
-			intersection[3] = vecStart[6] + dL[6]*vecDir[6];
-		}
-		else if ((dL[4] >= 0.0) && (dL[4] < 1.0)){
-			intersection[3] = vecStart[4] + dL[4]*vecDir[4];
-		}
-		else if ((dL[5] >= 0.0) && (dL[5] < 1.0)){
-			intersection[3] = vecStart[5] + dL[5]*vecDir[5];
-		} else {
-			intersection[3] = vecStart[7] + dL[7]*vecDir[7];
-		}
-		if	((dL[8] >= 0.0) && (dL[8] < 1.0)){
-			intersection[4] = vecStart[8] + dL[8]*vecDir[8];
-		}
-		else if ((dL[9] >= 0.0) && (dL[9] < 1.0)){
-			intersection[4] = vecStart[9] + dL[9]*vecDir[9];
-		} else {
-			intersection[4] = vecStart[11] + dL[11]*vecDir[11];
-		}
-
-		if ((dL[10]>= 0.0) && (dL[10]< 1.0)){
-			intersection[5] = vecStart[10] + dL[10]*vecDir[10];
-		}
-		else if ((dL[8] >= 0.0) && (dL[8] < 1.0)){
-			intersection[5] = vecStart[8] + dL[8]*vecDir[8];
-		}
-		else if ((dL[9] >= 0.0) && (dL[9] < 1.0)){
-			intersection[5] = vecStart[9] + dL[9]*vecDir[9];
-		} else {
-			intersection[5] = vecStart[11] + dL[11]*vecDir[11];
-		}
-
-		//after all 6 possible intersection vertices are obtained,
-		//we calculated the proper polygon indices by using indices of a triangular fan
-		int indices[]={0,1,2, 0,2,3, 0,3,4, 0,4,5};
-
-		//Using the indices, pass the intersection vertices to the vTextureSlices vector
-		for(int i=0;i<12;i++)
-			vTextureSlices[count++]=intersection[indices[i]];
-	}
-
-	//update buffer object with the new vertices
-	glBindBuffer(GL_ARRAY_BUFFER, volumeVBO);
-	glBufferSubData(GL_ARRAY_BUFFER, 0,  sizeof(vTextureSlices), &(vTextureSlices[0].x));
 }
 
 //OpenGL initialization
@@ -365,8 +272,12 @@ void OnInit() {
 	shader.CreateAndLinkProgram();
 	shader.Use();
 		//add attributes and uniforms
-		shader.AddAttribute("vVertex");
 		shader.AddUniform("MVP");
+		shader.AddUniform("num_slices");
+		shader.AddUniform("vecStart");
+		shader.AddUniform("vecDir");
+		shader.AddUniform("lambda");
+		shader.AddUniform("lambda_inc");
 		shader.AddUniform("volume");
 		//pass constant uniforms at initialization
 		glUniform1i(shader("volume"),0);
@@ -393,23 +304,11 @@ void OnInit() {
 	//get the current view direction vector
 	viewDir = -glm::vec3(MV[0][2], MV[1][2], MV[2][2]);
 
-	//setup the vertex array and buffer objects
+	//setup the vertex array object, the core profile needs one bound to draw
+	//even though the vertex shader reads no attributes
 	glGenVertexArrays(1, &volumeVAO);
-	glGenBuffers(1, &volumeVBO);
-
-	glBindVertexArray(volumeVAO);
-	glBindBuffer (GL_ARRAY_BUFFER, volumeVBO);
-
-	//pass the sliced vertices vector to buffer object memory
-	glBufferData (GL_ARRAY_BUFFER, sizeof(vTextureSlices), 0, GL_DYNAMIC_DRAW);
 
 	GL_CHECK_ERRORS
-	
-	//enable vertex attribute array for position
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,0,0);
-
-	glBindVertexArray(0);
 
 	//slice the volume dataset initially
 	SliceVolume();
@@ -422,7 +321,6 @@ void OnShutdown() {
 	shader.DeleteShaderProgram();
 
 	glDeleteVertexArrays(1, &volumeVAO);
-	glDeleteBuffers(1, &volumeVBO);
 
 	glDeleteTextures(1, &textureID);
 	delete grid;
@@ -471,10 +369,15 @@ void OnRender() {
 	glBindVertexArray(volumeVAO);
 		//use the volume shader
 		shader.Use();
-			//pass the shader uniform
+			//pass the shader uniforms
 			glUniformMatrix4fv(shader("MVP"), 1, GL_FALSE, glm::value_ptr(MVP));
-				//draw the triangles
-				glDrawArrays(GL_TRIANGLES, 0, sizeof(vTextureSlices)/sizeof(vTextureSlices[0]));
+			glUniform1i(shader("num_slices"), num_slices);
+			glUniform3fv(shader("vecStart"), 12, &(vecStart[0].x));
+			glUniform3fv(shader("vecDir"), 12, &(vecDir[0].x));
+			glUniform1fv(shader("lambda"), 12, lambda);
+			glUniform1fv(shader("lambda_inc"), 12, lambda_inc);
+				//draw 12 vertices (4 triangles) per slice
+				glDrawArrays(GL_TRIANGLES, 0, num_slices*12);
 		//unbind the shader
 		shader.UnUse();
 
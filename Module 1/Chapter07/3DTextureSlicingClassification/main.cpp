@@ -7,7 +7,9 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "..\src\GLSLShader.h"
+#include "..\src\PreIntegrator.h"
 #include <fstream>
+#include <sstream>
 
 #define GL_CHECK_ERRORS assert(glGetError()== GL_NO_ERROR);
 
@@ -40,6 +42,9 @@ GLuint volumeVAO;
 //3D texture slicing shader
 GLSLShader shader;
 
+//3D texture slicing shader with pre-integrated classification
+GLSLShader preintShader;
+
 //maximum number of slices
 const int MAX_SLICES = 512;
 
@@ -66,6 +71,22 @@ GLuint textureID;
 //transfer function (lookup table) texture id
 GLuint tfTexID;
 
+//pre-integrated transfer function table texture id
+GLuint preintTexID;
+
+//pre-integrated table builder
+CPreIntegrator preIntegrator;
+
+//flag to use the pre-integrated table instead of the 1D lookup table
+bool bUsePreIntegration = true;
+
+//number of slices at which the transfer function opacities are given.
+//Pre-integration corrects the opacities for the actual slice spacing.
+const int REFERENCE_SLICES = 256;
+
+//distance between adjacent slices in object space
+float sliceSpacing = 0;
+
 //flag to see if the view is rotated
 //volume is resliced if the view is rotated
 bool bViewRotated = false;
@@ -104,6 +125,10 @@ const glm::vec4 jet_values[9]={	glm::vec4(0,0,0.5,0),
 								glm::vec4(1,0,0,0.5),
 								glm::vec4(0.5,0,0,0.0)};
 
+//editable transfer function control points and the currently selected one
+glm::vec4 controlPoints[9];
+int selectedPoint = 4;
+
 //current viewing direction
 glm::vec3 viewDir;
 
@@ -150,21 +175,20 @@ bool LoadVolume() {
 	}
 }
 
-//function to generate interpolated colours from the set of colour values (jet_values)
+//function to generate interpolated colours from the set of control points
 //this function first calculates the amount of increments for each component and the
 //index difference. Then it linearly interpolates the adjacent values to get the 
-//interpolated result.
-void LoadTransferFunction() {
-	float pData[256][4];
+//interpolated result. The entries after the last control point keep its value.
+void BuildTransferFunction(float pData[256][4]) {
 	int indices[9];
 
 	//fill the colour values at the place where the colour should be after interpolation
 	for(int i=0;i<9;i++) {
 		int index = i*28;
-		pData[index][0] = jet_values[i].x;
-		pData[index][1] = jet_values[i].y;
-		pData[index][2] = jet_values[i].z;
-		pData[index][3] = jet_values[i].w;
+		pData[index][0] = controlPoints[i].x;
+		pData[index][1] = controlPoints[i].y;
+		pData[index][2] = controlPoints[i].z;
+		pData[index][3] = controlPoints[i].w;
 		indices[i] = index;
 	}
 
@@ -190,6 +214,28 @@ void LoadTransferFunction() {
 		}
 	}
 
+	//fill the tail after the last control point
+	for(int i=indices[8]+1;i<256;i++) {
+		for(int c=0;c<4;c++)
+			pData[i][c] = pData[indices[8]][c];
+	}
+}
+
+//rebuilds the pre-integrated table for the current transfer function and
+//slice spacing and uploads it if anything changed
+void UpdatePreIntegration(float pData[256][4]) {
+	if(preIntegrator.Update(&pData[0][0], float(REFERENCE_SLICES)/num_slices)) {
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, preintTexID);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, CPreIntegrator::TABLE_SIZE, CPreIntegrator::TABLE_SIZE, GL_RGBA, GL_FLOAT, preIntegrator.GetTable());
+	}
+}
+
+//generates the transfer function (lookup table) texture and the pre-integrated table texture
+void LoadTransferFunction() {
+	float pData[256][4];
+	BuildTransferFunction(pData);
+
 	//generate the OpenGL texture
 	glGenTextures(1, &tfTexID);
 	//bind this texture to texture unit 1
@@ -205,6 +251,44 @@ void LoadTransferFunction() {
 	glTexImage1D(GL_TEXTURE_1D,0,GL_RGBA,256,0,GL_RGBA,GL_FLOAT,pData);
 	
 	GL_CHECK_ERRORS
+
+	//generate the pre-integrated table texture on texture unit 2, the
+	//front scalar selects the row and the back scalar the column
+	glGenTextures(1, &preintTexID);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, preintTexID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, CPreIntegrator::TABLE_SIZE, CPreIntegrator::TABLE_SIZE, 0, GL_RGBA, GL_FLOAT, 0);
+	UpdatePreIntegration(pData);
+
+	GL_CHECK_ERRORS
+}
+
+//rebuilds the transfer function after a control point or the number of
+//slices changed. Only the changed part of the pre-integrated table is
+//recomputed.
+void UpdateTransferFunction() {
+	float pData[256][4];
+	BuildTransferFunction(pData);
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_1D, tfTexID);
+	glTexSubImage1D(GL_TEXTURE_1D, 0, 0, 256, GL_RGBA, GL_FLOAT, pData);
+
+	UpdatePreIntegration(pData);
+}
+
+//shows the current mode, slice count and the last table update time in the title bar
+void UpdateTitle() {
+	std::stringstream str;
+	str<<"Volume Rendering using 3D Texture Slicing - "<<(bUsePreIntegration ? "Pre-integrated" : "Post-classified");
+	str<<", Slices: "<<num_slices;
+	str<<", Point: "<<selectedPoint+1<<" (alpha "<<controlPoints[selectedPoint].w<<")";
+	str<<", Table update: "<<preIntegrator.GetLastTime()<<" ms ("<<preIntegrator.GetLastEntries()<<" entries)";
+	glutSetWindowTitle(str.str().c_str());
 }
 
 //mouse down event handler
@@ -299,6 +383,7 @@ void SliceVolume() {
 	//to get the plane increment
 	float plane_dist = min_dist;
 	float plane_dist_inc = (max_dist-min_dist)/float(num_slices);
+	sliceSpacing = plane_dist_inc;
 
 	//for all edges
 	for(int i=0;i<12;i++) {
@@ -446,6 +531,25 @@ void OnInit() {
 		glUniform1i(shader("lut"),1);
 	shader.UnUse();
 
+	//Load the pre-integrated texture slicing shader
+	preintShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/textureSlicer.vert");
+	preintShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/textureSlicerPreint.frag");
+
+	//compile and link the shader
+	preintShader.CreateAndLinkProgram();
+	preintShader.Use();
+		//add attributes and uniforms
+		preintShader.AddAttribute("vVertex");
+		preintShader.AddUniform("MVP");
+		preintShader.AddUniform("volume");
+		preintShader.AddUniform("preintTable");
+		preintShader.AddUniform("sliceOffset");
+
+		//the volume is on texture unit 0 and the pre-integrated table on unit 2
+		glUniform1i(preintShader("volume"),0);
+		glUniform1i(preintShader("preintTable"),2);
+	preintShader.UnUse();
+
 	GL_CHECK_ERRORS
 
 	//load volume data and generate the volume texture
@@ -457,6 +561,8 @@ void OnInit() {
 	}
 
 	//load the transfer function data and generate the trasnfer function (lookup table) texture
+	for(int i=0;i<9;i++)
+		controlPoints[i] = jet_values[i];
 	LoadTransferFunction();
 
 	//set background colour
@@ -490,18 +596,21 @@ void OnInit() {
 
 	//slice the volume dataset initially
 	SliceVolume();
+	UpdateTitle();
 	cout<<"Initialization successfull"<<endl;
 }
 
 //release all allocated resources
 void OnShutdown() {
 	shader.DeleteShaderProgram();
+	preintShader.DeleteShaderProgram();
 
 	glDeleteVertexArrays(1, &volumeVAO);
 	glDeleteBuffers(1, &volumeVBO);
 
 	glDeleteTextures(1, &textureID);
 	glDeleteTextures(1, &tfTexID);
+	glDeleteTextures(1, &preintTexID);
 
 	delete grid;
 	cout<<"Shutdown successfull"<<endl;
@@ -548,14 +657,24 @@ void OnRender() {
 
 	//bind volume vertex array object
 	glBindVertexArray(volumeVAO);
-		//use the volume shader
-		shader.Use();
-			//pass the shader uniform
-			glUniformMatrix4fv(shader("MVP"), 1, GL_FALSE, glm::value_ptr(MVP));
-				//draw the triangles
-				glDrawArrays(GL_TRIANGLES, 0, sizeof(vTextureSlices)/sizeof(vTextureSlices[0]));
-		//unbind the shader
-		shader.UnUse();
+		if(bUsePreIntegration) {
+			//use the pre-integrated shader, each fragment also samples the
+			//volume where the slab ends on the next slice away from the viewer
+			preintShader.Use();
+				glUniformMatrix4fv(preintShader("MVP"), 1, GL_FALSE, glm::value_ptr(MVP));
+				glUniform3fv(preintShader("sliceOffset"), 1, glm::value_ptr(viewDir*sliceSpacing));
+					glDrawArrays(GL_TRIANGLES, 0, sizeof(vTextureSlices)/sizeof(vTextureSlices[0]));
+			preintShader.UnUse();
+		} else {
+			//use the volume shader
+			shader.Use();
+				//pass the shader uniform
+				glUniformMatrix4fv(shader("MVP"), 1, GL_FALSE, glm::value_ptr(MVP));
+					//draw the triangles
+					glDrawArrays(GL_TRIANGLES, 0, sizeof(vTextureSlices)/sizeof(vTextureSlices[0]));
+			//unbind the shader
+			shader.UnUse();
+		}
 
 	//disable blending
 	glDisable(GL_BLEND);
@@ -564,7 +683,8 @@ void OnRender() {
 	glutSwapBuffers();
 }
 
-//keyboard function to change the number of slices
+//keyboard function to change the number of slices, toggle pre-integration
+//and edit the opacity of the selected transfer function control point
 void OnKey(unsigned char key, int x, int y) {
 	switch(key) {
 		case '-':
@@ -574,6 +694,24 @@ void OnKey(unsigned char key, int x, int y) {
 		case '+':
 			num_slices++;
 			break;
+
+		case 'p':
+			bUsePreIntegration = !bUsePreIntegration;
+			break;
+
+		case '[':
+			controlPoints[selectedPoint].w = max(0.0f, controlPoints[selectedPoint].w-0.05f);
+			break;
+
+		case ']':
+			controlPoints[selectedPoint].w = min(1.0f, controlPoints[selectedPoint].w+0.05f);
+			break;
+
+		default:
+			//1-9 select a control point
+			if(key>='1' && key<='9')
+				selectedPoint = key-'1';
+			break;
 	}
 	//check the range of num_slices variable
 	num_slices = min(MAX_SLICES, max(num_slices,3));
@@ -581,6 +719,11 @@ void OnKey(unsigned char key, int x, int y) {
 	//slice the volume
 	SliceVolume();
 
+	//update the lookup tables, this does nothing if the transfer function
+	//and the number of slices are unchanged
+	UpdateTransferFunction();
+	UpdateTitle();
+
 	//recall display function
 	glutPostRedisplay();
 }
@@ -0,0 +1,28 @@
+#version 330 core
+
+layout(location = 0) out vec4 vFragColor;	//fragment shader output
+
+smooth in vec3 vUV;			//3D texture coordinates form vertex shader interpolated by rasterizer
+
+//uniforms
+uniform sampler3D volume;		//volume dataset
+uniform sampler2D preintTable;	//pre-integrated transfer function table
+uniform vec3 sliceOffset;		//offset to the next slice away from the viewer in texture space
+
+//size of the pre-integrated table
+const float TABLE_SIZE = 256.0;
+
+void main()
+{
+	//The slab between this slice and the next one away from the viewer is
+	//classified by the scalars at its front and back. The table holds the
+	//transfer function integrated between the two scalars, so sharp features
+	//of the transfer function that fall between the samples are not missed.
+	float front = texture(volume, vUV).r;
+	float back  = texture(volume, vUV + sliceOffset).r;
+
+	//map the scalars to the texel centres of the table, the front scalar
+	//selects the row and the back scalar the column
+	vec2 uv = vec2(back, front)*((TABLE_SIZE-1.0)/TABLE_SIZE) + 0.5/TABLE_SIZE;
+	vFragColor = texture(preintTable, uv);
+}
\ No newline at end of file
@@ -8,6 +8,9 @@
 
 #include "..\src\GLSLShader.h"
 #include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
 
 #define GL_CHECK_ERRORS assert(glGetError()== GL_NO_ERROR);
 
@@ -54,6 +57,103 @@ const int ZDIM = 256;
 //volume texture ID
 GLuint textureID;
 
+//edge length of the bricks of the distance map in voxels
+const int BRICK_SIZE = 8;
+//voxel values up to this are fully transparent and count as empty space
+const int EMPTY_VALUE = 2;
+//distance map texture ID
+GLuint distanceMapID;
+//fraction of the bricks that are occupied
+float occupiedFraction = 1;
+
+//flags for empty space skipping and jittered ray starts
+bool bUseSkipping = true;
+bool bUseJitter = true;
+//ray step size in voxels
+float stepScale = 1.0f;
+
+//timer query ID for measuring the ray casting time
+GLuint queryID;
+
+//builds a map with one texel per brick of BRICK_SIZE^3 voxels holding the
+//chessboard distance, in bricks, to the nearest occupied brick. A brick
+//is occupied if any voxel that trilinear filtering inside it can reach is
+//above EMPTY_VALUE, so 0 marks occupied bricks and a value d tells the ray
+//caster that it can skip every brick within d-1 bricks.
+void BuildDistanceMap(const GLubyte* pData) {
+	const int BX = (XDIM+BRICK_SIZE-1)/BRICK_SIZE;
+	const int BY = (YDIM+BRICK_SIZE-1)/BRICK_SIZE;
+	const int BZ = (ZDIM+BRICK_SIZE-1)/BRICK_SIZE;
+	const int total = BX*BY*BZ;
+
+	//find the occupied bricks, including a one voxel border
+	std::vector<int> distance(total, -1);
+	std::vector<int> queue;
+	queue.reserve(total);
+	for(int bz=0;bz<BZ;bz++) {
+		for(int by=0;by<BY;by++) {
+			for(int bx=0;bx<BX;bx++) {
+				int x0 = max(bx*BRICK_SIZE-1, 0), x1 = min((bx+1)*BRICK_SIZE+1, XDIM);
+				int y0 = max(by*BRICK_SIZE-1, 0), y1 = min((by+1)*BRICK_SIZE+1, YDIM);
+				int z0 = max(bz*BRICK_SIZE-1, 0), z1 = min((bz+1)*BRICK_SIZE+1, ZDIM);
+				bool occupied = false;
+				for(int z=z0;z<z1 && !occupied;z++)
+					for(int y=y0;y<y1 && !occupied;y++) {
+						const GLubyte* row = pData + (size_t(z)*YDIM + y)*XDIM;
+						for(int x=x0;x<x1;x++) {
+							if(row[x]>EMPTY_VALUE) {
+								occupied = true;
+								break;
+							}
+						}
+					}
+				if(occupied) {
+					int index = (bz*BY + by)*BX + bx;
+					distance[index] = 0;
+					queue.push_back(index);
+				}
+			}
+		}
+	}
+	occupiedFraction = float(queue.size())/total;
+
+	//breadth first search over the 26 neighbours gives the chessboard distance
+	for(size_t head=0;head<queue.size();head++) {
+		int index = queue[head];
+		int bx = index%BX, by = (index/BX)%BY, bz = index/(BX*BY);
+		for(int dz=-1;dz<=1;dz++)
+			for(int dy=-1;dy<=1;dy++)
+				for(int dx=-1;dx<=1;dx++) {
+					int x = bx+dx, y = by+dy, z = bz+dz;
+					if(x<0 || y<0 || z<0 || x>=BX || y>=BY || z>=BZ)
+						continue;
+					int neighbour = (z*BY + y)*BX + x;
+					if(distance[neighbour]<0) {
+						distance[neighbour] = distance[index]+1;
+						queue.push_back(neighbour);
+					}
+				}
+	}
+
+	//an empty volume has no occupied brick, so everything can be skipped
+	std::vector<GLubyte> map(total);
+	for(int i=0;i<total;i++)
+		map[i] = GLubyte(distance[i]<0 ? 255 : min(distance[i], 255));
+
+	glGenTextures(1, &distanceMapID);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_3D, distanceMapID);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_R8UI, BX, BY, BZ, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &map[0]);
+	glActiveTexture(GL_TEXTURE0);
+	GL_CHECK_ERRORS
+}
+
 //function that load a volume from the given raw data file and 
 //generates an OpenGL 3D texture from it
 bool LoadVolume() {
@@ -87,6 +187,9 @@ bool LoadVolume() {
 		//generate mipmaps
 		glGenerateMipmap(GL_TEXTURE_3D);
 
+		//build the empty space map for skipping
+		BuildDistanceMap(pData);
+
 		//delete the volume data allocated on heap
 		delete [] pData;
 
@@ -149,10 +252,19 @@ void OnInit() {
 		shader.AddUniform("volume");
 		shader.AddUniform("camPos");
 		shader.AddUniform("step_size");
+		shader.AddUniform("maxSamples");
+		shader.AddUniform("stepScale");
+		shader.AddUniform("distanceMap");
+		shader.AddUniform("brickSize");
+		shader.AddUniform("emptyThreshold");
+		shader.AddUniform("useSkipping");
+		shader.AddUniform("useJitter");
 
 		//pass constant uniforms at initialization
-		glUniform3f(shader("step_size"), 1.0f/XDIM, 1.0f/YDIM, 1.0f/ZDIM);
 		glUniform1i(shader("volume"),0);
+		glUniform1i(shader("distanceMap"),1);
+		glUniform3f(shader("brickSize"), float(BRICK_SIZE)/XDIM, float(BRICK_SIZE)/YDIM, float(BRICK_SIZE)/ZDIM);
+		glUniform1f(shader("emptyThreshold"), (EMPTY_VALUE+0.5f)/255.0f);
 	shader.UnUse();
 
 	GL_CHECK_ERRORS
@@ -165,6 +277,9 @@ void OnInit() {
 		exit(EXIT_FAILURE);
 	}
 
+	//generate the timer query
+	glGenQueries(1, &queryID);
+
 	//set background colour
 	glClearColor(bg.r, bg.g, bg.b, bg.a);
 	
@@ -229,6 +344,8 @@ void OnShutdown() {
 	glDeleteBuffers(1, &cubeIndicesID);
 
 	glDeleteTextures(1, &textureID);
+	glDeleteTextures(1, &distanceMapID);
+	glDeleteQueries(1, &queryID);
 	delete grid;
 	cout<<"Shutdown successfull"<<endl;
 }
@@ -271,17 +388,48 @@ void OnRender() {
 			//pass shader uniforms
 			glUniformMatrix4fv(shader("MVP"), 1, GL_FALSE, glm::value_ptr(MVP));
 			glUniform3fv(shader("camPos"), 1, &(camPos.x));
-				//render the cube
+			//every iteration advances the ray by at least one step, so the
+			//loop needs the volume diagonal (sqrt(3) in texture space) over
+			//the step plus one for the jittered start
+			float stepSize = stepScale/max(XDIM, max(YDIM, ZDIM));
+			glUniform1f(shader("step_size"), stepSize);
+			glUniform1i(shader("maxSamples"), int(ceil(sqrt(3.0f)/stepSize))+1);
+			glUniform1f(shader("stepScale"), stepScale);
+			glUniform1i(shader("useSkipping"), bUseSkipping);
+			glUniform1i(shader("useJitter"), bUseJitter);
+				//render the cube and time it
+				glBeginQuery(GL_TIME_ELAPSED, queryID);
 				glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_SHORT, 0);
+				glEndQuery(GL_TIME_ELAPSED);
 		//unbind the raycasting shader
 		shader.UnUse();
 	//disable blending
 	glDisable(GL_BLEND);
 
+	//show the ray casting time and settings in the title
+	GLuint64 elapsed = 0;
+	glGetQueryObjectui64v(queryID, GL_QUERY_RESULT, &elapsed);
+	std::stringstream title;
+	title<<"GPU Ray Casting: "<<elapsed/1000000.0<<" ms, step "<<stepScale<<" voxel(s), skipping "
+		 <<(bUseSkipping ? "on" : "off")<<" ("<<int(occupiedFraction*100)<<"% bricks occupied), jitter "
+		 <<(bUseJitter ? "on" : "off");
+	glutSetWindowTitle(title.str().c_str());
+
 	//swap front and back buffers to show the rendered result
 	glutSwapBuffers();
 }
 
+//keyboard event handler to change the ray marching settings
+void OnKey(unsigned char key, int x, int y) {
+	switch(key) {
+		case 's': bUseSkipping = !bUseSkipping; break;
+		case 'j': bUseJitter = !bUseJitter; break;
+		case '+': stepScale = min(stepScale*1.25f, 8.0f); break;
+		case '-': stepScale = max(stepScale/1.25f, 0.25f); break;
+	}
+	glutPostRedisplay();
+}
+
 int main(int argc, char** argv) {
 	//freeglut initialization
 	glutInit(&argc, argv);
@@ -323,6 +471,7 @@ int main(int argc, char** argv) {
 	glutReshapeFunc(OnResize);
 	glutMouseFunc(OnMouseDown);
 	glutMotionFunc(OnMouseMove);
+	glutKeyboardFunc(OnKey);
 
 	//main loop call
 	glutMainLoop();
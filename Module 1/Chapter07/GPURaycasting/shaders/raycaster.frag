@@ -7,66 +7,83 @@ smooth in vec3 vUV;				//3D texture coordinates form vertex shader
 
 //uniforms
 uniform sampler3D	volume;		//volume dataset
+uniform usampler3D	distanceMap;	//per brick chessboard distance to the nearest occupied brick
 uniform vec3		camPos;		//camera position
-uniform vec3		step_size;	//ray step size 
+uniform float		step_size;	//ray step size in texture space
+uniform int			maxSamples;	//loop bound, enough steps to cross the volume diagonal
+uniform float		stepScale;	//step size relative to one voxel, for opacity correction
+uniform vec3		brickSize;	//size of a distance map brick in texture space
+uniform float		emptyThreshold;	//samples below this value are transparent
+uniform bool		useSkipping;	//skip empty bricks using the distance map
+uniform bool		useJitter;		//jitter the ray start per pixel
 
 //constants
-const int MAX_SAMPLES = 300;	//total samples for each ray march step
 const vec3 texMin = vec3(0);	//minimum texture access coordinate
 const vec3 texMax = vec3(1);	//maximum texture access coordinate
 
+//returns pseudo random number
+float rand(vec2 co){
+    return fract(sin(dot(co.xy ,vec2(12.9898,78.233))) * 43758.5453);
+}
+
 void main()
 { 
-	//get the 3D texture coordinates for lookup into the volume dataset
-	vec3 dataPos = vUV;
-
 	//Getting the ray marching direction:
 	//get the object space position by subracting 0.5 from the
 	//3D texture coordinates. Then subtraact it from camera position
 	//and normalize to get the ray marching direction
 	vec3 geomDir = normalize((vUV-vec3(0.5)) - camPos); 
 
-	//multiply the raymarching direction with the step size to get the
-	//sub-step size we need to take at each raymarching step
-	vec3 dirStep = geomDir * step_size; 
-	 
-	//flag to indicate if the raymarch loop should terminate
-	bool stop = false; 
+	//distance to where the ray leaves the volume (slab test against the
+	//texture space box, the ray starts on its front face)
+	vec3 invDir = 1.0/max(abs(geomDir), vec3(1e-6)) * sign(geomDir);
+	vec3 tExit = max((texMin-vUV)*invDir, (texMax-vUV)*invDir);
+	float tFar = min(min(tExit.x, tExit.y), tExit.z);
+
+	//samples are taken at t = (k + offset)*step_size. A per pixel offset
+	//turns the wood grain banding of large steps into noise.
+	float offset = useJitter ? rand(gl_FragCoord.xy) : 1.0;
+	float t = offset*step_size;
+
+	vFragColor = vec4(0);
 
 	//for all samples along the ray
-	for (int i = 0; i < MAX_SAMPLES; i++) {
-		// advance ray by dirstep
-		dataPos = dataPos + dirStep;
-		
-		
-		//The two constants texMin and texMax have a value of vec3(-1,-1,-1)
-		//and vec3(1,1,1) respectively. To determine if the data value is 
-		//outside the volume data, we use the sign function. The sign function 
-		//return -1 if the value is less than 0, 0 if the value is equal to 0 
-		//and 1 if value is greater than 0. Hence, the sign function for the 
-		//calculation (sign(dataPos-texMin) and sign (texMax-dataPos)) will 
-		//give us vec3(1,1,1) at the possible minimum and maximum position. 
-		//When we do a dot product between two vec3(1,1,1) we get the answer 3. 
-		//So to be within the dataset limits, the dot product will return a 
-		//value less than 3. If it is greater than 3, we are already out of 
-		//the volume dataset
-		stop = dot(sign(dataPos-texMin),sign(texMax-dataPos)) < 3.0;
+	for (int i = 0; i < maxSamples && t < tFar; i++) {
+		vec3 dataPos = vUV + geomDir*t;
+
+		//empty space skipping: every brick within a chessboard distance of
+		//d-1 bricks is empty, so the ray can jump to where it leaves that
+		//block of bricks and continue on the sample lattice after it
+		if(useSkipping) {
+			ivec3 brick = ivec3(dataPos/brickSize);
+			uint d = texelFetch(distanceMap, clamp(brick, ivec3(0), textureSize(distanceMap, 0)-1), 0).r;
+			if(d > 0u) {
+				vec3 lower = (vec3(brick) - float(d) + 1.0)*brickSize;
+				vec3 upper = (vec3(brick) + float(d))*brickSize;
+				vec3 tBlock = max((lower-dataPos)*invDir, (upper-dataPos)*invDir);
+				float tSkip = min(min(tBlock.x, tBlock.y), tBlock.z);
+				float next = (ceil((t + tSkip)/step_size - offset) + offset)*step_size;
+				t = max(next, t + step_size);
+				continue;
+			}
+		}
+
+		t += step_size;
 
-		//if the stopping condition is true we brek out of the ray marching loop
-		if (stop) 
-			break;
-		
 		// data fetching from the red channel of volume texture
-		float sample = texture(volume, dataPos).r;	
-		
+		float sample = textureLod(volume, dataPos, 0).r;	
+		if(sample < emptyThreshold)
+			continue;
+
+		//correct the opacity for the step size so that the image does not
+		//get more opaque as the step grows
+		float alpha = 1.0 - pow(1.0 - sample, stepScale);
+
 		//Opacity calculation using compositing:
 		//here we use front to back compositing scheme whereby the current sample
-		//value is multiplied to the currently accumulated alpha and then this product
-		//is subtracted from the sample value to get the alpha from the previous steps.
-		//Next, this alpha is multiplied with the current sample colour and accumulated
-		//to the composited colour. The alpha value from the previous steps is then 
-		//accumulated to the composited colour alpha.
-		float prev_alpha = sample - (sample * vFragColor.a);
+		//alpha is multiplied to the remaining transparency and then this product
+		//is accumulated to the composited colour and alpha.
+		float prev_alpha = alpha - (alpha * vFragColor.a);
 		vFragColor.rgb = prev_alpha * vec3(sample) + vFragColor.rgb; 
 		vFragColor.a += prev_alpha; 
 			
@@ -33,8 +33,8 @@ CGrid* grid;
 //modelview and projection matrices
 glm::mat4 MV,P;
 
-//volume vertex array and buffer objects
-GLuint volumeVBO;
+//volume vertex array object. It has no buffers since the
+//slice polygons are generated in the vertex shader
 GLuint volumeVAO;
 
 //3D texture slicing shader, shadowShader, flatShader and quadShader
@@ -43,8 +43,13 @@ GLSLShader shader, shaderShadow, flatShader, quadShader;
 //maximum number of slices
 const int MAX_SLICES = 512;
 
-//sliced vertices
-glm::vec3 vTextureSlices[MAX_SLICES*12];
+//edge start and direction vectors, lambda intersection values
+//and increments for the current half angle vector, passed to
+//the vertex shaders
+glm::vec3 vecStart[12];
+glm::vec3 vecDir[12];
+float lambda[12];
+float lambda_inc[12];
  
 //volume data files
 const std::string volume_file = "../media/Engine256.raw";
@@ -329,14 +334,16 @@ int FindAbsMax(glm::vec3 v) {
 	return max_dim;
 }
 
-//main slicing function
+//main slicing function. It only sets up the intersection of the slice
+//planes with the 12 cube edges for the current half angle vector. The
+//slice polygons are generated from it in the vertex shaders, so reslicing
+//does not depend on the number of slices.
 void SliceVolume() {
 	//get the max and min distance of each vertex of the unit cube 
 	//in the viewing direction
 	float max_dist = glm::dot(halfVec, vertexList[0]);
 	float min_dist = max_dist;
 	int max_index = 0;
-	int count = 0;
 
 	for(int i=1;i<8;i++) {
 		//get the distance between the current unit cube vertex and 
@@ -361,12 +368,6 @@ void SliceVolume() {
 	min_dist -= EPSILON;
 	max_dist += EPSILON;
 
-	//local variables to store the start, direction vectors, 
-	//lambda intersection values
-	glm::vec3 vecStart[12];
-	glm::vec3 vecDir[12];
-	float lambda[12];
-	float lambda_inc[12];
 	float denom = 0;
 
 	//set the minimum distance as the plane_dist
@@ -396,99 +397,15 @@ void SliceVolume() {
 			lambda_inc[i] =  0.0;
 		}
 	}
+}
 
-	//local variables to store the intesected points
-	//note that for a plane and sub intersection, we can have 
-	//a minimum of 3 and a maximum of 6 vertex polygon
-	glm::vec3 intersection[6];
-	float dL[12];
-
-	//loop through all slices
-	for(int i=num_slices-1;i>=0;i--) {
-
-		//determine the lambda value for all edges
-		for(int e = 0; e < 12; e++)
-		{
-			dL[e] = lambda[e] + i*lambda_inc[e];
-		}
-
-		//if the values are between 0-1, we have an intersection at the current edge
-		//repeat the same for all 12 edges
-		if  ((dL[0] >= 0.0) && (dL[0] < 1.0))	{
-			intersection[0] = vecStart[0] + dL[0]*vecDir[0];
-		}
-		else if ((dL[1] >= 0.0) && (dL[1] < 1.0))	{
-			intersection[0] = vecStart[1] + dL[1]*vecDir[1];
-		}
-		else if ((dL[3] >= 0.0) && (dL[3] < 1.0))	{
-			intersection[0] = vecStart[3] + dL[3]*vecDir[3];
-		}
-		else continue;
-
-		if ((dL[2] >= 0.0) && (dL[2] < 1.0)){
-			intersection[1] = vecStart[2] + dL[2]*vecDir[2];
-		}
-		else if ((dL[0] >= 0.0) && (dL[0] < 1.0)){
-			intersection[1] = vecStart[0] + dL[0]*vecDir[0];
-		}
-		else if ((dL[1] >= 0.0) && (dL[1] < 1.0)){
-			intersection[1] = vecStart[1] + dL[1]*vecDir[1];
-		} else {
-			intersection[1] = vecStart[3] + dL[3]*vecDir[3];
-		}
-
-		if  ((dL[4] >= 0.0) && (dL[4] < 1.0)){
-			intersection[2] = vecStart[4] + dL[4]*vecDir[4];
-		}
-		else if ((dL[5] >= 0.0) && (dL[5] < 1.0)){
-			intersection[2] = vecStart[5] + dL[5]*vecDir[5];
-		} else {
-			intersection[2] = vecStart[7] + dL[7]*vecDir[7];
-		}
-		if	((dL[6] >= 0.0) && (dL[6] < 1.0)){
-			intersection[3] = vecStart[6] + dL[6]*vecDir[6];
-		}
-		else if ((dL[4] >= 0.0) && (dL[4] < 1.0)){
-			intersection[3] = vecStart[4] + dL[4]*vecDir[4];
-		}
-		else if ((dL[5] >= 0.0) && (dL[5] < 1.0)){
-			intersection[3] = vecStart[5] + dL[5]*vecDir[5];
-		} else {
-			intersection[3] = vecStart[7] + dL[7]*vecDir[7];
-		}
-		if	((dL[8] >= 0.0) && (dL[8] < 1.0)){
-			intersection[4] = vecStart[8] + dL[8]*vecDir[8];
-		}
-		else if ((dL[9] >= 0.0) && (dL[9] < 1.0)){
-			intersection[4] = vecStart[9] + dL[9]*vecDir[9];
-		} else {
-			intersection[4] = vecStart[11] + dL[11]*vecDir[11];
-		}
-
-		if ((dL[10]>= 0.0) && (dL[10]< 1.0)){
-			intersection[5] = vecStart[10] + dL[10]*vecDir[10];
-		}
-		else if ((dL[8] >= 0.0) && (dL[8] < 1.0)){
-			intersection[5] = vecStart[8] + dL[8]*vecDir[8];
-		}
-		else if ((dL[9] >= 0.0) && (dL[9] < 1.0)){
-			intersection[5] = vecStart[9] + dL[9]*vecDir[9];
-		} else {
-			intersection[5] = vecStart[11] + dL[11]*vecDir[11];
-		}
-
-		//after all 6 possible intersection vertices are obtained,
-		//we calculated the proper polygon indices by using indices of a triangular fan
-		int indices[]={0,1,2, 0,2,3, 0,3,4, 0,4,5};
-
-		//Using the indices, pass the intersection vertices to the vTextureSlices vector
-		for(int i=0;i<12;i++)
-			vTextureSlices[count++]=intersection[indices[i]];
-	}
-
-	//update buffer object with the new vertices
-	glBindBuffer(GL_ARRAY_BUFFER, volumeVBO);
-	glBufferSubData(GL_ARRAY_BUFFER, 0,  sizeof(vTextureSlices), &(vTextureSlices[0].x));
+//passes the slicing setup to the given shader, which must be in use
+void SetSliceUniforms(GLSLShader& slicer) {
+	glUniform1i(slicer("num_slices"), num_slices);
+	glUniform3fv(slicer("vecStart"), 12, &(vecStart[0].x));
+	glUniform3fv(slicer("vecDir"), 12, &(vecDir[0].x));
+	glUniform1fv(slicer("lambda"), 12, lambda);
+	glUniform1fv(slicer("lambda_inc"), 12, lambda_inc);
 }
 
 //OpenGL initialization
@@ -509,8 +426,12 @@ void OnInit() {
 	shader.CreateAndLinkProgram();
 	shader.Use();
 		//add attributes and uniforms
-		shader.AddAttribute("vVertex");
 		shader.AddUniform("MVP");
+		shader.AddUniform("num_slices");
+		shader.AddUniform("vecStart");
+		shader.AddUniform("vecDir");
+		shader.AddUniform("lambda");
+		shader.AddUniform("lambda_inc");
 		shader.AddUniform("color");
 		shader.AddUniform("volume");
 
@@ -530,8 +451,12 @@ void OnInit() {
 	shaderShadow.CreateAndLinkProgram();
 	shaderShadow.Use();
 		//add attributes and uniforms
-		shaderShadow.AddAttribute("vVertex");
 		shaderShadow.AddUniform("MVP");
+		shaderShadow.AddUniform("num_slices");
+		shaderShadow.AddUniform("vecStart");
+		shaderShadow.AddUniform("vecDir");
+		shaderShadow.AddUniform("lambda");
+		shaderShadow.AddUniform("lambda_inc");
 		shaderShadow.AddUniform("S");
 		shaderShadow.AddUniform("color");
 		shaderShadow.AddUniform("shadowTex");
@@ -584,23 +509,12 @@ void OnInit() {
 		exit(EXIT_FAILURE);
 	}
 
-	//setup the vertex array and buffer objects
+	//setup the vertex array object, the core profile needs one bound to draw
+	//even though the slicing vertex shaders read no attributes
 	glGenVertexArrays(1, &volumeVAO);
-	glGenBuffers(1, &volumeVBO);
-
-	glBindVertexArray(volumeVAO);
-	glBindBuffer (GL_ARRAY_BUFFER, volumeVBO);
-	//pass the sliced vertices vector to buffer object memory
-	glBufferData (GL_ARRAY_BUFFER, sizeof(vTextureSlices), 0, GL_DYNAMIC_DRAW);
 
 	GL_CHECK_ERRORS
 
-	//enable vertex attribute array for position
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,0,0);
-
-	glBindVertexArray(0);
-
 	//setup vao and vbo stuff for the light position crosshair
 	glm::vec3 crossHairVertices[6];
 	crossHairVertices[0] = glm::vec3(-0.5f,0,0);
@@ -694,7 +608,6 @@ void OnShutdown() {
 	quadShader.DeleteShaderProgram();
 
 	glDeleteVertexArrays(1, &volumeVAO);
-	glDeleteBuffers(1, &volumeVBO);
 
 	glDeleteVertexArrays(1, &quadVAOID);
 	glDeleteBuffers(1, &quadVBOID);
@@ -780,6 +693,12 @@ void DrawSlices(glm::mat4 MVP) {
 	//bind the volume vertex array object
 	glBindVertexArray(volumeVAO);
 
+	//pass the slicing setup to both slicing shaders once per frame
+	shaderShadow.Use();
+		SetSliceUniforms(shaderShadow);
+	shader.Use();
+		SetSliceUniforms(shader);
+
 	//for all slices
 	for(int i =0;i<num_slices;i++) {
 		//bind the shadow shader
@@ -1,20 +1,72 @@
 #version 330 core
-  
-layout(location = 0) in vec3 vVertex; //object space vertex position
 
-//uniform
-uniform mat4 MVP;   //combined modelview projection matrix
+//uniforms
+uniform mat4 MVP;				//combined modelview projection matrix
+uniform int num_slices;			//total number of slices
+uniform vec3 vecStart[12];		//start vertex of the cube edges for the current view
+uniform vec3 vecDir[12];		//direction of the cube edges for the current view
+uniform float lambda[12];		//edge intersection parameter of the nearest slice
+uniform float lambda_inc[12];	//edge intersection parameter increment per slice
 
 smooth out vec3 vUV; //3D texture coordinates for texture lookup in the fragment shader
 
+//a slice polygon has 3 to 6 vertices and is drawn as a fan of 4 triangles
+const int indices[12] = int[12](0,1,2, 0,2,3, 0,3,4, 0,4,5);
+
+//intersection parameters of the current slice with the 12 edges
+float dL[12];
+
+//returns true if the slice plane intersects the given edge
+bool Hit(int e) {
+	return dL[e] >= 0.0 && dL[e] < 1.0;
+}
+
+//returns the intersection of the slice plane with the given edge
+vec3 Intersection(int e) {
+	return vecStart[e] + dL[e]*vecDir[e];
+}
+
 void main()
-{  
+{
+	//The slice polygons are generated here instead of on the CPU. There is no
+	//vertex buffer, every 12 vertices make up one slice and the slices are 
+	//emitted from back to front. The CPU only updates the edge setup when the
+	//view or the light changes, which does not depend on the number of slices.
+	int slice = num_slices - 1 - gl_VertexID/12;
+
+	//determine the lambda value for all edges
+	for(int e=0;e<12;e++)
+		dL[e] = lambda[e] + float(slice)*lambda_inc[e];
+
+	//if the slice misses the volume, collapse its triangles to a point
+	if(!Hit(0) && !Hit(1) && !Hit(3)) {
+		gl_Position = vec4(0,0,0,1);
+		vUV = vec3(0);
+		return;
+	}
+
+	//get the polygon vertex using the same edge order as the CPU slicer
+	vec3 vertex;
+	int corner = indices[gl_VertexID%12];
+	if(corner==0)
+		vertex = Hit(0) ? Intersection(0) : (Hit(1) ? Intersection(1) : Intersection(3));
+	else if(corner==1)
+		vertex = Hit(2) ? Intersection(2) : (Hit(0) ? Intersection(0) : (Hit(1) ? Intersection(1) : Intersection(3)));
+	else if(corner==2)
+		vertex = Hit(4) ? Intersection(4) : (Hit(5) ? Intersection(5) : Intersection(7));
+	else if(corner==3)
+		vertex = Hit(6) ? Intersection(6) : (Hit(4) ? Intersection(4) : (Hit(5) ? Intersection(5) : Intersection(7)));
+	else if(corner==4)
+		vertex = Hit(8) ? Intersection(8) : (Hit(9) ? Intersection(9) : Intersection(11));
+	else
+		vertex = Hit(10) ? Intersection(10) : (Hit(8) ? Intersection(8) : (Hit(9) ? Intersection(9) : Intersection(11)));
+
 	//get the clipspace position 
-	gl_Position = MVP*vec4(vVertex.xyz,1);
+	gl_Position = MVP*vec4(vertex,1);
 
 	//get the 3D texture coordinates by adding (0.5,0.5,0.5) to the object space 
 	//vertex position. Since the unit cube is at origin (min: (-0.5,-0.5,-0.5) and max: (0.5,0.5,0.5))
 	//adding (0.5,0.5,0.5) to the unit cube object space position gives us values from (0,0,0) to 
 	//(1,1,1)
-	vUV = vVertex + vec3(0.5);
+	vUV = vertex + vec3(0.5);
 }
\ No newline at end of file
@@ -0,0 +1,678 @@
+#include "DualContourer.h"
+#include "..\src\Timer.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+
+//cells per task when merging and contouring in parallel
+const size_t CELLS_PER_TASK = 4096;
+
+//eigenvalues of the QEF below this fraction of the largest one are dropped,
+//so flat and curved regions fall back to the mass point along the free directions
+const double EIGEN_THRESHOLD = 0.1;
+
+//the QEF vertex may leave its cell by this fraction of the cell size before
+//the mass point is used instead
+const float CELL_MARGIN = 0.1f;
+
+//cube corner i is at (i&1, (i>>1)&1, (i>>2)&1), the edges are sorted by axis
+static const int cubeEdges[12][2] = {
+	{0,1},{2,3},{4,5},{6,7},
+	{0,2},{1,3},{4,6},{5,7},
+	{0,4},{1,5},{2,6},{3,7}
+};
+
+//the four corners of each cube face
+static const int cubeFaces[6][4] = {
+	{0,2,4,6},{1,3,5,7},
+	{0,1,4,5},{2,3,6,7},
+	{0,1,2,3},{4,5,6,7}
+};
+
+//a quad (or triangle) touching a merged cell, sorted vertex ids are the key
+//used to drop the copies emitted by every fine edge along a coarse edge
+struct SharedFace {
+	GLuint key[4];
+	GLuint v[4];
+	int count;
+	bool operator<(const SharedFace& f) const {
+		return std::lexicographical_compare(key, key+4, f.key, f.key+4);
+	}
+	bool operator==(const SharedFace& f) const {
+		return std::equal(key, key+4, f.key);
+	}
+};
+
+struct DualContourer::Job {
+	DualContourer* contourer;
+	//active leaves of each slice of cells
+	std::vector<std::vector<Node> > slices;
+	//first child of each parent in the child level
+	std::vector<size_t> groups;
+	int level;
+	//output of each contouring task
+	std::vector<std::vector<GLuint> > triangles;
+	std::vector<std::vector<SharedFace> > sharedFaces;
+	GLuint firstLeafVertex;
+};
+
+//spreads the lower 10 bits of v so that there are two zero bits between each
+static inline unsigned int SpreadBits(unsigned int v) {
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v <<  8)) & 0x0300f00f;
+	v = (v | (v <<  4)) & 0x030c30c3;
+	v = (v | (v <<  2)) & 0x09249249;
+	return v;
+}
+
+static inline unsigned int CompactBits(unsigned int v) {
+	v &= 0x09249249;
+	v = (v | (v >>  2)) & 0x030c30c3;
+	v = (v | (v >>  4)) & 0x0300f00f;
+	v = (v | (v >>  8)) & 0x030000ff;
+	v = (v | (v >> 16)) & 0x000003ff;
+	return v;
+}
+
+static inline unsigned int MortonCode(const int i, const int j, const int k) {
+	return SpreadBits(i) | (SpreadBits(j)<<1) | (SpreadBits(k)<<2);
+}
+
+static inline glm::ivec3 MortonDecode(const unsigned int code) {
+	return glm::ivec3(CompactBits(code), CompactBits(code>>1), CompactBits(code>>2));
+}
+
+//a cell has a single sheet of surface if its inside corners and its outside
+//corners are each connected through the cube edges
+static bool IsManifold(const unsigned char corners) {
+	int component[8];
+	for(int i=0;i<8;i++)
+		component[i] = i;
+	for(int i=0;i<12;i++) {
+		int a = cubeEdges[i][0], b = cubeEdges[i][1];
+		if(((corners>>a)&1) != ((corners>>b)&1))
+			continue;
+		int ca = component[a], cb = component[b];
+		if(ca == cb)
+			continue;
+		for(int j=0;j<8;j++)
+			if(component[j] == cb)
+				component[j] = ca;
+	}
+	int insideComponents = 0, outsideComponents = 0;
+	for(int i=0;i<8;i++) {
+		if(component[i] != i)
+			continue;
+		if((corners>>i)&1)
+			insideComponents++;
+		else
+			outsideComponents++;
+	}
+	return insideComponents<=1 && outsideComponents<=1;
+}
+
+//eigen decomposition of a symmetric 3x3 matrix with cyclic Jacobi rotations,
+//a is diagonalized in place and the eigenvectors are the columns of v
+static void JacobiEigen(double a[3][3], double v[3][3]) {
+	for(int i=0;i<3;i++)
+		for(int j=0;j<3;j++)
+			v[i][j] = (i==j) ? 1.0 : 0.0;
+
+	static const int pairs[3][2] = {{0,1},{0,2},{1,2}};
+	for(int sweep=0;sweep<8;sweep++) {
+		double offDiagonal = fabs(a[0][1]) + fabs(a[0][2]) + fabs(a[1][2]);
+		if(offDiagonal < 1e-12)
+			break;
+		for(int n=0;n<3;n++) {
+			int p = pairs[n][0], q = pairs[n][1];
+			if(fabs(a[p][q]) < 1e-15)
+				continue;
+			double theta = (a[q][q]-a[p][p])/(2.0*a[p][q]);
+			double t = (theta>=0 ? 1.0 : -1.0)/(fabs(theta) + sqrt(theta*theta + 1.0));
+			double c = 1.0/sqrt(t*t + 1.0);
+			double s = t*c;
+			for(int k=0;k<3;k++) {
+				double akp = a[k][p], akq = a[k][q];
+				a[k][p] = c*akp - s*akq;
+				a[k][q] = s*akp + c*akq;
+			}
+			for(int k=0;k<3;k++) {
+				double apk = a[p][k], aqk = a[q][k];
+				a[p][k] = c*apk - s*aqk;
+				a[q][k] = s*apk + c*aqk;
+			}
+			for(int k=0;k<3;k++) {
+				double vkp = v[k][p], vkq = v[k][q];
+				v[k][p] = c*vkp - s*vkq;
+				v[k][q] = s*vkp + c*vkq;
+			}
+		}
+	}
+}
+
+void DualContourer::QEF::Clear() {
+	for(int i=0;i<6;i++)
+		ata[i] = 0;
+	for(int i=0;i<3;i++)
+		atb[i] = 0;
+	btb = 0;
+	massPoint = glm::vec3(0);
+	normal = glm::vec3(0);
+	count = 0;
+}
+
+void DualContourer::QEF::Add(const glm::vec3& p, const glm::vec3& n) {
+	double d = double(n.x)*p.x + double(n.y)*p.y + double(n.z)*p.z;
+	ata[0] += n.x*n.x; ata[1] += n.x*n.y; ata[2] += n.x*n.z;
+	ata[3] += n.y*n.y; ata[4] += n.y*n.z; ata[5] += n.z*n.z;
+	atb[0] += n.x*d; atb[1] += n.y*d; atb[2] += n.z*d;
+	btb += d*d;
+	massPoint += p;
+	normal += n;
+	count++;
+}
+
+void DualContourer::QEF::Add(const QEF& q) {
+	for(int i=0;i<6;i++)
+		ata[i] += q.ata[i];
+	for(int i=0;i<3;i++)
+		atb[i] += q.atb[i];
+	btb += q.btb;
+	massPoint += q.massPoint;
+	normal += q.normal;
+	count += q.count;
+}
+
+DualContourer::DualContourer(void)
+{
+	XDIM = 256;
+	YDIM = 256;
+	ZDIM = 256;
+	X_SAMPLING_DIST = Y_SAMPLING_DIST = Z_SAMPLING_DIST = 128;
+	pVolume = NULL;
+	isoValue = 128;
+	errorTolerance = 0.25f;
+	lastTime = 0;
+	pool.Init();
+}
+
+DualContourer::~DualContourer(void)
+{
+	pool.Destroy();
+	if(pVolume!=NULL) {
+		delete [] pVolume;
+		pVolume = NULL;
+	}
+}
+
+void DualContourer::SetVolumeDimensions(const int xdim, const int ydim, const int zdim) {
+	XDIM = xdim;
+	YDIM = ydim;
+	ZDIM = zdim;
+	invDim.x = 1.0f/XDIM;
+	invDim.y = 1.0f/YDIM;
+	invDim.z = 1.0f/ZDIM;
+}
+void DualContourer::SetNumSamplingVoxels(const int x, const int y, const int z) {
+	X_SAMPLING_DIST = x;
+	Y_SAMPLING_DIST = y;
+	Z_SAMPLING_DIST = z;
+}
+void DualContourer::SetIsosurfaceValue(const GLubyte value) {
+	isoValue = value;
+}
+void DualContourer::SetErrorTolerance(const float tolerance) {
+	errorTolerance = tolerance;
+}
+
+bool DualContourer::LoadVolume(const std::string& filename) {
+	std::ifstream infile(filename.c_str(), std::ios_base::binary);
+
+	if(infile.good()) {
+		pVolume = new GLubyte[XDIM*YDIM*ZDIM];
+		infile.read(reinterpret_cast<char*>(pVolume), XDIM*YDIM*ZDIM*sizeof(GLubyte));
+		infile.close();
+		return true;
+	} else {
+		return false;
+	}
+}
+
+GLubyte DualContourer::SampleVolume(const int x, const int y, const int z) {
+	int index = (x+(y*XDIM)) + z*(XDIM*YDIM);
+	if(index<0)
+		index = 0;
+	if(index >= XDIM*YDIM*ZDIM)
+		index = (XDIM*YDIM*ZDIM)-1;
+	return pVolume[index];
+}
+
+glm::vec3 DualContourer::GetNormal(const int x, const int y, const int z) {
+	glm::vec3 N;
+	N.x = (SampleVolume(x-1,y,z)-SampleVolume(x+1,y,z))*0.5f;
+	N.y = (SampleVolume(x,y-1,z)-SampleVolume(x,y+1,z))*0.5f;
+	N.z = (SampleVolume(x,y,z-1)-SampleVolume(x,y,z+1))*0.5f;
+	return N;
+}
+
+bool DualContourer::IsInside(const int i, const int j, const int k) {
+	return SampleVolume(i*step.x, j*step.y, k*step.z) > isoValue;
+}
+
+unsigned char DualContourer::GetCornerSigns(const int i, const int j, const int k, const int size) {
+	unsigned char corners = 0;
+	for(int c=0;c<8;c++) {
+		if(IsInside(i + (c&1)*size, j + ((c>>1)&1)*size, k + ((c>>2)&1)*size))
+			corners |= 1<<c;
+	}
+	return corners;
+}
+
+bool DualContourer::IsSafeToCollapse(const int i, const int j, const int k, const int size, const unsigned char corners) {
+	//the merged cell must carry a single sheet of surface
+	if(corners==0 || corners==255 || !IsManifold(corners))
+		return false;
+
+	int half = size/2;
+
+	//the middle of an edge must have the sign of one of its end points
+	for(int e=0;e<12;e++) {
+		int a = cubeEdges[e][0], b = cubeEdges[e][1];
+		bool sign = ((corners>>a)&1)!=0;
+		if(sign != (((corners>>b)&1)!=0))
+			continue;
+		int mi = i + ((a&1) + (b&1))*half;
+		int mj = j + (((a>>1)&1) + ((b>>1)&1))*half;
+		int mk = k + (((a>>2)&1) + ((b>>2)&1))*half;
+		if(IsInside(mi, mj, mk) != sign)
+			return false;
+	}
+
+	//the middle of a face must have the sign of one of its corners
+	for(int f=0;f<6;f++) {
+		int insideCorners = 0;
+		for(int c=0;c<4;c++)
+			insideCorners += (corners>>cubeFaces[f][c])&1;
+		if(insideCorners!=0 && insideCorners!=4)
+			continue;
+		int axis = f/2;
+		glm::ivec3 center = glm::ivec3(i,j,k) + glm::ivec3(half);
+		center[axis] += (f&1) ? half : -half;
+		if(IsInside(center.x, center.y, center.z) != (insideCorners==4))
+			return false;
+	}
+	return true;
+}
+
+void DualContourer::SolveQEF(const QEF& qef, const glm::vec3& minP, const glm::vec3& maxP, glm::vec3& position, float& error) {
+	glm::vec3 massPoint = qef.massPoint/float(qef.count);
+	double m[3] = { massPoint.x, massPoint.y, massPoint.z };
+
+	double a[3][3] = {
+		{ qef.ata[0], qef.ata[1], qef.ata[2] },
+		{ qef.ata[1], qef.ata[3], qef.ata[4] },
+		{ qef.ata[2], qef.ata[4], qef.ata[5] }
+	};
+
+	//solve around the mass point so that the dropped directions keep it
+	double b[3];
+	for(int r=0;r<3;r++)
+		b[r] = qef.atb[r] - (a[r][0]*m[0] + a[r][1]*m[1] + a[r][2]*m[2]);
+
+	double d[3][3], v[3][3];
+	for(int r=0;r<3;r++)
+		for(int c=0;c<3;c++)
+			d[r][c] = a[r][c];
+	JacobiEigen(d, v);
+
+	double maxEigen = std::max(d[0][0], std::max(d[1][1], d[2][2]));
+	double x[3] = { m[0], m[1], m[2] };
+	for(int e=0;e<3;e++) {
+		if(d[e][e] <= EIGEN_THRESHOLD*maxEigen || d[e][e] <= 0)
+			continue;
+		double proj = (v[0][e]*b[0] + v[1][e]*b[1] + v[2][e]*b[2])/d[e][e];
+		for(int r=0;r<3;r++)
+			x[r] += v[r][e]*proj;
+	}
+
+	//keep the vertex in its cell
+	glm::vec3 margin = (maxP-minP)*CELL_MARGIN;
+	for(int r=0;r<3;r++) {
+		if(x[r] < minP[r]-margin[r] || x[r] > maxP[r]+margin[r]) {
+			x[0] = m[0]; x[1] = m[1]; x[2] = m[2];
+			break;
+		}
+	}
+
+	double ax[3];
+	for(int r=0;r<3;r++)
+		ax[r] = a[r][0]*x[0] + a[r][1]*x[1] + a[r][2]*x[2];
+	double e = (x[0]*ax[0] + x[1]*ax[1] + x[2]*ax[2])
+			 - 2.0*(x[0]*qef.atb[0] + x[1]*qef.atb[1] + x[2]*qef.atb[2]) + qef.btb;
+	error = float(std::max(e, 0.0));
+	position = glm::vec3(float(x[0]), float(x[1]), float(x[2]));
+}
+
+bool DualContourer::ProcessLeaf(const int i, const int j, const int k, Node& node) {
+	GLubyte values[8];
+	unsigned char corners = 0;
+	for(int c=0;c<8;c++) {
+		values[c] = SampleVolume((i + (c&1))*step.x, (j + ((c>>1)&1))*step.y, (k + ((c>>2)&1))*step.z);
+		if(values[c] > isoValue)
+			corners |= 1<<c;
+	}
+	if(corners==0 || corners==255)
+		return false;
+
+	node.code = MortonCode(i,j,k);
+	node.parent = -1;
+	node.vertex = -1;
+	node.corners = corners;
+	node.collapsed = true;
+	node.qef.Clear();
+
+	//hermite data: the crossing of every sign changing edge and the surface normal there
+	glm::vec3 scale = glm::vec3(step);
+	for(int e=0;e<12;e++) {
+		int a = cubeEdges[e][0], b = cubeEdges[e][1];
+		if(((corners>>a)&1) == ((corners>>b)&1))
+			continue;
+		float delta = float(values[b]) - float(values[a]);
+		float offset = (float(isoValue) - values[a])/delta;
+
+		glm::ivec3 pa = glm::ivec3(i + (a&1), j + ((a>>1)&1), k + ((a>>2)&1));
+		glm::ivec3 pb = glm::ivec3(i + (b&1), j + ((b>>1)&1), k + ((b>>2)&1));
+		glm::vec3 p = glm::vec3(pa) + glm::vec3(pb-pa)*offset;
+
+		//gradients are in voxels, scale them to the sampling grid
+		glm::vec3 na = GetNormal(pa.x*step.x, pa.y*step.y, pa.z*step.z);
+		glm::vec3 nb = GetNormal(pb.x*step.x, pb.y*step.y, pb.z*step.z);
+		glm::vec3 n = (na + (nb-na)*offset)*scale;
+		float length = glm::length(n);
+		if(length < 1e-6f) {
+			//flat data, point the normal from the inside to the outside corner
+			n = glm::vec3(pb-pa);
+			if((corners>>b)&1)
+				n = -n;
+		} else {
+			n /= length;
+		}
+		node.qef.Add(p, n);
+	}
+
+	glm::vec3 minP = glm::vec3(i,j,k);
+	SolveQEF(node.qef, minP, minP + glm::vec3(1), node.position, node.error);
+	return true;
+}
+
+void DualContourer::ProcessLeafSlices(int task, void* data) {
+	Job& job = *(Job*)data;
+	DualContourer* contourer = job.contourer;
+	std::vector<Node>& output = job.slices[task];
+	output.clear();
+
+	Node node;
+	glm::ivec3 cells = contourer->samples - glm::ivec3(1);
+	for(int j=0;j<cells.y;j++) {
+		for(int i=0;i<cells.x;i++) {
+			if(contourer->ProcessLeaf(i, j, task, node))
+				output.push_back(node);
+		}
+	}
+}
+
+void DualContourer::MergeNodes(int task, void* data) {
+	Job& job = *(Job*)data;
+	DualContourer* contourer = job.contourer;
+	std::vector<Node>& children = contourer->levels[job.level-1];
+	std::vector<Node>& parents = contourer->levels[job.level];
+	int size = 1<<job.level;
+	glm::ivec3 cells = contourer->samples - glm::ivec3(1);
+
+	size_t first = task*CELLS_PER_TASK;
+	size_t last = std::min(first+CELLS_PER_TASK, parents.size());
+	for(size_t p=first;p<last;p++) {
+		Node& parent = parents[p];
+		size_t childStart = job.groups[p], childEnd = job.groups[p+1];
+
+		parent.code = children[childStart].code>>3;
+		parent.parent = -1;
+		parent.vertex = -1;
+		parent.qef.Clear();
+
+		bool childrenCollapsed = true;
+		for(size_t c=childStart;c<childEnd;c++) {
+			children[c].parent = int(p);
+			parent.qef.Add(children[c].qef);
+			if(!children[c].collapsed || !IsManifold(children[c].corners))
+				childrenCollapsed = false;
+		}
+
+		glm::ivec3 origin = MortonDecode(parent.code)*size;
+		parent.collapsed = false;
+		parent.corners = 0;
+		parent.error = 0;
+		parent.position = parent.qef.massPoint/float(parent.qef.count);
+
+		//nodes reaching past the sampling grid are never merged
+		if(!childrenCollapsed || contourer->errorTolerance<=0 || glm::any(glm::greaterThan(origin+glm::ivec3(size), cells)))
+			continue;
+
+		parent.corners = contourer->GetCornerSigns(origin.x, origin.y, origin.z, size);
+		glm::vec3 minP = glm::vec3(origin);
+		SolveQEF(parent.qef, minP, minP + glm::vec3(float(size)), parent.position, parent.error);
+		float tolerance = contourer->errorTolerance;
+		if(parent.error > tolerance*tolerance*parent.qef.count)
+			continue;
+		parent.collapsed = contourer->IsSafeToCollapse(origin.x, origin.y, origin.z, size, parent.corners);
+	}
+}
+
+int DualContourer::FindLeafVertex(const int i, const int j, const int k) {
+	if(i<0 || j<0 || k<0)
+		return -1;
+	Node key;
+	key.code = MortonCode(i,j,k);
+	std::vector<Node>& leaves = levels[0];
+	std::vector<Node>::iterator it = std::lower_bound(leaves.begin(), leaves.end(), key,
+		[](const Node& a, const Node& b) { return a.code < b.code; });
+	if(it==leaves.end() || it->code!=key.code)
+		return -1;
+	return it->vertex;
+}
+
+void DualContourer::ContourLeaves(int task, void* data) {
+	Job& job = *(Job*)data;
+	DualContourer* contourer = job.contourer;
+	std::vector<Node>& leaves = contourer->levels[0];
+	std::vector<GLuint>& triangles = job.triangles[task];
+	std::vector<SharedFace>& sharedFaces = job.sharedFaces[task];
+	triangles.clear();
+	sharedFaces.clear();
+
+	size_t first = task*CELLS_PER_TASK;
+	size_t last = std::min(first+CELLS_PER_TASK, leaves.size());
+	for(size_t l=first;l<last;l++) {
+		glm::ivec3 cell = MortonDecode(leaves[l].code);
+		bool inside = (leaves[l].corners&1)!=0;
+
+		//the three edges leaving the cell's first corner, each shared by the
+		//cell and its three neighbours on the negative side of the other axes
+		for(int axis=0;axis<3;axis++) {
+			if(inside == (((leaves[l].corners>>(1<<axis))&1)!=0))
+				continue;
+			int b = (axis+1)%3, c = (axis+2)%3;
+			glm::ivec3 cb = cell, cc = cell, cbc = cell;
+			cb[b]--; cc[c]--; cbc[b]--; cbc[c]--;
+
+			//the cells in counter clockwise order around the axis
+			int ids[4];
+			ids[0] = leaves[l].vertex;
+			ids[1] = contourer->FindLeafVertex(cb.x, cb.y, cb.z);
+			ids[2] = contourer->FindLeafVertex(cbc.x, cbc.y, cbc.z);
+			ids[3] = contourer->FindLeafVertex(cc.x, cc.y, cc.z);
+			if(ids[1]<0 || ids[2]<0 || ids[3]<0)
+				continue;
+
+			//the normal of the quad points along the axis, flip it to face the outside
+			if(!inside)
+				std::swap(ids[1], ids[3]);
+
+			//merged cells repeat a vertex, drop it to get a triangle
+			GLuint v[4];
+			int count = 0;
+			bool shared = false;
+			for(int n=0;n<4;n++) {
+				if(ids[n] == ids[(n+3)%4])
+					continue;
+				v[count++] = GLuint(ids[n]);
+				shared = shared || GLuint(ids[n]) < job.firstLeafVertex;
+			}
+			if(count<3 || (count==4 && (v[0]==v[2] || v[1]==v[3])))
+				continue;
+
+			if(shared) {
+				SharedFace face;
+				face.count = count;
+				for(int n=0;n<4;n++) {
+					face.v[n] = n<count ? v[n] : v[0];
+					face.key[n] = face.v[n];
+				}
+				std::sort(face.key, face.key+4);
+				sharedFaces.push_back(face);
+				continue;
+			}
+
+			//split the quad along its shorter diagonal
+			const std::vector<Vertex>& vertices = contourer->vertices;
+			if(glm::length(vertices[v[0]].pos - vertices[v[2]].pos) <= glm::length(vertices[v[1]].pos - vertices[v[3]].pos)) {
+				GLuint quad[6] = { v[0], v[1], v[2], v[0], v[2], v[3] };
+				triangles.insert(triangles.end(), quad, quad+6);
+			} else {
+				GLuint quad[6] = { v[0], v[1], v[3], v[1], v[2], v[3] };
+				triangles.insert(triangles.end(), quad, quad+6);
+			}
+		}
+	}
+}
+
+void DualContourer::ContourVolume() {
+	CTimer timer;
+
+	vertices.clear();
+	indices.clear();
+	levels.clear();
+
+	//the sampling grid, Morton codes hold up to 1024 samples per axis
+	step = glm::max(glm::ivec3(XDIM/X_SAMPLING_DIST, YDIM/Y_SAMPLING_DIST, ZDIM/Z_SAMPLING_DIST), glm::ivec3(1));
+	samples = glm::min((glm::ivec3(XDIM,YDIM,ZDIM)-glm::ivec3(1))/step + glm::ivec3(1), glm::ivec3(1024));
+	glm::ivec3 cells = samples - glm::ivec3(1);
+
+	Job job;
+	job.contourer = this;
+
+	//active leaves and their vertices
+	job.slices.resize(cells.z);
+	pool.Run(cells.z, ProcessLeafSlices, &job);
+	levels.push_back(std::vector<Node>());
+	size_t total = 0;
+	for(size_t i=0;i<job.slices.size();i++)
+		total += job.slices[i].size();
+	levels[0].reserve(total);
+	for(size_t i=0;i<job.slices.size();i++)
+		levels[0].insert(levels[0].end(), job.slices[i].begin(), job.slices[i].end());
+	job.slices.clear();
+	std::sort(levels[0].begin(), levels[0].end(), [](const Node& a, const Node& b) { return a.code < b.code; });
+
+	//build the octree bottom up, siblings are next to each other in Morton
+	//order. Merging stops at the first level where nothing collapses.
+	int maxCells = std::max(cells.x, std::max(cells.y, cells.z));
+	for(int level=1;(1<<(level-1))<maxCells;level++) {
+		std::vector<Node>& children = levels[level-1];
+		job.groups.clear();
+		for(size_t c=0;c<children.size();c++) {
+			if(c==0 || (children[c].code>>3) != (children[c-1].code>>3))
+				job.groups.push_back(c);
+		}
+		job.groups.push_back(children.size());
+
+		levels.push_back(std::vector<Node>(job.groups.size()-1));
+		job.level = level;
+		pool.Run(int((levels[level].size()+CELLS_PER_TASK-1)/CELLS_PER_TASK), MergeNodes, &job);
+
+		bool anyCollapsed = false;
+		for(size_t p=0;p<levels[level].size() && !anyCollapsed;p++)
+			anyCollapsed = levels[level][p].collapsed;
+		if(!anyCollapsed)
+			break;
+	}
+
+	//every collapsed node below a node that is not collapsed gives a vertex,
+	//the merged cells first so that the leaves come last
+	glm::vec3 scale = glm::vec3(step)*invDim;
+	for(int level=int(levels.size())-1;level>=0;level--) {
+		if(level==0)
+			job.firstLeafVertex = GLuint(vertices.size());
+		std::vector<Node>& nodes = levels[level];
+		for(size_t n=0;n<nodes.size();n++) {
+			Node& node = nodes[n];
+			if(!node.collapsed)
+				continue;
+			if(node.parent>=0 && levels[level+1][node.parent].collapsed) {
+				node.vertex = levels[level+1][node.parent].vertex;
+				continue;
+			}
+			node.vertex = int(vertices.size());
+			Vertex v;
+			v.pos = node.position*scale;
+			float length = glm::length(node.qef.normal);
+			v.normal = length>0 ? node.qef.normal/length : glm::vec3(0,1,0);
+			vertices.push_back(v);
+		}
+	}
+
+	//one quad for each sign changing edge of the leaves
+	int totalTasks = int((levels[0].size()+CELLS_PER_TASK-1)/CELLS_PER_TASK);
+	job.triangles.resize(totalTasks);
+	job.sharedFaces.resize(totalTasks);
+	pool.Run(totalTasks, ContourLeaves, &job);
+
+	//every fine edge along the edge of a merged cell gives the same face, keep one
+	std::vector<SharedFace> sharedFaces;
+	for(int i=0;i<totalTasks;i++) {
+		indices.insert(indices.end(), job.triangles[i].begin(), job.triangles[i].end());
+		sharedFaces.insert(sharedFaces.end(), job.sharedFaces[i].begin(), job.sharedFaces[i].end());
+	}
+	std::sort(sharedFaces.begin(), sharedFaces.end());
+	sharedFaces.erase(std::unique(sharedFaces.begin(), sharedFaces.end()), sharedFaces.end());
+	for(size_t i=0;i<sharedFaces.size();i++) {
+		const SharedFace& f = sharedFaces[i];
+		indices.push_back(f.v[0]); indices.push_back(f.v[1]); indices.push_back(f.v[2]);
+		if(f.count==4) {
+			indices.push_back(f.v[0]); indices.push_back(f.v[2]); indices.push_back(f.v[3]);
+		}
+	}
+
+	lastTime = timer.Elapsed();
+}
+
+size_t DualContourer::GetTotalVertices() {
+	return vertices.size();
+}
+size_t DualContourer::GetTotalIndices() {
+	return indices.size();
+}
+Vertex* DualContourer::GetVertexPointer() {
+	return vertices.empty() ? NULL : &vertices[0];
+}
+GLuint* DualContourer::GetIndexPointer() {
+	return indices.empty() ? NULL : &indices[0];
+}
+size_t DualContourer::GetTotalActiveCells() {
+	return levels.empty() ? 0 : levels[0].size();
+}
+float DualContourer::GetLastTime() {
+	return lastTime;
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#pragma once
+#include <GL/freeglut.h>
+#include <string.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "TetrahedraMarcher.h"
+#include "..\src\ThreadPool.h"
+
+//DualContourer class. It extracts the isosurface with dual contouring on a
+//sparse voxel octree: only cells the surface passes through are stored. Each
+//active leaf cell gets one vertex that minimizes the quadratic error function
+//(QEF) of the surface planes at its edge crossings, which keeps sharp
+//features. Cells are then merged bottom up while the merged QEF error stays
+//below a tolerance and the merge cannot change the topology, so flat regions
+//get large cells and few triangles. The mesh is indexed, one quad per edge
+//crossing the surface.
+class DualContourer
+{
+public:
+	//constructor/destructor
+	DualContourer(void);
+	~DualContourer(void);
+
+	//function to set the volume dimension
+	void SetVolumeDimensions(const int xdim, const int ydim, const int zdim);
+
+	//function to set the total number of sampling voxels
+	//more voxels will give a higher density mesh
+	void SetNumSamplingVoxels(const int x, const int y, const int z);
+
+	//set the isosurface value
+	void SetIsosurfaceValue(const GLubyte value);
+
+	//set the largest root mean square distance (in sampling voxels) of the
+	//surface planes of a merged cell to its vertex, 0 disables merging
+	void SetErrorTolerance(const float tolerance);
+
+	//load the volume dataset
+	bool LoadVolume(const std::string& filename);
+
+	//extract the isosurface
+	void ContourVolume();
+
+	//get the total number of vertices and indices generated
+	size_t GetTotalVertices();
+	size_t GetTotalIndices();
+
+	//get the pointers to the vertex and index buffers
+	Vertex* GetVertexPointer();
+	GLuint* GetIndexPointer();
+
+	//get the number of active leaf cells and the time taken by the last
+	//extraction in milliseconds
+	size_t GetTotalActiveCells();
+	float GetLastTime();
+
+protected:
+	//accumulated surface planes of a cell
+	struct QEF {
+		double ata[6];
+		double atb[3];
+		double btb;
+		glm::vec3 massPoint;
+		glm::vec3 normal;
+		int count;
+		void Clear();
+		void Add(const glm::vec3& p, const glm::vec3& n);
+		void Add(const QEF& q);
+	};
+
+	//an octree node. Leaves are single sampling cells. A node is collapsed if
+	//it is drawn as one cell with a single vertex.
+	struct Node {
+		unsigned int code;
+		int parent;
+		int vertex;
+		unsigned char corners;
+		bool collapsed;
+		QEF qef;
+		glm::vec3 position;
+		float error;
+	};
+
+	struct Job;
+	static void ProcessLeafSlices(int task, void* data);
+	static void MergeNodes(int task, void* data);
+	static void ContourLeaves(int task, void* data);
+
+	//volume sampling function, give the x,y,z values returns the density value
+	//in the volume at that location
+	GLubyte SampleVolume(const int x, const int y, const int z);
+
+	//get the normal at the given location using center finite difference approximation
+	glm::vec3 GetNormal(const int x, const int y, const int z);
+
+	//returns true if the sample at the given sampling grid position is inside the surface
+	bool IsInside(const int i, const int j, const int k);
+
+	//returns the corner signs of the node at the given sampling grid position and size
+	unsigned char GetCornerSigns(const int i, const int j, const int k, const int size);
+
+	//returns true if merging the children of a node cannot change the topology
+	bool IsSafeToCollapse(const int i, const int j, const int k, const int size, const unsigned char corners);
+
+	//computes the hermite data and vertex of a leaf cell, returns false for inactive cells
+	bool ProcessLeaf(const int i, const int j, const int k, Node& node);
+
+	//solves the QEF inside the given box
+	static void SolveQEF(const QEF& qef, const glm::vec3& minP, const glm::vec3& maxP, glm::vec3& position, float& error);
+
+	//returns the vertex of the leaf cell at the given sampling grid position or -1
+	int FindLeafVertex(const int i, const int j, const int k);
+
+	//the volume dataset dimensions and inverse volume dimensions
+	int XDIM, YDIM, ZDIM;
+	glm::vec3 invDim;
+
+	//sampling distances in voxels
+	int X_SAMPLING_DIST;
+	int Y_SAMPLING_DIST;
+	int Z_SAMPLING_DIST;
+
+	//sampling step in voxels and the number of samples along each axis
+	glm::ivec3 step, samples;
+
+	//volume data pointer
+	GLubyte* pVolume;
+
+	//the given isovalue to look for
+	GLubyte isoValue;
+
+	//the merge tolerance
+	float errorTolerance;
+
+	//octree levels, the leaves first. Each level is sorted by Morton code.
+	std::vector<std::vector<Node> > levels;
+
+	//output mesh
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+
+	//worker threads
+	CThreadPool pool;
+
+	float lastTime;
+};
\ No newline at end of file
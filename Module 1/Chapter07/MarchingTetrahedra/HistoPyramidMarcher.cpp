@@ -0,0 +1,274 @@
+#include "HistoPyramidMarcher.h"
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include "Tables.h"
+
+HistoPyramidMarcher::HistoPyramidMarcher(void)
+{
+	XDIM = 256;
+	YDIM = 256;
+	ZDIM = 256;
+	isoValue = 48;
+	volumeTexID = pyramidTexID = triTableTexID = triCountTexID = 0;
+	fboID = emptyVAOID = vboID = queryID = 0;
+	pyramidSize = totalLevels = 0;
+	capacity = 0;
+	totalVertices = 0;
+	lastTime = 0;
+}
+
+HistoPyramidMarcher::~HistoPyramidMarcher(void)
+{
+	classifyShader.DeleteShaderProgram();
+	reduceShader.DeleteShaderProgram();
+	extractShader.DeleteShaderProgram();
+	glDeleteTextures(1, &volumeTexID);
+	glDeleteTextures(1, &pyramidTexID);
+	glDeleteTextures(1, &triTableTexID);
+	glDeleteTextures(1, &triCountTexID);
+	glDeleteFramebuffers(1, &fboID);
+	glDeleteVertexArrays(1, &emptyVAOID);
+	glDeleteBuffers(1, &vboID);
+	glDeleteQueries(1, &queryID);
+}
+
+void HistoPyramidMarcher::SetVolumeDimensions(const int xdim, const int ydim, const int zdim) {
+	XDIM = xdim;
+	YDIM = ydim;
+	ZDIM = zdim;
+	invDim.x = 1.0f/XDIM;
+	invDim.y = 1.0f/YDIM;
+	invDim.z = 1.0f/ZDIM;
+}
+void HistoPyramidMarcher::SetNumSamplingVoxels(const int x, const int y, const int z) {
+	X_SAMPLING_DIST = x;
+	Y_SAMPLING_DIST = y;
+	Z_SAMPLING_DIST = z;
+}
+void HistoPyramidMarcher::SetIsosurfaceValue(const GLubyte value) {
+	isoValue = value;
+}
+
+bool HistoPyramidMarcher::LoadVolume(const std::string& filename) {
+	std::ifstream infile(filename.c_str(), std::ios_base::binary);
+	if(!infile.good())
+		return false;
+
+	//read the volume data file
+	std::vector<GLubyte> volume(XDIM*YDIM*ZDIM);
+	infile.read(reinterpret_cast<char*>(&volume[0]), XDIM*YDIM*ZDIM*sizeof(GLubyte));
+	infile.close();
+
+	//the volume as an integer texture so the shaders see the same values as the CPU
+	glGenTextures(1, &volumeTexID);
+	glBindTexture(GL_TEXTURE_3D, volumeTexID);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_R8UI, XDIM, YDIM, ZDIM, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &volume[0]);
+
+	//the cells visited by TetrahedraMarcher::MarchVolume
+	step = glm::ivec3(XDIM/X_SAMPLING_DIST, YDIM/Y_SAMPLING_DIST, ZDIM/Z_SAMPLING_DIST);
+	cells = (glm::ivec3(XDIM, YDIM, ZDIM) + step - glm::ivec3(1))/step;
+
+	//the pyramid is a cube of power of two size with one level per mipmap,
+	//the counts of the cells in the base level and a 1x1x1 top level
+	int maxCells = std::max(cells.x, std::max(cells.y, cells.z));
+	for(pyramidSize=1, totalLevels=1; pyramidSize<maxCells; pyramidSize*=2, totalLevels++);
+	glGenTextures(1, &pyramidTexID);
+	glBindTexture(GL_TEXTURE_3D, pyramidTexID);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	for(int level=0;level<totalLevels;level++) {
+		int size = pyramidSize>>level;
+		glTexImage3D(GL_TEXTURE_3D, level, GL_R32UI, size, size, size, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	}
+
+	//the triangle table and the number of triangles of each cube index
+	GLubyte triCount[256];
+	for(int i=0;i<256;i++) {
+		int total = 0;
+		while(total<16 && a2iTriangleConnectionTable[i][total]>=0)
+			total++;
+		triCount[i] = GLubyte(total/3);
+	}
+	glGenTextures(1, &triCountTexID);
+	glBindTexture(GL_TEXTURE_2D, triCountTexID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, 256, 1, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, triCount);
+
+	glGenTextures(1, &triTableTexID);
+	glBindTexture(GL_TEXTURE_2D, triTableTexID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32I, 16, 256, 0, GL_RED_INTEGER, GL_INT, a2iTriangleConnectionTable);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glGenFramebuffers(1, &fboID);
+	glGenVertexArrays(1, &emptyVAOID);
+	glGenBuffers(1, &vboID);
+	glGenQueries(1, &queryID);
+
+	//classification shader
+	classifyShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/histoPyramid.vert");
+	classifyShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/histoPyramidClassify.frag");
+	classifyShader.CreateAndLinkProgram();
+	classifyShader.Use();
+		classifyShader.AddUniform("volume");
+		classifyShader.AddUniform("triCount");
+		classifyShader.AddUniform("volumeSize");
+		classifyShader.AddUniform("stepSize");
+		classifyShader.AddUniform("cells");
+		classifyShader.AddUniform("layer");
+		classifyShader.AddUniform("isoValue");
+		classifyShader.AddUniform("vertexOffset");
+		glUniform1i(classifyShader("volume"), 0);
+		glUniform1i(classifyShader("triCount"), 3);
+		glUniform3i(classifyShader("volumeSize"), XDIM, YDIM, ZDIM);
+		glUniform3iv(classifyShader("stepSize"), 1, &step.x);
+		glUniform3iv(classifyShader("cells"), 1, &cells.x);
+		glUniform3iv(classifyShader("vertexOffset"), 8, &a2fVertexOffset[0][0]);
+	classifyShader.UnUse();
+
+	//reduction shader
+	reduceShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/histoPyramid.vert");
+	reduceShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/histoPyramidReduce.frag");
+	reduceShader.CreateAndLinkProgram();
+	reduceShader.Use();
+		reduceShader.AddUniform("pyramid");
+		reduceShader.AddUniform("layer");
+		glUniform1i(reduceShader("pyramid"), 1);
+	reduceShader.UnUse();
+
+	//extraction shader, its outputs are written to the vertex buffer
+	std::vector<std::string> varyings;
+	varyings.push_back("vPosition");
+	varyings.push_back("vNormal");
+	extractShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/histoPyramidExtract.vert");
+	extractShader.SetFeedbackVaryings(varyings, GL_INTERLEAVED_ATTRIBS);
+	extractShader.CreateAndLinkProgram();
+	extractShader.Use();
+		extractShader.AddUniform("volume");
+		extractShader.AddUniform("pyramid");
+		extractShader.AddUniform("triTable");
+		extractShader.AddUniform("volumeSize");
+		extractShader.AddUniform("invDim");
+		extractShader.AddUniform("stepSize");
+		extractShader.AddUniform("isoValue");
+		extractShader.AddUniform("topLevel");
+		extractShader.AddUniform("vertexOffset");
+		extractShader.AddUniform("edgeConnection");
+		glUniform1i(extractShader("volume"), 0);
+		glUniform1i(extractShader("pyramid"), 1);
+		glUniform1i(extractShader("triTable"), 2);
+		glUniform3i(extractShader("volumeSize"), XDIM, YDIM, ZDIM);
+		glUniform3fv(extractShader("invDim"), 1, &invDim.x);
+		glUniform3iv(extractShader("stepSize"), 1, &step.x);
+		glUniform1i(extractShader("topLevel"), totalLevels-1);
+		glUniform3iv(extractShader("vertexOffset"), 8, &a2fVertexOffset[0][0]);
+		glUniform2iv(extractShader("edgeConnection"), 12, &a2iEdgeConnection[0][0]);
+	extractShader.UnUse();
+	return true;
+}
+
+void HistoPyramidMarcher::MarchVolume() {
+	//remember the viewport, the passes render at the size of the pyramid levels
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	glBeginQuery(GL_TIME_ELAPSED, queryID);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_3D, volumeTexID);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, triTableTexID);
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_2D, triCountTexID);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_3D, pyramidTexID);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fboID);
+	glBindVertexArray(emptyVAOID);
+
+	//classify the cells slice by slice into the base level
+	glViewport(0, 0, pyramidSize, pyramidSize);
+	classifyShader.Use();
+		glUniform1i(classifyShader("isoValue"), isoValue);
+		for(int z=0;z<pyramidSize;z++) {
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, pyramidTexID, 0, z);
+			glUniform1i(classifyShader("layer"), z);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+	classifyShader.UnUse();
+
+	//each level holds the sums of the 2x2x2 cells of the level below. The
+	//level below is made the only level of the texture while reading it, so
+	//the level being written is never sampled.
+	reduceShader.Use();
+		for(int level=1;level<totalLevels;level++) {
+			int size = pyramidSize>>level;
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_BASE_LEVEL, level-1);
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, level-1);
+			glViewport(0, 0, size, size);
+			for(int z=0;z<size;z++) {
+				glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, pyramidTexID, level, z);
+				glUniform1i(reduceShader("layer"), z);
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+			}
+		}
+	reduceShader.UnUse();
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, totalLevels-1);
+
+	//the top level holds the total number of triangles
+	GLuint totalTriangles = 0;
+	glGetTexImage(GL_TEXTURE_3D, totalLevels-1, GL_RED_INTEGER, GL_UNSIGNED_INT, &totalTriangles);
+	totalVertices = size_t(totalTriangles)*3;
+
+	//grow the vertex buffer if needed, the name stays the same so vertex
+	//array objects using it remain valid
+	if(totalVertices > capacity) {
+		capacity = std::max(totalVertices, capacity + capacity/2);
+		glBindBuffer(GL_ARRAY_BUFFER, vboID);
+		glBufferData(GL_ARRAY_BUFFER, capacity*sizeof(Vertex), NULL, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	//one vertex shader invocation per output vertex, written by transform feedback
+	if(totalVertices > 0) {
+		glEnable(GL_RASTERIZER_DISCARD);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, vboID);
+		extractShader.Use();
+			glUniform1i(extractShader("isoValue"), isoValue);
+			glBeginTransformFeedback(GL_POINTS);
+				glDrawArrays(GL_POINTS, 0, GLsizei(totalVertices));
+			glEndTransformFeedback();
+		extractShader.UnUse();
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+		glDisable(GL_RASTERIZER_DISCARD);
+	}
+
+	glBindVertexArray(0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	glEndQuery(GL_TIME_ELAPSED);
+	GLuint64 elapsed = 0;
+	glGetQueryObjectui64v(queryID, GL_QUERY_RESULT, &elapsed);
+	lastTime = elapsed/1000000.0f;
+}
+
+size_t HistoPyramidMarcher::GetTotalVertices() {
+	return totalVertices;
+}
+GLuint HistoPyramidMarcher::GetVertexBuffer() {
+	return vboID;
+}
+float HistoPyramidMarcher::GetLastTime() {
+	return lastTime;
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+#include <GL/glew.h>
+#include <string>
+#include <glm/glm.hpp>
+#include "TetrahedraMarcher.h"
+#include "..\src\GLSLShader.h"
+
+//HistoPyramidMarcher class. GPU version of the TetrahedraMarcher that gives
+//the same triangles. A fragment shader classifies every cell against the
+//isovalue and writes its triangle count into the base level of a 3D
+//histogram pyramid, each higher level holds the sums of 8 cells below it.
+//The vertex shader of the extraction pass walks down the pyramid to find the
+//cell and triangle of its vertex and transform feedback writes the vertices
+//straight into a vertex buffer, so only the total count is read back.
+class HistoPyramidMarcher
+{
+public:
+	//constructor/destructor
+	HistoPyramidMarcher(void);
+	~HistoPyramidMarcher(void);
+
+	//function to set the volume dimension
+	void SetVolumeDimensions(const int xdim, const int ydim, const int zdim);
+
+	//function to set the total number of sampling voxels
+	//more voxels will give a higher density mesh
+	void SetNumSamplingVoxels(const int x, const int y, const int z);
+
+	//set the isosurface value
+	void SetIsosurfaceValue(const GLubyte value);
+
+	//load the volume dataset into a 3D texture and create the pyramid, the
+	//lookup tables and the shaders. Needs a current OpenGL context.
+	bool LoadVolume(const std::string& filename);
+
+	//extract the isosurface into the vertex buffer
+	void MarchVolume();
+
+	//get the total number of vertices generated
+	size_t GetTotalVertices();
+
+	//get the vertex buffer object holding the vertices, the layout is Vertex
+	GLuint GetVertexBuffer();
+
+	//get the GPU time taken by the last extraction in milliseconds
+	float GetLastTime();
+
+protected:
+	//the volume dataset dimensions and inverse volume dimensions
+	int XDIM, YDIM, ZDIM;
+	glm::vec3 invDim;
+
+	//sampling distances in voxels
+	int X_SAMPLING_DIST;
+	int Y_SAMPLING_DIST;
+	int Z_SAMPLING_DIST;
+
+	//the given isovalue to look for
+	GLubyte isoValue;
+
+	//sampling step in voxels, the number of cells along each axis and the
+	//power of two size and number of levels of the pyramid
+	glm::ivec3 step, cells;
+	int pyramidSize, totalLevels;
+
+	//volume, pyramid and lookup table textures
+	GLuint volumeTexID;
+	GLuint pyramidTexID;
+	GLuint triTableTexID;
+	GLuint triCountTexID;
+
+	//framebuffer object for the pyramid levels and an empty vertex array
+	//object for the attributeless draws
+	GLuint fboID;
+	GLuint emptyVAOID;
+
+	//output vertex buffer and its capacity in vertices
+	GLuint vboID;
+	size_t capacity;
+	size_t totalVertices;
+
+	//timer query
+	GLuint queryID;
+	float lastTime;
+
+	//classification, reduction and extraction shaders
+	GLSLShader classifyShader;
+	GLSLShader reduceShader;
+	GLSLShader extractShader;
+};
\ No newline at end of file
@@ -29,7 +29,7 @@ static const int a2fEdgeDirection[12][3] =
         {0, 0, 1},{0, 0, 1},{ 0, 0, 1},{0,  0, 1}
 };
 
-GLint aiCubeEdgeFlags[256]=
+static const GLint aiCubeEdgeFlags[256]=
 {
         0x000, 0x109, 0x203, 0x30a, 0x406, 0x50f, 0x605, 0x70c, 0x80c, 0x905, 0xa0f, 0xb06, 0xc0a, 0xd03, 0xe09, 0xf00, 
         0x190, 0x099, 0x393, 0x29a, 0x596, 0x49f, 0x795, 0x69c, 0x99c, 0x895, 0xb9f, 0xa96, 0xd9a, 0xc93, 0xf99, 0xe90, 
@@ -57,7 +57,7 @@ GLint aiCubeEdgeFlags[256]=
 //
 //  I found this table in an example program someone wrote long ago.  It was probably generated by hand
 
-GLint a2iTriangleConnectionTable[256][16] =  
+static const GLint a2iTriangleConnectionTable[256][16] =  
 {
         {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
         {0, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
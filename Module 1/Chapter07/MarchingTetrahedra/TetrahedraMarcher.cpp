@@ -135,7 +135,7 @@ size_t TetrahedraMarcher::GetTotalVertices() {
 	return vertices.size();
 }
 Vertex* TetrahedraMarcher::GetVertexPointer() {
-	return  &vertices[0];
+	return  vertices.empty() ? NULL : &vertices[0];
 } 
 
 GLubyte TetrahedraMarcher::SampleVolume(const int x, const int y, const int z) {
@@ -8,6 +8,7 @@
 
 #include "..\src\GLSLShader.h"
 #include <fstream>
+#include <sstream>
 
 #define GL_CHECK_ERRORS assert(glGetError()== GL_NO_ERROR);
 
@@ -38,6 +39,30 @@ bool bWireframe = false;
 GLuint volumeMarcherVBO;
 GLuint volumeMarcherVAO;
 
+//dual contouring vertex array, vertex buffer and index buffer object IDs
+GLuint dualContourVBO;
+GLuint dualContourVAO;
+GLuint dualContourIBO;
+
+//GPU marcher vertex array object ID, the vertex buffer belongs to the marcher
+GLuint gpuMarcherVAO;
+
+//surface extraction backends
+enum Backend { CPU_MARCHING, GPU_MARCHING, DUAL_CONTOURING };
+Backend backend = GPU_MARCHING;
+
+//isosurface value, changed by dragging with the right mouse button. The GPU
+//marcher follows the drag, the CPU backends are updated when it ends.
+int isoValue = 48;
+bool bCPUMarcherDirty = false;
+bool bDualContourDirty = false;
+
+//merge tolerance of the dual contouring octree in sampling voxels
+float errorTolerance = 0.25f;
+
+//time taken by the tetrahedra marcher in milliseconds
+float marchTime = 0;
+
 //shader
 GLSLShader shader;
 
@@ -51,6 +76,77 @@ const std::string volume_file = "../media/Engine256.raw";
 #include "TetrahedraMarcher.h"
 TetrahedraMarcher* marcher;
 
+//DualContourer instance
+#include "DualContourer.h"
+DualContourer* contourer;
+
+//HistoPyramidMarcher instance
+#include "HistoPyramidMarcher.h"
+HistoPyramidMarcher* gpuMarcher;
+
+//shows the active backend with its triangle count and extraction time in the title
+void UpdateTitle() {
+	std::stringstream title;
+	switch(backend) {
+		case CPU_MARCHING:
+			title<<"Marching Tetrahedra (CPU): "<<marcher->GetTotalVertices()/3<<" triangles, "<<marchTime<<" ms";
+			break;
+		case GPU_MARCHING:
+			title<<"Marching Tetrahedra (GPU): "<<gpuMarcher->GetTotalVertices()/3<<" triangles, "<<gpuMarcher->GetLastTime()<<" ms";
+			break;
+		case DUAL_CONTOURING:
+			title<<"Dual Contouring: "<<contourer->GetTotalIndices()/3<<" triangles, "
+				 <<contourer->GetTotalActiveCells()<<" active cells, tolerance "<<errorTolerance
+				 <<", "<<contourer->GetLastTime()<<" ms";
+			break;
+	}
+	title<<", isovalue "<<isoValue<<" ('1'-'3' backend, right drag isovalue, '+'/'-' tolerance)";
+	glutSetWindowTitle(title.str().c_str());
+}
+
+//extracts the isosurface on the GPU into the marcher's vertex buffer
+void UpdateGPUMarcher() {
+	gpuMarcher->SetIsosurfaceValue(isoValue);
+	gpuMarcher->MarchVolume();
+}
+
+//marches the volume on the CPU and passes the vertices to the buffer object.
+//The CPU marcher is the reference for the GPU marcher, both have to give
+//the same triangles for the same isovalue.
+void UpdateCPUMarcher() {
+	marcher->SetIsosurfaceValue(isoValue);
+	int start = glutGet(GLUT_ELAPSED_TIME);
+	marcher->MarchVolume();
+	marchTime = float(glutGet(GLUT_ELAPSED_TIME)-start);
+	bCPUMarcherDirty = false;
+
+	glBindBuffer (GL_ARRAY_BUFFER, volumeMarcherVBO);
+	glBufferData (GL_ARRAY_BUFFER, marcher->GetTotalVertices()*sizeof(Vertex), marcher->GetVertexPointer(), GL_STATIC_DRAW);
+	glBindBuffer (GL_ARRAY_BUFFER, 0);
+
+	if(gpuMarcher->GetTotalVertices() == marcher->GetTotalVertices()) {
+		cout<<"CPU and GPU marchers agree on "<<marcher->GetTotalVertices()/3<<" triangles at isovalue "<<isoValue<<endl;
+	} else {
+		cerr<<"Triangle count mismatch at isovalue "<<isoValue<<": CPU "<<marcher->GetTotalVertices()/3
+			<<", GPU "<<gpuMarcher->GetTotalVertices()/3<<endl;
+	}
+}
+
+//extracts the dual contouring mesh and passes it to the buffer objects
+void UpdateDualContour() {
+	contourer->SetIsosurfaceValue(isoValue);
+	contourer->SetErrorTolerance(errorTolerance);
+	contourer->ContourVolume();
+	bDualContourDirty = false;
+
+	glBindVertexArray(dualContourVAO);
+	glBindBuffer (GL_ARRAY_BUFFER, dualContourVBO);
+	glBufferData (GL_ARRAY_BUFFER, contourer->GetTotalVertices()*sizeof(Vertex), contourer->GetVertexPointer(), GL_STATIC_DRAW);
+	glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, dualContourIBO);
+	glBufferData (GL_ELEMENT_ARRAY_BUFFER, contourer->GetTotalIndices()*sizeof(GLuint), contourer->GetIndexPointer(), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+}
+
 //mouse down event handler
 void OnMouseDown(int button, int s, int x, int y)
 {
@@ -62,8 +158,20 @@ void OnMouseDown(int button, int s, int x, int y)
 
 	if(button == GLUT_MIDDLE_BUTTON)
 		state = 0;
+	else if(button == GLUT_RIGHT_BUTTON)
+		state = 2;
 	else
 		state = 1;
+
+	//the isovalue drag has ended, check the GPU result against the CPU
+	//marcher and bring the dual contouring mesh up to date when it is shown
+	if(button == GLUT_RIGHT_BUTTON && s == GLUT_UP && bCPUMarcherDirty) {
+		UpdateCPUMarcher();
+		if(backend == DUAL_CONTOURING)
+			UpdateDualContour();
+		UpdateTitle();
+		glutPostRedisplay();
+	}
 }
 
 //mouse move event handler
@@ -71,6 +179,14 @@ void OnMouseMove(int x, int y)
 {
 	if (state == 0) {
 		dist += (y - oldY)/50.0f;
+	} else if (state == 2) {
+		int value = max(0, min(255, isoValue + (x - oldX)));
+		if(value != isoValue) {
+			isoValue = value;
+			bCPUMarcherDirty = bDualContourDirty = true;
+			UpdateGPUMarcher();
+			UpdateTitle();
+		}
 	} else {
 		rX += (y - oldY)/5.0f;
 		rY += (x - oldX)/5.0f;
@@ -96,13 +212,27 @@ void OnInit() {
 	//set the volume dataset dimensions
 	marcher->SetVolumeDimensions(256,256,256);
 	//load the volume dataset
-	marcher->LoadVolume(volume_file);
+	if(marcher->LoadVolume(volume_file)) {
+		cout<<"Volume data loaded successfully."<<endl;
+	} else {
+		cout<<"Cannot load volume data."<<endl;
+		exit(EXIT_FAILURE);
+	}
 	//set the isosurface value
-	marcher->SetIsosurfaceValue(48);
+	marcher->SetIsosurfaceValue(isoValue);
 	//set the number of sampling voxels 
 	marcher->SetNumSamplingVoxels(128,128,128);
-	//begin tetrahedra marching
-	marcher->MarchVolume();
+
+	//create the GPU marcher with the same volume and sampling, it uploads
+	//the volume to a 3D texture
+	gpuMarcher = new HistoPyramidMarcher();
+	gpuMarcher->SetVolumeDimensions(256,256,256);
+	gpuMarcher->SetNumSamplingVoxels(128,128,128);
+	if(!gpuMarcher->LoadVolume(volume_file)) {
+		cout<<"Cannot create the GPU marcher."<<endl;
+		exit(EXIT_FAILURE);
+	}
+	UpdateGPUMarcher();
 
 	//setup the volume marcher vertex array object and vertex buffer object
 	glGenVertexArrays(1, &volumeMarcherVAO);
@@ -110,9 +240,11 @@ void OnInit() {
 	glBindVertexArray(volumeMarcherVAO);
 	glBindBuffer (GL_ARRAY_BUFFER, volumeMarcherVBO);
 
-	//pass the obtained vertices from the tetrahedra marcher and pass to the
-	//buffer object memory
-	glBufferData (GL_ARRAY_BUFFER, marcher->GetTotalVertices()*sizeof(Vertex), marcher->GetVertexPointer(), GL_STATIC_DRAW);
+	//begin tetrahedra marching, pass the obtained vertices from the
+	//tetrahedra marcher to the buffer object memory and compare them with
+	//the GPU marcher
+	UpdateCPUMarcher();
+	glBindBuffer (GL_ARRAY_BUFFER, volumeMarcherVBO);
 
 	//enable vertex attribute array for position
 	glEnableVertexAttribArray(0);
@@ -122,6 +254,44 @@ void OnInit() {
 	glEnableVertexAttribArray(1);
 	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,sizeof(Vertex),(const GLvoid*)offsetof(Vertex, normal));
 
+	//the GPU marcher vertex array object reads the vertices written by
+	//transform feedback with the same attributes
+	glGenVertexArrays(1, &gpuMarcherVAO);
+	glBindVertexArray(gpuMarcherVAO);
+	glBindBuffer (GL_ARRAY_BUFFER, gpuMarcher->GetVertexBuffer());
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,sizeof(Vertex),0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,sizeof(Vertex),(const GLvoid*)offsetof(Vertex, normal));
+
+	GL_CHECK_ERRORS
+
+	//create the dual contourer with the same volume and sampling
+	contourer = new DualContourer();
+	contourer->SetVolumeDimensions(256,256,256);
+	if(!contourer->LoadVolume(volume_file)) {
+		cout<<"Cannot load volume data."<<endl;
+		exit(EXIT_FAILURE);
+	}
+	contourer->SetIsosurfaceValue(isoValue);
+	contourer->SetNumSamplingVoxels(128,128,128);
+
+	//setup the dual contouring vertex array object with its vertex and
+	//index buffer objects, the attributes match the marcher's
+	glGenVertexArrays(1, &dualContourVAO);
+	glGenBuffers(1, &dualContourVBO);
+	glGenBuffers(1, &dualContourIBO);
+	glBindVertexArray(dualContourVAO);
+	glBindBuffer (GL_ARRAY_BUFFER, dualContourVBO);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,sizeof(Vertex),0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,sizeof(Vertex),(const GLvoid*)offsetof(Vertex, normal));
+
+	//extract the dual contouring mesh
+	UpdateDualContour();
+	UpdateTitle();
+
 	GL_CHECK_ERRORS
 
 	//load the shader 
@@ -153,9 +323,15 @@ void OnShutdown() {
 	shader.DeleteShaderProgram();
 	glDeleteVertexArrays(1, &volumeMarcherVAO);
 	glDeleteBuffers(1, &volumeMarcherVBO);
+	glDeleteVertexArrays(1, &dualContourVAO);
+	glDeleteBuffers(1, &dualContourVBO);
+	glDeleteBuffers(1, &dualContourIBO);
+	glDeleteVertexArrays(1, &gpuMarcherVAO);
 
 	delete grid;
 	delete marcher;
+	delete contourer;
+	delete gpuMarcher;
 	cout<<"Shutdown successfull"<<endl;
 }
 
@@ -192,16 +368,27 @@ void OnRender() {
 	if(bWireframe)
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 	
-	//set the volume marcher vertex array object
-	glBindVertexArray(volumeMarcherVAO);
-		//bind the shader
-		shader.Use();
-			//set the shader uniforms
-			glUniformMatrix4fv(shader("MVP"), 1, GL_FALSE, glm::value_ptr(MVP*T));
-				//render the triangles
-				glDrawArrays(GL_TRIANGLES, 0, marcher->GetTotalVertices());
-		//unbind the shader
-		shader.UnUse();
+	//bind the shader
+	shader.Use();
+		//set the shader uniforms
+		glUniformMatrix4fv(shader("MVP"), 1, GL_FALSE, glm::value_ptr(MVP*T));
+			//set the vertex array object of the backend and render the triangles
+			switch(backend) {
+				case CPU_MARCHING:
+					glBindVertexArray(volumeMarcherVAO);
+					glDrawArrays(GL_TRIANGLES, 0, marcher->GetTotalVertices());
+					break;
+				case GPU_MARCHING:
+					glBindVertexArray(gpuMarcherVAO);
+					glDrawArrays(GL_TRIANGLES, 0, gpuMarcher->GetTotalVertices());
+					break;
+				case DUAL_CONTOURING:
+					glBindVertexArray(dualContourVAO);
+					glDrawElements(GL_TRIANGLES, contourer->GetTotalIndices(), GL_UNSIGNED_INT, 0);
+					break;
+			}
+	//unbind the shader
+	shader.UnUse();
 	
 	//restore the default polygon mode
 	if(bWireframe)
@@ -211,11 +398,18 @@ void OnRender() {
 	glutSwapBuffers();
 }
 
-//keyboard function to change the wireframe rendering mode
+//keyboard function to change the wireframe rendering mode, the extraction
+//backend and the dual contouring merge tolerance
 void OnKey(unsigned char key, int x, int y) {
 	switch(key) {
 		case 'w': 	bWireframe = !bWireframe;	break; 
+		case '1':	backend = CPU_MARCHING;	if(bCPUMarcherDirty) UpdateCPUMarcher();	break;
+		case '2':	backend = GPU_MARCHING;	break;
+		case '3':	backend = DUAL_CONTOURING;	if(bDualContourDirty) UpdateDualContour();	break;
+		case '+':	errorTolerance += 0.05f;	UpdateDualContour();	break;
+		case '-':	errorTolerance = max(errorTolerance-0.05f, 0.0f);	UpdateDualContour();	break;
 	}
+	UpdateTitle();
 	//recall display function
 	glutPostRedisplay();
 }
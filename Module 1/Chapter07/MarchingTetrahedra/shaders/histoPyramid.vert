@@ -0,0 +1,9 @@
+#version 330 core
+
+//draws one triangle covering the whole viewport without vertex attributes,
+//used to run the classification and reduction fragment shaders once per cell
+void main()
+{
+	vec2 pos = vec2((gl_VertexID<<1)&2, gl_VertexID&2);
+	gl_Position = vec4(pos*2.0-1.0, 0, 1);
+}
\ No newline at end of file
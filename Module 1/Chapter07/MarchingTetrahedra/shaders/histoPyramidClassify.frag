@@ -0,0 +1,39 @@
+#version 330 core
+
+layout(location = 0) out uint vCount;	//fragment shader output, triangles of the cell
+
+//uniforms
+uniform usampler3D volume;			//volume dataset
+uniform usampler2D triCount;		//number of triangles of each cube index
+uniform ivec3 volumeSize;			//volume dimensions
+uniform ivec3 stepSize;				//sampling distance in voxels
+uniform ivec3 cells;				//number of cells along each axis
+uniform int layer;					//slice of cells being classified
+uniform int isoValue;				//isosurface value
+uniform ivec3 vertexOffset[8];		//cube corners, a2fVertexOffset in Tables.h
+
+//same as TetrahedraMarcher::SampleVolume, the linear index is clamped to the volume
+uint SampleVolume(ivec3 p) {
+	int index = clamp(p.x + p.y*volumeSize.x + p.z*volumeSize.x*volumeSize.y, 0, volumeSize.x*volumeSize.y*volumeSize.z-1);
+	ivec3 q = ivec3(index%volumeSize.x, (index/volumeSize.x)%volumeSize.y, index/(volumeSize.x*volumeSize.y));
+	return texelFetch(volume, q, 0).r;
+}
+
+void main()
+{
+	//cells outside the volume and the padding of the pyramid give no triangles
+	ivec3 cell = ivec3(ivec2(gl_FragCoord.xy), layer);
+	if(any(greaterThanEqual(cell, cells))) {
+		vCount = 0u;
+		return;
+	}
+
+	//flag the corners at or below the isovalue as TetrahedraMarcher::SampleVoxel does
+	ivec3 pos = cell*stepSize;
+	int cubeIndex = 0;
+	for(int i=0;i<8;i++) {
+		if(int(SampleVolume(pos + vertexOffset[i]*stepSize)) <= isoValue)
+			cubeIndex |= 1<<i;
+	}
+	vCount = texelFetch(triCount, ivec2(cubeIndex, 0), 0).r;
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#version 330 core
+
+//outputs captured by transform feedback, laid out as the Vertex structure
+out vec3 vPosition;		//vertex position scaled to the unit cube
+out vec3 vNormal;		//vertex normal
+
+//uniforms
+uniform usampler3D volume;			//volume dataset
+uniform usampler3D pyramid;			//histogram pyramid of triangle counts
+uniform isampler2D triTable;		//a2iTriangleConnectionTable in Tables.h
+uniform ivec3 volumeSize;			//volume dimensions
+uniform vec3 invDim;				//inverse volume dimensions
+uniform ivec3 stepSize;				//sampling distance in voxels
+uniform int isoValue;				//isosurface value
+uniform int topLevel;				//the 1x1x1 level of the pyramid
+uniform ivec3 vertexOffset[8];		//cube corners, a2fVertexOffset in Tables.h
+uniform ivec2 edgeConnection[12];	//edge end points, a2iEdgeConnection in Tables.h
+
+//same as TetrahedraMarcher::SampleVolume, the linear index is clamped to the volume
+uint SampleVolume(ivec3 p) {
+	int index = clamp(p.x + p.y*volumeSize.x + p.z*volumeSize.x*volumeSize.y, 0, volumeSize.x*volumeSize.y*volumeSize.z-1);
+	ivec3 q = ivec3(index%volumeSize.x, (index/volumeSize.x)%volumeSize.y, index/(volumeSize.x*volumeSize.y));
+	return texelFetch(volume, q, 0).r;
+}
+
+//same as TetrahedraMarcher::GetNormal, center finite difference approximation
+vec3 GetNormal(ivec3 p) {
+	vec3 N;
+	N.x = (float(SampleVolume(p-ivec3(1,0,0))) - float(SampleVolume(p+ivec3(1,0,0))))*0.5;
+	N.y = (float(SampleVolume(p-ivec3(0,1,0))) - float(SampleVolume(p+ivec3(0,1,0))))*0.5;
+	N.z = (float(SampleVolume(p-ivec3(0,0,1))) - float(SampleVolume(p+ivec3(0,0,1))))*0.5;
+	return normalize(N);
+}
+
+void main()
+{
+	//walk down the pyramid to the cell holding this triangle, the index
+	//drops the triangles of the cells skipped on the way
+	int index = gl_VertexID/3;
+	ivec3 cell = ivec3(0);
+	for(int level=topLevel-1;level>=0;level--) {
+		ivec3 first = 2*cell;
+		for(int i=0;i<8;i++) {
+			ivec3 child = first + ivec3(i&1, (i>>1)&1, (i>>2)&1);
+			int count = int(texelFetch(pyramid, child, level).r);
+			if(index < count) {
+				cell = child;
+				break;
+			}
+			index -= count;
+		}
+	}
+
+	//classify the cell again to get its cube index
+	ivec3 pos = cell*stepSize;
+	float values[8];
+	int cubeIndex = 0;
+	for(int i=0;i<8;i++) {
+		uint value = SampleVolume(pos + vertexOffset[i]*stepSize);
+		values[i] = float(value);
+		if(int(value) <= isoValue)
+			cubeIndex |= 1<<i;
+	}
+
+	//the edge of this vertex and the position of the isovalue on it
+	int edge = texelFetch(triTable, ivec2(3*index + gl_VertexID%3, cubeIndex), 0).r;
+	ivec2 ends = edgeConnection[edge];
+	float delta = values[ends.y]-values[ends.x];
+	float offset = (delta == 0.0) ? 0.5 : (float(isoValue)-values[ends.x])/delta;
+	vec3 edgeDirection = vec3(vertexOffset[ends.y]-vertexOffset[ends.x]);
+	vec3 p = vec3(pos) + (vec3(vertexOffset[ends.x]) + offset*edgeDirection)*vec3(stepSize);
+
+	vNormal = GetNormal(ivec3(p));
+	vPosition = p*invDim;
+}
\ No newline at end of file
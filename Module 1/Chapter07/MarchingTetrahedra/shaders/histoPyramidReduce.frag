@@ -0,0 +1,17 @@
+#version 330 core
+
+layout(location = 0) out uint vSum;	//fragment shader output, triangles of the 8 cells
+
+//uniforms
+uniform usampler3D pyramid;		//pyramid with the level below as its base level
+uniform int layer;				//slice of the level being written
+
+void main()
+{
+	//add up the 2x2x2 cells of the level below
+	ivec3 pos = 2*ivec3(ivec2(gl_FragCoord.xy), layer);
+	uint sum = 0u;
+	for(int i=0;i<8;i++)
+		sum += texelFetch(pyramid, pos + ivec3(i&1, (i>>1)&1, (i>>2)&1), 0).r;
+	vSum = sum;
+}
\ No newline at end of file
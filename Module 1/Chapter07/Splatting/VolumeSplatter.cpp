@@ -1,7 +1,78 @@
 #include "VolumeSplatter.h"
 #include "Tables.h"
+#include "..\src\Timer.h"
 
 #include <fstream> 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+//largest number of splats in a hierarchy leaf
+const int LEAF_SIZE = 8;
+
+//the splats overlap their neighbours by this factor of the sampling distance
+const float SPLAT_OVERLAP = 1.3f;
+
+//the hierarchy is cut into at least this many subtrees which are traversed in parallel
+const int MIN_SUBTREES = 64;
+
+//distance to the near clip plane, nodes closer than this are never drawn as one splat
+const float NEAR_DIST = 0.1f;
+
+//bits of the depth key sorted per radix sort pass
+const int RADIX_BITS = 8;
+const int RADIX_SIZE = 1<<RADIX_BITS;
+
+//splats are sorted by a single thread below this count
+const int MIN_PARALLEL_SORT = 16384;
+
+//culling states of a node
+enum NodeState { NODE_CULLED, NODE_DRAWN, NODE_EXPANDED };
+
+struct VolumeSplatter::SplatJob {
+	VolumeSplatter* splatter;
+	int dx, dy, dz;
+	std::vector<std::vector<Vertex> >* slices;
+};
+
+struct VolumeSplatter::SelectJob {
+	VolumeSplatter* splatter;
+	//frustum planes, object space eye position and the modelview row giving the depth
+	glm::vec4 planes[6];
+	glm::vec3 eye;
+	glm::vec4 depthRow;
+	//projected diameter in pixels of a unit radius at unit depth
+	float pixelScale;
+	float pixelThreshold;
+	bool cullBackfaces;
+	bool backToFront;
+	//subtree roots with their active frustum planes
+	std::vector<std::pair<int, int> > subtrees;
+};
+
+struct VolumeSplatter::SortJob {
+	const GLuint* keys;
+	const GLuint* values;
+	GLuint* outKeys;
+	GLuint* outValues;
+	size_t* histograms;
+	size_t total, chunk;
+	int shift;
+};
+
+//converts a depth to an unsigned key that sorts in the same order
+static inline GLuint DepthKey(float depth, bool backToFront) {
+	GLuint bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	bits ^= (bits & 0x80000000u) ? 0xffffffffu : 0x80000000u;
+	return backToFront ? ~bits : bits;
+}
+
+//returns the view depth of the given object space point
+static inline float Depth(const glm::vec4& depthRow, const glm::vec3& p) {
+	return -(depthRow.x*p.x + depthRow.y*p.y + depthRow.z*p.z + depthRow.w);
+}
 
 VolumeSplatter::VolumeSplatter(void)
 {
@@ -9,11 +80,16 @@ VolumeSplatter::VolumeSplatter(void)
 	YDIM = 256;
 	ZDIM = 256;
 	pVolume = NULL; 
-
+	totalSplats = 0;
+	splatRadius = 0;
+	selectTime = 0;
+	sortTime = 0;
+	pool.Init();
 } 
 
 VolumeSplatter::~VolumeSplatter(void)
 { 
+	pool.Destroy();
 	if(pVolume!=NULL) {
 		delete [] pVolume;
 		pVolume = NULL;
@@ -41,8 +117,8 @@ bool VolumeSplatter::LoadVolume(const std::string& filename) {
 	std::ifstream infile(filename.c_str(), std::ios_base::binary); 
 
 	if(infile.good()) {
-		pVolume = new GLubyte[XDIM*YDIM*ZDIM];
-		infile.read(reinterpret_cast<char*>(pVolume), XDIM*YDIM*ZDIM*sizeof(GLubyte));
+		pVolume = new GLubyte[size_t(XDIM)*YDIM*ZDIM];
+		infile.read(reinterpret_cast<char*>(pVolume), size_t(XDIM)*YDIM*ZDIM*sizeof(GLubyte));
 		infile.close();
 		return true;
 	} else {
@@ -50,7 +126,7 @@ bool VolumeSplatter::LoadVolume(const std::string& filename) {
 	}
 } 
 
-void VolumeSplatter::SampleVoxel(const int x, const int y, const int z) {
+void VolumeSplatter::SampleVoxel(const int x, const int y, const int z, std::vector<Vertex>& output) {
 	GLubyte data = SampleVolume(x, y, z);
 	if(data>isoValue) {
 		Vertex v; 
@@ -59,30 +135,368 @@ void VolumeSplatter::SampleVoxel(const int x, const int y, const int z) {
 		v.pos.z = (float)z;			 			
 		v.normal = GetNormal(x, y, z);
 		v.pos *= invDim; 
-		vertices.push_back(v);
+		v.radius = splatRadius;
+		output.push_back(v);
+	}
+}
+
+void VolumeSplatter::SplatSlices(int task, void* data) {
+	SplatJob& job = *(SplatJob*)data;
+	VolumeSplatter* splatter = job.splatter;
+	std::vector<Vertex>& output = (*job.slices)[task];
+	output.clear();
+	int z = task*job.dz;
+	for(int y=0;y<splatter->YDIM;y+=job.dy) {
+		for(int x=0;x<splatter->XDIM;x+=job.dx) {
+			splatter->SampleVoxel(x,y,z,output);
+		}
 	} 
 }
 
 void VolumeSplatter::SplatVolume() {
 	vertices.clear(); 
+	nodes.clear();
+	totalSplats = 0;
+	if(pVolume==NULL)
+		return;
+
 	int dx = XDIM/X_SAMPLING_DIST;
 	int dy = YDIM/Y_SAMPLING_DIST;
 	int dz = ZDIM/Z_SAMPLING_DIST;
 	scale = glm::vec3(dx,dy,dz); 
-	for(int z=0;z<ZDIM;z+=dz) {
-		for(int y=0;y<YDIM;y+=dy) {
-			for(int x=0;x<XDIM;x+=dx) {
-				SampleVoxel(x,y,z);
+
+	//the splats cover the sampling distance with some overlap
+	splatRadius = 0.5f*SPLAT_OVERLAP*std::max(dx*invDim.x, std::max(dy*invDim.y, dz*invDim.z));
+
+	//each z slice is sampled by its own task and the slices are
+	//appended in order, so the splats come out in x/y/z order
+	std::vector<std::vector<Vertex> > slices((ZDIM+dz-1)/dz);
+	SplatJob job;
+	job.splatter = this;
+	job.dx = dx;
+	job.dy = dy;
+	job.dz = dz;
+	job.slices = &slices;
+	pool.Run(int(slices.size()), SplatSlices, &job);
+
+	size_t total = 0;
+	for(size_t i=0;i<slices.size();i++)
+		total += slices[i].size();
+	vertices.reserve(total);
+	for(size_t i=0;i<slices.size();i++)
+		vertices.insert(vertices.end(), slices[i].begin(), slices[i].end());
+	totalSplats = vertices.size();
+}
+
+//orders splats along one axis
+struct SplatAxisLess {
+	int axis;
+	bool operator()(const Vertex& a, const Vertex& b) const { return a.pos[axis] < b.pos[axis]; }
+};
+
+int VolumeSplatter::BuildNode(const int first, const int count) {
+	int index = int(nodes.size());
+	nodes.push_back(SplatNode());
+
+	//bounding box and average normal of the splats
+	glm::vec3 minP(FLT_MAX), maxP(-FLT_MAX), sumN(0);
+	for(int i=first;i<first+count;i++) {
+		const Vertex& v = vertices[i];
+		minP = glm::min(minP, v.pos);
+		maxP = glm::max(maxP, v.pos);
+		//normals of flat regions are not a number
+		if(v.normal==v.normal)
+			sumN += v.normal;
+	}
+
+	SplatNode node;
+	node.center = (minP+maxP)*0.5f;
+	float maxDist2 = 0;
+	for(int i=first;i<first+count;i++) {
+		glm::vec3 d = vertices[i].pos-node.center;
+		maxDist2 = std::max(maxDist2, glm::dot(d,d));
+	}
+	node.radius = sqrt(maxDist2) + splatRadius;
+
+	//the normal cone is the largest angle to the average normal. If the
+	//normals cancel out, the cone is the whole sphere. Splats without a
+	//normal lie inside the surface and do not widen the cone.
+	float length = glm::length(sumN);
+	node.coneAngle = 3.14159265358979323846f;
+	node.normal = glm::vec3(0,0,1);
+	if(length > 1e-3f*count) {
+		node.normal = sumN/length;
+		float minCos = 1;
+		for(int i=first;i<first+count;i++) {
+			float c = glm::dot(vertices[i].normal, node.normal);
+			if(c==c)
+				minCos = std::min(minCos, c);
+		}
+		node.coneAngle = acos(std::max(-1.0f, std::min(1.0f, minCos)));
+	}
+	node.first = first;
+	node.count = count;
+	node.left = node.right = -1;
+
+	//split the splats at the median of the longest axis of the box
+	if(count > LEAF_SIZE) {
+		glm::vec3 extent = maxP-minP;
+		SplatAxisLess less;
+		less.axis = (extent.x>extent.y) ? (extent.x>extent.z ? 0 : 2) : (extent.y>extent.z ? 1 : 2);
+		int half = count/2;
+		std::nth_element(vertices.begin()+first, vertices.begin()+first+half, vertices.begin()+first+count, less);
+		node.left = BuildNode(first, half);
+		node.right = BuildNode(first+half, count-half);
+	}
+	nodes[index] = node;
+	return index;
+}
+
+void VolumeSplatter::BuildHierarchy() {
+	nodes.clear();
+	vertices.resize(totalSplats);
+	if(totalSplats==0)
+		return;
+
+	nodes.reserve(4*totalSplats/LEAF_SIZE+1);
+	BuildNode(0, int(totalSplats));
+
+	//append the splat that stands for each node
+	vertices.reserve(totalSplats+nodes.size());
+	for(size_t i=0;i<nodes.size();i++) {
+		Vertex v;
+		v.pos = nodes[i].center;
+		v.normal = nodes[i].normal;
+		v.radius = nodes[i].radius;
+		vertices.push_back(v);
+	}
+}
+
+int VolumeSplatter::ClassifyNode(const SelectJob& job, const SplatNode& node, int& planeMask) {
+	//view frustum culling of the bounding sphere
+	for(int i=0;i<6;i++) {
+		if(!(planeMask & (1<<i)))
+			continue;
+		float d = glm::dot(glm::vec3(job.planes[i]), node.center) + job.planes[i].w;
+		if(d < -node.radius)
+			return NODE_CULLED;
+		if(d > node.radius)
+			planeMask &= ~(1<<i);
+	}
+
+	glm::vec3 toNode = node.center-job.eye;
+	float dist = glm::length(toNode);
+
+	//backface culling with the normal cone. All normals in the cone face
+	//away from every point of the sphere if the angle from the view ray to
+	//the cone axis plus the cone and the sphere's angular radius is below 90
+	if(job.cullBackfaces && dist > node.radius) {
+		float viewAngle = acos(std::max(-1.0f, std::min(1.0f, glm::dot(toNode, node.normal)/dist)));
+		float sphereAngle = asin(node.radius/dist);
+		if(viewAngle + node.coneAngle + sphereAngle < 0.5f*3.14159265358979323846f)
+			return NODE_CULLED;
+	}
+
+	//draw the node as one splat if it is small enough on screen
+	float depth = Depth(job.depthRow, node.center);
+	if(depth-node.radius > NEAR_DIST && node.radius*job.pixelScale < job.pixelThreshold*depth)
+		return NODE_DRAWN;
+	return NODE_EXPANDED;
+}
+
+void VolumeSplatter::SelectSubtrees(int task, void* data) {
+	SelectJob& job = *(SelectJob*)data;
+	VolumeSplatter* splatter = job.splatter;
+	std::vector<GLuint>& keys = splatter->taskKeys[task];
+	std::vector<GLuint>& indices = splatter->taskIndices[task];
+	keys.clear();
+	indices.clear();
+
+	//depth first traversal of the subtree with an explicit stack
+	std::pair<int, int> stack[64];
+	int top = 0;
+	stack[top++] = job.subtrees[task];
+	while(top>0) {
+		int index = stack[--top].first;
+		int planeMask = stack[top].second;
+		const SplatNode& node = splatter->nodes[index];
+		int state = ClassifyNode(job, node, planeMask);
+		if(state==NODE_CULLED)
+			continue;
+		if(state==NODE_DRAWN) {
+			keys.push_back(DepthKey(Depth(job.depthRow, node.center), job.backToFront));
+			indices.push_back(GLuint(splatter->totalSplats+index));
+		} else if(node.left<0) {
+			//a leaf is drawn with its own splats
+			for(int i=node.first;i<node.first+node.count;i++) {
+				const Vertex& v = splatter->vertices[i];
+				if(job.cullBackfaces && glm::dot(v.pos-job.eye, v.normal) > 0)
+					continue;
+				keys.push_back(DepthKey(Depth(job.depthRow, v.pos), job.backToFront));
+				indices.push_back(GLuint(i));
+			}
+		} else {
+			stack[top++] = std::make_pair(node.right, planeMask);
+			stack[top++] = std::make_pair(node.left, planeMask);
+		}
+	}
+}
+
+void VolumeSplatter::SelectSplats(const glm::mat4& MV, const glm::mat4& P, const int viewportHeight, const float pixelThreshold,
+								  const bool cullBackfaces, const bool backToFront, std::vector<GLuint>& indices) {
+	CTimer timer;
+	indices.clear();
+	keys.clear();
+	values.clear();
+	if(nodes.empty()) {
+		selectTime = sortTime = 0;
+		return;
+	}
+
+	SelectJob job;
+	job.splatter = this;
+
+	//object space frustum planes from the rows of the combined matrix
+	glm::mat4 M = P*MV;
+	for(int i=0;i<3;i++) {
+		for(int s=0;s<2;s++) {
+			glm::vec4 plane;
+			for(int c=0;c<4;c++)
+				plane[c] = M[c][3] + (s==0 ? M[c][i] : -M[c][i]);
+			job.planes[i*2+s] = plane/glm::length(glm::vec3(plane));
+		}
+	}
+	job.eye = glm::vec3(glm::inverse(MV)*glm::vec4(0,0,0,1));
+	job.depthRow = glm::vec4(MV[0][2], MV[1][2], MV[2][2], MV[3][2]);
+	job.pixelScale = P[1][1]*viewportHeight;
+	job.pixelThreshold = pixelThreshold;
+	job.cullBackfaces = cullBackfaces;
+	job.backToFront = backToFront;
+
+	//expand the top of the hierarchy breadth first until there are enough
+	//subtrees to keep every thread busy. Nodes decided on the way are kept,
+	//leaves are left to the tasks.
+	std::vector<std::pair<int, int> >& subtrees = job.subtrees;
+	std::vector<std::pair<int, int> > open;
+	open.push_back(std::make_pair(0, 63));
+	size_t next = 0;
+	while(next < open.size() && open.size()-next+subtrees.size() < size_t(MIN_SUBTREES)) {
+		std::pair<int, int> item = open[next++];
+		const SplatNode& node = nodes[item.first];
+		if(node.left < 0) {
+			subtrees.push_back(item);
+			continue;
+		}
+		int planeMask = item.second;
+		int state = ClassifyNode(job, node, planeMask);
+		if(state==NODE_CULLED)
+			continue;
+		if(state==NODE_DRAWN) {
+			keys.push_back(DepthKey(Depth(job.depthRow, node.center), backToFront));
+			values.push_back(GLuint(totalSplats+item.first));
+			continue;
+		}
+		open.push_back(std::make_pair(node.left, planeMask));
+		open.push_back(std::make_pair(node.right, planeMask));
+	}
+	subtrees.insert(subtrees.end(), open.begin()+next, open.end());
+
+	//traverse the subtrees in parallel and gather their splats
+	taskKeys.resize(subtrees.size());
+	taskIndices.resize(subtrees.size());
+	pool.Run(int(subtrees.size()), SelectSubtrees, &job);
+	for(size_t i=0;i<subtrees.size();i++) {
+		keys.insert(keys.end(), taskKeys[i].begin(), taskKeys[i].end());
+		values.insert(values.end(), taskIndices[i].begin(), taskIndices[i].end());
+	}
+	selectTime = timer.Elapsed();
+	timer.Start();
+
+	SortByDepth();
+	indices.swap(values);
+	sortTime = timer.Elapsed();
+}
+
+void VolumeSplatter::CountDigits(int task, void* data) {
+	SortJob& job = *(SortJob*)data;
+	size_t* histogram = job.histograms + size_t(task)*RADIX_SIZE;
+	std::fill(histogram, histogram+RADIX_SIZE, size_t(0));
+	size_t first = task*job.chunk;
+	size_t last = std::min(first+job.chunk, job.total);
+	for(size_t i=first;i<last;i++)
+		histogram[(job.keys[i]>>job.shift) & (RADIX_SIZE-1)]++;
+}
+
+void VolumeSplatter::ScatterDigits(int task, void* data) {
+	SortJob& job = *(SortJob*)data;
+	//the histogram holds the output offset of each digit for this task
+	size_t* offset = job.histograms + size_t(task)*RADIX_SIZE;
+	size_t first = task*job.chunk;
+	size_t last = std::min(first+job.chunk, job.total);
+	for(size_t i=first;i<last;i++) {
+		size_t j = offset[(job.keys[i]>>job.shift) & (RADIX_SIZE-1)]++;
+		job.outKeys[j] = job.keys[i];
+		job.outValues[j] = job.values[i];
+	}
+}
+
+void VolumeSplatter::SortByDepth() {
+	//least significant digit radix sort. Each task counts the digits of its
+	//chunk, the counts are turned into per task output offsets and each task
+	//scatters its chunk, which keeps every pass stable.
+	const size_t total = keys.size();
+	if(total < 2)
+		return;
+	const int tasks = total < size_t(MIN_PARALLEL_SORT) ? 1 : pool.GetTotalThreads();
+	tempKeys.resize(total);
+	tempValues.resize(total);
+	histograms.resize(size_t(tasks)*RADIX_SIZE);
+
+	SortJob job;
+	job.histograms = &histograms[0];
+	job.total = total;
+	job.chunk = (total+tasks-1)/tasks;
+	for(int shift=0;shift<32;shift+=RADIX_BITS) {
+		job.keys = &keys[0];
+		job.values = &values[0];
+		job.outKeys = &tempKeys[0];
+		job.outValues = &tempValues[0];
+		job.shift = shift;
+		pool.Run(tasks, CountDigits, &job);
+
+		//skip the pass if every key has the same digit
+		bool uniform = false;
+		size_t offset = 0;
+		for(int d=0;d<RADIX_SIZE && !uniform;d++) {
+			size_t count = 0;
+			for(int t=0;t<tasks;t++) {
+				size_t c = histograms[size_t(t)*RADIX_SIZE+d];
+				histograms[size_t(t)*RADIX_SIZE+d] = offset+count;
+				count += c;
 			}
+			uniform = (count==total);
+			offset += count;
 		}
+		if(uniform)
+			continue;
+
+		pool.Run(tasks, ScatterDigits, &job);
+		keys.swap(tempKeys);
+		values.swap(tempValues);
 	}
 }
   
 size_t VolumeSplatter::GetTotalVertices() {
 	return vertices.size();
 }
+size_t VolumeSplatter::GetTotalSplats() {
+	return totalSplats;
+}
+size_t VolumeSplatter::GetTotalNodes() {
+	return nodes.size();
+}
 Vertex* VolumeSplatter::GetVertexPointer() {
-	return  &vertices[0];
+	return vertices.empty() ? NULL : &vertices[0];
 } 
 
 GLubyte VolumeSplatter::SampleVolume(const int x, const int y, const int z) {
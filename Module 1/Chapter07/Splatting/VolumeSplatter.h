@@ -3,10 +3,24 @@
 #include <string.h>
 #include <glm/glm.hpp>
 #include <vector>
+#include "..\src\ThreadPool.h"
 
-//our vertex struct stores the position and normals
+//our vertex struct stores the position, normal and the object space splat radius
 struct Vertex {
 	glm::vec3 pos, normal;
+	float radius;
+};
+
+//a node of the bounding sphere hierarchy over the splats. It covers the
+//splats [first, first+count) and bounds their normals by a cone around the
+//average normal. Leaves have no children (left is -1).
+struct SplatNode {
+	glm::vec3 center;
+	float radius;
+	glm::vec3 normal;
+	float coneAngle;
+	int first, count;
+	int left, right;
 };
 
 //VolumeSplatter class
@@ -33,12 +47,34 @@ public:
 	//splat the volume dataset
 	void SplatVolume();
 
+	//build the bounding sphere hierarchy over the splats. This reorders the
+	//splats and appends one splat per node, which stands for the node when
+	//it is drawn in place of its splats.
+	void BuildHierarchy();
+
+	//select the splats to draw for the given modelview and projection matrix
+	//and viewport height. The hierarchy is cut where a node covers less than
+	//pixelThreshold pixels, nodes outside the view frustum are skipped and,
+	//if cullBackfaces is set, so are nodes whose normals all face away. The
+	//vertex indices are returned sorted by view depth, front to back or
+	//back to front.
+	void SelectSplats(const glm::mat4& MV, const glm::mat4& P, const int viewportHeight, const float pixelThreshold,
+					  const bool cullBackfaces, const bool backToFront, std::vector<GLuint>& indices);
+
 	//get the total number of vertices generated
 	size_t GetTotalVertices();
 
+	//get the number of splats and hierarchy nodes
+	size_t GetTotalSplats();
+	size_t GetTotalNodes();
+
 	//get the pointer to the vertex buffer
 	Vertex* GetVertexPointer();
 
+	//time taken by the last splat selection and the depth sort in milliseconds
+	float GetSelectTime() { return selectTime; }
+	float GetSortTime() { return sortTime; }
+
 protected:
 	//volume sampling function, give the x,y,z values returns the density value 
 	//in the volume at that location
@@ -47,8 +83,27 @@ protected:
 	//get the normal at the given location using center finite difference approximation
 	glm::vec3 GetNormal(const int x, const int y, const int z);
 
-	//samples a voxel at the given location
-	void SampleVoxel(const int x, const int y, const int z); 
+	//samples a voxel at the given location into the given vertex list
+	void SampleVoxel(const int x, const int y, const int z, std::vector<Vertex>& output); 
+
+	//builds the hierarchy node for the splats [first, first+count) and 
+	//returns its index
+	int BuildNode(const int first, const int count);
+
+	//sorts the selected splat indices by their depth keys
+	void SortByDepth();
+
+	struct SplatJob;
+	struct SelectJob;
+	struct SortJob;
+	static void SplatSlices(int task, void* data);
+	static void SelectSubtrees(int task, void* data);
+
+	//decides if a node is culled, drawn as one splat or expanded, and drops
+	//the frustum planes its sphere is completely inside of from planeMask
+	static int ClassifyNode(const SelectJob& job, const SplatNode& node, int& planeMask);
+	static void CountDigits(int task, void* data);
+	static void ScatterDigits(int task, void* data);
 
 	//the volume dataset dimensions and inverse volume dimensions
 	int XDIM, YDIM, ZDIM;
@@ -71,5 +126,22 @@ protected:
 	//vertices vector storing positions and normals
 	std::vector<Vertex> vertices; 
 
+	//number of splats at the start of the vertices vector and radius of a splat
+	size_t totalSplats;
+	float splatRadius;
+
+	//the bounding sphere hierarchy, the root is the first node
+	std::vector<SplatNode> nodes;
+
+	//worker threads for splatting, splat selection and sorting
+	CThreadPool pool;
+
+	//per task selected splats and the depth keys and vertex indices to sort
+	std::vector<std::vector<GLuint> > taskKeys, taskIndices;
+	std::vector<GLuint> keys, values, tempKeys, tempValues;
+	std::vector<size_t> histograms;
+
+	float selectTime, sortTime;
+
 };
 
@@ -9,6 +9,8 @@
 
 #include "..\src\GLSLShader.h"
 #include <fstream>
+#include <sstream>
+#include <vector>
 
 #define GL_CHECK_ERRORS assert(glGetError()== GL_NO_ERROR);
 
@@ -38,14 +40,37 @@ glm::mat4 MV,P;
 GLuint volumeSplatterVBO;
 GLuint volumeSplatterVAO;
 
+//index buffer object ID holding the visible splats sorted by depth
+GLuint volumeSplatterIBO;
+
+//visible splat indices of the current frame
+std::vector<GLuint> visibleSplats;
+
 //shaders for splatter, gaussian smoothing and fillscreen quad rendering
 GLSLShader shader, gaussianV_shader, gaussianH_shader, quadShader;
 
 //background colour
 glm::vec4 bg=glm::vec4(0,0,0,1);
 
-//volume data filename
+//volume data filename and dimensions
 const std::string volume_file = "../media/Engine256.raw";
+const int XDIM = 256;
+const int YDIM = 256;
+const int ZDIM = 256;
+
+//number of sampling voxels along each axis. The splat hierarchy picks the 
+//level of detail per view, so every voxel can be sampled.
+const int SAMPLING_VOXELS = 256;
+
+//hierarchy nodes smaller than this many pixels on screen are drawn as one splat
+float pixelThreshold = 4;
+
+//flag to skip splats whose normals face away from the viewer
+bool bCullBackfaces = true;
+
+//flag to blend soft splats back to front instead of drawing opaque 
+//discs front to back
+bool bBlendSplats = false;
  
 //VolumeSplatter instance
 #include "VolumeSplatter.h"
@@ -102,17 +127,21 @@ void OnInit() {
 	//create volume splatter instance
 	splatter = new VolumeSplatter();
 	//set volume dimentsions
-	splatter->SetVolumeDimensions(256,256,256);
+	splatter->SetVolumeDimensions(XDIM,YDIM,ZDIM);
 	//load volume data
 	splatter->LoadVolume(volume_file);
 	//set the required isosurface value
 	splatter->SetIsosurfaceValue(40);
 	//set the number of sampling voxels
-	splatter->SetNumSamplingVoxels(64,64,64);
+	splatter->SetNumSamplingVoxels(SAMPLING_VOXELS,SAMPLING_VOXELS,SAMPLING_VOXELS);
 	std::cout<<"Generating point splats ...";
 	//splat volumes
 	splatter->SplatVolume();
 	std::cout<<"Done."<<std::endl;
+	//build the bounding sphere hierarchy used to select the splats per view
+	std::cout<<"Building splat hierarchy ...";
+	splatter->BuildHierarchy();
+	std::cout<<"Done. "<<splatter->GetTotalSplats()<<" splats, "<<splatter->GetTotalNodes()<<" nodes."<<std::endl;
 
 	//generate the vertex array and vertex buffer objects
 	glGenVertexArrays(1, &volumeSplatterVAO);
@@ -131,6 +160,16 @@ void OnInit() {
 	glEnableVertexAttribArray(1);
 	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,sizeof(Vertex),(const GLvoid*)offsetof(Vertex, normal));
 
+	//enable vertex attrib array for splat radii
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE,sizeof(Vertex),(const GLvoid*)offsetof(Vertex, radius));
+
+	//the index buffer is refilled with the visible splats every frame
+	glGenBuffers(1, &volumeSplatterIBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, volumeSplatterIBO);
+
+	glBindVertexArray(0);
+
 	GL_CHECK_ERRORS
 
 	//load shader
@@ -142,12 +181,12 @@ void OnInit() {
 		//add attributes and uniforms
 		shader.AddAttribute("vVertex");
 		shader.AddAttribute("vNormal");
+		shader.AddAttribute("vRadius");
 		shader.AddUniform("MV");
 		shader.AddUniform("N");
 		shader.AddUniform("P");
-		shader.AddUniform("splatSize");
-		//set constant uniforms once
-		glUniform1f(shader("splatSize"), 256/64);
+		shader.AddUniform("pixelScale");
+		shader.AddUniform("blendSplats");
 	shader.UnUse();
 
 	GL_CHECK_ERRORS
@@ -334,6 +373,7 @@ void OnShutdown() {
 
 	glDeleteVertexArrays(1, &volumeSplatterVAO);
 	glDeleteBuffers(1, &volumeSplatterVBO);
+	glDeleteBuffers(1, &volumeSplatterIBO);
 
 	delete splatter;
 
@@ -380,19 +420,40 @@ void OnRender() {
 	//set the modelling transform to bring the splatting output to origin
 	glm::mat4 T = glm::translate(glm::mat4(1), glm::vec3(-0.5,-0.5,-0.5));
 
+	//select the visible splats from the hierarchy sorted by depth. Opaque
+	//splats are drawn front to back so that hidden ones fail the depth test
+	//early, blended splats back to front for correct compositing.
+	splatter->SelectSplats(MV*T, P, IMAGE_HEIGHT, pixelThreshold, bCullBackfaces, bBlendSplats, visibleSplats);
+
 	//bind the splatter vertex array object
 	glBindVertexArray(volumeSplatterVAO);
+		//pass the visible splat indices to the index buffer
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, visibleSplats.size()*sizeof(GLuint), visibleSplats.empty() ? NULL : &visibleSplats[0], GL_STREAM_DRAW);
+
+		if(bBlendSplats) {
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glDepthMask(GL_FALSE);
+		}
+
 		//bind the splatting shader
 		shader.Use();
 			//set the shader uniforms
 			glUniformMatrix4fv(shader("MV"), 1, GL_FALSE, glm::value_ptr(MV*T));
 			glUniformMatrix3fv(shader("N"), 1, GL_FALSE, glm::value_ptr(glm::inverseTranspose(glm::mat3(MV*T))));
 			glUniformMatrix4fv(shader("P"), 1, GL_FALSE, glm::value_ptr(P));
-				//draw points
-				glDrawArrays(GL_POINTS, 0, splatter->GetTotalVertices());
+			glUniform1f(shader("pixelScale"), P[1][1]*IMAGE_HEIGHT);
+			glUniform1i(shader("blendSplats"), bBlendSplats);
+				//draw the visible points
+				glDrawElements(GL_POINTS, GLsizei(visibleSplats.size()), GL_UNSIGNED_INT, 0);
 		//unbind the splatting shader
 		shader.UnUse();
 
+		if(bBlendSplats) {
+			glDisable(GL_BLEND);
+			glDepthMask(GL_TRUE);
+		}
+
 	//bind the quad vertex array object
 	glBindVertexArray(quadVAOID);
 
@@ -428,10 +489,44 @@ void OnRender() {
 	//unbind vertex array object
 	glBindVertexArray(0);
 
+	//show the number of splats drawn and the time taken to select and sort them
+	std::stringstream str;
+	str<<"Volume Splatting - "<<visibleSplats.size()<<" of "<<splatter->GetTotalSplats()<<" splats";
+	str<<", Threshold: "<<pixelThreshold<<" px";
+	str<<", Backface culling: "<<(bCullBackfaces ? "on" : "off");
+	str<<", "<<(bBlendSplats ? "Blended" : "Opaque");
+	str<<", Select: "<<splatter->GetSelectTime()<<" ms, Sort: "<<splatter->GetSortTime()<<" ms";
+	glutSetWindowTitle(str.str().c_str());
+
 	//swap front and back buffers to show the rendered result
 	glutSwapBuffers();
 }
 
+//keyboard function to change the level of detail threshold, toggle backface
+//culling and switch between opaque and blended splats
+void OnKey(unsigned char key, int x, int y) {
+	switch(key) {
+		case '-':
+			pixelThreshold = max(0.5f, pixelThreshold-0.5f);
+			break;
+
+		case '+':
+			pixelThreshold = min(64.0f, pixelThreshold+0.5f);
+			break;
+
+		case 'c':
+			bCullBackfaces = !bCullBackfaces;
+			break;
+
+		case 'b':
+			bBlendSplats = !bBlendSplats;
+			break;
+	}
+
+	//recall display function
+	glutPostRedisplay();
+}
+
 
 int main(int argc, char** argv) {
 	//freeglut initialization
@@ -474,6 +569,7 @@ int main(int argc, char** argv) {
 	glutReshapeFunc(OnResize);
 	glutMouseFunc(OnMouseDown);
 	glutMotionFunc(OnMouseMove);
+	glutKeyboardFunc(OnKey);
 
 	//main loop call
 	glutMainLoop();
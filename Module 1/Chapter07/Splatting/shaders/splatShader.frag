@@ -4,6 +4,9 @@ layout(location = 0) out vec4 vFragColor;	//fragment shader output
 
 smooth in vec3 outNormal;	//eye space per-vertex normal 
 							//interpolated varying input from vertex shader
+
+//uniform
+uniform bool blendSplats;	//fade the splat out towards its border for blending
   
 //constants
 const vec3 L = vec3(0,0,1);	//light vector
@@ -32,4 +35,8 @@ void main()
 
 	//set the final fragment shader by combining the diffuse and specular components
 	vFragColor =  (specular*specular_color) + (diffuse*diffuse_color);
+
+	//blended splats get a Gaussian falloff so that overlapping splats 
+	//composited back to front merge smoothly
+	vFragColor.a = blendSplats ? exp(-4.0*mag) : 1.0;
 }	
\ No newline at end of file
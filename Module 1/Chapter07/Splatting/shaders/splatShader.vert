@@ -2,12 +2,13 @@
   
 layout(location = 0) in vec3 vVertex;	//object space vertex position
 layout(location = 1) in vec3 vNormal;	//object space vertex normal
+layout(location = 2) in float vRadius;	//object space splat radius
    
 //uniforms
 uniform mat4 MV;			//modelview matrix
 uniform mat3 N;				//normal matrix
 uniform mat4 P;				//projection matrix		
-uniform float splatSize;	//splat size
+uniform float pixelScale;	//projected diameter in pixels of a unit radius at unit depth
 
 smooth out vec3 outNormal;	//output eye space normal
 
@@ -16,8 +17,8 @@ void main()
 	//get eye space vertex position
 	vec4 eyeSpaceVertex = MV*vec4(vVertex,1);
 	
-	//get the splat size by using the eye space vertex z component
-	gl_PointSize = 2*splatSize/-eyeSpaceVertex.z; 
+	//get the splat size by projecting the splat radius at the eye space depth
+	gl_PointSize = vRadius*pixelScale/-eyeSpaceVertex.z; 
 	
 	//get the clipspace position
 	gl_Position = P * eyeSpaceVertex; 
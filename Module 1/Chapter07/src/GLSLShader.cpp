@@ -10,6 +10,7 @@ GLSLShader::GLSLShader(void)
 	_shaders[GEOMETRY_SHADER]=0;
 	_attributeList.clear();
 	_uniformLocationList.clear();
+	_feedbackMode = GL_INTERLEAVED_ATTRIBS;
 }
 
 GLSLShader::~GLSLShader(void)
@@ -44,6 +45,11 @@ void GLSLShader::LoadFromString(GLenum type, const string& source) {
 }
 
 
+void GLSLShader::SetFeedbackVaryings(const vector<string>& varyings, GLenum bufferMode) {
+	_feedbackVaryings = varyings;
+	_feedbackMode = bufferMode;
+}
+
 void GLSLShader::CreateAndLinkProgram() {
 	_program = glCreateProgram ();
 	if (_shaders[VERTEX_SHADER] != 0) {
@@ -55,6 +61,14 @@ void GLSLShader::CreateAndLinkProgram() {
 	if (_shaders[GEOMETRY_SHADER] != 0) {
 		glAttachShader (_program, _shaders[GEOMETRY_SHADER]);
 	}
+
+	//the captured outputs have to be known before linking
+	if (!_feedbackVaryings.empty()) {
+		vector<const char*> names;
+		for (size_t i=0; i<_feedbackVaryings.size(); i++)
+			names.push_back(_feedbackVaryings[i].c_str());
+		glTransformFeedbackVaryings (_program, GLsizei(names.size()), &names[0], _feedbackMode);
+	}
 	
 	//link and check whether the program links fine
 	GLint status;
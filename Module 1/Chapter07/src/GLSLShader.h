@@ -2,6 +2,7 @@
 #include <GL/glew.h>
 #include <map>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -12,6 +13,8 @@ public:
 	~GLSLShader(void);	
 	void LoadFromString(GLenum whichShader, const string& source);
 	void LoadFromFile(GLenum whichShader, const string& filename);
+	//sets the outputs captured by transform feedback, call before CreateAndLinkProgram
+	void SetFeedbackVaryings(const vector<string>& varyings, GLenum bufferMode);
 	void CreateAndLinkProgram();
 	void Use();
 	void UnUse();
@@ -30,4 +33,6 @@ private:
 	GLuint _shaders[3];//0->vertexshader, 1->fragmentshader, 2->geometryshader
 	map<string,GLuint> _attributeList;
 	map<string,GLuint> _uniformLocationList;
+	vector<string> _feedbackVaryings;
+	GLenum _feedbackMode;
 };	
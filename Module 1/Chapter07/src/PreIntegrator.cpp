@@ -0,0 +1,176 @@
+#include "PreIntegrator.h"
+#include "Timer.h"
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#include <algorithm>
+#include <cmath>
+
+//largest transfer function opacity, full opacity has infinite extinction
+const float MAX_ALPHA = 0.9999f;
+
+//e^x for x in [-87, 88] from 2^x = 2^i * 2^f with a degree 6 polynomial for
+//2^f, accurate to about 1e-7 relative
+static inline __m128 Exp(__m128 x) {
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-87.0f)), _mm_set1_ps(88.0f));
+	__m128 t = _mm_mul_ps(x, _mm_set1_ps(1.44269504f));
+
+	//floor, truncation rounds negative values up
+	__m128i i = _mm_cvttps_epi32(t);
+	__m128 fi = _mm_cvtepi32_ps(i);
+	__m128 greater = _mm_cmpgt_ps(fi, t);
+	fi = _mm_sub_ps(fi, _mm_and_ps(greater, _mm_set1_ps(1.0f)));
+	i = _mm_cvtps_epi32(fi);
+	__m128 f = _mm_sub_ps(t, fi);
+
+	__m128 p = _mm_set1_ps(1.54035304e-4f);
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.33335581e-3f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(9.61812911e-3f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(5.55041087e-2f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(2.40226507e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(6.93147182e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+
+	//multiply by 2^i through the exponent bits
+	__m128i e = _mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(127)), 23);
+	return _mm_mul_ps(p, _mm_castsi128_ps(e));
+}
+
+//selects b where mask is set and a elsewhere
+static inline __m128 Select(__m128 a, __m128 b, __m128 mask) {
+	return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+}
+
+CPreIntegrator::CPreIntegrator(void)
+{
+	tf.resize(TABLE_SIZE*4);
+	tau.resize(TABLE_SIZE);
+	red.resize(TABLE_SIZE);
+	green.resize(TABLE_SIZE);
+	blue.resize(TABLE_SIZE);
+	T.resize(TABLE_SIZE);
+	KR.resize(TABLE_SIZE);
+	KG.resize(TABLE_SIZE);
+	KB.resize(TABLE_SIZE);
+	table.resize(TABLE_SIZE*TABLE_SIZE*4);
+	scale = 1;
+	valid = false;
+	lastTime = 0;
+	lastEntries = 0;
+}
+
+CPreIntegrator::~CPreIntegrator(void)
+{
+}
+
+bool CPreIntegrator::Update(const float* newTF, const float newScale) {
+	CTimer timer;
+
+	//find the range of changed entries, everything if the slab changed
+	int lo = 0, hi = TABLE_SIZE-1;
+	if(valid && newScale==scale) {
+		lo = TABLE_SIZE;
+		hi = -1;
+		for(int i=0;i<TABLE_SIZE;i++) {
+			if(std::equal(newTF+i*4, newTF+i*4+4, &tf[i*4]))
+				continue;
+			lo = std::min(lo, i);
+			hi = std::max(hi, i);
+		}
+		if(hi<0) {
+			lastEntries = 0;
+			lastTime = 0;
+			return false;
+		}
+	}
+	std::copy(newTF, newTF+TABLE_SIZE*4, tf.begin());
+	scale = newScale;
+	valid = true;
+
+	//extinction per reference thickness and colour of every entry
+	for(int i=0;i<TABLE_SIZE;i++) {
+		tau[i] = -log(1.0f - std::min(std::max(tf[i*4+3], 0.0f), MAX_ALPHA));
+		red[i] = tf[i*4];
+		green[i] = tf[i*4+1];
+		blue[i] = tf[i*4+2];
+	}
+
+	//prefix integrals of the extinction and the extinction weighted colour
+	//with the trapezoidal rule, exact for the piecewise linear extinction
+	T[0] = KR[0] = KG[0] = KB[0] = 0;
+	for(int i=1;i<TABLE_SIZE;i++) {
+		T[i]  = T[i-1]  + 0.5f*(tau[i-1] + tau[i]);
+		KR[i] = KR[i-1] + 0.5f*(tau[i-1]*red[i-1] + tau[i]*red[i]);
+		KG[i] = KG[i-1] + 0.5f*(tau[i-1]*green[i-1] + tau[i]*green[i]);
+		KB[i] = KB[i-1] + 0.5f*(tau[i-1]*blue[i-1] + tau[i]*blue[i]);
+	}
+
+	ComputeRows(lo, hi);
+
+	lastTime = timer.Elapsed();
+	return true;
+}
+
+void CPreIntegrator::ComputeRows(const int lo, const int hi) {
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 epsilon = _mm_set1_ps(1e-6f);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 negScale = _mm_set1_ps(-scale);
+	const __m128 lane = _mm_set_ps(3, 2, 1, 0);
+
+	lastEntries = 0;
+	for(int f=0;f<TABLE_SIZE;f++) {
+		//an entry depends on the entries between its two scalars, so a row
+		//in the changed range changes entirely and any other row only
+		//towards the changed range
+		int first = 0, last = TABLE_SIZE;
+		if(f<lo)
+			first = lo & ~3;
+		else if(f>hi)
+			last = hi+1;
+
+		const __m128 sf = _mm_set1_ps(float(f));
+		const __m128 Tf = _mm_set1_ps(T[f]);
+		const __m128 KRf = _mm_set1_ps(KR[f]), KGf = _mm_set1_ps(KG[f]), KBf = _mm_set1_ps(KB[f]);
+		const __m128 tauf = _mm_set1_ps(tau[f]);
+		const __m128 rf = _mm_set1_ps(red[f]), gf = _mm_set1_ps(green[f]), bf = _mm_set1_ps(blue[f]);
+		float* row = &table[size_t(f)*TABLE_SIZE*4];
+
+		for(int b=first;b<last;b+=4) {
+			__m128 ds = _mm_sub_ps(_mm_add_ps(_mm_set1_ps(float(b)), lane), sf);
+			__m128 dT = _mm_sub_ps(_mm_loadu_ps(&T[b]), Tf);
+
+			//average extinction over the scalar range, the extinction of
+			//the entry itself where both scalars are equal
+			__m128 same = _mm_cmpeq_ps(ds, zero);
+			__m128 averageTau = _mm_div_ps(dT, Select(ds, one, same));
+			averageTau = Select(averageTau, tauf, same);
+			__m128 alpha = _mm_sub_ps(one, Exp(_mm_mul_ps(negScale, averageTau)));
+
+			//extinction weighted average colour. Where there is no extinction
+			//the colour does not matter and the mean of the two ends is used.
+			__m128 transparent = _mm_cmple_ps(_mm_and_ps(dT, absMask), epsilon);
+			__m128 invDT = _mm_div_ps(one, Select(dT, one, transparent));
+			__m128 r = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&KR[b]), KRf), invDT);
+			__m128 g = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&KG[b]), KGf), invDT);
+			__m128 bl = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&KB[b]), KBf), invDT);
+			r = Select(r, _mm_mul_ps(half, _mm_add_ps(rf, _mm_loadu_ps(&red[b]))), transparent);
+			g = Select(g, _mm_mul_ps(half, _mm_add_ps(gf, _mm_loadu_ps(&green[b]))), transparent);
+			bl = Select(bl, _mm_mul_ps(half, _mm_add_ps(bf, _mm_loadu_ps(&blue[b]))), transparent);
+
+			//where both scalars are equal the colour is the entry's own
+			r = Select(r, rf, same);
+			g = Select(g, gf, same);
+			bl = Select(bl, bf, same);
+
+			//interleave to RGBA
+			_MM_TRANSPOSE4_PS(r, g, bl, alpha);
+			_mm_storeu_ps(row + b*4, r);
+			_mm_storeu_ps(row + b*4 + 4, g);
+			_mm_storeu_ps(row + b*4 + 8, bl);
+			_mm_storeu_ps(row + b*4 + 12, alpha);
+		}
+		lastEntries += last-first;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+
+//Pre-integrated classification for slice based volume rendering. For every
+//pair of scalars (front, back) sampled at the two faces of a slab, the table
+//holds the colour and opacity of the transfer function integrated over the
+//scalar range between them, so thin features of a sharp transfer function
+//are not missed when the volume is rendered with few slices. The transfer
+//function opacities are taken as the opacity of a slab of reference
+//thickness and corrected for the actual slab thickness. Colours are the
+//extinction weighted average over the range (self attenuation inside the
+//slab is neglected) and are not premultiplied, like the 1D lookup table.
+class CPreIntegrator
+{
+public:
+	//number of transfer function entries and the table size in each direction
+	static const int TABLE_SIZE = 256;
+
+	CPreIntegrator(void);
+	~CPreIntegrator(void);
+
+	//tf holds TABLE_SIZE RGBA entries. scale is the slab thickness over the
+	//reference thickness. If only the transfer function changed, only the
+	//entries whose scalar range covers a changed entry are recomputed.
+	//Returns false if nothing had to be recomputed.
+	bool Update(const float* tf, const float scale);
+
+	//TABLE_SIZE x TABLE_SIZE RGBA entries, the front scalar selects the row
+	const float* GetTable() const { return &table[0]; }
+
+	//time taken and entries recomputed by the last update
+	float GetLastTime() const { return lastTime; }
+	int GetLastEntries() const { return lastEntries; }
+
+private:
+	void ComputeRows(const int lo, const int hi);
+
+	//transfer function of the last update
+	std::vector<float> tf;
+	//extinction and colour per entry, and their prefix integrals
+	std::vector<float> tau, red, green, blue;
+	std::vector<float> T, KR, KG, KB;
+	std::vector<float> table;
+	float scale;
+	bool valid;
+	float lastTime;
+	int lastEntries;
+};
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "ThreadPool.h"
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <process.h>
+
+CThreadPool::CThreadPool(void)
+{
+	doneEvent = 0;
+	function = 0;
+	data = 0;
+	totalTasks = 0;
+	nextTask = 0;
+	busyWorkers = 0;
+	quit = 0;
+}
+
+CThreadPool::~CThreadPool(void)
+{
+	Destroy();
+}
+
+void CThreadPool::Init(int totalThreads) {
+	Destroy();
+	if(totalThreads <= 0) {
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		totalThreads = int(info.dwNumberOfProcessors);
+	}
+	if(totalThreads <= 1)
+		return;
+	quit = 0;
+	doneEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+	//the workers keep a pointer to their entry so the vector must not grow
+	//once the threads are running
+	workers.resize(totalThreads-1);
+	for(size_t i=0;i<workers.size();i++) {
+		workers[i].pool = this;
+		workers[i].startEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	}
+	for(size_t i=0;i<workers.size();i++)
+		workers[i].thread = (void*)_beginthreadex(NULL, 0, WorkerLoop, &workers[i], 0, NULL);
+}
+
+void CThreadPool::Destroy() {
+	if(workers.empty())
+		return;
+	InterlockedExchange(&quit, 1);
+	for(size_t i=0;i<workers.size();i++)
+		SetEvent(workers[i].startEvent);
+	for(size_t i=0;i<workers.size();i++) {
+		WaitForSingleObject(workers[i].thread, INFINITE);
+		CloseHandle(workers[i].thread);
+		CloseHandle(workers[i].startEvent);
+	}
+	workers.clear();
+	CloseHandle(doneEvent);
+	doneEvent = 0;
+}
+
+void CThreadPool::RunTasks() {
+	for(long task = InterlockedIncrement(&nextTask)-1; task < totalTasks; task = InterlockedIncrement(&nextTask)-1)
+		function(int(task), data);
+}
+
+void CThreadPool::Run(const int tasks, TaskFunction f, void* d) {
+	if(workers.empty() || tasks <= 1) {
+		for(int i=0;i<tasks;i++)
+			f(i, d);
+		return;
+	}
+	//SetEvent is a full barrier, so the workers see the new job
+	function = f;
+	data = d;
+	totalTasks = tasks;
+	nextTask = 0;
+	busyWorkers = long(workers.size());
+	for(size_t i=0;i<workers.size();i++)
+		SetEvent(workers[i].startEvent);
+
+	RunTasks();
+
+	WaitForSingleObject(doneEvent, INFINITE);
+}
+
+unsigned int __stdcall CThreadPool::WorkerLoop(void* param) {
+	Worker* worker = static_cast<Worker*>(param);
+	CThreadPool* pool = worker->pool;
+	while(true) {
+		WaitForSingleObject(worker->startEvent, INFINITE);
+		if(pool->quit)
+			return 0;
+		pool->RunTasks();
+		if(InterlockedDecrement(&pool->busyWorkers) == 0)
+			SetEvent(pool->doneEvent);
+	}
+}
\ No newline at end of file
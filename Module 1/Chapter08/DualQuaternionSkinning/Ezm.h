@@ -10,6 +10,7 @@
 
 #include <map>
 #include "MeshImport.h"
+#include "../src/EzmReader.h"
 using namespace std;
 
 struct Vertex	{  
@@ -31,7 +32,7 @@ struct Bone {
 
 struct SubMesh {
 	const char* materialName;
-	vector<unsigned int> indices;
+	int firstIndex, totalIndices;	//range in the loader's indices
 };
  
 
@@ -40,6 +41,21 @@ class EzmLoader {
 		EzmLoader();
 		~EzmLoader();
 
-	bool Load(const string& filename, vector<Bone>& skeleton, vector<NVSHARE::MeshAnimation>& animations, vector<SubMesh>& meshes, vector<Vertex>& verts, vector<unsigned short>& inds,	std::map<std::string, std::string>& materialNames, glm::vec3& min, glm::vec3& max);	
+	bool Load(const string& filename, vector<Bone>& skeleton, vector<NVSHARE::MeshAnimation>& animations, vector<SubMesh>& meshes, std::map<std::string, std::string>& materialNames, glm::vec3& min, glm::vec3& max);	
+
+	//the vertices and the indices of all submeshes, they point into the 
+	//reader or the mapped cache and stay valid as long as the loader
+	const Vertex* GetVertices() const;
+	int GetTotalVertices() const;
+	const unsigned int* GetIndices() const;
+	int GetTotalIndices() const;
+	private:
+		//the animations, their tracks and the submesh material names point
+		//into these, they stay valid as long as the loader
+		CEzmReader reader;
+		vector<NVSHARE::MeshAnimTrack> tracks;
+		vector<NVSHARE::MeshAnimTrack*> trackPointers;
+		vector<Vertex> converted;	//Y up copy of a Z up mesh
+		const Vertex* vertexData;
 };
 #endif
@@ -11,6 +11,15 @@ uniform mat4 P;
 uniform mat4 MV;
 uniform mat3 N;
 
+//dual quaternions of all instances, 2 texels (ordinary then dual part) per bone
+uniform samplerBuffer palette;
+uniform int numBones;
+
+//instances are placed on a grid with the given number of columns
+uniform int columns;
+uniform float spacing;
+uniform vec3 gridOrigin;
+
 //shader outputs to the fragment shader
 smooth out vec2 vUVout;						//texture coordinates
 smooth out vec3 vEyeSpaceNormal;    		//eye space normals
@@ -49,6 +58,13 @@ mat4 dualQuatToMatrix(vec4 Qn, vec4 Qd)
     return M;	
 }
 
+//returns the given part (bone*2 is the ordinary, bone*2+1 the dual part) of
+//a dual quaternion of the current instance
+vec4 GetBone(int index)
+{
+	return texelFetch(palette, gl_InstanceID*numBones*2 + index);
+}
+
 void main()
 {
 	//initialize local variables
@@ -61,34 +77,34 @@ void main()
     
 	//if the dot product is < 0 they are opposite to each other
 	//hence we multiply the -1 which would subtract the blended result
-    if (dot(Bones[viBlendIndices.x * 2], Bones[viBlendIndices.y * 2]) < 0.0)
+    if (dot(GetBone(viBlendIndices.x * 2), GetBone(viBlendIndices.y * 2)) < 0.0)
 		yc = -1.0;
     
-    if (dot(Bones[viBlendIndices.x * 2], Bones[viBlendIndices.z * 2]) < 0.0)
+    if (dot(GetBone(viBlendIndices.x * 2), GetBone(viBlendIndices.z * 2)) < 0.0)
        	zc = -1.0;
 	
-    if (dot(Bones[viBlendIndices.x * 2], Bones[viBlendIndices.w * 2]) < 0.0)
+    if (dot(GetBone(viBlendIndices.x * 2), GetBone(viBlendIndices.w * 2)) < 0.0)
 		wc = -1.0;
 	
     //get the dual quaternions for the first index
 	//multiply with the given blend weight
-	blendDQ[0] = Bones[viBlendIndices.x * 2] * vBlendWeights.x;
-    blendDQ[1] = Bones[viBlendIndices.x * 2 + 1] * vBlendWeights.x;
+	blendDQ[0] = GetBone(viBlendIndices.x * 2) * vBlendWeights.x;
+    blendDQ[1] = GetBone(viBlendIndices.x * 2 + 1) * vBlendWeights.x;
     
 	//get the dual quaternions for the second index
 	//multiply with the given blend weight and add to the existing dual quaternion
-    blendDQ[0] += yc*Bones[viBlendIndices.y * 2] * vBlendWeights.y;
-    blendDQ[1] += yc*Bones[viBlendIndices.y * 2 + 1] * vBlendWeights.y;
+    blendDQ[0] += yc*GetBone(viBlendIndices.y * 2) * vBlendWeights.y;
+    blendDQ[1] += yc*GetBone(viBlendIndices.y * 2 + 1) * vBlendWeights.y;
     
 	//get the dual quaternions for the third index
 	//multiply with the given blend weight and add to the existing dual quaternion
-    blendDQ[0] += zc*Bones[viBlendIndices.z * 2] * vBlendWeights.z;
-    blendDQ[1] += zc*Bones[viBlendIndices.z * 2 + 1] * vBlendWeights.z;
+    blendDQ[0] += zc*GetBone(viBlendIndices.z * 2) * vBlendWeights.z;
+    blendDQ[1] += zc*GetBone(viBlendIndices.z * 2 + 1) * vBlendWeights.z;
     
 	//get the dual quaternions for the fourth index
 	//multiply with the given blend weight and add to the existing dual quaternion
-    blendDQ[0] += wc*Bones[viBlendIndices.w * 2] * vBlendWeights.w;
-    blendDQ[1] += wc*Bones[viBlendIndices.w * 2 + 1] * vBlendWeights.w;
+    blendDQ[0] += wc*GetBone(viBlendIndices.w * 2) * vBlendWeights.w;
+    blendDQ[1] += wc*GetBone(viBlendIndices.w * 2 + 1) * vBlendWeights.w;
 
 	//get the skinning matrix from the dual quaternion
 	mat4 skinTransform = dualQuatToMatrix(blendDQ[0], blendDQ[1]);
@@ -98,6 +114,9 @@ void main()
     blendVertex = skinTransform*vec4(vVertex,1);
 	blendNormal = (skinTransform*vec4(vNormal,0)).xyz;
 
+	//move the instance to its place on the grid
+	blendVertex.xyz += gridOrigin + vec3(gl_InstanceID % columns, 0, gl_InstanceID / columns)*spacing;
+
 	//finally multiply the blendVertex with the modelview matrix to get the eye space position
     vEyeSpacePosition = (MV*blendVertex).xyz; 
 
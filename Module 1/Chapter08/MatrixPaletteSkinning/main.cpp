@@ -8,6 +8,8 @@
 #include <glm/gtc/matrix_inverse.hpp>
 
 #include "..\src\GLSLShader.h"
+#include "..\src\CrowdAnimator.h"
+#include "..\src\CompressedClip.h"
 #include <vector>
 #include "Ezm.h"
 
@@ -54,11 +56,6 @@ typedef std::map<std::string, std::string>::iterator iter;	//material2map iterat
 //All material names in the EZMesh model file in a linear list
 vector<std::string> materialNames;
 
-//linear list of all mesh vertices and indices 
-//in the EZMesh model
-vector<Vertex> vertices;
-vector<unsigned short> indices;
-
 //light gizmo vertex arrary and buffer object
 GLuint lightVAOID;
 GLuint lightVerticesVBO;
@@ -71,8 +68,8 @@ float theta = 5.4f;
 float phi = 0.86f;
 float radius = 30;
 
-int currentFrame = -1;	//-1 -> bindPose, 0 to frameCount-1 -> skinned
 bool bLoop = true;		//enable/disable loop playback
+bool bBlend = false;	//enable/disable blending of two animations per instance
 
 //camera transformation variables
 int state = 0, oldX=0, oldY=0;
@@ -90,9 +87,31 @@ const std::string mesh_filename = "../media/dude.ezm";
 vector<Bone> skeleton;
 vector<glm::mat4> bindPose;
 vector<glm::mat4> invBindPose;
-vector<glm::mat4> animatedXform;
 vector<NVSHARE::MeshAnimation> animations;
 
+//animation clips converted from the mesh animations and their compressed
+//versions, the crowd animator that plays them on all instances and the
+//thread pool it runs on
+vector<CAnimationClip> clips;
+vector<CCompressedClip> compressedClips;
+bool bCompressed = true;
+CCrowdAnimator crowd;
+CThreadPool threadPool;
+
+//texture buffer holding the skinning matrices of all instances
+GLuint paletteBufferID;
+GLuint paletteTextureID;
+
+//number of animated instances, drawn on a grid with the given spacing
+int totalInstances = 256;
+int maxInstances = 4096;
+float spacing = 1;
+float modelSize = 1;
+
+//start and count of the indices of every submesh in the index buffer
+vector<GLuint> submeshStart;
+vector<GLsizei> submeshCount;
+
 //flag which shows if the model is Yup or Zup
 bool bYup=false;
 
@@ -157,6 +176,65 @@ void UpdateCombinedMatrices() {
 	}
 }
 
+//converts an EZMesh animation to a clip, track j animates bone j. The poses of
+//Zup models are converted to Yup as done for the skeleton.
+void BuildClip(NVSHARE::MeshAnimation& anim, CAnimationClip& clip) {
+	clip.Clear();
+	float frameTime = anim.GetDuration() / anim.GetFrameCount();
+	vector<float> times;
+	vector<BonePose> keys;
+	for(int j=0;j<anim.mTrackCount;j++) {
+		NVSHARE::MeshAnimTrack* pTrack = anim.mTracks[j];
+		int frames = pTrack->GetFrameCount();
+		times.resize(frames);
+		keys.resize(frames);
+		for(int k=0;k<frames;k++) {
+			NVSHARE::MeshAnimPose* pPose = pTrack->GetPose(k);
+			BonePose& key = keys[k];
+			for(int i=0;i<3;i++) {
+				key.position[i] = pPose->mPos[i];
+				key.scale[i] = pPose->mScale[i];
+			}
+			for(int i=0;i<4;i++)
+				key.rotation[i] = pPose->mQuat[i];
+
+			//handle the Zup case
+			if(!bYup) {
+				key.position[1] = pPose->mPos[2];
+				key.position[2] = -pPose->mPos[1];
+				key.rotation[1] = pPose->mQuat[2];
+				key.rotation[2] = -pPose->mQuat[1];
+				key.scale[1] = pPose->mScale[2];
+				key.scale[2] = -pPose->mScale[1];
+			}
+			times[k] = k*frameTime;
+		}
+		clip.AddTrack(j, frames, &times[0], &keys[0]);
+	}
+}
+
+//gives every instance its animations, a random start time and speed so the
+//crowd does not move in lockstep
+void SetupInstances() {
+	crowd.SetTotalInstances(totalInstances);
+	//the compressed clips follow the uncompressed ones in the animator
+	int totalClips = max(1, int(clips.size()));
+	int first = bCompressed? int(clips.size()) : 0;
+	for(int i=0;i<totalInstances;i++) {
+		float start = rand()/float(RAND_MAX);
+		float speed = 0.8f + 0.4f*rand()/float(RAND_MAX);
+		crowd.SetInstance(i, first + i%totalClips, first + (i+1)%totalClips, bBlend? 0.5f : 0.0f, start, speed);
+	}
+
+	//move the camera back so the whole grid is visible
+	int columns = int(ceil(sqrt(float(totalInstances))));
+	dist = -max(modelSize, columns*spacing);
+
+	stringstream title;
+	title<<"EZMesh Skeletal Animation Viewer - OpenGL 3.3 - "<<totalInstances<<" instances"<<(bCompressed? " (compressed)" : "");
+	glutSetWindowTitle(title.str().c_str());
+}
+
 //OpenGL initialization
 void OnInit() {
 
@@ -170,7 +248,7 @@ void OnInit() {
 	glm::vec3 min, max;
 
 	//load the EZmesh file
-	if(!ezm.Load(mesh_filename.c_str(), skeleton, animations, submeshes, vertices, indices, material2ImageMap, min, max)) {
+	if(!ezm.Load(mesh_filename.c_str(), skeleton, animations, submeshes, material2ImageMap, min, max)) {
 		cout<<"Cannot load the EZMesh file"<<endl;
 		exit(EXIT_FAILURE);
 	}
@@ -185,10 +263,9 @@ void OnInit() {
 	//get the combined bone transform
 	UpdateCombinedMatrices();
 
-	//resize bind pose, inverse bind pose and animatedXform vectors
+	//resize bind pose and inverse bind pose vectors
 	bindPose.resize(skeleton.size());
 	invBindPose.resize(skeleton.size());
-	animatedXform.resize(skeleton.size());
 
 	//store the bind pose matrices which are the absolute transform of
 	//each bone. Also store their inverse which is used in skinning
@@ -209,6 +286,8 @@ void OnInit() {
 	glm::vec3 diagonal = (max-min);
 	radius = glm::length(center- diagonal * 0.5f);
 	dist = -glm::length(diagonal);
+	modelSize = glm::length(diagonal);
+	spacing = ((diagonal.x > diagonal.z)? diagonal.x : diagonal.z)*1.5f;
 
 	//generate OpenGL textures from the loaded material names
 	for(size_t k=0;k<materialNames.size();k++) {
@@ -286,16 +365,9 @@ void OnInit() {
 		flatShader.AddUniform("MVP");
 	flatShader.UnUse();
 
-	//For the skinning vertex shader, we pass the Bones array dynamcially
-	//since we may not know the total number of bones in the model at compile
-	//time. Since the GLSL arrays have to be a compile time constant, we 
-	//dynamically generate the shader string to add the uniform in the shader.
-	//To achieve this, we overload the GLSLShader::LoadFromFile function with
-	//a thid parameter, the string we want to add before the shader main function.
-	stringstream str( ios_base::app | ios_base::out);
-	str<<"\nconst int NUM_BONES="<<skeleton.size()<<";"<<endl;
-	str<<"uniform mat4 Bones[NUM_BONES];"<<endl;
-	shader.LoadFromFile(GL_VERTEX_SHADER, "shaders/shader.vert", str.str());
+	//the skinning matrices of all instances are read from a texture buffer
+	//so the number of bones and instances is not limited by the uniforms
+	shader.LoadFromFile(GL_VERTEX_SHADER, "shaders/shader.vert");
 	shader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/shader.frag");
 
 	//compile and link shader
@@ -308,7 +380,11 @@ void OnInit() {
 		shader.AddAttribute("vBlendWeights");
 		shader.AddAttribute("viBlendIndices");
 
-		shader.AddUniform("Bones");
+		shader.AddUniform("palette");
+		shader.AddUniform("numBones");
+		shader.AddUniform("columns");
+		shader.AddUniform("spacing");
+		shader.AddUniform("gridOrigin");
 		shader.AddUniform("MV");
 		shader.AddUniform("N");
 		shader.AddUniform("P");
@@ -320,7 +396,8 @@ void OnInit() {
 
 		//pass values to uniforms at initialization
 		glUniform1i(shader("textureMap"), 0);
-		glUniformMatrix4fv(shader("Bones"), animatedXform.size(), GL_FALSE, glm::value_ptr(animatedXform[0]));
+		glUniform1i(shader("palette"), 1);
+		glUniform1i(shader("numBones"), skeleton.size());
 
 	shader.UnUse();
 
@@ -335,7 +412,7 @@ void OnInit() {
 	glBindVertexArray(vaoID);
 		glBindBuffer (GL_ARRAY_BUFFER, vboVerticesID);
 		//pass vertices to buffer object memory
-		glBufferData (GL_ARRAY_BUFFER, sizeof(Vertex)*vertices.size(), &(vertices[0].pos.x), GL_DYNAMIC_DRAW);
+		glBufferData (GL_ARRAY_BUFFER, sizeof(Vertex)*ezm.GetTotalVertices(), ezm.GetVertices(), GL_DYNAMIC_DRAW);
 		GL_CHECK_ERRORS
 		//enable vertex attribute array for position
 		glEnableVertexAttribArray(shader["vVertex"]);
@@ -360,6 +437,81 @@ void OnInit() {
 		glEnableVertexAttribArray(shader["viBlendIndices"]);
 		glVertexAttribIPointer(shader["viBlendIndices"], 4, GL_INT, sizeof(Vertex), (const GLvoid*)(offsetof(Vertex, blendIndices)) );
 
+		GL_CHECK_ERRORS
+		//the indices of all submeshes are already in one array so they go
+		//into one index buffer and every submesh is drawn from its range
+		for(size_t i=0;i<submeshes.size();i++) {
+			submeshStart.push_back(submeshes[i].firstIndex);
+			submeshCount.push_back(submeshes[i].totalIndices);
+		}
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboIndicesID);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint)*ezm.GetTotalIndices(), ezm.GetIndices(), GL_STATIC_DRAW);
+
+	GL_CHECK_ERRORS
+
+	//setup the crowd animator with the skeleton and the mesh animations
+	vector<int> parents(skeleton.size());
+	vector<BonePose> restPose(skeleton.size());
+	for(size_t i=0;i<skeleton.size();i++) {
+		const Bone& b = skeleton[i];
+		parents[i] = b.parent;
+		BonePose& pose = restPose[i];
+		pose.position[0] = b.position.x; pose.position[1] = b.position.y; pose.position[2] = b.position.z;
+		pose.rotation[0] = b.orientation.x; pose.rotation[1] = b.orientation.y;
+		pose.rotation[2] = b.orientation.z; pose.rotation[3] = b.orientation.w;
+		pose.scale[0] = b.scale.x; pose.scale[1] = b.scale.y; pose.scale[2] = b.scale.z;
+	}
+	threadPool.Init();
+	crowd.Init(parents, restPose, invBindPose, CCrowdAnimator::MATRIX_PALETTE, &threadPool);
+	clips.resize(animations.size());
+	for(size_t i=0;i<animations.size();i++) {
+		BuildClip(animations[i], clips[i]);
+		crowd.AddClip(&clips[i]);
+	}
+
+	//compress the clips, or load them from the files next to the mesh if
+	//they were compressed before from the same mesh file with the same
+	//tolerance. The position error is relative to the model size.
+	CCompressedClip::Tolerance tolerance;
+	tolerance.position = modelSize*0.0001f;
+	compressedClips.resize(animations.size());
+	for(size_t i=0;i<animations.size();i++) {
+		stringstream clipName;
+		clipName<<mesh_filename<<"."<<i<<".eza";
+		CCompressedClip& compressed = compressedClips[i];
+		if(!compressed.Load(clipName.str(), mesh_filename, tolerance, int(skeleton.size())) ||
+		   compressed.GetTotalTracks() != clips[i].GetTotalTracks()) {
+			compressed.Compress(clips[i], tolerance);
+			if(!compressed.Save(clipName.str(), mesh_filename))
+				cerr<<"Cannot save the compressed clip: "<<clipName.str()<<endl;
+		}
+		cout<<"Animation "<<i<<": "<<clips[i].GetSize()/1024<<" KB, compressed "<<compressed.GetSize()/1024<<" KB"<<endl;
+		crowd.AddClip(&compressed);
+	}
+
+	//the palettes of all instances have to fit into the texture buffer, 3
+	//texels per bone
+	GLint maxTexels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+	int fitInstances = int(maxTexels/(skeleton.size()*3));
+	if(fitInstances < maxInstances)
+		maxInstances = (fitInstances > 1)? fitInstances : 1;
+	if(totalInstances > maxInstances)
+		totalInstances = maxInstances;
+	SetupInstances();
+
+	//texture buffer for the palettes, refilled every frame
+	glGenBuffers(1, &paletteBufferID);
+	glGenTextures(1, &paletteTextureID);
+	glBindBuffer(GL_TEXTURE_BUFFER, paletteBufferID);
+	glBufferData(GL_TEXTURE_BUFFER, crowd.GetPaletteSize(), 0, GL_STREAM_DRAW);
+	glBindTexture(GL_TEXTURE_BUFFER, paletteTextureID);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, paletteBufferID);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	cout<<"Press '+'/'-' to change the number of instances, 'b' to blend animations, 'c' to toggle compressed clips, 'l' to toggle looping"<<endl;
+
 	GL_CHECK_ERRORS
 		 
 
@@ -412,11 +564,21 @@ void OnShutdown() {
 	materialNames.clear();
 	materialMap.clear();
 	submeshes.clear();
-	vertices.clear();
-	indices.clear();
 	skeleton.clear();
 	animations.clear();
 
+	//stop the animation threads
+	crowd.Destroy();
+	clips.clear();
+	compressedClips.clear();
+	threadPool.Destroy();
+	submeshStart.clear();
+	submeshCount.clear();
+
+	//delete the palette texture buffer
+	glDeleteTextures(1, &paletteTextureID);
+	glDeleteBuffers(1, &paletteBufferID);
+
 	//Destroy shader
 	shader.DeleteShaderProgram();
 	flatShader.DeleteShaderProgram();
@@ -460,6 +622,19 @@ void OnRender() {
 			glUniformMatrix4fv(shader("P"), 1, GL_FALSE, glm::value_ptr(P));
 			glUniform3fv(shader("light_position"),1, &(lightPosOS.x));
 
+			//place the instances on a grid centered at the origin
+			int columns = int(ceil(sqrt(float(totalInstances))));
+			int rows = (totalInstances+columns-1)/columns;
+			glm::vec3 gridOrigin = glm::vec3(-0.5f*(columns-1), 0, -0.5f*(rows-1))*spacing;
+			glUniform1i(shader("columns"), columns);
+			glUniform1f(shader("spacing"), spacing);
+			glUniform3fv(shader("gridOrigin"), 1, &(gridOrigin.x));
+
+			//bind the palettes to texture unit 1
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_BUFFER, paletteTextureID);
+			glActiveTexture(GL_TEXTURE0);
+
 			//for all submeshes
 			for(size_t i=0;i<submeshes.size();i++) {
 				//if the material name is not empty
@@ -478,8 +653,8 @@ void OnRender() {
 					//there is no texture in submesh, use a default colour
 					glUniform1f(shader("useDefault"), 1.0);
 				}
-				//draw the triangles using the submesh indices
- 				glDrawElements(GL_TRIANGLES, submeshes[i].indices.size(), GL_UNSIGNED_INT, &submeshes[i].indices[0]);
+				//draw the triangles of all instances using the submesh indices
+				glDrawElementsInstanced(GL_TRIANGLES, submeshCount[i], GL_UNSIGNED_INT, (const GLvoid*)(submeshStart[i]*sizeof(GLuint)), totalInstances);
 			} //end for
 
 		//unbind shader
@@ -541,101 +716,24 @@ void OnIdle() {
     dt = (double)(current.QuadPart - last.QuadPart) / (double)freq.QuadPart;
 	last = current;
 
-	static double t  = 0;
-
-	//increment time
-	t+=dt;
-
-	//get the current mesh animation and store the frame rate
-	//if the current time is greater than the framerate, we move
-	//to the next frame
-	NVSHARE::MeshAnimation* pAnim = &animations[0];
-	float framesPerSecond = pAnim->GetFrameCount() / pAnim->GetDuration();
-	if( t > 1.0f/framesPerSecond) {
-		currentFrame++;
-		t=0;
-	}
-
-	//if looped playback is on, we do a modulus operation of the current frame with
-	//the total number of frames
-	if(bLoop) {
-		currentFrame = currentFrame%pAnim->mFrameCount;
-	} else {
-		//otherwise, we just restrict the current frame to be in range
-		currentFrame = max(-1, min(currentFrame, pAnim->mFrameCount-1));
+	//sample, blend and skin all instances, then upload their palettes
+	//with a single buffer update
+	crowd.SetLoop(bLoop);
+	crowd.Update(float(dt));
+	glBindBuffer(GL_TEXTURE_BUFFER, paletteBufferID);
+	glBufferData(GL_TEXTURE_BUFFER, crowd.GetPaletteSize(), crowd.GetPalette(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	//show the animation time in the title twice a second
+	static double titleTime = 0;
+	titleTime += dt;
+	if(titleTime > 0.5) {
+		titleTime = 0;
+		stringstream title;
+		title<<"EZMesh Skeletal Animation Viewer - OpenGL 3.3 - "<<totalInstances<<" instances"<<(bCompressed? " (compressed)" : "")<<", animation: "<<crowd.GetUpdateTime()<<" ms";
+		glutSetWindowTitle(title.str().c_str());
 	}
 
-	//if the current frame is -1, means we are in bind pose
-	//just use the bind  pose matrix and the bones absolute 
-	//transforms to get the aniamted transform
-	if(currentFrame == -1) {
-		for(size_t i=0;i<skeleton.size();i++) {
-			skeleton[i].comb = bindPose[i];
-			animatedXform[i] = skeleton[i].comb*invBindPose[i];
-		}
-	} else {
-		//otherwise, we loop through all tracks in the current animation
-		//and determine the pose.
-		for(int j=0;j<pAnim->mTrackCount;j++) {
-			NVSHARE::MeshAnimTrack* pTrack = pAnim->mTracks[j];
-			NVSHARE::MeshAnimPose* pPose = pTrack->GetPose(currentFrame);
-
-			//using the pose, we estimate the local transform of the current bone
-			//in the given animation track
-			//first get positions
-			skeleton[j].position.x = pPose->mPos[0];
-			skeleton[j].position.y = pPose->mPos[1];
-			skeleton[j].position.z = pPose->mPos[2];
-
-			//then orientation
-			glm::quat q;
-			q.x = pPose->mQuat[0];
-			q.y = pPose->mQuat[1];
-			q.z = pPose->mQuat[2];
-			q.w = pPose->mQuat[3];
-
-			//then scale
-			skeleton[j].scale  = glm::vec3(pPose->mScale[0], pPose->mScale[1], pPose->mScale[2]);
-
-			//handle the Zup case
-			if(!bYup) {
-				skeleton[j].position.y = pPose->mPos[2];
-				skeleton[j].position.z = -pPose->mPos[1];
-				q.y = pPose->mQuat[2];
-				q.z = -pPose->mQuat[1];
-
-				skeleton[j].scale.y = pPose->mScale[2];
-				skeleton[j].scale.z = -pPose->mScale[1];
-			}
-
-			skeleton[j].orientation = q;			
-
-			//use the stored scale, orientation and translation to obtain the 
-			//local transform of bone
-			glm::mat4 S = glm::scale(glm::mat4(1),skeleton[j].scale);
-			glm::mat4 R = glm::toMat4(q);
-			glm::mat4 T = glm::translate(glm::mat4(1), skeleton[j].position);
-			skeleton[j].xform = T*R*S;
-
-			//get the absolute transform of the bone
-			Bone& b = skeleton[j];
-			if(b.parent==-1)
-				b.comb = b.xform;
-			else
-				b.comb = skeleton[b.parent].comb * b.xform;
-
-			//multiply the absolute transform of the current bone with
-			//the inverse bind pose of the bone to get the new animated 
-			//transform
-			animatedXform[j] = b.comb * invBindPose[j] ;
-		}//for all animation tracks
-	}//else
-	
-	//pass the new animated transforms to the shader by updating the uniform
-	shader.Use();
-		glUniformMatrix4fv(shader("Bones"), animatedXform.size(), GL_FALSE, glm::value_ptr(animatedXform[0]));
-	shader.UnUse();
-	 
 	//call the display callback
 	glutPostRedisplay();
 }
@@ -645,6 +743,10 @@ void OnKey(unsigned char key, int x, int y) {
 	if(animations.size()>0) {
 		switch(key) {
 			case 'l': bLoop = !bLoop; break;
+			case 'b': bBlend = !bBlend; SetupInstances(); break;
+			case 'c': bCompressed = !bCompressed; SetupInstances(); break;
+			case '+': case '=': totalInstances = min(totalInstances*2, maxInstances); SetupInstances(); break;
+			case '-': totalInstances = max(totalInstances/2, 1); SetupInstances(); break;
 		}
 	} 
 	//recall display function
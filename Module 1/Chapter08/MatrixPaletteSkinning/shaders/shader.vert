@@ -12,11 +12,30 @@ uniform mat4 P;
 uniform mat4 MV;
 uniform mat3 N;
 
+//skinning matrices of all instances, 3 texels (rows of a 3x4 matrix) per bone
+uniform samplerBuffer palette;
+uniform int numBones;
+
+//instances are placed on a grid with the given number of columns
+uniform int columns;
+uniform float spacing;
+uniform vec3 gridOrigin;
+
 //shader outputs to the fragment shader
 smooth out vec2 vUVout;					//texture coordinates
 smooth out vec3 vEyeSpaceNormal;		//eye space normals
 smooth out vec3 vEyeSpacePosition;		//eye space positions
 
+//returns the skinning matrix of the given bone of the current instance
+mat4 GetBone(int index)
+{
+	int texel = (gl_InstanceID*numBones + index)*3;
+	vec4 r0 = texelFetch(palette, texel);
+	vec4 r1 = texelFetch(palette, texel+1);
+	vec4 r2 = texelFetch(palette, texel+2);
+	return transpose(mat4(r0, r1, r2, vec4(0,0,0,1)));
+}
+
 void main()
 {
 	//initialize local variables
@@ -30,32 +49,36 @@ void main()
 	//get the bone matrix for the first index. 
 	//multiply with the given vertex and the bones blend weight
 	//do the same for the normal
-	blendVertex = (Bones[index] * vVertex4) *  vBlendWeights.x;
-    blendNormal = (Bones[index] * vec4(vNormal, 0.0)).xyz *  vBlendWeights.x;
+	blendVertex = (GetBone(index) * vVertex4) *  vBlendWeights.x;
+    blendNormal = (GetBone(index) * vec4(vNormal, 0.0)).xyz *  vBlendWeights.x;
    	 
 	//get the bone matrix for the second index. 
 	//multiply with the given vertex and the bones blend weight but also add to the previous 
 	//blendedVertex  
 	//do the same for the normal (also add the previous blendNormal)
 	index = viBlendIndices.y;        
-	blendVertex = ((Bones[index] * vVertex4) * vBlendWeights.y) + blendVertex;
-    blendNormal = (Bones[index] * vec4(vNormal, 0.0)).xyz * vBlendWeights.y  + blendNormal;
+	blendVertex = ((GetBone(index) * vVertex4) * vBlendWeights.y) + blendVertex;
+    blendNormal = (GetBone(index) * vec4(vNormal, 0.0)).xyz * vBlendWeights.y  + blendNormal;
 
 	//get the bone matrix for the third index. 
 	//multiply with the given vertex and the bones blend weight but also add to the previous 
 	//blendedVertex  
 	//do the same for the normal (also add the previous blendNormal)
 	index = viBlendIndices.z;        
-	blendVertex = ((Bones[index] * vVertex4) *  vBlendWeights.z)  + blendVertex;
-    blendNormal = (Bones[index] * vec4(vNormal, 0.0)).xyz *  vBlendWeights.z  + blendNormal;
+	blendVertex = ((GetBone(index) * vVertex4) *  vBlendWeights.z)  + blendVertex;
+    blendNormal = (GetBone(index) * vec4(vNormal, 0.0)).xyz *  vBlendWeights.z  + blendNormal;
 
 	//get the bone matrix for the fourth index. 
 	//multiply with the given vertex and the bones blend weight but also add to the previous 
 	//blendedVertex  
 	//do the same for the normal (also add the previous blendNormal)
 	index = viBlendIndices.w;        
-	blendVertex = ((Bones[index] * vVertex4) *  vBlendWeights.w)   + blendVertex;
-    blendNormal = (Bones[index] * vec4(vNormal, 0.0)).xyz *  vBlendWeights.w  + blendNormal;
+	blendVertex = ((GetBone(index) * vVertex4) *  vBlendWeights.w)   + blendVertex;
+    blendNormal = (GetBone(index) * vec4(vNormal, 0.0)).xyz *  vBlendWeights.w  + blendNormal;
+
+	//move the instance to its place on the grid
+	vec3 offset = gridOrigin + vec3(gl_InstanceID % columns, 0, gl_InstanceID / columns)*spacing;
+	blendVertex.xyz += offset*blendVertex.w;
 
 	//finally multiply the blendVertex with the modelview matrix to get the eye space position
     vEyeSpacePosition = (MV*blendVertex).xyz; 
@@ -5,12 +5,17 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include "..\src\GLSLShader.h"
+#include "..\src\ClothConstraints.h"
+#include "..\src\ClothCollision.h"
+#include "..\src\MeshCollider.h"
+#include "..\src\XPBDCloth.h"
+#include "..\src\XPBDClothGPU.h"
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include <cassert> 
+#include <cassert>
 
 
 using namespace std;
@@ -21,17 +26,29 @@ using namespace std;
 //screen size
 const int width = 1024, height = 1024;
 
+//cloth resolutions selected with the keys 1-3
+const int CLOTH_SIZES[3] = {21, 128, 256};
+
 //total number of particles on X and Z axis
 int numX = 21, numY=21;
-const int total_points = (numX+1)*(numY+1);
+int total_points = (numX+1)*(numY+1);
 
 //world space cloth size
 int sizeX = 4,
 	sizeY = 4;
 float hsize = sizeX/2.0f;
 
-//number of transform feedback iterations
-const int NUM_ITER = 10;
+//number of solver substeps per frame
+const int SUBSTEPS = 10;
+
+//collision thickness relative to the cloth edge length and its lower bound,
+//the velocity clamp of the collisions grows with the thickness
+const float THICKNESS_SCALE = 0.4f;
+const float MIN_THICKNESS = 0.02f;
+
+//resolution and margin of the distance field of the ellipsoid
+const int FIELD_RESOLUTION = 64;
+const float FIELD_MARGIN = 0.25f;
 
 //selected vertex index
 int selected_index = -1;
@@ -39,22 +56,26 @@ int selected_index = -1;
 //flag to display/hide masses
 bool bDisplayMasses=true;
 
-//spring struct for storing cloth springs
-struct Spring {
-	int p1, p2;			//indices of two vertices
-	float rest_length;	//resting length
-	float Ks, Kd;		//spring and damping constants
-};
+//cloth constraints shared by the CPU and the GPU solver
+CClothConstraints constraints;
+
+//cloth collisions and the distance field of the ellipsoid mesh
+CClothCollision collision;
+CMeshCollider ellipsoidCollider;
+
+//XPBD solvers and the thread pool of the CPU solver
+CXPBDCloth cpuCloth;
+CXPBDClothGPU gpuCloth;
+CThreadPool threadPool;
 
-//cloth indices
-vector<GLushort> indices;
+//flag to run the solver on GPU or CPU
+bool bUseGPU = true;
 
-//cloth springs
-vector<Spring> springs;
+//cloth positions written by the CPU solver
+vector<glm::vec4> X;
 
-vector<glm::vec4> X;		//cloth vertex current positions
-vector<glm::vec4> X_last;	//cloth vertex previous positions
-vector<glm::vec3> F;		//cloth vertex forces
+//position of the dragged vertex
+glm::vec3 selected_position;
 
 //variables for camera transformation
 int oldX=0, oldY=0;
@@ -65,21 +86,14 @@ float dist=-4;
 //grid size
 const int GRID_SIZE=10;
 
-//total number of springs
-int spring_count=0;
-
 //information message
 char info[MAX_PATH]={0};
 
-//default cloth spring values
-const float DEFAULT_DAMPING =  -0.05f;
-float	KsStruct = 10.5f,KdStruct = -10.5f;
-float	KsShear = 0.25f,KdShear =-0.25f;
-float	KsBend = 0.25f,KdBend = -0.25f;
+//compliance (inverse stiffness) of the stretch, shear and bend constraints
+const float COMPLIANCE[CClothConstraints::TOTAL_TYPES] = {0.0f, 1e-6f, 1e-4f};
 
-//default gravity and mass 
-glm::vec3 gravity=glm::vec3(0.0f,-0.00981f,0.0f);
-float mass = 1.0f;
+//default gravity
+glm::vec3 gravity=glm::vec3(0.0f,-9.81f,0.0f);
 
 //default time step value and other timing related variables
 float timeStep =  1.0f/60.0f;
@@ -104,16 +118,11 @@ LARGE_INTEGER frequency;        // ticks per second
 LARGE_INTEGER t1, t2;           // ticks
 double frameTimeQP=0;
 float frameTime =0 ;
-int texture_size_x=0;
-int texture_size_y=0;
 
 //for fps calculation
 float startTime =0, fps=0 ;
 int totalFrames=0;
 
-//for transform feedback query
-GLuint primitives_written=0;
-
 //particle size
 GLfloat pointSize = 30;
 
@@ -123,52 +132,25 @@ GLfloat vBeige[] = { 1.0f, 0.8f, 0.7f, 1.0f };
 GLfloat vWhite[] = { 1.0f, 1.0f, 1.0f, 1.0f };
 GLfloat vGray[] = { .25f, .25f, .25f, 1.0f };
 
-//delta time per frame for transform feedback
-float delta_time=0;
-
-//ping pong ids
-int readID=0, writeID = 1;
-
-//buffer object ids for current and previous positions
-GLuint	vboID_Pos[2],
-		vboID_PrePos[2];
-
-//vertex array object ids for update, render cycle 
-GLuint vaoUpdateID[2], vaoRenderID[2], vboIndices;
-
-//buffer texture ids
-GLuint texPosID[2];
-GLuint texPrePosID[2];
-
-size_t i=0;
-
-//shaders for cloth vertex, particle and rendering
-GLSLShader	massSpringShader,
-			particleShader,
+//shaders for particle and rendering
+GLSLShader	particleShader,
 			renderShader;
 
-//timer query ids
-GLuint t_query, query;
-
-//elapsed time per frame
-GLuint64 elapsed_time;
-
 //grid rendering variables
 GLuint gridVAOID, gridVBOVerticesID, gridVBOIndicesID;
 vector<glm::vec3> grid_vertices;
 vector<GLushort> grid_indices;
 
-//cloth vertex array and buffer objects
-GLuint clothVAOID, clothVBOVerticesID, clothVBOIndicesID;
+//cloth vertex array and buffer objects, the first vertex array object
+//draws the positions of the CPU solver, the second those of the GPU solver
+GLuint clothVAOID[2], clothVBOVerticesID, clothVBOIndicesID;
+int total_indices=0;
 
 //spehre vertex array and buffer objects
 GLuint sphereVAOID, sphereVerticesID, sphereIndicesID;
 
-//transform feedback id
-GLuint tfID;
-
-//collision ellipsoid transform and its inverse 
-glm::mat4 ellipsoid, inverse_ellipsoid;
+//collision ellipsoid transform
+glm::mat4 ellipsoid;
 
 //radius, stacks and slices for the sphere
 int iStacks = 30;
@@ -178,91 +160,13 @@ float fRadius = 1;
 //total sphere indices
 int total_sphere_indices=0;
 
-//converts vec4 to vec3
-glm::vec3 vec3(glm::vec4 v) {
-	return glm::vec3(v.x, v.y, v.z);
-}
+//sphere mesh, also used to build the collider
+vector<glm::vec4> sphere_vertices;
+vector<GLushort>  sphere_indices;
 
-//creates a new spring between th given vertices (a and b) with the given
-//spring and damping constants
-void AddSpring(int a, int b, float ks, float kd ) {
-	Spring spring;
-	spring.p1=a;
-	spring.p2=b;
-	spring.Ks=ks;
-	spring.Kd=kd;
-	glm::vec3 deltaP = vec3(X[a]-X[b]);
-	spring.rest_length = sqrt(glm::dot(deltaP, deltaP));
-	springs.push_back(spring);
-}
-
-//creates buffer objects for cloth, grid and sphere
+//creates buffer objects for the grid
 void createVBO()
 {
-	//fill the vertices
-	int count = 0;
-
-    // create vertex array objects
-	glGenVertexArrays(2, vaoUpdateID);
-	glGenVertexArrays(2, vaoRenderID);
-
-	// create buffer objects
-	glGenBuffers( 2, vboID_Pos);
-	glGenBuffers( 2, vboID_PrePos);
-	glGenBuffers(1, &vboIndices);
-	glGenTextures(2, texPosID);
-	glGenTextures(2, texPrePosID);
-
-	//set update vao
-	for(int i=0;i<2;i++) {
-		glBindVertexArray(vaoUpdateID[i]);
-		//pass current positions 
-		glBindBuffer( GL_ARRAY_BUFFER, vboID_Pos[i]);
-		glBufferData( GL_ARRAY_BUFFER, X.size()* sizeof(glm::vec4), &(X[0].x), GL_DYNAMIC_COPY);
-		//enable vertex attribute attribute
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0,  4, GL_FLOAT, GL_FALSE, 0, 0);
-
-		CHECK_GL_ERRORS
-
-		//pass previous positions 
-		glBindBuffer( GL_ARRAY_BUFFER, vboID_PrePos[i]);
-		glBufferData( GL_ARRAY_BUFFER, X_last.size()*sizeof(glm::vec4), &(X_last[0].x), GL_DYNAMIC_COPY);
-		//enable vertex attribute attribute
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1,  4, GL_FLOAT, GL_FALSE, 0,0);
-
-		CHECK_GL_ERRORS;
-	}
-
-	CHECK_GL_ERRORS;
-
-	//setup the render vao which simply uses the position buffer object we filled earlier
-	for(int i=0;i<2;i++) {
-		glBindVertexArray(vaoRenderID[i]);
-		glBindBuffer( GL_ARRAY_BUFFER, vboID_Pos[i]);
-		//enable vertex attribute array
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0,  4, GL_FLOAT, GL_FALSE, 0, 0);
-
-		//setup the indices array buffer
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboIndices);
-		if(i==0)
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
-	}
-
-	glBindVertexArray(0);
-
-	//setup the two buffer textures, which take the values from the 
-	//current and previous position buffer objects
-	for(int i=0;i<2;i++) {
-		glBindTexture( GL_TEXTURE_BUFFER, texPosID[i]);
-		glTexBuffer( GL_TEXTURE_BUFFER, GL_RGBA32F, vboID_Pos[i]);
-
-		glBindTexture( GL_TEXTURE_BUFFER, texPrePosID[i]);
-		glTexBuffer( GL_TEXTURE_BUFFER, GL_RGBA32F, vboID_PrePos[i]);
-	}
-	 
 	//setup the grid vertices
 	for(int i=-GRID_SIZE;i<=GRID_SIZE;i++)
 	{
@@ -280,6 +184,7 @@ void createVBO()
 		grid_indices.push_back(i+2);
 		grid_indices.push_back(i+3);
 	}
+
 	//Create grid VAO/VBO
 	glGenVertexArrays(1, &gridVAOID);
 	glGenBuffers (1, &gridVBOVerticesID);
@@ -294,31 +199,14 @@ void createVBO()
 		glVertexAttribPointer (0, 3, GL_FLOAT, GL_FALSE,0,0);
 
 		CHECK_GL_ERRORS
+
 		//pass grid indices to element array buffer object
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridVBOIndicesID);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort)*grid_indices.size(), &grid_indices[0], GL_STATIC_DRAW);
 
-	//create cloth vertex array and buffer objects
-	glGenVertexArrays(1, &clothVAOID);
-	glGenBuffers (1, &clothVBOVerticesID);
-	glGenBuffers (1, &clothVBOIndicesID);
-	glBindVertexArray(clothVAOID);
-		glBindBuffer (GL_ARRAY_BUFFER, clothVBOVerticesID);
-		//pass cloth vertex positions 
-		glBufferData (GL_ARRAY_BUFFER, sizeof(float)*4*X.size(), &X[0].x, GL_STATIC_DRAW);
-		//enable vertex attribute array
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer (0, 4, GL_FLOAT, GL_FALSE,0,0);
-
-		CHECK_GL_ERRORS
-		//pass cloth indices to element array buffer 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, clothVBOIndicesID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort)*indices.size(), &indices[0], GL_STATIC_DRAW);
+	glBindVertexArray(0);
 
 	//setup sphere vertices and indices
-	vector<glm::vec4> sphere_vertices;
-	vector<GLushort>  sphere_indices;
-
 	//this code generates a set of vertices on a sphere
 	//and also generate their triangulation
 
@@ -328,7 +216,7 @@ void createVBO()
 	GLfloat dt = 1.0f / (GLfloat) iStacks;
     GLint i, j;     // Looping variables
     total_sphere_indices = iSlices * iStacks * 6;
-	count=0;
+	int count=0;
 	 
 	for (i = 0; i < iStacks; i++)
 	{
@@ -408,6 +296,98 @@ void createVBO()
     CHECK_GL_ERRORS;
 }
 
+//builds the distance field of the ellipsoid from the sphere mesh placed in
+//the world, so the cloth collides with the mesh it sees
+void CreateCollider()
+{
+	vector<glm::vec3> vertices(sphere_vertices.size());
+	for(size_t i=0;i<sphere_vertices.size();i++)
+		vertices[i] = glm::vec3(ellipsoid*glm::vec4(glm::vec3(sphere_vertices[i]), 1));
+	vector<GLuint> indices(sphere_indices.begin(), sphere_indices.end());
+	ellipsoidCollider.Build(&vertices[0], int(vertices.size()), &indices[0], int(indices.size()),
+							FIELD_RESOLUTION, FIELD_MARGIN, &threadPool);
+	collision.ClearColliders();
+	collision.AddCollider(&ellipsoidCollider, glm::mat4(1));
+}
+
+//creates the cloth of the given resolution for both solvers along with its
+//vertex array and buffer objects
+void SetupCloth(int size)
+{
+	numX = numY = size;
+	total_points = (numX+1)*(numY+1);
+	printf("Total triangles: %3d\n",numX*numY*2);
+
+	constraints.Build(numX, numY, float(sizeX), float(sizeY), sizeX+1.0f);
+	collision.Init(constraints, max(MIN_THICKNESS, THICKNESS_SCALE*sizeX/numX));
+	cpuCloth.Init(constraints, &threadPool);
+	cpuCloth.SetCollision(&collision);
+	gpuCloth.SetConstraints(constraints);
+	gpuCloth.SetCollision(&collision);
+	for(int i=0;i<CClothConstraints::TOTAL_TYPES;i++) {
+		cpuCloth.SetCompliance(i, COMPLIANCE[i]);
+		gpuCloth.SetCompliance(i, COMPLIANCE[i]);
+	}
+	cpuCloth.SetSubsteps(SUBSTEPS);
+	gpuCloth.SetSubsteps(SUBSTEPS);
+	cpuCloth.SetGravity(gravity);
+	gpuCloth.SetGravity(gravity);
+	X = constraints.GetPositions();
+	selected_index = -1;
+
+	//masses get smaller as the cloth gets finer
+	particleShader.Use();
+		glUniform1f(particleShader("pointSize"), pointSize*CLOTH_SIZES[0]/numX);
+	particleShader.UnUse();
+
+	if(clothVBOVerticesID == 0) {
+		glGenVertexArrays(2, clothVAOID);
+		glGenBuffers (1, &clothVBOVerticesID);
+		glGenBuffers (1, &clothVBOIndicesID);
+	}
+
+	//pass cloth indices to element array buffer
+	const vector<unsigned int>& indices = constraints.GetIndices();
+	total_indices = int(indices.size());
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, clothVBOIndicesID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint)*indices.size(), &indices[0], GL_STATIC_DRAW);
+
+	//pass cloth vertex positions 
+	glBindBuffer (GL_ARRAY_BUFFER, clothVBOVerticesID);
+	glBufferData (GL_ARRAY_BUFFER, sizeof(float)*4*X.size(), &X[0].x, GL_STREAM_DRAW);
+
+	GLuint positions[2] = {clothVBOVerticesID, gpuCloth.GetPositionBuffer()};
+	for(int i=0;i<2;i++) {
+		glBindVertexArray(clothVAOID[i]);
+			glBindBuffer (GL_ARRAY_BUFFER, positions[i]);
+			//enable vertex attribute array
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer (0, 4, GL_FLOAT, GL_FALSE,0,0);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, clothVBOIndicesID);
+	}
+	glBindVertexArray(0);
+
+	CHECK_GL_ERRORS;
+}
+
+//current cloth positions of the active solver
+void ReadPositions(vector<glm::vec4>& positions)
+{
+	if(bUseGPU)
+		gpuCloth.Read(positions);
+	else
+		positions = X;
+}
+
+//moves a cloth vertex in the active solver
+void SetParticle(int index, const glm::vec3& p, float invMass)
+{
+	if(bUseGPU)
+		gpuCloth.SetParticle(index, p, invMass);
+	else
+		cpuCloth.SetParticle(index, p, invMass);
+}
+
 void OnMouseDown(int button, int s, int x, int y)
 {
 	if (s == GLUT_DOWN)
@@ -428,33 +408,26 @@ void OnMouseDown(int button, int s, int x, int y)
 		//unproject the value using the current modelview, projection matrices and the current 
 		//viewport to get the object space position of the clicked point
 		double objX=0, objY=0, objZ=0;
-		gluUnProject(winX, winY, winZ,  MV,  P, viewport, &objX, &objY, &objZ);
-	
+		gluUnProject(winX,winY, winZ,  MV,  P, viewport, &objX, &objY, &objZ);
 		glm::vec3 pt(objX,objY, objZ);
-	 
-		//bind our render vertex array object
-		glBindVertexArray(vaoRenderID[readID]);
-		glBindBuffer(GL_ARRAY_BUFFER, vboID_Pos[writeID]);
-		//map the data so that we can read each vertex position
-		//to check the nearest vertex the user has picked
-		GLfloat* pData = (GLfloat*)glMapBuffer(GL_ARRAY_BUFFER, GL_READ_ONLY);
-
-		//loop through all cloth vertices
-		for(int i=0;i<total_points*4;i+=4) {
+		
+		//read the vertex positions to check the nearest vertex the user has picked
+		vector<glm::vec4> positions;
+		ReadPositions(positions);
+		for(int i=0;i<total_points;i++) {
 			//if the vertex distance is close enough
-			if( abs(pData[i]-pt.x)<0.1 &&
-				abs(pData[i+1]-pt.y)<0.1  &&
-				abs(pData[i+2]-pt.z)<0.1 ) {
-				//take this as the selected vertex
-				selected_index = i/4;
+			if( abs(positions[i].x-pt.x)<0.1 &&
+				abs(positions[i].y-pt.y)<0.1  &&
+				abs(positions[i].z-pt.z)<0.1 ) {
+				//take this as the selected vertex, it is held by the mouse
+				//until the button is released
+				selected_index = i;
+				selected_position = glm::vec3(positions[i]);
+				SetParticle(selected_index, selected_position, 0);
 				printf("Intersected at %d\n",i);
 				break;
 			}
 		}
-		//unmap buffer to release the obtained pointer to GPU memory
-		glUnmapBuffer(GL_ARRAY_BUFFER);
-		glBindVertexArray(0);
-
 	}
 
 	if(button == GLUT_MIDDLE_BUTTON)
@@ -463,6 +436,9 @@ void OnMouseDown(int button, int s, int x, int y)
 		state = 1;
 
 	if(s==GLUT_UP) {
+		//give the vertex its mass back, pinned vertices stay pinned
+		if(selected_index != -1)
+			SetParticle(selected_index, selected_position, constraints.GetPositions()[selected_index].w);
 		selected_index= -1;
 		glutSetCursor(GLUT_CURSOR_INHERIT);
 	}
@@ -479,53 +455,34 @@ void OnMouseMove(int x, int y)
 			rX += (y - oldY)/5.0f;
 		}
 	} else {
-
+		
 		//if there was a vertex selected, selected_index will not be -1
+
 		float delta = 1500/abs(dist);
 		float valX = (x - oldX)/delta;
 		float valY = (oldY - y)/delta;
+
 		//change the cursor depending on the direction the user is draggin mouse in
 		if(abs(valX)>abs(valY))
 			glutSetCursor(GLUT_CURSOR_LEFT_RIGHT);
 		else
 			glutSetCursor(GLUT_CURSOR_UP_DOWN);
 
-		//set the rendering vertex array object
-		glBindVertexArray(vaoRenderID[readID]);
-		//bind the position buffer object
-		glBindBuffer(GL_ARRAY_BUFFER, vboID_Pos[writeID]);
-			//map the buffer object to obtain access to the selected vertex position
-			GLfloat* pData = (GLfloat*)glMapBuffer(GL_ARRAY_BUFFER, GL_READ_WRITE);
-				//assign a new value to the selected vertex
-				pData[selected_index*4]	  += Right[0]*valX ;
-				float newValue = pData[selected_index*4+1]+Up[1]*valY;
-
-				//for Y value, we test the new value to be >0 so that he vertex cannot go
-				//below the ground plane
-				if(newValue>0)
-					pData[selected_index*4+1] = newValue;
-				pData[selected_index*4+2] += Right[2]*valX + Up[2]*valY;
-			//unmap buffer to release the obtained pointer to GPU memory
-			glUnmapBuffer(GL_ARRAY_BUFFER);
-		//do the same steps for the previous position buffer object
-		glBindBuffer(GL_ARRAY_BUFFER, vboID_PrePos[writeID]);
-			pData = (GLfloat*)glMapBuffer(GL_ARRAY_BUFFER, GL_READ_WRITE);
-				pData[selected_index*4]	  += Right[0]*valX ;
-				newValue = pData[selected_index*4+1]+Up[1]*valY;
-				if(newValue>0)
-					pData[selected_index*4+1] = newValue;
-				pData[selected_index*4+2] += Right[2]*valX + Up[2]*valY;
-			glUnmapBuffer(GL_ARRAY_BUFFER);
-		glBindVertexArray(0);
+		//move the selected vertex, for Y value, we test the new value to be >0
+		//so that the vertex cannot go below the ground plane
+		selected_position.x += Right[0]*valX;
+		float newValue = selected_position.y+Up[1]*valY;
+		if(newValue>0)
+			selected_position.y = newValue;
+		selected_position.z += Right[2]*valX + Up[2]*valY;
+		SetParticle(selected_index, selected_position, 0);
 	}
-
 	oldX = x;
 	oldY = y;
 
 	glutPostRedisplay();
 }
 
-
 //grid rendering routine 
 //it uses the pass through shader with the given uniform colour as fragment colour 
 void DrawGrid()
@@ -538,56 +495,22 @@ void DrawGrid()
 	renderShader.UnUse();
 }
 
-//renders cloth using the render shader 
-void DrawCloth()
-{
-	renderShader.Use();
-		glBindVertexArray(clothVAOID);
-		glUniformMatrix4fv(renderShader("MVP"), 1, GL_FALSE, glm::value_ptr(mMVP));
-			glDrawElements(GL_TRIANGLES, indices.size(),GL_UNSIGNED_SHORT,0);
-		//glBindVertexArray(0);
-	renderShader.UnUse();
-}
-
 //renders sphere using the render shader
 void DrawSphere(glm::mat4 mvp) {
 	renderShader.Use();
 		glBindVertexArray(sphereVAOID);
 		glUniformMatrix4fv(renderShader("MVP"), 1, GL_FALSE, glm::value_ptr(mvp));
 			glDrawElements(GL_TRIANGLES, total_sphere_indices,GL_UNSIGNED_SHORT,0); 
-	renderShader.UnUse();
-}
-
-//renders cloth vertices using particle shader
-//this call assumes that the cloth vertex array object is bound currently
-void DrawClothPoints()
-{
-	particleShader.Use();
-		//glBindVertexArray(clothVAOID);
-		glUniform1i(particleShader("selected_index"), selected_index);
-		glUniformMatrix4fv(particleShader("MV"), 1, GL_FALSE, glm::value_ptr(mMV));
-		glUniformMatrix4fv(particleShader("MVP"), 1, GL_FALSE, glm::value_ptr(mMVP));
-			//draw the masses last
-			glDrawArrays(GL_POINTS, 0, total_points);
 		glBindVertexArray(0);
-	particleShader.UnUse();
+	renderShader.UnUse();
 }
-
 //initialize OpenGL
 void InitGL() {
 	//set the background colour to white
 	glClearColor(1,1,1,1);
 
-	//generate hardware query objects
-	glGenQueries(1, &query);
-	glGenQueries(1, &t_query);
-
-	//setup texture size for shaders
-	texture_size_x =  numX+1;
-	texture_size_y =  numY+1;
-
 	CHECK_GL_ERRORS
-	
+
 	//get initial time
 	startTime = (float)glutGet(GLUT_ELAPSED_TIME);
 	// get ticks per second
@@ -596,46 +519,6 @@ void InitGL() {
     // start timer
     QueryPerformanceCounter(&t1);
 
-	//local variables
-	size_t i=0, j=0, count=0;
-	int l1=0, l2=0;
-	int v = numY+1;
-	int u = numX+1;
-
-	printf("Total triangles: %3d\n",numX*numY*2);
-	
-	//resize the cloth indices, position, previous position and force vectors
-	indices.resize( numX*numY*2*3);
-	X.resize(total_points);
-	X_last.resize(total_points);
-	F.resize(total_points);
-
-	//fill in positions
-	for(int j=0;j<=numY;j++) {
-		for(int i=0;i<=numX;i++) {
-			X[count] = glm::vec4( ((float(i)/(u-1)) *2-1)* hsize, sizeX+1, ((float(j)/(v-1) )* sizeY),1);
-			X_last[count] = X[count];
-			count++;
-		}
-	}
-
-	//fill in indices
-	GLushort* id=&indices[0];
-	for (int i = 0; i < numY; i++) {
-		for (int j = 0; j < numX; j++) {
-			int i0 = i * (numX+1) + j;
-			int i1 = i0 + 1;
-			int i2 = i0 + (numX+1);
-			int i3 = i2 + 1;
-			if ((j+i)%2) {
-				*id++ = i0; *id++ = i2; *id++ = i1;
-				*id++ = i1; *id++ = i2; *id++ = i3;
-			} else {
-				*id++ = i0; *id++ = i2; *id++ = i3;
-				*id++ = i0; *id++ = i3; *id++ = i1;
-			}
-		}
-	}
 	//set the polygon rendering to render them as lines
 	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
@@ -648,80 +531,16 @@ void InitGL() {
 	glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	 
+
 	//enable state to use the vertex shader to reset the particle size
 	//by writing to gl_PointSize value
 	glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
 
-	// Setup springs
-	// Horizontal
-	for (l1 = 0; l1 < v; l1++)	// v
-		for (l2 = 0; l2 < (u - 1); l2++) {
-			AddSpring((l1 * u) + l2,(l1 * u) + l2 + 1,KsStruct,KdStruct);
-		}
-
-	// Vertical
-	for (l1 = 0; l1 < (u); l1++)
-		for (l2 = 0; l2 < (v - 1); l2++) {
-			AddSpring((l2 * u) + l1,((l2 + 1) * u) + l1,KsStruct,KdStruct);
-		}
-
-	// Shearing Springs
-	for (l1 = 0; l1 < (v - 1); l1++)
-		for (l2 = 0; l2 < (u - 1); l2++) {
-			AddSpring((l1 * u) + l2,((l1 + 1) * u) + l2 + 1,KsShear,KdShear);
-			AddSpring(((l1 + 1) * u) + l2,(l1 * u) + l2 + 1,KsShear,KdShear);
-		}
-
-	// Bend Springs
-	for (l1 = 0; l1 < (v); l1++) {
-		for (l2 = 0; l2 < (u - 2); l2++) {
-			AddSpring((l1 * u) + l2,(l1 * u) + l2 + 2,KsBend,KdBend);
-		}
-		AddSpring((l1 * u) + (u - 3),(l1 * u) + (u - 1),KsBend,KdBend);
-	}
-	for (l1 = 0; l1 < (u); l1++) {
-		for (l2 = 0; l2 < (v - 2); l2++) {
-			AddSpring((l2 * u) + l1,((l2 + 2) * u) + l1,KsBend,KdBend);
-		}
-		AddSpring(((v - 3) * u) + l1,((v - 1) * u) + l1,KsBend,KdBend);
-	}
-
 	//setup shader loading
-	massSpringShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/Spring.vert");
 	particleShader.LoadFromFile(GL_VERTEX_SHADER,"shaders/Basic.vert");
 	particleShader.LoadFromFile(GL_FRAGMENT_SHADER,"shaders/Basic.frag");
 	renderShader.LoadFromFile(GL_VERTEX_SHADER,"shaders/Passthrough.vert");
 	renderShader.LoadFromFile(GL_FRAGMENT_SHADER,"shaders/Passthrough.frag");
-	
-	//compile and link mass spring shader
-	massSpringShader.CreateAndLinkProgram();
-	massSpringShader.Use();
-		//add attributes and uniforms
-		massSpringShader.AddAttribute("position_mass");
-		massSpringShader.AddAttribute("prev_position");
-		massSpringShader.AddUniform("tex_position_mass");
-		massSpringShader.AddUniform("tex_pre_position_mass");
-		massSpringShader.AddUniform("MVP");
-		massSpringShader.AddUniform("dt");
-		massSpringShader.AddUniform("gravity");
-		massSpringShader.AddUniform("ksStr");
-		massSpringShader.AddUniform("ksShr");
-		massSpringShader.AddUniform("ksBnd");
-		massSpringShader.AddUniform("kdStr");
-		massSpringShader.AddUniform("kdShr");
-		massSpringShader.AddUniform("kdBnd");
-		massSpringShader.AddUniform("DEFAULT_DAMPING");
-		massSpringShader.AddUniform("texsize_x");
-		massSpringShader.AddUniform("texsize_y");
-		massSpringShader.AddUniform("step");
-		massSpringShader.AddUniform("inv_cloth_size");
-		massSpringShader.AddUniform("ellipsoid_xform");	
-		massSpringShader.AddUniform("inv_ellipsoid");	
-		massSpringShader.AddUniform("ellipsoid");		
-	massSpringShader.UnUse();
-
-	CHECK_GL_ERRORS
 
 	//compile and link particle shader
 	particleShader.CreateAndLinkProgram();
@@ -758,40 +577,15 @@ void InitGL() {
 	ellipsoid = glm::translate(glm::mat4(1),glm::vec3(0,2,0));
 	ellipsoid = glm::rotate(ellipsoid, 45.0f ,glm::vec3(1,0,0));
 	ellipsoid = glm::scale(ellipsoid, glm::vec3(fRadius,fRadius,fRadius/2));
-	inverse_ellipsoid = glm::inverse(ellipsoid);
-
-	//setup transform feedback attributes
-	glGenTransformFeedbacks(1, &tfID);
-	glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, tfID);
-	//pass the vertex shader outputs for transform feedback
-	const char* varying_names[]={"out_position_mass", "out_prev_position"};
-	glTransformFeedbackVaryings(massSpringShader.GetProgram(), 2, varying_names, GL_SEPARATE_ATTRIBS);
-	//relink the massSpringShader program
-	glLinkProgram(massSpringShader.GetProgram());
-
-	//set the mass spring shader and pass values to constant uniforms
-	massSpringShader.Use();		
-		glUniform1f(massSpringShader("dt"),  timeStep);
-		glUniform3fv(massSpringShader("gravity"),1,&gravity.x);
-		glUniform1i(massSpringShader("tex_position_mass"), 0);
-		glUniform1i(massSpringShader("tex_pre_position_mass"), 1);
-		glUniform1i(massSpringShader("texsize_x"),texture_size_x);
-		glUniform1i(massSpringShader("texsize_y"),texture_size_y);
-		glUniformMatrix4fv(massSpringShader("ellipsoid_xform"), 1, GL_FALSE, glm::value_ptr(ellipsoid));
-		glUniformMatrix4fv(massSpringShader("inv_ellipsoid"), 1, GL_FALSE, glm::value_ptr(inverse_ellipsoid));
-		glUniform4f(massSpringShader("ellipsoid"),0, 0, 0, fRadius);		
-		glUniform2f(massSpringShader("inv_cloth_size"),float(sizeX)/numX,float(sizeY)/numY);
-		glUniform2f(massSpringShader("step"),1.0f/(texture_size_x-1.0f),1.0f/(texture_size_y-1.0f));
-		glUniform1f(massSpringShader("ksStr"),  KsStruct);
-		glUniform1f(massSpringShader("ksShr"),  KsShear);
-		glUniform1f(massSpringShader("ksBnd"),  KsBend);
-		glUniform1f(massSpringShader("kdStr"),  KdStruct/1000.0f);
-		glUniform1f(massSpringShader("kdShr"),  KdShear/1000.0f);
-		glUniform1f(massSpringShader("kdBnd"),  KdBend/1000.0f);
-		glUniform1f(massSpringShader("DEFAULT_DAMPING"),  DEFAULT_DAMPING);
-	massSpringShader.UnUse();
-
-	
+
+	//setup the solvers, the collider and the default cloth
+	threadPool.Init();
+	CreateCollider();
+	if(!gpuCloth.Init(true)) {
+		puts("Cannot create the GPU cloth solver.");
+		exit(EXIT_FAILURE);
+	}
+	SetupCloth(CLOTH_SIZES[0]);
 
 	//disable vsync
 	wglSwapIntervalEXT(0);
@@ -810,67 +604,24 @@ void OnReshape(int nw, int nh) {
 	//get the viewport
 	glGetIntegerv(GL_VIEWPORT, viewport);
 }
-//update and rendering of cloth particles
-void RenderGPU_TF() {
-	CHECK_GL_ERRORS
 
-	//set the cloth vertex shader
-	massSpringShader.Use();
-	CHECK_GL_ERRORS
-		//pass shader uniforms
-		glUniformMatrix4fv(massSpringShader("MVP"), 1, GL_FALSE, glm::value_ptr(mMVP));
-	 
-		CHECK_GL_ERRORS
-		//run the iteration loop
-		for(int i=0;i<NUM_ITER;i++) {
-			//set the buffer texture for current position 
-			glActiveTexture( GL_TEXTURE0);
-			glBindTexture( GL_TEXTURE_BUFFER, texPosID[writeID]);
-
-			//set the buffer texture for previous position
-			glActiveTexture( GL_TEXTURE1);
-			glBindTexture( GL_TEXTURE_BUFFER, texPrePosID[writeID]);
-
-			//set the update vertex array object
-			glBindVertexArray( vaoUpdateID[writeID]);
-				//bind transform feedback buffers
-				//index 0 -> current position
-				//index 1 -> previous position
-				glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, vboID_Pos[readID]);
-				glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 1, vboID_PrePos[readID]);
-				// disable rasterization
-				glEnable(GL_RASTERIZER_DISCARD);  
-					//run hardware timer query
-					glBeginQuery(GL_TIME_ELAPSED,t_query);
-						//initiate transform feedback
-						glBeginTransformFeedback(GL_POINTS);
-							//render points, this call pushes all attributes to GPU
-							glDrawArrays(GL_POINTS, 0, total_points);
-						//end transform feedback
-						glEndTransformFeedback();
-					//end timer query
-					glEndQuery(GL_TIME_ELAPSED);
-					glFlush();
-				//enable rasterizer
-				glDisable(GL_RASTERIZER_DISCARD);
-
-			//swap read/write pathways
-			int tmp = readID;
-			readID=writeID;
-			writeID = tmp;
-		}
-		CHECK_GL_ERRORS
-		// get the query result
-		glGetQueryObjectui64v(t_query, GL_QUERY_RESULT, &elapsed_time);
-		//get the transform feedback time
-		delta_time = elapsed_time / 1000000.0f;
-	//remove the cloth vertex shader
-	massSpringShader.UnUse();
+//update and rendering of cloth particles
+void StepAndRenderCloth() {
+	//advance the cloth by one frame on the selected solver
+	if(bUseGPU) {
+		gpuCloth.Step(timeStep);
+	} else {
+		cpuCloth.Step(timeStep);
+		cpuCloth.Write(&X[0].x);
+		glBindBuffer(GL_ARRAY_BUFFER, clothVBOVerticesID);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, X.size()*sizeof(glm::vec4), &X[0].x);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
 
 	CHECK_GL_ERRORS;
 
 	//bind the render vertex array object
-	glBindVertexArray(vaoRenderID[writeID]);
+	glBindVertexArray(clothVAOID[bUseGPU? 1 : 0]);
 		//disable depth test
 		glDisable(GL_DEPTH_TEST);
 			//set the render shader
@@ -878,7 +629,7 @@ void RenderGPU_TF() {
 				//set the shader uniform
 				glUniformMatrix4fv(renderShader("MVP"), 1, GL_FALSE, glm::value_ptr(mMVP));
 					//draw the cloth geometry
-					glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_SHORT,0);
+					glDrawElements(GL_TRIANGLES, total_indices, GL_UNSIGNED_INT,0);
 			//remove render shader
 			renderShader.UnUse();
 		//enable depth test
@@ -893,16 +644,15 @@ void RenderGPU_TF() {
 				glUniformMatrix4fv(particleShader("MV"), 1, GL_FALSE, glm::value_ptr(mMV));
 				glUniformMatrix4fv(particleShader("MVP"), 1, GL_FALSE, glm::value_ptr(mMVP));
 					//draw the masses last
-			  		glDrawArrays(GL_POINTS, 0, total_points);
-					//this also renders particles
-					//glDrawTransformFeedbackStream(GL_POINTS, tfID, 0);
+		  			glDrawArrays(GL_POINTS, 0, total_points);
 			//remove the particle shader
 			particleShader.UnUse();
 		}
 	//remove the currently bound vertex array object
 	glBindVertexArray( 0);
 
-	CHECK_GL_ERRORS
+	CHECK_GL_ERRORS 
+
 }
 
 //display function
@@ -911,12 +661,11 @@ void OnRender() {
 	//timing related function calls
 	float newTime = (float) glutGet(GLUT_ELAPSED_TIME);
 	frameTime = newTime-currentTime;
-	currentTime = newTime;
-	
+	currentTime = newTime; 
+
 	//Using high res. counter
     QueryPerformanceCounter(&t2);
-	 
-	// compute and print the elapsed time in millisec
+	 // compute and print the elapsed time in millisec
     frameTimeQP = (t2.QuadPart - t1.QuadPart) * 1000.0 / frequency.QuadPart;
 	t1=t2;
 	accumulator += frameTimeQP;
@@ -929,7 +678,10 @@ void OnRender() {
 		fps = (totalFrames/ elapsedTime)*1000 ;
 		startTime = newTime;
 		totalFrames=0;
-		sprintf_s(info, "FPS: %3.2f, Frame time (GLUT): %3.4f msecs, Frame time (QP): %3.3f, TF Time: %3.3f", fps, frameTime, frameTimeQP, delta_time);
+		if(bUseGPU)
+			sprintf_s(info, "FPS: %3.2f, Frame time (QP): %3.3f msecs, Cloth: %dx%d, Self collision: %s, XPBD on GPU: %3.3f msecs", fps, frameTimeQP, numX, numY, collision.IsSelfCollision()? "on" : "off", gpuCloth.GetStepTime());
+		else
+			sprintf_s(info, "FPS: %3.2f, Frame time (QP): %3.3f msecs, Cloth: %dx%d, Self collision: %s, XPBD on CPU (%d threads): %3.3f msecs", fps, frameTimeQP, numX, numY, collision.IsSelfCollision()? "on" : "off", threadPool.GetTotalThreads(), cpuCloth.GetStepTime());
 	}
 
 	glutSetWindowTitle(info);
@@ -960,7 +712,7 @@ void OnRender() {
 	DrawSphere(mP*(mMV*ellipsoid));
 
 	//deform and render cloth 
-	RenderGPU_TF(); 
+	StepAndRenderCloth();
 
 	//swap back and front buffers to display the result on screen
 	glutSwapBuffers();
@@ -969,20 +721,8 @@ void OnRender() {
 //delete all allocated objects
 void OnShutdown() {
 	X.clear();
-	X_last.clear();
-	F.clear();
-	indices.clear();
-	springs.clear();
-
-	glDeleteQueries(1, &query);
-	glDeleteQueries(1, &t_query);
 
-	glDeleteTextures( 2, texPosID);
-	glDeleteTextures( 2, texPrePosID);
-
-	glDeleteVertexArrays(2, vaoUpdateID);
-	glDeleteVertexArrays(2, vaoRenderID);
-	glDeleteVertexArrays(1, &clothVAOID);
+	glDeleteVertexArrays(2, clothVAOID);
 	glDeleteVertexArrays(1, &gridVAOID);
 	glDeleteVertexArrays(1, &sphereVAOID);
 
@@ -993,26 +733,27 @@ void OnShutdown() {
 	glDeleteBuffers( 1, &sphereVerticesID);
 	glDeleteBuffers( 1, &sphereIndicesID);
 
-    glDeleteBuffers( 2, vboID_Pos);
-	glDeleteBuffers( 2, vboID_PrePos);
-	glDeleteBuffers( 1, &vboIndices);
-
-	glDeleteTransformFeedbacks(1, &tfID);
+	cpuCloth.Destroy();
+	gpuCloth.Destroy();
+	threadPool.Destroy();
 	renderShader.DeleteShaderProgram();
-	massSpringShader.DeleteShaderProgram();
 	particleShader.DeleteShaderProgram();
-	printf("Shutdown successful");
 }
 
-
 void OnIdle() {
 	glutPostRedisplay();
 }
- 
+
 //keyboard event handler
 void OnKey(unsigned char key, int , int) {
 	switch(key) {
 		case 'm':	bDisplayMasses=!bDisplayMasses;	break;
+		case 'c':	collision.SetSelfCollision(!collision.IsSelfCollision());	break;
+		//switching the solver restarts the cloth from its rest pose
+		case 'g':	bUseGPU=!bUseGPU; SetupCloth(numX);	break;
+		case '1':
+		case '2':
+		case '3':	SetupCloth(CLOTH_SIZES[key-'1']);	break;
 	}
 
 	glutPostRedisplay();
@@ -1021,13 +762,13 @@ void OnKey(unsigned char key, int , int) {
 int main(int argc, char** argv) {
 	//freeglut initialization calls
 	glutInit(&argc, argv);
-	glutInitContextVersion(3,3);
+	glutInitContextVersion(4,3);
 	glutInitContextProfile(GLUT_CORE_PROFILE);
 	glutInitContextFlags(GLUT_FORWARD_COMPATIBLE);
 
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
 	glutInitWindowSize(width, height);
-	glutCreateWindow("GLUT Cloth Demo using Transform Feedback");
+	glutCreateWindow("GLUT Cloth Demo using XPBD with Collision");
 
 	//callback hooks
 	glutDisplayFunc(OnRender);
@@ -1049,22 +790,16 @@ int main(int argc, char** argv) {
 
 	GLuint error = glGetError();
 
-	// Only continue, if OpenGL 3.3 is supported.
-	if (!glewIsSupported("GL_VERSION_3_3"))
-	{
-  		puts("OpenGL 3.3 not supported.");
-		exit(EXIT_FAILURE);
-	} else {
-		puts("OpenGL 3.3 supported.");
-	}
-	if(!glewIsExtensionSupported("GL_ARB_transform_feedback2"))
+	// Only continue, if OpenGL 4.3 is supported.
+	if (!glewIsSupported("GL_VERSION_4_3"))
 	{
-		puts("Your hardware does not support a required extension [GL_ARB_transform_feedback2].");
+  		puts("OpenGL 4.3 not supported.");
 		exit(EXIT_FAILURE);
 	} else {
-		puts("GL_ARB_transform_feedback2 supported.");
+		puts("OpenGL 4.3 supported.");
 	}
-	//output information on screen
+
+	//print information on screen
 	printf("Using GLEW %s\n",glewGetString(GLEW_VERSION));
 	printf("Vendor: %s\n",glGetString (GL_VENDOR));
 	printf("Renderer: %s\n",glGetString (GL_RENDERER));
@@ -1079,4 +814,3 @@ int main(int argc, char** argv) {
 
 	return 0;
 }
-
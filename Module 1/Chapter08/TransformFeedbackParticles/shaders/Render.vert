@@ -1,7 +1,13 @@
-#version 330 core
+#version 430 core
 precision highp float;
 
-layout (location=0) in vec4 position;	//particle object space position
+struct Particle {
+	vec4 position;	//xyz position, w remaining life
+	vec4 velocity;	//xyz velocity, w total life
+};
+
+layout(std430, binding = 0) readonly buffer ParticleBuffer { Particle particles[]; };
+layout(std430, binding = 2) readonly buffer AliveList { uvec2 alive[]; };	//sorted (key, particle index)
 
 uniform mat4 MVP;						//combine modelview projection matrix
 
@@ -14,11 +20,14 @@ const vec3 YELLOW = vec3(1,1,0);
 
 void main() 
 {  
+	//the particles are drawn in the order of the sorted alive list
+	Particle p = particles[alive[gl_VertexID].y];
+
 	//store the clip space position
-	gl_Position = MVP*vec4(position.xyz, 1.0);	
+	gl_Position = MVP*vec4(p.position.xyz, 1.0);	
 	//get the t value for interpolation of the colour map colours 
-	//using the distance of the particle from the origin, if it is 
-	//3 or greater, the particle colour is changed to yellow
-	float t =  1.0- length(position.xyz)/3.0;	
+	//from the remaining life of the particle, young particles are red 
+	//and turn yellow and transparent as they age
+	float t = p.position.w/p.velocity.w;	
 	color = vec4(mix(YELLOW, RED, t), t);
 }
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "AnimationClip.h"
+#include <algorithm>
+#include <cmath>
+
+CAnimationClip::CAnimationClip(void)
+{
+	duration = 0;
+}
+
+CAnimationClip::~CAnimationClip(void)
+{
+	Clear();
+}
+
+void CAnimationClip::Clear() {
+	tracks.clear();
+	duration = 0;
+}
+
+void CAnimationClip::AddTrack(const int bone, const int totalKeys, const float* times, const BonePose* keys) {
+	if(totalKeys<=0)
+		return;
+	Track track;
+	track.bone = bone;
+	track.times.assign(times, times+totalKeys);
+	track.keys.assign(keys, keys+totalKeys);
+
+	//keep neighbouring rotations in the same hemisphere so sampling can
+	//interpolate without checking the sign
+	for(int i=1;i<totalKeys;i++) {
+		float* q = track.keys[i].rotation;
+		const float* p = track.keys[i-1].rotation;
+		if(q[0]*p[0] + q[1]*p[1] + q[2]*p[2] + q[3]*p[3] < 0) {
+			for(int k=0;k<4;k++)
+				q[k] = -q[k];
+		}
+	}
+	tracks.push_back(track);
+	duration = std::max(duration, times[totalKeys-1]);
+}
+
+size_t CAnimationClip::GetSize() const {
+	size_t size = 0;
+	for(size_t i=0;i<tracks.size();i++)
+		size += tracks[i].times.size()*(sizeof(float)+sizeof(BonePose));
+	return size;
+}
+
+static void Interpolate(const BonePose& a, const BonePose& b, const float t, BonePose& result, const float sign) {
+	const float s = 1-t;
+	for(int k=0;k<3;k++) {
+		result.position[k] = s*a.position[k] + t*b.position[k];
+		result.scale[k] = s*a.scale[k] + t*b.scale[k];
+	}
+	//normalized linear interpolation, close enough to slerp for the small
+	//angles between keys and much cheaper
+	float len = 0;
+	for(int k=0;k<4;k++) {
+		result.rotation[k] = s*a.rotation[k] + sign*t*b.rotation[k];
+		len += result.rotation[k]*result.rotation[k];
+	}
+	len = (len>0)? 1.0f/sqrtf(len) : 0.0f;
+	for(int k=0;k<4;k++)
+		result.rotation[k] *= len;
+}
+
+void CAnimationClip::Blend(const BonePose& a, const BonePose& b, const float t, BonePose& result) {
+	const float d = a.rotation[0]*b.rotation[0] + a.rotation[1]*b.rotation[1] +
+					a.rotation[2]*b.rotation[2] + a.rotation[3]*b.rotation[3];
+	Interpolate(a, b, t, result, (d<0)? -1.0f : 1.0f);
+}
+
+void CAnimationClip::Sample(const float time, int* cursors, BonePose* pose) const {
+	for(size_t i=0;i<tracks.size();i++) {
+		const Track& track = tracks[i];
+		const int last = int(track.times.size())-1;
+		BonePose& result = pose[track.bone];
+		if(last==0) {
+			result = track.keys[0];
+			continue;
+		}
+		//the cursor only moves forward, it restarts when the time wraps
+		int key = cursors[i];
+		if(key>last-1 || time < track.times[key])
+			key = 0;
+		while(key<last-1 && track.times[key+1] <= time)
+			key++;
+		cursors[i] = key;
+
+		const float t0 = track.times[key], t1 = track.times[key+1];
+		float t = (t1>t0)? (time-t0)/(t1-t0) : 0.0f;
+		t = std::max(0.0f, std::min(1.0f, t));
+		Interpolate(track.keys[key], track.keys[key+1], t, result, 1.0f);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+//local transform of a bone relative to its parent
+struct BonePose {
+	float position[3];
+	float rotation[4];	//unit quaternion x,y,z,w
+	float scale[3];
+};
+
+//A skeletal animation that can be sampled at any time. Samplers keep cursors
+//that remember the last keys used, so playing forward only steps to the next
+//key instead of searching the key list every frame. Every caller (animation
+//instance) owns its cursors.
+class CAbstractClip
+{
+public:
+	virtual ~CAbstractClip(void) {}
+
+	virtual float GetDuration() const = 0;
+	//number of cursors Sample needs
+	virtual int GetTotalCursors() const = 0;
+
+	//writes the pose of every animated bone at time, in [0, duration].
+	//cursors must start at 0.
+	virtual void Sample(const float time, int* cursors, BonePose* pose) const = 0;
+};
+
+//An uncompressed clip made of one key framed track per animated bone, with
+//one cursor per track.
+class CAnimationClip : public CAbstractClip
+{
+public:
+	CAnimationClip(void);
+	~CAnimationClip(void);
+
+	void Clear();
+
+	//adds the keys of a bone, times must be increasing and start at 0
+	void AddTrack(const int bone, const int totalKeys, const float* times, const BonePose* keys);
+
+	float GetDuration() const { return duration; }
+	int GetTotalCursors() const { return int(tracks.size()); }
+	void Sample(const float time, int* cursors, BonePose* pose) const;
+
+	int GetTotalTracks() const { return int(tracks.size()); }
+	int GetTrackBone(const int track) const { return tracks[track].bone; }
+	int GetTotalKeys(const int track) const { return int(tracks[track].times.size()); }
+	const float* GetKeyTimes(const int track) const { return &tracks[track].times[0]; }
+	const BonePose* GetKeys(const int track) const { return &tracks[track].keys[0]; }
+
+	//memory used by the keys in bytes
+	size_t GetSize() const;
+
+	//interpolates a and b, rotations are blended along the shorter arc
+	static void Blend(const BonePose& a, const BonePose& b, const float t, BonePose& result);
+
+private:
+	struct Track {
+		int bone;
+		std::vector<float> times;
+		std::vector<BonePose> keys;
+	};
+	std::vector<Track> tracks;
+	float duration;
+};
\ No newline at end of file
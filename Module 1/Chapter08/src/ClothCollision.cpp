@@ -0,0 +1,282 @@
+#include "ClothCollision.h"
+#include <algorithm>
+
+//fraction of the thickness a particle may travel in one substep, which
+//bounds how far it gets in a frame
+const float MAX_TRAVEL = 0.2f;
+
+//constraints keep edges close to their rest length, this is the slack
+const float EDGE_SLACK = 1.25f;
+
+CClothCollision::CClothCollision(void)
+{
+	total = 0;
+	thickness = 0;
+	maxEdge = 0;
+	selfCollision = true;
+	substeps = 10;
+	tableSize = 0;
+	cellSize = 1;
+	fx = fy = fz = 0;
+}
+
+CClothCollision::~CClothCollision(void)
+{
+}
+
+void CClothCollision::Init(const CClothConstraints& constraints, const float t) {
+	thickness = t;
+	total = constraints.GetTotalParticles();
+	indices = constraints.GetIndices();
+	const std::vector<glm::vec4>& p = constraints.GetPositions();
+	rest.resize(total);
+	for(int i=0;i<total;i++)
+		rest[i] = glm::vec3(p[i]);
+
+	//triangles around every vertex and the longest edge
+	const int totalTriangles = int(indices.size()/3);
+	triangleStart.assign(total+1, 0);
+	maxEdge = 0;
+	for(int i=0;i<totalTriangles;i++) {
+		for(int k=0;k<3;k++) {
+			triangleStart[indices[3*i+k]+1]++;
+			glm::vec3 e = glm::vec3(p[indices[3*i+k]] - p[indices[3*i+(k+1)%3]]);
+			maxEdge = std::max(maxEdge, glm::length(e));
+		}
+	}
+	maxEdge *= EDGE_SLACK;
+	for(int i=0;i<total;i++)
+		triangleStart[i+1] += triangleStart[i];
+	vertexTriangles.resize(triangleStart[total]);
+	std::vector<int> cursor(triangleStart.begin(), triangleStart.end()-1);
+	for(int i=0;i<totalTriangles;i++)
+		for(int k=0;k<3;k++)
+			vertexTriangles[cursor[indices[3*i+k]]++] = i;
+
+	//twice as many table entries as particles keeps hash collisions rare
+	tableSize = 1;
+	while(tableSize < 2*total)
+		tableSize <<= 1;
+	cellStart.resize(tableSize+1);
+	cellEntries.resize(total);
+	neighborCount.assign(total, 0);
+	neighbors.resize(total*MAX_NEIGHBORS);
+	triangleCount.assign(total, 0);
+	triangles.resize(total*MAX_TRIANGLES);
+}
+
+bool CClothCollision::AddCollider(const CMeshCollider* mesh, const glm::mat4& transform) {
+	if(int(colliders.size()) >= MAX_COLLIDERS)
+		return false;
+	Collider c;
+	c.mesh = mesh;
+	c.transform = transform;
+	c.inverse = glm::inverse(transform);
+	c.scale = glm::length(glm::vec3(transform[0]));
+	colliders.push_back(c);
+	return true;
+}
+
+float CClothCollision::GetMaxVelocity(const float dt) const {
+	return MAX_TRAVEL*thickness*substeps/dt;
+}
+
+float CClothCollision::GetSearchRadius() const {
+	//a particle and whatever it touches may both travel for a whole frame
+	return std::max(2*thickness, thickness+maxEdge) + 2*MAX_TRAVEL*thickness*substeps;
+}
+
+float CClothCollision::GetPairRadius() const {
+	return 2*thickness + 2*MAX_TRAVEL*thickness*substeps;
+}
+
+float CClothCollision::GetTriangleRadius() const {
+	return thickness + 2*MAX_TRAVEL*thickness*substeps;
+}
+
+glm::ivec3 CClothCollision::Cell(const glm::vec3& p) const {
+	return glm::ivec3(int(floorf(p.x/cellSize)), int(floorf(p.y/cellSize)), int(floorf(p.z/cellSize)));
+}
+
+int CClothCollision::Hash(const glm::ivec3& c) const {
+	unsigned int h = (unsigned int)(c.x)*92837111u ^ (unsigned int)(c.y)*689287499u ^ (unsigned int)(c.z)*283923481u;
+	return int(h & (tableSize-1));
+}
+
+void CClothCollision::FindCandidates(const float* x, const float* y, const float* z, CThreadPool* pool) {
+	fx = x; fy = y; fz = z;
+	cellSize = GetSearchRadius();
+
+	//counting sort of the particles by table entry
+	std::fill(cellStart.begin(), cellStart.end(), 0);
+	for(int i=0;i<total;i++)
+		cellStart[Hash(Cell(glm::vec3(x[i], y[i], z[i])))+1]++;
+	for(int i=0;i<tableSize;i++)
+		cellStart[i+1] += cellStart[i];
+	std::vector<int> cursor(cellStart.begin(), cellStart.end()-1);
+	for(int i=0;i<total;i++)
+		cellEntries[cursor[Hash(Cell(glm::vec3(x[i], y[i], z[i])))]++] = i;
+
+	pool->Run((total+CHUNK_SIZE-1)/CHUNK_SIZE, FindTask, this);
+}
+
+void CClothCollision::FindTask(int task, void* data) {
+	CClothCollision* collision = static_cast<CClothCollision*>(data);
+	int start = task*CHUNK_SIZE;
+	collision->FindRange(start, std::min(start+CHUNK_SIZE, collision->total));
+}
+
+//cheap test of the bounds of a triangle against a sphere
+static inline bool InReach(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const float radius) {
+	glm::vec3 lo = glm::min(a, glm::min(b, c)) - radius;
+	glm::vec3 hi = glm::max(a, glm::max(b, c)) + radius;
+	return p.x > lo.x && p.y > lo.y && p.z > lo.z && p.x < hi.x && p.y < hi.y && p.z < hi.z;
+}
+
+//keeps the count closest candidates, replacing the farthest one when full
+static void Insert(int* list, float* distances, int& count, const int max, const int value, const float distance) {
+	if(count < max) {
+		list[count] = value;
+		distances[count++] = distance;
+		return;
+	}
+	int farthest = int(std::max_element(distances, distances+max) - distances);
+	if(distance < distances[farthest]) {
+		list[farthest] = value;
+		distances[farthest] = distance;
+	}
+}
+
+void CClothCollision::FindRange(const int start, const int end) {
+	const float r2 = cellSize*cellSize;
+	const float pairRadius = GetPairRadius();
+	const float triangleRadius = GetTriangleRadius();
+	float nd[MAX_NEIGHBORS], td[MAX_TRIANGLES];
+	for(int i=start;i<end;i++) {
+		glm::vec3 p(fx[i], fy[i], fz[i]);
+		glm::ivec3 c = Cell(p);
+		int* n = &neighbors[i*MAX_NEIGHBORS];
+		int* t = &triangles[i*MAX_TRIANGLES];
+		int nc = 0, tc = 0;
+		if(!selfCollision) {
+			neighborCount[i] = triangleCount[i] = 0;
+			continue;
+		}
+		for(int dz=-1;dz<=1;dz++) for(int dy=-1;dy<=1;dy++) for(int dx=-1;dx<=1;dx++) {
+			int h = Hash(c+glm::ivec3(dx, dy, dz));
+			for(int e=cellStart[h];e<cellStart[h+1];e++) {
+				int j = cellEntries[e];
+				if(j == i)
+					continue;
+				glm::vec3 d = glm::vec3(fx[j], fy[j], fz[j]) - p;
+				float d2 = glm::dot(d, d);
+				if(d2 >= r2)
+					continue;
+				//particles close in the rest pose are kept apart by the
+				//constraints, skipping them keeps the lists for real contacts
+				glm::vec3 r = rest[j] - rest[i];
+				if(glm::dot(r, r) < r2)
+					continue;
+				//different cells can share a table entry, so j may come twice
+				float dj = sqrtf(d2);
+				if(dj < pairRadius && std::find(n, n+nc, j) == n+nc)
+					Insert(n, nd, nc, MAX_NEIGHBORS, j, dj);
+
+				//triangles of a close particle may come within reach. The cell
+				//size covers the longest edge, so every triangle in reach has
+				//its first vertex in the cells and is visited only from there.
+				for(int k=triangleStart[j];k<triangleStart[j+1];k++) {
+					int tri = vertexTriangles[k];
+					unsigned int a = indices[3*tri], b = indices[3*tri+1], v = indices[3*tri+2];
+					if(a != unsigned(j) || b == unsigned(i) || v == unsigned(i))
+						continue;
+					glm::vec3 pa(fx[a], fy[a], fz[a]), pb(fx[b], fy[b], fz[b]), pc(fx[v], fy[v], fz[v]);
+					if(!InReach(p, pa, pb, pc, triangleRadius))
+						continue;
+					bool interior;
+					float distance = glm::length(p - CMeshBVH::ClosestPointOnTriangle(p, pa, pb, pc, interior));
+					if(distance >= triangleRadius)
+						continue;
+					float side = glm::dot(p-pa, glm::cross(pb-pa, pc-pa));
+					Insert(t, td, tc, MAX_TRIANGLES, (side >= 0)? tri+1 : -(tri+1), distance);
+				}
+			}
+		}
+		neighborCount[i] = nc;
+		triangleCount[i] = tc;
+	}
+}
+
+void CClothCollision::Solve(const float* px, const float* py, const float* pz, const float* w,
+							float* dstX, float* dstY, float* dstZ, const int start, const int end) const {
+	const float distance = 2*thickness;
+	for(int i=start;i<end;i++) {
+		glm::vec3 p(px[i], py[i], pz[i]);
+		if(w[i] > 0) {
+			//the corrections of all contacts are averaged
+			glm::vec3 delta(0);
+			int contacts = 0;
+			const int* n = &neighbors[i*MAX_NEIGHBORS];
+			for(int k=0;k<neighborCount[i];k++) {
+				int j = n[k];
+				glm::vec3 d = p - glm::vec3(px[j], py[j], pz[j]);
+				float len2 = glm::dot(d, d);
+				if(len2 >= distance*distance || len2 < 1e-18f)
+					continue;
+				float len = sqrtf(len2);
+				//each particle of the pair moves its share of the overlap
+				delta += d*((distance-len)/len*w[i]/(w[i]+w[j]));
+				contacts++;
+			}
+			const int* t = &triangles[i*MAX_TRIANGLES];
+			for(int k=0;k<triangleCount[i];k++) {
+				int tri = abs(t[k])-1;
+				float side = (t[k] > 0)? 1.0f : -1.0f;
+				unsigned int a = indices[3*tri], b = indices[3*tri+1], c = indices[3*tri+2];
+				glm::vec3 pa(px[a], py[a], pz[a]), pb(px[b], py[b], pz[b]), pc(px[c], py[c], pz[c]);
+				if(!InReach(p, pa, pb, pc, thickness))
+					continue;
+				bool interior;
+				glm::vec3 q = CMeshBVH::ClosestPointOnTriangle(p, pa, pb, pc, interior);
+				float share = w[i]/(w[i] + (w[a]+w[b]+w[c])/3.0f);
+				if(interior) {
+					//keep the particle on its side of the triangle
+					glm::vec3 normal = glm::cross(pb-pa, pc-pa);
+					float area = glm::length(normal);
+					if(area < 1e-12f)
+						continue;
+					normal *= side/area;
+					float d = glm::dot(p-q, normal);
+					if(d >= thickness)
+						continue;
+					delta += normal*((thickness-d)*share);
+				} else {
+					glm::vec3 d = p-q;
+					float len = glm::length(d);
+					if(len >= thickness || len < 1e-9f)
+						continue;
+					delta += d*((thickness-len)/len*share);
+				}
+				contacts++;
+			}
+			if(contacts > 0)
+				p += delta/float(contacts);
+
+			//push out of the colliders along the distance gradient
+			for(size_t k=0;k<colliders.size();k++) {
+				const Collider& c = colliders[k];
+				glm::vec3 local = glm::vec3(c.inverse*glm::vec4(p, 1));
+				float d = c.mesh->Distance(local)*c.scale;
+				if(d >= thickness)
+					continue;
+				glm::vec3 g = glm::mat3(c.transform)*c.mesh->Gradient(local);
+				float len = glm::length(g);
+				if(len > 1e-9f)
+					p += g*((thickness-d)/len);
+			}
+		}
+		dstX[i] = p.x;
+		dstY[i] = p.y;
+		dstZ[i] = p.z;
+	}
+}
\ No newline at end of file
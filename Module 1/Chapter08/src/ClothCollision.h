@@ -0,0 +1,112 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "ClothConstraints.h"
+#include "MeshCollider.h"
+#include "ThreadPool.h"
+
+//Collision handling of a cloth against itself and against mesh colliders.
+//Once per frame the particles are put into a uniform spatial hash and every
+//particle collects the nearby particles and triangles it may touch during
+//the frame, the velocity is clamped so that no particle can travel further
+//than assumed. Every substep each particle then pushes itself out of its
+//candidates and out of the signed distance fields of the colliders. A
+//particle only ever writes its own position (a Jacobi step), so the same
+//pass runs on threads and in a compute shader without conflicts.
+class CClothCollision
+{
+public:
+	//candidate particles and triangles stored per particle
+	static const int MAX_NEIGHBORS = 24;
+	static const int MAX_TRIANGLES = 24;
+	static const int MAX_COLLIDERS = 4;
+
+	//a collider placed with a rigid transform and a uniform scale
+	struct Collider {
+		const CMeshCollider* mesh;
+		glm::mat4 transform, inverse;
+		float scale;
+	};
+
+	CClothCollision(void);
+	~CClothCollision(void);
+
+	//thickness is the distance kept from colliders and from the cloth
+	//itself, particles keep twice the thickness between each other
+	void Init(const CClothConstraints& constraints, const float thickness);
+
+	void SetSelfCollision(const bool enable) { selfCollision = enable; }
+	//substeps per frame of the solver, the velocity bound depends on it
+	void SetSubsteps(const int n) { substeps = n; }
+	bool IsSelfCollision() const { return selfCollision; }
+	float GetThickness() const { return thickness; }
+
+	void ClearColliders() { colliders.clear(); }
+	bool AddCollider(const CMeshCollider* mesh, const glm::mat4& transform);
+	int GetTotalColliders() const { return int(colliders.size()); }
+	const Collider& GetCollider(const int i) const { return colliders[i]; }
+
+	//fastest velocity allowed for a frame of dt seconds, the candidates of a
+	//frame stay valid up to this speed
+	float GetMaxVelocity(const float dt) const;
+	//candidate radius and hash cell size
+	float GetSearchRadius() const;
+	//largest distance between two particles that may collide in the frame
+	float GetPairRadius() const;
+	//largest distance of a particle to a triangle it may hit in the frame
+	float GetTriangleRadius() const;
+	int GetTableSize() const { return tableSize; }
+
+	//triangles around every particle, for each particle the triangles
+	//vertexTriangles[triangleStart[i]] to vertexTriangles[triangleStart[i+1]]
+	const std::vector<int>& GetTriangleStart() const { return triangleStart; }
+	const std::vector<int>& GetVertexTriangles() const { return vertexTriangles; }
+	const std::vector<unsigned int>& GetIndices() const { return indices; }
+
+	//collects the candidates of every particle from the positions at the
+	//start of a frame
+	void FindCandidates(const float* x, const float* y, const float* z, CThreadPool* pool);
+
+	//candidate lists, MAX_NEIGHBORS/MAX_TRIANGLES entries per particle
+	const std::vector<int>& GetNeighborCount() const { return neighborCount; }
+	const std::vector<int>& GetNeighbors() const { return neighbors; }
+	const std::vector<int>& GetTriangleCount() const { return triangleCount; }
+	const std::vector<int>& GetTriangles() const { return triangles; }
+
+	//pushes the predicted positions of the particles [start, end) out of the
+	//candidates and the colliders and writes them to dst
+	void Solve(const float* px, const float* py, const float* pz, const float* w,
+			   float* dstX, float* dstY, float* dstZ, const int start, const int end) const;
+
+private:
+	static const int CHUNK_SIZE = 1024;
+
+	int Hash(const glm::ivec3& cell) const;
+	glm::ivec3 Cell(const glm::vec3& p) const;
+	void FindRange(const int start, const int end);
+	static void FindTask(int task, void* data);
+
+	int total;
+	float thickness;
+	float maxEdge;			//longest triangle edge allowed by the constraints
+	bool selfCollision;
+	int substeps;
+	std::vector<Collider> colliders;
+
+	std::vector<glm::vec3> rest;
+	std::vector<unsigned int> indices;
+	std::vector<int> triangleStart, vertexTriangles;
+
+	//spatial hash, the particles of every table entry in cellStart order
+	int tableSize;
+	float cellSize;
+	std::vector<int> cellStart, cellEntries;
+
+	//per particle candidate lists, triangles are stored as (index+1)
+	//signed with the side of the triangle the particle started on
+	std::vector<int> neighborCount, neighbors;
+	std::vector<int> triangleCount, triangles;
+
+	//positions of the frame shared with the tasks
+	const float *fx, *fy, *fz;
+};
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "ClothConstraints.h"
+#include <algorithm>
+
+CClothConstraints::CClothConstraints(void)
+{
+}
+
+CClothConstraints::~CClothConstraints(void)
+{
+}
+
+void CClothConstraints::Add(const int a, const int b, const ConstraintType type) {
+	Constraint c;
+	c.a = a;
+	c.b = b;
+	c.restLength = glm::length(glm::vec3(positions[a]-positions[b]));
+	c.type = type;
+	constraints.push_back(c);
+}
+
+void CClothConstraints::Build(const int numX, const int numY, const float sizeX, const float sizeY, const float height) {
+	const int u = numX+1, v = numY+1;
+	positions.resize(u*v);
+	constraints.clear();
+	indices.clear();
+
+	//fill in positions, the same layout as the mass spring cloth
+	for(int j=0;j<v;j++)
+		for(int i=0;i<u;i++)
+			positions[j*u+i] = glm::vec4((float(i)/numX*2-1)*sizeX*0.5f, height, float(j)/numY*sizeY, 1);
+	positions[0].w = 0;
+	positions[numX].w = 0;
+	anchors.clear();
+	anchors.push_back(0);
+	anchors.push_back(numX);
+
+	//fill in indices
+	for(int j=0;j<numY;j++) {
+		for(int i=0;i<numX;i++) {
+			unsigned int i0 = j*u+i, i1 = i0+1, i2 = i0+u, i3 = i2+1;
+			if((i+j)%2) {
+				unsigned int t[6] = {i0, i2, i1, i1, i2, i3};
+				indices.insert(indices.end(), t, t+6);
+			} else {
+				unsigned int t[6] = {i0, i2, i3, i0, i3, i1};
+				indices.insert(indices.end(), t, t+6);
+			}
+		}
+	}
+
+	//stretch
+	for(int j=0;j<v;j++)
+		for(int i=0;i<u-1;i++)
+			Add(j*u+i, j*u+i+1, STRETCH);
+	for(int i=0;i<u;i++)
+		for(int j=0;j<v-1;j++)
+			Add(j*u+i, (j+1)*u+i, STRETCH);
+
+	//shear
+	for(int j=0;j<v-1;j++) {
+		for(int i=0;i<u-1;i++) {
+			Add(j*u+i, (j+1)*u+i+1, SHEAR);
+			Add((j+1)*u+i, j*u+i+1, SHEAR);
+		}
+	}
+
+	//bend
+	for(int j=0;j<v;j++)
+		for(int i=0;i<u-2;i++)
+			Add(j*u+i, j*u+i+2, BEND);
+	for(int i=0;i<u;i++)
+		for(int j=0;j<v-2;j++)
+			Add(j*u+i, (j+2)*u+i, BEND);
+
+	Color();
+}
+
+void CClothConstraints::Color() {
+	//greedy colouring, every constraint takes the first colour that none of
+	//the constraints on its two particles has. A grid with bend constraints
+	//needs about a dozen colours, every particle keeps one bit per colour in
+	//words of 64 bits and all particles get another word when they run out.
+	const size_t totalParticles = positions.size();
+	int words = 1;
+	std::vector<unsigned long long> used(totalParticles, 0);
+	std::vector<int> color(constraints.size());
+	std::vector<int> counts;
+	for(size_t i=0;i<constraints.size();i++) {
+		const size_t a = constraints[i].a*size_t(words);
+		const size_t b = constraints[i].b*size_t(words);
+		int c = 0;
+		while(c < words*64 && ((used[a+c/64] | used[b+c/64]) & (1ull<<(c%64))))
+			c++;
+		if(c == words*64) {
+			std::vector<unsigned long long> grown(totalParticles*(words+1), 0);
+			for(size_t p=0;p<totalParticles;p++)
+				std::copy(used.begin()+p*words, used.begin()+(p+1)*words, grown.begin()+p*(words+1));
+			used.swap(grown);
+			words++;
+		}
+		used[constraints[i].a*size_t(words)+c/64] |= 1ull<<(c%64);
+		used[constraints[i].b*size_t(words)+c/64] |= 1ull<<(c%64);
+		color[i] = c;
+		if(c >= int(counts.size()))
+			counts.resize(c+1, 0);
+		counts[c]++;
+	}
+	const int totalColors = int(counts.size());
+
+	//lay the batches out one after the other, keeping the generation order
+	//inside a batch so neighbouring lanes touch neighbouring particles
+	Constraint padding;
+	padding.a = padding.b = GetPaddingParticle();
+	padding.restLength = 0;
+	padding.type = STRETCH;
+
+	batchStart.assign(1, 0);
+	std::vector<int> offset(totalColors);
+	for(int c=0;c<totalColors;c++) {
+		offset[c] = batchStart.back();
+		int size = (counts[c]+BATCH_ALIGNMENT-1)/BATCH_ALIGNMENT*BATCH_ALIGNMENT;
+		batchStart.push_back(batchStart.back()+size);
+	}
+	std::vector<Constraint> sorted(batchStart.back(), padding);
+	for(size_t i=0;i<constraints.size();i++)
+		sorted[offset[color[i]]++] = constraints[i];
+	constraints.swap(sorted);
+}
\ No newline at end of file
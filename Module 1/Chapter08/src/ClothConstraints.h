@@ -0,0 +1,67 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+//Distance constraints of a rectangular cloth grid for (extended) position
+//based dynamics. Every particle is connected to its direct neighbours
+//(stretch), its diagonal neighbours (shear) and the particles two nodes
+//away (bend), like the springs of the mass spring cloth. The constraints are
+//graph coloured: no two constraints of a batch share a particle, so all
+//constraints of a batch can be solved at the same time, by SIMD lanes, by
+//threads or by GPU invocations. Batches are padded to a multiple of
+//BATCH_ALIGNMENT with constraints on an extra particle of zero inverse
+//mass, which the solvers allocate after the cloth particles. Pinned
+//particles are also anchors of long range attachments: no particle may be
+//further from an anchor than in the rest pose, which the solvers enforce per
+//particle so a large cloth does not sag from the few constraints holding it.
+class CClothConstraints
+{
+public:
+	enum ConstraintType {STRETCH, SHEAR, BEND, TOTAL_TYPES};
+
+	//batch sizes are a multiple of this, the widest SIMD width of the solvers
+	static const int BATCH_ALIGNMENT = 8;
+
+	//a constraint as it is stored on the GPU
+	struct Constraint {
+		int a, b;			//particle indices
+		float restLength;
+		int type;			//ConstraintType, selects the compliance
+	};
+
+	CClothConstraints(void);
+	~CClothConstraints(void);
+
+	//a grid of (numX+1) x (numY+1) particles spanning sizeX x sizeY at the
+	//given height. The two corners of the first row are pinned.
+	void Build(const int numX, const int numY, const float sizeX, const float sizeY, const float height);
+
+	int GetTotalParticles() const { return int(positions.size()); }
+	//index of the padding particle, one past the cloth particles
+	int GetPaddingParticle() const { return int(positions.size()); }
+	//rest positions (xyz) and inverse masses (w)
+	const std::vector<glm::vec4>& GetPositions() const { return positions; }
+
+	//constraints of all batches including the padding, batch after batch
+	int GetTotalConstraints() const { return int(constraints.size()); }
+	const Constraint* GetConstraints() const { return &constraints[0]; }
+	int GetTotalBatches() const { return int(batchStart.size())-1; }
+	int GetBatchStart(const int batch) const { return batchStart[batch]; }
+	int GetBatchSize(const int batch) const { return batchStart[batch+1]-batchStart[batch]; }
+
+	//pinned particles used as anchors of the long range attachments
+	const std::vector<int>& GetAnchors() const { return anchors; }
+
+	//triangle indices of the cloth surface
+	const std::vector<unsigned int>& GetIndices() const { return indices; }
+
+private:
+	void Add(const int a, const int b, const ConstraintType type);
+	void Color();
+
+	std::vector<glm::vec4> positions;
+	std::vector<Constraint> constraints;
+	std::vector<int> batchStart;
+	std::vector<int> anchors;
+	std::vector<unsigned int> indices;
+};
\ No newline at end of file
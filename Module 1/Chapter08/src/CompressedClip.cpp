@@ -0,0 +1,374 @@
+#include "CompressedClip.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+const char MAGIC[4] = {'E','Z','A','C'};
+const int VERSION = 2;
+
+//longest run of keys replaced by one interpolated segment, bounds the cost of
+//the key reduction on long linear channels
+const int MAX_SEGMENT = 255;
+
+const float SQRT2 = 1.41421356f;
+
+static void EncodeRotation(const float* q, unsigned short* out) {
+	//drop the largest component, it is rebuilt from the unit length. Its sign
+	//is made positive so the other three stay in [-1/sqrt(2), 1/sqrt(2)].
+	int largest = 0;
+	for(int k=1;k<4;k++) {
+		if(fabsf(q[k]) > fabsf(q[largest]))
+			largest = k;
+	}
+	const float sign = (q[largest]<0)? -1.0f : 1.0f;
+	unsigned long long bits = (unsigned long long)largest;
+	int shift = 2;
+	for(int k=0;k<4;k++) {
+		if(k==largest)
+			continue;
+		float v = sign*q[k]*SQRT2*0.5f + 0.5f;
+		int u = int(floorf(v*32767.0f + 0.5f));
+		u = std::max(0, std::min(32767, u));
+		bits |= (unsigned long long)u << shift;
+		shift += 15;
+	}
+	out[0] = (unsigned short)(bits & 0xffff);
+	out[1] = (unsigned short)((bits>>16) & 0xffff);
+	out[2] = (unsigned short)((bits>>32) & 0xffff);
+}
+
+static void DecodeRotation(const unsigned short* in, float* q) {
+	unsigned long long bits = (unsigned long long)in[0] | ((unsigned long long)in[1]<<16) | ((unsigned long long)in[2]<<32);
+	const int largest = int(bits & 3);
+	int shift = 2;
+	float sum = 0;
+	for(int k=0;k<4;k++) {
+		if(k==largest)
+			continue;
+		float u = float((bits>>shift) & 0x7fff);
+		q[k] = (u/32767.0f*2.0f - 1.0f)/SQRT2;
+		sum += q[k]*q[k];
+		shift += 15;
+	}
+	q[largest] = sqrtf(std::max(0.0f, 1.0f-sum));
+}
+
+//decodes a quantized key, positions and scales are stored in the range
+//given by minimum and extent
+static void DecodeKey(const unsigned short* e, const float* minimum, const float* extent, const bool rotation, float* value) {
+	if(rotation) {
+		DecodeRotation(e, value);
+	} else {
+		for(int c=0;c<3;c++)
+			value[c] = minimum[c] + extent[c]*(e[c]/65535.0f);
+	}
+}
+
+//interpolates two keys of a channel, rotations by normalized lerp along the
+//shorter arc
+static void Interpolate(const float* a, const float* b, const float t, const bool rotation, float* result) {
+	if(rotation) {
+		const float sign = (a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3] < 0)? -1.0f : 1.0f;
+		float len = 0;
+		for(int k=0;k<4;k++) {
+			result[k] = (1-t)*a[k] + sign*t*b[k];
+			len += result[k]*result[k];
+		}
+		len = (len>0)? 1.0f/sqrtf(len) : 0.0f;
+		for(int k=0;k<4;k++)
+			result[k] *= len;
+	} else {
+		for(int k=0;k<3;k++)
+			result[k] = (1-t)*a[k] + t*b[k];
+	}
+}
+
+//angle between unit rotations or distance between positions and scales. The
+//angle is found from the chord between the quaternions, acos of their dot
+//product is too inaccurate for small angles.
+static float Error(const float* a, const float* b, const bool rotation) {
+	if(rotation) {
+		const float sign = (a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3] < 0)? -1.0f : 1.0f;
+		float chord = 0;
+		for(int k=0;k<4;k++)
+			chord += (a[k]-sign*b[k])*(a[k]-sign*b[k]);
+		return 4.0f*asinf(std::min(1.0f, 0.5f*sqrtf(chord)));
+	}
+	float e = 0;
+	for(int k=0;k<3;k++)
+		e += (a[k]-b[k])*(a[k]-b[k]);
+	return sqrtf(e);
+}
+
+CCompressedClip::CCompressedClip(void)
+{
+	duration = 0;
+}
+
+CCompressedClip::~CCompressedClip(void)
+{
+	Clear();
+}
+
+void CCompressedClip::Clear() {
+	tracks.clear();
+	duration = 0;
+	tolerance = Tolerance();
+}
+
+bool CCompressedClip::GetSourceStamp(const std::string& filename, long long stamp[2]) {
+	struct stat info;
+	if(stat(filename.c_str(), &info)!=0)
+		return false;
+	stamp[0] = (long long)info.st_size;
+	stamp[1] = (long long)info.st_mtime;
+	return true;
+}
+
+void CCompressedClip::CompressChannel(const float* times, const float* values, const int totalKeys, const int type,
+									  const float tolerance, const float duration, Channel& channel) {
+	const bool rotation = (type==ROTATION);
+	const int size = rotation? 4 : 3;
+
+	//range of the channel
+	for(int c=0;c<3;c++) {
+		float lo = values[c], hi = values[c];
+		for(int k=1;k<totalKeys;k++) {
+			lo = std::min(lo, values[k*size+c]);
+			hi = std::max(hi, values[k*size+c]);
+		}
+		channel.minimum[c] = lo;
+		channel.extent[c] = hi-lo;
+	}
+
+	//quantize every key first, so the error checks below measure the keys
+	//as they are decoded. The skipped keys are checked at their exact times
+	//in 16 bit units, the time Sample interpolates at.
+	std::vector<unsigned short> encoded(totalKeys*3), times16(totalKeys);
+	std::vector<float> decoded(totalKeys*4), exact16(totalKeys);
+	for(int k=0;k<totalKeys;k++) {
+		const float* v = values + k*size;
+		unsigned short* e = &encoded[k*3];
+		if(rotation) {
+			EncodeRotation(v, e);
+		} else {
+			for(int c=0;c<3;c++) {
+				float u = (channel.extent[c]>0)? (v[c]-channel.minimum[c])/channel.extent[c] : 0.0f;
+				e[c] = (unsigned short)std::max(0.0f, std::min(65535.0f, floorf(u*65535.0f + 0.5f)));
+			}
+		}
+		DecodeKey(e, channel.minimum, channel.extent, rotation, &decoded[k*4]);
+		exact16[k] = (duration>0)? times[k]/duration*65535.0f : 0.0f;
+		times16[k] = (unsigned short)std::max(0.0f, std::min(65535.0f, floorf(exact16[k] + 0.5f)));
+	}
+
+	std::vector<int> kept;
+	kept.push_back(0);
+
+	//a channel that stays within the tolerance of its first key is constant
+	bool constant = true;
+	for(int k=1;k<totalKeys && constant;k++)
+		constant = (Error(&decoded[0], values + k*size, rotation) <= tolerance);
+
+	if(!constant) {
+		//greedy key reduction, every segment is grown while the keys it
+		//skips are rebuilt within the tolerance
+		int a = 0;
+		float value[4];
+		while(a < totalKeys-1) {
+			int b = a+1;
+			while(b+1 < totalKeys && b+1-a <= MAX_SEGMENT) {
+				const int next = b+1;
+				bool fits = true;
+				const float span = float(times16[next]) - float(times16[a]);
+				for(int k=a+1;k<next && fits;k++) {
+					float t = (span>0)? (exact16[k]-float(times16[a]))/span : 0.0f;
+					t = std::max(0.0f, std::min(1.0f, t));
+					Interpolate(&decoded[a*4], &decoded[next*4], t, rotation, value);
+					fits = (Error(value, values + k*size, rotation) <= tolerance);
+				}
+				if(!fits)
+					break;
+				b = next;
+			}
+			kept.push_back(b);
+			a = b;
+		}
+	}
+
+	channel.times.resize(kept.size());
+	channel.values.resize(kept.size()*3);
+	for(size_t i=0;i<kept.size();i++) {
+		channel.times[i] = times16[kept[i]];
+		for(int c=0;c<3;c++)
+			channel.values[i*3+c] = encoded[kept[i]*3+c];
+	}
+}
+
+void CCompressedClip::Compress(const CAnimationClip& clip, const Tolerance& tolerance) {
+	Clear();
+	duration = clip.GetDuration();
+	this->tolerance = tolerance;
+	const float limits[TOTAL_CHANNELS] = {tolerance.position, tolerance.rotation, tolerance.scale};
+
+	std::vector<float> values;
+	for(int i=0;i<clip.GetTotalTracks();i++) {
+		const int totalKeys = clip.GetTotalKeys(i);
+		const BonePose* keys = clip.GetKeys(i);
+		Track track;
+		track.bone = clip.GetTrackBone(i);
+		for(int type=0;type<TOTAL_CHANNELS;type++) {
+			const int size = (type==ROTATION)? 4 : 3;
+			values.resize(totalKeys*size);
+			for(int k=0;k<totalKeys;k++) {
+				const float* src = (type==POSITION)? keys[k].position : (type==ROTATION)? keys[k].rotation : keys[k].scale;
+				std::copy(src, src+size, &values[k*size]);
+				if(type==ROTATION) {
+					float* q = &values[k*size];
+					float len = sqrtf(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+					len = (len>0)? 1.0f/len : 0.0f;
+					for(int c=0;c<4;c++)
+						q[c] *= len;
+				}
+			}
+			CompressChannel(clip.GetKeyTimes(i), &values[0], totalKeys, type, limits[type], duration, track.channels[type]);
+		}
+		tracks.push_back(track);
+	}
+}
+
+void CCompressedClip::Sample(const float time, int* cursors, BonePose* pose) const {
+	const float t16 = (duration>0)? time/duration*65535.0f : 0.0f;
+	float a[4], b[4];
+	for(size_t i=0;i<tracks.size();i++) {
+		const Track& track = tracks[i];
+		BonePose& result = pose[track.bone];
+		for(int type=0;type<TOTAL_CHANNELS;type++) {
+			const Channel& channel = track.channels[type];
+			float* dst = (type==POSITION)? result.position : (type==ROTATION)? result.rotation : result.scale;
+			const int last = int(channel.times.size())-1;
+			const bool rotation = (type==ROTATION);
+			if(last==0) {
+				DecodeKey(&channel.values[0], channel.minimum, channel.extent, rotation, dst);
+				continue;
+			}
+			//the cursor only moves forward, it restarts when the time wraps
+			int& key = cursors[i*TOTAL_CHANNELS+type];
+			if(key>last-1 || t16 < channel.times[key])
+				key = 0;
+			while(key<last-1 && channel.times[key+1] <= t16)
+				key++;
+
+			const float t0 = channel.times[key], t1 = channel.times[key+1];
+			float t = (t1>t0)? (t16-t0)/(t1-t0) : 0.0f;
+			t = std::max(0.0f, std::min(1.0f, t));
+			DecodeKey(&channel.values[key*3], channel.minimum, channel.extent, rotation, a);
+			DecodeKey(&channel.values[key*3+3], channel.minimum, channel.extent, rotation, b);
+			Interpolate(a, b, t, rotation, dst);
+		}
+	}
+}
+
+size_t CCompressedClip::GetSize() const {
+	size_t size = 0;
+	for(size_t i=0;i<tracks.size();i++) {
+		size += sizeof(int);
+		for(int type=0;type<TOTAL_CHANNELS;type++) {
+			const Channel& channel = tracks[i].channels[type];
+			size += 6*sizeof(float) + (channel.times.size() + channel.values.size())*sizeof(unsigned short);
+		}
+	}
+	return size;
+}
+
+bool CCompressedClip::Save(const std::string& filename, const std::string& sourceFilename) const {
+	long long stamp[2];
+	if(!GetSourceStamp(sourceFilename, stamp))
+		return false;
+	FILE* fp = fopen(filename.c_str(), "wb");
+	if(!fp)
+		return false;
+	int totalTracks = int(tracks.size());
+	const float limits[TOTAL_CHANNELS] = {tolerance.position, tolerance.rotation, tolerance.scale};
+	fwrite(MAGIC, 1, 4, fp);
+	fwrite(&VERSION, sizeof(int), 1, fp);
+	fwrite(stamp, sizeof(long long), 2, fp);
+	fwrite(limits, sizeof(float), TOTAL_CHANNELS, fp);
+	fwrite(&duration, sizeof(float), 1, fp);
+	fwrite(&totalTracks, sizeof(int), 1, fp);
+	for(int i=0;i<totalTracks;i++) {
+		const Track& track = tracks[i];
+		fwrite(&track.bone, sizeof(int), 1, fp);
+		for(int type=0;type<TOTAL_CHANNELS;type++) {
+			const Channel& channel = track.channels[type];
+			int totalKeys = int(channel.times.size());
+			fwrite(&totalKeys, sizeof(int), 1, fp);
+			fwrite(channel.minimum, sizeof(float), 3, fp);
+			fwrite(channel.extent, sizeof(float), 3, fp);
+			fwrite(&channel.times[0], sizeof(unsigned short), channel.times.size(), fp);
+			fwrite(&channel.values[0], sizeof(unsigned short), channel.values.size(), fp);
+		}
+	}
+	bool ok = (ferror(fp) == 0);
+	fclose(fp);
+	return ok;
+}
+
+bool CCompressedClip::Load(const std::string& filename, const std::string& sourceFilename, const Tolerance& expected, const int totalBones) {
+	Clear();
+	long long stamp[2];
+	if(!GetSourceStamp(sourceFilename, stamp))
+		return false;
+	FILE* fp = fopen(filename.c_str(), "rb");
+	if(!fp)
+		return false;
+
+	//the counts are checked against the file size before anything is
+	//allocated for them. A track takes at least its bone and the headers
+	//and one key of its channels, a key takes 4 shorts.
+	fseek(fp, 0, SEEK_END);
+	const long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	const long minTrackSize = long(sizeof(int) + TOTAL_CHANNELS*(sizeof(int) + 6*sizeof(float) + 4*sizeof(unsigned short)));
+
+	char magic[4];
+	int version = 0, totalTracks = 0;
+	long long savedStamp[2];
+	float limits[TOTAL_CHANNELS];
+	bool ok = (fread(magic, 1, 4, fp) == 4 && memcmp(magic, MAGIC, 4) == 0 &&
+			   fread(&version, sizeof(int), 1, fp) == 1 && version == VERSION &&
+			   fread(savedStamp, sizeof(long long), 2, fp) == 2 &&
+			   savedStamp[0] == stamp[0] && savedStamp[1] == stamp[1] &&
+			   fread(limits, sizeof(float), TOTAL_CHANNELS, fp) == TOTAL_CHANNELS &&
+			   limits[POSITION] == expected.position && limits[ROTATION] == expected.rotation && limits[SCALE] == expected.scale &&
+			   fread(&duration, sizeof(float), 1, fp) == 1 &&
+			   fread(&totalTracks, sizeof(int), 1, fp) == 1 && totalTracks >= 0 && totalTracks <= size/minTrackSize);
+	if(ok) {
+		tolerance = expected;
+		tracks.resize(totalTracks);
+	}
+	for(int i=0;i<totalTracks && ok;i++) {
+		Track& track = tracks[i];
+		ok = (fread(&track.bone, sizeof(int), 1, fp) == 1 && track.bone >= 0 && track.bone < totalBones);
+		for(int type=0;type<TOTAL_CHANNELS && ok;type++) {
+			Channel& channel = track.channels[type];
+			int totalKeys = 0;
+			ok = (fread(&totalKeys, sizeof(int), 1, fp) == 1 && totalKeys > 0 && totalKeys <= 65536 &&
+				  long(totalKeys)*4*long(sizeof(unsigned short)) <= size &&
+				  fread(channel.minimum, sizeof(float), 3, fp) == 3 &&
+				  fread(channel.extent, sizeof(float), 3, fp) == 3);
+			if(!ok)
+				break;
+			channel.times.resize(totalKeys);
+			channel.values.resize(totalKeys*3);
+			ok = (fread(&channel.times[0], sizeof(unsigned short), channel.times.size(), fp) == channel.times.size() &&
+				  fread(&channel.values[0], sizeof(unsigned short), channel.values.size(), fp) == channel.values.size());
+		}
+	}
+	fclose(fp);
+	if(!ok)
+		Clear();
+	return ok;
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "AnimationClip.h"
+
+//A clip compressed for memory and storage. Every track is split into
+//position, rotation and scale channels with their own keys. Keys that can be
+//rebuilt from their neighbours by interpolation within the error bounds are
+//removed and the remaining keys are quantized: rotations to their smallest
+//three components with 15 bits each, positions and scales to 16 bits in the
+//range of the channel and key times to 16 bits of the clip duration. Removed
+//keys are rebuilt within the error bounds from the decoded keys, so their
+//error includes the quantization. Kept keys differ from the source by their
+//quantization alone, half a step: 1/131070 of the channel range per component
+//for positions and scales, about 1e-4 radians for rotations. Bounds below
+//that are not met. Samples are decoded straight from the quantized keys, with
+//one cursor per channel.
+class CCompressedClip : public CAbstractClip
+{
+public:
+	//largest allowed difference between the original and the compressed clip
+	struct Tolerance {
+		float position;		//distance in model units
+		float rotation;		//angle in radians
+		float scale;
+
+		Tolerance() : position(0.001f), rotation(0.001f), scale(0.001f) {}
+	};
+
+	CCompressedClip(void);
+	~CCompressedClip(void);
+
+	void Clear();
+	void Compress(const CAnimationClip& clip, const Tolerance& tolerance);
+
+	//saves the clip with the tolerance it was compressed with and the size
+	//and modification time of the source file
+	bool Save(const std::string& filename, const std::string& sourceFilename) const;
+	//loads a clip for a skeleton of totalBones bones. Fails if the source
+	//file changed since the clip was saved, if it was compressed with another
+	//tolerance or if a track animates a bone outside the skeleton.
+	bool Load(const std::string& filename, const std::string& sourceFilename, const Tolerance& tolerance, const int totalBones);
+
+	float GetDuration() const { return duration; }
+	int GetTotalCursors() const { return int(tracks.size())*TOTAL_CHANNELS; }
+	void Sample(const float time, int* cursors, BonePose* pose) const;
+
+	int GetTotalTracks() const { return int(tracks.size()); }
+	//memory used by the keys in bytes
+	size_t GetSize() const;
+
+private:
+	enum ChannelType {POSITION, ROTATION, SCALE, TOTAL_CHANNELS};
+
+	struct Channel {
+		float minimum[3], extent[3];		//range of positions and scales
+		std::vector<unsigned short> times;	//fraction of the duration
+		std::vector<unsigned short> values;	//3 per key
+	};
+	struct Track {
+		int bone;
+		Channel channels[TOTAL_CHANNELS];
+	};
+
+	static void CompressChannel(const float* times, const float* values, const int totalKeys, const int type,
+								const float tolerance, const float duration, Channel& channel);
+
+	//size and modification time of a file
+	static bool GetSourceStamp(const std::string& filename, long long stamp[2]);
+
+	std::vector<Track> tracks;
+	float duration;
+	Tolerance tolerance;
+};
\ No newline at end of file
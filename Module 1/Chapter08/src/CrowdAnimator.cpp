@@ -0,0 +1,316 @@
+#include "CrowdAnimator.h"
+#include "Timer.h"
+#include <xmmintrin.h>
+#include <algorithm>
+#include <cmath>
+
+CCrowdAnimator::CCrowdAnimator(void)
+{
+	pool = 0;
+	type = MATRIX_PALETTE;
+	totalBones = 0;
+	cursorStride = 0;
+	loop = true;
+	totalInstances = 0;
+	totalGroups = 0;
+	local = global = palette = 0;
+	updateTime = 0;
+}
+
+CCrowdAnimator::~CCrowdAnimator(void)
+{
+	Destroy();
+}
+
+void CCrowdAnimator::Destroy() {
+	float* buffers[3] = {local, global, palette};
+	for(int i=0;i<3;i++) {
+		if(buffers[i])
+			_mm_free(buffers[i]);
+	}
+	local = global = palette = 0;
+	totalGroups = 0;
+	totalInstances = 0;
+	cursorStride = 0;
+	instances.clear();
+	cursors.clear();
+	scratch.clear();
+	clips.clear();
+}
+
+void CCrowdAnimator::Init(const std::vector<int>& parents, const std::vector<BonePose>& restPose,
+						  const std::vector<glm::mat4>& invBindPose, const PaletteType type, CThreadPool* pool) {
+	Destroy();
+	this->pool = pool;
+	this->type = type;
+	this->parents = parents;
+	this->restPose = restPose;
+	totalBones = int(parents.size());
+
+	//order the bones so that every parent is transformed before its children
+	order.clear();
+	std::vector<char> done(totalBones, 0);
+	std::vector<int> path;
+	for(int i=0;i<totalBones;i++) {
+		path.clear();
+		for(int b=i; b!=-1 && !done[b]; b=parents[b]) {
+			path.push_back(b);
+			done[b] = 1;
+		}
+		for(int k=int(path.size())-1;k>=0;k--)
+			order.push_back(path[k]);
+	}
+
+	invBind.resize(totalBones*12);
+	for(int b=0;b<totalBones;b++) {
+		for(int r=0;r<3;r++) {
+			for(int c=0;c<4;c++)
+				invBind[b*12+r*4+c] = invBindPose[b][c][r];
+		}
+	}
+}
+
+int CCrowdAnimator::AddClip(const CAbstractClip* clip) {
+	clips.push_back(clip);
+	//cursors are only a cache, so they can restart when they grow
+	if(clip->GetTotalCursors() > cursorStride) {
+		cursorStride = clip->GetTotalCursors();
+		cursors.assign(size_t(totalInstances)*2*cursorStride, 0);
+	}
+	return int(clips.size())-1;
+}
+
+void CCrowdAnimator::Allocate(const int groups) {
+	float* buffers[3] = {local, global, palette};
+	for(int i=0;i<3;i++) {
+		if(buffers[i])
+			_mm_free(buffers[i]);
+	}
+	totalGroups = groups;
+	size_t lanes = size_t(groups)*4*totalBones;
+	local = static_cast<float*>(_mm_malloc(lanes*LOCAL_SIZE*sizeof(float), 16));
+	global = static_cast<float*>(_mm_malloc(lanes*GLOBAL_SIZE*sizeof(float), 16));
+	//the palette has room for the padding lanes of the last group so the
+	//stores do not need a lane check
+	palette = static_cast<float*>(_mm_malloc(lanes*12*sizeof(float), 16));
+	scratch.resize(size_t(groups)*2*totalBones);
+}
+
+void CCrowdAnimator::SetTotalInstances(const int total) {
+	Instance instance;
+	instance.clip[0] = instance.clip[1] = 0;
+	instance.time = 0;
+	instance.speed = 1;
+	instance.weight = 0;
+	instances.resize(total, instance);
+	cursors.resize(size_t(total)*2*cursorStride, 0);
+	totalInstances = total;
+
+	int groups = (total+3)/4;
+	if(groups > totalGroups)
+		Allocate(groups);
+}
+
+void CCrowdAnimator::SetInstance(const int i, const int a, const int b, const float weight, const float time, const float speed) {
+	Instance& instance = instances[i];
+	instance.clip[0] = a;
+	instance.clip[1] = b;
+	instance.weight = weight;
+	instance.time = time;
+	instance.speed = speed;
+	std::fill(cursors.begin() + size_t(i)*2*cursorStride, cursors.begin() + size_t(i+1)*2*cursorStride, 0);
+}
+
+void CCrowdAnimator::SampleGroup(const int group) {
+	BonePose* a = &scratch[size_t(group)*2*totalBones];
+	BonePose* b = a + totalBones;
+	float* L = local + size_t(group)*totalBones*LOCAL_SIZE*4;
+	const int totalClips = int(clips.size());
+
+	for(int lane=0;lane<4;lane++) {
+		const int i = group*4+lane;
+		std::copy(restPose.begin(), restPose.end(), a);
+		if(i < totalInstances) {
+			const Instance& instance = instances[i];
+			int* cursor = cursors.empty()? 0 : &cursors[size_t(i)*2*cursorStride];
+			if(instance.clip[0] < totalClips) {
+				const CAbstractClip* clip = clips[instance.clip[0]];
+				clip->Sample(instance.time*clip->GetDuration(), cursor, a);
+			}
+			if(instance.weight > 0 && instance.clip[1] < totalClips) {
+				const CAbstractClip* clip = clips[instance.clip[1]];
+				std::copy(restPose.begin(), restPose.end(), b);
+				clip->Sample(instance.time*clip->GetDuration(), cursor + cursorStride, b);
+				for(int bone=0;bone<totalBones;bone++)
+					CAnimationClip::Blend(a[bone], b[bone], instance.weight, a[bone]);
+			}
+		}
+
+		//scatter the pose into the lane of the group
+		for(int bone=0;bone<totalBones;bone++) {
+			float* dst = L + bone*LOCAL_SIZE*4 + lane;
+			const BonePose& p = a[bone];
+			dst[0] = p.position[0];	dst[4] = p.position[1];	dst[8] = p.position[2];
+			dst[12] = p.rotation[0]; dst[16] = p.rotation[1]; dst[20] = p.rotation[2]; dst[24] = p.rotation[3];
+			dst[28] = p.scale[0]; dst[32] = p.scale[1]; dst[36] = p.scale[2];
+		}
+	}
+}
+
+//copies the sign of s to the magnitude of v
+static inline __m128 CopySign(const __m128 v, const __m128 s) {
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	return _mm_or_ps(_mm_andnot_ps(signMask, v), _mm_and_ps(signMask, s));
+}
+
+void CCrowdAnimator::TransformGroup(const int group) {
+	const float* L = local + size_t(group)*totalBones*LOCAL_SIZE*4;
+	float* G = global + size_t(group)*totalBones*GLOBAL_SIZE*4;
+	const int boneFloats = GetBoneFloats();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for(size_t o=0;o<order.size();o++) {
+		const int bone = order[o];
+		const float* l = L + bone*LOCAL_SIZE*4;
+		__m128 px = _mm_load_ps(l),    py = _mm_load_ps(l+4),  pz = _mm_load_ps(l+8);
+		__m128 qx = _mm_load_ps(l+12), qy = _mm_load_ps(l+16), qz = _mm_load_ps(l+20), qw = _mm_load_ps(l+24);
+		__m128 sx = _mm_load_ps(l+28), sy = _mm_load_ps(l+32), sz = _mm_load_ps(l+36);
+
+		//local transform T*R*S as 3x4 rows
+		__m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+		__m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+		__m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+		__m128 m[12];
+		m[0]  = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+		m[1]  = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+		m[2]  = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+		m[3]  = px;
+		m[4]  = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+		m[5]  = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+		m[6]  = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+		m[7]  = py;
+		m[8]  = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+		m[9]  = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+		m[10] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+		m[11] = pz;
+
+		//global transform, parent global times local
+		__m128 g[12];
+		const int parent = parents[bone];
+		if(parent==-1) {
+			for(int k=0;k<12;k++)
+				g[k] = m[k];
+		} else {
+			const float* P = G + parent*GLOBAL_SIZE*4;
+			for(int r=0;r<3;r++) {
+				__m128 p0 = _mm_load_ps(P+(r*4  )*4);
+				__m128 p1 = _mm_load_ps(P+(r*4+1)*4);
+				__m128 p2 = _mm_load_ps(P+(r*4+2)*4);
+				__m128 p3 = _mm_load_ps(P+(r*4+3)*4);
+				for(int c=0;c<4;c++) {
+					g[r*4+c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, m[c]), _mm_mul_ps(p1, m[4+c])), _mm_mul_ps(p2, m[8+c]));
+				}
+				g[r*4+3] = _mm_add_ps(g[r*4+3], p3);
+			}
+		}
+		float* dst = G + bone*GLOBAL_SIZE*4;
+		for(int k=0;k<12;k++)
+			_mm_store_ps(dst+k*4, g[k]);
+
+		//skinning transform, global times inverse bind pose
+		const float* ib = &invBind[bone*12];
+		__m128 s[12];
+		for(int r=0;r<3;r++) {
+			for(int c=0;c<4;c++) {
+				s[r*4+c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(g[r*4], _mm_set1_ps(ib[c])),
+												 _mm_mul_ps(g[r*4+1], _mm_set1_ps(ib[4+c]))),
+												 _mm_mul_ps(g[r*4+2], _mm_set1_ps(ib[8+c])));
+			}
+			s[r*4+3] = _mm_add_ps(s[r*4+3], g[r*4+3]);
+		}
+
+		float* out[4];
+		for(int lane=0;lane<4;lane++)
+			out[lane] = palette + (size_t(group*4+lane)*totalBones + bone)*boneFloats;
+
+		if(type==MATRIX_PALETTE) {
+			//transpose so every lane gets its rows
+			for(int r=0;r<3;r++) {
+				__m128 r0 = s[r*4], r1 = s[r*4+1], r2 = s[r*4+2], r3 = s[r*4+3];
+				_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+				_mm_store_ps(out[0]+r*4, r0);
+				_mm_store_ps(out[1]+r*4, r1);
+				_mm_store_ps(out[2]+r*4, r2);
+				_mm_store_ps(out[3]+r*4, r3);
+			}
+		} else {
+			//rotation to quaternion without branches, the magnitudes come from
+			//the diagonal and the signs from the off diagonal differences
+			__m128 d0 = s[0], d1 = s[5], d2 = s[10];
+			__m128 rw = _mm_mul_ps(half, _mm_sqrt_ps(_mm_max_ps(zero, _mm_add_ps(one, _mm_add_ps(d0, _mm_add_ps(d1, d2))))));
+			__m128 rx = _mm_mul_ps(half, _mm_sqrt_ps(_mm_max_ps(zero, _mm_add_ps(one, _mm_sub_ps(d0, _mm_add_ps(d1, d2))))));
+			__m128 ry = _mm_mul_ps(half, _mm_sqrt_ps(_mm_max_ps(zero, _mm_add_ps(one, _mm_sub_ps(d1, _mm_add_ps(d0, d2))))));
+			__m128 rz = _mm_mul_ps(half, _mm_sqrt_ps(_mm_max_ps(zero, _mm_add_ps(one, _mm_sub_ps(d2, _mm_add_ps(d0, d1))))));
+			rx = CopySign(rx, _mm_sub_ps(s[9], s[6]));
+			ry = CopySign(ry, _mm_sub_ps(s[2], s[8]));
+			rz = CopySign(rz, _mm_sub_ps(s[4], s[1]));
+			__m128 len = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)),
+									_mm_add_ps(_mm_mul_ps(rz, rz), _mm_mul_ps(rw, rw)));
+			__m128 inv = _mm_div_ps(one, _mm_sqrt_ps(len));
+			rx = _mm_mul_ps(rx, inv);
+			ry = _mm_mul_ps(ry, inv);
+			rz = _mm_mul_ps(rz, inv);
+			rw = _mm_mul_ps(rw, inv);
+
+			//dual part, half the translation times the rotation
+			__m128 tx = _mm_mul_ps(half, s[3]), ty = _mm_mul_ps(half, s[7]), tz = _mm_mul_ps(half, s[11]);
+			__m128 dw = _mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, rx), _mm_mul_ps(ty, ry)), _mm_mul_ps(tz, rz)));
+			__m128 dx = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(tx, rw), _mm_mul_ps(ty, rz)), _mm_mul_ps(tz, ry));
+			__m128 dy = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(ty, rw), _mm_mul_ps(tx, rz)), _mm_mul_ps(tz, rx));
+			__m128 dz = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(tx, ry), _mm_mul_ps(ty, rx)), _mm_mul_ps(tz, rw));
+
+			_MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+			_MM_TRANSPOSE4_PS(dx, dy, dz, dw);
+			_mm_store_ps(out[0], rx); _mm_store_ps(out[0]+4, dx);
+			_mm_store_ps(out[1], ry); _mm_store_ps(out[1]+4, dy);
+			_mm_store_ps(out[2], rz); _mm_store_ps(out[2]+4, dz);
+			_mm_store_ps(out[3], rw); _mm_store_ps(out[3]+4, dw);
+		}
+	}
+}
+
+void CCrowdAnimator::UpdateTask(int task, void* data) {
+	CCrowdAnimator* animator = static_cast<CCrowdAnimator*>(data);
+	const int groups = (animator->totalInstances+3)/4;
+	const int end = std::min((task+1)*GROUP_CHUNK, groups);
+	for(int g=task*GROUP_CHUNK; g<end; g++) {
+		animator->SampleGroup(g);
+		animator->TransformGroup(g);
+	}
+}
+
+void CCrowdAnimator::Update(const float dt) {
+	CTimer timer;
+
+	//advance the normalized time by the duration of the first clip
+	const int totalClips = int(clips.size());
+	for(int i=0;i<totalInstances;i++) {
+		Instance& instance = instances[i];
+		float duration = (instance.clip[0] < totalClips)? clips[instance.clip[0]]->GetDuration() : 0.0f;
+		if(duration <= 0)
+			continue;
+		instance.time += dt*instance.speed/duration;
+		if(loop)
+			instance.time -= floorf(instance.time);
+		else
+			instance.time = std::min(instance.time, 1.0f);
+	}
+
+	const int groups = (totalInstances+3)/4;
+	if(groups>0)
+		pool->Run((groups+GROUP_CHUNK-1)/GROUP_CHUNK, UpdateTask, this);
+	updateTime = timer.Elapsed();
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "AnimationClip.h"
+#include "ThreadPool.h"
+
+//Animates many instances of one skeleton. Every instance plays two clips
+//and blends them by a weight. Instances are processed in groups of four,
+//one per SSE lane: the clips are sampled per instance with cached cursors,
+//then the local transforms, the hierarchy and the skinning transforms of the
+//whole group are computed as a structure of arrays. Groups are split into
+//tasks of a thread pool. The skinning palettes of all instances are written
+//to one array, ready for a single texture buffer upload, either as 3x4
+//matrices (3 rows of 4 floats per bone) or as dual quaternions (ordinary
+//then dual part, x,y,z,w each).
+class CCrowdAnimator
+{
+public:
+	enum PaletteType {MATRIX_PALETTE, DUAL_QUATERNION_PALETTE};
+
+	CCrowdAnimator(void);
+	~CCrowdAnimator(void);
+
+	//parent index of every bone (-1 for roots), the local rest pose used by
+	//bones a clip does not animate and the inverse bind pose of every bone
+	void Init(const std::vector<int>& parents, const std::vector<BonePose>& restPose,
+			  const std::vector<glm::mat4>& invBindPose, const PaletteType type, CThreadPool* pool);
+	void Destroy();
+
+	//the clips must outlive the animator
+	int AddClip(const CAbstractClip* clip);
+	int GetTotalClips() const { return int(clips.size()); }
+
+	void SetTotalInstances(const int total);
+	int GetTotalInstances() const { return totalInstances; }
+
+	//the instance plays clip a at time, clip b at the same normalized time,
+	//and shows them blended by weight (0 is clip a only)
+	void SetInstance(const int i, const int a, const int b, const float weight, const float time, const float speed);
+	void SetLoop(const bool loop) { this->loop = loop; }
+
+	//advances every instance by dt seconds and updates the palettes
+	void Update(const float dt);
+
+	PaletteType GetPaletteType() const { return type; }
+	//floats per bone in the palette
+	int GetBoneFloats() const { return (type==MATRIX_PALETTE)? 12 : 8; }
+	int GetTotalBones() const { return totalBones; }
+	const float* GetPalette() const { return palette; }
+	//size of the palettes of all instances in bytes
+	size_t GetPaletteSize() const { return size_t(totalInstances)*totalBones*GetBoneFloats()*sizeof(float); }
+	//CPU time of the last update in milliseconds
+	float GetUpdateTime() const { return updateTime; }
+
+private:
+	//instance groups of four per thread pool task
+	static const int GROUP_CHUNK = 4;
+	//SoA floats per bone: local position, rotation, scale, then the 3x4
+	//global transform
+	static const int LOCAL_SIZE = 10;
+	static const int GLOBAL_SIZE = 12;
+
+	struct Instance {
+		int clip[2];
+		float time;		//normalized playback time in [0,1]
+		float speed;
+		float weight;
+	};
+
+	void Allocate(const int groups);
+	void SampleGroup(const int group);
+	void TransformGroup(const int group);
+	static void UpdateTask(int task, void* data);
+
+	CThreadPool* pool;
+	PaletteType type;
+	int totalBones;
+	std::vector<int> parents;
+	std::vector<int> order;		//bones ordered so parents come first
+	std::vector<BonePose> restPose;
+	std::vector<float> invBind;	//3x4 inverse bind pose of every bone
+	std::vector<const CAbstractClip*> clips;
+	bool loop;
+
+	int totalInstances;
+	int totalGroups;			//allocated groups of four instances
+	std::vector<Instance> instances;
+	std::vector<int> cursors;	//two cursor sets per instance
+	int cursorStride;			//cursors of the largest clip
+	std::vector<BonePose> scratch;	//two sampled poses per group
+	float* local;				//LOCAL_SIZE*4 floats per bone per group
+	float* global;				//GLOBAL_SIZE*4 floats per bone per group
+	float* palette;
+	float updateTime;
+};
\ No newline at end of file
@@ -0,0 +1,772 @@
+#include "EzmReader.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cfloat>
+#include <cstddef>
+#include <algorithm>
+#include <map>
+#include <sys/stat.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+const char MAGIC[4] = {'E','Z','M','B'};
+const int VERSION = 1;
+
+//the source file is read in blocks of this size
+const size_t BLOCK_SIZE = 1<<20;
+//at least this many characters are buffered before a number is parsed so
+//numbers never straddle the end of the buffer
+const size_t MAX_TOKEN = 64;
+//alignment of the bulk arrays in the cache
+const size_t CACHE_ALIGNMENT = 16;
+
+namespace {
+
+typedef std::vector<std::pair<std::string, std::string> > Attributes;
+
+//powers of ten that are exact in a double
+const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+						1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+inline bool IsDigit(const char c) {
+	return c>='0' && c<='9';
+}
+
+inline bool IsSpace(const char c) {
+	return c==' ' || c=='\t' || c=='\n' || c=='\r';
+}
+
+//parses a decimal number from a null terminated string and returns the
+//character after it, or s when there is no number. Up to 19 significant
+//digits are gathered in an integer and scaled by one exact power of ten,
+//which is as precise as strtod for the floats stored in EZMesh files.
+const char* ParseNumber(const char* s, double& value) {
+	const char* p = s;
+	bool negative = false;
+	if(*p=='-' || *p=='+')
+		negative = (*p++=='-');
+
+	unsigned long long mantissa = 0;
+	int digits = 0, exponent = 0;
+	const char* first = p;
+	for(;IsDigit(*p);p++) {
+		if(digits<19) {
+			mantissa = mantissa*10 + (*p-'0');
+			digits += (mantissa!=0);
+		} else {
+			exponent++;
+		}
+	}
+	if(*p=='.') {
+		p++;
+		for(;IsDigit(*p);p++) {
+			if(digits<19) {
+				mantissa = mantissa*10 + (*p-'0');
+				digits += (mantissa!=0);
+				exponent--;
+			}
+		}
+	}
+	if(p==first || (p==first+1 && *first=='.'))
+		return s;
+
+	if(*p=='e' || *p=='E') {
+		const char* e = p+1;
+		bool negativeExponent = false;
+		if(*e=='-' || *e=='+')
+			negativeExponent = (*e++=='-');
+		if(IsDigit(*e)) {
+			int x = 0;
+			for(;IsDigit(*e);e++)
+				x = (x<10000)? x*10 + (*e-'0') : x;
+			exponent += negativeExponent? -x : x;
+			p = e;
+		}
+	}
+
+	if(exponent>=-22 && exponent<=22) {
+		value = double(mantissa);
+		value = (exponent<0)? value/POW10[-exponent] : value*POW10[exponent];
+		value = negative? -value : value;
+	} else {
+		//rare, leave it to the library
+		value = strtod(s, 0);
+	}
+	return p;
+}
+
+//buffered reader of the XML text
+class Stream
+{
+public:
+	Stream(FILE* fp) : fp(fp), buffer(BLOCK_SIZE+1), pos(0), end(0) {
+		buffer[0] = 0;
+	}
+
+	//buffers at least MAX_TOKEN characters unless the file ends, returns
+	//false when nothing is left
+	bool Fill() {
+		if(end-pos>=MAX_TOKEN)
+			return true;
+		const size_t left = end-pos;
+		memmove(&buffer[0], &buffer[pos], left);
+		pos = 0;
+		end = left + fread(&buffer[left], 1, BLOCK_SIZE-left, fp);
+		buffer[end] = 0;
+		return end>pos;
+	}
+
+	int Peek() {
+		return (pos<end || Fill())? (unsigned char)buffer[pos] : -1;
+	}
+
+	int Get() {
+		const int c = Peek();
+		if(c>=0)
+			pos++;
+		return c;
+	}
+
+	bool SkipTo(const char c) {
+		while(pos<end || Fill()) {
+			const char* p = (const char*)memchr(&buffer[pos], c, end-pos);
+			if(p) {
+				pos = p-&buffer[0];
+				return true;
+			}
+			pos = end;
+		}
+		return false;
+	}
+
+	//reads the next number of an array, the numbers are separated by white
+	//space and commas. Returns false at the end of the element.
+	bool ReadNumber(double& value) {
+		while(Fill() && (IsSpace(buffer[pos]) || buffer[pos]==','))
+			pos++;
+		if(pos==end || buffer[pos]=='<')
+			return false;
+		const char* s = &buffer[pos];
+		const char* e = ParseNumber(s, value);
+		if(e==s) {
+			//not a number, take it as zero
+			value = 0;
+			while(*e && !IsSpace(*e) && *e!=',' && *e!='<')
+				e++;
+		}
+		pos += e-s;
+		return true;
+	}
+
+	//reads the next tag. Declarations and comments are skipped.
+	bool ReadTag(std::string& name, Attributes& attributes, bool& closing) {
+		name.clear();
+		attributes.clear();
+		int c;
+		do {
+			if(!SkipTo('<'))
+				return false;
+			pos++;
+			c = Peek();
+			if(c=='?' || c=='!')
+				SkipTo('>');
+		} while(c=='?' || c=='!');
+
+		closing = (c=='/');
+		if(closing)
+			pos++;
+		while((c=Peek())>=0 && !IsSpace(char(c)) && c!='/' && c!='>') {
+			name += char(c);
+			pos++;
+		}
+		while((c=Get())>=0 && c!='>') {
+			if(IsSpace(char(c)) || c=='/')
+				continue;
+			std::string key(1, char(c));
+			while((c=Get())>=0 && c!='=' && !IsSpace(char(c)))
+				key += char(c);
+			if(c!='=') {
+				if(!SkipTo('='))
+					return false;
+				pos++;
+			}
+			while((c=Get())>=0 && c!='"' && c!='\'');
+			const char quote = char(c);
+			std::string value;
+			while((c=Get())>=0 && c!=quote)
+				value += char(c);
+			attributes.push_back(std::make_pair(key, value));
+		}
+		return c=='>';
+	}
+
+private:
+	FILE* fp;
+	std::vector<char> buffer;
+	size_t pos, end;
+};
+
+const std::string& GetAttribute(const Attributes& attributes, const char* key) {
+	static const std::string none;
+	for(size_t i=0;i<attributes.size();i++)
+		if(attributes[i].first==key)
+			return attributes[i].second;
+	return none;
+}
+
+int GetInt(const Attributes& attributes, const char* key) {
+	return atoi(GetAttribute(attributes, key).c_str());
+}
+
+float GetFloat(const Attributes& attributes, const char* key) {
+	double value = 0;
+	ParseNumber(GetAttribute(attributes, key).c_str(), value);
+	return float(value);
+}
+
+//reads up to total numbers separated by spaces or commas
+void GetFloats(const Attributes& attributes, const char* key, float* values, const int total) {
+	const char* s = GetAttribute(attributes, key).c_str();
+	for(int i=0;i<total;i++) {
+		while(IsSpace(*s) || *s==',')
+			s++;
+		double value = 0;
+		const char* e = ParseNumber(s, value);
+		if(e==s)
+			return;
+		values[i] = float(value);
+		s = e;
+	}
+}
+
+std::vector<std::string> Split(const std::string& text) {
+	std::vector<std::string> tokens;
+	size_t start = text.find_first_not_of(" \t");
+	while(start!=std::string::npos) {
+		size_t stop = text.find_first_of(" \t", start);
+		tokens.push_back(text.substr(start, stop-start));
+		start = text.find_first_not_of(" \t", stop);
+	}
+	return tokens;
+}
+
+void WriteString(FILE* fp, const std::string& s) {
+	const int length = int(s.size());
+	fwrite(&length, sizeof(int), 1, fp);
+	fwrite(s.c_str(), 1, length, fp);
+}
+
+void WritePadding(FILE* fp) {
+	const char zeros[CACHE_ALIGNMENT] = {0};
+	const long offset = ftell(fp);
+	fwrite(zeros, 1, (CACHE_ALIGNMENT - offset%CACHE_ALIGNMENT)%CACHE_ALIGNMENT, fp);
+}
+
+//bounds checked reads from the mapped cache
+struct Cursor {
+	const char* start;
+	const char* p;
+	const char* end;
+
+	bool Read(void* data, const size_t size) {
+		if(size_t(end-p)<size)
+			return false;
+		memcpy(data, p, size);
+		p += size;
+		return true;
+	}
+
+	bool ReadString(std::string& s) {
+		int length = 0;
+		if(!Read(&length, sizeof(int)) || length<0 || end-p<length)
+			return false;
+		s.assign(p, length);
+		p += length;
+		return true;
+	}
+
+	const char* Array(const size_t size) {
+		p += (CACHE_ALIGNMENT - (p-start)%CACHE_ALIGNMENT)%CACHE_ALIGNMENT;
+		if(p>end || size_t(end-p)<size)
+			return 0;
+		const char* array = p;
+		p += size;
+		return array;
+	}
+};
+
+}
+
+CEzmReader::CEzmReader(void)
+{
+	mapping = 0;
+	mappedSize = 0;
+#ifdef _WIN32
+	fileHandle = 0;
+	mappingHandle = 0;
+#endif
+	Clear();
+}
+
+CEzmReader::~CEzmReader(void)
+{
+	Clear();
+}
+
+void CEzmReader::Clear() {
+	Unmap();
+	bones.clear();
+	animations.clear();
+	tracks.clear();
+	materials.clear();
+	submeshes.clear();
+	vertices.clear();
+	indices.clear();
+	poses.clear();
+	vertexData = 0;
+	indexData = 0;
+	poseData = 0;
+	totalVertices = totalIndices = totalPoses = 0;
+	for(int i=0;i<6;i++)
+		bounds[i] = 0;
+}
+
+bool CEzmReader::Load(const std::string& filename) {
+	if(LoadCache(filename))
+		return true;
+	if(!Import(filename))
+		return false;
+	//a missing cache only costs the next load its speed
+	SaveCache(filename);
+	return true;
+}
+
+bool CEzmReader::Import(const std::string& filename) {
+	Clear();
+	FILE* fp = fopen(filename.c_str(), "rb");
+	if(!fp)
+		return false;
+
+	Stream stream(fp);
+	std::string tag;
+	Attributes attributes;
+	bool closing = false;
+	bool readBones = false, ok = true;
+	int totalSkeletons = 0;
+	unsigned int baseVertex = 0;
+	std::vector<std::string> parentNames;
+	for(int i=0;i<3;i++) {
+		bounds[i] = FLT_MAX;
+		bounds[i+3] = -FLT_MAX;
+	}
+
+	while(ok && stream.ReadTag(tag, attributes, closing)) {
+		if(closing) {
+			if(tag=="Skeleton")
+				readBones = false;
+			continue;
+		}
+
+		if(tag=="Skeleton") {
+			readBones = (totalSkeletons++==0);
+			if(readBones)
+				bones.reserve(GetInt(attributes, "count"));
+		} else if(tag=="Bone" && readBones) {
+			Bone b;
+			b.name = GetAttribute(attributes, "name");
+			b.parent = -1;
+			Pose& pose = b.pose;
+			for(int i=0;i<3;i++) {
+				pose.position[i] = 0;
+				pose.rotation[i] = 0;
+				pose.scale[i] = 1;
+			}
+			pose.rotation[3] = 1;
+			GetFloats(attributes, "position", pose.position, 3);
+			GetFloats(attributes, "orientation", pose.rotation, 4);
+			GetFloats(attributes, "scale", pose.scale, 3);
+			bones.push_back(b);
+			parentNames.push_back(GetAttribute(attributes, "parent"));
+		} else if(tag=="Animation") {
+			Animation a;
+			a.name = GetAttribute(attributes, "name");
+			a.firstTrack = int(tracks.size());
+			a.totalTracks = 0;
+			a.totalFrames = GetInt(attributes, "framecount");
+			a.duration = GetFloat(attributes, "duration");
+			a.dtime = GetFloat(attributes, "dtime");
+			animations.push_back(a);
+			tracks.reserve(tracks.size() + GetInt(attributes, "trackcount"));
+		} else if(tag=="AnimTrack" && !animations.empty()) {
+			Track t;
+			t.name = GetAttribute(attributes, "name");
+			t.firstPose = int(poses.size());
+			t.totalPoses = std::max(GetInt(attributes, "count"), 0);
+			const bool hasScale = (GetAttribute(attributes, "has_scale")!="false");
+			const Pose identity = {{0,0,0}, {0,0,0,1}, {1,1,1}};
+			poses.resize(t.firstPose + t.totalPoses, identity);
+			for(int i=0;i<t.totalPoses && ok;i++) {
+				float* values = poses[t.firstPose+i].position;
+				const int totalValues = hasScale? 10 : 7;
+				for(int k=0;k<totalValues && ok;k++) {
+					double value;
+					ok = stream.ReadNumber(value);
+					values[k] = float(value);
+				}
+			}
+			tracks.push_back(t);
+			animations.back().totalTracks++;
+		} else if(tag=="Material") {
+			Material m;
+			m.name = GetAttribute(attributes, "name");
+			m.metaData = GetAttribute(attributes, "meta_data");
+			materials.push_back(m);
+		} else if(tag=="Mesh") {
+			baseVertex = (unsigned int)vertices.size();
+		} else if(tag=="vertexbuffer") {
+			//where every component of the vertex format goes, in floats
+			//from the start of the vertex (-1 skips it)
+			std::vector<std::string> types = Split(GetAttribute(attributes, "ctype"));
+			std::vector<std::string> semantics = Split(GetAttribute(attributes, "semantic"));
+			std::vector<int> offsets;
+			for(size_t i=0;i<types.size();i++) {
+				const std::string semantic = (i<semantics.size())? semantics[i] : "";
+				int offset = -1, size = 0;
+				if(semantic=="position") {
+					offset = offsetof(Vertex, position);
+					size = 3;
+				} else if(semantic=="normal") {
+					offset = offsetof(Vertex, normal);
+					size = 3;
+				} else if(semantic=="texcoord1") {
+					offset = offsetof(Vertex, uv);
+					size = 2;
+				} else if(semantic=="blendweights") {
+					offset = offsetof(Vertex, blendWeights);
+					size = 4;
+				} else if(semantic=="blendindices") {
+					offset = offsetof(Vertex, blendIndices);
+					size = 4;
+				}
+				for(int k=0;k<int(types[i].size());k++)
+					offsets.push_back((k<size)? offset/int(sizeof(float)) + k : -1);
+			}
+			const int blendIndices = offsetof(Vertex, blendIndices)/sizeof(float);
+
+			const int first = int(vertices.size());
+			const int count = std::max(GetInt(attributes, "count"), 0);
+			vertices.resize(first+count, Vertex());
+			for(int i=0;i<count && ok;i++) {
+				Vertex& v = vertices[first+i];
+				float* floats = reinterpret_cast<float*>(&v);
+				int* ints = reinterpret_cast<int*>(&v);
+				for(size_t k=0;k<offsets.size() && ok;k++) {
+					double value;
+					ok = stream.ReadNumber(value);
+					const int offset = offsets[k];
+					if(offset>=blendIndices)
+						ints[offset] = int(value);
+					else if(offset>=0)
+						floats[offset] = float(value);
+				}
+				for(int k=0;k<3;k++) {
+					bounds[k] = std::min(bounds[k], v.position[k]);
+					bounds[k+3] = std::max(bounds[k+3], v.position[k]);
+				}
+			}
+		} else if(tag=="MeshSection") {
+			SubMesh s;
+			s.material = GetAttribute(attributes, "material");
+			s.firstIndex = int(indices.size());
+			s.totalIndices = 0;
+			submeshes.push_back(s);
+		} else if(tag=="indexbuffer" && !submeshes.empty()) {
+			SubMesh& s = submeshes.back();
+			const int count = std::max(GetInt(attributes, "triangle_count"), 0)*3;
+			if(count==0)
+				continue;
+			indices.resize(s.firstIndex + s.totalIndices + count);
+			unsigned int* dst = &indices[s.firstIndex + s.totalIndices];
+			for(int i=0;i<count && ok;i++) {
+				double value;
+				ok = stream.ReadNumber(value);
+				dst[i] = (unsigned int)(value) + baseVertex;
+			}
+			s.totalIndices += count;
+		}
+	}
+	fclose(fp);
+
+	if(!ok) {
+		Clear();
+		return false;
+	}
+
+	std::map<std::string, int> boneIndices;
+	for(size_t i=0;i<bones.size();i++)
+		boneIndices[bones[i].name] = int(i);
+	for(size_t i=0;i<bones.size();i++) {
+		std::map<std::string, int>::const_iterator parent = boneIndices.find(parentNames[i]);
+		bones[i].parent = (parent==boneIndices.end())? -1 : parent->second;
+	}
+
+	if(vertices.empty()) {
+		for(int i=0;i<6;i++)
+			bounds[i] = 0;
+	}
+	totalVertices = int(vertices.size());
+	totalIndices = int(indices.size());
+	totalPoses = int(poses.size());
+	vertexData = vertices.empty()? 0 : &vertices[0];
+	indexData = indices.empty()? 0 : &indices[0];
+	poseData = poses.empty()? 0 : &poses[0];
+	if(!IsValid()) {
+		Clear();
+		return false;
+	}
+	return true;
+}
+
+//true if [first, first+count) lies in [0, total)
+static bool InRange(const int first, const int count, const int total) {
+	return first>=0 && count>=0 && first<=total && count<=total-first;
+}
+
+bool CEzmReader::IsValid() const {
+	const int totalBones = int(bones.size());
+	for(int i=0;i<totalBones;i++) {
+		if(bones[i].parent<-1 || bones[i].parent>=totalBones)
+			return false;
+	}
+	for(size_t i=0;i<animations.size();i++) {
+		if(!InRange(animations[i].firstTrack, animations[i].totalTracks, int(tracks.size())))
+			return false;
+	}
+	for(size_t i=0;i<tracks.size();i++) {
+		if(!InRange(tracks[i].firstPose, tracks[i].totalPoses, totalPoses))
+			return false;
+	}
+	for(size_t i=0;i<submeshes.size();i++) {
+		if(!InRange(submeshes[i].firstIndex, submeshes[i].totalIndices, totalIndices))
+			return false;
+	}
+	for(int i=0;i<totalIndices;i++) {
+		if(indexData[i]>=(unsigned int)totalVertices)
+			return false;
+	}
+	return true;
+}
+
+bool CEzmReader::GetSourceStamp(const std::string& filename, long long stamp[2]) {
+	struct stat info;
+	if(stat(filename.c_str(), &info)!=0)
+		return false;
+	stamp[0] = (long long)info.st_size;
+	stamp[1] = (long long)info.st_mtime;
+	return true;
+}
+
+bool CEzmReader::SaveCache(const std::string& filename) const {
+	long long stamp[2];
+	if(!GetSourceStamp(filename, stamp))
+		return false;
+	FILE* fp = fopen((filename + ".ezb").c_str(), "wb");
+	if(!fp)
+		return false;
+
+	const int counts[8] = {int(bones.size()), int(animations.size()), int(tracks.size()), int(materials.size()),
+						   int(submeshes.size()), totalVertices, totalIndices, totalPoses};
+	fwrite(MAGIC, 1, 4, fp);
+	fwrite(&VERSION, sizeof(int), 1, fp);
+	fwrite(stamp, sizeof(long long), 2, fp);
+	fwrite(counts, sizeof(int), 8, fp);
+	fwrite(bounds, sizeof(float), 6, fp);
+
+	for(size_t i=0;i<bones.size();i++) {
+		WriteString(fp, bones[i].name);
+		fwrite(&bones[i].parent, sizeof(int), 1, fp);
+		fwrite(&bones[i].pose, sizeof(Pose), 1, fp);
+	}
+	for(size_t i=0;i<animations.size();i++) {
+		const Animation& a = animations[i];
+		WriteString(fp, a.name);
+		fwrite(&a.firstTrack, sizeof(int), 1, fp);
+		fwrite(&a.totalTracks, sizeof(int), 1, fp);
+		fwrite(&a.totalFrames, sizeof(int), 1, fp);
+		fwrite(&a.duration, sizeof(float), 1, fp);
+		fwrite(&a.dtime, sizeof(float), 1, fp);
+	}
+	for(size_t i=0;i<tracks.size();i++) {
+		WriteString(fp, tracks[i].name);
+		fwrite(&tracks[i].firstPose, sizeof(int), 1, fp);
+		fwrite(&tracks[i].totalPoses, sizeof(int), 1, fp);
+	}
+	for(size_t i=0;i<materials.size();i++) {
+		WriteString(fp, materials[i].name);
+		WriteString(fp, materials[i].metaData);
+	}
+	for(size_t i=0;i<submeshes.size();i++) {
+		WriteString(fp, submeshes[i].material);
+		fwrite(&submeshes[i].firstIndex, sizeof(int), 1, fp);
+		fwrite(&submeshes[i].totalIndices, sizeof(int), 1, fp);
+	}
+
+	WritePadding(fp);
+	fwrite(vertexData, sizeof(Vertex), totalVertices, fp);
+	WritePadding(fp);
+	fwrite(indexData, sizeof(unsigned int), totalIndices, fp);
+	WritePadding(fp);
+	fwrite(poseData, sizeof(Pose), totalPoses, fp);
+
+	const bool ok = (ferror(fp)==0);
+	fclose(fp);
+	return ok;
+}
+
+bool CEzmReader::LoadCache(const std::string& filename) {
+	Clear();
+	long long stamp[2];
+	if(!GetSourceStamp(filename, stamp) || !Map(filename + ".ezb"))
+		return false;
+
+	Cursor cursor = {mapping, mapping, mapping+mappedSize};
+	char magic[4];
+	int version = 0;
+	long long cacheStamp[2];
+	int counts[8];
+	bool ok = cursor.Read(magic, 4) && memcmp(magic, MAGIC, 4)==0 &&
+			  cursor.Read(&version, sizeof(int)) && version==VERSION &&
+			  cursor.Read(cacheStamp, sizeof(cacheStamp)) &&
+			  cacheStamp[0]==stamp[0] && cacheStamp[1]==stamp[1] &&
+			  cursor.Read(counts, sizeof(counts)) &&
+			  cursor.Read(bounds, sizeof(bounds));
+	for(int i=0;i<8 && ok;i++)
+		ok = (counts[i]>=0);
+
+	//every record takes at least the size of its fixed fields, so the counts
+	//are checked against the rest of the file before anything is allocated
+	if(ok) {
+		const size_t recordSizes[8] = {
+			2*sizeof(int) + sizeof(Pose),		//bone: name length, parent and pose
+			4*sizeof(int) + 2*sizeof(float),	//animation
+			3*sizeof(int),						//track
+			2*sizeof(int),						//material: two string lengths
+			3*sizeof(int),						//submesh
+			sizeof(Vertex), sizeof(unsigned int), sizeof(Pose)};
+		long long required = 0;
+		for(int i=0;i<8;i++)
+			required += (long long)recordSizes[i]*counts[i];
+		ok = (required <= (long long)(cursor.end-cursor.p));
+	}
+
+	if(ok) {
+		bones.resize(counts[0]);
+		animations.resize(counts[1]);
+		tracks.resize(counts[2]);
+		materials.resize(counts[3]);
+		submeshes.resize(counts[4]);
+	}
+	for(size_t i=0;i<bones.size() && ok;i++) {
+		ok = cursor.ReadString(bones[i].name) &&
+			 cursor.Read(&bones[i].parent, sizeof(int)) &&
+			 cursor.Read(&bones[i].pose, sizeof(Pose));
+	}
+	for(size_t i=0;i<animations.size() && ok;i++) {
+		Animation& a = animations[i];
+		ok = cursor.ReadString(a.name) &&
+			 cursor.Read(&a.firstTrack, sizeof(int)) &&
+			 cursor.Read(&a.totalTracks, sizeof(int)) &&
+			 cursor.Read(&a.totalFrames, sizeof(int)) &&
+			 cursor.Read(&a.duration, sizeof(float)) &&
+			 cursor.Read(&a.dtime, sizeof(float));
+	}
+	for(size_t i=0;i<tracks.size() && ok;i++) {
+		ok = cursor.ReadString(tracks[i].name) &&
+			 cursor.Read(&tracks[i].firstPose, sizeof(int)) &&
+			 cursor.Read(&tracks[i].totalPoses, sizeof(int));
+	}
+	for(size_t i=0;i<materials.size() && ok;i++)
+		ok = cursor.ReadString(materials[i].name) && cursor.ReadString(materials[i].metaData);
+	for(size_t i=0;i<submeshes.size() && ok;i++) {
+		ok = cursor.ReadString(submeshes[i].material) &&
+			 cursor.Read(&submeshes[i].firstIndex, sizeof(int)) &&
+			 cursor.Read(&submeshes[i].totalIndices, sizeof(int));
+	}
+
+	if(ok) {
+		totalVertices = counts[5];
+		totalIndices = counts[6];
+		totalPoses = counts[7];
+		vertexData = reinterpret_cast<const Vertex*>(cursor.Array(sizeof(Vertex)*totalVertices));
+		indexData = reinterpret_cast<const unsigned int*>(cursor.Array(sizeof(unsigned int)*totalIndices));
+		poseData = reinterpret_cast<const Pose*>(cursor.Array(sizeof(Pose)*totalPoses));
+		ok = vertexData && indexData && poseData && IsValid();
+	}
+	if(!ok)
+		Clear();
+	return ok;
+}
+
+bool CEzmReader::Map(const std::string& filename) {
+	Unmap();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+							  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if(file==INVALID_HANDLE_VALUE)
+		return false;
+	fileHandle = file;
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(file, &size) || size.QuadPart==0) {
+		Unmap();
+		return false;
+	}
+	mappingHandle = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	if(mappingHandle)
+		mapping = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	mappedSize = size_t(size.QuadPart);
+#else
+	int file = open(filename.c_str(), O_RDONLY);
+	if(file<0)
+		return false;
+	struct stat info;
+	if(fstat(file, &info)==0 && info.st_size>0) {
+		void* view = mmap(0, size_t(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		if(view!=MAP_FAILED) {
+			mapping = (const char*)view;
+			mappedSize = size_t(info.st_size);
+		}
+	}
+	close(file);
+#endif
+	if(!mapping) {
+		Unmap();
+		return false;
+	}
+	return true;
+}
+
+void CEzmReader::Unmap() {
+#ifdef _WIN32
+	if(mapping)
+		UnmapViewOfFile(mapping);
+	if(mappingHandle)
+		CloseHandle(mappingHandle);
+	if(fileHandle)
+		CloseHandle(fileHandle);
+	fileHandle = 0;
+	mappingHandle = 0;
+#else
+	if(mapping)
+		munmap((void*)mapping, mappedSize);
+#endif
+	mapping = 0;
+	mappedSize = 0;
+}
\ No newline at end of file
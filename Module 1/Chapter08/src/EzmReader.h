@@ -0,0 +1,116 @@
+#pragma once
+#include <string>
+#include <vector>
+
+//Streaming reader for EZMesh (.ezm) files. The XML text is read in blocks
+//and parsed in a single pass without building a document tree: the count
+//attributes size the vertex, index and pose arrays up front and the numbers
+//are parsed straight into them. After the first import the result is saved
+//to a binary cache next to the source file (<file>.ezb); later loads map the
+//cache into memory and use its arrays in place. The cache is rebuilt when
+//the size or modification time of the source file changes.
+class CEzmReader
+{
+public:
+	struct Vertex {
+		float position[3];
+		float normal[3];
+		float uv[2];
+		float blendWeights[4];
+		int blendIndices[4];
+	};
+	//same layout as NVSHARE::MeshAnimPose
+	struct Pose {
+		float position[3];
+		float rotation[4];	//x,y,z,w
+		float scale[3];
+	};
+	struct Bone {
+		std::string name;
+		int parent;			//-1 for roots
+		Pose pose;
+	};
+	struct Track {
+		std::string name;
+		int firstPose, totalPoses;
+	};
+	struct Animation {
+		std::string name;
+		int firstTrack, totalTracks;
+		int totalFrames;
+		float duration, dtime;
+	};
+	struct Material {
+		std::string name, metaData;
+	};
+	//indices are already offset to the vertices of their mesh
+	struct SubMesh {
+		std::string material;
+		int firstIndex, totalIndices;
+	};
+
+	CEzmReader(void);
+	~CEzmReader(void);
+
+	void Clear();
+
+	//loads from the cache when it is up to date, otherwise imports the
+	//source file and writes the cache
+	bool Load(const std::string& filename);
+	bool Import(const std::string& filename);
+	bool SaveCache(const std::string& filename) const;
+	bool LoadCache(const std::string& filename);
+
+	//only the first skeleton of the file is read
+	const std::vector<Bone>& GetBones() const { return bones; }
+	const std::vector<Animation>& GetAnimations() const { return animations; }
+	const std::vector<Track>& GetTracks() const { return tracks; }
+	const std::vector<Material>& GetMaterials() const { return materials; }
+	const std::vector<SubMesh>& GetSubMeshes() const { return submeshes; }
+
+	int GetTotalVertices() const { return totalVertices; }
+	const Vertex* GetVertices() const { return vertexData; }
+	int GetTotalIndices() const { return totalIndices; }
+	const unsigned int* GetIndices() const { return indexData; }
+	int GetTotalPoses() const { return totalPoses; }
+	const Pose* GetPoses() const { return poseData; }
+
+	//bounding box of all vertex positions
+	const float* GetMin() const { return bounds; }
+	const float* GetMax() const { return bounds+3; }
+
+private:
+	CEzmReader(const CEzmReader&);
+	CEzmReader& operator=(const CEzmReader&);
+
+	static bool GetSourceStamp(const std::string& filename, long long stamp[2]);
+	//checks that the bone parents, the track, animation and submesh ranges
+	//and every index refer to existing elements
+	bool IsValid() const;
+	bool Map(const std::string& filename);
+	void Unmap();
+
+	std::vector<Bone> bones;
+	std::vector<Animation> animations;
+	std::vector<Track> tracks;
+	std::vector<Material> materials;
+	std::vector<SubMesh> submeshes;
+
+	//the bulk arrays are owned after an import and point into the mapped
+	//cache after a cache load
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<Pose> poses;
+	const Vertex* vertexData;
+	const unsigned int* indexData;
+	const Pose* poseData;
+	int totalVertices, totalIndices, totalPoses;
+	float bounds[6];
+
+	const char* mapping;
+	size_t mappedSize;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,268 @@
+#include "GPUParticleSystem.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <vector>
+
+//work group size of the emission, preparation and simulation shaders
+const int GROUP_SIZE = 256;
+
+//layout of the indirect argument buffer, three dispatches, a draw and the
+//padded size of the sort
+const GLintptr SIMULATE_ARGS = 0;
+const GLintptr SORT_LOCAL_ARGS = 3*sizeof(GLuint);
+const GLintptr SORT_GLOBAL_ARGS = 6*sizeof(GLuint);
+const GLintptr DRAW_ARGS = 9*sizeof(GLuint);
+const int TOTAL_ARGS = 14;
+
+CGPUParticleSystem::CGPUParticleSystem(void)
+{
+	capacity = 0;
+	maxLife = 1;
+	emissionRate = 0;
+	emitAccumulator = 0;
+	sorting = true;
+	current = 0;
+	seed = 0;
+	particleBufferID = deadListBufferID = 0;
+	aliveListBufferID[0] = aliveListBufferID[1] = 0;
+	counterBufferID = argumentBufferID = 0;
+	emptyVAOID = 0;
+	queryID[0] = queryID[1] = 0;
+	frame = 0;
+	updateTime = 0;
+}
+
+CGPUParticleSystem::~CGPUParticleSystem(void)
+{
+}
+
+bool CGPUParticleSystem::Init(const int count, const float life) {
+	maxLife = life;
+
+	//particles are fetched from the buffers with gl_VertexID, a core
+	//profile still needs a vertex array object to be bound
+	glGenVertexArrays(1, &emptyVAOID);
+	glGenQueries(2, queryID);
+
+	emitShader.LoadFromFile(GL_COMPUTE_SHADER, "shaders/particle_emit.comp");
+	emitShader.CreateAndLinkProgram();
+	emitShader.Use();
+		emitShader.AddUniform("emitCount");
+		emitShader.AddUniform("seed");
+		emitShader.AddUniform("maxLife");
+		emitShader.AddUniform("current");
+	emitShader.UnUse();
+
+	prepareShader.LoadFromFile(GL_COMPUTE_SHADER, "shaders/particle_prepare.comp");
+	prepareShader.CreateAndLinkProgram();
+	prepareShader.Use();
+		prepareShader.AddUniform("current");
+		prepareShader.AddUniform("afterSimulation");
+	prepareShader.UnUse();
+
+	simulateShader.LoadFromFile(GL_COMPUTE_SHADER, "shaders/particle_simulate.comp");
+	simulateShader.CreateAndLinkProgram();
+	simulateShader.Use();
+		simulateShader.AddUniform("dt");
+		simulateShader.AddUniform("MV");
+		simulateShader.AddUniform("current");
+	simulateShader.UnUse();
+
+	sortLocalShader.LoadFromFile(GL_COMPUTE_SHADER, "shaders/particle_sort_local.comp");
+	sortLocalShader.CreateAndLinkProgram();
+	sortLocalShader.Use();
+		sortLocalShader.AddUniform("k");
+		sortLocalShader.AddUniform("current");
+	sortLocalShader.UnUse();
+
+	sortGlobalShader.LoadFromFile(GL_COMPUTE_SHADER, "shaders/particle_sort_global.comp");
+	sortGlobalShader.CreateAndLinkProgram();
+	sortGlobalShader.Use();
+		sortGlobalShader.AddUniform("k");
+		sortGlobalShader.AddUniform("j");
+	sortGlobalShader.UnUse();
+
+	renderShader.LoadFromFile(GL_VERTEX_SHADER, "shaders/Render.vert");
+	renderShader.LoadFromFile(GL_FRAGMENT_SHADER, "shaders/Render.frag");
+	renderShader.CreateAndLinkProgram();
+	renderShader.Use();
+		renderShader.AddUniform("MVP");
+	renderShader.UnUse();
+
+	return SetCapacity(count);
+}
+
+bool CGPUParticleSystem::SetCapacity(const int count) {
+	ReleaseBuffers();
+	capacity = SORT_BLOCK_SIZE;
+	while(capacity < count)
+		capacity <<= 1;
+	emissionRate = capacity/maxLife;
+	emitAccumulator = 0;
+	current = 0;
+
+	//two vec4 per particle, position and remaining life, velocity and
+	//total life. All particles start out dead.
+	std::vector<glm::vec4> particles(capacity*2, glm::vec4(0));
+	glGenBuffers(1, &particleBufferID);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleBufferID);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, particles.size()*sizeof(glm::vec4), &particles[0], GL_DYNAMIC_COPY);
+
+	std::vector<GLuint> dead(capacity);
+	for(int i=0;i<capacity;i++)
+		dead[i] = i;
+	glGenBuffers(1, &deadListBufferID);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, deadListBufferID);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, capacity*sizeof(GLuint), &dead[0], GL_DYNAMIC_COPY);
+
+	//alive lists hold (sort key, particle index) pairs
+	glGenBuffers(2, aliveListBufferID);
+	for(int i=0;i<2;i++) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, aliveListBufferID[i]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity*2*sizeof(GLuint), 0, GL_DYNAMIC_COPY);
+	}
+
+	//dead count and the alive count of both lists
+	GLint counters[3] = {capacity, 0, 0};
+	glGenBuffers(1, &counterBufferID);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBufferID);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(counters), counters, GL_DYNAMIC_COPY);
+
+	//the draw call must not see stale counts before the first update
+	GLuint args[TOTAL_ARGS] = {0};
+	glGenBuffers(1, &argumentBufferID);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, argumentBufferID);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(args), args, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+void CGPUParticleSystem::ReleaseBuffers() {
+	if(particleBufferID == 0)
+		return;
+	glDeleteBuffers(1, &particleBufferID);
+	glDeleteBuffers(1, &deadListBufferID);
+	glDeleteBuffers(2, aliveListBufferID);
+	glDeleteBuffers(1, &counterBufferID);
+	glDeleteBuffers(1, &argumentBufferID);
+	particleBufferID = deadListBufferID = 0;
+	aliveListBufferID[0] = aliveListBufferID[1] = 0;
+	counterBufferID = argumentBufferID = 0;
+}
+
+void CGPUParticleSystem::Destroy() {
+	emitShader.DeleteShaderProgram();
+	prepareShader.DeleteShaderProgram();
+	simulateShader.DeleteShaderProgram();
+	sortLocalShader.DeleteShaderProgram();
+	sortGlobalShader.DeleteShaderProgram();
+	renderShader.DeleteShaderProgram();
+	ReleaseBuffers();
+	glDeleteVertexArrays(1, &emptyVAOID);
+	glDeleteQueries(2, queryID);
+}
+
+void CGPUParticleSystem::BindBuffers() {
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLES, particleBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DEAD_LIST, deadListBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ALIVE_LIST_READ, aliveListBufferID[current]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ALIVE_LIST_WRITE, aliveListBufferID[1-current]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTERS, counterBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ARGUMENTS, argumentBufferID);
+}
+
+void CGPUParticleSystem::Dispatch(GLSLShader& shader, const GLintptr indirectOffset) {
+	shader.Use();
+	glDispatchComputeIndirect(indirectOffset);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void CGPUParticleSystem::Update(const float dt, const glm::mat4& MV) {
+	//the query of the previous frame has finished by now
+	if(frame > 0) {
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(queryID[(frame-1)&1], GL_QUERY_RESULT, &elapsed);
+		updateTime = elapsed/1000000.0f;
+	}
+	glBeginQuery(GL_TIME_ELAPSED, queryID[frame&1]);
+	frame++;
+
+	BindBuffers();
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, argumentBufferID);
+
+	//new particles are appended to the list read this frame
+	emitAccumulator += emissionRate*dt;
+	int emitCount = int(emitAccumulator);
+	emitAccumulator -= emitCount;
+	emitCount = (emitCount < capacity)? emitCount : capacity;
+	if(emitCount > 0) {
+		emitShader.Use();
+			glUniform1i(emitShader("emitCount"), emitCount);
+			glUniform1ui(emitShader("seed"), seed);
+			glUniform1f(emitShader("maxLife"), maxLife);
+			glUniform1i(emitShader("current"), current);
+			glDispatchCompute((emitCount+GROUP_SIZE-1)/GROUP_SIZE, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		seed += emitCount;
+	}
+
+	//size the simulation to the alive count
+	prepareShader.Use();
+		glUniform1i(prepareShader("current"), current);
+		glUniform1i(prepareShader("afterSimulation"), 0);
+		glDispatchCompute(1, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+	simulateShader.Use();
+		glUniform1f(simulateShader("dt"), dt);
+		glUniformMatrix4fv(simulateShader("MV"), 1, GL_FALSE, glm::value_ptr(MV));
+		glUniform1i(simulateShader("current"), current);
+	Dispatch(simulateShader, SIMULATE_ARGS);
+
+	//size the sort and the draw call to the survivors
+	prepareShader.Use();
+		glUniform1i(prepareShader("afterSimulation"), 1);
+		glDispatchCompute(1, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+	if(sorting) {
+		//bitonic sort, stages up to SORT_BLOCK_SIZE run in shared memory,
+		//every larger stage runs global steps until the distance fits into
+		//a block and finishes in shared memory. Stages larger than the
+		//padded alive count return at once.
+		sortLocalShader.Use();
+			glUniform1i(sortLocalShader("current"), current);
+			glUniform1ui(sortLocalShader("k"), 0);
+		Dispatch(sortLocalShader, SORT_LOCAL_ARGS);
+		for(GLuint k=SORT_BLOCK_SIZE*2; k<=GLuint(capacity); k<<=1) {
+			for(GLuint j=k>>1; j>=GLuint(SORT_BLOCK_SIZE); j>>=1) {
+				sortGlobalShader.Use();
+					glUniform1ui(sortGlobalShader("k"), k);
+					glUniform1ui(sortGlobalShader("j"), j);
+				Dispatch(sortGlobalShader, SORT_GLOBAL_ARGS);
+			}
+			sortLocalShader.Use();
+				glUniform1ui(sortLocalShader("k"), k);
+			Dispatch(sortLocalShader, SORT_LOCAL_ARGS);
+		}
+	}
+	glUseProgram(0);
+	glEndQuery(GL_TIME_ELAPSED);
+
+	//the survivors are read next frame
+	current = 1-current;
+}
+
+void CGPUParticleSystem::Render(const glm::mat4& MVP) {
+	//the list written by the last update
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLES, particleBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ALIVE_LIST_READ, aliveListBufferID[current]);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, argumentBufferID);
+	glBindVertexArray(emptyVAOID);
+	renderShader.Use();
+		glUniformMatrix4fv(renderShader("MVP"), 1, GL_FALSE, glm::value_ptr(MVP));
+		glDrawArraysIndirect(GL_POINTS, (const GLvoid*)DRAW_ARGS);
+	renderShader.UnUse();
+	glBindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
\ No newline at end of file
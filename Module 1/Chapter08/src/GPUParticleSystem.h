@@ -0,0 +1,76 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "GLSLShader.h"
+
+//Particle system that lives entirely on the GPU (OpenGL 4.3 compute
+//shaders). Free particle slots are kept on a dead list, emission pops slots
+//from it and the simulation pushes dying particles back, so only live
+//particles are simulated. The simulation writes the survivors compacted
+//into the alive list of the next frame together with their view depth,
+//the list is then bitonic sorted back to front. The number of live
+//particles never leaves the GPU, the simulation dispatch, the sort and the
+//draw call all read it from an indirect argument buffer.
+class CGPUParticleSystem
+{
+public:
+	//invocations per work group of the sort shaders, a local sort handles
+	//twice as many elements in shared memory
+	static const int SORT_GROUP_SIZE = 512;
+	static const int SORT_BLOCK_SIZE = 2*SORT_GROUP_SIZE;
+
+	CGPUParticleSystem(void);
+	~CGPUParticleSystem(void);
+
+	//capacity is rounded up to a power of two of at least SORT_BLOCK_SIZE
+	bool Init(const int capacity, const float maxLife);
+	void Destroy();
+
+	//reallocates the particle pool, all particles start out dead again
+	bool SetCapacity(const int capacity);
+
+	//particles emitted per second, the default keeps the pool full
+	void SetEmissionRate(const float rate) { emissionRate = rate; }
+	float GetEmissionRate() const { return emissionRate; }
+	void SetSorting(const bool sort) { sorting = sort; }
+	bool IsSorting() const { return sorting; }
+
+	//emits, simulates and sorts the particles, MV is used for the depth
+	void Update(const float dt, const glm::mat4& MV);
+	void Render(const glm::mat4& MVP);
+
+	int GetCapacity() const { return capacity; }
+	//GPU time of the last finished update in milliseconds
+	float GetUpdateTime() const { return updateTime; }
+
+private:
+	//buffer binding points shared by all particle shaders
+	enum Bindings {PARTICLES, DEAD_LIST, ALIVE_LIST_READ, ALIVE_LIST_WRITE, COUNTERS, ARGUMENTS};
+
+	void ReleaseBuffers();
+	void BindBuffers();
+	void Dispatch(GLSLShader& shader, const GLintptr indirectOffset);
+
+	int capacity;
+	float maxLife;
+	float emissionRate;
+	float emitAccumulator;
+	bool sorting;
+	int current;			//alive list read this frame
+	unsigned int seed;
+
+	GLuint particleBufferID;
+	GLuint deadListBufferID;
+	GLuint aliveListBufferID[2];
+	GLuint counterBufferID;
+	GLuint argumentBufferID;
+	GLuint emptyVAOID;
+
+	GLSLShader emitShader, prepareShader, simulateShader;
+	GLSLShader sortLocalShader, sortGlobalShader, renderShader;
+
+	//timer queries of the last two frames, read one frame late
+	GLuint queryID[2];
+	int frame;
+	float updateTime;
+};
\ No newline at end of file
@@ -0,0 +1,277 @@
+#include "MeshBVH.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+//maximum number of triangles stored in a leaf
+const int MAX_LEAF_TRIANGLES = 4;
+
+//a ray is parallel to a triangle when the cosine between its direction and
+//the triangle normal is below this. The determinant of the ray triangle test
+//is compared against it scaled by the ray and normal lengths, so the test
+//does not depend on the size of the mesh.
+const float PARALLEL_EPSILON = 1e-6f;
+
+//comparison functor used to split triangles at the median centre along an axis
+struct TriangleCenterLess {
+	const std::vector<glm::vec3>* centers;
+	int axis;
+	bool operator()(int a, int b) const {
+		return (*centers)[a][axis] < (*centers)[b][axis];
+	}
+};
+
+//slab test, returns the entry distance or a negative value on a miss
+static float IntersectNode(const glm::vec3& origin, const glm::vec3& invDir, const float tMax,
+						   const glm::vec3& bmin, const glm::vec3& bmax) {
+	glm::vec3 t0 = (bmin - origin) * invDir;
+	glm::vec3 t1 = (bmax - origin) * invDir;
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar  = glm::max(t0, t1);
+	float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float exit  = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+	return (enter <= exit)? enter : -1.0f;
+}
+
+//squared distance of a point to a box, 0 inside
+static float DistanceToNode2(const glm::vec3& p, const glm::vec3& bmin, const glm::vec3& bmax) {
+	glm::vec3 d = glm::max(glm::max(bmin-p, p-bmax), glm::vec3(0));
+	return glm::dot(d, d);
+}
+
+CMeshBVH::CMeshBVH(void)
+{
+}
+
+CMeshBVH::~CMeshBVH(void)
+{
+}
+
+void CMeshBVH::Build(const glm::vec3* vertices, const int totalVertices, const GLuint* indices, const int totalIndices) {
+	const int total = totalIndices/3;
+	for(int i=0;i<3*total;i++)
+		assert(indices[i] < GLuint(totalVertices));
+	nodes.clear();
+	triangles.resize(total);
+	centers.resize(total);
+	tmin.resize(total);
+	tmax.resize(total);
+	order.resize(total);
+
+	for(int i=0;i<total;i++) {
+		const glm::vec3& a = vertices[indices[3*i]];
+		const glm::vec3& b = vertices[indices[3*i+1]];
+		const glm::vec3& c = vertices[indices[3*i+2]];
+		tmin[i] = glm::min(a, glm::min(b, c));
+		tmax[i] = glm::max(a, glm::max(b, c));
+		centers[i] = (a+b+c)/3.0f;
+		order[i] = i;
+	}
+
+	if(total>0) {
+		nodes.reserve(2*total/MAX_LEAF_TRIANGLES+1);
+		BuildRecursive(0, total);
+	} else {
+		Node empty = {glm::vec3(0), glm::vec3(0), 0, 0, -1};
+		nodes.push_back(empty);
+	}
+
+	//store the triangles in leaf order with precomputed edges
+	for(int i=0;i<total;i++) {
+		int id = order[i];
+		const glm::vec3& a = vertices[indices[3*id]];
+		triangles[i].v0 = a;
+		triangles[i].e1 = vertices[indices[3*id+1]]-a;
+		triangles[i].e2 = vertices[indices[3*id+2]]-a;
+		triangles[i].normalLength = glm::length(glm::cross(triangles[i].e1, triangles[i].e2));
+		triangles[i].id = id;
+	}
+
+	std::vector<glm::vec3>().swap(centers);
+	std::vector<glm::vec3>().swap(tmin);
+	std::vector<glm::vec3>().swap(tmax);
+	std::vector<int>().swap(order);
+}
+
+int CMeshBVH::BuildRecursive(int first, int count) {
+	int index = int(nodes.size());
+	nodes.push_back(Node());
+
+	glm::vec3 bmin = tmin[order[first]], bmax = tmax[order[first]];
+	glm::vec3 cmin = centers[order[first]], cmax = cmin;
+	for(int i=first+1;i<first+count;i++) {
+		int id = order[i];
+		bmin = glm::min(bmin, tmin[id]);
+		bmax = glm::max(bmax, tmax[id]);
+		cmin = glm::min(cmin, centers[id]);
+		cmax = glm::max(cmax, centers[id]);
+	}
+	nodes[index].min   = bmin;
+	nodes[index].max   = bmax;
+	nodes[index].first = first;
+	nodes[index].count = count;
+	nodes[index].right = -1;
+
+	glm::vec3 extent = cmax-cmin;
+	if(count <= MAX_LEAF_TRIANGLES || glm::max(extent.x, glm::max(extent.y, extent.z)) <= 0)
+		return index;
+
+	TriangleCenterLess cmp;
+	cmp.centers = &centers;
+	cmp.axis = (extent.x > extent.y && extent.x > extent.z)? 0 : (extent.y > extent.z)? 1 : 2;
+	int half = count/2;
+	std::nth_element(order.begin()+first, order.begin()+first+half, order.begin()+first+count, cmp);
+
+	nodes[index].count = 0;
+	BuildRecursive(first, half);
+	int right = BuildRecursive(first+half, count-half);
+	nodes[index].right = right;
+	return index;
+}
+
+bool CMeshBVH::Intersect(const glm::vec3& origin, const glm::vec3& direction, const float tMax, RayHit& hit) const {
+	hit.triangle = -1;
+	hit.t = tMax;
+	hit.u = hit.v = 0;
+	if(triangles.empty())
+		return false;
+
+	glm::vec3 invDir = 1.0f/direction;
+	const float parallel = PARALLEL_EPSILON*glm::length(direction);
+
+	int stack[64];
+	int top = 0;
+	if(IntersectNode(origin, invDir, hit.t, nodes[0].min, nodes[0].max) >= 0)
+		stack[top++] = 0;
+
+	while(top>0) {
+		int index = stack[--top];
+		const Node& node = nodes[index];
+
+		if(node.count>0) {
+			//Moller-Trumbore ray triangle test for every triangle in the leaf
+			for(int i=node.first;i<node.first+node.count;i++) {
+				const Triangle& tri = triangles[i];
+				glm::vec3 p = glm::cross(direction, tri.e2);
+				float det = glm::dot(tri.e1, p);
+				if(fabs(det) <= parallel*tri.normalLength)
+					continue;
+				float invDet = 1.0f/det;
+				glm::vec3 s = origin - tri.v0;
+				float u = glm::dot(s, p)*invDet;
+				if(u < 0 || u > 1)
+					continue;
+				glm::vec3 q = glm::cross(s, tri.e1);
+				float v = glm::dot(direction, q)*invDet;
+				if(v < 0 || u+v > 1)
+					continue;
+				float t = glm::dot(tri.e2, q)*invDet;
+				if(t > 0 && t < hit.t) {
+					hit.t = t;
+					hit.u = u;
+					hit.v = v;
+					hit.triangle = tri.id;
+				}
+			}
+		} else {
+			//visit the nearer child first so farther subtrees are usually
+			//rejected by the shortened hit distance
+			int left = index+1, right = node.right;
+			float tl = IntersectNode(origin, invDir, hit.t, nodes[left].min, nodes[left].max);
+			float tr = IntersectNode(origin, invDir, hit.t, nodes[right].min, nodes[right].max);
+			if(tl >= 0 && tr >= 0) {
+				if(tl < tr) std::swap(left, right);
+				stack[top++] = left;
+				stack[top++] = right;
+			} else if(tl >= 0) {
+				stack[top++] = left;
+			} else if(tr >= 0) {
+				stack[top++] = right;
+			}
+		}
+	}
+	return hit.triangle != -1;
+}
+
+glm::vec3 CMeshBVH::ClosestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b,
+										   const glm::vec3& c, bool& interior) {
+	//Voronoi region test from Ericson, Real-Time Collision Detection
+	interior = false;
+	glm::vec3 ab = b-a, ac = c-a, ap = p-a;
+	float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+	if(d1 <= 0 && d2 <= 0)
+		return a;
+	glm::vec3 bp = p-b;
+	float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+	if(d3 >= 0 && d4 <= d3)
+		return b;
+	float vc = d1*d4 - d3*d2;
+	if(vc <= 0 && d1 >= 0 && d3 <= 0)
+		return a + ab*(d1/(d1-d3));
+	glm::vec3 cp = p-c;
+	float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+	if(d6 >= 0 && d5 <= d6)
+		return c;
+	float vb = d5*d2 - d1*d6;
+	if(vb <= 0 && d2 >= 0 && d6 <= 0)
+		return a + ac*(d2/(d2-d6));
+	float va = d3*d6 - d5*d4;
+	if(va <= 0 && (d4-d3) >= 0 && (d5-d6) >= 0)
+		return b + (c-b)*((d4-d3)/((d4-d3)+(d5-d6)));
+	float denom = va+vb+vc;
+	if(denom <= 0)
+		return a;
+	interior = true;
+	return a + ab*(vb/denom) + ac*(vc/denom);
+}
+
+bool CMeshBVH::Closest(const glm::vec3& p, const float maxDistance, ClosestHit& hit) const {
+	hit.triangle = -1;
+	hit.distance = maxDistance;
+	hit.point = p;
+	if(triangles.empty())
+		return false;
+
+	float best2 = maxDistance*maxDistance;
+	int stack[64];
+	int top = 0;
+	if(DistanceToNode2(p, nodes[0].min, nodes[0].max) < best2)
+		stack[top++] = 0;
+
+	while(top>0) {
+		int index = stack[--top];
+		const Node& node = nodes[index];
+		if(DistanceToNode2(p, node.min, node.max) >= best2)
+			continue;
+
+		if(node.count>0) {
+			for(int i=node.first;i<node.first+node.count;i++) {
+				const Triangle& tri = triangles[i];
+				bool interior;
+				glm::vec3 q = ClosestPointOnTriangle(p, tri.v0, tri.v0+tri.e1, tri.v0+tri.e2, interior);
+				float d2 = glm::dot(p-q, p-q);
+				if(d2 < best2) {
+					best2 = d2;
+					hit.point = q;
+					hit.triangle = tri.id;
+				}
+			}
+		} else {
+			//visit the nearer child first so the farther one is usually
+			//rejected by the shortened distance
+			int left = index+1, right = node.right;
+			float dl = DistanceToNode2(p, nodes[left].min, nodes[left].max);
+			float dr = DistanceToNode2(p, nodes[right].min, nodes[right].max);
+			if(dl < dr) {
+				std::swap(left, right);
+				std::swap(dl, dr);
+			}
+			if(dl < best2)
+				stack[top++] = left;
+			if(dr < best2)
+				stack[top++] = right;
+		}
+	}
+	hit.distance = sqrtf(best2);
+	return hit.triangle != -1;
+}
\ No newline at end of file
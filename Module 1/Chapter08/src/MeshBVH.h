@@ -0,0 +1,71 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+//result of a ray mesh intersection
+struct RayHit {
+	int triangle;		//index of the hit triangle, -1 if nothing was hit
+	float t;			//distance along the ray
+	float u, v;			//barycentric coordinates of the hit point, the weight
+						//of the first vertex is 1-u-v
+};
+
+//result of a closest point query
+struct ClosestHit {
+	int triangle;		//index of the closest triangle, -1 if none is in range
+	float distance;
+	glm::vec3 point;	//closest point on the mesh
+};
+
+//Bounding volume hierarchy over the triangles of one mesh, used to find the
+//exact triangle hit by a ray and the closest point of the mesh to a point.
+//Queries are given in the object space of the mesh so the same hierarchy is
+//shared by all instances of the mesh.
+class CMeshBVH
+{
+public:
+	CMeshBVH(void);
+	~CMeshBVH(void);
+
+	void Build(const glm::vec3* vertices, const int totalVertices, const GLuint* indices, const int totalIndices);
+
+	//find the nearest hit with t in (0, tMax). Returns false if there is none.
+	bool Intersect(const glm::vec3& origin, const glm::vec3& direction, const float tMax, RayHit& hit) const;
+
+	//find the closest point of the mesh within maxDistance of p. Returns
+	//false if there is none.
+	bool Closest(const glm::vec3& p, const float maxDistance, ClosestHit& hit) const;
+
+	//closest point to p on the triangle (a, b, c). interior is set when the
+	//point lies inside the triangle rather than on one of its edges.
+	static glm::vec3 ClosestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b,
+											const glm::vec3& c, bool& interior);
+
+	const glm::vec3& GetMin() const { return nodes[0].min; }
+	const glm::vec3& GetMax() const { return nodes[0].max; }
+
+	int GetTotalTriangles() const { return int(triangles.size()); }
+
+private:
+	struct Node {
+		glm::vec3 min, max;
+		int first;		//first triangle in the triangle list
+		int count;		//number of triangles, 0 for interior nodes
+		int right;		//right child, left child always follows the node
+	};
+
+	struct Triangle {
+		glm::vec3 v0, e1, e2;	//first vertex and the two edges from it
+		float normalLength;		//length of cross(e1, e2), twice the area
+		int id;					//index of the triangle in the source mesh
+	};
+
+	int BuildRecursive(int first, int count);
+
+	std::vector<Node> nodes;
+	std::vector<Triangle> triangles;
+	//scratch used while building
+	std::vector<glm::vec3> centers, tmin, tmax;
+	std::vector<int> order;
+};
\ No newline at end of file
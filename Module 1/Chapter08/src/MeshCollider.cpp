@@ -0,0 +1,80 @@
+#include "MeshCollider.h"
+#include <algorithm>
+
+//direction of the sign rays, skewed so rays rarely run along mesh edges
+const glm::vec3 RAY_DIRECTION = glm::normalize(glm::vec3(0.5773f, 0.6123f, 0.5403f));
+
+//largest number of crossings followed along a sign ray
+const int MAX_CROSSINGS = 64;
+
+CMeshCollider::CMeshCollider(void)
+{
+	resolution = 0;
+	outside = 0;
+}
+
+CMeshCollider::~CMeshCollider(void)
+{
+}
+
+void CMeshCollider::Build(const glm::vec3* vertices, const int totalVertices, const GLuint* indices, const int totalIndices,
+						  const int res, const float margin, CThreadPool* pool) {
+	bvh.Build(vertices, totalVertices, indices, totalIndices);
+	resolution = res;
+	bmin = bvh.GetMin() - glm::vec3(margin);
+	bmax = bvh.GetMax() + glm::vec3(margin);
+	cellSize = (bmax-bmin)/float(resolution-1);
+	outside = glm::length(bmax-bmin);
+	field.resize(resolution*resolution*resolution);
+	if(pool)
+		pool->Run(resolution, SliceTask, this);
+	else
+		for(int z=0;z<resolution;z++)
+			BuildSlice(z);
+}
+
+void CMeshCollider::SliceTask(int task, void* data) {
+	static_cast<CMeshCollider*>(data)->BuildSlice(task);
+}
+
+void CMeshCollider::BuildSlice(const int z) {
+	const float step = 1e-4f*outside;
+	for(int y=0;y<resolution;y++) {
+		for(int x=0;x<resolution;x++) {
+			glm::vec3 p = bmin + glm::vec3(float(x), float(y), float(z))*cellSize;
+			ClosestHit closest;
+			bvh.Closest(p, outside, closest);
+
+			//inside a closed mesh a ray crosses the surface an odd number of times
+			int crossings = 0;
+			glm::vec3 origin = p;
+			RayHit hit;
+			while(crossings < MAX_CROSSINGS && bvh.Intersect(origin, RAY_DIRECTION, outside, hit)) {
+				crossings++;
+				origin += RAY_DIRECTION*(hit.t+step);
+			}
+			field[(z*resolution+y)*resolution+x] = (crossings&1)? -closest.distance : closest.distance;
+		}
+	}
+}
+
+float CMeshCollider::Distance(const glm::vec3& p) const {
+	glm::vec3 g = (p-bmin)/cellSize;
+	if(g.x < 0 || g.y < 0 || g.z < 0 || g.x >= resolution-1 || g.y >= resolution-1 || g.z >= resolution-1)
+		return outside;
+	int x = int(g.x), y = int(g.y), z = int(g.z);
+	glm::vec3 f = g - glm::vec3(float(x), float(y), float(z));
+	float c00 = glm::mix(Sample(x, y,   z),   Sample(x+1, y,   z),   f.x);
+	float c10 = glm::mix(Sample(x, y+1, z),   Sample(x+1, y+1, z),   f.x);
+	float c01 = glm::mix(Sample(x, y,   z+1), Sample(x+1, y,   z+1), f.x);
+	float c11 = glm::mix(Sample(x, y+1, z+1), Sample(x+1, y+1, z+1), f.x);
+	return glm::mix(glm::mix(c00, c10, f.y), glm::mix(c01, c11, f.y), f.z);
+}
+
+glm::vec3 CMeshCollider::Gradient(const glm::vec3& p) const {
+	//central differences of half a cell
+	glm::vec3 h = cellSize*0.5f;
+	return glm::vec3(Distance(p+glm::vec3(h.x,0,0)) - Distance(p-glm::vec3(h.x,0,0)),
+					 Distance(p+glm::vec3(0,h.y,0)) - Distance(p-glm::vec3(0,h.y,0)),
+					 Distance(p+glm::vec3(0,0,h.z)) - Distance(p-glm::vec3(0,0,h.z)))/(2.0f*h);
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "MeshBVH.h"
+#include "ThreadPool.h"
+
+//Signed distance field of a closed triangle mesh, used to collide cloth
+//against arbitrary meshes. The field is sampled once on a regular grid
+//around the mesh, the distances come from closest point queries on a
+//bounding volume hierarchy and the sign from counting ray crossings. At
+//run time a collision test is a single trilinear lookup, on the CPU or
+//from a 3D texture on the GPU.
+class CMeshCollider
+{
+public:
+	CMeshCollider(void);
+	~CMeshCollider(void);
+
+	//samples the field on resolution^3 points covering the mesh bounds
+	//grown by margin on every side, the slices are spread over the pool
+	void Build(const glm::vec3* vertices, const int totalVertices, const GLuint* indices, const int totalIndices,
+			   const int resolution, const float margin, CThreadPool* pool);
+
+	//trilinear distance at a point in mesh space, negative inside. Points
+	//outside the grid return the largest distance of the grid.
+	float Distance(const glm::vec3& p) const;
+	//unnormalized gradient of the distance, points away from the mesh
+	glm::vec3 Gradient(const glm::vec3& p) const;
+
+	int GetResolution() const { return resolution; }
+	const glm::vec3& GetMin() const { return bmin; }
+	const glm::vec3& GetMax() const { return bmax; }
+	const float* GetData() const { return &field[0]; }
+
+private:
+	float Sample(const int x, const int y, const int z) const { return field[(z*resolution+y)*resolution+x]; }
+	void BuildSlice(const int z);
+	static void SliceTask(int task, void* data);
+
+	CMeshBVH bvh;
+	int resolution;
+	glm::vec3 bmin, bmax;
+	glm::vec3 cellSize;
+	float outside;			//distance returned outside of the grid
+	std::vector<float> field;
+};
\ No newline at end of file
@@ -0,0 +1,292 @@
+#include "XPBDCloth.h"
+#include "Timer.h"
+#include <xmmintrin.h>
+#include <algorithm>
+#include <cstring>
+
+static float* AllocateArray(const int count) {
+	float* p = static_cast<float*>(_mm_malloc(count*sizeof(float), 16));
+	memset(p, 0, count*sizeof(float));
+	return p;
+}
+
+static void FreeArray(float*& p) {
+	if(p)
+		_mm_free(p);
+	p = 0;
+}
+
+CXPBDCloth::CXPBDCloth(void)
+{
+	pool = 0;
+	collision = 0;
+	total = allocated = 0;
+	substeps = 10;
+	compliance[CClothConstraints::STRETCH] = 0;
+	compliance[CClothConstraints::SHEAR] = 1e-6f;
+	compliance[CClothConstraints::BEND] = 1e-4f;
+	gravity = glm::vec3(0, -9.81f, 0);
+	damping = 0.1f;
+	x = y = z = px = py = pz = vx = vy = vz = w = 0;
+	cx = cy = cz = 0;
+	restLength = alpha = 0;
+	h = 0;
+	batch = 0;
+	maxVelocity = 0;
+	stepTime = 0;
+}
+
+CXPBDCloth::~CXPBDCloth(void)
+{
+	Destroy();
+}
+
+void CXPBDCloth::Init(const CClothConstraints& constraints, CThreadPool* threadPool) {
+	Destroy();
+	pool = threadPool;
+	total = constraints.GetTotalParticles();
+	allocated = (total+1+3)&~3;
+
+	float** arrays[13] = {&x, &y, &z, &px, &py, &pz, &vx, &vy, &vz, &w, &cx, &cy, &cz};
+	for(int i=0;i<13;i++)
+		*arrays[i] = AllocateArray(allocated);
+	const std::vector<glm::vec4>& p = constraints.GetPositions();
+	for(int i=0;i<total;i++) {
+		x[i] = px[i] = p[i].x;
+		y[i] = py[i] = p[i].y;
+		z[i] = pz[i] = p[i].z;
+		w[i] = p[i].w;
+	}
+
+	const int count = constraints.GetTotalConstraints();
+	const CClothConstraints::Constraint* c = constraints.GetConstraints();
+	a.resize(count);
+	b.resize(count);
+	types.resize(count);
+	restLength = AllocateArray(count);
+	alpha = AllocateArray(count);
+	for(int i=0;i<count;i++) {
+		a[i] = c[i].a;
+		b[i] = c[i].b;
+		types[i] = c[i].type;
+		restLength[i] = c[i].restLength;
+	}
+	batchStart.resize(constraints.GetTotalBatches()+1);
+	for(int i=0;i<constraints.GetTotalBatches();i++)
+		batchStart[i] = constraints.GetBatchStart(i);
+	batchStart.back() = count;
+
+	anchors = constraints.GetAnchors();
+	for(size_t k=0;k<anchors.size();k++) {
+		float* length = AllocateArray(allocated);
+		glm::vec3 anchor(p[anchors[k]]);
+		for(int i=0;i<total;i++)
+			length[i] = glm::length(glm::vec3(p[i])-anchor);
+		tetherLength.push_back(length);
+	}
+}
+
+void CXPBDCloth::Destroy() {
+	float** arrays[15] = {&x, &y, &z, &px, &py, &pz, &vx, &vy, &vz, &w, &cx, &cy, &cz, &restLength, &alpha};
+	for(int i=0;i<15;i++)
+		FreeArray(*arrays[i]);
+	for(size_t k=0;k<tetherLength.size();k++)
+		FreeArray(tetherLength[k]);
+	tetherLength.clear();
+	anchors.clear();
+	a.clear();
+	b.clear();
+	types.clear();
+	batchStart.clear();
+	total = allocated = 0;
+}
+
+void CXPBDCloth::SetParticle(const int i, const glm::vec3& p, const float invMass) {
+	x[i] = px[i] = p.x;
+	y[i] = py[i] = p.y;
+	z[i] = pz[i] = p.z;
+	vx[i] = vy[i] = vz[i] = 0;
+	w[i] = invMass;
+}
+
+void CXPBDCloth::Write(float* dst) const {
+	for(int i=0;i<total;i++, dst+=4) {
+		dst[0] = x[i];
+		dst[1] = y[i];
+		dst[2] = z[i];
+		dst[3] = w[i];
+	}
+}
+
+void CXPBDCloth::Predict(const int start, const int end) {
+	//particles of zero inverse mass neither fall nor move
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1);
+	const __m128 epsilon = _mm_set1_ps(1e-9f);
+	const __m128 vmax = _mm_set1_ps(maxVelocity);
+	const __m128 t = _mm_set1_ps(h);
+	const __m128 gx = _mm_set1_ps(gravity.x*h), gy = _mm_set1_ps(gravity.y*h), gz = _mm_set1_ps(gravity.z*h);
+	for(int i=start;i<end;i+=4) {
+		__m128 free = _mm_cmpgt_ps(_mm_load_ps(w+i), zero);
+		__m128 velX = _mm_add_ps(_mm_load_ps(vx+i), _mm_and_ps(free, gx));
+		__m128 velY = _mm_add_ps(_mm_load_ps(vy+i), _mm_and_ps(free, gy));
+		__m128 velZ = _mm_add_ps(_mm_load_ps(vz+i), _mm_and_ps(free, gz));
+		if(maxVelocity > 0) {
+			//the collision candidates only cover particles this fast
+			__m128 speed = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(velX, velX), _mm_mul_ps(velY, velY)), _mm_mul_ps(velZ, velZ)));
+			__m128 s = _mm_min_ps(one, _mm_div_ps(vmax, _mm_max_ps(speed, epsilon)));
+			velX = _mm_mul_ps(velX, s);
+			velY = _mm_mul_ps(velY, s);
+			velZ = _mm_mul_ps(velZ, s);
+		}
+		_mm_store_ps(vx+i, velX); _mm_store_ps(vy+i, velY); _mm_store_ps(vz+i, velZ);
+		_mm_store_ps(px+i, _mm_add_ps(_mm_load_ps(x+i), _mm_mul_ps(velX, t)));
+		_mm_store_ps(py+i, _mm_add_ps(_mm_load_ps(y+i), _mm_mul_ps(velY, t)));
+		_mm_store_ps(pz+i, _mm_add_ps(_mm_load_ps(z+i), _mm_mul_ps(velZ, t)));
+	}
+}
+
+void CXPBDCloth::Solve(const int start, const int end) {
+	//with one iteration per substep the Lagrange multiplier of every
+	//constraint starts at zero, so it does not have to be stored
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 epsilon = _mm_set1_ps(1e-9f);
+	const int* ia = &a[0];
+	const int* ib = &b[0];
+	__m128 outA[3], outB[3];
+	const float* fa = reinterpret_cast<const float*>(outA);
+	const float* fb = reinterpret_cast<const float*>(outB);
+	for(int c=start;c<end;c+=4) {
+		const int a0 = ia[c], a1 = ia[c+1], a2 = ia[c+2], a3 = ia[c+3];
+		const int b0 = ib[c], b1 = ib[c+1], b2 = ib[c+2], b3 = ib[c+3];
+		__m128 xa = _mm_set_ps(px[a3], px[a2], px[a1], px[a0]);
+		__m128 ya = _mm_set_ps(py[a3], py[a2], py[a1], py[a0]);
+		__m128 za = _mm_set_ps(pz[a3], pz[a2], pz[a1], pz[a0]);
+		__m128 wa = _mm_set_ps(w[a3], w[a2], w[a1], w[a0]);
+		__m128 xb = _mm_set_ps(px[b3], px[b2], px[b1], px[b0]);
+		__m128 yb = _mm_set_ps(py[b3], py[b2], py[b1], py[b0]);
+		__m128 zb = _mm_set_ps(pz[b3], pz[b2], pz[b1], pz[b0]);
+		__m128 wb = _mm_set_ps(w[b3], w[b2], w[b1], w[b0]);
+
+		__m128 dx = _mm_sub_ps(xa, xb), dy = _mm_sub_ps(ya, yb), dz = _mm_sub_ps(za, zb);
+		__m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+		__m128 denom = _mm_add_ps(_mm_add_ps(wa, wb), _mm_load_ps(alpha+c));
+		__m128 valid = _mm_and_ps(_mm_cmpgt_ps(len, epsilon), _mm_cmpgt_ps(denom, zero));
+
+		//lambda = -C/(wa+wb+alpha/h^2), the correction along the
+		//normalized difference is lambda*dx/len
+		__m128 C = _mm_sub_ps(len, _mm_load_ps(restLength+c));
+		__m128 s = _mm_and_ps(valid, _mm_div_ps(C, _mm_mul_ps(denom, len)));
+		__m128 sa = _mm_mul_ps(s, wa), sb = _mm_mul_ps(s, wb);
+
+		outA[0] = _mm_sub_ps(xa, _mm_mul_ps(dx, sa));
+		outA[1] = _mm_sub_ps(ya, _mm_mul_ps(dy, sa));
+		outA[2] = _mm_sub_ps(za, _mm_mul_ps(dz, sa));
+		outB[0] = _mm_add_ps(xb, _mm_mul_ps(dx, sb));
+		outB[1] = _mm_add_ps(yb, _mm_mul_ps(dy, sb));
+		outB[2] = _mm_add_ps(zb, _mm_mul_ps(dz, sb));
+
+		//no particle appears twice in a batch, so the lanes scatter safely
+		for(int k=0;k<4;k++) {
+			px[ia[c+k]] = fa[k]; py[ia[c+k]] = fa[4+k]; pz[ia[c+k]] = fa[8+k];
+			px[ib[c+k]] = fb[k]; py[ib[c+k]] = fb[4+k]; pz[ib[c+k]] = fb[8+k];
+		}
+	}
+}
+
+void CXPBDCloth::Finalize(const int start, const int end) {
+	//long range attachments and floor collision, then the velocity is the
+	//distance moved in the substep
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 invH = _mm_set1_ps(std::max(0.0f, 1-damping*h)/h);
+	for(int i=start;i<end;i+=4) {
+		__m128 nx = _mm_load_ps(px+i);
+		__m128 ny = _mm_load_ps(py+i);
+		__m128 nz = _mm_load_ps(pz+i);
+		__m128 free = _mm_cmpgt_ps(_mm_load_ps(w+i), zero);
+		for(size_t k=0;k<anchors.size();k++) {
+			//pull the particle back onto the sphere of its rest distance
+			__m128 dx = _mm_sub_ps(nx, _mm_set1_ps(px[anchors[k]]));
+			__m128 dy = _mm_sub_ps(ny, _mm_set1_ps(py[anchors[k]]));
+			__m128 dz = _mm_sub_ps(nz, _mm_set1_ps(pz[anchors[k]]));
+			__m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+			__m128 rest = _mm_load_ps(tetherLength[k]+i);
+			__m128 stretched = _mm_and_ps(free, _mm_cmpgt_ps(len, rest));
+			__m128 s = _mm_and_ps(stretched, _mm_div_ps(_mm_sub_ps(len, rest), len));
+			nx = _mm_sub_ps(nx, _mm_mul_ps(dx, s));
+			ny = _mm_sub_ps(ny, _mm_mul_ps(dy, s));
+			nz = _mm_sub_ps(nz, _mm_mul_ps(dz, s));
+		}
+		ny = _mm_max_ps(ny, zero);
+		_mm_store_ps(vx+i, _mm_mul_ps(_mm_sub_ps(nx, _mm_load_ps(x+i)), invH));
+		_mm_store_ps(vy+i, _mm_mul_ps(_mm_sub_ps(ny, _mm_load_ps(y+i)), invH));
+		_mm_store_ps(vz+i, _mm_mul_ps(_mm_sub_ps(nz, _mm_load_ps(z+i)), invH));
+		_mm_store_ps(x+i, nx);
+		_mm_store_ps(y+i, ny);
+		_mm_store_ps(z+i, nz);
+	}
+}
+
+void CXPBDCloth::PredictTask(int task, void* data) {
+	CXPBDCloth* cloth = static_cast<CXPBDCloth*>(data);
+	int start = task*PARTICLE_CHUNK;
+	cloth->Predict(start, std::min(start+PARTICLE_CHUNK, cloth->allocated));
+}
+
+void CXPBDCloth::SolveTask(int task, void* data) {
+	CXPBDCloth* cloth = static_cast<CXPBDCloth*>(data);
+	int start = cloth->batchStart[cloth->batch] + task*CONSTRAINT_CHUNK;
+	cloth->Solve(start, std::min(start+CONSTRAINT_CHUNK, cloth->batchStart[cloth->batch+1]));
+}
+
+void CXPBDCloth::CollideTask(int task, void* data) {
+	CXPBDCloth* cloth = static_cast<CXPBDCloth*>(data);
+	int start = task*PARTICLE_CHUNK;
+	cloth->collision->Solve(cloth->px, cloth->py, cloth->pz, cloth->w, cloth->cx, cloth->cy, cloth->cz,
+							start, std::min(start+PARTICLE_CHUNK, cloth->allocated));
+}
+
+void CXPBDCloth::FinalizeTask(int task, void* data) {
+	CXPBDCloth* cloth = static_cast<CXPBDCloth*>(data);
+	int start = task*PARTICLE_CHUNK;
+	cloth->Finalize(start, std::min(start+PARTICLE_CHUNK, cloth->allocated));
+}
+
+void CXPBDCloth::Step(const float dt) {
+	CTimer timer;
+	h = dt/substeps;
+
+	//alpha/h^2 of every constraint
+	const int count = int(a.size());
+	const float invH2 = 1.0f/(h*h);
+	for(int i=0;i<count;i++)
+		alpha[i] = compliance[types[i]]*invH2;
+
+	//the collision candidates are found once per frame and hold as long as
+	//no particle moves faster than the collision allows
+	maxVelocity = 0;
+	if(collision) {
+		collision->SetSubsteps(substeps);
+		collision->FindCandidates(x, y, z, pool);
+		maxVelocity = collision->GetMaxVelocity(dt);
+	}
+
+	const int particleTasks = (allocated+PARTICLE_CHUNK-1)/PARTICLE_CHUNK;
+	for(int s=0;s<substeps;s++) {
+		pool->Run(particleTasks, PredictTask, this);
+		for(batch=0; batch<int(batchStart.size())-1; batch++) {
+			int size = batchStart[batch+1]-batchStart[batch];
+			pool->Run((size+CONSTRAINT_CHUNK-1)/CONSTRAINT_CHUNK, SolveTask, this);
+		}
+		if(collision) {
+			//every particle reads the others and writes only itself, the
+			//result becomes the predicted positions
+			pool->Run(particleTasks, CollideTask, this);
+			std::swap(px, cx);
+			std::swap(py, cy);
+			std::swap(pz, cz);
+		}
+		pool->Run(particleTasks, FinalizeTask, this);
+	}
+	stepTime = timer.Elapsed();
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "ClothCollision.h"
+#include "ClothConstraints.h"
+#include "ThreadPool.h"
+
+//CPU cloth solver using extended position based dynamics (XPBD). Every frame
+//is split into substeps with one constraint iteration each, which keeps
+//stiff cloth stable at large resolutions where explicit springs need tiny
+//time steps. The particles are stored as a structure of arrays, the
+//constraint batches of CClothConstraints are solved four constraints per
+//SSE instruction and split into chunks that run on a thread pool. With a
+//CClothCollision attached, collisions are resolved after the constraints of
+//every substep.
+class CXPBDCloth
+{
+public:
+	CXPBDCloth(void);
+	~CXPBDCloth(void);
+
+	void Init(const CClothConstraints& constraints, CThreadPool* pool);
+	void Destroy();
+
+	//compliance (inverse stiffness) of a constraint type, 0 is rigid
+	void SetCompliance(const int type, const float compliance) { this->compliance[type] = compliance; }
+	void SetSubsteps(const int substeps) { this->substeps = substeps; }
+	void SetGravity(const glm::vec3& g) { gravity = g; }
+	//fraction of the velocity lost per second
+	void SetDamping(const float damping) { this->damping = damping; }
+	//self and collider collisions, 0 to disable. The collision object must
+	//be set up for the same constraints and outlive the cloth.
+	void SetCollision(CClothCollision* collision) { this->collision = collision; }
+
+	//advances the cloth by dt seconds
+	void Step(const float dt);
+
+	//moves a particle and stops it, particles of inverse mass 0 are only
+	//moved by this call, as used for pinning and dragging
+	void SetParticle(const int i, const glm::vec3& p, const float invMass);
+	glm::vec3 GetPosition(const int i) const { return glm::vec3(x[i], y[i], z[i]); }
+
+	//writes position (xyz) and inverse mass (w) of every cloth particle
+	void Write(float* dst) const;
+
+	int GetTotalParticles() const { return total; }
+	//CPU time of the last step in milliseconds
+	float GetStepTime() const { return stepTime; }
+
+private:
+	//particles per predict or finalize task and constraints per solve task,
+	//multiples of the SIMD width
+	static const int PARTICLE_CHUNK = 4096;
+	static const int CONSTRAINT_CHUNK = 2048;
+
+	void Predict(const int start, const int end);
+	void Solve(const int start, const int end);
+	void Finalize(const int start, const int end);
+
+	static void PredictTask(int task, void* data);
+	static void SolveTask(int task, void* data);
+	static void CollideTask(int task, void* data);
+	static void FinalizeTask(int task, void* data);
+
+	CThreadPool* pool;
+	CClothCollision* collision;
+	int total;		//cloth particles
+	int allocated;	//cloth particles, the padding particle and SIMD padding
+	int substeps;
+	float compliance[CClothConstraints::TOTAL_TYPES];
+	glm::vec3 gravity;
+	float damping;
+
+	//structure of arrays particle data, positions, predicted positions,
+	//velocities and inverse masses
+	float *x, *y, *z;
+	float *px, *py, *pz;
+	float *vx, *vy, *vz;
+	float *w;
+	//predicted positions after collisions, swapped with px, py, pz
+	float *cx, *cy, *cz;
+
+	//anchors and the rest distance of every particle to each of them
+	std::vector<int> anchors;
+	std::vector<float*> tetherLength;
+
+	//constraints, batch after batch
+	std::vector<int> a, b;
+	std::vector<int> types;
+	float *restLength, *alpha;
+	std::vector<int> batchStart;
+
+	//state of the current substep shared with the tasks
+	float h;
+	int batch;
+	float maxVelocity;	//velocity clamp while colliding, 0 for none
+
+	float stepTime;
+};
\ No newline at end of file
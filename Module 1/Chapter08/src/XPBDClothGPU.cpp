@@ -0,0 +1,403 @@
+#include "XPBDClothGPU.h"
+#include <algorithm>
+
+//work group size of the cloth shaders
+const int GROUP_SIZE = 256;
+
+//ints per particle in the candidate buffer, the two counts and the lists
+const int CANDIDATE_STRIDE = 2 + CClothCollision::MAX_NEIGHBORS + CClothCollision::MAX_TRIANGLES;
+
+CXPBDClothGPU::CXPBDClothGPU(void)
+{
+	total = totalAnchors = 0;
+	substeps = 10;
+	compliance[CClothConstraints::STRETCH] = 0;
+	compliance[CClothConstraints::SHEAR] = 1e-6f;
+	compliance[CClothConstraints::BEND] = 1e-4f;
+	gravity = glm::vec3(0, -9.81f, 0);
+	damping = 0.1f;
+	positionBufferID = predictedBufferID = velocityBufferID = 0;
+	constraintBufferID = restBufferID = anchorBufferID = 0;
+	queryID[0] = queryID[1] = 0;
+	collision = 0;
+	tableSize = 0;
+	hashBufferID = cellEntryBufferID = adjacencyBufferID = 0;
+	indexBufferID = candidateBufferID = collidedBufferID = 0;
+	for(int i=0;i<CClothCollision::MAX_COLLIDERS;i++)
+		distanceFieldID[i] = 0;
+	frame = 0;
+	stepTime = 0;
+}
+
+CXPBDClothGPU::~CXPBDClothGPU(void)
+{
+}
+
+bool CXPBDClothGPU::Init(const bool collisions) {
+	glGenQueries(2, queryID);
+
+	predictShader.LoadFromFile(GL_COMPUTE_SHADER, "shaders/xpbd_predict.comp");
+	predictShader.CreateAndLinkProgram();
+	predictShader.Use();
+		predictShader.AddUniform("totalParticles");
+		predictShader.AddUniform("h");
+		predictShader.AddUniform("gravity");
+		predictShader.AddUniform("maxVelocity");
+	predictShader.UnUse();
+
+	solveShader.LoadFromFile(GL_COMPUTE_SHADER, "shaders/xpbd_solve.comp");
+	solveShader.CreateAndLinkProgram();
+	solveShader.Use();
+		solveShader.AddUniform("batchStart");
+		solveShader.AddUniform("batchSize");
+		solveShader.AddUniform("alpha");
+	solveShader.UnUse();
+
+	finalizeShader.LoadFromFile(GL_COMPUTE_SHADER, "shaders/xpbd_finalize.comp");
+	finalizeShader.CreateAndLinkProgram();
+	finalizeShader.Use();
+		finalizeShader.AddUniform("totalParticles");
+		finalizeShader.AddUniform("totalAnchors");
+		finalizeShader.AddUniform("h");
+		finalizeShader.AddUniform("damping");
+	finalizeShader.UnUse();
+
+	if(collisions) {
+		GLSLShader* hashShaders[3] = {&hashCountShader, &hashScanShader, &hashScatterShader};
+		const char* hashFiles[3] = {"shaders/cloth_hash_count.comp", "shaders/cloth_hash_scan.comp", "shaders/cloth_hash_scatter.comp"};
+		for(int i=0;i<3;i++) {
+			hashShaders[i]->LoadFromFile(GL_COMPUTE_SHADER, hashFiles[i]);
+			hashShaders[i]->CreateAndLinkProgram();
+			hashShaders[i]->Use();
+				hashShaders[i]->AddUniform("totalParticles");
+				hashShaders[i]->AddUniform("tableSize");
+				hashShaders[i]->AddUniform("cellSize");
+			hashShaders[i]->UnUse();
+		}
+
+		candidateShader.LoadFromFile(GL_COMPUTE_SHADER, "shaders/cloth_candidates.comp");
+		candidateShader.CreateAndLinkProgram();
+		candidateShader.Use();
+			candidateShader.AddUniform("totalParticles");
+			candidateShader.AddUniform("tableSize");
+			candidateShader.AddUniform("cellSize");
+			candidateShader.AddUniform("pairRadius");
+			candidateShader.AddUniform("triangleRadius");
+		candidateShader.UnUse();
+
+		collideShader.LoadFromFile(GL_COMPUTE_SHADER, "shaders/cloth_collide.comp");
+		collideShader.CreateAndLinkProgram();
+		collideShader.Use();
+			collideShader.AddUniform("totalParticles");
+			collideShader.AddUniform("thickness");
+			collideShader.AddUniform("totalColliders");
+			collideShader.AddUniform("distanceField");
+			collideShader.AddUniform("colliderTransform");
+			collideShader.AddUniform("colliderInverse");
+			collideShader.AddUniform("colliderScale");
+			collideShader.AddUniform("colliderMin");
+			collideShader.AddUniform("colliderMax");
+			collideShader.AddUniform("colliderResolution");
+			//the distance fields use the first texture units
+			GLint units[CClothCollision::MAX_COLLIDERS];
+			for(int i=0;i<CClothCollision::MAX_COLLIDERS;i++)
+				units[i] = i;
+			glUniform1iv(collideShader("distanceField"), CClothCollision::MAX_COLLIDERS, units);
+		collideShader.UnUse();
+	}
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+void CXPBDClothGPU::Destroy() {
+	ReleaseBuffers();
+	predictShader.DeleteShaderProgram();
+	solveShader.DeleteShaderProgram();
+	finalizeShader.DeleteShaderProgram();
+	hashCountShader.DeleteShaderProgram();
+	hashScanShader.DeleteShaderProgram();
+	hashScatterShader.DeleteShaderProgram();
+	candidateShader.DeleteShaderProgram();
+	collideShader.DeleteShaderProgram();
+	glDeleteQueries(2, queryID);
+}
+
+void CXPBDClothGPU::ReleaseBuffers() {
+	ReleaseCollision();
+	if(positionBufferID == 0)
+		return;
+	GLuint buffers[6] = {positionBufferID, predictedBufferID, velocityBufferID,
+						 constraintBufferID, restBufferID, anchorBufferID};
+	glDeleteBuffers(6, buffers);
+	positionBufferID = predictedBufferID = velocityBufferID = 0;
+	constraintBufferID = restBufferID = anchorBufferID = 0;
+}
+
+void CXPBDClothGPU::ReleaseCollision() {
+	collision = 0;
+	if(hashBufferID == 0)
+		return;
+	GLuint buffers[6] = {hashBufferID, cellEntryBufferID, adjacencyBufferID,
+						 indexBufferID, candidateBufferID, collidedBufferID};
+	glDeleteBuffers(6, buffers);
+	hashBufferID = cellEntryBufferID = adjacencyBufferID = 0;
+	indexBufferID = candidateBufferID = collidedBufferID = 0;
+	glDeleteTextures(CClothCollision::MAX_COLLIDERS, distanceFieldID);
+	for(int i=0;i<CClothCollision::MAX_COLLIDERS;i++)
+		distanceFieldID[i] = 0;
+}
+
+static GLuint CreateBuffer(const GLsizeiptr size, const GLvoid* data) {
+	GLuint id;
+	glGenBuffers(1, &id);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, id);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_COPY);
+	return id;
+}
+
+void CXPBDClothGPU::SetCollision(CClothCollision* c) {
+	ReleaseCollision();
+	collision = c;
+	if(!collision)
+		return;
+
+	//cell starts followed by the cell counts
+	tableSize = collision->GetTableSize();
+	hashBufferID = CreateBuffer((2*tableSize+1)*sizeof(int), 0);
+	cellEntryBufferID = CreateBuffer(total*sizeof(int), 0);
+
+	//triangle starts of every particle followed by the triangles
+	std::vector<int> adjacency(collision->GetTriangleStart());
+	const std::vector<int>& triangles = collision->GetVertexTriangles();
+	adjacency.insert(adjacency.end(), triangles.begin(), triangles.end());
+	adjacencyBufferID = CreateBuffer(adjacency.size()*sizeof(int), &adjacency[0]);
+	const std::vector<unsigned int>& indices = collision->GetIndices();
+	indexBufferID = CreateBuffer(indices.size()*sizeof(unsigned int), &indices[0]);
+
+	//the padding particle only needs room in the collided positions
+	std::vector<int> candidates(total*CANDIDATE_STRIDE, 0);
+	candidateBufferID = CreateBuffer(candidates.size()*sizeof(int), &candidates[0]);
+	collidedBufferID = CreateBuffer((total+1)*sizeof(glm::vec4), 0);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	//the distance fields as linearly filtered float textures
+	glGenTextures(collision->GetTotalColliders(), distanceFieldID);
+	for(int i=0;i<collision->GetTotalColliders();i++) {
+		const CMeshCollider* mesh = collision->GetCollider(i).mesh;
+		const int res = mesh->GetResolution();
+		glBindTexture(GL_TEXTURE_3D, distanceFieldID[i]);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, res, res, res, 0, GL_RED, GL_FLOAT, mesh->GetData());
+	}
+	glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+void CXPBDClothGPU::SetConstraints(const CClothConstraints& constraints) {
+	ReleaseBuffers();
+	total = constraints.GetTotalParticles();
+
+	//the padding particle of the batches follows the cloth particles
+	std::vector<glm::vec4> positions(constraints.GetPositions());
+	positions.push_back(glm::vec4(0));
+	std::vector<glm::vec4> velocities(positions.size(), glm::vec4(0));
+	const GLsizeiptr size = positions.size()*sizeof(glm::vec4);
+	positionBufferID = CreateBuffer(size, &positions[0]);
+	predictedBufferID = CreateBuffer(size, &positions[0]);
+	velocityBufferID = CreateBuffer(size, &velocities[0]);
+	restBufferID = CreateBuffer(size, &positions[0]);
+
+	constraintBufferID = CreateBuffer(constraints.GetTotalConstraints()*sizeof(CClothConstraints::Constraint),
+									  constraints.GetConstraints());
+	const std::vector<int>& anchors = constraints.GetAnchors();
+	totalAnchors = int(anchors.size());
+	anchorBufferID = CreateBuffer((totalAnchors+1)*sizeof(int), totalAnchors? &anchors[0] : 0);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	batchStart.resize(constraints.GetTotalBatches()+1);
+	for(int i=0;i<constraints.GetTotalBatches();i++)
+		batchStart[i] = constraints.GetBatchStart(i);
+	batchStart.back() = constraints.GetTotalConstraints();
+}
+
+void CXPBDClothGPU::SetParticle(const int i, const glm::vec3& p, const float invMass) {
+	glm::vec4 position(p, invMass), zero(0);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, positionBufferID);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, i*sizeof(glm::vec4), sizeof(glm::vec4), &position);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, predictedBufferID);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, i*sizeof(glm::vec4), sizeof(glm::vec4), &position);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, velocityBufferID);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, i*sizeof(glm::vec4), sizeof(glm::vec4), &zero);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void CXPBDClothGPU::Read(std::vector<glm::vec4>& positions) {
+	positions.resize(total);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, positionBufferID);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, total*sizeof(glm::vec4), &positions[0]);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void CXPBDClothGPU::Step(const float dt) {
+	//the query of the previous step has finished by now
+	if(frame > 0) {
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(queryID[(frame-1)&1], GL_QUERY_RESULT, &elapsed);
+		stepTime = elapsed/1000000.0f;
+	}
+	glBeginQuery(GL_TIME_ELAPSED, queryID[frame&1]);
+	frame++;
+
+	float maxVelocity = 0;
+	if(collision) {
+		collision->SetSubsteps(substeps);
+		maxVelocity = collision->GetMaxVelocity(dt);
+		FindCandidates();
+	}
+	BindBuffers();
+
+	const float h = dt/substeps;
+	float alpha[CClothConstraints::TOTAL_TYPES];
+	for(int i=0;i<CClothConstraints::TOTAL_TYPES;i++)
+		alpha[i] = compliance[i]/(h*h);
+	const int particleGroups = (total+1+GROUP_SIZE-1)/GROUP_SIZE;
+
+	predictShader.Use();
+		glUniform1i(predictShader("totalParticles"), total+1);
+		glUniform1f(predictShader("h"), h);
+		glUniform3fv(predictShader("gravity"), 1, &gravity.x);
+		glUniform1f(predictShader("maxVelocity"), maxVelocity);
+	solveShader.Use();
+		glUniform1fv(solveShader("alpha"), CClothConstraints::TOTAL_TYPES, alpha);
+	finalizeShader.Use();
+		glUniform1i(finalizeShader("totalParticles"), total);
+		glUniform1i(finalizeShader("totalAnchors"), totalAnchors);
+		glUniform1f(finalizeShader("h"), h);
+		glUniform1f(finalizeShader("damping"), damping);
+
+	for(int s=0;s<substeps;s++) {
+		predictShader.Use();
+		glDispatchCompute(particleGroups, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		//the batches depend on each other, the constraints of a batch do not
+		solveShader.Use();
+		for(size_t b=0;b+1<batchStart.size();b++) {
+			int size = batchStart[b+1]-batchStart[b];
+			glUniform1i(solveShader("batchStart"), batchStart[b]);
+			glUniform1i(solveShader("batchSize"), size);
+			glDispatchCompute((size+GROUP_SIZE-1)/GROUP_SIZE, 1, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		}
+
+		if(collision) {
+			//every particle reads the others and writes only itself, the
+			//result becomes the predicted positions
+			collideShader.Use();
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDICES, indexBufferID);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CANDIDATES, candidateBufferID);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COLLIDED, collidedBufferID);
+			glDispatchCompute(particleGroups, 1, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			std::swap(predictedBufferID, collidedBufferID);
+			BindBuffers();
+		}
+
+		finalizeShader.Use();
+		glDispatchCompute(particleGroups, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+	glUseProgram(0);
+	for(int i=0;collision && i<collision->GetTotalColliders();i++) {
+		glActiveTexture(GL_TEXTURE0+i);
+		glBindTexture(GL_TEXTURE_3D, 0);
+	}
+	glActiveTexture(GL_TEXTURE0);
+	glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+	glEndQuery(GL_TIME_ELAPSED);
+}
+
+void CXPBDClothGPU::BindBuffers() {
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POSITIONS, positionBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PREDICTED, predictedBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VELOCITIES, velocityBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CONSTRAINTS, constraintBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, REST_POSITIONS, restBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ANCHORS, anchorBufferID);
+}
+
+void CXPBDClothGPU::FindCandidates() {
+	const float cellSize = collision->GetSearchRadius();
+	const int particleGroups = (total+GROUP_SIZE-1)/GROUP_SIZE;
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POSITIONS, positionBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HASH, hashBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CELL_ENTRIES, cellEntryBufferID);
+
+	if(!collision->IsSelfCollision()) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, candidateBufferID);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32I, GL_RED_INTEGER, GL_INT, 0);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	} else {
+		//counting sort of the particles by hash table entry
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, hashBufferID);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32I, GL_RED_INTEGER, GL_INT, 0);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		GLSLShader* hashShaders[3] = {&hashCountShader, &hashScanShader, &hashScatterShader};
+		for(int i=0;i<3;i++) {
+			hashShaders[i]->Use();
+			glUniform1i((*hashShaders[i])("totalParticles"), total);
+			glUniform1i((*hashShaders[i])("tableSize"), tableSize);
+			glUniform1f((*hashShaders[i])("cellSize"), cellSize);
+			//the scan runs in a single work group
+			glDispatchCompute(hashShaders[i] == &hashScanShader? 1 : particleGroups, 1, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		}
+
+		candidateShader.Use();
+		glUniform1i(candidateShader("totalParticles"), total);
+		glUniform1i(candidateShader("tableSize"), tableSize);
+		glUniform1f(candidateShader("cellSize"), cellSize);
+		glUniform1f(candidateShader("pairRadius"), collision->GetPairRadius());
+		glUniform1f(candidateShader("triangleRadius"), collision->GetTriangleRadius());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ADJACENCY, adjacencyBufferID);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDICES, indexBufferID);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CANDIDATES, candidateBufferID);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, REST_POSITIONS, restBufferID);
+		glDispatchCompute(particleGroups, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	//colliders of the step
+	const int colliders = collision->GetTotalColliders();
+	collideShader.Use();
+	glUniform1i(collideShader("totalParticles"), total+1);
+	glUniform1f(collideShader("thickness"), collision->GetThickness());
+	glUniform1i(collideShader("totalColliders"), colliders);
+	glm::mat4 transforms[CClothCollision::MAX_COLLIDERS], inverses[CClothCollision::MAX_COLLIDERS];
+	glm::vec3 mins[CClothCollision::MAX_COLLIDERS], maxs[CClothCollision::MAX_COLLIDERS];
+	float scales[CClothCollision::MAX_COLLIDERS], resolutions[CClothCollision::MAX_COLLIDERS];
+	for(int i=0;i<colliders;i++) {
+		const CClothCollision::Collider& c = collision->GetCollider(i);
+		transforms[i] = c.transform;
+		inverses[i] = c.inverse;
+		mins[i] = c.mesh->GetMin();
+		maxs[i] = c.mesh->GetMax();
+		scales[i] = c.scale;
+		resolutions[i] = float(c.mesh->GetResolution());
+		glActiveTexture(GL_TEXTURE0+i);
+		glBindTexture(GL_TEXTURE_3D, distanceFieldID[i]);
+	}
+	if(colliders > 0) {
+		glUniformMatrix4fv(collideShader("colliderTransform"), colliders, GL_FALSE, &transforms[0][0][0]);
+		glUniformMatrix4fv(collideShader("colliderInverse"), colliders, GL_FALSE, &inverses[0][0][0]);
+		glUniform3fv(collideShader("colliderMin"), colliders, &mins[0].x);
+		glUniform3fv(collideShader("colliderMax"), colliders, &maxs[0].x);
+		glUniform1fv(collideShader("colliderScale"), colliders, scales);
+		glUniform1fv(collideShader("colliderResolution"), colliders, resolutions);
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
\ No newline at end of file
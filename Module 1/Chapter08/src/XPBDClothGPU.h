@@ -0,0 +1,99 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "ClothCollision.h"
+#include "ClothConstraints.h"
+#include "GLSLShader.h"
+
+//GPU version of CXPBDCloth using OpenGL 4.3 compute shaders. The constraint
+//batches of CClothConstraints are uploaded as they are and every batch is
+//solved by one dispatch, one invocation per constraint. The positions
+//(xyz, inverse mass in w) stay in a buffer object that is drawn directly.
+//Collisions follow CClothCollision: the spatial hash is built and the
+//candidates are found once per step, then every substep resolves them
+//together with the distance fields of the colliders, kept in 3D textures.
+class CXPBDClothGPU
+{
+public:
+	CXPBDClothGPU(void);
+	~CXPBDClothGPU(void);
+
+	//loads the shaders, the cloth is given with SetConstraints. The
+	//collision shaders are only loaded when asked for.
+	bool Init(const bool collisions = false);
+	void Destroy();
+
+	//(re)creates the buffers for a new cloth in its rest pose
+	void SetConstraints(const CClothConstraints& constraints);
+
+	void SetCompliance(const int type, const float compliance) { this->compliance[type] = compliance; }
+	void SetSubsteps(const int substeps) { this->substeps = substeps; }
+	void SetGravity(const glm::vec3& g) { gravity = g; }
+	void SetDamping(const float damping) { this->damping = damping; }
+
+	//uploads the collision data for the current cloth, 0 disables
+	//collisions. Needs Init(true), call again after changing the colliders
+	//or the cloth.
+	void SetCollision(CClothCollision* collision);
+
+	void Step(const float dt);
+
+	//moves a particle and stops it, see CXPBDCloth
+	void SetParticle(const int i, const glm::vec3& p, const float invMass);
+	//reads back position and inverse mass of every particle
+	void Read(std::vector<glm::vec4>& positions);
+
+	//vec4 per particle, valid for drawing after Step
+	GLuint GetPositionBuffer() const { return positionBufferID; }
+	int GetTotalParticles() const { return total; }
+	//GPU time of the last finished step in milliseconds
+	float GetStepTime() const { return stepTime; }
+
+private:
+	//buffer binding points shared by the cloth shaders
+	enum Bindings {POSITIONS, PREDICTED, VELOCITIES, CONSTRAINTS, REST_POSITIONS, ANCHORS};
+	//only eight binding points are guaranteed, the collision passes reuse
+	//the ones of the cloth buffers they do not need
+	enum CollisionBindings {ADJACENCY=1, INDICES=2, CANDIDATES=3, COLLIDED=5, HASH=6, CELL_ENTRIES=7};
+
+	void BindBuffers();
+	void FindCandidates();
+	void ReleaseBuffers();
+	void ReleaseCollision();
+
+	int total;
+	int totalAnchors;
+	int substeps;
+	float compliance[CClothConstraints::TOTAL_TYPES];
+	glm::vec3 gravity;
+	float damping;
+	std::vector<int> batchStart;
+
+	GLuint positionBufferID;
+	GLuint predictedBufferID;
+	GLuint velocityBufferID;
+	GLuint constraintBufferID;
+	GLuint restBufferID;
+	GLuint anchorBufferID;
+
+	GLSLShader predictShader, solveShader, finalizeShader;
+
+	//collision data, see CClothCollision
+	CClothCollision* collision;
+	int tableSize;
+	GLuint hashBufferID;
+	GLuint cellEntryBufferID;
+	GLuint adjacencyBufferID;
+	GLuint indexBufferID;
+	GLuint candidateBufferID;
+	GLuint collidedBufferID;
+	GLuint distanceFieldID[CClothCollision::MAX_COLLIDERS];
+	GLSLShader hashCountShader, hashScanShader, hashScatterShader;
+	GLSLShader candidateShader, collideShader;
+
+	//timer queries of the last two steps, read one step late
+	GLuint queryID[2];
+	int frame;
+	float stepTime;
+};
\ No newline at end of file